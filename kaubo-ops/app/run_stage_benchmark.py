@@ -0,0 +1,48 @@
+"""分阶段基准用例——在进程内逐段测量编译管线和 VM。
+
+与 RunBenchmark（整进程计时、跨语言对比）互补：这里每个阶段单独计时并统计
+堆分配，结果写 JSON，可与基线比较、超阈值即失败。
+"""
+
+from pathlib import Path
+
+from domain.project import KauboProject
+from infra.command import CommandRunner
+from infra.filesystem import FileSystem
+from infra.events import EventBus
+
+
+class RunStageBenchmark:
+    """运行 `cargo bench -p kaubo-driver --bench stages` 并转发参数。"""
+
+    def __init__(self, runner: CommandRunner, fs: FileSystem, events: EventBus):
+        self.runner = runner
+        self.fs = fs
+        self.events = events
+
+    def run(self, project: KauboProject, suites: list[str] | None = None,
+            iters: int = 10, warmup: int = 3, json_out: Path | None = None,
+            baseline: Path | None = None, threshold: float = 10.0) -> bool:
+        args = ["--iters", str(iters), "--warmup", str(warmup),
+                "--threshold", str(threshold)]
+        if suites:
+            args += ["--suite", ",".join(suites)]
+        if json_out:
+            args += ["--json", str(json_out.resolve())]
+        if baseline:
+            if not baseline.exists():
+                self.events.emit("error", f"Baseline not found: {baseline}")
+                return False
+            args += ["--baseline", str(baseline.resolve())]
+
+        self.events.emit("step", "Stage benchmark")
+        r = self.runner.run(
+            project.create_rust_workspace().stage_bench_command(args),
+            cwd=project.rust_workspace,
+        )
+        print(r.stdout, end="")
+        if not r.ok:
+            self.events.emit("error", f"Stage benchmark failed:\n{r.stderr[-1500:]}")
+            return False
+        self.events.emit("success", "Stage benchmark passed")
+        return True
@@ -82,6 +82,17 @@ def main() -> int:
     bench.add_argument("--kaubo-bin", default=None,
                        help="kaubo2-cli 二进制路径")
 
+    stages = sub.add_parser("bench-stages", help="进程内分阶段基准（耗时 + 分配）")
+    stages.add_argument("--suite", default="",
+                        help="逗号分隔的用例名，如 fib,loop。默认全部")
+    stages.add_argument("--iters", type=int, default=10, help="迭代次数")
+    stages.add_argument("--warmup", type=int, default=3, help="预热次数")
+    stages.add_argument("--json", type=Path, default=None, help="结果 JSON 输出路径")
+    stages.add_argument("--baseline", type=Path, default=None,
+                        help="与之比较的基线 JSON（之前 --json 的输出）")
+    stages.add_argument("--threshold", type=float, default=10.0,
+                        help="回归阈值，百分比（默认 10）")
+
     # ── Coverage ───────────────────────────────────────────
     cov = sub.add_parser("coverage", help="生成覆盖率报告")
     cov.add_argument("--html", action="store_true", help="生成 HTML 报告")
@@ -187,6 +198,18 @@ def main() -> int:
             warmup=args.warmup,
             kaubo_bin=args.kaubo_bin,
         )
+    elif cmd == "bench-stages":
+        from app.run_stage_benchmark import RunStageBenchmark
+        suites = [s.strip() for s in args.suite.split(",")] if args.suite else None
+        ok = RunStageBenchmark(runner, fs, events).run(
+            project,
+            suites=suites,
+            iters=args.iters,
+            warmup=args.warmup,
+            json_out=args.json,
+            baseline=args.baseline,
+            threshold=args.threshold,
+        )
     elif cmd == "coverage":
         from app.run_coverage import RunCoverage
         ok = RunCoverage(runner, fs, events).run(
@@ -28,5 +28,9 @@ class RustWorkspace:
     def build_release_command(self, package: str) -> list[str]:
         return ["cargo", "build", "--release", "-p", package]
 
+    def stage_bench_command(self, args: list[str]) -> list[str]:
+        """进程内分阶段基准（kaubo-driver/benches/stages.rs）。"""
+        return ["cargo", "bench", "-p", "kaubo-driver", "--bench", "stages", "--", *args]
+
     def doc_command(self) -> list[str]:
         return ["cargo", "doc", "--workspace", "--open"]
@@ -0,0 +1,803 @@
+//! Arena-backed AST.
+//!
+//! Every node lives in one of a handful of `Vec`s owned by [`Ast`]. Children
+//! are `u32` ids ([`ExprId`], [`StmtId`], [`TypeId`]) and variable-length
+//! children are contiguous ranges ([`List`]) into a side table, so building a
+//! module is a sequence of pushes instead of one heap allocation per node, and
+//! cloning one is a few `memcpy`s plus a reference count. Names and string literals are [`Symbol`]s
+//! of the interner the lexer filled.
+//!
+//! Nodes are immutable once pushed and may be shared: the parser reuses the
+//! same id for the twice-evaluated operand of `??`. [`Ast::to_module`] lowers
+//! the arena into the owned [`Module`] tree for consumers that walk it.
+
+use crate::{
+    BinOp, Expr, FieldDef, MethodDef, MethodSig, Module, Param, Span, Stmt, TypeExpr, UnOp,
+    VariantDef,
+};
+use kaubo_token::{Interner, Symbol};
+use std::fmt;
+use std::marker::PhantomData;
+use std::ops::Index;
+use std::sync::Arc;
+
+/// Index of an [`ExprNode`] in its [`Ast`].
+#[derive(Debug, Clone, Copy, PartialEq, Eq, Hash)]
+pub struct ExprId(u32);
+
+/// Index of a [`StmtNode`] in its [`Ast`].
+#[derive(Debug, Clone, Copy, PartialEq, Eq, Hash)]
+pub struct StmtId(u32);
+
+/// Index of a [`TypeNode`] in its [`Ast`].
+#[derive(Debug, Clone, Copy, PartialEq, Eq, Hash)]
+pub struct TypeId(u32);
+
+/// Contiguous run of `T` in the arena's side table for `T`.
+pub struct List<T> {
+    start: u32,
+    len: u32,
+    _item: PhantomData<fn() -> T>,
+}
+
+impl<T> List<T> {
+    pub const EMPTY: Self = Self {
+        start: 0,
+        len: 0,
+        _item: PhantomData,
+    };
+
+    pub fn len(self) -> usize {
+        self.len as usize
+    }
+
+    pub fn is_empty(self) -> bool {
+        self.len == 0
+    }
+}
+
+impl<T> Clone for List<T> {
+    fn clone(&self) -> Self {
+        *self
+    }
+}
+
+impl<T> Copy for List<T> {}
+
+impl<T> Default for List<T> {
+    fn default() -> Self {
+        Self::EMPTY
+    }
+}
+
+impl<T> PartialEq for List<T> {
+    fn eq(&self, other: &Self) -> bool {
+        self.start == other.start && self.len == other.len
+    }
+}
+
+impl<T> Eq for List<T> {}
+
+impl<T> fmt::Debug for List<T> {
+    fn fmt(&self, f: &mut fmt::Formatter<'_>) -> fmt::Result {
+        write!(f, "List({}..{})", self.start, self.start + self.len)
+    }
+}
+
+#[derive(Debug, Clone, Copy, PartialEq)]
+pub enum StmtNode {
+    ConstDecl {
+        name: Symbol,
+        span: Span,
+        ty_ann: Option<TypeId>,
+        value: ExprId,
+    },
+    VarDecl {
+        name: Symbol,
+        span: Span,
+        ty_ann: Option<TypeId>,
+        value: Option<ExprId>,
+    },
+    StructDef {
+        name: Symbol,
+        span: Span,
+        fields: List<FieldNode>,
+    },
+    EnumDef {
+        name: Symbol,
+        span: Span,
+        variants: List<VariantNode>,
+    },
+    ImplBlock {
+        struct_name: Symbol,
+        span: Span,
+        interface_name: Option<Symbol>,
+        methods: List<MethodNode>,
+    },
+    InterfaceDef {
+        name: Symbol,
+        span: Span,
+        methods: List<SigNode>,
+    },
+    ExportStmt(StmtId),
+    Import {
+        path: Symbol,
+        alias: Option<Symbol>,
+        names: List<Symbol>,
+    },
+    ExprStmt(ExprId),
+}
+
+#[derive(Debug, Clone, Copy, PartialEq)]
+pub enum ExprNode {
+    LitInt(i64),
+    LitFloat(f64),
+    LitString(Symbol),
+    LitTrue,
+    LitFalse,
+    LitNull,
+
+    VarRef {
+        name: Symbol,
+        span: Span,
+    },
+    Lambda {
+        params: List<ParamNode>,
+        ret_ty: Option<TypeId>,
+        body: ExprId,
+    },
+    Call {
+        func: ExprId,
+        arg: ExprId,
+    },
+    Binary {
+        left: ExprId,
+        op: BinOp,
+        right: ExprId,
+    },
+    Unary {
+        op: UnOp,
+        right: ExprId,
+    },
+    Block(List<StmtId>),
+
+    If {
+        cond: ExprId,
+        then_branch: ExprId,
+        else_branch: Option<ExprId>,
+    },
+    While {
+        cond: ExprId,
+        body: ExprId,
+    },
+    For {
+        var: ParamNode,
+        iterable: ExprId,
+        body: ExprId,
+    },
+    Break,
+    Continue,
+    Return(Option<ExprId>),
+
+    Member {
+        object: ExprId,
+        field: Symbol,
+    },
+    Index {
+        object: ExprId,
+        index: ExprId,
+    },
+
+    StructLit {
+        name: Symbol,
+        fields: List<FieldInit>,
+        spread: Option<ExprId>,
+    },
+    VariantLit {
+        enum_name: Symbol,
+        variant_name: Symbol,
+        tag: u16,
+        fields: List<ExprId>,
+    },
+    ListLit(List<ExprId>),
+    Tuple(List<ExprId>),
+    GetVariantTag(ExprId),
+    GetVariantField {
+        object: ExprId,
+        field_idx: u16,
+    },
+
+    Assign {
+        target: ExprId,
+        value: ExprId,
+    },
+    Async(ExprId),
+    Await(ExprId),
+}
+
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum TypeNode {
+    Named(Symbol),
+    List(TypeId),
+    Tuple(List<TypeId>),
+    Arrow { params: List<TypeId>, ret: TypeId },
+}
+
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub struct ParamNode {
+    pub name: Symbol,
+    pub span: Span,
+    pub ty_ann: Option<TypeId>,
+}
+
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub struct FieldNode {
+    pub name: Symbol,
+    pub span: Span,
+    pub ty: TypeId,
+}
+
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub struct VariantNode {
+    pub name: Symbol,
+    pub span: Span,
+    pub fields: List<FieldNode>,
+}
+
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub struct MethodNode {
+    pub name: Symbol,
+    pub span: Span,
+    pub body: ExprId,
+    pub operator: bool,
+}
+
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub struct SigNode {
+    pub name: Symbol,
+    pub params: List<ParamNode>,
+    pub return_type: Option<TypeId>,
+    pub operator: bool,
+}
+
+/// `name: value` entry of a struct literal.
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub struct FieldInit {
+    pub name: Symbol,
+    pub value: ExprId,
+}
+
+/// Item types that can be stored in a [`List`]; each has its own side table.
+pub trait ListItem: Copy + Sized {
+    fn table(ast: &Ast) -> &Vec<Self>;
+    fn table_mut(ast: &mut Ast) -> &mut Vec<Self>;
+}
+
+macro_rules! list_items {
+    ($($ty:ty => $field:ident),* $(,)?) => {
+        $(impl ListItem for $ty {
+            fn table(ast: &Ast) -> &Vec<Self> {
+                &ast.$field
+            }
+            fn table_mut(ast: &mut Ast) -> &mut Vec<Self> {
+                &mut ast.$field
+            }
+        })*
+    };
+}
+
+list_items! {
+    ExprId => expr_lists,
+    StmtId => stmt_lists,
+    TypeId => type_lists,
+    Symbol => symbols,
+    ParamNode => params,
+    FieldNode => fields,
+    VariantNode => variants,
+    MethodNode => methods,
+    SigNode => sigs,
+    FieldInit => inits,
+}
+
+/// One parsed module: node tables, side tables, root statements and the
+/// interner that owns every [`Symbol`] in them. The interner is shared
+/// between clones and copied only when a clone interns a new name.
+#[derive(Debug, Clone, Default)]
+pub struct Ast {
+    interner: Arc<Interner>,
+    exprs: Vec<ExprNode>,
+    stmts: Vec<StmtNode>,
+    types: Vec<TypeNode>,
+    expr_lists: Vec<ExprId>,
+    stmt_lists: Vec<StmtId>,
+    type_lists: Vec<TypeId>,
+    symbols: Vec<Symbol>,
+    params: Vec<ParamNode>,
+    fields: Vec<FieldNode>,
+    variants: Vec<VariantNode>,
+    methods: Vec<MethodNode>,
+    sigs: Vec<SigNode>,
+    inits: Vec<FieldInit>,
+    roots: List<StmtId>,
+}
+
+fn next_index(len: usize) -> u32 {
+    u32::try_from(len).expect("AST arena exceeds u32 indices")
+}
+
+impl Ast {
+    pub fn new() -> Self {
+        Self::default()
+    }
+
+    /// Arena whose symbols continue `interner` (usually the lexer's).
+    pub fn with_interner(interner: Interner) -> Self {
+        Self {
+            interner: Arc::new(interner),
+            ..Self::default()
+        }
+    }
+
+    /// Reserve room for roughly `tokens` tokens worth of nodes.
+    pub fn reserve(&mut self, tokens: usize) {
+        self.exprs.reserve(tokens / 2);
+        self.stmts.reserve(tokens / 8);
+        self.expr_lists.reserve(tokens / 8);
+        self.stmt_lists.reserve(tokens / 8);
+    }
+
+    pub fn interner(&self) -> &Interner {
+        &self.interner
+    }
+
+    pub fn interner_mut(&mut self) -> &mut Interner {
+        Arc::make_mut(&mut self.interner)
+    }
+
+    pub fn intern(&mut self, name: &str) -> Symbol {
+        self.interner_mut().intern(name)
+    }
+
+    /// Text of a name or string literal.
+    pub fn name(&self, sym: Symbol) -> &str {
+        self.interner.resolve(sym)
+    }
+
+    pub fn add_expr(&mut self, node: ExprNode) -> ExprId {
+        let id = ExprId(next_index(self.exprs.len()));
+        self.exprs.push(node);
+        id
+    }
+
+    pub fn add_stmt(&mut self, node: StmtNode) -> StmtId {
+        let id = StmtId(next_index(self.stmts.len()));
+        self.stmts.push(node);
+        id
+    }
+
+    pub fn add_type(&mut self, node: TypeNode) -> TypeId {
+        let id = TypeId(next_index(self.types.len()));
+        self.types.push(node);
+        id
+    }
+
+    /// Copy `items` to the end of their side table.
+    pub fn add_list<T: ListItem>(&mut self, items: &[T]) -> List<T> {
+        if items.is_empty() {
+            return List::EMPTY;
+        }
+        let table = T::table_mut(self);
+        let start = next_index(table.len());
+        table.extend_from_slice(items);
+        List {
+            start,
+            len: next_index(items.len()),
+            _item: PhantomData,
+        }
+    }
+
+    pub fn set_roots(&mut self, roots: List<StmtId>) {
+        self.roots = roots;
+    }
+
+    /// Top-level statements in source order.
+    pub fn roots(&self) -> &[StmtId] {
+        &self[self.roots]
+    }
+
+    /// Expression, statement and type nodes in the arena.
+    pub fn node_count(&self) -> usize {
+        self.exprs.len() + self.stmts.len() + self.types.len()
+    }
+
+    // ── Lowering to the owned tree ──
+
+    pub fn to_module(&self) -> Module {
+        Module {
+            stmts: self.roots().iter().map(|&s| self.lower_stmt(s)).collect(),
+        }
+    }
+
+    pub fn lower_stmt(&self, id: StmtId) -> Stmt {
+        match self[id] {
+            StmtNode::ConstDecl {
+                name,
+                span,
+                ty_ann,
+                value,
+            } => Stmt::ConstDecl {
+                name: self.string(name),
+                span,
+                ty_ann: ty_ann.map(|t| self.lower_type(t)),
+                value: self.lower_expr(value),
+            },
+            StmtNode::VarDecl {
+                name,
+                span,
+                ty_ann,
+                value,
+            } => Stmt::VarDecl {
+                name: self.string(name),
+                span,
+                ty_ann: ty_ann.map(|t| self.lower_type(t)),
+                value: value.map(|v| self.lower_expr(v)),
+            },
+            StmtNode::StructDef { name, span, fields } => Stmt::StructDef {
+                name: self.string(name),
+                span,
+                fields: self.lower_fields(fields),
+            },
+            StmtNode::EnumDef {
+                name,
+                span,
+                variants,
+            } => Stmt::EnumDef {
+                name: self.string(name),
+                span,
+                variants: self[variants]
+                    .iter()
+                    .map(|v| VariantDef {
+                        name: self.string(v.name),
+                        span: v.span,
+                        fields: self.lower_fields(v.fields),
+                    })
+                    .collect(),
+            },
+            StmtNode::ImplBlock {
+                struct_name,
+                span,
+                interface_name,
+                methods,
+            } => Stmt::ImplBlock {
+                struct_name: self.string(struct_name),
+                span,
+                interface_name: interface_name.map(|i| self.string(i)),
+                methods: self[methods]
+                    .iter()
+                    .map(|m| MethodDef {
+                        name: self.string(m.name),
+                        span: m.span,
+                        body: self.lower_expr(m.body),
+                        operator: m.operator,
+                    })
+                    .collect(),
+            },
+            StmtNode::InterfaceDef {
+                name,
+                span,
+                methods,
+            } => Stmt::InterfaceDef {
+                name: self.string(name),
+                span,
+                methods: self[methods]
+                    .iter()
+                    .map(|m| MethodSig {
+                        name: self.string(m.name),
+                        params: self.lower_params(m.params),
+                        return_type: m.return_type.map(|t| self.lower_type(t)),
+                        operator: m.operator,
+                    })
+                    .collect(),
+            },
+            StmtNode::ExportStmt(inner) => Stmt::ExportStmt(Box::new(self.lower_stmt(inner))),
+            StmtNode::Import { path, alias, names } => Stmt::Import {
+                path: self.string(path),
+                alias: alias.map(|a| self.string(a)),
+                names: self[names].iter().map(|&n| self.string(n)).collect(),
+            },
+            StmtNode::ExprStmt(expr) => Stmt::ExprStmt(self.lower_expr(expr)),
+        }
+    }
+
+    pub fn lower_expr(&self, id: ExprId) -> Expr {
+        match self[id] {
+            ExprNode::LitInt(n) => Expr::LitInt(n),
+            ExprNode::LitFloat(f) => Expr::LitFloat(f),
+            ExprNode::LitString(s) => Expr::LitString(self.string(s)),
+            ExprNode::LitTrue => Expr::LitTrue,
+            ExprNode::LitFalse => Expr::LitFalse,
+            ExprNode::LitNull => Expr::LitNull,
+            ExprNode::VarRef { name, span } => Expr::VarRef {
+                name: self.string(name),
+                span,
+            },
+            ExprNode::Lambda {
+                params,
+                ret_ty,
+                body,
+            } => Expr::Lambda {
+                params: self.lower_params(params),
+                ret_ty: ret_ty.map(|t| self.lower_type(t)),
+                body: self.boxed(body),
+            },
+            ExprNode::Call { func, arg } => Expr::Call {
+                func: self.boxed(func),
+                arg: self.boxed(arg),
+            },
+            ExprNode::Binary { left, op, right } => Expr::Binary {
+                left: self.boxed(left),
+                op,
+                right: self.boxed(right),
+            },
+            ExprNode::Unary { op, right } => Expr::Unary {
+                op,
+                right: self.boxed(right),
+            },
+            ExprNode::Block(stmts) => {
+                Expr::Block(self[stmts].iter().map(|&s| self.lower_stmt(s)).collect())
+            }
+            ExprNode::If {
+                cond,
+                then_branch,
+                else_branch,
+            } => Expr::If {
+                cond: self.boxed(cond),
+                then_branch: self.boxed(then_branch),
+                else_branch: else_branch.map(|e| self.boxed(e)),
+            },
+            ExprNode::While { cond, body } => Expr::While {
+                cond: self.boxed(cond),
+                body: self.boxed(body),
+            },
+            ExprNode::For {
+                var,
+                iterable,
+                body,
+            } => Expr::For {
+                var: self.lower_param(&var),
+                iterable: self.boxed(iterable),
+                body: self.boxed(body),
+            },
+            ExprNode::Break => Expr::Break,
+            ExprNode::Continue => Expr::Continue,
+            ExprNode::Return(value) => Expr::Return(value.map(|v| self.boxed(v))),
+            ExprNode::Member { object, field } => Expr::Member {
+                object: self.boxed(object),
+                field: self.string(field),
+            },
+            ExprNode::Index { object, index } => Expr::Index {
+                object: self.boxed(object),
+                index: self.boxed(index),
+            },
+            ExprNode::StructLit {
+                name,
+                fields,
+                spread,
+            } => Expr::StructLit {
+                name: self.string(name),
+                fields: self[fields]
+                    .iter()
+                    .map(|f| (self.string(f.name), self.lower_expr(f.value)))
+                    .collect(),
+                spread: spread.map(|s| self.boxed(s)),
+            },
+            ExprNode::VariantLit {
+                enum_name,
+                variant_name,
+                tag,
+                fields,
+            } => Expr::VariantLit {
+                enum_name: self.string(enum_name),
+                variant_name: self.string(variant_name),
+                tag,
+                fields: self.lower_exprs(fields),
+            },
+            ExprNode::ListLit(items) => Expr::ListLit(self.lower_exprs(items)),
+            ExprNode::Tuple(items) => Expr::Tuple(self.lower_exprs(items)),
+            ExprNode::GetVariantTag(object) => Expr::GetVariantTag(self.boxed(object)),
+            ExprNode::GetVariantField { object, field_idx } => Expr::GetVariantField {
+                object: self.boxed(object),
+                field_idx,
+            },
+            ExprNode::Assign { target, value } => Expr::Assign {
+                target: self.boxed(target),
+                value: self.boxed(value),
+            },
+            ExprNode::Async(e) => Expr::Async(self.boxed(e)),
+            ExprNode::Await(e) => Expr::Await(self.boxed(e)),
+        }
+    }
+
+    pub fn lower_type(&self, id: TypeId) -> TypeExpr {
+        match self[id] {
+            TypeNode::Named(name) => TypeExpr::Named(self.string(name)),
+            TypeNode::List(inner) => TypeExpr::List(Box::new(self.lower_type(inner))),
+            TypeNode::Tuple(items) => {
+                TypeExpr::Tuple(self[items].iter().map(|&t| self.lower_type(t)).collect())
+            }
+            TypeNode::Arrow { params, ret } => TypeExpr::Arrow {
+                params: self[params].iter().map(|&t| self.lower_type(t)).collect(),
+                ret: Box::new(self.lower_type(ret)),
+            },
+        }
+    }
+
+    fn string(&self, sym: Symbol) -> String {
+        self.name(sym).to_string()
+    }
+
+    fn boxed(&self, id: ExprId) -> Box<Expr> {
+        Box::new(self.lower_expr(id))
+    }
+
+    fn lower_exprs(&self, items: List<ExprId>) -> Vec<Expr> {
+        self[items].iter().map(|&e| self.lower_expr(e)).collect()
+    }
+
+    fn lower_param(&self, p: &ParamNode) -> Param {
+        Param {
+            name: self.string(p.name),
+            span: p.span,
+            ty_ann: p.ty_ann.map(|t| self.lower_type(t)),
+        }
+    }
+
+    fn lower_params(&self, params: List<ParamNode>) -> Vec<Param> {
+        self[params].iter().map(|p| self.lower_param(p)).collect()
+    }
+
+    fn lower_fields(&self, fields: List<FieldNode>) -> Vec<FieldDef> {
+        self[fields]
+            .iter()
+            .map(|f| FieldDef {
+                name: self.string(f.name),
+                span: f.span,
+                ty: self.lower_type(f.ty),
+            })
+            .collect()
+    }
+}
+
+impl Index<ExprId> for Ast {
+    type Output = ExprNode;
+
+    fn index(&self, id: ExprId) -> &ExprNode {
+        &self.exprs[id.0 as usize]
+    }
+}
+
+impl Index<StmtId> for Ast {
+    type Output = StmtNode;
+
+    fn index(&self, id: StmtId) -> &StmtNode {
+        &self.stmts[id.0 as usize]
+    }
+}
+
+impl Index<TypeId> for Ast {
+    type Output = TypeNode;
+
+    fn index(&self, id: TypeId) -> &TypeNode {
+        &self.types[id.0 as usize]
+    }
+}
+
+impl<T: ListItem> Index<List<T>> for Ast {
+    type Output = [T];
+
+    fn index(&self, list: List<T>) -> &[T] {
+        let start = list.start as usize;
+        &T::table(self)[start..start + list.len as usize]
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    const S: Span = Span { line: 1, col: 1 };
+
+    /// `const xs: List<Int64> = [1, x]; xs ?? xs;` built by hand.
+    fn sample() -> Ast {
+        let mut ast = Ast::new();
+        let name = ast.intern("xs");
+        let x = ast.intern("x");
+        let int = ast.intern("Int64");
+        let one = ast.add_expr(ExprNode::LitInt(1));
+        let var = ast.add_expr(ExprNode::VarRef { name: x, span: S });
+        let items = ast.add_list(&[one, var]);
+        let list = ast.add_expr(ExprNode::ListLit(items));
+        let elem = ast.add_type(TypeNode::Named(int));
+        let ty = ast.add_type(TypeNode::List(elem));
+        let decl = ast.add_stmt(StmtNode::ConstDecl {
+            name,
+            span: S,
+            ty_ann: Some(ty),
+            value: list,
+        });
+        let xs = ast.add_expr(ExprNode::VarRef { name, span: S });
+        // the same node on both sides, as `??` desugaring produces
+        let both = ast.add_expr(ExprNode::Binary {
+            left: xs,
+            op: BinOp::Add,
+            right: xs,
+        });
+        let stmt = ast.add_stmt(StmtNode::ExprStmt(both));
+        let roots = ast.add_list(&[decl, stmt]);
+        ast.set_roots(roots);
+        ast
+    }
+
+    #[test]
+    fn ids_index_their_tables() {
+        let ast = sample();
+        assert_eq!(ast.roots().len(), 2);
+        let StmtNode::ConstDecl { name, value, .. } = ast[ast.roots()[0]] else {
+            panic!("expected const");
+        };
+        assert_eq!(ast.name(name), "xs");
+        let ExprNode::ListLit(items) = ast[value] else {
+            panic!("expected list");
+        };
+        assert_eq!(items.len(), 2);
+        assert_eq!(ast[ast[items][0]], ExprNode::LitInt(1));
+        assert_eq!(ast.node_count(), 9);
+    }
+
+    #[test]
+    fn lowering_rebuilds_the_owned_tree() {
+        let var = |name: &str| Expr::VarRef {
+            name: name.to_string(),
+            span: S,
+        };
+        let expected = Module {
+            stmts: vec![
+                Stmt::ConstDecl {
+                    name: "xs".to_string(),
+                    span: S,
+                    ty_ann: Some(TypeExpr::List(Box::new(TypeExpr::named("Int64")))),
+                    value: Expr::ListLit(vec![Expr::LitInt(1), var("x")]),
+                },
+                Stmt::ExprStmt(Expr::Binary {
+                    left: Box::new(var("xs")),
+                    op: BinOp::Add,
+                    right: Box::new(var("xs")),
+                }),
+            ],
+        };
+        assert_eq!(sample().to_module(), expected);
+    }
+
+    #[test]
+    fn empty_lists_share_the_empty_range() {
+        let mut ast = Ast::new();
+        let empty: List<ExprId> = ast.add_list(&[]);
+        assert!(empty.is_empty());
+        assert_eq!(empty, List::EMPTY);
+        assert!(ast[empty].is_empty());
+        assert!(ast.roots().is_empty());
+        assert_eq!(ast.to_module(), Module { stmts: vec![] });
+    }
+
+    #[test]
+    fn clone_keeps_symbols_resolvable() {
+        let ast = sample();
+        let copy = ast.clone();
+        drop(ast);
+        assert_eq!(copy.to_module().stmts.len(), 2);
+        assert_eq!(
+            copy.interner().get("Int64").map(|s| copy.name(s)),
+            Some("Int64")
+        );
+    }
+}
@@ -2,6 +2,11 @@
 //!
 //! This crate owns syntax tree data structures shared by parser, infer, IR,
 //! and adapters. It does not parse or infer on its own.
+//!
+//! [`arena::Ast`] is the flat form the parser builds; [`Module`] is the owned
+//! tree lowered from it for passes that walk `Box`ed nodes.
+
+pub mod arena;
 
 /// Source position (1-based line and column).
 #[derive(Debug, Clone, Copy, PartialEq, Eq, Default)]
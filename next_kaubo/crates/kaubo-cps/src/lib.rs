@@ -7,6 +7,9 @@
 use serde::{Deserialize, Serialize};
 use std::collections::HashMap;
 
+#[cfg(feature = "test-util")]
+pub mod test_util;
+
 #[derive(Debug, Clone, Serialize, Deserialize)]
 pub struct CpsModule {
     pub functions: Vec<CpsFunction>,
@@ -141,8 +144,20 @@ pub enum CpsUnOp {
     NegInt,
     FNeg,
     Not,
+    // 纯数学 builtin 的 intrinsic 形式：一条 VM 指令，不走 CallNative
+    FSqrt,
+    FSin,
+    FCos,
+    FFloor,
+    FCeil,
 }
 
+/// `CallNative` 的最大实参个数。
+///
+/// VM 把实参从寄存器窗口收集到定长栈数组里再调用 native，不分配；
+/// 构建 CPS 时超过此数的调用直接报错。
+pub const MAX_NATIVE_ARGS: usize = 4;
+
 #[derive(Debug, Clone, Serialize, Deserialize)]
 pub enum Constant {
     Int(i64),
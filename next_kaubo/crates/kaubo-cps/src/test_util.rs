@@ -0,0 +1,54 @@
+//! Terse CPS constructors for unit tests in the passes and the VM.
+//!
+//! Only built with the `test-util` feature, which downstream crates enable
+//! from `[dev-dependencies]`.
+
+use crate::*;
+
+/// A block without parameters.
+pub fn block(id: usize, instrs: Vec<CpsInstr>, term: CpsTerminator) -> CpsBlock {
+    block_with(id, vec![], instrs, term)
+}
+
+/// A block that binds `params` on entry.
+pub fn block_with(
+    id: usize,
+    params: Vec<usize>,
+    instrs: Vec<CpsInstr>,
+    term: CpsTerminator,
+) -> CpsBlock {
+    CpsBlock {
+        id,
+        params,
+        instrs,
+        term,
+    }
+}
+
+/// Function `f` entered at block 0.
+pub fn func(blocks: Vec<CpsBlock>, reg_count: usize) -> CpsFunction {
+    named_func("f", blocks, reg_count)
+}
+
+/// Like [`func`], with a name (for tests that look functions up by name).
+pub fn named_func(name: &str, blocks: Vec<CpsBlock>, reg_count: usize) -> CpsFunction {
+    CpsFunction {
+        name: name.into(),
+        blocks,
+        entry: 0,
+        reg_count,
+    }
+}
+
+/// A module with no type definitions or symbol map.
+pub fn module(functions: Vec<CpsFunction>, constants: Vec<Constant>) -> CpsModule {
+    CpsModule {
+        functions,
+        constants,
+        structs: vec![],
+        enums: vec![],
+        vtables: vec![],
+        symbol_map: HashMap::new(),
+        func_owners: vec![],
+    }
+}
@@ -0,0 +1,365 @@
+//! DiskCache — the native [`PersistentCache`]: one file per entry.
+//!
+//! # Layout
+//!
+//! ```text
+//! <root>/<kind>/<key>      header + payload
+//! <root>/<kind>/.<key>.<pid>.<n>.tmp   write in progress
+//! ```
+//!
+//! Every entry starts with a 32-byte header: `"KDC1"`, 4 reserved bytes,
+//! the payload length (u64 LE) and the payload's FNV-1a 128 checksum. A
+//! file whose length or checksum disagrees is treated as a miss and
+//! removed, so a torn or foreign file can never be decoded as an artifact.
+//!
+//! # Concurrency
+//!
+//! Writers fill a uniquely named temp file and `rename` it over the entry,
+//! so readers in this or any other process see either the old entry or the
+//! new one, never a partial write. Two writers racing on one key both
+//! produce the same bytes (the key is a content address), so the last
+//! rename winning is harmless.
+//!
+//! # Eviction
+//!
+//! A hit refreshes the entry's modification time, which makes mtime an
+//! LRU clock shared by all processes using the directory. When a write
+//! pushes the tracked total over `max_bytes`, the directory is rescanned
+//! and the least recently used entries are removed until the total is
+//! back under 90% of the limit.
+
+use crate::persist::{checksum, CacheCounters, CacheKey, CacheStats, PersistentCache};
+use crate::types::Kind;
+use std::fs;
+use std::io::{self, Write};
+use std::path::{Path, PathBuf};
+use std::sync::atomic::{AtomicU64, Ordering};
+use std::sync::Mutex;
+use std::time::SystemTime;
+
+const MAGIC: &[u8; 4] = b"KDC1";
+const HEADER_LEN: usize = 32;
+
+/// A size-bounded, content-addressed artifact cache in a directory.
+pub struct DiskCache {
+    root: PathBuf,
+    max_bytes: u64,
+    /// Bytes this process believes the directory holds. Other processes
+    /// write too, so it is only a trigger; eviction rescans.
+    total: AtomicU64,
+    /// Distinguishes this process's concurrent temp files.
+    tmp_seq: AtomicU64,
+    /// Serialises eviction scans within the process.
+    evicting: Mutex<()>,
+    counters: CacheCounters,
+}
+
+impl DiskCache {
+    /// Open (creating if needed) a cache rooted at `root`, holding at most
+    /// `max_bytes` of entries.
+    pub fn open(root: impl Into<PathBuf>, max_bytes: u64) -> io::Result<Self> {
+        let root = root.into();
+        fs::create_dir_all(&root)?;
+        let total = scan(&root).iter().map(|e| e.size).sum();
+        Ok(DiskCache {
+            root,
+            max_bytes,
+            total: AtomicU64::new(total),
+            tmp_seq: AtomicU64::new(0),
+            evicting: Mutex::new(()),
+            counters: CacheCounters::new(),
+        })
+    }
+
+    pub fn root(&self) -> &Path {
+        &self.root
+    }
+
+    /// Bytes currently tracked for the directory.
+    pub fn size(&self) -> u64 {
+        self.total.load(Ordering::Relaxed)
+    }
+
+    fn kind_dir(&self, kind: &Kind) -> PathBuf {
+        let name: String = kind
+            .as_str()
+            .chars()
+            .map(|c| {
+                if c.is_ascii_alphanumeric() || c == '-' {
+                    c
+                } else {
+                    '_'
+                }
+            })
+            .collect();
+        self.root.join(name)
+    }
+
+    fn read_entry(path: &Path) -> Option<Vec<u8>> {
+        let mut bytes = fs::read(path).ok()?;
+        if bytes.len() < HEADER_LEN || &bytes[..4] != MAGIC {
+            return None;
+        }
+        let len = u64::from_le_bytes(bytes[8..16].try_into().unwrap());
+        let sum = u128::from_le_bytes(bytes[16..32].try_into().unwrap());
+        if len != (bytes.len() - HEADER_LEN) as u64 || checksum(&bytes[HEADER_LEN..]) != sum {
+            return None;
+        }
+        bytes.drain(..HEADER_LEN);
+        Some(bytes)
+    }
+
+    fn write_entry(&self, dir: &Path, path: &Path, bytes: &[u8]) -> io::Result<u64> {
+        fs::create_dir_all(dir)?;
+        let name = path.file_name().and_then(|n| n.to_str()).unwrap_or("entry");
+        let seq = self.tmp_seq.fetch_add(1, Ordering::Relaxed);
+        let tmp = dir.join(format!(".{name}.{}.{seq}.tmp", std::process::id()));
+
+        let mut header = [0u8; HEADER_LEN];
+        header[..4].copy_from_slice(MAGIC);
+        header[8..16].copy_from_slice(&(bytes.len() as u64).to_le_bytes());
+        header[16..32].copy_from_slice(&checksum(bytes).to_le_bytes());
+
+        let written = (|| {
+            let mut f = fs::File::create(&tmp)?;
+            f.write_all(&header)?;
+            f.write_all(bytes)?;
+            f.flush()?;
+            drop(f);
+            fs::rename(&tmp, path)
+        })();
+        if let Err(e) = written {
+            let _ = fs::remove_file(&tmp);
+            return Err(e);
+        }
+        Ok((HEADER_LEN + bytes.len()) as u64)
+    }
+
+    /// Remove least recently used entries until the directory is under
+    /// 90% of `max_bytes`.
+    fn evict(&self) {
+        let Ok(_guard) = self.evicting.try_lock() else {
+            return; // another thread is already evicting
+        };
+        let mut entries = scan(&self.root);
+        let mut total: u64 = entries.iter().map(|e| e.size).sum();
+        let target = self.max_bytes / 10 * 9;
+        entries.sort_by_key(|e| e.mtime);
+        for e in entries {
+            if total <= target {
+                break;
+            }
+            if fs::remove_file(&e.path).is_ok() {
+                total -= e.size;
+                self.counters.evict(&e.kind);
+            }
+        }
+        self.total.store(total, Ordering::Relaxed);
+    }
+}
+
+impl PersistentCache for DiskCache {
+    fn load(&self, kind: &Kind, key: CacheKey) -> Option<Vec<u8>> {
+        let path = self.kind_dir(kind).join(key.to_string());
+        match Self::read_entry(&path) {
+            Some(bytes) => {
+                // Refresh the LRU clock; failing to is only a worse eviction order.
+                if let Ok(f) = fs::File::options().write(true).open(&path) {
+                    let _ = f.set_modified(SystemTime::now());
+                }
+                self.counters.hit(kind);
+                Some(bytes)
+            }
+            None => {
+                if path.exists() {
+                    let _ = fs::remove_file(&path);
+                }
+                self.counters.miss(kind);
+                None
+            }
+        }
+    }
+
+    fn store(&self, kind: &Kind, key: CacheKey, bytes: &[u8]) {
+        let dir = self.kind_dir(kind);
+        let path = dir.join(key.to_string());
+        let replaced = fs::metadata(&path).map_or(0, |m| m.len());
+        let Ok(size) = self.write_entry(&dir, &path, bytes) else {
+            return;
+        };
+        self.counters.write(kind);
+        let grow = |t: u64| (t + size).saturating_sub(replaced);
+        let before = self
+            .total
+            .fetch_update(Ordering::Relaxed, Ordering::Relaxed, |t| Some(grow(t)));
+        if grow(before.unwrap_or_default()) > self.max_bytes {
+            self.evict();
+        }
+    }
+
+    fn stats(&self) -> Vec<(Kind, CacheStats)> {
+        self.counters.snapshot()
+    }
+}
+
+/// One file found by [`scan`].
+struct Entry {
+    path: PathBuf,
+    kind: String,
+    size: u64,
+    mtime: SystemTime,
+}
+
+/// Every file under `<root>/<kind>/`, temp files included — a temp file
+/// left by a crashed writer is as evictable as any stale entry.
+fn scan(root: &Path) -> Vec<Entry> {
+    let mut out = Vec::new();
+    let Ok(kinds) = fs::read_dir(root) else {
+        return out;
+    };
+    for kind in kinds.flatten() {
+        let Ok(files) = fs::read_dir(kind.path()) else {
+            continue;
+        };
+        let kind_name = kind.file_name().to_string_lossy().into_owned();
+        for file in files.flatten() {
+            let Ok(meta) = file.metadata() else {
+                continue;
+            };
+            if !meta.is_file() {
+                continue;
+            }
+            out.push(Entry {
+                path: file.path(),
+                kind: kind_name.clone(),
+                size: meta.len(),
+                mtime: meta.modified().unwrap_or(SystemTime::UNIX_EPOCH),
+            });
+        }
+    }
+    out
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use std::sync::Arc;
+    use std::time::Duration;
+
+    fn temp_root(name: &str) -> PathBuf {
+        let dir =
+            std::env::temp_dir().join(format!("kaubo_dag_disk_{name}_{}", std::process::id()));
+        let _ = fs::remove_dir_all(&dir);
+        dir
+    }
+
+    fn key(s: &str) -> CacheKey {
+        CacheKey::builder().str(s).finish()
+    }
+
+    #[test]
+    fn round_trips_and_counts_per_kind() {
+        let root = temp_root("roundtrip");
+        let cache = DiskCache::open(&root, 1 << 20).unwrap();
+        let cps = Kind::new(Kind::CPS);
+        assert_eq!(cache.load(&cps, key("a")), None);
+        cache.store(&cps, key("a"), b"payload");
+        assert_eq!(cache.load(&cps, key("a")).as_deref(), Some(&b"payload"[..]));
+        // Same key, other kind: a separate entry.
+        assert_eq!(cache.load(&Kind::new("ExportTable"), key("a")), None);
+
+        let stats = cache.stats();
+        assert_eq!(stats[0].0.as_str(), "Cps");
+        assert_eq!(
+            stats[0].1,
+            CacheStats {
+                hits: 1,
+                misses: 1,
+                writes: 1,
+                evictions: 0
+            }
+        );
+        assert_eq!(stats[1].1.misses, 1);
+
+        // A second process (here: a second handle) sees the entry.
+        let reopened = DiskCache::open(&root, 1 << 20).unwrap();
+        assert_eq!(reopened.size(), (HEADER_LEN + 7) as u64);
+        assert!(reopened.load(&cps, key("a")).is_some());
+        fs::remove_dir_all(&root).unwrap();
+    }
+
+    #[test]
+    fn corrupt_entries_are_misses() {
+        let root = temp_root("corrupt");
+        let cache = DiskCache::open(&root, 1 << 20).unwrap();
+        let cps = Kind::new(Kind::CPS);
+        cache.store(&cps, key("a"), b"payload");
+        let path = cache.kind_dir(&cps).join(key("a").to_string());
+
+        let mut bytes = fs::read(&path).unwrap();
+        *bytes.last_mut().unwrap() ^= 1;
+        fs::write(&path, &bytes).unwrap();
+        assert_eq!(cache.load(&cps, key("a")), None);
+        assert!(!path.exists(), "corrupt entry is removed");
+
+        cache.store(&cps, key("a"), b"payload");
+        let bytes = fs::read(&path).unwrap();
+        fs::write(&path, &bytes[..bytes.len() - 1]).unwrap();
+        assert_eq!(cache.load(&cps, key("a")), None);
+        fs::remove_dir_all(&root).unwrap();
+    }
+
+    #[test]
+    fn evicts_least_recently_used() {
+        let root = temp_root("lru");
+        let entry = (HEADER_LEN + 100) as u64;
+        let cache = DiskCache::open(&root, entry * 3).unwrap();
+        let cps = Kind::new(Kind::CPS);
+        let old = SystemTime::now() - Duration::from_secs(3600);
+        for (i, name) in ["a", "b", "c"].iter().enumerate() {
+            cache.store(&cps, key(name), &[i as u8; 100]);
+            let path = cache.kind_dir(&cps).join(key(name).to_string());
+            let f = fs::File::options().write(true).open(&path).unwrap();
+            f.set_modified(old + Duration::from_secs(i as u64)).unwrap();
+        }
+        // "a" is the oldest write but the most recent read.
+        assert!(cache.load(&cps, key("a")).is_some());
+        cache.store(&cps, key("d"), &[3; 100]);
+
+        assert!(cache.size() <= entry * 3 / 10 * 9);
+        assert!(cache.load(&cps, key("a")).is_some());
+        assert!(cache.load(&cps, key("d")).is_some());
+        assert_eq!(cache.load(&cps, key("b")), None);
+        assert_eq!(cache.load(&cps, key("c")), None);
+        assert_eq!(cache.stats()[0].1.evictions, 2);
+        fs::remove_dir_all(&root).unwrap();
+    }
+
+    #[test]
+    fn concurrent_writers_leave_whole_entries() {
+        let root = temp_root("concurrent");
+        let cache = Arc::new(DiskCache::open(&root, 1 << 24).unwrap());
+        let cps = Kind::new(Kind::CPS);
+        let payload: Vec<u8> = (0..64 * 1024).map(|i| (i % 251) as u8).collect();
+        let workers: Vec<_> = (0..8)
+            .map(|_| {
+                let (cache, cps, payload) = (Arc::clone(&cache), cps.clone(), payload.clone());
+                std::thread::spawn(move || {
+                    for _ in 0..20 {
+                        cache.store(&cps, key("shared"), &payload);
+                        if let Some(bytes) = cache.load(&cps, key("shared")) {
+                            assert_eq!(bytes, payload);
+                        }
+                    }
+                })
+            })
+            .collect();
+        for w in workers {
+            w.join().unwrap();
+        }
+        let leftovers = fs::read_dir(cache.kind_dir(&cps)).unwrap().count();
+        assert_eq!(leftovers, 1, "temp files are renamed or removed");
+        assert_eq!(cache.load(&cps, key("shared")), Some(payload));
+        fs::remove_dir_all(&root).unwrap();
+    }
+}
@@ -4,6 +4,7 @@
 
 use crate::cancel::CancellationToken;
 use crate::error::DagError;
+use crate::persist::PersistentCache;
 use crate::types::{Artifact, ArtifactKey};
 use futures::channel::mpsc;
 use std::collections::HashSet;
@@ -221,6 +222,64 @@ where
         result
     }
 
+    /// Request several artifacts at once.
+    ///
+    /// Each key is resolved as by [`request_dependency`](Self::request_dependency),
+    /// but as its own task on the scheduler's [`Spawner`](crate::Spawner),
+    /// so independent fetchers run in parallel on a multi-threaded spawner.
+    /// Results come back in `keys` order; the first error in that order is
+    /// returned once every earlier key has resolved.
+    pub async fn request_dependencies(
+        &mut self,
+        keys: Vec<ArtifactKey<M>>,
+    ) -> Result<Vec<Artifact<M>>, DagError<M>> {
+        if keys.len() <= 1 {
+            let mut out = Vec::with_capacity(keys.len());
+            for key in keys {
+                out.push(self.request_dependency(key).await?);
+            }
+            return Ok(out);
+        }
+
+        let mut pending = Vec::with_capacity(keys.len());
+        for key in keys {
+            if self.call_stack_set.contains(&key) {
+                let pos = self.call_stack.iter().position(|k| k == &key).unwrap();
+                let cycle = self.call_stack[pos..].to_vec();
+                return Err(DagError::CircularDependency { cycle });
+            }
+            let mut call_stack = self.call_stack.clone();
+            call_stack.push(key.clone());
+            let mut call_stack_set = self.call_stack_set.clone();
+            call_stack_set.insert(key.clone());
+
+            let request = self.scheduler.request_dependency(
+                key,
+                self.progress_tx.clone(),
+                self.result_tx.clone(),
+                self.cancel.child(),
+                call_stack,
+                call_stack_set,
+            );
+            let (tx, rx) = futures::channel::oneshot::channel();
+            // Unstarted, `request` has not marked the key in flight yet, so
+            // dropping it on cancellation leaves the store consistent.
+            self.scheduler.spawner().spawn_cancellable(
+                Box::pin(async move {
+                    let _ = tx.send(request.await);
+                }),
+                self.cancel.child(),
+            );
+            pending.push(rx);
+        }
+
+        let mut out = Vec::with_capacity(pending.len());
+        for rx in pending {
+            out.push(rx.await.unwrap_or(Err(DagError::Cancelled))?);
+        }
+        Ok(out)
+    }
+
     /// Check whether the current operation has been cancelled.
     ///
     /// Fetchers should call this at each await point and return
@@ -245,6 +304,16 @@ where
         self.scheduler.store.store_and_wake(artifact);
     }
 
+    /// The scheduler's persistent tier, if one is attached.
+    ///
+    /// A fetcher that can name all of its inputs as a
+    /// [`CacheKey`](crate::CacheKey) should try [`load`](PersistentCache::load)
+    /// before computing and [`store`](PersistentCache::store) the encoded
+    /// result afterwards.
+    pub fn persistent_cache(&self) -> Option<&Arc<dyn PersistentCache>> {
+        self.scheduler.persistent_cache()
+    }
+
     /// Mark a key as in-flight so that downstream fetchers calling
     /// `request_dependency` will wait for it. Call `seed_artifact_and_wake`
     /// when the artifact is ready.
@@ -14,7 +14,8 @@
 //! | [`Fetcher<M>`] | Data producer — given inputs, produces one output artifact |
 //! | [`Builder<M, Out>`] | Terminal consumer — produces a final result (not cached) |
 //! | [`DagScheduler<M>`] | Core orchestration engine |
-//! | [`Spawner`] | Platform abstraction for spawning async tasks |
+//! | [`Spawner`] | Platform abstraction for spawning async tasks ([`PoolSpawner`] on native) |
+//! | [`PersistentCache`] | Optional content-addressed tier under the ready cache ([`DiskCache`] on native) |
 //!
 //! # Example (minimal, using `String` as module ID)
 //!
@@ -35,8 +36,13 @@
 
 pub mod builder;
 pub mod cancel;
+#[cfg(not(target_arch = "wasm32"))]
+pub mod disk;
 pub mod error;
 pub mod fetcher;
+pub mod persist;
+#[cfg(not(target_arch = "wasm32"))]
+pub mod pool;
 pub mod registry;
 pub mod scheduler;
 pub mod spawner;
@@ -47,12 +53,17 @@ pub use builder::{Builder, BuilderEvent};
 pub use cancel::CancellationToken;
 pub use error::DagError;
 pub use fetcher::{FetchContext, Fetcher, ProgressEvent, ResultEvent, StreamingHandle};
+pub use persist::{CacheKey, CacheKeyBuilder, CacheStats, PersistentCache};
 pub use registry::FetcherRegistry;
 pub use scheduler::{BuildStream, DagScheduler};
 pub use spawner::{Spawner, SyncSpawner};
 pub use store::ArtifactStore;
 pub use types::{Artifact, ArtifactKey, ContentHash, Kind};
 
+#[cfg(not(target_arch = "wasm32"))]
+pub use disk::DiskCache;
+#[cfg(not(target_arch = "wasm32"))]
+pub use pool::PoolSpawner;
 #[cfg(not(target_arch = "wasm32"))]
 pub use spawner::{BlockingSpawner, NativeSpawner};
 #[cfg(target_arch = "wasm32")]
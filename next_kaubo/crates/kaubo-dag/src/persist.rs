@@ -0,0 +1,218 @@
+//! Persistent artifact tier — encoded artifacts that outlive one scheduler.
+//!
+//! The Ready Cache in [`ArtifactStore`](crate::ArtifactStore) lives as long
+//! as its scheduler. A [`PersistentCache`] sits under it: a fetcher that can
+//! name everything its output depends on as a [`CacheKey`] looks the key up
+//! before computing, and stores the encoded artifact afterwards. The
+//! scheduler never inspects the bytes — encoding, decoding and what goes
+//! into the key are the fetcher's business.
+//!
+//! Keys are content addresses, so entries are never invalidated: an edit
+//! produces a different key, and stale entries age out of the tier's size
+//! limit.
+
+use crate::types::Kind;
+use std::collections::HashMap;
+use std::fmt;
+use std::sync::Mutex;
+
+// ── CacheKey ─────────────────────────────────────────────────────────
+
+/// Content address of a persisted artifact.
+///
+/// Unlike [`ContentHash`](crate::ContentHash), which only has to agree
+/// within one process, a `CacheKey` is compared across processes and
+/// compiler builds, so it uses a fixed 128-bit FNV-1a rather than the
+/// standard library's unspecified hasher.
+#[derive(Debug, Clone, Copy, PartialEq, Eq, Hash)]
+pub struct CacheKey(u128);
+
+impl CacheKey {
+    /// Start a key. Every field is length-prefixed, so `("ab", "c")` and
+    /// `("a", "bc")` hash differently.
+    pub fn builder() -> CacheKeyBuilder {
+        CacheKeyBuilder { state: FNV_OFFSET }
+    }
+
+    /// The raw key value.
+    pub fn as_u128(&self) -> u128 {
+        self.0
+    }
+}
+
+impl fmt::Display for CacheKey {
+    fn fmt(&self, f: &mut fmt::Formatter<'_>) -> fmt::Result {
+        write!(f, "{:032x}", self.0)
+    }
+}
+
+const FNV_OFFSET: u128 = 0x6c62272e07bb014262b821756295c58d;
+const FNV_PRIME: u128 = 0x0000000001000000000000000000013b;
+
+/// FNV-1a over `data`, continuing from `state`.
+pub(crate) fn fnv1a(mut state: u128, data: &[u8]) -> u128 {
+    for &b in data {
+        state ^= b as u128;
+        state = state.wrapping_mul(FNV_PRIME);
+    }
+    state
+}
+
+/// FNV-1a 128 of `data`, used as an entry checksum by persistent tiers and
+/// by the driver's exported program bytecode.
+pub fn checksum(data: &[u8]) -> u128 {
+    fnv1a(FNV_OFFSET, data)
+}
+
+/// Accumulates the inputs of a [`CacheKey`].
+#[derive(Debug, Clone)]
+pub struct CacheKeyBuilder {
+    state: u128,
+}
+
+impl CacheKeyBuilder {
+    /// Mix in a byte string.
+    pub fn bytes(mut self, data: &[u8]) -> Self {
+        self.state = fnv1a(self.state, &(data.len() as u64).to_le_bytes());
+        self.state = fnv1a(self.state, data);
+        self
+    }
+
+    /// Mix in a string.
+    pub fn str(self, s: &str) -> Self {
+        self.bytes(s.as_bytes())
+    }
+
+    /// Mix in another key, e.g. the key of a dependency.
+    pub fn key(self, key: CacheKey) -> Self {
+        self.bytes(&key.0.to_le_bytes())
+    }
+
+    pub fn finish(&self) -> CacheKey {
+        CacheKey(self.state)
+    }
+}
+
+// ── CacheStats ───────────────────────────────────────────────────────
+
+/// Lookup and write counts for one [`Kind`].
+#[derive(Debug, Clone, Copy, Default, PartialEq, Eq)]
+pub struct CacheStats {
+    pub hits: u64,
+    pub misses: u64,
+    pub writes: u64,
+    pub evictions: u64,
+}
+
+/// Per-kind [`CacheStats`], shared by the tier's lookups and writes.
+#[derive(Debug, Default)]
+pub struct CacheCounters {
+    by_kind: Mutex<HashMap<String, CacheStats>>,
+}
+
+impl CacheCounters {
+    pub fn new() -> Self {
+        Self::default()
+    }
+
+    fn bump(&self, kind: &str, f: impl FnOnce(&mut CacheStats)) {
+        let mut map = self.by_kind.lock().unwrap();
+        match map.get_mut(kind) {
+            Some(stats) => f(stats),
+            None => f(map.entry(kind.to_string()).or_default()),
+        }
+    }
+
+    pub fn hit(&self, kind: &Kind) {
+        self.bump(kind.as_str(), |s| s.hits += 1);
+    }
+
+    pub fn miss(&self, kind: &Kind) {
+        self.bump(kind.as_str(), |s| s.misses += 1);
+    }
+
+    pub fn write(&self, kind: &Kind) {
+        self.bump(kind.as_str(), |s| s.writes += 1);
+    }
+
+    pub fn evict(&self, kind: &str) {
+        self.bump(kind, |s| s.evictions += 1);
+    }
+
+    /// Snapshot, sorted by kind name.
+    pub fn snapshot(&self) -> Vec<(Kind, CacheStats)> {
+        let map = self.by_kind.lock().unwrap();
+        let mut out: Vec<_> = map
+            .iter()
+            .map(|(k, s)| (Kind::new(k.clone()), *s))
+            .collect();
+        out.sort_by(|a, b| a.0.as_str().cmp(b.0.as_str()));
+        out
+    }
+}
+
+// ── PersistentCache ──────────────────────────────────────────────────
+
+/// A content-addressed byte store under the Ready Cache.
+///
+/// Implementations must tolerate concurrent use from several fetchers and
+/// several processes. They may drop entries at any time; a failed write is
+/// not an error, only a future miss.
+pub trait PersistentCache: Send + Sync {
+    /// The bytes stored for `(kind, key)`, if still present and intact.
+    fn load(&self, kind: &Kind, key: CacheKey) -> Option<Vec<u8>>;
+
+    /// Store `bytes` for `(kind, key)`, replacing any previous entry.
+    fn store(&self, kind: &Kind, key: CacheKey, bytes: &[u8]);
+
+    /// Hit / miss / write / eviction counts since the tier was opened.
+    fn stats(&self) -> Vec<(Kind, CacheStats)>;
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn keys_are_stable_and_length_prefixed() {
+        let a = CacheKey::builder().str("ab").str("c").finish();
+        let b = CacheKey::builder().str("a").str("bc").finish();
+        assert_ne!(a, b);
+        assert_eq!(a, CacheKey::builder().str("ab").str("c").finish());
+        // Pinned to the FNV-1a reference vector: a key written by one build
+        // must be found by the next.
+        assert_eq!(fnv1a(FNV_OFFSET, b""), FNV_OFFSET);
+        assert_eq!(fnv1a(FNV_OFFSET, b"a"), 0xd228cb696f1a8caf78912b704e4a8964);
+    }
+
+    #[test]
+    fn dependency_keys_feed_the_key() {
+        let dep1 = CacheKey::builder().str("dep v1").finish();
+        let dep2 = CacheKey::builder().str("dep v2").finish();
+        let k1 = CacheKey::builder().str("src").key(dep1).finish();
+        let k2 = CacheKey::builder().str("src").key(dep2).finish();
+        assert_ne!(k1, k2);
+    }
+
+    #[test]
+    fn counters_are_per_kind() {
+        let c = CacheCounters::new();
+        let cps = Kind::new(Kind::CPS);
+        c.hit(&cps);
+        c.hit(&cps);
+        c.miss(&Kind::new(Kind::AST));
+        c.write(&cps);
+        let stats = c.snapshot();
+        assert_eq!(stats[0].0.as_str(), "Ast");
+        assert_eq!(stats[0].1.misses, 1);
+        assert_eq!(
+            stats[1].1,
+            CacheStats {
+                hits: 2,
+                misses: 0,
+                writes: 1,
+                evictions: 0
+            }
+        );
+    }
+}
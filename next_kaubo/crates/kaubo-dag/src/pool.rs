@@ -0,0 +1,469 @@
+//! Work-stealing thread pool behind [`PoolSpawner`].
+//!
+//! [`NativeSpawner`](crate::NativeSpawner) gives every spawned future its
+//! own OS thread and blocks that thread on the future, so a fetcher waiting
+//! on a dependency pins a thread for the whole wait. The pool instead runs
+//! futures as tasks on a fixed set of workers:
+//!
+//! - each worker owns a deque; tasks woken on a worker go to the back of
+//!   its own deque and the worker pops from the back (the task whose data
+//!   is still in cache runs next);
+//! - tasks spawned or woken from outside the pool, and tasks that called
+//!   [`yield_now`](Spawner::yield_now), go to the shared injector queue and
+//!   run after everything already queued;
+//! - an idle worker takes from the injector, then steals from the front of
+//!   the other workers' deques, then parks.
+//!
+//! A pending task holds no thread, so a fetcher awaiting a dependency
+//! costs nothing while it waits and a pool of one worker still cannot
+//! deadlock on the DAG.
+
+use crate::cancel::CancellationToken;
+use crate::spawner::{BlockingSpawner, Spawner};
+use futures::task::{waker_ref, ArcWake};
+use std::cell::Cell;
+use std::collections::VecDeque;
+use std::future::Future;
+use std::pin::Pin;
+use std::sync::atomic::{AtomicBool, AtomicU8, AtomicUsize, Ordering};
+use std::sync::{Arc, Condvar, Mutex, OnceLock};
+use std::task::{Context, Poll};
+
+type BoxFuture = Pin<Box<dyn Future<Output = ()> + Send>>;
+
+// Task states. A wake while RUNNING only records NOTIFIED; the worker
+// requeues the task once the poll returns, so a task is never queued twice.
+const IDLE: u8 = 0;
+const SCHEDULED: u8 = 1;
+const RUNNING: u8 = 2;
+const NOTIFIED: u8 = 3;
+const DONE: u8 = 4;
+
+struct Task {
+    future: Mutex<Option<BoxFuture>>,
+    /// Token from [`Spawner::spawn_cancellable`]; taken on the first poll.
+    cancel: Mutex<Option<CancellationToken>>,
+    state: AtomicU8,
+    shared: Arc<Shared>,
+}
+
+impl ArcWake for Task {
+    fn wake_by_ref(task: &Arc<Self>) {
+        let mut state = task.state.load(Ordering::Acquire);
+        loop {
+            let next = match state {
+                IDLE => SCHEDULED,
+                RUNNING => NOTIFIED,
+                _ => return,
+            };
+            match task
+                .state
+                .compare_exchange_weak(state, next, Ordering::AcqRel, Ordering::Acquire)
+            {
+                Ok(_) if next == SCHEDULED => return task.shared.push(task.clone(), false),
+                Ok(_) => return,
+                Err(actual) => state = actual,
+            }
+        }
+    }
+}
+
+struct Shared {
+    injector: Mutex<VecDeque<Arc<Task>>>,
+    locals: Vec<Mutex<VecDeque<Arc<Task>>>>,
+    /// Tasks sitting in any queue; workers park only when this is zero.
+    queued: AtomicUsize,
+    sleepers: AtomicUsize,
+    sleep: Mutex<()>,
+    wake: Condvar,
+    shutdown: AtomicBool,
+}
+
+thread_local! {
+    /// `(pool address, worker index)` of the pool worker on this thread.
+    static WORKER: Cell<Option<(usize, usize)>> = const { Cell::new(None) };
+    /// Set by [`YieldNow`] so the worker requeues the task behind the injector.
+    static YIELDED: Cell<bool> = const { Cell::new(false) };
+}
+
+/// Whether the current thread is a worker of some [`PoolSpawner`].
+///
+/// Work that would fan out onto threads of its own can check this and stay
+/// serial instead: the pool already keeps every core busy.
+pub fn on_worker() -> bool {
+    WORKER.with(|w| w.get().is_some())
+}
+
+impl Shared {
+    fn id(self: &Arc<Self>) -> usize {
+        Arc::as_ptr(self) as usize
+    }
+
+    /// The index of the current thread's worker, if it belongs to this pool.
+    fn local_index(self: &Arc<Self>) -> Option<usize> {
+        WORKER
+            .with(|w| w.get())
+            .filter(|&(id, _)| id == self.id())
+            .map(|(_, i)| i)
+    }
+
+    fn push(self: &Arc<Self>, task: Arc<Task>, to_injector: bool) {
+        // Counted before it is visible, so `pop` never takes it below zero.
+        // SeqCst pairs with the sleeper's increment-then-check in `park`:
+        // either the worker sees the task or this thread sees the sleeper.
+        self.queued.fetch_add(1, Ordering::SeqCst);
+        match self.local_index() {
+            Some(i) if !to_injector => self.locals[i].lock().unwrap().push_back(task),
+            _ => self.injector.lock().unwrap().push_back(task),
+        }
+        if self.sleepers.load(Ordering::SeqCst) > 0 {
+            let _guard = self.sleep.lock().unwrap();
+            self.wake.notify_one();
+        }
+    }
+
+    fn pop(&self, index: usize) -> Option<Arc<Task>> {
+        let task = self.locals[index]
+            .lock()
+            .unwrap()
+            .pop_back()
+            .or_else(|| self.injector.lock().unwrap().pop_front())
+            .or_else(|| {
+                let n = self.locals.len();
+                (1..n).find_map(|d| self.locals[(index + d) % n].lock().unwrap().pop_front())
+            })?;
+        self.queued.fetch_sub(1, Ordering::SeqCst);
+        Some(task)
+    }
+
+    fn park(&self) {
+        let guard = self.sleep.lock().unwrap();
+        self.sleepers.fetch_add(1, Ordering::SeqCst);
+        let _guard = self
+            .wake
+            .wait_while(guard, |_| {
+                self.queued.load(Ordering::SeqCst) == 0 && !self.shutdown.load(Ordering::SeqCst)
+            })
+            .unwrap();
+        self.sleepers.fetch_sub(1, Ordering::SeqCst);
+    }
+
+    fn run_worker(self: Arc<Self>, index: usize) {
+        WORKER.with(|w| w.set(Some((self.id(), index))));
+        while !self.shutdown.load(Ordering::SeqCst) {
+            match self.pop(index) {
+                Some(task) => self.run(task),
+                None => self.park(),
+            }
+        }
+        // Break the task → shared → queue cycle for tasks left behind.
+        self.injector.lock().unwrap().clear();
+        self.locals[index].lock().unwrap().clear();
+    }
+
+    fn run(self: &Arc<Self>, task: Arc<Task>) {
+        task.state.store(RUNNING, Ordering::Release);
+        let mut slot = task.future.lock().unwrap();
+        let Some(future) = slot.as_mut() else {
+            return;
+        };
+        // A job cancelled before it started is dropped unpolled. Once it
+        // has run it may hold in-flight store entries, so from then on
+        // it winds down through its own `is_cancelled` checks.
+        let cancel = task.cancel.lock().unwrap().take();
+        if cancel.is_some_and(|c| c.is_cancelled()) {
+            *slot = None;
+            task.state.store(DONE, Ordering::Release);
+            return;
+        }
+        let waker = waker_ref(&task);
+        let mut cx = Context::from_waker(&waker);
+        YIELDED.with(|y| y.set(false));
+        if future.as_mut().poll(&mut cx).is_ready() {
+            *slot = None;
+            task.state.store(DONE, Ordering::Release);
+            return;
+        }
+        drop(slot);
+        if task
+            .state
+            .compare_exchange(RUNNING, IDLE, Ordering::AcqRel, Ordering::Acquire)
+            .is_err()
+        {
+            // Woken during the poll (NOTIFIED): requeue it ourselves.
+            task.state.store(SCHEDULED, Ordering::Release);
+            let yielded = YIELDED.with(|y| y.replace(false));
+            self.push(task, yielded);
+        }
+    }
+}
+
+/// Resolves on its second poll, after going round the pool's queue once.
+struct YieldNow {
+    yielded: bool,
+}
+
+impl Future for YieldNow {
+    type Output = ();
+
+    fn poll(mut self: Pin<&mut Self>, cx: &mut Context<'_>) -> Poll<()> {
+        if self.yielded {
+            return Poll::Ready(());
+        }
+        self.yielded = true;
+        YIELDED.with(|y| y.set(true));
+        cx.waker().wake_by_ref();
+        Poll::Pending
+    }
+}
+
+// ── PoolSpawner ──────────────────────────────────────────────────────
+
+/// A [`Spawner`] backed by a fixed work-stealing thread pool.
+///
+/// Futures spawned on the pool run on its worker threads; independent
+/// fetchers requested together via
+/// [`FetchContext::request_dependencies`](crate::FetchContext::request_dependencies)
+/// run in parallel. Dropping the spawner stops the workers once their
+/// current task returns.
+pub struct PoolSpawner {
+    shared: Arc<Shared>,
+}
+
+impl PoolSpawner {
+    /// Start a pool with `threads` workers (at least one).
+    pub fn new(threads: usize) -> Self {
+        let threads = threads.max(1);
+        let shared = Arc::new(Shared {
+            injector: Mutex::new(VecDeque::new()),
+            locals: (0..threads).map(|_| Mutex::new(VecDeque::new())).collect(),
+            queued: AtomicUsize::new(0),
+            sleepers: AtomicUsize::new(0),
+            sleep: Mutex::new(()),
+            wake: Condvar::new(),
+            shutdown: AtomicBool::new(false),
+        });
+        for index in 0..threads {
+            let shared = Arc::clone(&shared);
+            std::thread::Builder::new()
+                .name(format!("kaubo-dag-{index}"))
+                .spawn(move || shared.run_worker(index))
+                .expect("failed to spawn pool worker");
+        }
+        PoolSpawner { shared }
+    }
+
+    /// A pool sized to the machine's available parallelism.
+    pub fn with_available_parallelism() -> Self {
+        Self::new(std::thread::available_parallelism().map_or(1, |n| n.get()))
+    }
+
+    /// The process-wide pool, started on first use and sized to the
+    /// machine's available parallelism.
+    pub fn global() -> Arc<PoolSpawner> {
+        static GLOBAL: OnceLock<Arc<PoolSpawner>> = OnceLock::new();
+        GLOBAL
+            .get_or_init(|| Arc::new(PoolSpawner::with_available_parallelism()))
+            .clone()
+    }
+
+    /// Number of worker threads.
+    pub fn threads(&self) -> usize {
+        self.shared.locals.len()
+    }
+}
+
+impl std::fmt::Debug for PoolSpawner {
+    fn fmt(&self, f: &mut std::fmt::Formatter<'_>) -> std::fmt::Result {
+        f.debug_struct("PoolSpawner")
+            .field("threads", &self.threads())
+            .finish()
+    }
+}
+
+impl Drop for PoolSpawner {
+    fn drop(&mut self) {
+        self.shared.shutdown.store(true, Ordering::SeqCst);
+        let _guard = self.shared.sleep.lock().unwrap();
+        self.shared.wake.notify_all();
+    }
+}
+
+impl PoolSpawner {
+    fn submit(&self, future: BoxFuture, cancel: Option<CancellationToken>) {
+        let task = Arc::new(Task {
+            future: Mutex::new(Some(future)),
+            cancel: Mutex::new(cancel),
+            state: AtomicU8::new(SCHEDULED),
+            shared: Arc::clone(&self.shared),
+        });
+        self.shared.push(task, false);
+    }
+}
+
+impl Spawner for PoolSpawner {
+    fn spawn(&self, future: Pin<Box<dyn Future<Output = ()> + Send>>) {
+        self.submit(future, None);
+    }
+
+    /// Queues the job like [`spawn`](Spawner::spawn); if `cancel` fires
+    /// before a worker picks the job up, the future is dropped unpolled.
+    fn spawn_cancellable(
+        &self,
+        future: Pin<Box<dyn Future<Output = ()> + Send>>,
+        cancel: CancellationToken,
+    ) {
+        self.submit(future, Some(cancel));
+    }
+
+    fn yield_now(&self) -> Pin<Box<dyn Future<Output = ()> + Send>> {
+        Box::pin(YieldNow { yielded: false })
+    }
+
+    fn cancellation_token(&self) -> CancellationToken {
+        CancellationToken::new()
+    }
+}
+
+impl BlockingSpawner for PoolSpawner {
+    /// Blocks the calling thread, which should not be one of the pool's
+    /// workers; work the future spawns still runs on the pool.
+    fn block_on<F: Future>(&self, future: F) -> F::Output {
+        futures::executor::block_on(future)
+    }
+}
+
+// ── Tests ────────────────────────────────────────────────────────────
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use futures::channel::oneshot;
+    use std::time::{Duration, Instant};
+
+    #[test]
+    fn spawned_futures_run_on_all_workers() {
+        // Each task waits until all four have started, which only happens
+        // if four workers are running them at once.
+        let pool = PoolSpawner::new(4);
+        let arrived = Arc::new(AtomicUsize::new(0));
+        let mut done = Vec::new();
+        for _ in 0..4 {
+            let (tx, rx) = oneshot::channel();
+            let arrived = arrived.clone();
+            pool.spawn(Box::pin(async move {
+                arrived.fetch_add(1, Ordering::SeqCst);
+                let deadline = Instant::now() + Duration::from_secs(10);
+                while arrived.load(Ordering::SeqCst) < 4 && Instant::now() < deadline {
+                    std::thread::yield_now();
+                }
+                let _ = tx.send(arrived.load(Ordering::SeqCst));
+            }));
+            done.push(rx);
+        }
+        let seen = pool.block_on(futures::future::join_all(done));
+        assert!(
+            seen.iter().all(|n| *n == Ok(4)),
+            "tasks never overlapped: {seen:?}"
+        );
+    }
+
+    #[test]
+    fn waiting_tasks_do_not_hold_a_worker() {
+        // One worker: the waiter must park without blocking the thread the
+        // producer needs.
+        let pool = PoolSpawner::new(1);
+        let (tx, rx) = oneshot::channel::<i64>();
+        let (out_tx, out_rx) = oneshot::channel();
+        pool.spawn(Box::pin(async move {
+            let _ = out_tx.send(rx.await.unwrap() + 1);
+        }));
+        pool.spawn(Box::pin(async move {
+            let _ = tx.send(41);
+        }));
+        assert_eq!(pool.block_on(out_rx).unwrap(), 42);
+    }
+
+    #[test]
+    fn on_worker_is_set_only_on_pool_threads() {
+        let pool = PoolSpawner::new(1);
+        let (tx, rx) = oneshot::channel();
+        pool.spawn(Box::pin(async move {
+            let _ = tx.send(on_worker());
+        }));
+        assert!(pool.block_on(rx).unwrap());
+        assert!(!on_worker());
+    }
+
+    #[test]
+    fn yield_now_lets_queued_tasks_run_first() {
+        let pool = Arc::new(PoolSpawner::new(1));
+        let order = Arc::new(Mutex::new(Vec::new()));
+        let (gate_tx, gate_rx) = oneshot::channel::<()>();
+        let (done_tx, done_rx) = oneshot::channel();
+        let (p, o) = (pool.clone(), order.clone());
+        pool.spawn(Box::pin(async move {
+            let _ = gate_rx.await;
+            o.lock().unwrap().push("a1");
+            let o2 = o.clone();
+            p.spawn(Box::pin(async move {
+                o2.lock().unwrap().push("b");
+            }));
+            p.yield_now().await;
+            o.lock().unwrap().push("a2");
+            let _ = done_tx.send(());
+        }));
+        let _ = gate_tx.send(());
+        pool.block_on(done_rx).unwrap();
+        assert_eq!(*order.lock().unwrap(), vec!["a1", "b", "a2"]);
+    }
+
+    #[test]
+    fn cancelled_jobs_are_dropped_before_they_start() {
+        let pool = PoolSpawner::new(1);
+        let ran = Arc::new(AtomicBool::new(false));
+        let token = pool.cancellation_token();
+        token.cancel();
+        let (tx, rx) = oneshot::channel::<()>();
+        let r = ran.clone();
+        pool.spawn_cancellable(
+            Box::pin(async move {
+                r.store(true, Ordering::SeqCst);
+                let _ = tx.send(());
+            }),
+            token.child(),
+        );
+        // The dropped future drops its sender.
+        assert!(pool.block_on(rx).is_err());
+        assert!(!ran.load(Ordering::SeqCst));
+    }
+
+    #[test]
+    fn started_jobs_run_to_completion_after_cancel() {
+        let pool = PoolSpawner::new(1);
+        let token = pool.cancellation_token();
+        let (started_tx, started_rx) = oneshot::channel::<()>();
+        let (gate_tx, gate_rx) = oneshot::channel::<()>();
+        let (done_tx, done_rx) = oneshot::channel();
+        let t = token.child();
+        pool.spawn_cancellable(
+            Box::pin(async move {
+                let _ = started_tx.send(());
+                let _ = gate_rx.await;
+                let _ = done_tx.send(t.is_cancelled());
+            }),
+            token.child(),
+        );
+        pool.block_on(started_rx).unwrap();
+        token.cancel();
+        let _ = gate_tx.send(());
+        assert_eq!(pool.block_on(done_rx), Ok(true));
+    }
+
+    #[test]
+    fn pool_spawner_is_send_sync() {
+        fn assert_send_sync<T: Send + Sync>() {}
+        assert_send_sync::<PoolSpawner>();
+        assert!(PoolSpawner::global().threads() >= 1);
+    }
+}
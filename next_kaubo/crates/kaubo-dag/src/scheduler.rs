@@ -10,6 +10,7 @@ use crate::builder::{Builder, BuilderEvent};
 use crate::cancel::CancellationToken;
 use crate::error::DagError;
 use crate::fetcher::{FetchContext, ProgressEvent, ResultEvent};
+use crate::persist::PersistentCache;
 use crate::registry::FetcherRegistry;
 use crate::spawner::Spawner;
 use crate::store::ArtifactStore;
@@ -20,7 +21,7 @@ use std::collections::HashSet;
 use std::fmt;
 use std::future::Future;
 use std::pin::Pin;
-use std::sync::Arc;
+use std::sync::{Arc, OnceLock};
 use std::task::{Context, Poll};
 
 // ── DagScheduler ─────────────────────────────────────────────────────
@@ -53,6 +54,10 @@ where
 
     /// Platform spawner for background work.
     spawner: Arc<dyn Spawner>,
+
+    /// Optional persistent tier under the ready cache, consulted by
+    /// fetchers that can content-address their output.
+    persistent: OnceLock<Arc<dyn PersistentCache>>,
 }
 
 impl<M> DagScheduler<M>
@@ -68,6 +73,7 @@ where
             store: ArtifactStore::new(),
             registry: Arc::new(registry),
             spawner,
+            persistent: OnceLock::new(),
         })
     }
 
@@ -110,7 +116,7 @@ where
         };
 
         // Spawn the builder execution as a background task
-        self.spawner.spawn(Box::pin(async move {
+        let job = Box::pin(async move {
             // Resolve all declared dependencies first
             let mut inputs: Vec<Artifact<M>> = Vec::new();
             for dep_key in builder.dependencies() {
@@ -126,7 +132,8 @@ where
             // Execute the builder and send the result
             let result = builder.build(inputs, &mut ctx).await;
             let _ = done_tx.send(result);
-        }));
+        });
+        self.spawner.spawn_cancellable(job, cancel.child());
 
         BuildStream {
             done_rx,
@@ -187,6 +194,12 @@ where
                 }
             }
 
+            // A cancelled build starts no new fetchers; waiters hear why
+            if cancel_fetcher.is_cancelled() {
+                scheduler.store.complete(&key, Err(DagError::Cancelled));
+                return Err(DagError::Cancelled);
+            }
+
             // Emit started event
             let _ = progress_tx.unbounded_send(ProgressEvent::Started {
                 key: key.clone(),
@@ -213,9 +226,11 @@ where
                 result_tx: result_tx.clone(),
             };
 
-            // Resolve declared dependencies
+            // Resolve declared dependencies, recording each edge so that
+            // invalidating a dependency also evicts this artifact
             let mut inputs = Vec::new();
             for dep_key in fetcher.dependencies() {
+                scheduler.store.add_dependent(key.clone(), dep_key.clone());
                 match ctx.request_dependency(dep_key).await {
                     Ok(artifact) => inputs.push(artifact),
                     Err(e) => {
@@ -275,6 +290,34 @@ where
         self.store.put_ready(artifact);
     }
 
+    /// Evict `key` and its transitive dependents from the ready cache.
+    ///
+    /// Call before re-seeding an input (e.g. new source text): the input
+    /// itself is evicted too, and the next build recomputes everything
+    /// derived from it. Returns the visited keys.
+    pub fn invalidate(&self, key: &ArtifactKey<M>) -> Vec<ArtifactKey<M>> {
+        self.store.invalidate(key)
+    }
+
+    /// Access the artifact store, for callers that cache artifacts they
+    /// compute outside a fetcher and track their dependencies themselves.
+    pub fn store(&self) -> &ArtifactStore<M> {
+        &self.store
+    }
+
+    /// Attach a persistent tier. Fetchers see it through
+    /// [`FetchContext::persistent_cache`]; the scheduler itself never reads
+    /// it. Returns `false` (and keeps the existing tier) if one is already
+    /// attached.
+    pub fn set_persistent_cache(&self, cache: Arc<dyn PersistentCache>) -> bool {
+        self.persistent.set(cache).is_ok()
+    }
+
+    /// The attached persistent tier, if any.
+    pub fn persistent_cache(&self) -> Option<&Arc<dyn PersistentCache>> {
+        self.persistent.get()
+    }
+
     /// Mark a streaming artifact as complete. Moves it from InFlight to
     /// Ready cache and wakes all tasks waiting on it.
     pub fn notify_final(
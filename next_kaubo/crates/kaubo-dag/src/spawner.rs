@@ -4,8 +4,8 @@
 //! Native environments use a thread pool; WASM uses
 //! `wasm_bindgen_futures::spawn_local`.
 //!
-//! Phase 1 defines only the trait. Concrete implementations live in
-//! `kaubo-driver` (native) and `kaubo-wasm` (WASM, Phase 2).
+//! Native builds also get [`PoolSpawner`](crate::PoolSpawner), a
+//! work-stealing pool that runs independent fetchers in parallel.
 
 use crate::cancel::CancellationToken;
 use std::future::Future;
@@ -15,12 +15,13 @@ use std::pin::Pin;
 ///
 /// # Design
 ///
-/// The trait is deliberately minimal. The scheduler only needs three
+/// The trait is deliberately minimal. The scheduler only needs these
 /// capabilities from the runtime:
 ///
 /// | Method | Purpose |
 /// |--------|---------|
 /// | [`spawn`](Spawner::spawn) | Run a background future to completion |
+/// | [`spawn_cancellable`](Spawner::spawn_cancellable) | Run a build's job, skipping it once the build is cancelled |
 /// | [`yield_now`](Spawner::yield_now) | Yield execution to let other tasks progress |
 /// | [`cancellation_token`](Spawner::cancellation_token) | Create a cancellation token |
 ///
@@ -32,12 +33,26 @@ use std::pin::Pin;
 pub trait Spawner: Send + Sync {
     /// Spawn a background future.
     ///
-    /// The spawned future runs to completion independently. Cancellation
-    /// is cooperatively checked via the [`CancellationToken`] passed
-    /// through [`FetchContext`](crate::FetchContext) — the `Spawner` does
-    /// not own cancellation logic.
+    /// The spawned future runs to completion independently. Once running,
+    /// cancellation is cooperatively checked via the [`CancellationToken`]
+    /// passed through [`FetchContext`](crate::FetchContext).
     fn spawn(&self, future: Pin<Box<dyn Future<Output = ()> + Send>>);
 
+    /// Spawn a job that belongs to the build owning `cancel`.
+    ///
+    /// A spawner with a job queue may drop the future without polling it
+    /// if `cancel` fires before the job starts; a started job always runs
+    /// to completion. The default ignores the token and calls
+    /// [`spawn`](Spawner::spawn).
+    fn spawn_cancellable(
+        &self,
+        future: Pin<Box<dyn Future<Output = ()> + Send>>,
+        cancel: CancellationToken,
+    ) {
+        let _ = cancel;
+        self.spawn(future);
+    }
+
     /// Yield the current task's execution slot so that other ready tasks
     /// can make progress.
     ///
@@ -16,7 +16,7 @@
 //! - **InFlight Map**: `Mutex<HashMap>` — writes are rare (once per key per
 //!   build). The Mutex is held briefly during registration/waiter setup.
 //! - **Reverse Deps**: `Mutex<HashMap>` — populated during graph expansion,
-//!   read during invalidation (Phase 2).
+//!   read during invalidation.
 
 use crate::cancel::CancellationToken;
 use crate::error::DagError;
@@ -54,7 +54,7 @@ where
 /// 2. **InFlight tracking** — computations in progress, for deduplication and
 ///    waiter registration.
 /// 3. **Reverse Dependents** — dependency index for cache invalidation
-///    propagation (Phase 2).
+///    propagation.
 pub struct ArtifactStore<M>
 where
     M: Eq + std::hash::Hash + Clone + fmt::Debug + fmt::Display,
@@ -66,7 +66,7 @@ where
     in_flight: Mutex<HashMap<ArtifactKey<M>, InFlightEntry<M>>>,
 
     /// Reverse dependency index: for each key, the set of keys that
-    /// depend on it. Used for cache invalidation (Phase 2).
+    /// depend on it. Used for cache invalidation.
     reverse_deps: Mutex<HashMap<ArtifactKey<M>, HashSet<ArtifactKey<M>>>>,
 }
 
@@ -104,7 +104,6 @@ where
     }
 
     /// Remove an artifact from the ready cache (for invalidation).
-    #[allow(dead_code)] // Phase 2: used by invalidate()
     pub fn remove_ready(&self, key: &ArtifactKey<M>) -> Option<Artifact<M>> {
         self.ready.remove(key).map(|(_, artifact)| artifact)
     }
@@ -120,8 +119,18 @@ where
         deps.entry(dependency).or_default().insert(dependent);
     }
 
+    /// Drop a dependency edge registered with [`add_dependent`](Self::add_dependent).
+    pub fn remove_dependent(&self, dependent: &ArtifactKey<M>, dependency: &ArtifactKey<M>) {
+        let mut deps = self.reverse_deps.lock().unwrap();
+        if let Some(set) = deps.get_mut(dependency) {
+            set.remove(dependent);
+            if set.is_empty() {
+                deps.remove(dependency);
+            }
+        }
+    }
+
     /// Get all keys that directly depend on `key`.
-    #[allow(dead_code)] // Phase 2: used by invalidate()
     pub fn get_dependents(&self, key: &ArtifactKey<M>) -> Vec<ArtifactKey<M>> {
         let deps = self.reverse_deps.lock().unwrap();
         deps.get(key)
@@ -129,6 +138,31 @@ where
             .unwrap_or_default()
     }
 
+    /// Evict `key` and everything that transitively depends on it from the
+    /// ready cache, so the next request recomputes them.
+    ///
+    /// Returns every key that was visited (including `key`), whether or not
+    /// it was cached. Edges are kept: a recomputed artifact usually has the
+    /// same dependencies, and callers that know otherwise remove them with
+    /// [`remove_dependent`](Self::remove_dependent).
+    pub fn invalidate(&self, key: &ArtifactKey<M>) -> Vec<ArtifactKey<M>> {
+        let deps = self.reverse_deps.lock().unwrap();
+        let mut seen: HashSet<ArtifactKey<M>> = HashSet::new();
+        let mut stack = vec![key.clone()];
+        let mut visited = Vec::new();
+        while let Some(k) = stack.pop() {
+            if !seen.insert(k.clone()) {
+                continue;
+            }
+            if let Some(dependents) = deps.get(&k) {
+                stack.extend(dependents.iter().filter(|d| !seen.contains(*d)).cloned());
+            }
+            self.ready.remove(&k);
+            visited.push(k);
+        }
+        visited
+    }
+
     // ── InFlight ─────────────────────────────────────────────────
 
     /// Check whether a key is currently being computed.
@@ -410,6 +444,31 @@ mod tests {
         assert_eq!(deps, vec![parent]);
     }
 
+    #[test]
+    fn invalidate_evicts_transitive_dependents_only() {
+        let store = ArtifactStore::<M>::new();
+        let src = key("a", "Source");
+        let ast = key("a", "Ast");
+        let sem = key("a", "Semantic");
+        let other = key("b", "Ast");
+        for k in [&src, &ast, &sem, &other] {
+            store.put_ready(Artifact::new(k.module_id.clone(), k.kind.clone(), 0i64));
+        }
+        store.add_dependent(ast.clone(), src.clone());
+        store.add_dependent(sem.clone(), ast.clone());
+
+        let mut visited = store.invalidate(&src);
+        visited.sort_by_key(|k| k.kind.to_string());
+        assert_eq!(visited, vec![ast.clone(), sem.clone(), src.clone()]);
+        assert!(!store.has_ready(&sem));
+        assert!(store.has_ready(&other));
+
+        store.remove_dependent(&sem, &ast);
+        store.put_ready(Artifact::new("a".to_string(), Kind::new("Semantic"), 1i64));
+        store.invalidate(&ast);
+        assert!(store.has_ready(&sem));
+    }
+
     #[test]
     fn ready_count_tracks_entries() {
         let store = ArtifactStore::<M>::new();
@@ -195,6 +195,17 @@ impl<M> Artifact<M> {
         }
     }
 
+    /// Create a final artifact around data the caller also keeps a handle
+    /// to; the store shares it instead of taking a copy.
+    pub fn shared<T: Send + Sync + 'static>(module_id: M, kind: Kind, data: Arc<T>) -> Self {
+        Artifact {
+            key: ArtifactKey { module_id, kind },
+            hash: ContentHash::placeholder(),
+            is_final: true,
+            data,
+        }
+    }
+
     /// Create an artifact with an explicit key and hash.
     pub fn with_key<T: Send + Sync + 'static>(
         key: ArtifactKey<M>,
@@ -310,6 +321,14 @@ mod tests {
         assert!(Arc::ptr_eq(&a.data, &b.data));
     }
 
+    #[test]
+    fn shared_artifact_keeps_callers_arc() {
+        let data = Arc::new(vec![1, 2, 3]);
+        let a = Artifact::shared("mod".to_string(), Kind::new(Kind::AST), Arc::clone(&data));
+        assert_eq!(a.downcast_ref::<Vec<i32>>(), &[1, 2, 3]);
+        assert_eq!(Arc::strong_count(&data), 2);
+    }
+
     #[test]
     fn content_hash_different_data_different_hash() {
         let h1 = ContentHash::from_bytes(b"hello");
@@ -585,3 +585,213 @@ fn streaming_artifact_cached_after_finalize() {
     assert_eq!(r2.unwrap(), 42);
     assert_eq!(*counter.lock().unwrap(), 1);
 }
+
+/// Re-seeding an input and invalidating it evicts everything derived from
+/// it; untouched branches stay cached.
+#[test]
+fn invalidate_recomputes_dependents_of_reseeded_input() {
+    let registry = FetcherRegistry::new();
+    registry.register(
+        Kind::new("Double"),
+        Box::new(|output_key| {
+            Box::new(TransformFetcher {
+                key: output_key,
+                dep_key: mkkey("mod", "Source"),
+                transform: |x| x * 2,
+            })
+        }),
+    );
+    let counter = Arc::new(Mutex::new(0u32));
+    let ctr = counter.clone();
+    registry.register(
+        Kind::new("Const"),
+        Box::new(move |output_key| {
+            Box::new(CountingFetcher {
+                key: output_key,
+                value: 1,
+                counter: ctr.clone(),
+            })
+        }),
+    );
+
+    let scheduler = DagScheduler::new(registry, Arc::new(NativeSpawner));
+    let sum = |s: &Arc<DagScheduler<M>>| {
+        let stream = s.build(Box::new(SumBuilder {
+            dep_a: mkkey("mod", "Double"),
+            dep_b: mkkey("mod", "Const"),
+        }));
+        futures::executor::block_on(collect_stream(stream)).unwrap()
+    };
+
+    scheduler.seed_artifact(Artifact::new("mod".to_string(), Kind::new("Source"), 5i64));
+    assert_eq!(sum(&scheduler), 11);
+
+    let evicted = scheduler.invalidate(&mkkey("mod", "Source"));
+    assert!(evicted.contains(&mkkey("mod", "Double")));
+    assert!(!evicted.contains(&mkkey("mod", "Const")));
+
+    scheduler.seed_artifact(Artifact::new("mod".to_string(), Kind::new("Source"), 7i64));
+    assert_eq!(sum(&scheduler), 15);
+    assert_eq!(*counter.lock().unwrap(), 1);
+}
+
+/// A fetcher that sleeps, to make overlapping execution observable.
+struct SlowFetcher {
+    key: ArtifactKey<M>,
+    value: i64,
+}
+
+impl Fetcher<M> for SlowFetcher {
+    fn key(&self) -> ArtifactKey<M> {
+        self.key.clone()
+    }
+
+    fn dependencies(&self) -> Vec<ArtifactKey<M>> {
+        vec![]
+    }
+
+    fn fetch<'a>(
+        &'a self,
+        _inputs: Vec<Artifact<M>>,
+        _ctx: &'a mut FetchContext<M>,
+    ) -> Pin<Box<dyn Future<Output = Result<Artifact<M>, DagError<M>>> + Send + 'a>> {
+        std::thread::sleep(std::time::Duration::from_millis(60));
+        let artifact = Artifact::new(
+            self.key.module_id.clone(),
+            self.key.kind.clone(),
+            self.value,
+        );
+        Box::pin(async move { Ok(artifact) })
+    }
+}
+
+/// A fetcher that requests `Slow` for every listed module at once and sums them.
+struct FanOutFetcher {
+    key: ArtifactKey<M>,
+    modules: Vec<&'static str>,
+}
+
+impl Fetcher<M> for FanOutFetcher {
+    fn key(&self) -> ArtifactKey<M> {
+        self.key.clone()
+    }
+
+    fn dependencies(&self) -> Vec<ArtifactKey<M>> {
+        vec![]
+    }
+
+    fn fetch<'a>(
+        &'a self,
+        _inputs: Vec<Artifact<M>>,
+        ctx: &'a mut FetchContext<M>,
+    ) -> Pin<Box<dyn Future<Output = Result<Artifact<M>, DagError<M>>> + Send + 'a>> {
+        Box::pin(async move {
+            let keys = self.modules.iter().map(|m| mkkey(m, "Slow")).collect();
+            let values = ctx.request_dependencies(keys).await?;
+            let sum: i64 = values.iter().map(|a| *a.downcast_ref::<i64>()).sum();
+            Ok(Artifact::new(
+                self.key.module_id.clone(),
+                self.key.kind.clone(),
+                sum,
+            ))
+        })
+    }
+}
+
+fn fan_out_registry(modules: Vec<&'static str>) -> FetcherRegistry<M> {
+    let registry = FetcherRegistry::<M>::new();
+    registry.register(
+        Kind::new("Slow"),
+        Box::new(|key| {
+            let value = key.module_id.len() as i64;
+            Box::new(SlowFetcher { key, value })
+        }),
+    );
+    registry.register(
+        Kind::new("FanOut"),
+        Box::new(move |key| {
+            Box::new(FanOutFetcher {
+                key,
+                modules: modules.clone(),
+            })
+        }),
+    );
+    registry
+}
+
+#[test]
+fn request_dependencies_runs_independent_fetchers_in_parallel() {
+    let scheduler = DagScheduler::new(
+        fan_out_registry(vec!["a", "bb", "ccc", "dddd"]),
+        Arc::new(PoolSpawner::new(4)),
+    );
+    let t0 = std::time::Instant::now();
+    let r = futures::executor::block_on(collect_stream(scheduler.build(Box::new(
+        SingleDepBuilder {
+            dep_key: mkkey("mod", "FanOut"),
+        },
+    ))));
+    assert_eq!(r.unwrap(), 10);
+    // Four 60ms fetchers; serially this takes at least 240ms
+    assert!(
+        t0.elapsed() < std::time::Duration::from_millis(200),
+        "{:?}",
+        t0.elapsed()
+    );
+}
+
+#[test]
+fn request_dependencies_dedups_shared_keys_and_keeps_order() {
+    let scheduler = DagScheduler::new(
+        fan_out_registry(vec!["a", "bb", "a"]),
+        Arc::new(PoolSpawner::new(2)),
+    );
+    let r = futures::executor::block_on(collect_stream(scheduler.build(Box::new(
+        SingleDepBuilder {
+            dep_key: mkkey("mod", "FanOut"),
+        },
+    ))));
+    assert_eq!(r.unwrap(), 4);
+    // "a" computed once; SyncSpawner runs the same requests inline
+    let inline = DagScheduler::new(
+        fan_out_registry(vec!["a", "bb", "a"]),
+        Arc::new(SyncSpawner),
+    );
+    let r = futures::executor::block_on(collect_stream(inline.build(Box::new(SingleDepBuilder {
+        dep_key: mkkey("mod", "FanOut"),
+    }))));
+    assert_eq!(r.unwrap(), 4);
+}
+
+#[test]
+fn request_dependencies_reports_missing_fetchers() {
+    let registry = fan_out_registry(vec![]);
+    struct BadFanOut;
+    impl Fetcher<M> for BadFanOut {
+        fn key(&self) -> ArtifactKey<M> {
+            mkkey("mod", "Mixed")
+        }
+        fn dependencies(&self) -> Vec<ArtifactKey<M>> {
+            vec![]
+        }
+        fn fetch<'a>(
+            &'a self,
+            _inputs: Vec<Artifact<M>>,
+            ctx: &'a mut FetchContext<M>,
+        ) -> Pin<Box<dyn Future<Output = Result<Artifact<M>, DagError<M>>> + Send + 'a>> {
+            Box::pin(async move {
+                ctx.request_dependencies(vec![mkkey("a", "Slow"), mkkey("a", "Missing")])
+                    .await?;
+                Ok(Artifact::new("mod".to_string(), Kind::new("Mixed"), 0i64))
+            })
+        }
+    }
+    registry.register(Kind::new("Mixed"), Box::new(|_| Box::new(BadFanOut)));
+    let scheduler = DagScheduler::new(registry, Arc::new(PoolSpawner::new(2)));
+    let r = futures::executor::block_on(collect_stream(scheduler.build(Box::new(
+        SingleDepBuilder {
+            dep_key: mkkey("mod", "Mixed"),
+        },
+    ))));
+    assert!(matches!(r, Err(DagError::NoFetcherForKind(k)) if k == "Missing"));
+}
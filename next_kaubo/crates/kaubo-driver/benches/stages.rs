@@ -0,0 +1,510 @@
+//! 分阶段基准：在进程内跑 `ops/benchmark/suites/` 的 `.kb` 用例，把编译管线
+//! 拆开逐段计时，同时统计每段的堆分配。
+//!
+//! 单文件用例的阶段：`lex` → `parse` → `infer` → `cps_build` → `flatten` →
+//! 标准流水线的每个 pass（`pass:<name>`，单线程）→ `encode` / `decode`
+//! （`kaubo_ir::binary`）→ `vm_load` → `vm_execute`。多文件用例（`module_*`）
+//! 没有单独的前端阶段，测 `module_graph` 和整个 `compile_file`，后面相同。
+//!
+//! 每段先预热 `--warmup` 次，再测 `--iters` 次；报告耗时分布（min / 中位数 /
+//! p90 / max / 均值），以及中位数的分配次数、分配字节和峰值堆增量（相对该段
+//! 开始时的存活字节）。计数来自本进程的全局分配器，每段的输入在计数清零前
+//! 准备好，不算在内。
+//!
+//! ```text
+//! cargo bench -p kaubo-driver --bench stages -- [--suite fib,loop]
+//!     [--iters 10] [--warmup 3] [--json out.json]
+//!     [--baseline base.json] [--threshold 10] [--min-us 20]
+//! ```
+//!
+//! `--baseline` 与之前 `--json` 写出的结果比较：中位耗时、分配次数、分配字节
+//! 或峰值任何一项超出基线 `--threshold` 百分比即为回归，进程以 1 退出。
+//! 基线中位耗时低于 `--min-us` 的阶段只比分配，不比时间——微秒级的计时抖动
+//! 比阈值大。
+
+use kaubo_driver::module_graph::ModuleGraph;
+use kaubo_driver::module_loader::MemLoader;
+use kaubo_driver::{DagCoordinator, LoadedProgram};
+use kaubo_ir::cps::CpsModule;
+use kaubo_syntax::lexer::Lexer;
+use kaubo_syntax::parser::Parser;
+use kaubo_vm::VM;
+use serde_json::{json, Value};
+use std::alloc::{GlobalAlloc, Layout, System};
+use std::path::{Path, PathBuf};
+use std::process::ExitCode;
+use std::sync::atomic::{AtomicU64, Ordering};
+use std::sync::Arc;
+use std::time::Instant;
+
+// ── 计数分配器 ──
+
+/// 包装 `System`，记录分配次数、分配字节、存活字节和存活峰值。
+struct Counting;
+
+static ALLOCS: AtomicU64 = AtomicU64::new(0);
+static BYTES: AtomicU64 = AtomicU64::new(0);
+static LIVE: AtomicU64 = AtomicU64::new(0);
+static PEAK: AtomicU64 = AtomicU64::new(0);
+
+impl Counting {
+    fn grow(size: usize) {
+        ALLOCS.fetch_add(1, Ordering::Relaxed);
+        BYTES.fetch_add(size as u64, Ordering::Relaxed);
+        let live = LIVE.fetch_add(size as u64, Ordering::Relaxed) + size as u64;
+        PEAK.fetch_max(live, Ordering::Relaxed);
+    }
+
+    fn shrink(size: usize) {
+        LIVE.fetch_sub(size as u64, Ordering::Relaxed);
+    }
+}
+
+// SAFETY: 所有分配都转交给 `System`，这里只记账
+unsafe impl GlobalAlloc for Counting {
+    unsafe fn alloc(&self, layout: Layout) -> *mut u8 {
+        let ptr = System.alloc(layout);
+        if !ptr.is_null() {
+            Self::grow(layout.size());
+        }
+        ptr
+    }
+
+    unsafe fn alloc_zeroed(&self, layout: Layout) -> *mut u8 {
+        let ptr = System.alloc_zeroed(layout);
+        if !ptr.is_null() {
+            Self::grow(layout.size());
+        }
+        ptr
+    }
+
+    unsafe fn dealloc(&self, ptr: *mut u8, layout: Layout) {
+        System.dealloc(ptr, layout);
+        Self::shrink(layout.size());
+    }
+
+    /// realloc 记作一次新分配（字节按新大小计）加一次释放。
+    unsafe fn realloc(&self, ptr: *mut u8, layout: Layout, new_size: usize) -> *mut u8 {
+        let new = System.realloc(ptr, layout, new_size);
+        if !new.is_null() {
+            Self::shrink(layout.size());
+            Self::grow(new_size);
+        }
+        new
+    }
+}
+
+#[global_allocator]
+static GLOBAL: Counting = Counting;
+
+// ── 采样 ──
+
+/// 一次执行的耗时与分配。
+#[derive(Clone, Copy)]
+struct Sample {
+    ns: u64,
+    allocs: u64,
+    bytes: u64,
+    peak: u64,
+}
+
+/// 计时并统计 `run` 的分配；`run` 的返回值在统计结束后才释放。
+fn sample<T>(run: impl FnOnce() -> T) -> Sample {
+    let (allocs, bytes) = (
+        ALLOCS.load(Ordering::Relaxed),
+        BYTES.load(Ordering::Relaxed),
+    );
+    let live = LIVE.load(Ordering::Relaxed);
+    PEAK.store(live, Ordering::Relaxed);
+    let start = Instant::now();
+    let out = run();
+    let ns = start.elapsed().as_nanos() as u64;
+    let s = Sample {
+        ns,
+        allocs: ALLOCS.load(Ordering::Relaxed) - allocs,
+        bytes: BYTES.load(Ordering::Relaxed) - bytes,
+        peak: PEAK.load(Ordering::Relaxed).saturating_sub(live),
+    };
+    drop(out);
+    s
+}
+
+/// 一个阶段的全部采样。
+struct StageResult {
+    name: String,
+    samples: Vec<Sample>,
+}
+
+impl StageResult {
+    fn sorted(&self, f: impl Fn(&Sample) -> u64) -> Vec<u64> {
+        let mut v: Vec<u64> = self.samples.iter().map(f).collect();
+        v.sort_unstable();
+        v
+    }
+
+    fn median(&self, f: impl Fn(&Sample) -> u64) -> u64 {
+        let v = self.sorted(f);
+        v[v.len() / 2]
+    }
+
+    fn to_json(&self) -> Value {
+        let ns = self.sorted(|s| s.ns);
+        // 最近秩法：第 ceil(0.9 n) 个
+        let p90 = ns[(ns.len() * 9).div_ceil(10) - 1];
+        let mean = ns.iter().sum::<u64>() / ns.len() as u64;
+        json!({
+            "stage": self.name,
+            "ns": {
+                "min": ns[0],
+                "median": ns[ns.len() / 2],
+                "p90": p90,
+                "max": ns[ns.len() - 1],
+                "mean": mean,
+            },
+            "allocs": self.median(|s| s.allocs),
+            "bytes": self.median(|s| s.bytes),
+            "peak_bytes": self.median(|s| s.peak),
+        })
+    }
+}
+
+struct Config {
+    iters: usize,
+    warmup: usize,
+}
+
+/// 每次迭代先 `setup` 准备输入（不计），再测 `run`。
+fn stage<I, O>(
+    cfg: &Config,
+    name: impl Into<String>,
+    mut setup: impl FnMut() -> I,
+    mut run: impl FnMut(I) -> O,
+) -> StageResult {
+    for _ in 0..cfg.warmup {
+        let input = setup();
+        drop(run(input));
+    }
+    let samples = (0..cfg.iters)
+        .map(|_| {
+            let input = setup();
+            sample(|| run(input))
+        })
+        .collect();
+    StageResult {
+        name: name.into(),
+        samples,
+    }
+}
+
+// ── 用例 ──
+
+fn suites_dir() -> PathBuf {
+    Path::new(env!("CARGO_MANIFEST_DIR")).join("../../ops/benchmark/suites")
+}
+
+/// 单文件用例：逐段跑到 `CpsModule`。
+fn bench_frontend(
+    cfg: &Config,
+    source: &str,
+    out: &mut Vec<StageResult>,
+) -> Result<CpsModule, String> {
+    out.push(stage(cfg, "lex", || (), |_| Lexer::new(source).tokenize()));
+    out.push(stage(cfg, "parse", || (), |_| Parser::new(source).parse()));
+    let module = Parser::new(source).parse().map_err(|e| e.to_string())?;
+    kaubo_infer::infer_module(&module).map_err(|e| e.msg)?;
+    out.push(stage(
+        cfg,
+        "infer",
+        || (),
+        |_| kaubo_infer::infer_module(&module),
+    ));
+    out.push(stage(
+        cfg,
+        "cps_build",
+        || (),
+        |_| kaubo_ir::cps_build::build_module(&module, None),
+    ));
+
+    let mut cps = kaubo_ir::cps_build::build_module(&module, None)?;
+    let built = cps.clone();
+    out.push(stage(
+        cfg,
+        "flatten",
+        || built.clone(),
+        |mut m| {
+            kaubo_ir::flatten::flatten_module(&mut m);
+            m
+        },
+    ));
+    kaubo_ir::flatten::flatten_module(&mut cps);
+
+    // 单线程，让每个 pass 的计时和分配只反映 pass 本身
+    for pass in DagCoordinator::standard_pipeline().with_threads(1).split() {
+        let input = cps.clone();
+        out.push(stage(
+            cfg,
+            format!("pass:{}", pass.fingerprint()),
+            || input.clone(),
+            |mut m| {
+                pass.run(&mut m, None);
+                m
+            },
+        ));
+        pass.run(&mut cps, None);
+    }
+    Ok(cps)
+}
+
+/// 多文件用例：模块图 + 整个多文件编译。
+fn bench_modules(
+    cfg: &Config,
+    dir: &Path,
+    out: &mut Vec<StageResult>,
+) -> Result<CpsModule, String> {
+    let mut mem = MemLoader::new();
+    for entry in std::fs::read_dir(dir).map_err(|e| e.to_string())? {
+        let path = entry.map_err(|e| e.to_string())?.path();
+        if path.extension().is_some_and(|ext| ext == "kb") {
+            let name = path.file_name().unwrap().to_string_lossy().into_owned();
+            let source = std::fs::read_to_string(&path).map_err(|e| e.to_string())?;
+            mem.insert(&name, &source);
+        }
+    }
+    let loader: Arc<MemLoader> = Arc::new(mem);
+    ModuleGraph::build("main.kb", loader.as_ref()).map_err(|e| e.to_string())?;
+    out.push(stage(
+        cfg,
+        "module_graph",
+        || (),
+        |_| ModuleGraph::build("main.kb", loader.as_ref()),
+    ));
+    out.push(stage(
+        cfg,
+        "compile_file",
+        || loader.clone(),
+        |l| kaubo_driver::compile_file("main.kb", l),
+    ));
+    kaubo_driver::compile_file("main.kb", loader).map_err(|e| e.to_string())
+}
+
+/// 编码 / 解码 / 装载 / 执行，并校验输出与 `expected.txt` 一致。
+fn bench_backend(
+    cfg: &Config,
+    cps: &CpsModule,
+    expected: &str,
+    out: &mut Vec<StageResult>,
+) -> Result<(), String> {
+    let bytes = kaubo_driver::encode_module(cps);
+    out.push(stage(
+        cfg,
+        "encode",
+        || (),
+        |_| kaubo_driver::encode_module(cps),
+    ));
+    out.push(stage(
+        cfg,
+        "decode",
+        || (),
+        |_| kaubo_driver::decode_module(&bytes),
+    ));
+    out.push(stage(cfg, "vm_load", VM::new, |mut vm| {
+        vm.load(cps).map(|_| vm)
+    }));
+
+    let program = Arc::new(LoadedProgram::new(cps)?);
+    let entry = program.entry().ok_or("no entry function")?;
+    let mut vm = VM::with_program(program.clone());
+    vm.execute(entry, 0, None).map_err(|e| format!("{e:?}"))?;
+    let output = vm.take_output().join("\n");
+    if output.trim() != expected.trim() {
+        return Err(format!(
+            "output mismatch: expected {:?}, got {output:?}",
+            expected.trim()
+        ));
+    }
+    out.push(stage(
+        cfg,
+        "vm_execute",
+        || VM::with_program(program.clone()),
+        |mut vm| {
+            let result = vm.execute(entry, 0, None);
+            (vm, result)
+        },
+    ));
+    Ok(())
+}
+
+fn bench_suite(cfg: &Config, dir: &Path) -> Result<Vec<StageResult>, String> {
+    let expected = std::fs::read_to_string(dir.join("expected.txt")).unwrap_or_default();
+    let mut out = Vec::new();
+    let name = dir.file_name().unwrap().to_string_lossy();
+    let cps = if name.starts_with("module_") {
+        bench_modules(cfg, dir, &mut out)?
+    } else {
+        let source = std::fs::read_to_string(dir.join("main.kb")).map_err(|e| e.to_string())?;
+        bench_frontend(cfg, &source, &mut out)?
+    };
+    bench_backend(cfg, &cps, &expected, &mut out)?;
+    Ok(out)
+}
+
+// ── 基线比较 ──
+
+/// 与基线比较，返回回归描述。
+fn regressions(current: &Value, baseline: &Value, threshold: f64, min_ns: u64) -> Vec<String> {
+    let stages = |v: &Value| -> Vec<(String, String, Value)> {
+        let mut out = Vec::new();
+        for suite in v["suites"].as_array().into_iter().flatten() {
+            for st in suite["stages"].as_array().into_iter().flatten() {
+                let (s, n) = (suite["name"].as_str(), st["stage"].as_str());
+                if let (Some(s), Some(n)) = (s, n) {
+                    out.push((s.to_string(), n.to_string(), st.clone()));
+                }
+            }
+        }
+        out
+    };
+    let base = stages(baseline);
+    let mut found = Vec::new();
+    for (suite, name, cur) in stages(current) {
+        let Some((_, _, old)) = base.iter().find(|(s, n, _)| *s == suite && *n == name) else {
+            continue;
+        };
+        let mut metrics = vec![("allocs", &old["allocs"], &cur["allocs"])];
+        metrics.push(("bytes", &old["bytes"], &cur["bytes"]));
+        metrics.push(("peak_bytes", &old["peak_bytes"], &cur["peak_bytes"]));
+        if old["ns"]["median"].as_u64().unwrap_or(0) >= min_ns {
+            metrics.push(("median ns", &old["ns"]["median"], &cur["ns"]["median"]));
+        }
+        for (metric, old, cur) in metrics {
+            let (Some(old), Some(cur)) = (old.as_u64(), cur.as_u64()) else {
+                continue;
+            };
+            if old > 0 && cur as f64 > old as f64 * (1.0 + threshold / 100.0) {
+                let pct = (cur as f64 / old as f64 - 1.0) * 100.0;
+                found.push(format!(
+                    "{suite}/{name}: {metric} {old} -> {cur} (+{pct:.1}%)"
+                ));
+            }
+        }
+    }
+    found
+}
+
+// ── 入口 ──
+
+fn main() -> ExitCode {
+    let mut cfg = Config {
+        iters: 10,
+        warmup: 3,
+    };
+    let (mut suites, mut json_out, mut baseline) =
+        (None::<Vec<String>>, None::<PathBuf>, None::<PathBuf>);
+    let (mut threshold, mut min_us) = (10.0_f64, 20_u64);
+    let mut args = std::env::args().skip(1);
+    while let Some(arg) = args.next() {
+        let mut value = || args.next().unwrap_or_else(|| panic!("{arg} needs a value"));
+        match arg.as_str() {
+            "--suite" => suites = Some(value().split(',').map(str::to_string).collect()),
+            "--iters" => cfg.iters = value().parse().expect("--iters: integer"),
+            "--warmup" => cfg.warmup = value().parse().expect("--warmup: integer"),
+            "--json" => json_out = Some(value().into()),
+            "--baseline" => baseline = Some(value().into()),
+            "--threshold" => threshold = value().parse().expect("--threshold: percent"),
+            "--min-us" => min_us = value().parse().expect("--min-us: integer"),
+            // cargo bench 传给 harness = false 目标的参数
+            "--bench" => {}
+            other => {
+                eprintln!("unknown argument: {other}");
+                return ExitCode::from(2);
+            }
+        }
+    }
+    cfg.iters = cfg.iters.max(1);
+
+    let mut dirs: Vec<PathBuf> = std::fs::read_dir(suites_dir())
+        .expect("benchmark suites directory")
+        .filter_map(|e| e.ok().map(|e| e.path()))
+        .filter(|p| p.join("main.kb").exists())
+        .collect();
+    dirs.sort();
+    if let Some(names) = &suites {
+        dirs.retain(|d| names.iter().any(|n| d.ends_with(n)));
+    }
+
+    println!(
+        "{:<20} {:<22} {:>10} {:>10} {:>9} {:>10} {:>10}",
+        "suite", "stage", "median_us", "p90_us", "allocs", "alloc_kb", "peak_kb"
+    );
+    let mut failed = false;
+    let mut report = Vec::new();
+    for dir in &dirs {
+        let name = dir.file_name().unwrap().to_string_lossy().into_owned();
+        match bench_suite(&cfg, dir) {
+            Ok(results) => {
+                let stages: Vec<Value> = results.iter().map(StageResult::to_json).collect();
+                for st in &stages {
+                    println!(
+                        "{:<20} {:<22} {:>10.1} {:>10.1} {:>9} {:>10.1} {:>10.1}",
+                        name,
+                        st["stage"].as_str().unwrap_or(""),
+                        st["ns"]["median"].as_u64().unwrap_or(0) as f64 / 1000.0,
+                        st["ns"]["p90"].as_u64().unwrap_or(0) as f64 / 1000.0,
+                        st["allocs"].as_u64().unwrap_or(0),
+                        st["bytes"].as_u64().unwrap_or(0) as f64 / 1024.0,
+                        st["peak_bytes"].as_u64().unwrap_or(0) as f64 / 1024.0,
+                    );
+                }
+                report.push(json!({ "name": name, "stages": stages }));
+            }
+            Err(e) => {
+                eprintln!("{name}: {e}");
+                failed = true;
+            }
+        }
+    }
+    let report = json!({
+        "iterations": cfg.iters,
+        "warmup": cfg.warmup,
+        "suites": report,
+    });
+
+    if let Some(path) = &json_out {
+        let text = serde_json::to_string_pretty(&report).unwrap();
+        if let Err(e) = std::fs::write(path, text + "\n") {
+            eprintln!("write {}: {e}", path.display());
+            failed = true;
+        }
+    }
+    if let Some(path) = &baseline {
+        let base = std::fs::read_to_string(path)
+            .map_err(|e| e.to_string())
+            .and_then(|text| serde_json::from_str::<Value>(&text).map_err(|e| e.to_string()));
+        match base {
+            Ok(base) => {
+                let found = regressions(&report, &base, threshold, min_us * 1000);
+                if found.is_empty() {
+                    println!(
+                        "no regressions above {threshold}% against {}",
+                        path.display()
+                    );
+                } else {
+                    eprintln!("{} regression(s) above {threshold}%:", found.len());
+                    for r in &found {
+                        eprintln!("  {r}");
+                    }
+                    failed = true;
+                }
+            }
+            Err(e) => {
+                eprintln!("baseline {}: {e}", path.display());
+                failed = true;
+            }
+        }
+    }
+    if failed {
+        ExitCode::FAILURE
+    } else {
+        ExitCode::SUCCESS
+    }
+}
@@ -0,0 +1,495 @@
+//! Persistent-cache keys and encodings for driver artifacts.
+//!
+//! The DAG scheduler's [`PersistentCache`] stores opaque bytes under a
+//! [`CacheKey`]; this module decides what goes into the key and how driver
+//! artifacts become bytes:
+//!
+//! | Artifact | Key inputs | Encoding |
+//! |----------|-----------|----------|
+//! | single-file `Cps` | compiler version, pipeline, source | `KAUB` binary module |
+//! | per-module `Cps` | compiler version, pipeline, path, source, resolved imports | `KAUB` binary module |
+//! | per-module `ExportTable` | same key as the module's `Cps` | export entries (below) |
+//!
+//! Struct and enum ids in export tables are derived from the defining
+//! module's path and the type's name
+//! ([`TypeIds::for_module`](kaubo_infer::TypeIds::for_module)), so an entry
+//! written by one process unifies correctly with modules inferred by another.
+//!
+//! A module's key covers the *resolved import table* — the types and
+//! indices it actually imports — rather than its dependencies' sources, so
+//! editing a dependency's function bodies leaves importers' entries valid
+//! as long as its exports keep their types.
+//!
+//! Ast and Semantic are not persisted: nothing downstream of a `Cps` hit
+//! needs them, and the multi-file graph already parses every module to
+//! discover imports.
+
+use crate::export_table::{ExportEntry, ExportTable, ImportTable};
+use crate::protocol::Pipeline;
+use kaubo_dag::{CacheKey, Kind, PersistentCache};
+use kaubo_infer::types::TypeVar;
+use kaubo_infer::Type;
+use kaubo_ir::cps::CpsModule;
+use kaubo_ir::pass::binary;
+use std::sync::Arc;
+
+/// Compiler release the cache entries were produced by (`.version`).
+pub fn compiler_version() -> &'static str {
+    include_str!("../../../.version").trim()
+}
+
+/// Bumped whenever a key's inputs or an encoding below change meaning.
+const FORMAT: &str = "2";
+
+/// Kind under which per-module export tables are persisted.
+pub const KIND_EXPORT_TABLE: &str = "ExportTable";
+
+fn base_key(scope: &str, pipeline: Option<&Pipeline>) -> kaubo_dag::CacheKeyBuilder {
+    CacheKey::builder()
+        .str(scope)
+        .str(compiler_version())
+        .str(FORMAT)
+        .str(&pipeline.map_or_else(String::new, Pipeline::fingerprint))
+}
+
+/// Key of a single-file compile of `source`.
+pub fn source_key(source: &str, pipeline: Option<&Pipeline>) -> CacheKey {
+    base_key("source", pipeline).str(source).finish()
+}
+
+/// Key of one module of a multi-file compile, once its imports resolved.
+/// `content_hash` is the module's `FileMeta::hash`, computed by the VFS when
+/// it read the file, so the source is not hashed a second time here.
+pub fn module_key(
+    path: &str,
+    content_hash: u128,
+    pipeline: Option<&Pipeline>,
+    imports: &ImportTable,
+) -> CacheKey {
+    let mut w = Writer::default();
+    w.imports(imports);
+    base_key("module", pipeline)
+        .str(path)
+        .bytes(&content_hash.to_le_bytes())
+        .bytes(&w.0)
+        .finish()
+}
+
+// ── Load / store ─────────────────────────────────────────────────────
+
+pub fn load_cps(cache: &dyn PersistentCache, key: CacheKey) -> Option<CpsModule> {
+    let bytes = cache.load(&Kind::new(Kind::CPS), key)?;
+    binary::decode_module(&bytes).ok()
+}
+
+pub fn store_cps(cache: &dyn PersistentCache, key: CacheKey, cps: &CpsModule) {
+    cache.store(&Kind::new(Kind::CPS), key, &binary::encode_module(cps));
+}
+
+/// A module's `Cps` and `ExportTable`, or `None` unless both are cached.
+/// `imports` is the table the key was computed from; it is not persisted.
+pub fn load_module(
+    cache: &dyn PersistentCache,
+    key: CacheKey,
+    path: &str,
+    imports: &ImportTable,
+) -> Option<(CpsModule, ExportTable)> {
+    let cps = load_cps(cache, key)?;
+    let bytes = cache.load(&Kind::new(KIND_EXPORT_TABLE), key)?;
+    let entries = Reader::new(&bytes).entries().ok()?;
+    let table = ExportTable {
+        source_path: path.to_string(),
+        entries,
+        import_table: imports.clone(),
+        cps_module: Arc::new(cps.clone()),
+    };
+    Some((cps, table))
+}
+
+pub fn store_module(
+    cache: &dyn PersistentCache,
+    key: CacheKey,
+    cps: &CpsModule,
+    table: &ExportTable,
+) {
+    store_cps(cache, key, cps);
+    let mut w = Writer::default();
+    w.entries(&table.entries);
+    cache.store(&Kind::new(KIND_EXPORT_TABLE), key, &w.0);
+}
+
+// ── Encoding ─────────────────────────────────────────────────────────
+//
+// Little-endian; lengths and indices are u64, strings are length-prefixed
+// UTF-8, sums are a u8 tag followed by their fields.
+
+#[derive(Default)]
+struct Writer(Vec<u8>);
+
+impl Writer {
+    fn u8(&mut self, v: u8) {
+        self.0.push(v);
+    }
+    fn u64(&mut self, v: u64) {
+        self.0.extend_from_slice(&v.to_le_bytes());
+    }
+    fn usize(&mut self, v: usize) {
+        self.u64(v as u64);
+    }
+    fn str(&mut self, s: &str) {
+        self.usize(s.len());
+        self.0.extend_from_slice(s.as_bytes());
+    }
+
+    fn ty(&mut self, t: &Type) {
+        match t {
+            Type::Var(v) => {
+                self.u8(0);
+                self.usize(v.0);
+            }
+            Type::Int64 => self.u8(1),
+            Type::Float64 => self.u8(2),
+            Type::String => self.u8(3),
+            Type::Bool => self.u8(4),
+            Type::Null => self.u8(5),
+            Type::Arrow(a, b) => {
+                self.u8(6);
+                self.ty(a);
+                self.ty(b);
+            }
+            Type::Record(id, fields) => {
+                self.u8(7);
+                self.usize(*id);
+                self.fields(fields);
+            }
+            Type::Variant(id, name, fields) => {
+                self.u8(8);
+                self.usize(*id);
+                self.str(name);
+                self.fields(fields);
+            }
+            Type::List(t) => {
+                self.u8(9);
+                self.ty(t);
+            }
+            Type::Tuple(ts) => {
+                self.u8(10);
+                self.usize(ts.len());
+                for t in ts {
+                    self.ty(t);
+                }
+            }
+            Type::Interface(name) => {
+                self.u8(11);
+                self.str(name);
+            }
+        }
+    }
+
+    fn fields(&mut self, fields: &[(String, Type)]) {
+        self.usize(fields.len());
+        for (name, ty) in fields {
+            self.str(name);
+            self.ty(ty);
+        }
+    }
+
+    fn entry(&mut self, e: &ExportEntry) {
+        match e {
+            ExportEntry::Const {
+                name,
+                ty,
+                const_idx,
+            } => {
+                self.u8(0);
+                self.str(name);
+                self.ty(ty);
+                self.usize(*const_idx);
+            }
+            ExportEntry::Function { name, ty, func_idx } => {
+                self.u8(1);
+                self.str(name);
+                self.ty(ty);
+                self.usize(*func_idx);
+            }
+            ExportEntry::Struct {
+                name,
+                fields,
+                struct_id,
+            } => {
+                self.u8(2);
+                self.str(name);
+                self.fields(fields);
+                self.usize(*struct_id);
+            }
+            ExportEntry::Interface { name, methods } => {
+                self.u8(3);
+                self.str(name);
+                self.usize(methods.len());
+                for (method, params, ret) in methods {
+                    self.str(method);
+                    self.fields(params);
+                    match ret {
+                        Some(t) => {
+                            self.u8(1);
+                            self.ty(t);
+                        }
+                        None => self.u8(0),
+                    }
+                }
+            }
+        }
+    }
+
+    fn entries(&mut self, entries: &[ExportEntry]) {
+        self.usize(entries.len());
+        for e in entries {
+            self.entry(e);
+        }
+    }
+
+    fn imports(&mut self, imports: &ImportTable) {
+        self.usize(imports.entries.len());
+        for ri in &imports.entries {
+            self.str(&ri.local_name);
+            self.str(&ri.source_path);
+            self.entry(&ri.entry);
+        }
+    }
+}
+
+struct Reader<'a> {
+    bytes: &'a [u8],
+    pos: usize,
+}
+
+impl<'a> Reader<'a> {
+    fn new(bytes: &'a [u8]) -> Self {
+        Reader { bytes, pos: 0 }
+    }
+
+    fn take(&mut self, n: usize) -> Result<&'a [u8], String> {
+        let end = self.pos.checked_add(n).filter(|&e| e <= self.bytes.len());
+        let end = end.ok_or_else(|| format!("truncated at byte {}", self.pos))?;
+        let out = &self.bytes[self.pos..end];
+        self.pos = end;
+        Ok(out)
+    }
+    fn u8(&mut self) -> Result<u8, String> {
+        Ok(self.take(1)?[0])
+    }
+    fn usize(&mut self) -> Result<usize, String> {
+        let b = self.take(8)?;
+        Ok(u64::from_le_bytes(b.try_into().unwrap()) as usize)
+    }
+    fn str(&mut self) -> Result<String, String> {
+        let len = self.usize()?;
+        let b = self.take(len)?;
+        String::from_utf8(b.to_vec()).map_err(|e| format!("utf8: {e}"))
+    }
+
+    fn ty(&mut self) -> Result<Type, String> {
+        Ok(match self.u8()? {
+            0 => Type::Var(TypeVar(self.usize()?)),
+            1 => Type::Int64,
+            2 => Type::Float64,
+            3 => Type::String,
+            4 => Type::Bool,
+            5 => Type::Null,
+            6 => Type::Arrow(Box::new(self.ty()?), Box::new(self.ty()?)),
+            7 => Type::Record(self.usize()?, self.fields()?),
+            8 => Type::Variant(self.usize()?, self.str()?, self.fields()?),
+            9 => Type::List(Box::new(self.ty()?)),
+            10 => {
+                let n = self.usize()?;
+                Type::Tuple((0..n).map(|_| self.ty()).collect::<Result<_, _>>()?)
+            }
+            11 => Type::Interface(self.str()?),
+            tag => return Err(format!("bad type tag {tag}")),
+        })
+    }
+
+    fn fields(&mut self) -> Result<Vec<(String, Type)>, String> {
+        let n = self.usize()?;
+        (0..n).map(|_| Ok((self.str()?, self.ty()?))).collect()
+    }
+
+    fn entry(&mut self) -> Result<ExportEntry, String> {
+        Ok(match self.u8()? {
+            0 => ExportEntry::Const {
+                name: self.str()?,
+                ty: self.ty()?,
+                const_idx: self.usize()?,
+            },
+            1 => ExportEntry::Function {
+                name: self.str()?,
+                ty: self.ty()?,
+                func_idx: self.usize()?,
+            },
+            2 => ExportEntry::Struct {
+                name: self.str()?,
+                fields: self.fields()?,
+                struct_id: self.usize()?,
+            },
+            3 => {
+                let name = self.str()?;
+                let n = self.usize()?;
+                let mut methods = Vec::with_capacity(n.min(1024));
+                for _ in 0..n {
+                    let method = self.str()?;
+                    let params = self.fields()?;
+                    let ret = match self.u8()? {
+                        0 => None,
+                        _ => Some(self.ty()?),
+                    };
+                    methods.push((method, params, ret));
+                }
+                ExportEntry::Interface { name, methods }
+            }
+            tag => return Err(format!("bad export tag {tag}")),
+        })
+    }
+
+    fn entries(&mut self) -> Result<Vec<ExportEntry>, String> {
+        let n = self.usize()?;
+        let entries = (0..n)
+            .map(|_| self.entry())
+            .collect::<Result<Vec<_>, _>>()?;
+        if self.pos != self.bytes.len() {
+            return Err("trailing bytes".into());
+        }
+        Ok(entries)
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::export_table::ResolvedImport;
+    use std::collections::HashMap;
+
+    fn sample_entries() -> Vec<ExportEntry> {
+        let point = vec![
+            ("x".to_string(), Type::Int64),
+            ("y".to_string(), Type::Float64),
+        ];
+        vec![
+            ExportEntry::Const {
+                name: "N".into(),
+                ty: Type::List(Box::new(Type::String)),
+                const_idx: 4,
+            },
+            ExportEntry::Function {
+                name: "f".into(),
+                ty: Type::Arrow(
+                    Box::new(Type::Tuple(vec![
+                        Type::Record(2, point.clone()),
+                        Type::Var(TypeVar(7)),
+                    ])),
+                    Box::new(Type::Variant(
+                        1,
+                        "Some".into(),
+                        vec![("v".into(), Type::Bool)],
+                    )),
+                ),
+                func_idx: 3,
+            },
+            ExportEntry::Struct {
+                name: "Point".into(),
+                fields: point,
+                struct_id: 2,
+            },
+            ExportEntry::Interface {
+                name: "Show".into(),
+                methods: vec![
+                    (
+                        "show".into(),
+                        vec![("self".into(), Type::Interface("Show".into()))],
+                        Some(Type::String),
+                    ),
+                    ("reset".into(), vec![], None),
+                ],
+            },
+            ExportEntry::Const {
+                name: "Z".into(),
+                ty: Type::Null,
+                const_idx: 0,
+            },
+        ]
+    }
+
+    fn debug(entries: &[ExportEntry]) -> String {
+        format!("{entries:?}")
+    }
+
+    #[test]
+    fn export_entries_round_trip() {
+        let entries = sample_entries();
+        let mut w = Writer::default();
+        w.entries(&entries);
+        let decoded = Reader::new(&w.0).entries().unwrap();
+        assert_eq!(debug(&decoded), debug(&entries));
+
+        for cut in [0, 1, w.0.len() / 2, w.0.len() - 1] {
+            assert!(Reader::new(&w.0[..cut]).entries().is_err(), "cut at {cut}");
+        }
+        let mut extra = w.0.clone();
+        extra.push(0);
+        assert!(Reader::new(&extra).entries().is_err());
+    }
+
+    #[test]
+    fn module_key_covers_imported_types() {
+        let import = |ty| ImportTable {
+            entries: vec![ResolvedImport {
+                local_name: "f".into(),
+                source_path: "lib.kb".into(),
+                entry: ExportEntry::Function {
+                    name: "f".into(),
+                    ty,
+                    func_idx: 0,
+                },
+            }],
+            by_name: HashMap::from([("f".to_string(), 0)]),
+        };
+        let int = import(Type::Arrow(Box::new(Type::Int64), Box::new(Type::Int64)));
+        let float = import(Type::Arrow(Box::new(Type::Float64), Box::new(Type::Int64)));
+        let src = "import { f } from \"lib\";";
+        let hash = kaubo_vfs::content_hash(src.as_bytes());
+        assert_eq!(
+            module_key("main.kb", hash, None, &int),
+            module_key("main.kb", hash, None, &int)
+        );
+        assert_ne!(
+            module_key("main.kb", hash, None, &int),
+            module_key("main.kb", hash, None, &float)
+        );
+        assert_ne!(
+            module_key("main.kb", hash, None, &int),
+            module_key("other.kb", hash, None, &int)
+        );
+        assert_ne!(
+            module_key("main.kb", hash, None, &int),
+            module_key("main.kb", kaubo_vfs::content_hash(b"edited"), None, &int)
+        );
+
+        let standard = crate::DagCoordinator::standard_pipeline();
+        assert_ne!(source_key(src, None), source_key(src, Some(&standard)));
+        assert_ne!(
+            source_key(src, Some(&standard)),
+            source_key("const x = 1;", Some(&standard))
+        );
+        assert_eq!(
+            source_key(src, Some(&standard)),
+            source_key(src, Some(&standard.clone().with_threads(1))),
+            "thread count does not change the output"
+        );
+    }
+
+    #[test]
+    fn compiler_version_is_read_from_the_release_file() {
+        let v = compiler_version();
+        assert!(!v.is_empty() && !v.contains('\n'));
+        assert!(v.split('.').all(|part| part.parse::<u32>().is_ok()), "{v}");
+    }
+}
@@ -12,6 +12,7 @@ use std::pin::Pin;
 pub struct ExecuteBuilder {
     pub module_id: String,
     pub max_loop_iterations: u64,
+    pub max_stack_bytes: usize,
 }
 
 impl ExecuteBuilder {
@@ -19,6 +20,7 @@ impl ExecuteBuilder {
         ExecuteBuilder {
             module_id: module_id.into(),
             max_loop_iterations: u64::MAX,
+            max_stack_bytes: kaubo_vm::DEFAULT_MAX_STACK_BYTES,
         }
     }
 
@@ -26,6 +28,11 @@ impl ExecuteBuilder {
         self.max_loop_iterations = limit;
         self
     }
+
+    pub fn with_max_stack_bytes(mut self, limit: usize) -> Self {
+        self.max_stack_bytes = limit;
+        self
+    }
 }
 
 impl Builder<String, RunOutcome> for ExecuteBuilder {
@@ -43,6 +50,7 @@ impl Builder<String, RunOutcome> for ExecuteBuilder {
         _ctx: &'a mut FetchContext<String>,
     ) -> Pin<Box<dyn Future<Output = Result<RunOutcome, DagError<String>>> + Send + 'a>> {
         let max_loops = self.max_loop_iterations;
+        let max_stack = self.max_stack_bytes;
         let cps_artifact = inputs.into_iter().next().unwrap();
         Box::pin(async move {
             let Some(cps) = cps_artifact.try_downcast_ref::<CpsModule>() else {
@@ -58,6 +66,7 @@ impl Builder<String, RunOutcome> for ExecuteBuilder {
 
             let mut vm = kaubo_vm::VM::new();
             vm.max_loop_iterations = max_loops;
+            vm.max_stack_bytes = max_stack;
             vm.load(cps).map_err(|e| DagError::BuilderError(format!("load: {e}")))?;
 
             let func_idx = cps.functions.len() - 1;
@@ -69,7 +78,7 @@ impl Builder<String, RunOutcome> for ExecuteBuilder {
 
             Ok(RunOutcome {
                 result,
-                output: vm.output,
+                output: vm.take_output(),
             })
         })
     }
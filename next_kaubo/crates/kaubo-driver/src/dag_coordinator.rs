@@ -3,27 +3,35 @@
 //! This is the bridge between the async `kaubo-dag` crate and the existing
 //! synchronous `kaubo-driver` API surface.
 
+use crate::artifact_cache;
 use crate::builders::execute::ExecuteBuilder;
 use crate::fetchers;
 use crate::module_loader::ModuleLoader;
 use crate::protocol::Pipeline;
 use crate::stages::adapt_pass;
 use crate::RunOutcome;
-use kaubo_dag::{Artifact, ArtifactKey, BuilderEvent, DagError, DagScheduler, FetcherRegistry, Kind};
+use kaubo_dag::{
+    Artifact, ArtifactKey, BuilderEvent, DagError, DagScheduler, FetcherRegistry, Kind,
+    PersistentCache,
+};
 use kaubo_ir::cps::CpsModule;
 use kaubo_dag::Spawner;
-use kaubo_ir::pass::{empty_block::EmptyBlockElim, fold::ConstantFold, move_fold::MoveFold};
+use kaubo_ir::pass::{
+    empty_block::EmptyBlockElim, escape::ScalarReplace, fold::ConstantFold, inline::Inline,
+    loop_inline::LoopInline, move_fold::MoveFold, reg_alloc::RegAlloc,
+};
 use std::sync::Arc;
 
 #[cfg(not(target_arch = "wasm32"))]
-use kaubo_dag::{BlockingSpawner, NativeSpawner};
+use kaubo_dag::{BlockingSpawner, NativeSpawner, PoolSpawner};
 #[cfg(target_arch = "wasm32")]
 use kaubo_dag::WasmSpawner;
 
-/// Platform-appropriate spawner.
+/// Platform-appropriate spawner: on native, the process-wide
+/// work-stealing pool shared by every coordinator.
 #[cfg(not(target_arch = "wasm32"))]
 fn default_spawner() -> Arc<dyn kaubo_dag::Spawner> {
-    Arc::new(NativeSpawner)
+    PoolSpawner::global()
 }
 #[cfg(target_arch = "wasm32")]
 fn default_spawner() -> Arc<dyn kaubo_dag::Spawner> {
@@ -41,23 +49,47 @@ fn default_spawner() -> Arc<dyn kaubo_dag::Spawner> {
 /// | Feature | Old Coordinator | DagCoordinator |
 /// |---------|----------------|---------------|
 /// | Execution model | Synchronous `fn` calls | Async DAG expansion |
-/// | Parallelism | Serial only | Parallel (Semantic ∥ Cps) |
+/// | Parallelism | Serial only | Parallel (Semantic ∥ Cps, independent modules on a work-stealing pool) |
 /// | Cancellation | Not supported | `drop(stream)` cancels all tasks |
-/// | Caching | String-keyed HashMap | ArtifactStore with dependency tracking |
+/// | Caching | String-keyed HashMap | ArtifactStore with dependency tracking, optional [persistent tier](DagCoordinator::with_cache) |
 /// | Progress | EventHandler side-channel | First-class ProgressEvent stream |
 pub struct DagCoordinator {
     scheduler: Arc<DagScheduler<String>>,
+    /// Single-file pipeline, kept to key persisted `Cps` artifacts.
+    pipeline: Option<Pipeline>,
 }
 
 impl DagCoordinator {
+    /// The standard optimisation pipeline:
+    /// EmptyBlockElim + MoveFold + ConstantFold + Inline + ScalarReplace
+    /// (objects returned from inlined calls become local) + LoopInline, then
+    /// RegAlloc packs the registers those passes left behind.  Inline is the
+    /// only module pass; the others run function by function across threads.
+    pub fn standard_pipeline() -> Pipeline {
+        Pipeline::new()
+            .add_function(EmptyBlockElim)
+            .add_function(MoveFold)
+            .add_function(ConstantFold)
+            .add(adapt_pass(Inline::default()))
+            .add_function(ScalarReplace)
+            .add_function(LoopInline)
+            .add_function(RegAlloc)
+    }
+
+    /// The pipeline run on a linked multi-file module: Inline, now that
+    /// imported calls have known targets, ScalarReplace, which also sees
+    /// imported struct definitions, then RegAlloc on the grown callers.
+    pub fn link_pipeline() -> Pipeline {
+        Pipeline::new()
+            .add(adapt_pass(Inline::default()))
+            .add_function(ScalarReplace)
+            .add_function(RegAlloc)
+    }
+
     /// Create a new DagCoordinator for single-file compilation with the
-    /// standard optimisation pipeline (EmptyBlockElim + MoveFold + ConstantFold).
+    /// [standard optimisation pipeline](DagCoordinator::standard_pipeline).
     pub fn new() -> Self {
-        let pipeline = Pipeline::new()
-            .add(adapt_pass(EmptyBlockElim))
-            .add(adapt_pass(MoveFold))
-            .add(adapt_pass(ConstantFold));
-        Self::with_pipeline(pipeline)
+        Self::with_pipeline(Self::standard_pipeline())
     }
 
     /// Create a DagCoordinator for single-file compilation with a
@@ -66,7 +98,7 @@ impl DagCoordinator {
         let registry = FetcherRegistry::<String>::new();
         let spawner = default_spawner();
 
-        let pipeline_for_cps = pipeline;
+        let pipeline_for_cps = pipeline.clone();
         registry.register(
             Kind::new(Kind::CPS),
             Box::new(move |key| {
@@ -87,24 +119,27 @@ impl DagCoordinator {
         );
 
         let scheduler = DagScheduler::new(registry, spawner);
-        DagCoordinator { scheduler }
+        DagCoordinator {
+            scheduler,
+            pipeline: Some(pipeline),
+        }
     }
 
     /// Create with a custom spawner (e.g. SyncSpawner for WASM sync API).
     pub fn new_with_spawner(spawner: Arc<dyn Spawner>) -> Self {
-        let pipeline = Pipeline::new()
-            .add(adapt_pass(EmptyBlockElim))
-            .add(adapt_pass(MoveFold))
-            .add(adapt_pass(ConstantFold));
+        let pipeline = Self::standard_pipeline();
         let registry = FetcherRegistry::<String>::new();
-        let pipeline_for_cps = pipeline;
+        let pipeline_for_cps = pipeline.clone();
         registry.register(Kind::new(Kind::CPS), Box::new(move |key| {
             Box::new(fetchers::cps::CpsFetcher::new(key.module_id.clone(), Some(pipeline_for_cps.clone())))
         }));
         registry.register(Kind::new(Kind::SEMANTIC), Box::new(|key| {
             Box::new(fetchers::semantic::SemanticFetcher::new(key.module_id.clone()))
         }));
-        DagCoordinator { scheduler: DagScheduler::new(registry, spawner) }
+        DagCoordinator {
+            scheduler: DagScheduler::new(registry, spawner),
+            pipeline: Some(pipeline),
+        }
     }
 
     /// Create a DagCoordinator for multi-file compilation.
@@ -112,14 +147,38 @@ impl DagCoordinator {
     /// Registers:
     /// - ModuleGraphFetcher (discovers graph + seeds Sources)
     /// - PerModuleCpsFetcher (concurrent per-module compilation via dynamic deps)
-    /// - LinkedCpsFetcher (collects all Cps + links)
+    /// - LinkedCpsFetcher (collects all Cps + links, then runs the
+    ///   [link pipeline](DagCoordinator::link_pipeline))
     pub fn new_multifile(
         entry: impl Into<String>,
         loader: Arc<dyn ModuleLoader>,
         pipeline: Option<Pipeline>,
+    ) -> Self {
+        Self::new_multifile_with_link(entry, loader, pipeline, Some(Self::link_pipeline()))
+    }
+
+    /// [`new_multifile`](DagCoordinator::new_multifile) with a specific
+    /// `pipeline` per module and `link` pipeline for the linked module.
+    pub fn new_multifile_with_link(
+        entry: impl Into<String>,
+        loader: Arc<dyn ModuleLoader>,
+        pipeline: Option<Pipeline>,
+        link: Option<Pipeline>,
+    ) -> Self {
+        Self::new_multifile_with_spawner(entry, loader, pipeline, link, default_spawner())
+    }
+
+    /// [`new_multifile_with_link`](DagCoordinator::new_multifile_with_link)
+    /// on a specific spawner, e.g. a [`PoolSpawner`](kaubo_dag::PoolSpawner)
+    /// of a chosen size.
+    pub fn new_multifile_with_spawner(
+        entry: impl Into<String>,
+        loader: Arc<dyn ModuleLoader>,
+        pipeline: Option<Pipeline>,
+        link: Option<Pipeline>,
+        spawner: Arc<dyn Spawner>,
     ) -> Self {
         let registry = FetcherRegistry::<String>::new();
-        let spawner = default_spawner();
 
         let entry_str: String = entry.into();
         let l1 = Arc::clone(&loader);
@@ -140,12 +199,26 @@ impl DagCoordinator {
         registry.register(Kind::new(Kind::CPS), Box::new(move |key| {
             Box::new(fetchers::per_module_cps::PerModuleCpsFetcher::new(key.module_id.clone(), p.clone(), Arc::clone(&l2)))
         }));
-        registry.register(Kind::new(Kind::LINKED_CPS), Box::new(|_key| {
-            Box::new(fetchers::linked_cps::LinkedCpsFetcher::new())
+        registry.register(Kind::new(Kind::LINKED_CPS), Box::new(move |_key| {
+            Box::new(fetchers::linked_cps::LinkedCpsFetcher::with_pipeline(link.clone()))
         }));
 
         let scheduler = DagScheduler::new(registry, spawner);
-        DagCoordinator { scheduler }
+        DagCoordinator {
+            scheduler,
+            pipeline: None,
+        }
+    }
+
+    /// Keep compiled artifacts in `cache` across coordinators and processes.
+    ///
+    /// Single-file compiles persist the finished `Cps`; multi-file compiles
+    /// persist each module's `Cps` and `ExportTable`, keyed by its source
+    /// and resolved imports (see [`artifact_cache`](crate::artifact_cache)).
+    /// Linking and the link pipeline still run on every compile.
+    pub fn with_cache(self, cache: Arc<dyn PersistentCache>) -> Self {
+        self.scheduler.set_persistent_cache(cache);
+        self
     }
 
     // ── Async helpers ──────────────────────────────────────────────
@@ -163,12 +236,26 @@ impl DagCoordinator {
 
     /// Async: compile source to CpsModule.
     pub async fn compile_source_async(&self, source: &str, max_loop_iterations: u64) -> Result<CpsModule, DagError<String>> {
+        let cache = self.scheduler.persistent_cache().cloned();
+        let cache_key = cache
+            .as_ref()
+            .map(|_| artifact_cache::source_key(source, self.pipeline.as_ref()));
+        if let (Some(cache), Some(key)) = (&cache, cache_key) {
+            if let Some(cps) = artifact_cache::load_cps(cache.as_ref(), key) {
+                return Ok(cps);
+            }
+        }
+
         let module_id = "mod".to_string();
         let module = kaubo_syntax::parser::Parser::new(source).parse().map_err(|e| {
             DagError::fetcher_error(ArtifactKey::new(module_id.clone(), Kind::new(Kind::AST)), format!("parse: {e}"))
         })?;
         self.scheduler.seed_artifact(Artifact::new(module_id.clone(), Kind::new(Kind::AST), module));
-        Self::collect_build(self.scheduler.build(Box::new(CpsBuilder { module_id, max_loop_iterations }))).await
+        let cps = Self::collect_build(self.scheduler.build(Box::new(CpsBuilder { module_id, max_loop_iterations }))).await?;
+        if let (Some(cache), Some(key)) = (&cache, cache_key) {
+            artifact_cache::store_cps(cache.as_ref(), key, &cps);
+        }
+        Ok(cps)
     }
 
     /// Async: compile and execute.
@@ -1,7 +1,7 @@
 //! 模块导入/导出数据结构。
 //!
 //! 提供导出表（ExportTable）、导入表（ImportTable）及其组成类型。
-//! 这些数据结构被 ModuleGraph、ModuleCompiler、LinkStage 和 infer 共享。
+//! 这些数据结构被 ModuleGraph、PerModuleCpsFetcher、LinkStage 和 infer 共享。
 
 use kaubo_infer::Type;
 use std::collections::HashMap;
@@ -1,18 +1,24 @@
 //! LinkedCpsFetcher — collects per-module Cps and ExportTables, then links.
 //!
 //! PerModuleCpsFetcher compiles each module concurrently via the DAG and
-//! seeds ExportTable/{path}. This fetcher requests Cps and ExportTable
-//! for each module, then calls LinkStage::link().
+//! seeds ExportTable/{path}. This fetcher requests every module's Cps at
+//! once, collects the ExportTables, then calls LinkStage::link() — the only
+//! serial step — and runs the optional post-link pipeline (passes that need
+//! cross-module call targets).
 
 use crate::export_table::ExportTable;
 use crate::module_graph::ModuleGraph;
+use crate::protocol::Pipeline;
 use kaubo_dag::{Artifact, ArtifactKey, DagError, FetchContext, Fetcher, Kind};
 use kaubo_ir::cps::CpsModule;
 use std::collections::HashMap;
 use std::future::Future;
 use std::pin::Pin;
 
-pub struct LinkedCpsFetcher;
+pub struct LinkedCpsFetcher {
+    /// Passes run on the linked module, after imports resolve to `Call`.
+    pub pipeline: Option<Pipeline>,
+}
 
 impl Default for LinkedCpsFetcher {
     fn default() -> Self {
@@ -21,7 +27,13 @@ impl Default for LinkedCpsFetcher {
 }
 
 impl LinkedCpsFetcher {
-    pub fn new() -> Self { LinkedCpsFetcher }
+    pub fn new() -> Self {
+        LinkedCpsFetcher { pipeline: None }
+    }
+
+    pub fn with_pipeline(pipeline: Option<Pipeline>) -> Self {
+        LinkedCpsFetcher { pipeline }
+    }
 }
 
 impl Fetcher<String> for LinkedCpsFetcher {
@@ -37,6 +49,7 @@ impl Fetcher<String> for LinkedCpsFetcher {
         ctx: &'a mut FetchContext<String>,
     ) -> Pin<Box<dyn Future<Output = Result<Artifact<String>, DagError<String>>> + Send + 'a>> {
         let graph_artifact = inputs.into_iter().next().unwrap();
+        let pipeline = self.pipeline.clone();
         Box::pin(async move {
             let Some(graph) = graph_artifact.try_downcast_ref::<ModuleGraph>() else {
                 return Err(DagError::Internal("LinkedCps: expected ModuleGraph".into()));
@@ -47,21 +60,31 @@ impl Fetcher<String> for LinkedCpsFetcher {
                     CpsModule { functions: vec![], constants: vec![], structs: vec![], enums: vec![], vtables: vec![], symbol_map: HashMap::new(), func_owners: vec![] }));
             }
 
+            // Request every module's Cps together — each PerModuleCpsFetcher
+            // waits only on its own imports, so independent modules compile
+            // in parallel and each seeds ExportTable/{path} when done
+            let cps_keys = order
+                .iter()
+                .map(|path| ArtifactKey::new(path.clone(), Kind::new(Kind::CPS)))
+                .collect();
+            ctx.request_dependencies(cps_keys).await?;
+
             let mut built: HashMap<String, ExportTable> = HashMap::new();
             for path in order {
-                // Request Cps first — triggers PerModuleCpsFetcher which
-                // compiles the module and seeds ExportTable/{path}
-                let cps_key = ArtifactKey::new(path.clone(), Kind::new(Kind::CPS));
-                let _ = ctx.request_dependency(cps_key).await?;
                 // Now ExportTable is ready in cache
                 let et_key = ArtifactKey::new(path.clone(), Kind::new("ExportTable"));
                 let et = ctx.request_dependency(et_key).await?.downcast_clone::<ExportTable>();
                 built.insert(path.clone(), et);
             }
 
-            let linked = crate::link_stage::LinkStage::link(&built, order).map_err(|e| {
+            let mut linked = crate::link_stage::LinkStage::link(&built, order).map_err(|e| {
                 DagError::fetcher_error(ArtifactKey::new("__linked__".to_string(), Kind::new(Kind::LINKED_CPS)), format!("link: {e}"))
             })?;
+            if let Some(ref passes) = pipeline {
+                if !passes.is_empty() {
+                    passes.run(&mut linked, None);
+                }
+            }
             Ok(Artifact::new("__linked__".to_string(), Kind::new(Kind::LINKED_CPS), linked))
         })
     }
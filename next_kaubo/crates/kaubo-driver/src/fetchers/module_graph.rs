@@ -57,7 +57,8 @@ impl Fetcher<String> for ModuleGraphFetcher {
 
             // 2. Seed Source artifacts for every discovered module
             for (path, source) in &graph.sources {
-                let artifact = Artifact::new(path.clone(), Kind::new(Kind::SOURCE), source.clone());
+                let artifact =
+                    Artifact::new(path.clone(), Kind::new(Kind::SOURCE), source.to_string());
                 ctx.seed_artifact(artifact);
             }
 
@@ -1,9 +1,17 @@
 //! PerModuleCpsFetcher — concurrent per-module compilation via dynamic deps.
 //!
 //! Each module's compilation is an independent DAG node. Import resolution
-//! works through the DAG: A depends on B's `ExportTable`, which B produces
-//! after its own compilation. The DAG scheduler orchestrates concurrency.
+//! works through the DAG: A waits on B's `Cps`, and reads B's `ExportTable`,
+//! which B seeds just before its `Cps` completes. A module starts compiling
+//! as soon as its imports are done, so on a multi-threaded spawner
+//! independent modules compile in parallel.
+//!
+//! With a persistent tier attached, a module whose source, pipeline and
+//! resolved imports match a cached entry skips infer, CPS build and passes
+//! and reuses the cached `Cps` and `ExportTable` (see
+//! [`artifact_cache`](crate::artifact_cache)).
 
+use crate::artifact_cache;
 use crate::export_table::{ExportEntry, ExportTable, ImportTable, RawImport, ResolvedImport};
 use crate::module_graph::ModuleGraph;
 use crate::module_loader::ModuleLoader;
@@ -39,16 +47,14 @@ impl Fetcher<String> for PerModuleCpsFetcher {
 
     fn fetch<'a>(
         &'a self,
-        inputs: Vec<Artifact<String>>,
+        _inputs: Vec<Artifact<String>>,
         ctx: &'a mut FetchContext<String>,
     ) -> Pin<Box<dyn Future<Output = Result<Artifact<String>, DagError<String>>> + Send + 'a>> {
         let module_path = self.module_path.clone();
         let pipeline = self.pipeline.clone();
         let loader = Arc::clone(&self.loader);
-        let source_artifact = inputs.into_iter().next().unwrap();
 
         Box::pin(async move {
-            let source = source_artifact.downcast_clone::<String>();
             let path = module_path.clone();
             let et_key = ArtifactKey::new(path.clone(), Kind::new("ExportTable"));
 
@@ -70,17 +76,39 @@ impl Fetcher<String> for PerModuleCpsFetcher {
                 resolve_imports(loader.as_ref(), &path, raw_imports, ctx).await?
             };
 
-            // 3. Parse
-            let module = {
-                let mut parser = kaubo_syntax::parser::Parser::new(&source);
-                for ri in &import_table.entries {
-                    if matches!(ri.entry, ExportEntry::Struct { .. }) {
-                        parser.register_struct_name(&ri.local_name);
-                    }
+            // Everything the module's output depends on is known now
+            let cache = ctx.persistent_cache().cloned();
+            let cache_key = match (&cache, graph.meta.get(&path)) {
+                (Some(_), Some(meta)) => Some(artifact_cache::module_key(
+                    &path,
+                    meta.hash,
+                    pipeline.as_ref(),
+                    &import_table,
+                )),
+                _ => None,
+            };
+            if let (Some(cache), Some(key)) = (&cache, cache_key) {
+                if let Some((cps, export_table)) =
+                    artifact_cache::load_module(cache.as_ref(), key, &path, &import_table)
+                {
+                    ctx.seed_artifact_and_wake(Artifact::new(
+                        path.clone(),
+                        Kind::new("ExportTable"),
+                        export_table,
+                    ));
+                    return Ok(Artifact::new(path, Kind::new(Kind::CPS), cps));
                 }
-                parser.parse().map_err(|e| {
-                    DagError::fetcher_error(ArtifactKey::new(path.clone(), Kind::new(Kind::CPS)), format!("parse: {e}"))
-                })?
+            }
+
+            if ctx.is_cancelled() {
+                return Err(DagError::Cancelled);
+            }
+
+            // 3. Lower the AST the graph parsed during discovery
+            let Some(module) = graph.module(&path) else {
+                return Err(DagError::Internal(format!(
+                    "PerModuleCps: no AST for {path}"
+                )));
             };
 
             // 4. Convert to ImportSpecs
@@ -90,9 +118,11 @@ impl Fetcher<String> for PerModuleCpsFetcher {
                 }).collect())
             };
 
-            // 5. Infer with imports
+            // 5. Infer with imports. Struct / enum ids come from the path so
+            // that cached export tables agree with freshly inferred modules
+            let mut ids = kaubo_infer::TypeIds::for_module(&path);
             let (type_env, struct_fields, exports) =
-                kaubo_infer::infer_module_with_imports(&module, import_specs.as_deref())
+                kaubo_infer::infer_module_with_imports(&module, import_specs.as_deref(), &mut ids)
                     .map_err(|e| DagError::fetcher_error(ArtifactKey::new(path.clone(), Kind::new(Kind::CPS)), format!("infer: {}", e.msg)))?;
 
             // 6. CPS build with imports
@@ -116,6 +146,10 @@ impl Fetcher<String> for PerModuleCpsFetcher {
                 &path, &cps, type_env, struct_fields, &exports, &export_funcs, &export_consts, import_table,
             );
 
+            if let (Some(cache), Some(key)) = (&cache, cache_key) {
+                artifact_cache::store_module(cache.as_ref(), key, &cps, &export_table);
+            }
+
             // 9. Wake downstream waiters by storing the complete export table
             ctx.seed_artifact_and_wake(Artifact::new(path.clone(), Kind::new("ExportTable"), export_table));
 
@@ -130,11 +164,28 @@ async fn resolve_imports(
     raw_imports: &[RawImport],
     ctx: &mut FetchContext<String>,
 ) -> Result<ImportTable, DagError<String>> {
-    let mut entries = Vec::new();
-    let mut by_name = HashMap::new();
+    let mut dep_paths = Vec::with_capacity(raw_imports.len());
     for raw_imp in raw_imports {
         let (dep_path, _) = loader.resolve(path, &raw_imp.source_path)
             .map_err(|e| DagError::BuilderError(format!("resolve failed: {e}")))?;
+        dep_paths.push(dep_path);
+    }
+
+    // Wait on the dependencies' Cps rather than their ExportTables: that
+    // starts any dependency nobody has requested yet instead of finding
+    // its ExportTable unseeded, and compiles independent ones in parallel
+    let mut unique: Vec<&String> = dep_paths.iter().collect();
+    unique.sort();
+    unique.dedup();
+    let cps_keys = unique
+        .into_iter()
+        .map(|dep| ArtifactKey::new(dep.clone(), Kind::new(Kind::CPS)))
+        .collect();
+    ctx.request_dependencies(cps_keys).await?;
+
+    let mut entries = Vec::new();
+    let mut by_name = HashMap::new();
+    for (raw_imp, dep_path) in raw_imports.iter().zip(dep_paths) {
         let et_key = ArtifactKey::new(dep_path.clone(), Kind::new("ExportTable"));
         let et_artifact = ctx.request_dependency(et_key).await?;
         let Some(export_table) = et_artifact.try_downcast_ref::<ExportTable>() else {
@@ -12,19 +12,27 @@
 //!   ModuleGraph, LinkedCps).
 //! - **Builders** (`builders/`): terminal DAG consumers (ExecuteBuilder).
 
+pub mod artifact_cache;
 pub mod builders;
 pub mod dag_coordinator;
 pub mod export_table;
 pub mod fetchers;
 pub mod link_stage;
-pub mod module_compiler;
 pub mod module_graph;
 pub mod module_loader;
+pub mod programs;
 pub mod protocol;
 pub mod stages;
 
 pub use dag_coordinator::DagCoordinator;
+pub use kaubo_dag::{CacheStats, PersistentCache, Spawner};
+#[cfg(not(target_arch = "wasm32"))]
+pub use kaubo_dag::{DiskCache, PoolSpawner};
 pub use kaubo_ir::cps::CpsModule;
+pub use kaubo_vfs::{FileMeta, SourceFile, SourceText};
+pub use kaubo_vm::{
+    CollectSink, LoadedProgram, OutputSink, ProfileConfig, Profiler, RingSink, WriteSink,
+};
 pub use protocol::{BuildError, Pipeline};
 pub use stages::{adapt_pass, SemanticArtifact};
 
@@ -116,17 +124,85 @@ pub fn run_module_with_config(
     cps: &CpsModule,
     max_loop_iterations: u64,
 ) -> Result<RunOutcome, DriverError> {
-    if cps.functions.is_empty() {
-        return Ok(RunOutcome { result: 0, output: Vec::new() });
-    }
-    let mut vm = kaubo_vm::VM::new();
+    run_program(&load_program(cps)?, max_loop_iterations)
+}
+
+/// Encode and pre-decode a CPS module once into a shareable program image.
+pub fn load_program(cps: &CpsModule) -> Result<Arc<LoadedProgram>, DriverError> {
+    LoadedProgram::new(cps)
+        .map(Arc::new)
+        .map_err(DriverError::Load)
+}
+
+/// Execute a loaded program in a fresh VM isolate.
+///
+/// The program is shared, not copied: any number of threads may run the same
+/// `Arc<LoadedProgram>` at once. Hosts that pool VMs use `VM::attach` /
+/// `VM::reset` directly instead.
+pub fn run_program(
+    program: &Arc<LoadedProgram>,
+    max_loop_iterations: u64,
+) -> Result<RunOutcome, DriverError> {
+    run_program_with_sink(program, max_loop_iterations, Box::new(CollectSink::new()))
+}
+
+/// Execute a loaded program, sending `print` output to `sink`.
+///
+/// `RunOutcome::output` holds whatever lines the sink kept in memory (none for
+/// a streaming `WriteSink`). The sink is flushed before returning.
+pub fn run_program_with_sink(
+    program: &Arc<LoadedProgram>,
+    max_loop_iterations: u64,
+    sink: Box<dyn OutputSink>,
+) -> Result<RunOutcome, DriverError> {
+    run_isolate(program, max_loop_iterations, sink, None).map(|(outcome, _)| outcome)
+}
+
+/// Execute a loaded program with the sampling profiler attached.
+///
+/// Returns the run's outcome together with the collected profile; see
+/// `kaubo_vm::profile` for what is counted and how it is rendered.
+pub fn profile_program(
+    program: &Arc<LoadedProgram>,
+    max_loop_iterations: u64,
+    config: ProfileConfig,
+    sink: Box<dyn OutputSink>,
+) -> Result<(RunOutcome, Box<Profiler>), DriverError> {
+    let profiler = Box::new(Profiler::new(config));
+    let (outcome, profiler) = run_isolate(program, max_loop_iterations, sink, Some(profiler))?;
+    Ok((outcome, profiler.expect("profiler stays attached")))
+}
+
+fn run_isolate(
+    program: &Arc<LoadedProgram>,
+    max_loop_iterations: u64,
+    sink: Box<dyn OutputSink>,
+    profiler: Option<Box<Profiler>>,
+) -> Result<(RunOutcome, Option<Box<Profiler>>), DriverError> {
+    let Some(func_idx) = program.entry() else {
+        return Ok((
+            RunOutcome {
+                result: 0,
+                output: Vec::new(),
+            },
+            profiler,
+        ));
+    };
+    let mut vm = kaubo_vm::VM::with_program(program.clone());
     vm.max_loop_iterations = max_loop_iterations;
-    vm.load(cps).map_err(DriverError::Load)?;
-    let func_idx = cps.functions.len() - 1;
-    let reg_count = cps.functions[func_idx].reg_count;
-    let result = vm.execute(func_idx, reg_count, None)
-        .map_err(|e| DriverError::Runtime(format!("{e:?}")))?;
-    Ok(RunOutcome { result, output: vm.output })
+    vm.sink = sink;
+    vm.profiler = profiler;
+    let reg_count = program.func_reg_counts[func_idx];
+    let result = vm.execute(func_idx, reg_count, None);
+    // Flush what was printed before a runtime error, too.
+    let flushed = vm.sink.flush();
+    let result = result.map_err(|e| DriverError::Runtime(format!("{e:?}")))?;
+    flushed.map_err(|e| DriverError::Runtime(format!("output: {e}")))?;
+    let outcome = RunOutcome {
+        result,
+        output: vm.take_output(),
+    };
+    Ok((outcome, vm.profiler.take()))
 }
 
 /// Async: compile source (all platforms).
@@ -207,13 +283,55 @@ pub fn run_file(entry: &str, loader: Arc<dyn crate::module_loader::ModuleLoader>
     coord.run_file(entry, loader).map_err(Into::into)
 }
 
+/// [`compile_source_with_config`] through a persistent artifact cache.
+#[cfg(not(target_arch = "wasm32"))]
+pub fn compile_source_cached(
+    source: &str,
+    max_loop_iterations: u64,
+    cache: Arc<dyn PersistentCache>,
+) -> Result<CpsModule, DriverError> {
+    let coord = DagCoordinator::new().with_cache(cache);
+    coord
+        .compile_source_with_config(source, max_loop_iterations)
+        .map_err(Into::into)
+}
+
+/// [`compile_file`] through a persistent artifact cache: unchanged modules
+/// skip infer, CPS build and passes.
+#[cfg(not(target_arch = "wasm32"))]
+pub fn compile_file_cached(
+    entry: &str,
+    loader: Arc<dyn crate::module_loader::ModuleLoader>,
+    cache: Arc<dyn PersistentCache>,
+) -> Result<CpsModule, DriverError> {
+    let coord = DagCoordinator::new_multifile(entry, loader.clone(), None).with_cache(cache);
+    coord.compile_file(entry, loader).map_err(Into::into)
+}
+
+/// [`compile_file`] on a specific spawner, e.g. a
+/// [`PoolSpawner`] of a chosen size; the default is the process-wide pool.
+#[cfg(not(target_arch = "wasm32"))]
+pub fn compile_file_with_spawner(
+    entry: &str,
+    loader: Arc<dyn crate::module_loader::ModuleLoader>,
+    spawner: Arc<dyn Spawner>,
+) -> Result<CpsModule, DriverError> {
+    let coord = DagCoordinator::new_multifile_with_spawner(
+        entry,
+        loader.clone(),
+        None,
+        Some(DagCoordinator::link_pipeline()),
+        spawner,
+    );
+    coord.compile_file(entry, loader).map_err(Into::into)
+}
+
 pub fn instruction_count(module: &CpsModule) -> usize {
-    module
-        .functions
-        .iter()
-        .flat_map(|func| &func.blocks)
-        .map(|block| block.instrs.len() + 1)
-        .sum()
+    kaubo_ir::pass::instruction_count(module)
+}
+
+pub fn frame_size(module: &CpsModule) -> usize {
+    kaubo_ir::pass::frame_size(module)
 }
 
 pub fn encode_module(module: &CpsModule) -> Vec<u8> {
@@ -224,6 +342,28 @@ pub fn decode_module(bytes: &[u8]) -> Result<CpsModule, DriverError> {
     binary::decode_module(bytes).map_err(DriverError::Decode)
 }
 
+/// Encode a loaded program as a `KAUB` v2 image: the VM's flat tables, aligned
+/// and little-endian (see `kaubo_vm::image`).
+pub fn encode_image(program: &LoadedProgram) -> Vec<u8> {
+    program.to_image()
+}
+
+/// Load a precompiled program from either of the two `KAUB` formats.
+///
+/// Both share the magic; the version field after it tells them apart:
+/// - version 2 is a VM image (`encode_image`, `kaubo_vm::image::VERSION`),
+///   read table by table without building a `CpsModule`;
+/// - any other version goes to the module codec (`encode_module`), which
+///   accepts v3 and the older v1 and rejects everything else.
+pub fn load_image(bytes: &[u8]) -> Result<Arc<LoadedProgram>, DriverError> {
+    match kaubo_vm::image::version(bytes) {
+        Some(kaubo_vm::image::VERSION) => LoadedProgram::from_image(bytes)
+            .map(Arc::new)
+            .map_err(DriverError::Decode),
+        _ => load_program(&decode_module(bytes)?),
+    }
+}
+
 #[cfg(test)]
 mod tests {
     use super::*;
@@ -252,6 +392,92 @@ mod tests {
         assert_eq!(outcome.output, vec!["hi".to_string()]);
     }
 
+    #[test]
+    fn run_source_array_kernels() {
+        let source = r#"
+const xs = [1.5, 2.5, 3.0];
+const ys = float_array(3, 1.0);
+axpy(2.0, xs, ys);
+print(sum(ys).to_string());
+print(dot(xs, xs).to_string());
+const ns = [3, 1, 4, 1, 5, 9, 2, 6, 5];
+print(max(ns).to_string());
+print(min(ns).to_string());
+const ps = prefix_sum(ns);
+print(ps[8].to_string());
+print(sum(array_gt(ns, int_array(9, 3))).to_string());
+"#;
+        let outcome = run_source(source).unwrap();
+        assert_eq!(outcome.output, vec!["17", "17.5", "9", "1", "36", "5"]);
+    }
+
+    #[test]
+    fn run_program_streams_into_the_given_sink() {
+        use std::io::Write;
+        use std::sync::Mutex;
+
+        #[derive(Clone, Default)]
+        struct Shared(Arc<Mutex<Vec<u8>>>);
+        impl Write for Shared {
+            fn write(&mut self, buf: &[u8]) -> std::io::Result<usize> {
+                self.0.lock().unwrap().write(buf)
+            }
+            fn flush(&mut self) -> std::io::Result<()> {
+                Ok(())
+            }
+        }
+
+        let cps = compile_source(
+            "var i = 0; while (i < 5) { print(i.to_string()); i = i + 1; }; print(\"end\");",
+        )
+        .unwrap();
+        let program = load_program(&cps).unwrap();
+
+        let out = Shared::default();
+        let sink = Box::new(WriteSink::new(out.clone()));
+        let outcome = run_program_with_sink(&program, u64::MAX, sink).unwrap();
+        assert!(outcome.output.is_empty());
+        assert_eq!(out.0.lock().unwrap().as_slice(), b"0\n1\n2\n3\n4\nend\n");
+
+        let outcome =
+            run_program_with_sink(&program, u64::MAX, Box::new(RingSink::new(2))).unwrap();
+        assert_eq!(outcome.output, vec!["4", "end"]);
+    }
+
+    #[test]
+    fn profile_program_counts_calls_and_samples_stacks() {
+        // Unoptimised, so Inline keeps the calls being counted.
+        let cps = DagCoordinator::with_pipeline(Pipeline::new())
+            .compile_source(
+                "const sq = |n: Int64| -> Int64 { return n * n; };\n\
+                 var t = 0; var i = 0; while (i < 10) { t = t + sq(i); i = i + 1; }; print(t.to_string());",
+            )
+            .unwrap();
+        let program = load_program(&cps).unwrap();
+        let config = ProfileConfig {
+            sample_period: 1,
+            opcodes: true,
+        };
+        let (outcome, profile) =
+            profile_program(&program, u64::MAX, config, Box::new(CollectSink::new())).unwrap();
+        assert_eq!(outcome, run_program(&program, u64::MAX).unwrap());
+        let sq = program
+            .func_names
+            .iter()
+            .position(|n| &**n == "lambda_0")
+            .unwrap();
+        assert_eq!(profile.calls[sq], 10);
+        // Every sample of the lambda sits under the entry function.
+        let folded = profile.folded(&program);
+        assert!(folded.lines().any(|l| l == "main;lambda_0 10"), "{folded}");
+        assert_eq!(
+            profile.samples,
+            profile.stacks().iter().map(|(_, n)| n).sum::<u64>()
+        );
+        let ops = profile.opcode_counts();
+        assert!(ops.contains(&(kaubo_vm::Opcode::Call, 10)), "{ops:?}");
+    }
+
     #[test]
     fn run_source_prints_float_method_result_as_float_string() {
         let source = r#"
@@ -371,6 +597,27 @@ mod tests {
         assert_eq!(outcome.result, 42);
     }
 
+    #[test]
+    fn image_roundtrip_runs() {
+        let cps = compile_source(
+            "const f = |n: Int64| -> Int64 { return n * 2; }; print(f(21).to_string());",
+        )
+        .unwrap();
+        let image = encode_image(&load_program(&cps).unwrap());
+        let program = load_image(&image).unwrap();
+        assert!((0..program.func_count()).all(|f| !program.is_materialized(f)));
+        let outcome = run_program(&program, u64::MAX).unwrap();
+        assert_eq!(outcome.output, vec!["42"]);
+    }
+
+    #[test]
+    fn v1_modules_still_load() {
+        let cps = compile_source("print((40 + 2).to_string());").unwrap();
+        let program = load_image(&encode_module(&cps)).unwrap();
+        assert_eq!(run_program(&program, u64::MAX).unwrap().output, vec!["42"]);
+        assert!(matches!(load_image(b"bad"), Err(DriverError::Decode(_))));
+    }
+
     #[test]
     fn run_if_true_branch() {
         let outcome = run_source("const x = if (true) { 1 } else { 0 };").unwrap();
@@ -478,6 +725,17 @@ mod tests {
         assert!(instruction_count(&cps) > 2);
     }
 
+    #[test]
+    fn frame_size_sums_function_registers() {
+        let cps = compile_source(
+            "const f = |a: Int64| -> Int64 { return a + 1; }; print(f(1).to_string());",
+        )
+        .unwrap();
+        let regs: usize = cps.functions.iter().map(|f| f.reg_count).sum();
+        assert!(regs > 0);
+        assert_eq!(frame_size(&cps), regs);
+    }
+
     #[test]
     fn encode_empty_module() {
         let cps = compile_source("").unwrap();
@@ -1333,6 +1591,52 @@ mod tests {
         assert_eq!(outcome.result, 23); // (1+10) + (2+10) = 11 + 12 = 23
     }
 
+    /// 分层项目：每层 6 个互不依赖的模块，各自导入上一层的两个模块。
+    /// 单线程池和多线程池编译结果一致。
+    ///
+    /// 调用结果写回调用方 r0，会覆盖首个参数，所以函数体在调用后不再读 x。
+    #[test]
+    fn layered_project_compiles_the_same_on_any_pool_size() {
+        let width = 6;
+        let mut loader = MemLoader::new();
+        for layer in 0..4 {
+            for k in 0..width {
+                let id = layer * width + k;
+                let source = if layer == 0 {
+                    format!("export const f{id} = |x: Int64| -> Int64 {{ return x + 1; }};")
+                } else {
+                    let (a, b) = (
+                        (layer - 1) * width + k,
+                        (layer - 1) * width + (k + 1) % width,
+                    );
+                    format!(
+                        "import {{ f{a} }} from \"./m{a}.kb\"; import {{ f{b} }} from \"./m{b}.kb\";\n\
+                         export const f{id} = |x: Int64| -> Int64 {{ return f{b}(f{a}(x)); }};"
+                    )
+                };
+                loader.insert(&format!("m{id}.kb"), &source);
+            }
+        }
+        let last: Vec<usize> = (3 * width..4 * width).collect();
+        let imports: String = last
+            .iter()
+            .map(|i| format!("import {{ f{i} }} from \"./m{i}.kb\";\n"))
+            .collect();
+        let calls: Vec<String> = last.iter().map(|i| format!("f{i}(1)")).collect();
+        loader.insert("main.kb", &format!("{imports}{};", calls.join(" + ")));
+        let loader = Arc::new(loader);
+
+        let one =
+            compile_file_with_spawner("main.kb", loader.clone(), Arc::new(PoolSpawner::new(1)))
+                .unwrap();
+        let many =
+            compile_file_with_spawner("main.kb", loader, Arc::new(PoolSpawner::new(4))).unwrap();
+        assert_eq!(one.functions.len(), many.functions.len());
+        // 第 0 层 f(x) = x + 1，之后每层 +2^(层号)：第 3 层 f(1) = 9
+        assert_eq!(run_module(&one).unwrap().result, 54);
+        assert_eq!(run_module(&many).unwrap().result, 54);
+    }
+
     /// 单文件向后兼容
     #[test]
     fn single_file_backward_compatible() {
@@ -1647,4 +1951,228 @@ mod tests {
         let err = run_file("main.kb", Arc::new(loader)).unwrap_err();
         assert!(err.to_string().contains("export"));
     }
+
+    /// Pre-decoded dispatch must agree with the encoded reference loop on the
+    /// benchmark suites (inputs shrunk to keep debug-mode tests fast).
+    #[test]
+    fn decoded_dispatch_matches_encoded_on_benchmark_suites() {
+        let suites = [
+            include_str!("../../../ops/benchmark/suites/loop/main.kb").replace("200", "30"),
+            include_str!("../../../ops/benchmark/suites/sieve/main.kb").replace("100000", "500"),
+            include_str!("../../../ops/benchmark/suites/pipeline/main.kb").replace("100000", "500"),
+            include_str!("../../../ops/benchmark/suites/fib/main.kb").to_string(),
+            include_str!("../../../ops/benchmark/suites/fact/main.kb").to_string(),
+            include_str!("../../../ops/benchmark/suites/strbuild/main.kb").replace("100000", "500"),
+        ];
+        for src in &suites {
+            let cps = compile_source(src).unwrap();
+            let entry = cps.functions.len() - 1;
+            let run = |mode| {
+                let mut vm = kaubo_vm::VM::new();
+                vm.dispatch = mode;
+                vm.load(&cps).unwrap();
+                let result = vm
+                    .execute(entry, cps.functions[entry].reg_count, None)
+                    .unwrap();
+                (result, vm.take_output())
+            };
+            assert_eq!(
+                run(kaubo_vm::DispatchMode::Decoded),
+                run(kaubo_vm::DispatchMode::Encoded),
+                "{src}"
+            );
+        }
+    }
+
+    /// Binary modules carry operand lists, branch arguments and enums — a
+    /// cached module must run exactly like the one it was encoded from.
+    #[test]
+    fn encode_module_round_trips_operands() {
+        let src = "struct P { x: Int64, y: Int64 };
+             enum Shape { Circle(r: Int64), Dot }
+             const p = P { x: 5, y: 2 };
+             const l = [1, 2, 3];
+             const t = (4, 5);
+             const s = Circle(3);
+             var n = 0;
+             if (p.x > l[1]) { n = l[2]; } else { n = 2; };
+             const k = match (s) { Circle(r) -> r, Dot -> 0 };
+             print((p.x + n + k).to_string());";
+        let mut cps = compile_source(src).unwrap();
+        for f in &mut cps.functions {
+            f.blocks.retain(|b| b.id != usize::MAX);
+        }
+        let bytes = encode_module(&cps);
+        let decoded = decode_module(&bytes).unwrap();
+        for (a, b) in cps.functions.iter().zip(&decoded.functions) {
+            assert_eq!(
+                format!("{:?}", a.blocks),
+                format!("{:?}", b.blocks),
+                "{}",
+                a.name
+            );
+        }
+        assert_eq!(decoded.enums.len(), 1);
+        assert_eq!(encode_module(&decoded), bytes);
+        assert_eq!(run_module(&decoded).unwrap().output, vec!["11"]);
+    }
+
+    // ── Persistent artifact cache ──
+
+    fn temp_cache_dir(name: &str) -> std::path::PathBuf {
+        let dir =
+            std::env::temp_dir().join(format!("kaubo_driver_cache_{name}_{}", std::process::id()));
+        let _ = std::fs::remove_dir_all(&dir);
+        dir
+    }
+
+    /// (hits, misses, writes) per kind.
+    fn cache_counts(cache: &DiskCache) -> Vec<(String, (u64, u64, u64))> {
+        cache
+            .stats()
+            .into_iter()
+            .map(|(k, s)| (k.to_string(), (s.hits, s.misses, s.writes)))
+            .collect()
+    }
+
+    #[test]
+    fn cached_single_file_compile_hits_in_a_new_coordinator() {
+        let dir = temp_cache_dir("single");
+        let sources = [
+            include_str!("../../../ops/benchmark/suites/pipeline/main.kb").replace("100000", "500"),
+            include_str!("../../../ops/benchmark/suites/iface_dispatch/main.kb").to_string(),
+            "enum Option { Some(value: Int64), None }
+             const x = Some(42);
+             const val = match (x) { Some(v) -> v, None -> 0 };
+             print(val.to_string());"
+                .to_string(),
+        ];
+        for src in &sources {
+            let fresh = run_module(&compile_source(src).unwrap()).unwrap();
+
+            let cold = Arc::new(DiskCache::open(&dir, 1 << 26).unwrap());
+            let cps = compile_source_cached(src, u64::MAX, cold.clone()).unwrap();
+            assert_eq!(cache_counts(&cold), vec![("Cps".into(), (0, 1, 1))]);
+            assert_eq!(run_module(&cps).unwrap().output, fresh.output);
+
+            let warm = Arc::new(DiskCache::open(&dir, 1 << 26).unwrap());
+            let cps = compile_source_cached(src, u64::MAX, warm.clone()).unwrap();
+            assert_eq!(cache_counts(&warm), vec![("Cps".into(), (1, 0, 0))]);
+            let rerun = run_module(&cps).unwrap();
+            assert_eq!(
+                (rerun.result, rerun.output),
+                (fresh.result, fresh.output),
+                "{src}"
+            );
+        }
+
+        // Compile errors are not cached.
+        let broken = Arc::new(DiskCache::open(&dir, 1 << 26).unwrap());
+        assert!(compile_source_cached("const x = ;", u64::MAX, broken.clone()).is_err());
+        assert!(compile_source_cached("const x = ;", u64::MAX, broken.clone()).is_err());
+        assert_eq!(cache_counts(&broken), vec![("Cps".into(), (0, 2, 0))]);
+        std::fs::remove_dir_all(&dir).unwrap();
+    }
+
+    #[test]
+    fn cached_multi_file_compile_reuses_unchanged_modules() {
+        let dir = temp_cache_dir("multi");
+        let main = "import { Point } from \"./point.kb\"; import { add } from \"./math.kb\";
+                    const p = Point { x: 10, y: 20 }; print(add(p.x, p.y).to_string());";
+        let math = "export const add = |a: Int64, b: Int64| -> Int64 { return a + b; };";
+        let point = "export struct Point { x: Int64, y: Int64 };";
+        let build = |main: &str, math: &str| {
+            let mut loader = MemLoader::new();
+            loader.insert("main.kb", main);
+            loader.insert("math.kb", math);
+            loader.insert("point.kb", point);
+            let cache = Arc::new(DiskCache::open(&dir, 1 << 26).unwrap());
+            let cps = compile_file_cached("main.kb", Arc::new(loader), cache.clone()).unwrap();
+            (run_module(&cps).unwrap().output, cache_counts(&cache))
+        };
+        let counts = |cps: (u64, u64, u64), exports: (u64, u64, u64)| {
+            vec![
+                ("Cps".to_string(), cps),
+                ("ExportTable".to_string(), exports),
+            ]
+        };
+
+        let (out, stats) = build(main, math);
+        assert_eq!(out, vec!["30"]);
+        assert_eq!(stats, counts((0, 3, 3), (0, 0, 3)));
+
+        let (out, stats) = build(main, math);
+        assert_eq!(out, vec!["30"]);
+        assert_eq!(stats, counts((3, 0, 0), (3, 0, 0)));
+
+        // A body edit that keeps `add`'s type: only math.kb recompiles.
+        let math2 = "export const add = |a: Int64, b: Int64| -> Int64 { return a + b + 1; };";
+        let (out, stats) = build(main, math2);
+        assert_eq!(out, vec!["31"]);
+        assert_eq!(stats, counts((2, 1, 1), (2, 0, 1)));
+
+        // An edit to the entry module leaves its dependencies cached.
+        let main2 = main.replace("x: 10", "x: 12");
+        let (out, stats) = build(&main2, math2);
+        assert_eq!(out, vec!["33"]);
+        assert_eq!(stats, counts((2, 1, 1), (2, 0, 1)));
+        std::fs::remove_dir_all(&dir).unwrap();
+    }
+
+    /// Struct ids in a cached export table must keep their meaning in the
+    /// process that loads them. Each build runs in a fresh test process, so
+    /// a per-process counter would hand `Other` the id `Point` was cached with.
+    #[test]
+    fn cached_struct_ids_hold_across_processes() {
+        const STEP: &str = "KAUBO_TEST_CACHE_STEP";
+        const DIR: &str = "KAUBO_TEST_CACHE_DIR";
+        let point = "export struct Point { x: Int64, y: Int64 };
+                     export const mk = |v: Int64| -> Point { return Point { x: v, y: v }; };";
+        let good = "import { Point, mk } from \"./point.kb\";
+                    const f = |p: Point| -> Int64 { return p.x; };
+                    print(f(mk(1)).to_string());";
+        let bad = "import { mk } from \"./point.kb\";
+                   struct Other { s: String, n: Int64 };
+                   const f = |o: Other| -> Int64 { return o.n; };
+                   print(f(mk(1)).to_string());";
+
+        if let (Ok(step), Ok(dir)) = (std::env::var(STEP), std::env::var(DIR)) {
+            let mut loader = MemLoader::new();
+            loader.insert("main.kb", if step == "good" { good } else { bad });
+            loader.insert("point.kb", point);
+            let cache = Arc::new(DiskCache::open(dir, 1 << 26).unwrap());
+            let result = compile_file_cached("main.kb", Arc::new(loader), cache.clone());
+            if step == "good" {
+                assert_eq!(run_module(&result.unwrap()).unwrap().output, vec!["1"]);
+            } else {
+                let err = result.unwrap_err().to_string();
+                assert!(err.contains("cannot unify"), "{err}");
+                let cps = cache_counts(&cache)
+                    .into_iter()
+                    .find(|(k, _)| k == "Cps")
+                    .unwrap();
+                assert_eq!(cps.1 .0, 1, "point.kb should come from the cache");
+            }
+            return;
+        }
+
+        let dir = temp_cache_dir("processes");
+        let child = |step: &str| {
+            std::process::Command::new(std::env::current_exe().unwrap())
+                .args(["--exact", "tests::cached_struct_ids_hold_across_processes"])
+                .env(STEP, step)
+                .env(DIR, &dir)
+                .output()
+                .unwrap()
+        };
+        for step in ["good", "bad"] {
+            let out = child(step);
+            let stdout = String::from_utf8_lossy(&out.stdout);
+            assert!(
+                out.status.success() && stdout.contains("1 passed"),
+                "{step}: {stdout}"
+            );
+        }
+        std::fs::remove_dir_all(&dir).unwrap();
+    }
 }
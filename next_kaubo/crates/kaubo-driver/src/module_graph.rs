@@ -1,14 +1,28 @@
 //! 模块依赖图——纯语法 DFS + 拓扑排序 + 循环检测。
 //!
 //! `ModuleGraph` 只做轻量 Parser 提取 import 语句——不涉及类型检查、
-//! CPS、缓存。图执行（`ModuleCompiler`）利用拓扑序按固定顺序编译。
+//! CPS、缓存。图执行由 DAG 上的 `PerModuleCpsFetcher` 完成：每个模块等它的
+//! 导入编译完就开始，互不依赖的模块并行编译。
+//!
+//! 解析结果以 arena 形式（`kaubo_ast::arena::Ast`）留在图里，编译阶段
+//! 直接降级复用，每个模块只解析一次。
+//!
+//! 构建分两步：预取阶段用若干线程并行读取、解析入口的整个 import 闭包
+//! （每个模块解析完就把它的依赖放进队列）；随后的 DFS 只在内存里排拓扑序、
+//! 查循环，不再碰 IO。
 
 use crate::export_table::RawImport;
 use crate::module_loader::ModuleLoader;
 use crate::protocol::BuildError;
-use kaubo_ast::{Module, Stmt};
+use kaubo_ast::arena::{Ast, StmtNode};
+use kaubo_ast::Module;
 use kaubo_syntax::parser::Parser;
-use std::collections::{HashMap, HashSet};
+use kaubo_vfs::{FileMeta, SourceFile, SourceText};
+use std::collections::{HashMap, HashSet, VecDeque};
+use std::sync::{Arc, Condvar, Mutex};
+
+/// 预取阶段最多使用的线程数。
+const PREFETCH_THREADS: usize = 8;
 
 /// 模块依赖图。
 ///
@@ -17,12 +31,16 @@ use std::collections::{HashMap, HashSet};
 pub struct ModuleGraph {
     /// 拓扑序（叶子→根），保证每个模块在被编译时其依赖已就绪。
     pub order: Vec<String>,
-    /// 路径 → 源码
-    pub sources: HashMap<String, String>,
+    /// 路径 → 源码（与 loader 共享缓冲区）
+    pub sources: HashMap<String, SourceText>,
+    /// 路径 → 文件元数据（大小、mtime、内容哈希）
+    pub meta: HashMap<String, FileMeta>,
     /// 路径 → 原始导入列表
     pub imports: HashMap<String, Vec<RawImport>>,
     /// 路径 → 直接依赖路径列表
     pub deps: HashMap<String, Vec<String>>,
+    /// 路径 → 图发现阶段解析出的 arena AST
+    pub asts: HashMap<String, Arc<Ast>>,
 }
 
 impl ModuleGraph {
@@ -31,26 +49,46 @@ impl ModuleGraph {
     /// `entry` 是入口模块路径（相对于 loader）。
     /// `loader` 用于读取和解析路径。
     ///
-    /// DFS 遍历所有传递依赖，检测循环，生成拓扑序。
+    /// 并行预取所有传递依赖，再 DFS 检测循环，生成拓扑序。
     pub fn build(entry: &str, loader: &dyn ModuleLoader) -> Result<Self, BuildError> {
+        let threads = std::thread::available_parallelism()
+            .map_or(1, |n| n.get())
+            .min(PREFETCH_THREADS);
+        Self::build_with_threads(entry, loader, threads)
+    }
+
+    /// 同 `build`，预取阶段使用 `threads` 个线程（`<= 1` 时在当前线程完成）。
+    pub fn build_with_threads(
+        entry: &str,
+        loader: &dyn ModuleLoader,
+        threads: usize,
+    ) -> Result<Self, BuildError> {
+        let mut scanned = prefetch(entry, loader, threads);
         let mut graph = Self {
             order: Vec::new(),
             sources: HashMap::new(),
+            meta: HashMap::new(),
             imports: HashMap::new(),
             deps: HashMap::new(),
+            asts: HashMap::new(),
         };
         let mut visited = HashSet::new();
         let mut stack = Vec::new();
-        graph.dfs(entry, loader, &mut visited, &mut stack)?;
+        graph.dfs(entry, &mut scanned, &mut visited, &mut stack)?;
         // 后序即拓扑序（叶子在前），无需反转
         Ok(graph)
     }
 
-    /// 深度优先遍历。
+    /// 模块的 `Module` 树，由图里缓存的 arena 降级得到。
+    pub fn module(&self, path: &str) -> Option<Module> {
+        self.asts.get(path).map(|ast| ast.to_module())
+    }
+
+    /// 深度优先遍历预取结果。
     fn dfs(
         &mut self,
         path: &str,
-        loader: &dyn ModuleLoader,
+        scanned: &mut HashMap<String, Result<Scanned, BuildError>>,
         visited: &mut HashSet<String>,
         stack: &mut Vec<String>,
     ) -> Result<(), BuildError> {
@@ -67,27 +105,29 @@ impl ModuleGraph {
 
         stack.push(path.to_string());
 
-        // 读取源文件
-        let source = loader.read(path)?;
-
-        // ★ 仅语法解析——不涉及类型检查/CPS
-        let module = parse_for_imports(&source)?;
-
-        // 收集原始导入信息
-        let raw_imports = collect_raw_imports(&module);
+        // 读取、解析失败的模块在这里报错，与串行发现的报错顺序一致
+        let Scanned {
+            file,
+            ast,
+            imports,
+            deps,
+        } = scanned
+            .remove(path)
+            .unwrap_or_else(|| Err(BuildError::Bug(format!("module {path} was not prefetched"))))?;
 
         // 存储
-        self.sources.insert(path.to_string(), source);
-        self.imports.insert(path.to_string(), raw_imports.clone());
+        self.sources.insert(path.to_string(), file.text);
+        self.meta.insert(path.to_string(), file.meta);
+        self.asts.insert(path.to_string(), Arc::new(ast));
+        self.imports.insert(path.to_string(), imports);
 
-        // 对每个 import，解析路径，记录依赖，递归 DFS
-        for imp in &raw_imports {
-            let (dep_path, _) = loader.resolve(path, &imp.source_path)?;
+        // 记录依赖，递归 DFS
+        for dep_path in &deps {
             self.deps
                 .entry(path.to_string())
                 .or_default()
                 .push(dep_path.clone());
-            self.dfs(&dep_path, loader, visited, stack)?;
+            self.dfs(dep_path, scanned, visited, stack)?;
         }
 
         stack.pop();
@@ -97,19 +137,114 @@ impl ModuleGraph {
     }
 }
 
+// ── 预取 ──
+
+/// 预取阶段对单个模块的处理结果。
+struct Scanned {
+    file: SourceFile,
+    ast: Ast,
+    imports: Vec<RawImport>,
+    /// `imports` 逐条解析后的依赖路径
+    deps: Vec<String>,
+}
+
+/// 读取并解析一个模块，解析它的 import 路径。
+fn scan(path: &str, loader: &dyn ModuleLoader) -> Result<Scanned, BuildError> {
+    let file = loader.load(path)?;
+    // ★ 仅语法解析——不涉及类型检查/CPS
+    let ast = parse_for_imports(&file.text)?;
+    let imports = collect_raw_imports(&ast);
+    let deps = imports
+        .iter()
+        .map(|imp| loader.resolve(path, &imp.source_path).map(|(dep, _)| dep))
+        .collect::<Result<_, _>>()?;
+    Ok(Scanned {
+        file,
+        ast,
+        imports,
+        deps,
+    })
+}
+
+struct PrefetchState {
+    queue: VecDeque<String>,
+    seen: HashSet<String>,
+    /// 正在处理的模块数；队列空且为 0 时闭包已取完
+    busy: usize,
+    done: HashMap<String, Result<Scanned, BuildError>>,
+}
+
+/// 并行处理 `entry` 的整个 import 闭包。
+///
+/// 每个可达路径恰好 `scan` 一次；失败的模块不展开依赖，错误留给 DFS 报告。
+fn prefetch(
+    entry: &str,
+    loader: &dyn ModuleLoader,
+    threads: usize,
+) -> HashMap<String, Result<Scanned, BuildError>> {
+    let state = Mutex::new(PrefetchState {
+        queue: VecDeque::from([entry.to_string()]),
+        seen: HashSet::from([entry.to_string()]),
+        busy: 0,
+        done: HashMap::new(),
+    });
+    let changed = Condvar::new();
+    let work = || loop {
+        let path = {
+            let mut st = state.lock().unwrap();
+            loop {
+                if let Some(path) = st.queue.pop_front() {
+                    st.busy += 1;
+                    break path;
+                }
+                if st.busy == 0 {
+                    return;
+                }
+                st = changed.wait(st).unwrap();
+            }
+        };
+        let result = scan(&path, loader);
+        let mut st = state.lock().unwrap();
+        if let Ok(scanned) = &result {
+            for dep in &scanned.deps {
+                if st.seen.insert(dep.clone()) {
+                    st.queue.push_back(dep.clone());
+                }
+            }
+        }
+        st.done.insert(path, result);
+        st.busy -= 1;
+        drop(st);
+        changed.notify_all();
+    };
+    if threads <= 1 {
+        work();
+    } else {
+        std::thread::scope(|s| {
+            for _ in 1..threads {
+                s.spawn(work);
+            }
+            work();
+        });
+    }
+    state.into_inner().unwrap().done
+}
+
 /// 仅解析源码为 AST（纯语法，不做类型推导/CPS）。
 ///
 /// 注意：图发现阶段可能遇到导入 struct 的字面量语法（如 `Point { x: 1 }`），
 /// 此时 parser 尚未知道 Point 是 struct。为容忍此情况，
 /// 使用文本扫描预先收集 struct 定义名称并注册到 parser。
-fn parse_for_imports(source: &str) -> Result<Module, BuildError> {
+fn parse_for_imports(source: &str) -> Result<Ast, BuildError> {
     let mut parser = Parser::new(source);
     // 预扫描 struct 定义——收集文件中定义的 struct 名称
     let struct_names = scan_struct_defs(source);
     for name in &struct_names {
         parser.register_struct_name(name);
     }
-    parser.parse().map_err(|e| BuildError::Parse(e.to_string()))
+    parser
+        .parse_ast()
+        .map_err(|e| BuildError::Parse(e.to_string()))
 }
 
 /// 文本扫描——提取源文件中 `struct Name { ... }` 的名称。
@@ -157,17 +292,19 @@ fn scan_struct_defs(source: &str) -> Vec<String> {
 /// 目前支持两种 import 形式：
 /// - `import { names } from "path"` → RawImport { names: [...], source_path: "path" }
 /// - `import "path" [as alias]` → 对带 alias 的不产生 RawImport（整个模块导入按 alias 使用）
-pub fn collect_raw_imports(module: &Module) -> Vec<RawImport> {
-    module
-        .stmts
+pub fn collect_raw_imports(ast: &Ast) -> Vec<RawImport> {
+    ast.roots()
         .iter()
-        .filter_map(|stmt| match stmt {
-            Stmt::Import { path, names, .. } if !names.is_empty() => Some(RawImport {
-                names: names.clone(),
-                source_path: path.clone(),
+        .filter_map(|&stmt| match ast[stmt] {
+            StmtNode::Import { path, names, .. } if !names.is_empty() => Some(RawImport {
+                names: ast[names]
+                    .iter()
+                    .map(|&n| ast.name(n).to_string())
+                    .collect(),
+                source_path: ast.name(path).to_string(),
             }),
             // 整个模块导入（`import "path" as alias`）：暂不处理，Phase 3b 不做通配符
-            Stmt::Import { .. } => None,
+            StmtNode::Import { .. } => None,
             _ => None,
         })
         .collect()
@@ -252,12 +389,127 @@ mod tests {
         assert!(err.to_string().contains("missing"));
     }
 
+    #[test]
+    fn graph_keeps_each_module_ast() {
+        let mut loader = MemLoader::new();
+        loader.insert(
+            "main.kb",
+            "import { a } from \"./math.kb\";\nprint(a.to_string());",
+        );
+        loader.insert("math.kb", "export const a = 1;");
+
+        let graph = ModuleGraph::build("main.kb", &loader).unwrap();
+        for path in &graph.order {
+            let expected = Parser::new(&graph.sources[path]).parse().unwrap();
+            assert_eq!(graph.module(path), Some(expected));
+        }
+        assert!(graph.module("other.kb").is_none());
+    }
+
     #[test]
     fn collect_raw_imports_extracts_named_imports() {
-        let module = parse_for_imports("import { a, b } from \"./math.kb\";").unwrap();
-        let raw = collect_raw_imports(&module);
+        let ast = parse_for_imports("import { a, b } from \"./math.kb\";").unwrap();
+        let raw = collect_raw_imports(&ast);
         assert_eq!(raw.len(), 1);
         assert_eq!(raw[0].names, vec!["a", "b"]);
         assert_eq!(raw[0].source_path, "./math.kb");
     }
+
+    /// 统计 `load` 次数的 loader。
+    struct CountingLoader {
+        inner: MemLoader,
+        loads: Mutex<HashMap<String, usize>>,
+    }
+
+    impl ModuleLoader for CountingLoader {
+        fn read(&self, path: &str) -> Result<String, BuildError> {
+            self.inner.read(path)
+        }
+
+        fn load(&self, path: &str) -> Result<SourceFile, BuildError> {
+            *self
+                .loads
+                .lock()
+                .unwrap()
+                .entry(path.to_string())
+                .or_default() += 1;
+            self.inner.load(path)
+        }
+
+        fn resolve(&self, from: &str, import_path: &str) -> Result<(String, String), BuildError> {
+            self.inner.resolve(from, import_path)
+        }
+    }
+
+    /// 4 层、每层 6 个模块，每个模块导入上一层的两个模块。
+    fn layered_loader() -> CountingLoader {
+        let mut inner = MemLoader::new();
+        let mut main = String::new();
+        for layer in 0..4 {
+            for i in 0..6 {
+                let mut src = String::new();
+                if layer > 0 {
+                    for dep in [i, (i + 1) % 6] {
+                        src += &format!(
+                            "import {{ v{} }} from \"./m{}_{dep}.kb\";\n",
+                            layer - 1,
+                            layer - 1
+                        );
+                    }
+                }
+                src += &format!("export const v{layer} = {i};\n");
+                inner.insert(&format!("m{layer}_{i}.kb"), &src);
+                if layer == 3 {
+                    main += &format!("import {{ v3 }} from \"./m3_{i}.kb\";\n");
+                }
+            }
+        }
+        inner.insert("main.kb", &main);
+        CountingLoader {
+            inner,
+            loads: Mutex::new(HashMap::new()),
+        }
+    }
+
+    #[test]
+    fn parallel_prefetch_matches_serial_build() {
+        let serial = ModuleGraph::build_with_threads("main.kb", &layered_loader(), 1).unwrap();
+        for threads in [2, 4, 8] {
+            let loader = layered_loader();
+            let graph = ModuleGraph::build_with_threads("main.kb", &loader, threads).unwrap();
+            assert_eq!(graph.order, serial.order);
+            assert_eq!(graph.deps, serial.deps);
+            assert_eq!(graph.sources, serial.sources);
+            assert_eq!(graph.meta, serial.meta);
+            // 每个模块恰好读取一次
+            let loads = loader.loads.lock().unwrap();
+            assert_eq!(loads.len(), 25);
+            assert!(loads.values().all(|&n| n == 1));
+        }
+        assert_eq!(serial.order.len(), 25);
+        assert_eq!(serial.order.last().unwrap(), "main.kb");
+    }
+
+    #[test]
+    fn parallel_prefetch_reports_missing_dependency() {
+        let mut loader = MemLoader::new();
+        loader.insert(
+            "main.kb",
+            "import { a } from \"./a.kb\"; import { b } from \"./gone.kb\";",
+        );
+        loader.insert("a.kb", "export const a = 1;");
+        let err = ModuleGraph::build_with_threads("main.kb", &loader, 4).unwrap_err();
+        assert!(err.to_string().contains("gone.kb"), "{err}");
+    }
+
+    #[test]
+    fn graph_records_content_hashes() {
+        let mut loader = MemLoader::new();
+        loader.insert("main.kb", "const x = 42;");
+        let graph = ModuleGraph::build("main.kb", &loader).unwrap();
+        assert_eq!(
+            graph.meta["main.kb"].hash,
+            kaubo_vfs::content_hash(b"const x = 42;")
+        );
+    }
 }
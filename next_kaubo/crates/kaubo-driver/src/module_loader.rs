@@ -4,9 +4,10 @@
 //! 内置两个实现：`FileLoader`（文件系统）和 `MemLoader`（内存，用于测试/WASM）。
 
 use crate::protocol::BuildError;
-use kaubo_vfs::{VfsError, VirtualFileSystem};
+use kaubo_vfs::{SourceFile, SourceText, VfsError, VirtualFileSystem};
 use std::collections::HashMap;
 use std::path::Path;
+use std::sync::Mutex;
 
 /// 模块加载器——解析路径并读取源文件。
 ///
@@ -15,6 +16,14 @@ pub trait ModuleLoader: Send + Sync {
     /// 读取 `path` 处的源文件内容。
     fn read(&self, path: &str) -> Result<String, BuildError>;
 
+    /// 读取源文件及其元数据，内容以共享缓冲区返回。
+    ///
+    /// `ModuleGraph` 经由此方法读取；默认实现包装 `read`。
+    fn load(&self, path: &str) -> Result<SourceFile, BuildError> {
+        self.read(path)
+            .map(|text| SourceFile::new(text.into(), None))
+    }
+
     /// 解析 import 路径。
     ///
     /// `from` 是包含 import 语句的模块路径，
@@ -29,31 +38,54 @@ pub trait ModuleLoader: Send + Sync {
 // ── FileLoader：文件系统后端 ──
 
 /// 基于 `kaubo_vfs::VirtualFileSystem` 的文件加载器。
+///
+/// `resolve` 的结果按 `(所在目录, import 路径)` 记忆：同一目录下的模块
+/// 导入同一路径只规范化一次。
 pub struct FileLoader {
     vfs: Box<dyn VirtualFileSystem>,
+    resolved: Mutex<HashMap<(String, String), String>>,
 }
 
 impl FileLoader {
     /// 创建新的 FileLoader，使用给定的 VFS 实现。
     pub fn new(vfs: Box<dyn VirtualFileSystem>) -> Self {
-        Self { vfs }
+        Self {
+            vfs,
+            resolved: Mutex::new(HashMap::new()),
+        }
+    }
+}
+
+fn vfs_error(e: VfsError) -> BuildError {
+    match e {
+        VfsError::NotFound { path } => BuildError::Build(format!("module not found: {path}")),
+        VfsError::IoError { path, reason } => {
+            BuildError::Build(format!("io error reading {path}: {reason}"))
+        }
     }
 }
 
 impl ModuleLoader for FileLoader {
     fn read(&self, path: &str) -> Result<String, BuildError> {
-        self.vfs.read(path).map_err(|e| match e {
-            VfsError::NotFound { path } => BuildError::Build(format!("module not found: {path}")),
-            VfsError::IoError { path, reason } => {
-                BuildError::Build(format!("io error reading {path}: {reason}"))
-            }
-        })
+        self.vfs.read(path).map_err(vfs_error)
+    }
+
+    fn load(&self, path: &str) -> Result<SourceFile, BuildError> {
+        self.vfs.open(path).map_err(vfs_error)
     }
 
     fn resolve(&self, from: &str, import_path: &str) -> Result<(String, String), BuildError> {
-        let resolved = normalize_path(from, import_path);
+        let dir = Path::new(from)
+            .parent()
+            .and_then(Path::to_str)
+            .unwrap_or("");
+        let key = (dir.to_string(), import_path.to_string());
+        let mut resolved = self.resolved.lock().unwrap();
+        let path = resolved
+            .entry(key)
+            .or_insert_with(|| normalize_path(from, import_path));
         // canonical 目前与 resolved 相同
-        Ok((resolved.clone(), resolved))
+        Ok((path.clone(), path.clone()))
     }
 }
 
@@ -61,7 +93,7 @@ impl ModuleLoader for FileLoader {
 
 /// 基于内存 `HashMap` 的模块加载器。
 pub struct MemLoader {
-    files: HashMap<String, String>,
+    files: HashMap<String, SourceText>,
 }
 
 impl MemLoader {
@@ -74,7 +106,7 @@ impl MemLoader {
 
     /// 向加载器中添加模块源码。
     pub fn insert(&mut self, path: &str, source: &str) {
-        self.files.insert(path.to_string(), source.to_string());
+        self.files.insert(path.to_string(), source.into());
     }
 }
 
@@ -86,9 +118,13 @@ impl Default for MemLoader {
 
 impl ModuleLoader for MemLoader {
     fn read(&self, path: &str) -> Result<String, BuildError> {
+        self.load(path).map(|f| f.text.to_string())
+    }
+
+    fn load(&self, path: &str) -> Result<SourceFile, BuildError> {
         self.files
             .get(path)
-            .cloned()
+            .map(|text| SourceFile::new(text.clone(), None))
             .ok_or_else(|| BuildError::Build(format!("module not found in memory: {path}")))
     }
 
@@ -180,4 +216,28 @@ mod tests {
         assert_eq!(resolved, "math.kb");
         assert_eq!(canonical, "math.kb");
     }
+
+    #[test]
+    fn file_loader_memoizes_resolution_per_directory() {
+        let loader = FileLoader::new(Box::new(kaubo_vfs::MemVfs::new()));
+        let a = loader.resolve("src/a.kb", "../lib/math.kb").unwrap();
+        let b = loader.resolve("src/b.kb", "../lib/math.kb").unwrap();
+        assert_eq!(a.0, "lib/math.kb");
+        assert_eq!(a, b);
+        assert_eq!(loader.resolved.lock().unwrap().len(), 1);
+        // 不同目录下同一 import 字符串解析到不同位置
+        let c = loader.resolve("src/sub/c.kb", "../lib/math.kb").unwrap();
+        assert_eq!(c.0, "src/lib/math.kb");
+    }
+
+    #[test]
+    fn file_loader_load_shares_vfs_buffers() {
+        let mut vfs = kaubo_vfs::MemVfs::new();
+        vfs.insert("a.kb", "const a = 1;");
+        let loader = FileLoader::new(Box::new(vfs));
+        let (x, y) = (loader.load("a.kb").unwrap(), loader.load("a.kb").unwrap());
+        assert!(SourceText::ptr_eq(&x.text, &y.text));
+        assert_eq!(x.meta.hash, kaubo_vfs::content_hash(b"const a = 1;"));
+        assert!(loader.load("missing.kb").is_err());
+    }
 }
@@ -0,0 +1,363 @@
+//! Compiled-program handles for hosts that run Kaubo in slices.
+//!
+//! A host compiles once, keeps the returned id, and calls [`Programs::run`]
+//! with a fuel budget per slice: each call executes at most that many fuel
+//! units (back edges and calls, see `VM::time_slice`) and returns whatever was
+//! printed meanwhile, so the host can report progress, honour cancellation
+//! and stay responsive between slices (e.g. one slice per message when the
+//! table lives in a worker).
+//!
+//! [`Programs::bytecode`] is the `encode_module` encoding behind a 32-byte
+//! header laid out like `kaubo_dag::DiskCache` entries: `"KPG1"`, 4 reserved
+//! bytes, the payload length (u64 LE) and its FNV-1a 128 checksum. Hosts may
+//! cache it (IndexedDB) and [`Programs::load`] it later without recompiling;
+//! the header turns a torn or foreign blob into an error before it is
+//! decoded, and `LoadedProgram::new` bounds-checks what a well-formed one
+//! contains.
+
+use crate::{CpsModule, DriverError, LoadedProgram, RingSink};
+use kaubo_dag::persist::checksum;
+use kaubo_vm::{Completion, VM};
+use std::collections::HashMap;
+use std::sync::Arc;
+
+const MAGIC: &[u8; 4] = b"KPG1";
+const HEADER_LEN: usize = 32;
+
+pub type ProgramId = u32;
+
+/// What one [`Programs::run`] call produced.
+#[derive(Debug, Clone, PartialEq, Eq)]
+pub struct Slice {
+    /// The entry function returned; the next `run` starts over.
+    pub done: bool,
+    /// The entry function's return value once `done`.
+    pub result: i64,
+    /// `print` lines since the previous slice.
+    pub output: Vec<String>,
+}
+
+struct Entry {
+    program: Arc<LoadedProgram>,
+    bytecode: Vec<u8>,
+    instructions: usize,
+    /// The execution in progress, between a yielded slice and the next `run`.
+    vm: Option<Box<VM>>,
+}
+
+/// Handle table of loaded programs and their in-progress executions.
+pub struct Programs {
+    entries: HashMap<ProgramId, Entry>,
+    next_id: ProgramId,
+    /// `print` lines kept per slice; older lines are dropped.
+    pub max_lines: usize,
+    /// Total fuel of one execution (`VM::max_loop_iterations`).
+    pub max_loop_iterations: u64,
+}
+
+impl Default for Programs {
+    fn default() -> Self {
+        Self::new()
+    }
+}
+
+impl Programs {
+    pub fn new() -> Self {
+        Self {
+            entries: HashMap::new(),
+            next_id: 1,
+            max_lines: 10_000,
+            max_loop_iterations: u64::MAX,
+        }
+    }
+
+    /// Compile `source` and register the result.
+    pub fn compile(&mut self, source: &str) -> Result<ProgramId, DriverError> {
+        let cps = crate::compile_source(source)?;
+        if cps.functions.is_empty() {
+            return Err(DriverError::Build("no functions in compiled module".into()));
+        }
+        let bytecode = seal(&crate::encode_module(&cps));
+        self.insert(&cps, bytecode)
+    }
+
+    /// Register bytecode previously returned by [`Programs::bytecode`].
+    pub fn load(&mut self, bytes: &[u8]) -> Result<ProgramId, DriverError> {
+        let cps = crate::decode_module(unseal(bytes)?)?;
+        self.insert(&cps, bytes.to_vec())
+    }
+
+    fn insert(&mut self, cps: &CpsModule, bytecode: Vec<u8>) -> Result<ProgramId, DriverError> {
+        let program = crate::load_program(cps)?;
+        let id = self.next_id;
+        self.next_id = self.next_id.wrapping_add(1).max(1);
+        self.entries.insert(
+            id,
+            Entry {
+                program,
+                bytecode,
+                instructions: crate::instruction_count(cps),
+                vm: None,
+            },
+        );
+        Ok(id)
+    }
+
+    fn entry(&mut self, id: ProgramId) -> Result<&mut Entry, DriverError> {
+        self.entries
+            .get_mut(&id)
+            .ok_or_else(|| DriverError::Load(format!("unknown program {id}")))
+    }
+
+    /// The bytecode behind `id`, for caching.
+    pub fn bytecode(&self, id: ProgramId) -> Option<&[u8]> {
+        self.entries.get(&id).map(|e| e.bytecode.as_slice())
+    }
+
+    /// CPS instruction count of `id`.
+    pub fn instructions(&self, id: ProgramId) -> Option<usize> {
+        self.entries.get(&id).map(|e| e.instructions)
+    }
+
+    /// The loaded program behind `id` (e.g. to profile it).
+    pub fn program(&self, id: ProgramId) -> Option<Arc<LoadedProgram>> {
+        self.entries.get(&id).map(|e| e.program.clone())
+    }
+
+    /// Run `id` for at most `fuel` units (0 = to completion). Starts a fresh
+    /// execution unless the previous slice yielded, in which case it resumes.
+    /// A runtime error ends the execution.
+    pub fn run(&mut self, id: ProgramId, fuel: u64) -> Result<Slice, DriverError> {
+        let slice = if fuel == 0 { u64::MAX } else { fuel };
+        let (max_lines, max_loop_iterations) = (self.max_lines, self.max_loop_iterations);
+        let entry = self.entry(id)?;
+        let completion = match entry.vm.as_deref_mut() {
+            Some(vm) => {
+                vm.set_time_slice(slice);
+                vm.resume(None)
+            }
+            None => {
+                let Some(func) = entry.program.entry() else {
+                    return Ok(Slice {
+                        done: true,
+                        result: 0,
+                        output: Vec::new(),
+                    });
+                };
+                let mut vm = Box::new(VM::with_program(entry.program.clone()));
+                vm.sink = Box::new(RingSink::new(max_lines));
+                vm.max_loop_iterations = max_loop_iterations;
+                vm.time_slice = slice;
+                entry.vm.insert(vm).start(func, None)
+            }
+        };
+        let output = entry
+            .vm
+            .as_mut()
+            .map(|vm| vm.take_output())
+            .unwrap_or_default();
+        match completion {
+            Ok(Completion::Yielded) => Ok(Slice {
+                done: false,
+                result: 0,
+                output,
+            }),
+            Ok(Completion::Done(result)) => {
+                entry.vm = None;
+                Ok(Slice {
+                    done: true,
+                    result,
+                    output,
+                })
+            }
+            Err(e) => {
+                entry.vm = None;
+                Err(DriverError::Runtime(format!("{e:?}")))
+            }
+        }
+    }
+
+    /// Abandon the execution in progress; the next `run` starts over.
+    pub fn reset(&mut self, id: ProgramId) -> Result<(), DriverError> {
+        self.entry(id)?.vm = None;
+        Ok(())
+    }
+
+    /// Drop `id` and its execution. Unknown ids are ignored.
+    pub fn release(&mut self, id: ProgramId) {
+        self.entries.remove(&id);
+    }
+
+    pub fn len(&self) -> usize {
+        self.entries.len()
+    }
+
+    pub fn is_empty(&self) -> bool {
+        self.entries.is_empty()
+    }
+}
+
+/// `payload` behind the bytecode header (see the module docs).
+fn seal(payload: &[u8]) -> Vec<u8> {
+    let mut bytes = Vec::with_capacity(HEADER_LEN + payload.len());
+    bytes.extend_from_slice(MAGIC);
+    bytes.extend_from_slice(&[0; 4]);
+    bytes.extend_from_slice(&(payload.len() as u64).to_le_bytes());
+    bytes.extend_from_slice(&checksum(payload).to_le_bytes());
+    bytes.extend_from_slice(payload);
+    bytes
+}
+
+/// The payload of sealed `bytes`, once its length and checksum agree.
+fn unseal(bytes: &[u8]) -> Result<&[u8], DriverError> {
+    if bytes.len() < HEADER_LEN || &bytes[..4] != MAGIC {
+        return Err(DriverError::Decode("not program bytecode".into()));
+    }
+    let len = u64::from_le_bytes(bytes[8..16].try_into().unwrap());
+    let sum = u128::from_le_bytes(bytes[16..32].try_into().unwrap());
+    let payload = &bytes[HEADER_LEN..];
+    if len != payload.len() as u64 {
+        return Err(DriverError::Decode(format!(
+            "bytecode truncated: {} of {len} bytes",
+            payload.len()
+        )));
+    }
+    if checksum(payload) != sum {
+        return Err(DriverError::Decode("bytecode checksum mismatch".into()));
+    }
+    Ok(payload)
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    const COUNTDOWN: &str =
+        "var i = 0;\nwhile (i < 5) {\n    print(i.to_string());\n    i = i + 1;\n};";
+
+    fn run_to_end(programs: &mut Programs, id: ProgramId, fuel: u64) -> (usize, Vec<String>) {
+        let mut slices = 0;
+        let mut output = Vec::new();
+        loop {
+            let slice = programs.run(id, fuel).unwrap();
+            slices += 1;
+            output.extend(slice.output);
+            if slice.done {
+                return (slices, output);
+            }
+        }
+    }
+
+    #[test]
+    fn programs_can_move_between_threads() {
+        fn assert_send<T: Send>() {}
+        assert_send::<Programs>();
+    }
+
+    #[test]
+    fn fuel_slices_stream_output_and_resume() {
+        let mut programs = Programs::new();
+        let id = programs.compile(COUNTDOWN).unwrap();
+        assert!(programs.instructions(id).unwrap() > 0);
+
+        let (slices, output) = run_to_end(&mut programs, id, 0);
+        assert_eq!(slices, 1);
+        assert_eq!(output, vec!["0", "1", "2", "3", "4"]);
+
+        let (slices, output) = run_to_end(&mut programs, id, 2);
+        assert!(slices > 1, "a small budget should yield");
+        assert_eq!(output, vec!["0", "1", "2", "3", "4"]);
+    }
+
+    #[test]
+    fn bytecode_round_trips_through_load() {
+        let mut programs = Programs::new();
+        let id = programs.compile(COUNTDOWN).unwrap();
+        let bytes = programs.bytecode(id).unwrap().to_vec();
+        programs.release(id);
+        assert!(programs.is_empty());
+
+        let loaded = programs.load(&bytes).unwrap();
+        assert_ne!(loaded, id);
+        let (_, output) = run_to_end(&mut programs, loaded, 3);
+        assert_eq!(output.len(), 5);
+        assert!(programs.load(b"not bytecode").is_err());
+    }
+
+    #[test]
+    fn damaged_bytecode_is_rejected_before_decoding() {
+        let mut programs = Programs::new();
+        let id = programs.compile(COUNTDOWN).unwrap();
+        let bytes = programs.bytecode(id).unwrap().to_vec();
+
+        for at in [0, 8, 16, HEADER_LEN, bytes.len() - 1] {
+            let mut flipped = bytes.clone();
+            flipped[at] ^= 0x40;
+            assert!(programs.load(&flipped).is_err(), "bit flip at {at}");
+        }
+        for len in [0, HEADER_LEN - 1, HEADER_LEN, bytes.len() - 1] {
+            assert!(programs.load(&bytes[..len]).is_err(), "truncated to {len}");
+        }
+        // a huge declared length fails on the header, not on an allocation
+        let mut huge = bytes.clone();
+        huge[8..16].copy_from_slice(&u64::MAX.to_le_bytes());
+        assert!(matches!(programs.load(&huge), Err(DriverError::Decode(_))));
+        assert_eq!(programs.len(), 1);
+    }
+
+    /// A resealed payload passes the checksum, so anything the codec or the
+    /// loader accepts must be safe to run: mutate every byte and run whatever
+    /// still loads.
+    #[test]
+    fn resealed_mutations_load_or_fail_cleanly() {
+        let mut programs = Programs::new();
+        programs.max_loop_iterations = 1_000;
+        let id = programs.compile(COUNTDOWN).unwrap();
+        let payload = unseal(programs.bytecode(id).unwrap()).unwrap().to_vec();
+        for at in 0..payload.len() {
+            for bits in [0x01, 0x80, 0xFF] {
+                let mut mutated = payload.clone();
+                mutated[at] ^= bits;
+                if let Ok(id) = programs.load(&seal(&mutated)) {
+                    let _ = programs.run(id, 0);
+                    programs.release(id);
+                }
+            }
+        }
+        let err = programs
+            .load(&seal(&payload[..payload.len() / 2]))
+            .unwrap_err();
+        assert!(matches!(err, DriverError::Decode(_)));
+    }
+
+    #[test]
+    fn handles_are_independent_and_reset() {
+        let mut programs = Programs::new();
+        let a = programs.compile(COUNTDOWN).unwrap();
+        let b = programs.compile("print(\"b\");").unwrap();
+        assert!(!programs.run(a, 2).unwrap().done);
+        assert_eq!(programs.run(b, 2).unwrap().output, vec!["b"]);
+
+        programs.reset(a).unwrap();
+        let first = programs.run(a, 0).unwrap();
+        assert!(first.done);
+        assert_eq!(first.output.first().map(String::as_str), Some("0"));
+
+        assert!(programs.run(99, 0).is_err());
+        assert!(programs.compile("var x = ;").is_err());
+    }
+
+    #[test]
+    fn total_fuel_still_bounds_resumed_runs() {
+        let mut programs = Programs::new();
+        programs.max_loop_iterations = 3;
+        let id = programs
+            .compile("var i = 0;\nwhile (true) {\n    i = i + 1;\n};")
+            .unwrap();
+        let mut result = programs.run(id, 1);
+        while let Ok(Slice { done: false, .. }) = result {
+            result = programs.run(id, 1);
+        }
+        assert!(matches!(result, Err(DriverError::Runtime(_))));
+    }
+}
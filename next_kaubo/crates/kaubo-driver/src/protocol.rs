@@ -3,6 +3,7 @@
 //! Stage/Pipeline are retained for backward compat (LSP uses Stage directly).
 
 use kaubo_ir::cps::CpsModule;
+use kaubo_ir::pass::FunctionPass;
 use kaubo_log::EventHandler;
 use std::fmt;
 
@@ -32,22 +33,97 @@ impl Pass for std::sync::Arc<dyn Pass> {
 }
 
 /// Ordered pipeline of passes. Uses `Arc` so the pipeline is cheap to clone.
+///
+/// Function passes run across up to `threads()` threads, one function at a
+/// time per thread; module passes run on the calling thread and are barriers
+/// between them. On a [`kaubo_dag::PoolSpawner`] worker function passes
+/// stay on the calling thread too, since the pool already fills the cores.
 #[derive(Default, Clone)]
 pub struct Pipeline {
-    passes: Vec<std::sync::Arc<dyn Pass>>,
+    steps: Vec<Step>,
+    /// 0 = one per available core.
+    threads: usize,
+}
+
+#[derive(Clone)]
+enum Step {
+    Module(std::sync::Arc<dyn Pass>),
+    Function(std::sync::Arc<dyn FunctionPass + Send + Sync>),
 }
 
 impl Pipeline {
-    pub fn new() -> Self { Self { passes: vec![] } }
+    pub fn new() -> Self {
+        Self::default()
+    }
     #[allow(clippy::should_implement_trait)]
     pub fn add(mut self, pass: impl Pass + 'static) -> Self {
-        self.passes.push(std::sync::Arc::new(pass));
+        self.steps.push(Step::Module(std::sync::Arc::new(pass)));
+        self
+    }
+    /// Adds a pass that may run on several functions at once.
+    pub fn add_function(mut self, pass: impl FunctionPass + Send + 'static) -> Self {
+        self.steps.push(Step::Function(std::sync::Arc::new(pass)));
+        self
+    }
+    /// Caps the threads function passes use; 1 keeps everything on the
+    /// calling thread.
+    pub fn with_threads(mut self, threads: usize) -> Self {
+        self.threads = threads;
         self
     }
+    pub fn threads(&self) -> usize {
+        match self.threads {
+            0 => std::thread::available_parallelism().map_or(1, |n| n.get()),
+            n => n,
+        }
+    }
     pub fn run(&self, module: &mut CpsModule, events: Option<&dyn EventHandler>) {
-        for pass in &self.passes { pass.run(module, events); }
+        #[cfg(not(target_arch = "wasm32"))]
+        let threads = if kaubo_dag::pool::on_worker() {
+            1
+        } else {
+            self.threads()
+        };
+        #[cfg(target_arch = "wasm32")]
+        let threads = self.threads();
+        for step in &self.steps {
+            match step {
+                Step::Module(pass) => pass.run(module, events),
+                Step::Function(pass) => {
+                    kaubo_ir::pass::run_function_pass(module, &**pass, threads, events)
+                }
+            }
+        }
+    }
+    pub fn is_empty(&self) -> bool {
+        self.steps.is_empty()
+    }
+    /// One single-pass pipeline per step, in order and with the same thread
+    /// cap. Running them back to back is the same as `run`; the per-stage
+    /// benchmark uses this to time each pass on its own.
+    pub fn split(&self) -> Vec<Pipeline> {
+        self.steps
+            .iter()
+            .map(|step| Pipeline {
+                steps: vec![step.clone()],
+                threads: self.threads,
+            })
+            .collect()
+    }
+    /// Pass names in order — what a persisted artifact records about the
+    /// pipeline that produced it. The thread count is left out: function
+    /// passes produce the same module on any number of threads.
+    pub fn fingerprint(&self) -> String {
+        let names: Vec<&str> = self
+            .steps
+            .iter()
+            .map(|step| match step {
+                Step::Module(pass) => pass.name(),
+                Step::Function(pass) => pass.name(),
+            })
+            .collect();
+        names.join(",")
     }
-    pub fn is_empty(&self) -> bool { self.passes.is_empty() }
 }
 
 /// Errors that can occur during a build.
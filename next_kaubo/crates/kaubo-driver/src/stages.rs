@@ -35,14 +35,19 @@ pub struct SemanticArtifact {
 
 pub struct SemanticStage;
 
-impl Stage<Module, SemanticArtifact> for SemanticStage {
+/// Borrows the AST: infer only reads it, so callers keep ownership.
+impl Stage<&Module, SemanticArtifact> for SemanticStage {
     fn name(&self) -> &str {
         "semantic"
     }
 
-    fn execute(&self, module: Module, _ctx: &BuildContext) -> Result<SemanticArtifact, BuildError> {
+    fn execute(
+        &self,
+        module: &Module,
+        _ctx: &BuildContext,
+    ) -> Result<SemanticArtifact, BuildError> {
         let (type_env, struct_fields) =
-            kaubo_infer::infer_module(&module).map_err(|e| BuildError::Infer(e.msg))?;
+            kaubo_infer::infer_module(module).map_err(|e| BuildError::Infer(e.msg))?;
 
         Ok(SemanticArtifact {
             type_env,
@@ -60,8 +65,9 @@ struct IrPassAdapter<T: kaubo_ir::pass::Pass> {
 
 impl<T: kaubo_ir::pass::Pass + Send + Sync> crate::protocol::Pass for IrPassAdapter<T> {
     fn name(&self) -> &str { self.inner.name() }
-    fn run(&self, module: &mut CpsModule, _events: Option<&dyn kaubo_log::EventHandler>) {
-        self.inner.run(module);
+    /// Runs through `run_passes`, so the pass reports start / size / finish events.
+    fn run(&self, module: &mut CpsModule, events: Option<&dyn kaubo_log::EventHandler>) {
+        kaubo_ir::pass::run_passes(module, &[&self.inner as &dyn kaubo_ir::pass::Pass], events);
     }
 }
 
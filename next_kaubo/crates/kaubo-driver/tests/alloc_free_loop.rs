@@ -0,0 +1,89 @@
+//! 循环体内零堆分配：用计数分配器跑 `loop` 基准、native 调用循环和字符串字面量循环。
+//!
+//! 同一程序只改循环上界，执行期间的分配次数必须相同 —— 任何随迭代次数
+//! 增长的分配（例如绑定块参数、收集 native 实参时临时构造的 `Vec`、
+//! 每次执行字符串字面量都新建的堆对象）都会让两者不等。
+//! 本文件只含一个测试，避免并行测试互相污染计数。
+
+use std::alloc::{GlobalAlloc, Layout, System};
+use std::sync::atomic::{AtomicUsize, Ordering};
+
+struct CountingAlloc;
+
+static ALLOCS: AtomicUsize = AtomicUsize::new(0);
+
+unsafe impl GlobalAlloc for CountingAlloc {
+    unsafe fn alloc(&self, layout: Layout) -> *mut u8 {
+        ALLOCS.fetch_add(1, Ordering::Relaxed);
+        System.alloc(layout)
+    }
+
+    unsafe fn dealloc(&self, ptr: *mut u8, layout: Layout) {
+        System.dealloc(ptr, layout)
+    }
+
+    unsafe fn realloc(&self, ptr: *mut u8, layout: Layout, new_size: usize) -> *mut u8 {
+        ALLOCS.fetch_add(1, Ordering::Relaxed);
+        System.realloc(ptr, layout, new_size)
+    }
+}
+
+#[global_allocator]
+static GLOBAL: CountingAlloc = CountingAlloc;
+
+const NATIVE_LOOP: &str = "
+var total = 0.0; var i = 0;
+while (i < 200) { total = total + sqrt(4.0); assert(i < 1000); i = i + 1; };
+print(total.to_string());
+";
+
+const STRING_LITERAL_LOOP: &str = "
+var s = \"\"; var i = 0;
+while (i < 200) { s = \"tick\"; i = i + 1; };
+print(s);
+";
+
+/// 编译并执行 `src`（上界 200 替换为 `bound`），返回 `execute` 期间的分配次数。
+fn allocs_during_execute(src: &str, bound: u32, mode: kaubo_vm::DispatchMode) -> usize {
+    let src = src.replace("200", &bound.to_string());
+    let cps = kaubo_driver::compile_source(&src).unwrap();
+    let entry = cps.functions.len() - 1;
+    let mut vm = kaubo_vm::VM::new();
+    vm.dispatch = mode;
+    vm.load(&cps).unwrap();
+    // 编译本身会分配：第一条回边就编译，两种上界下都发生一次。
+    // 看 VM 实际的 JIT 状态，而不是本 crate 的 feature（`kaubo-vm/jit` 可以单独打开）
+    if kaubo_vm::JIT_ENABLED {
+        vm.set_jit_threshold(1);
+    }
+
+    let before = ALLOCS.load(Ordering::Relaxed);
+    vm.execute(entry, cps.functions[entry].reg_count, None)
+        .unwrap();
+    ALLOCS.load(Ordering::Relaxed) - before
+}
+
+#[test]
+fn loop_benchmark_allocates_nothing_per_iteration() {
+    let suites = [
+        (
+            "loop",
+            include_str!("../../../ops/benchmark/suites/loop/main.kb"),
+        ),
+        ("native", NATIVE_LOOP),
+        ("string literal", STRING_LITERAL_LOOP),
+    ];
+    for (name, src) in suites {
+        for mode in [
+            kaubo_vm::DispatchMode::Decoded,
+            kaubo_vm::DispatchMode::Encoded,
+        ] {
+            let small = allocs_during_execute(src, 10, mode);
+            let large = allocs_during_execute(src, 100, mode);
+            assert_eq!(
+                small, large,
+                "{name} {mode:?}: allocations grow with iteration count ({small} vs {large})"
+            );
+        }
+    }
+}
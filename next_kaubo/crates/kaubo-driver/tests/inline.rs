@@ -0,0 +1,148 @@
+//! Inline：同一程序带 / 不带内联编译，输出必须一致，且带内联时实际执行的
+//! Call 指令更少；多文件程序在链接之后内联导入的函数。
+
+use kaubo_driver::module_loader::MemLoader;
+use kaubo_driver::{adapt_pass, DagCoordinator, Pipeline, ProfileConfig, RingSink};
+use kaubo_ir::cps::{CpsModule, CpsTerminator};
+use kaubo_ir::pass::{
+    empty_block::EmptyBlockElim, fold::ConstantFold, inline::Inline, move_fold::MoveFold,
+    reg_alloc::RegAlloc,
+};
+use kaubo_vm::Opcode;
+use std::sync::Arc;
+
+/// 循环里调用小 lambda：每次迭代一个 Call / Return。
+const HOT_CALL: &str = "
+const sq = |n: Int64| -> Int64 { return n * n; };
+const clamp = |x: Int64, hi: Int64| -> Int64 {
+    var r = x;
+    if (x > hi) { r = hi; };
+    return r;
+};
+var t = 0; var i = 0;
+while (i < 100) { t = t + clamp(sq(i), 2500); i = i + 1; };
+print(t.to_string());
+";
+
+/// 被调函数内部有循环：复制后的块 id 不能与调用者冲突。
+const LOOPING_CALLEE: &str = "
+const tri = |n: Int64| -> Int64 {
+    var s = 0; var k = 0;
+    while (k <= n) { s = s + k; k = k + 1; };
+    return s;
+};
+var total = 0; var j = 0;
+while (j < 30) { total = total + tri(j); j = j + 1; };
+print(total.to_string());
+";
+
+fn pipeline(inline: bool) -> Pipeline {
+    let p = Pipeline::new()
+        .add(adapt_pass(EmptyBlockElim))
+        .add(adapt_pass(MoveFold))
+        .add(adapt_pass(ConstantFold));
+    let p = if inline {
+        p.add(adapt_pass(Inline::default()))
+    } else {
+        p
+    };
+    p.add(adapt_pass(RegAlloc))
+}
+
+/// 返回输出和实际执行的 Call 指令数。
+fn run(cps: &CpsModule) -> (Vec<String>, u64) {
+    let program = kaubo_driver::load_program(cps).unwrap();
+    let config = ProfileConfig {
+        opcodes: true,
+        ..Default::default()
+    };
+    let (outcome, profile) =
+        kaubo_driver::profile_program(&program, u64::MAX, config, Box::new(RingSink::new(16)))
+            .unwrap();
+    let calls = profile
+        .opcode_counts()
+        .iter()
+        .filter(|&&(op, _)| op == Opcode::Call)
+        .map(|&(_, n)| n)
+        .sum();
+    (outcome.output, calls)
+}
+
+fn compile(source: &str, inline: bool) -> CpsModule {
+    DagCoordinator::with_pipeline(pipeline(inline))
+        .compile_source(source)
+        .unwrap()
+}
+
+fn assert_same_output_fewer_calls(source: &str, expected: &str) {
+    let (plain, plain_calls) = run(&compile(source, false));
+    let (inlined, inlined_calls) = run(&compile(source, true));
+    assert_eq!(plain, vec![expected]);
+    assert_eq!(inlined, plain);
+    assert!(plain_calls > 0);
+    assert_eq!(inlined_calls, 0, "plain executed {plain_calls} calls");
+}
+
+fn direct_calls(cps: &CpsModule, callee: usize) -> usize {
+    cps.functions
+        .iter()
+        .flat_map(|f| &f.blocks)
+        .filter(|b| {
+            b.id != usize::MAX && matches!(b.term, CpsTerminator::Call(g, ..) if g == callee)
+        })
+        .count()
+}
+
+#[test]
+fn small_lambdas_in_a_loop_are_inlined() {
+    assert_same_output_fewer_calls(HOT_CALL, "165425");
+}
+
+#[test]
+fn looping_callee_is_inlined_with_fresh_blocks() {
+    assert_same_output_fewer_calls(LOOPING_CALLEE, "4495");
+}
+
+#[test]
+fn standard_pipeline_runs_inline() {
+    let cps = kaubo_driver::compile_source(HOT_CALL).unwrap();
+    let (output, calls) = run(&cps);
+    assert_eq!(output, vec!["165425"]);
+    assert_eq!(calls, 0);
+}
+
+fn math_loader() -> Arc<MemLoader> {
+    let mut loader = MemLoader::new();
+    loader.insert(
+        "main.kb",
+        "import { add } from \"./math.kb\";\n\
+         var s = 0; var i = 0;\n\
+         while (i < 10) { s = add(s, i); i = i + 1; };\n\
+         print(s.to_string());",
+    );
+    loader.insert(
+        "math.kb",
+        "export const add = |a: Int64, b: Int64| -> Int64 { return a + b; };",
+    );
+    Arc::new(loader)
+}
+
+#[test]
+fn imported_function_is_inlined_after_linking() {
+    let linked = |link: Option<Pipeline>| {
+        let loader = math_loader();
+        DagCoordinator::new_multifile_with_link("main.kb", loader.clone(), None, link)
+            .compile_file("main.kb", loader)
+            .unwrap()
+    };
+    let plain = linked(None);
+    let inlined = linked(Some(DagCoordinator::link_pipeline()));
+    let add = plain.symbol_map[&("math.kb".to_string(), "add".to_string())];
+    assert!(direct_calls(&plain, add) > 0);
+    assert_eq!(direct_calls(&inlined, add), 0);
+    assert_eq!(run(&inlined), (vec!["45".to_string()], 0));
+    assert_eq!(run(&plain).0, run(&inlined).0);
+
+    let outcome = kaubo_driver::run_file("main.kb", math_loader()).unwrap();
+    assert_eq!(outcome.output, vec!["45"]);
+}
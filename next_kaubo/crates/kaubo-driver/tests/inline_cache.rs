@@ -0,0 +1,67 @@
+//! `CallIndirect` 的内联缓存：多态调用点命中缓存，超出路数后退化为
+//! megamorphic，结果都与不带缓存的语义一致。
+
+const SHAPES: &str = r#"
+interface Shape { area: |self: Self| -> Int64; };
+struct Sq { s: Int64 };
+struct Rect { w: Int64, h: Int64 };
+impl Shape for Sq { area: |self: Sq| -> Int64 { return self.s * self.s; }; };
+impl Shape for Rect { area: |self: Rect| -> Int64 { return self.w * self.h; }; };
+const measure = |sh: Shape| -> Int64 { return sh.area(); };
+var total = 0; var i = 0;
+while (i < 100) {
+    if (i % 2 == 0) { total = total + measure(Sq { s: 2 }); };
+    if (i % 2 == 1) { total = total + measure(Rect { w: 2, h: 3 }); };
+    i = i + 1;
+};
+print(total.to_string());
+"#;
+
+fn run(source: &str) -> (Vec<String>, kaubo_vm::IcStats) {
+    let cps = kaubo_driver::compile_source(source).unwrap();
+    let program = kaubo_driver::load_program(&cps).unwrap();
+    let entry = program.entry().unwrap();
+    let mut vm = kaubo_vm::VM::with_program(program.clone());
+    vm.execute(entry, program.func_reg_counts[entry], None)
+        .unwrap();
+    (vm.take_output(), vm.ic.stats())
+}
+
+#[test]
+fn polymorphic_site_hits_after_one_miss_per_receiver() {
+    let (output, stats) = run(SHAPES);
+    assert_eq!(output, vec!["500"]);
+    assert_eq!(stats.sites, 1);
+    assert_eq!(stats.misses, 2);
+    assert_eq!(stats.hits, 98);
+    assert_eq!(stats.megamorphic, 0);
+}
+
+#[test]
+fn megamorphic_site_still_dispatches_correctly() {
+    // 比缓存路数多一种接收者
+    let kinds = kaubo_vm::inline_cache::POLY_WAYS + 1;
+    let mut src = String::from("interface Shape { area: |self: Self| -> Int64; };\n");
+    for k in 0..kinds {
+        src += &format!(
+            "struct S{k} {{ v: Int64 }};\n\
+             impl Shape for S{k} {{ area: |self: S{k}| -> Int64 {{ return self.v + {k}; }}; }};\n"
+        );
+    }
+    src += "const measure = |sh: Shape| -> Int64 { return sh.area(); };\n\
+            var total = 0; var i = 0;\nwhile (i < 50) {\n";
+    for k in 0..kinds {
+        src += &format!(
+            "    if (i % {kinds} == {k}) {{ total = total + measure(S{k} {{ v: i }}); }};\n"
+        );
+    }
+    src += "    i = i + 1;\n};\nprint(total.to_string());\n";
+
+    let (output, stats) = run(&src);
+    // Σ i + Σ (i % kinds)
+    let expected: usize = (0..50).map(|i| i + i % kinds).sum();
+    assert_eq!(output, vec![expected.to_string()]);
+    assert_eq!(stats.megamorphic, 1);
+    assert_eq!(stats.hits + stats.misses, 50);
+    assert!(stats.misses > kinds as u64);
+}
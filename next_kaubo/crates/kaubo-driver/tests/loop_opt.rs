@@ -0,0 +1,105 @@
+//! LoopInline：同一程序带 / 不带循环优化编译，输出必须一致，
+//! 且带优化时实际执行的指令数（profiler 的 opcode 直方图之和）更少。
+
+use kaubo_driver::{adapt_pass, DagCoordinator, Pipeline, ProfileConfig, RingSink};
+use kaubo_ir::pass::{
+    empty_block::EmptyBlockElim, fold::ConstantFold, loop_inline::LoopInline, move_fold::MoveFold,
+};
+
+const SIEVE: &str = "
+var count = 0; var p = 2;
+while (p <= 300) {
+    var d = 2; var prime = true;
+    while (d * d <= p) {
+        if (p % d == 0) { prime = false; };
+        d = d + 1;
+    };
+    if (prime) { count = count + 1; };
+    p = p + 1;
+};
+print(count.to_string());
+";
+
+/// `i * k` 的乘法在循环内有可削减的归纳变量。
+const SCALED: &str = "
+var total = 0; var i = 0; const k = 7;
+while (i < 500) {
+    total = total + i * k;
+    i = i + 3;
+};
+print(total.to_string());
+";
+
+/// 嵌套 for-in：内层列表长度与外层迭代无关。
+const NESTED_FOR: &str = "
+const xs = [1, 2, 3, 4];
+const ys = [10, 20, 30];
+var t = 0; var n = 0;
+while (n < 50) {
+    for (x in xs) { for (y in ys) { t = t + x * y; }; };
+    n = n + 1;
+};
+print(t.to_string());
+";
+
+fn pipeline(loops: bool) -> Pipeline {
+    let p = Pipeline::new()
+        .add(adapt_pass(EmptyBlockElim))
+        .add(adapt_pass(MoveFold))
+        .add(adapt_pass(ConstantFold));
+    if loops {
+        p.add(adapt_pass(LoopInline))
+    } else {
+        p
+    }
+}
+
+/// 返回输出和实际执行的指令数。
+fn run(source: &str, loops: bool) -> (Vec<String>, u64) {
+    let cps = DagCoordinator::with_pipeline(pipeline(loops))
+        .compile_source(source)
+        .unwrap();
+    let program = kaubo_driver::load_program(&cps).unwrap();
+    let config = ProfileConfig {
+        opcodes: true,
+        ..Default::default()
+    };
+    let (outcome, profile) =
+        kaubo_driver::profile_program(&program, u64::MAX, config, Box::new(RingSink::new(16)))
+            .unwrap();
+    let executed = profile.opcode_counts().iter().map(|&(_, n)| n).sum();
+    (outcome.output, executed)
+}
+
+fn assert_same_output_fewer_instructions(source: &str, expected: &str) {
+    let (plain, plain_instrs) = run(source, false);
+    let (opt, opt_instrs) = run(source, true);
+    assert_eq!(plain, vec![expected]);
+    assert_eq!(opt, plain);
+    assert!(
+        opt_instrs < plain_instrs,
+        "LoopInline executed {opt_instrs} instructions, plain {plain_instrs}"
+    );
+}
+
+#[test]
+fn sieve_hoists_loop_invariant_constants() {
+    assert_same_output_fewer_instructions(SIEVE, "62");
+}
+
+#[test]
+fn induction_product_is_strength_reduced() {
+    assert_same_output_fewer_instructions(SCALED, "291081");
+}
+
+#[test]
+fn nested_for_in_hoists_inner_list_len() {
+    assert_same_output_fewer_instructions(NESTED_FOR, "30000");
+}
+
+#[test]
+fn standard_pipeline_runs_loop_inline() {
+    let (expected, _) = run(SIEVE, true);
+    let outcome = kaubo_driver::run_source(SIEVE).unwrap();
+    assert_eq!(outcome.output, expected);
+}
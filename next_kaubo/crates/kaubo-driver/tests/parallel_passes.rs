@@ -0,0 +1,89 @@
+//! 函数级 pass 并行：同一程序用 1 个线程和多个线程跑标准流水线，
+//! 产出的函数和常量池必须逐字节一致，运行输出也一致。
+
+use kaubo_driver::{DagCoordinator, Pipeline};
+use kaubo_ir::cps::CpsModule;
+
+/// 足够多的 lambda，让流水线真的分到多个线程；每个都有可折叠的常量。
+fn source() -> String {
+    let mut src = String::new();
+    for i in 0..48 {
+        src.push_str(&format!(
+            "const f{i} = |x: Int64| -> Int64 {{ var s = 0; var j = 0; \
+             while (j < x) {{ s = s + j * {i} + (2 + {i}); j = j + 1; }}; return s; }};\n"
+        ));
+    }
+    src.push_str("var total = 0;\n");
+    for i in 0..48 {
+        src.push_str(&format!("total = total + f{i}({});\n", i % 5 + 1));
+    }
+    src.push_str("print(total.to_string());\n");
+    src
+}
+
+fn compile(threads: usize) -> CpsModule {
+    let pipeline = DagCoordinator::standard_pipeline().with_threads(threads);
+    DagCoordinator::with_pipeline(pipeline)
+        .compile_source(&source())
+        .unwrap()
+}
+
+fn output(cps: &CpsModule) -> Vec<String> {
+    let program = kaubo_driver::load_program(cps).unwrap();
+    kaubo_driver::run_program(&program, u64::MAX)
+        .unwrap()
+        .output
+}
+
+#[test]
+fn parallel_pipeline_matches_serial_pipeline() {
+    let serial = compile(1);
+    let parallel = compile(4);
+    assert!(serial.functions.len() >= 48);
+    assert_eq!(
+        format!("{:?}", serial.functions),
+        format!("{:?}", parallel.functions)
+    );
+    assert_eq!(
+        format!("{:?}", serial.constants),
+        format!("{:?}", parallel.constants)
+    );
+    let out = output(&serial);
+    assert_eq!(out.len(), 1);
+    assert_eq!(out, output(&parallel));
+}
+
+#[test]
+fn pipeline_threads_default_to_available_cores() {
+    assert!(Pipeline::new().threads() >= 1);
+    assert_eq!(Pipeline::new().with_threads(3).threads(), 3);
+}
+
+#[test]
+fn split_pipeline_runs_the_same_passes() {
+    let standard = DagCoordinator::standard_pipeline().with_threads(1);
+    let parts = standard.split();
+    assert_eq!(
+        parts
+            .iter()
+            .map(Pipeline::fingerprint)
+            .collect::<Vec<_>>()
+            .join(","),
+        standard.fingerprint()
+    );
+    let module = kaubo_syntax::parser::Parser::new(&source())
+        .parse()
+        .unwrap();
+    let mut whole = kaubo_ir::cps_build::build_module(&module, None).unwrap();
+    kaubo_ir::flatten::flatten_module(&mut whole);
+    let mut stepped = whole.clone();
+    standard.run(&mut whole, None);
+    for part in &parts {
+        assert_eq!(part.threads(), 1);
+        part.run(&mut stepped, None);
+    }
+    assert_eq!(
+        format!("{:?}", whole.functions),
+        format!("{:?}", stepped.functions)
+    );
+}
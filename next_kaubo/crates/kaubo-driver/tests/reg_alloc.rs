@@ -0,0 +1,122 @@
+//! RegAlloc：同一程序带 / 不带寄存器分配编译，输出必须一致，
+//! 且带分配时所有函数帧的寄存器总数（frame_size）更小。
+
+use kaubo_driver::{adapt_pass, DagCoordinator, Pipeline};
+use kaubo_ir::pass::{
+    empty_block::EmptyBlockElim, fold::ConstantFold, loop_inline::LoopInline, move_fold::MoveFold,
+    reg_alloc::RegAlloc,
+};
+
+/// 循环 + 块参数 + 乘法归纳变量。
+const LOOPS: &str = "
+var total = 0; var i = 0;
+while (i < 200) {
+    var j = 0;
+    while (j < 10) { total = total + i * j; j = j + 1; };
+    i = i + 1;
+};
+print(total.to_string());
+";
+
+/// 调用跨越活跃值：r0 与实参寄存器不能被占用。
+const CALLS: &str = "
+const mix = |a: Int64, b: Int64, c: Int64| -> Int64 {
+    const x = a * 2; const y = b * 3;
+    return x + y * c - a;
+};
+var s = 0; var k = 0;
+while (k < 20) {
+    const m = k * 3;
+    s = s + mix(m, s % 7, 5) + m + mix(k, 1, m);
+    k = k + 1;
+};
+print(s.to_string());
+";
+
+/// 调用结果写回 r0，第一个实参也在 r0：调用之后还要读得到它。
+const FIRST_ARG_AFTER_CALL: &str = "
+const f = |x: Int64, y: Int64| -> Int64 {
+    const h = |z: Int64| -> Int64 { return z * 100; };
+    const s = h(y);
+    return s + x;
+};
+print(f(2, 3).to_string());
+";
+
+/// 列表 / 元组从块参数取元素，结构体字段之后写入。
+const AGGREGATES: &str = "
+struct Point { x: Int64, y: Int64 }
+const a = 3; const b = 4;
+const xs = [a, b, a + b];
+const t = (a * b, xs[2]);
+const p = Point { x: a * b, y: xs[2] };
+var sum = 0;
+for (v in xs) { sum = sum + v; };
+print((sum + p.x + p.y).to_string());
+";
+
+fn compile(source: &str, alloc: bool) -> kaubo_ir::cps::CpsModule {
+    let p = Pipeline::new()
+        .add(adapt_pass(EmptyBlockElim))
+        .add(adapt_pass(MoveFold))
+        .add(adapt_pass(ConstantFold))
+        .add(adapt_pass(LoopInline));
+    let p = if alloc {
+        p.add(adapt_pass(RegAlloc))
+    } else {
+        p
+    };
+    DagCoordinator::with_pipeline(p)
+        .compile_source(source)
+        .unwrap()
+}
+
+fn run(cps: &kaubo_ir::cps::CpsModule) -> Vec<String> {
+    let program = kaubo_driver::load_program(cps).unwrap();
+    kaubo_driver::run_program(&program, u64::MAX)
+        .unwrap()
+        .output
+}
+
+fn assert_same_output_smaller_frames(source: &str, expected: &str) {
+    let plain = compile(source, false);
+    let packed = compile(source, true);
+    assert_eq!(run(&plain), vec![expected]);
+    assert_eq!(run(&packed), run(&plain));
+    let (before, after) = (
+        kaubo_driver::frame_size(&plain),
+        kaubo_driver::frame_size(&packed),
+    );
+    assert!(after < before, "frame_size {before} -> {after}");
+}
+
+#[test]
+fn loops_keep_output_with_fewer_registers() {
+    assert_same_output_smaller_frames(LOOPS, "895500");
+}
+
+#[test]
+fn calls_keep_arguments_and_results() {
+    assert_same_output_smaller_frames(CALLS, "3970");
+}
+
+#[test]
+fn first_argument_survives_a_call() {
+    assert_eq!(run(&compile(FIRST_ARG_AFTER_CALL, false)), vec!["302"]);
+    assert_eq!(run(&compile(FIRST_ARG_AFTER_CALL, true)), vec!["302"]);
+}
+
+#[test]
+fn aggregates_read_renamed_block_params() {
+    assert_same_output_smaller_frames(AGGREGATES, "33");
+}
+
+#[test]
+fn standard_pipeline_runs_reg_alloc() {
+    let packed = compile(LOOPS, true);
+    let standard = kaubo_driver::compile_source(LOOPS).unwrap();
+    assert_eq!(
+        kaubo_driver::frame_size(&standard),
+        kaubo_driver::frame_size(&packed)
+    );
+}
@@ -0,0 +1,144 @@
+//! ScalarReplace：同一程序带 / 不带标量替换编译，输出必须一致，且带替换时
+//! 实际执行的 NewStruct / NewTuple 更少；逃逸的对象保留分配。
+
+use kaubo_driver::module_loader::MemLoader;
+use kaubo_driver::{adapt_pass, DagCoordinator, Pipeline, ProfileConfig, RingSink};
+use kaubo_ir::cps::CpsModule;
+use kaubo_ir::pass::{
+    empty_block::EmptyBlockElim, escape::allocation_sites, escape::ScalarReplace,
+    fold::ConstantFold, inline::Inline, move_fold::MoveFold, reg_alloc::RegAlloc,
+};
+use kaubo_vm::Opcode;
+use std::sync::Arc;
+
+/// 循环里每次构造结构体只为读两个字段。
+const POINTS: &str = "
+struct Point { x: Int64, y: Int64 }
+var s = 0; var i = 0;
+while (i < 100) {
+    const p = Point { x: i, y: i * 3 };
+    s = s + p.x * p.y;
+    i = i + 1;
+};
+print(s.to_string());
+";
+
+/// lambda 返回元组，内联后调用者立即解构。
+const TUPLES: &str = "
+const divmod = |a: Int64, b: Int64| -> Int64 {
+    const t = (a / b, a % b);
+    return t[0] * 10 + t[1];
+};
+var s = 0; var i = 1;
+while (i < 50) { s = s + divmod(i * 7, 5); i = i + 1; };
+print(s.to_string());
+";
+
+/// 结构体写入列表后逃逸，必须保留分配。
+const ESCAPES: &str = "
+struct Point { x: Int64, y: Int64 }
+const p = Point { x: 1, y: 2 };
+const xs = [p, p];
+const q = Point { x: 3, y: 4 };
+var n = 0;
+for (v in xs) { n = n + 1; };
+print((n + q.x).to_string());
+";
+
+fn pipeline(replace: bool) -> Pipeline {
+    let p = Pipeline::new()
+        .add(adapt_pass(EmptyBlockElim))
+        .add(adapt_pass(MoveFold))
+        .add(adapt_pass(ConstantFold))
+        .add(adapt_pass(Inline::default()));
+    let p = if replace {
+        p.add(adapt_pass(ScalarReplace))
+    } else {
+        p
+    };
+    p.add(adapt_pass(RegAlloc))
+}
+
+fn compile(source: &str, replace: bool) -> CpsModule {
+    DagCoordinator::with_pipeline(pipeline(replace))
+        .compile_source(source)
+        .unwrap()
+}
+
+/// 返回输出和实际执行的聚合分配数。
+fn run(cps: &CpsModule) -> (Vec<String>, u64) {
+    let program = kaubo_driver::load_program(cps).unwrap();
+    let config = ProfileConfig {
+        opcodes: true,
+        ..Default::default()
+    };
+    let (outcome, profile) =
+        kaubo_driver::profile_program(&program, u64::MAX, config, Box::new(RingSink::new(16)))
+            .unwrap();
+    let allocs = profile
+        .opcode_counts()
+        .iter()
+        .filter(|&&(op, _)| matches!(op, Opcode::NewStruct | Opcode::NewTuple))
+        .map(|&(_, n)| n)
+        .sum();
+    (outcome.output, allocs)
+}
+
+fn sites(cps: &CpsModule) -> usize {
+    cps.functions.iter().map(allocation_sites).sum()
+}
+
+fn assert_allocations_removed(source: &str, expected: &str) {
+    let (plain, plain_allocs) = run(&compile(source, false));
+    let (replaced, replaced_allocs) = run(&compile(source, true));
+    assert_eq!(plain, vec![expected]);
+    assert_eq!(replaced, plain);
+    assert!(plain_allocs > 0);
+    assert_eq!(
+        replaced_allocs, 0,
+        "plain executed {plain_allocs} allocations"
+    );
+}
+
+#[test]
+fn struct_built_to_read_fields_stays_in_registers() {
+    assert_allocations_removed(POINTS, "985050");
+}
+
+#[test]
+fn tuple_returned_from_inlined_lambda_is_destructured_in_registers() {
+    assert_allocations_removed(TUPLES, "17050");
+}
+
+#[test]
+fn escaping_struct_keeps_its_allocation() {
+    let plain = compile(ESCAPES, false);
+    let replaced = compile(ESCAPES, true);
+    assert_eq!(run(&replaced).0, vec!["5"]);
+    // `p` is stored in the list; only `q` is replaced.
+    assert_eq!(sites(&replaced), sites(&plain) - 1);
+}
+
+#[test]
+fn standard_pipeline_runs_scalar_replace() {
+    let cps = kaubo_driver::compile_source(POINTS).unwrap();
+    assert_eq!(run(&cps), (vec!["985050".to_string()], 0));
+}
+
+#[test]
+fn imported_struct_is_replaced_after_linking() {
+    let mut loader = MemLoader::new();
+    loader.insert(
+        "main.kb",
+        "import { Point } from \"./point.kb\";\n\
+         const p = Point { x: 10, y: 20 };\n\
+         print((p.x + p.y).to_string());",
+    );
+    loader.insert("point.kb", "export struct Point { x: Int64, y: Int64 };");
+    let loader = Arc::new(loader);
+    let linked = DagCoordinator::new_multifile("main.kb", loader.clone(), None)
+        .compile_file("main.kb", loader)
+        .unwrap();
+    assert_eq!(sites(&linked), 0);
+    assert_eq!(run(&linked).0, vec!["30"]);
+}
@@ -0,0 +1,62 @@
+//! 一份 `LoadedProgram` 同时跑在多个线程的 VM 隔离区上。
+//!
+//! 每个线程持有一个池化 VM，请求之间只 `reset`；结果必须与单次
+//! `run_module` 完全相同，且程序映像本身从不被复制。
+
+use std::sync::Arc;
+
+const SOURCE: &str = r#"
+struct Point { x: Int64, y: Int64 };
+var total = 0; var i = 0;
+while (i < 500) { const p = Point { x: i, y: 2 }; total = total + p.x * p.y; i = i + 1; };
+const label = "total=";
+print(label + total.to_string());
+print("done");
+"#;
+
+#[test]
+fn pooled_isolates_share_one_program_across_threads() {
+    let cps = kaubo_driver::compile_source(SOURCE).unwrap();
+    let expected = kaubo_driver::run_module(&cps).unwrap();
+    assert_eq!(expected.output, vec!["total=249500", "done"]);
+
+    let program = kaubo_driver::load_program(&cps).unwrap();
+    let entry = program.entry().unwrap();
+    let reg_count = program.func_reg_counts[entry];
+    let workers: Vec<_> = (0..8)
+        .map(|_| {
+            let program = program.clone();
+            std::thread::spawn(move || {
+                let mut vm = kaubo_vm::VM::with_program(program);
+                (0..25)
+                    .map(|_| {
+                        vm.reset();
+                        let result = vm.execute(entry, reg_count, None).unwrap();
+                        kaubo_driver::RunOutcome {
+                            result,
+                            output: vm.take_output(),
+                        }
+                    })
+                    .collect::<Vec<_>>()
+            })
+        })
+        .collect();
+    for w in workers {
+        for outcome in w.join().unwrap() {
+            assert_eq!(outcome, expected);
+        }
+    }
+    assert_eq!(Arc::strong_count(&program), 1);
+}
+
+#[test]
+fn run_program_matches_run_module() {
+    let cps = kaubo_driver::compile_source(SOURCE).unwrap();
+    let program = kaubo_driver::load_program(&cps).unwrap();
+    let first = kaubo_driver::run_program(&program, u64::MAX).unwrap();
+    assert_eq!(
+        first,
+        kaubo_driver::run_program(&program, u64::MAX).unwrap()
+    );
+    assert_eq!(first, kaubo_driver::run_module(&cps).unwrap());
+}
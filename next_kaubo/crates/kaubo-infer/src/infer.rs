@@ -1,3266 +1,2960 @@
-//! Algorithm W — Hindley-Milner 类型推断
-
-#![allow(clippy::type_complexity)]
-
-use crate::types::*;
-use kaubo_ast::*;
-use std::collections::{HashMap, HashSet};
-use std::sync::atomic::{AtomicUsize, Ordering};
-
-static TVAR_COUNTER: AtomicUsize = AtomicUsize::new(0);
-
-pub fn fresh_tvar() -> TypeVar {
-    TypeVar(TVAR_COUNTER.fetch_add(1, Ordering::Relaxed))
-}
-
-pub fn reset_tvar() {
-    TVAR_COUNTER.store(0, Ordering::Relaxed);
-}
-
-static STRUCT_COUNTER: AtomicUsize = AtomicUsize::new(0);
-static ENUM_COUNTER: AtomicUsize = AtomicUsize::new(0);
-
-pub fn fresh_struct_id() -> usize {
-    STRUCT_COUNTER.fetch_add(1, Ordering::Relaxed)
-}
-
-pub fn fresh_enum_id() -> usize {
-    ENUM_COUNTER.fetch_add(1, Ordering::Relaxed)
-}
-
-#[derive(Debug)]
-pub struct TypeError {
-    pub msg: String,
-    pub line: usize,
-    pub col: usize,
-}
-
-pub type InferResult<T> = Result<T, TypeError>;
-
-/// Annotate a TypeError with a better source position.
-fn annotate_err(e: TypeError, span: &Span) -> TypeError {
-    if e.line == 0 {
-        TypeError { line: span.line, col: span.col, msg: e.msg }
-    } else {
-        e
-    }
-}
-
-/// Extract the deepest span from an expression for error reporting.
-fn expr_span(expr: &Expr) -> Span {
-    match expr {
-        Expr::VarRef { span, .. } => *span,
-        Expr::Call { func, arg } => {
-            let a = expr_span(arg);
-            if a.line > 0 { a } else { expr_span(func) }
-        }
-        Expr::Member { object, .. } => expr_span(object),
-        Expr::Binary { left, right, .. } => {
-            let r = expr_span(right);
-            if r.line > 0 { r } else { expr_span(left) }
-        }
-        Expr::Unary { right, .. } => expr_span(right),
-        Expr::If { cond, .. } => expr_span(cond),
-        Expr::While { cond, .. } => expr_span(cond),
-        Expr::Return(val) => val.as_ref().map(|e| expr_span(e.as_ref())).unwrap_or(Span::ZERO),
-        Expr::Assign { target, .. } => expr_span(target),
-        Expr::Tuple(items) => items.iter().find_map(|i| {
-            let s = expr_span(i);
-            if s.line > 0 { Some(s) } else { None }
-        }).unwrap_or(Span::ZERO),
-        _ => Span::ZERO,
-    }
-}
-
-// ── 主入口 ──
-
-pub fn infer_module(
-    module: &Module,
-) -> InferResult<(TypeEnv, HashMap<usize, Vec<(String, Type)>>)> {
-    infer_module_with_imports(module, None).map(|(env, sf, _)| (env, sf))
-}
-
-/// 带导入表的类型推断。`imports` 为 `None` 时行为与 `infer_module` 一致（向后兼容）。
-pub fn infer_module_with_imports(
-    module: &Module,
-    imports: Option<&[ImportSpec]>,
-) -> InferResult<(
-    TypeEnv,
-    HashMap<usize, Vec<(String, Type)>>,
-    HashSet<String>,
-)> {
-    reset_tvar();
-    let mut env: TypeEnv = HashMap::new();
-    let mut exports: HashSet<String> = HashSet::new();
-
-    // Pass 1: collect struct, enum, and interface definitions
-    let mut interface_registry: HashMap<String, Vec<(String, Vec<(String, Type)>, Option<Type>)>> =
-        HashMap::new();
-    let mut struct_registry: HashMap<String, usize> = HashMap::new();
-    let mut struct_fields: HashMap<usize, Vec<(String, Type)>> = HashMap::new();
-    let mut enum_registry: HashMap<String, usize> = HashMap::new();
-    let mut enum_variants: HashMap<usize, Vec<(String, Vec<(String, Type)>)>> = HashMap::new();
-    for stmt in &module.stmts {
-        // Unwrap ExportStmt to reach inner definitions
-        let inner = match stmt {
-            Stmt::ExportStmt(inner) => inner.as_ref(),
-            other => other,
-        };
-        if let Stmt::StructDef { name, fields, .. } = inner {
-            let id = fresh_struct_id();
-            struct_registry.insert(name.clone(), id);
-            let mut fts = Vec::new();
-            for f in fields {
-                fts.push((
-                    f.name.clone(),
-                    type_expr_to_type(
-                        &f.ty,
-                        &struct_registry,
-                        &struct_fields,
-                        &interface_registry,
-                    )?,
-                ));
-            }
-            struct_fields.insert(id, fts);
-        }
-        if let Stmt::EnumDef { name, variants, .. } = inner {
-            let id = fresh_enum_id();
-            enum_registry.insert(name.clone(), id);
-            let mut vts: Vec<(String, Vec<(String, Type)>)> = Vec::new();
-            for v in variants {
-                let mut fts = Vec::new();
-                for f in &v.fields {
-                    fts.push((
-                        f.name.clone(),
-                        type_expr_to_type(
-                            &f.ty,
-                            &struct_registry,
-                            &struct_fields,
-                            &interface_registry,
-                        )?,
-                    ));
-                }
-                vts.push((v.name.clone(), fts));
-            }
-            enum_variants.insert(id, vts);
-        }
-        if let Stmt::InterfaceDef { name, methods, .. } = inner {
-            let mut sigs: Vec<(String, Vec<(String, Type)>, Option<Type>)> = Vec::new();
-            for m in methods {
-                let mut param_types = Vec::new();
-                for p in &m.params {
-                    let pt = if let Some(TypeExpr::Named(s)) = &p.ty_ann {
-                        if s == "Self" {
-                            Type::Var(fresh_tvar()) // Self is a placeholder
-                        } else {
-                            type_expr_to_type(
-                                &p.ty_ann.clone().unwrap(),
-                                &struct_registry,
-                                &struct_fields,
-                                &interface_registry,
-                            )?
-                        }
-                    } else {
-                        Type::Var(fresh_tvar())
-                    };
-                    param_types.push((p.name.clone(), pt));
-                }
-                let ret = m.return_type.as_ref().map(|t| {
-                    if let TypeExpr::Named(s) = t {
-                        if s == "Self" {
-                            return Type::Var(fresh_tvar());
-                        }
-                    }
-                    type_expr_to_type(t, &struct_registry, &struct_fields, &interface_registry)
-                        .unwrap_or(Type::Null)
-                });
-                sigs.push((m.name.clone(), param_types, ret));
-            }
-            interface_registry.insert(name.clone(), sigs);
-        }
-    }
-
-    // Pass 2: inject stdlib builtins, builtin interfaces, and builtin impls
-    inject_stdlib(&mut env);
-    inject_builtin_interfaces(&mut interface_registry);
-    inject_builtin_impls(
-        &mut env,
-        &mut struct_registry,
-        &mut struct_fields,
-        &mut interface_registry,
-    );
-
-    // Pass 2.5: inject imported symbols from other modules
-    if let Some(imports) = imports {
-        for spec in imports {
-            match &spec.kind {
-                ImportKind::Const { ty } | ImportKind::Function { ty } => {
-                    env.insert(spec.local_name.clone(), Scheme::monomorphic(ty.clone()));
-                }
-                ImportKind::Struct {
-                    struct_id: src_id,
-                    fields,
-                } => {
-                    // ★ 使用源模块原始 struct_id，不重新分配
-                    struct_registry.insert(spec.local_name.clone(), *src_id);
-                    struct_fields.insert(*src_id, fields.clone());
-                    env.insert(
-                        spec.local_name.clone(),
-                        Scheme::monomorphic(Type::Record(*src_id, fields.clone())),
-                    );
-                }
-                ImportKind::Interface { methods } => {
-                    interface_registry.insert(spec.local_name.clone(), methods.clone());
-                    env.insert(spec.local_name.clone(), Scheme::monomorphic(Type::Null));
-                }
-            }
-        }
-    }
-
-    // Pass 3: infer all statements
-    for stmt in &module.stmts {
-        match stmt {
-            Stmt::ConstDecl { name, value, span, .. } => {
-                let (s, ty) = infer(
-                    &env,
-                    value,
-                    &struct_registry,
-                    &struct_fields,
-                    &enum_registry,
-                    &enum_variants,
-                    &interface_registry,
-                )
-                .map_err(|e| annotate_err(e, span))?;
-                let scheme = generalize(&env, &s.apply(&ty));
-                env.insert(name.clone(), scheme);
-            }
-            Stmt::VarDecl { name, value, span, .. } => {
-                let ty = if let Some(val) = value {
-                    let (s, t) = infer(
-                        &env,
-                        val,
-                        &struct_registry,
-                        &struct_fields,
-                        &enum_registry,
-                        &enum_variants,
-                        &interface_registry,
-                    )
-                    .map_err(|e| annotate_err(e, span))?;
-                    s.apply(&t)
-                } else {
-                    Type::Var(fresh_tvar())
-                };
-                env.insert(name.clone(), Scheme::monomorphic(ty));
-            }
-            Stmt::StructDef { name, fields, .. } => {
-                let id = struct_registry[name];
-                let mut fts = Vec::new();
-                for f in fields {
-                    fts.push((
-                        f.name.clone(),
-                        type_expr_to_type(
-                            &f.ty,
-                            &struct_registry,
-                            &struct_fields,
-                            &interface_registry,
-                        )?,
-                    ));
-                }
-                struct_fields.insert(id, fts);
-            }
-            Stmt::EnumDef { name, variants, .. } => {
-                let id = enum_registry[name];
-                // Register each variant constructor in the environment
-                for (tag, v) in variants.iter().enumerate() {
-                    let vtys = enum_variants
-                        .get(&id)
-                        .and_then(|vs| vs.get(tag))
-                        .map(|(_, fts)| fts.clone())
-                        .unwrap_or_default();
-                    let result_ty = Type::Variant(id, v.name.clone(), vtys.clone());
-                    if v.fields.is_empty() {
-                        // Unit variant: just the variant type
-                        env.insert(v.name.clone(), Scheme::monomorphic(result_ty));
-                    } else {
-                        // Payload variant: fields... -> Variant
-                        let mut arrow = result_ty;
-                        for (_, ft) in vtys.iter().rev() {
-                            arrow = Type::Arrow(Box::new(ft.clone()), Box::new(arrow));
-                        }
-                        env.insert(v.name.clone(), Scheme::monomorphic(arrow));
-                    }
-                }
-            }
-            Stmt::ImplBlock {
-                struct_name,
-                interface_name,
-                methods,
-                ..
-            } => {
-                // Check interface completeness if implementing a trait
-                if let Some(ref iface_name) = interface_name {
-                    if let Some(required) = interface_registry.get(iface_name) {
-                        let implemented: std::collections::HashSet<&str> =
-                            methods.iter().map(|m| m.name.as_str()).collect();
-                        for (mname, _, _) in required {
-                            if !implemented.contains(mname.as_str()) {
-                                return Err(TypeError {
-                                    msg: format!(
-                                        "impl '{iface_name}' for '{struct_name}' missing method '{mname}'"
-                                    ),
-                                    line: 0,
-                                    col: 0,
-                                });
-                            }
-                        }
-                    }
-                }
-                // Register methods on struct — with interface signature checking
-                for m in methods {
-                    let (s, ty) = infer(
-                        &env,
-                        &m.body,
-                        &struct_registry,
-                        &struct_fields,
-                        &enum_registry,
-                        &enum_variants,
-                        &interface_registry,
-                    )?;
-                    let inferred = s.apply(&ty);
-                    // If implementing an interface, check method type against declared signature
-                    if let Some(ref iface_name) = interface_name {
-                        if let Some(required) = interface_registry.get(iface_name) {
-                            if let Some((_, param_types, ret_ty)) =
-                                required.iter().find(|(mn, _, _)| mn == &m.name)
-                            {
-                                // Build expected type: params → ret
-                                let tys: Vec<Type> =
-                                    param_types.iter().map(|(_, t)| t.clone()).collect();
-                                let param_ty = match tys.len() {
-                                    0 => Type::Tuple(vec![]),
-                                    1 => tys.into_iter().next().unwrap(),
-                                    _ => Type::Tuple(tys),
-                                };
-                                let expected = Type::Arrow(
-                                    Box::new(param_ty),
-                                    Box::new(ret_ty.clone().unwrap_or(Type::Null)),
-                                );
-                                // Unify inferred method type with expected signature
-                                if let Err(e) = unify(&inferred, &expected) {
-                                    return Err(TypeError {
-                                        msg: format!(
-                                            "method '{}' of impl '{iface_name}' for '{struct_name}': {}",
-                                            m.name, e
-                                        ),
-                                        line: 0,
-                                        col: 0,
-                                    });
-                                }
-                            }
-                        }
-                    }
-                    let scheme = generalize(&env, &inferred);
-                    env.insert(format!("{}.{}", struct_name, m.name), scheme);
-                }
-            }
-            Stmt::ExprStmt(expr) => {
-                let span = expr_span(expr);
-                infer(
-                    &env,
-                    expr,
-                    &struct_registry,
-                    &struct_fields,
-                    &enum_registry,
-                    &enum_variants,
-                    &interface_registry,
-                )
-                .map_err(|e| annotate_err(e, &span))?;
-            }
-            Stmt::InterfaceDef { name, .. } => {
-                // Register interface name as a type-level entity (no runtime value)
-                env.insert(name.clone(), Scheme::monomorphic(Type::Null));
-            }
-            Stmt::ExportStmt(inner) => {
-                // 推断内部声明，并记录导出
-                match inner.as_ref() {
-                    Stmt::ConstDecl { name, value, span, .. } => {
-                        let (s, ty) = infer(
-                            &env,
-                            value,
-                            &struct_registry,
-                            &struct_fields,
-                            &enum_registry,
-                            &enum_variants,
-                            &interface_registry,
-                        )
-                        .map_err(|e| annotate_err(e, span))?;
-                        let scheme = generalize(&env, &s.apply(&ty));
-                        env.insert(name.clone(), scheme);
-                        exports.insert(name.clone());
-                    }
-                    Stmt::StructDef { name, fields, .. } => {
-                        let id = struct_registry[name];
-                        let mut fts = Vec::new();
-                        for f in fields {
-                            fts.push((
-                                f.name.clone(),
-                                type_expr_to_type(
-                                    &f.ty,
-                                    &struct_registry,
-                                    &struct_fields,
-                                    &interface_registry,
-                                )?,
-                            ));
-                        }
-                        struct_fields.insert(id, fts.clone());
-                        env.insert(name.clone(), Scheme::monomorphic(Type::Record(id, fts)));
-                        exports.insert(name.clone());
-                    }
-                    Stmt::EnumDef { name, variants, .. } => {
-                        let id = enum_registry[name];
-                        for (tag, v) in variants.iter().enumerate() {
-                            let vtys = enum_variants
-                                .get(&id)
-                                .and_then(|vs| vs.get(tag))
-                                .map(|(_, fts)| fts.clone())
-                                .unwrap_or_default();
-                            let result_ty = Type::Variant(id, v.name.clone(), vtys.clone());
-                            if v.fields.is_empty() {
-                                env.insert(v.name.clone(), Scheme::monomorphic(result_ty));
-                            } else {
-                                let param_ty = match vtys.len() {
-                                    1 => vtys.into_iter().next().unwrap().1,
-                                    _ => Type::Tuple(vtys.into_iter().map(|(_, t)| t).collect()),
-                                };
-                                let arrow = Type::Arrow(Box::new(param_ty), Box::new(result_ty));
-                                env.insert(v.name.clone(), Scheme::monomorphic(arrow));
-                            }
-                        }
-                        exports.insert(name.clone());
-                    }
-                    Stmt::InterfaceDef { name, .. } => {
-                        env.insert(name.clone(), Scheme::monomorphic(Type::Null));
-                        exports.insert(name.clone());
-                    }
-                    Stmt::VarDecl { name, value, .. } => {
-                        let ty = if let Some(val) = value {
-                            let (s, t) = infer(
-                                &env,
-                                val,
-                                &struct_registry,
-                                &struct_fields,
-                                &enum_registry,
-                                &enum_variants,
-                                &interface_registry,
-                            )?;
-                            s.apply(&t)
-                        } else {
-                            Type::Var(fresh_tvar())
-                        };
-                        env.insert(name.clone(), Scheme::monomorphic(ty));
-                        exports.insert(name.clone());
-                    }
-                    _ => {
-                        // 不支持的导出语句类型，静默忽略（未来可报错）
-                    }
-                }
-            }
-            Stmt::Import { .. } => {}
-        }
-    }
-
-    Ok((env, struct_fields, exports))
-}
-
-// ── stdlib injection ──
-
-fn inject_stdlib(env: &mut TypeEnv) {
-    // print: String → Null
-    env.insert(
-        "print".into(),
-        Scheme::monomorphic(Type::Arrow(Box::new(Type::String), Box::new(Type::Null))),
-    );
-    // type_of: forall a. a → Int64
-    let tv = fresh_tvar();
-    env.insert(
-        "type_of".into(),
-        Scheme {
-            bound: vec![tv],
-            body: Box::new(Type::Arrow(Box::new(Type::Var(tv)), Box::new(Type::Int64))),
-        },
-    );
-    // assert: Bool → Null
-    env.insert(
-        "assert".into(),
-        Scheme::monomorphic(Type::Arrow(Box::new(Type::Bool), Box::new(Type::Null))),
-    );
-    // sqrt/sin/cos: Float64 → Float64
-    for name in &["sqrt", "sin", "cos", "floor", "ceil"] {
-        env.insert(
-            name.to_string(),
-            Scheme::monomorphic(Type::Arrow(
-                Box::new(Type::Float64),
-                Box::new(Type::Float64),
-            )),
-        );
-    }
-}
-
-/// Inject built-in interface definitions (Add, Subtract, Multiply, Divide, Modulo,
-/// Compare, Display, IntoFloat, IntoInt).
-fn inject_builtin_interfaces(
-    interface_registry: &mut HashMap<String, Vec<(String, Vec<(String, Type)>, Option<Type>)>>,
-) {
-    // Helper: create a fresh Self type variable (used as placeholder for the implementor type)
-    let self_tv = || Type::Var(fresh_tvar());
-    let bool_ty = Type::Bool;
-    let string_ty = Type::String;
-    let float_ty = Type::Float64;
-
-    // interface Add { operator add: |self, other: Self| -> Self; }
-    let sv = self_tv();
-    interface_registry.entry("Add".into()).or_insert_with(|| {
-        vec![(
-            "add".into(),
-            vec![("self".into(), sv.clone()), ("other".into(), sv.clone())],
-            Some(sv.clone()),
-        )]
-    });
-    // interface Subtract { operator subtract: |self, other: Self| -> Self; }
-    let sv = self_tv();
-    interface_registry
-        .entry("Subtract".into())
-        .or_insert_with(|| {
-            vec![(
-                "subtract".into(),
-                vec![("self".into(), sv.clone()), ("other".into(), sv.clone())],
-                Some(sv.clone()),
-            )]
-        });
-    // interface Multiply { operator multiply: |self, other: Self| -> Self; }
-    let sv = self_tv();
-    interface_registry
-        .entry("Multiply".into())
-        .or_insert_with(|| {
-            vec![(
-                "multiply".into(),
-                vec![("self".into(), sv.clone()), ("other".into(), sv.clone())],
-                Some(sv.clone()),
-            )]
-        });
-    // interface Divide { operator divide: |self, other: Self| -> Self; }
-    let sv = self_tv();
-    interface_registry
-        .entry("Divide".into())
-        .or_insert_with(|| {
-            vec![(
-                "divide".into(),
-                vec![("self".into(), sv.clone()), ("other".into(), sv.clone())],
-                Some(sv.clone()),
-            )]
-        });
-    // interface Modulo { operator modulo: |self, other: Self| -> Self; }
-    let sv = self_tv();
-    interface_registry
-        .entry("Modulo".into())
-        .or_insert_with(|| {
-            vec![(
-                "modulo".into(),
-                vec![("self".into(), sv.clone()), ("other".into(), sv.clone())],
-                Some(sv.clone()),
-            )]
-        });
-    // interface Compare {
-    //     operator less: |self, other: Self| -> Bool;
-    //     operator less_equal: |self, other: Self| -> Bool;
-    //     operator greater: |self, other: Self| -> Bool;
-    //     operator greater_equal: |self, other: Self| -> Bool;
-    //     operator equal: |self, other: Self| -> Bool;
-    //     operator not_equal: |self, other: Self| -> Bool;
-    // }
-    let sv = self_tv();
-    interface_registry
-        .entry("Compare".into())
-        .or_insert_with(|| {
-            vec![
-                (
-                    "less".into(),
-                    vec![("self".into(), sv.clone()), ("other".into(), sv.clone())],
-                    Some(bool_ty.clone()),
-                ),
-                (
-                    "less_equal".into(),
-                    vec![("self".into(), sv.clone()), ("other".into(), sv.clone())],
-                    Some(bool_ty.clone()),
-                ),
-                (
-                    "greater".into(),
-                    vec![("self".into(), sv.clone()), ("other".into(), sv.clone())],
-                    Some(bool_ty.clone()),
-                ),
-                (
-                    "greater_equal".into(),
-                    vec![("self".into(), sv.clone()), ("other".into(), sv.clone())],
-                    Some(bool_ty.clone()),
-                ),
-                (
-                    "equal".into(),
-                    vec![("self".into(), sv.clone()), ("other".into(), sv)],
-                    Some(bool_ty.clone()),
-                ),
-                ("not_equal".into(), vec![], Some(bool_ty.clone())),
-            ]
-        });
-    // interface Display { to_string: |self| -> String; }
-    interface_registry
-        .entry("Display".into())
-        .or_insert_with(|| {
-            vec![(
-                "to_string".into(),
-                vec![("self".into(), self_tv())],
-                Some(string_ty.clone()),
-            )]
-        });
-    // interface IntoFloat { to_float: |self| -> Float64; }
-    interface_registry
-        .entry("IntoFloat".into())
-        .or_insert_with(|| {
-            vec![(
-                "to_float".into(),
-                vec![("self".into(), self_tv())],
-                Some(float_ty.clone()),
-            )]
-        });
-    // interface IntoInt { to_int: |self| -> Int64; }
-    interface_registry
-        .entry("IntoInt".into())
-        .or_insert_with(|| {
-            vec![(
-                "to_int".into(),
-                vec![("self".into(), self_tv())],
-                Some(Type::Int64),
-            )]
-        });
-}
-
-/// Inject built-in impl blocks for Int64, Float64, String, Bool.
-/// These method signatures go into the type environment so `x.to_string()` and
-/// `x.add(y)` type-check.  CPS build recognizes builtin method names and rewrites
-/// them to the corresponding CPS instructions — the impl bodies are never executed.
-fn inject_builtin_impls(
-    env: &mut TypeEnv,
-    struct_registry: &mut HashMap<String, usize>,
-    struct_fields: &mut HashMap<usize, Vec<(String, Type)>>,
-    interface_registry: &mut HashMap<String, Vec<(String, Vec<(String, Type)>, Option<Type>)>>,
-) {
-    // Register builtin types as "struct-like" so method lookup works
-    let builtin_int_id = usize::MAX;
-    let builtin_float_id = usize::MAX - 1;
-    let builtin_string_id = usize::MAX - 2;
-    let builtin_bool_id = usize::MAX - 3;
-    struct_registry.insert("Int64".into(), builtin_int_id);
-    struct_registry.insert("Float64".into(), builtin_float_id);
-    struct_registry.insert("String".into(), builtin_string_id);
-    struct_registry.insert("Bool".into(), builtin_bool_id);
-    struct_fields.insert(builtin_int_id, vec![]);
-    struct_fields.insert(builtin_float_id, vec![]);
-    struct_fields.insert(builtin_string_id, vec![]);
-    struct_fields.insert(builtin_bool_id, vec![]);
-
-    // Helper: register a monomorphic method in env as "{struct}.{method}".
-    // For methods with one extra arg (operator methods), the type is curried:
-    //   self_type → (other_type → return_type)
-    // For zero-arg methods (to_string, to_float, etc.), it's just:
-    //   self_type → return_type
-    // Member handler strips the first Arrow (self), leaving either `ret` or `other → ret`.
-    let mut reg =
-        |struct_name: &str, method: &str, self_ty: Type, other_ty: Option<Type>, ret_ty: Type| {
-            let full = format!("{struct_name}.{method}");
-            let ty = if let Some(other) = other_ty {
-                Type::Arrow(
-                    Box::new(self_ty),
-                    Box::new(Type::Arrow(Box::new(other), Box::new(ret_ty))),
-                )
-            } else {
-                Type::Arrow(Box::new(self_ty), Box::new(ret_ty))
-            };
-            env.insert(full, Scheme::monomorphic(ty));
-        };
-
-    // ── Int64 ── (operator methods: self + other → return)
-    reg("Int64", "add", Type::Int64, Some(Type::Int64), Type::Int64);
-    reg(
-        "Int64",
-        "subtract",
-        Type::Int64,
-        Some(Type::Int64),
-        Type::Int64,
-    );
-    reg(
-        "Int64",
-        "multiply",
-        Type::Int64,
-        Some(Type::Int64),
-        Type::Int64,
-    );
-    reg(
-        "Int64",
-        "divide",
-        Type::Int64,
-        Some(Type::Int64),
-        Type::Int64,
-    );
-    reg(
-        "Int64",
-        "modulo",
-        Type::Int64,
-        Some(Type::Int64),
-        Type::Int64,
-    );
-    reg("Int64", "less", Type::Int64, Some(Type::Int64), Type::Bool);
-    reg(
-        "Int64",
-        "less_equal",
-        Type::Int64,
-        Some(Type::Int64),
-        Type::Bool,
-    );
-    reg(
-        "Int64",
-        "greater",
-        Type::Int64,
-        Some(Type::Int64),
-        Type::Bool,
-    );
-    reg(
-        "Int64",
-        "greater_equal",
-        Type::Int64,
-        Some(Type::Int64),
-        Type::Bool,
-    );
-    reg("Int64", "equal", Type::Int64, Some(Type::Int64), Type::Bool);
-    reg(
-        "Int64",
-        "not_equal",
-        Type::Int64,
-        Some(Type::Int64),
-        Type::Bool,
-    );
-    // zero-arg methods: no other type
-    reg("Int64", "to_string", Type::Int64, None, Type::String);
-    reg("Int64", "to_float", Type::Int64, None, Type::Float64);
-
-    // ── Float64 ──
-    reg(
-        "Float64",
-        "add",
-        Type::Float64,
-        Some(Type::Float64),
-        Type::Float64,
-    );
-    reg(
-        "Float64",
-        "subtract",
-        Type::Float64,
-        Some(Type::Float64),
-        Type::Float64,
-    );
-    reg(
-        "Float64",
-        "multiply",
-        Type::Float64,
-        Some(Type::Float64),
-        Type::Float64,
-    );
-    reg(
-        "Float64",
-        "divide",
-        Type::Float64,
-        Some(Type::Float64),
-        Type::Float64,
-    );
-    reg(
-        "Float64",
-        "less",
-        Type::Float64,
-        Some(Type::Float64),
-        Type::Bool,
-    );
-    reg(
-        "Float64",
-        "less_equal",
-        Type::Float64,
-        Some(Type::Float64),
-        Type::Bool,
-    );
-    reg(
-        "Float64",
-        "greater",
-        Type::Float64,
-        Some(Type::Float64),
-        Type::Bool,
-    );
-    reg(
-        "Float64",
-        "greater_equal",
-        Type::Float64,
-        Some(Type::Float64),
-        Type::Bool,
-    );
-    reg(
-        "Float64",
-        "equal",
-        Type::Float64,
-        Some(Type::Float64),
-        Type::Bool,
-    );
-    reg(
-        "Float64",
-        "not_equal",
-        Type::Float64,
-        Some(Type::Float64),
-        Type::Bool,
-    );
-    reg("Float64", "to_string", Type::Float64, None, Type::String);
-    reg("Float64", "to_int", Type::Float64, None, Type::Int64);
-
-    // ── String ──
-    reg(
-        "String",
-        "add",
-        Type::String,
-        Some(Type::String),
-        Type::String,
-    );
-    reg(
-        "String",
-        "less",
-        Type::String,
-        Some(Type::String),
-        Type::Bool,
-    );
-    reg(
-        "String",
-        "less_equal",
-        Type::String,
-        Some(Type::String),
-        Type::Bool,
-    );
-    reg(
-        "String",
-        "greater",
-        Type::String,
-        Some(Type::String),
-        Type::Bool,
-    );
-    reg(
-        "String",
-        "greater_equal",
-        Type::String,
-        Some(Type::String),
-        Type::Bool,
-    );
-    reg(
-        "String",
-        "equal",
-        Type::String,
-        Some(Type::String),
-        Type::Bool,
-    );
-    reg(
-        "String",
-        "not_equal",
-        Type::String,
-        Some(Type::String),
-        Type::Bool,
-    );
-    reg("String", "to_string", Type::String, None, Type::String);
-    reg("String", "to_int", Type::String, None, Type::Int64);
-
-    // ── Bool ──
-    reg("Bool", "equal", Type::Bool, Some(Type::Bool), Type::Bool);
-    reg(
-        "Bool",
-        "not_equal",
-        Type::Bool,
-        Some(Type::Bool),
-        Type::Bool,
-    );
-    reg("Bool", "to_string", Type::Bool, None, Type::String);
-
-    // Register builtin interface impls in interface_registry so completeness checks pass
-    for (iface_name, builtin_types) in &[
-        ("Add", &["Int64", "Float64", "String"][..]),
-        ("Subtract", &["Int64", "Float64"][..]),
-        ("Multiply", &["Int64", "Float64"][..]),
-        ("Divide", &["Int64", "Float64"][..]),
-        ("Modulo", &["Int64"][..]),
-        ("Compare", &["Int64", "Float64", "String", "Bool"][..]),
-        ("Display", &["Int64", "Float64", "String", "Bool"][..]),
-        ("IntoFloat", &["Int64", "String"][..]),
-        ("IntoInt", &["String", "Float64"][..]),
-    ] {
-        for bt in *builtin_types {
-            let key = format!("{bt}::{iface_name}");
-            interface_registry.entry(key).or_default();
-        }
-    }
-}
-
-/// Map a BinOp to the corresponding operator method name.
-fn binop_to_method(op: &BinOp) -> &'static str {
-    match op {
-        BinOp::Add => "add",
-        BinOp::Sub => "subtract",
-        BinOp::Mul => "multiply",
-        BinOp::Div => "divide",
-        BinOp::Mod => "modulo",
-        BinOp::Eq => "equal",
-        BinOp::Ne => "not_equal",
-        BinOp::Lt => "less",
-        BinOp::Le => "less_equal",
-        BinOp::Gt => "greater",
-        BinOp::Ge => "greater_equal",
-        BinOp::SAdd => "add", // String concatenation uses the same Add interface
-        _ => "add",
-    }
-}
-
-/// Get the struct name for a Type (reverse lookup from struct_registry).
-fn type_to_name(ty: &Type, structs: &HashMap<String, usize>) -> Option<String> {
-    match ty {
-        Type::Int64 => Some("Int64".into()),
-        Type::Float64 => Some("Float64".into()),
-        Type::String => Some("String".into()),
-        Type::Bool => Some("Bool".into()),
-        Type::List(_) => Some("List".into()),
-        Type::Record(id, _) => structs
-            .iter()
-            .find(|(_, &sid)| sid == *id)
-            .map(|(n, _)| n.clone()),
-        Type::Variant(_, name, _) => Some(name.clone()),
-        _ => None,
-    }
-}
-
-// ── 推断 ──
-
-pub fn infer(
-    env: &TypeEnv,
-    expr: &Expr,
-    structs: &HashMap<String, usize>,
-    struct_fields: &HashMap<usize, Vec<(String, Type)>>,
-    enums: &HashMap<String, usize>,
-    enum_variants: &HashMap<usize, Vec<(String, Vec<(String, Type)>)>>,
-    interface_registry: &HashMap<String, Vec<(String, Vec<(String, Type)>, Option<Type>)>>,
-) -> InferResult<(Subst, Type)> {
-    match expr {
-        Expr::LitInt(_) => Ok((Subst::empty(), Type::Int64)),
-        Expr::LitFloat(_) => Ok((Subst::empty(), Type::Float64)),
-        Expr::LitString(_) => Ok((Subst::empty(), Type::String)),
-        Expr::LitTrue | Expr::LitFalse => Ok((Subst::empty(), Type::Bool)),
-        Expr::LitNull => Ok((Subst::empty(), Type::Null)),
-
-        Expr::VarRef { name, .. } => {
-            let scheme = env.get(name).ok_or_else(|| TypeError {
-                msg: format!("unbound variable '{name}'"),
-                line: 0,
-                col: 0,
-            })?;
-            Ok((Subst::empty(), instantiate(scheme)))
-        }
-
-        Expr::Lambda { params, body, .. } => {
-            let mut s = Subst::empty();
-            let mut env_local = env.clone();
-            let mut param_types = Vec::new();
-
-            for p in params {
-                let pt = if let Some(ann) = &p.ty_ann {
-                    type_expr_to_type(ann, structs, struct_fields, interface_registry)?
-                } else {
-                    Type::Var(fresh_tvar())
-                };
-                param_types.push(pt.clone());
-                env_local.insert(p.name.clone(), Scheme::monomorphic(pt));
-            }
-
-            let (s_body, body_ty) = infer(
-                &env_local,
-                body,
-                structs,
-                struct_fields,
-                enums,
-                enum_variants,
-                interface_registry,
-            )?;
-            s = s.compose(&s_body);
-
-            // 构建参数类型：单参数不包裹（边界条件 1）
-            let param_ty = match param_types.len() {
-                0 => Type::Tuple(vec![]),
-                1 => param_types.into_iter().next().unwrap(),
-                _ => Type::Tuple(param_types),
-            };
-            let arrow_ty = Type::Arrow(Box::new(s.apply(&param_ty)), Box::new(body_ty));
-            Ok((s, arrow_ty))
-        }
-
-        Expr::Call { func, arg } => {
-            let (s_func, func_ty) = infer(
-                env,
-                func,
-                structs,
-                struct_fields,
-                enums,
-                enum_variants,
-                interface_registry,
-            )?;
-            let (s_arg, arg_ty) = infer(
-                env,
-                arg,
-                structs,
-                struct_fields,
-                enums,
-                enum_variants,
-                interface_registry,
-            )?;
-            let mut s = s_func.compose(&s_arg);
-            // func_ty 若不是 Arrow（如零参 method call 直接返回结果类型），跳过参数匹配
-            if let Type::Arrow(param_ty, body_ty) = s.apply(&func_ty) {
-                // 整体统一：param_ty（Int64 或 (Int64, Int64) 或 (））与 arg_ty 匹配
-                s = unify_with_registry(&param_ty, &arg_ty, interface_registry, structs)
-                    .map_err(|e| TypeError {
-                        msg: e,
-                        line: 0,
-                        col: 0,
-                    })?
-                    .compose(&s);
-                Ok((s.clone(), s.apply(&body_ty)))
-            } else {
-                // 方法调用等已消解场景：func_ty 为结果类型，arg 必须为空元组
-                if matches!(s.apply(&arg_ty), Type::Tuple(elems) if elems.is_empty()) {
-                    Ok((s.clone(), s.apply(&func_ty)))
-                } else {
-                    Err(TypeError {
-                        msg: format!("cannot call non-function type {}", s.apply(&func_ty)),
-                        line: 0,
-                        col: 0,
-                    })
-                }
-            }
-        }
-
-        Expr::Binary { left, op, right } => {
-            let (s1, t1) = infer(
-                env,
-                left,
-                structs,
-                struct_fields,
-                enums,
-                enum_variants,
-                interface_registry,
-            )?;
-            let (s2, t2) = infer(
-                env,
-                right,
-                structs,
-                struct_fields,
-                enums,
-                enum_variants,
-                interface_registry,
-            )?;
-            let mut s = s1.compose(&s2);
-
-            let result_type = match op {
-                BinOp::Add | BinOp::Sub | BinOp::Mul | BinOp::Div | BinOp::Mod => {
-                    s = unify(&s.apply(&t1), &s.apply(&t2))
-                        .map_err(|e| TypeError {
-                            msg: format!("binary operator: {e}"),
-                            line: 0,
-                            col: 0,
-                        })?
-                        .compose(&s);
-                    let unified = s.apply(&t1);
-                    // Try builtin numeric types first
-                    match unify(&unified, &Type::Int64).or_else(|_| unify(&unified, &Type::Float64))
-                    {
-                        Ok(subst) => {
-                            s = subst.compose(&s);
-                            s.apply(&t1)
-                        }
-                        Err(_) => {
-                            // Fallback: operator dispatch for user types
-                            // Map BinOp to operator method name
-                            let op_method = binop_to_method(op);
-                            // Find the type name of the unified type
-                            let type_name = type_to_name(&unified, structs);
-                            if let Some(tn) = type_name {
-                                let method_name = format!("{tn}.{op_method}");
-                                if let Some(scheme) = env.get(&method_name) {
-                                    let method_ty = instantiate(scheme);
-                                    // Operator methods are curried: self → (other → return)
-                                    // Strip both arrows to get the return type
-                                    match method_ty {
-                                        Type::Arrow(_, body) => match *body {
-                                            Type::Arrow(_, ret) => *ret,
-                                            other => other,
-                                        },
-                                        other => other,
-                                    }
-                                } else {
-                                    return Err(TypeError {
-                                        msg: format!(
-                                            "arithmetic requires numeric types, got {unified}"
-                                        ),
-                                        line: 0,
-                                        col: 0,
-                                    });
-                                }
-                            } else {
-                                return Err(TypeError {
-                                    msg: format!(
-                                        "arithmetic requires numeric types, got {unified}"
-                                    ),
-                                    line: 0,
-                                    col: 0,
-                                });
-                            }
-                        }
-                    }
-                }
-                BinOp::Eq | BinOp::Ne | BinOp::Lt | BinOp::Le | BinOp::Gt | BinOp::Ge => {
-                    // Unify operand types for comparison (unless one side is Null)
-                    let a1 = s.apply(&t1);
-                    let a2 = s.apply(&t2);
-                    if !matches!(&a1, Type::Null) && !matches!(&a2, Type::Null) {
-                        s = unify(&a1, &a2)
-                            .map_err(|e| TypeError {
-                                msg: format!("comparison operands must have same type: {e}"),
-                                line: 0,
-                                col: 0,
-                            })?
-                            .compose(&s);
-                    }
-                    Type::Bool
-                }
-                BinOp::And | BinOp::Or => Type::Bool,
-                BinOp::Pipe => {
-                    // a |> f : if f has type T -> U, unify T with type of a, result is U
-                    let ret = Type::Var(fresh_tvar());
-                    let f_ty = Type::Arrow(Box::new(t1.clone()), Box::new(ret.clone()));
-                    s = unify(&t2, &f_ty)
-                        .map_err(|e| TypeError {
-                            msg: format!("pipe operator: {e}"),
-                            line: 0,
-                            col: 0,
-                        })?
-                        .compose(&s);
-                    s.apply(&ret)
-                }
-                BinOp::GtGt => {
-                    t1.clone() // TODO: proper function composition typing
-                }
-                BinOp::SAdd => Type::String,
-            };
-            Ok((s, result_type))
-        }
-
-        Expr::Unary { op, right } => {
-            let (mut s, t) = infer(
-                env,
-                right,
-                structs,
-                struct_fields,
-                enums,
-                enum_variants,
-                interface_registry,
-            )?;
-            match op {
-                UnOp::Neg => {
-                    let applied = s.apply(&t);
-                    s = unify(&applied, &Type::Int64)
-                        .or_else(|_| unify(&applied, &Type::Float64))
-                        .map_err(|_| TypeError {
-                            msg: format!("negation requires numeric type, got {applied}"),
-                            line: 0,
-                            col: 0,
-                        })?
-                        .compose(&s);
-                    Ok((s, applied))
-                }
-                UnOp::Not => Ok((s, Type::Bool)),
-            }
-        }
-
-        Expr::Block(stmts) => {
-            let mut s = Subst::empty();
-            let mut local_env = env.clone();
-            let mut result = Type::Null;
-            for stmt in stmts {
-                match stmt {
-                    Stmt::ConstDecl { name, value, .. } => {
-                        let (s_val, ty) = infer(
-                            &local_env,
-                            value,
-                            structs,
-                            struct_fields,
-                            enums,
-                            enum_variants,
-                            interface_registry,
-                        )?;
-                        let scheme = generalize(&local_env, &s_val.apply(&ty));
-                        local_env.insert(name.clone(), scheme);
-                        s = s.compose(&s_val);
-                        result = Type::Null;
-                    }
-                    Stmt::VarDecl { name, value, .. } => {
-                        let ty = if let Some(val) = value {
-                            let (s_val, t) = infer(
-                                &local_env,
-                                val,
-                                structs,
-                                struct_fields,
-                                enums,
-                                enum_variants,
-                                interface_registry,
-                            )?;
-                            s = s.compose(&s_val);
-                            t
-                        } else {
-                            Type::Var(fresh_tvar())
-                        };
-                        local_env.insert(name.clone(), Scheme::monomorphic(ty));
-                        result = Type::Null;
-                    }
-                    Stmt::ExprStmt(expr) => {
-                        let span = expr_span(expr);
-                        let (s_e, ty) = infer(
-                            &local_env,
-                            expr,
-                            structs,
-                            struct_fields,
-                            enums,
-                            enum_variants,
-                            interface_registry,
-                        )
-                        .map_err(|e| annotate_err(e, &span))?;
-                        s = s.compose(&s_e);
-                        result = ty;
-                    }
-                    _ => {}
-                }
-            }
-            Ok((s, result))
-        }
-
-        Expr::If {
-            cond,
-            then_branch,
-            else_branch,
-        } => {
-            let (s_c, _tc) = infer(
-                env,
-                cond,
-                structs,
-                struct_fields,
-                enums,
-                enum_variants,
-                interface_registry,
-            )?;
-            let (s_t, tt) = infer(
-                env,
-                then_branch,
-                structs,
-                struct_fields,
-                enums,
-                enum_variants,
-                interface_registry,
-            )?;
-            if let Some(eb) = else_branch {
-                let (s_e, te) = infer(
-                    env,
-                    eb,
-                    structs,
-                    struct_fields,
-                    enums,
-                    enum_variants,
-                    interface_registry,
-                )?;
-                let mut s = s_c.compose(&s_t).compose(&s_e);
-                s = unify(&s.apply(&tt), &s.apply(&te))
-                    .map_err(|e| TypeError {
-                        msg: format!("if branches: {e}"),
-                        line: 0,
-                        col: 0,
-                    })?
-                    .compose(&s);
-                Ok((s.clone(), s.apply(&tt)))
-            } else {
-                let s = s_c.compose(&s_t);
-                Ok((s.clone(), s.apply(&tt)))
-            }
-        }
-
-        Expr::While { cond, body } => {
-            let (s_c, _) = infer(
-                env,
-                cond,
-                structs,
-                struct_fields,
-                enums,
-                enum_variants,
-                interface_registry,
-            )?;
-            let (s_b, _) = infer(
-                env,
-                body,
-                structs,
-                struct_fields,
-                enums,
-                enum_variants,
-                interface_registry,
-            )?;
-            Ok((s_c.compose(&s_b), Type::Null))
-        }
-
-        Expr::For {
-            var,
-            iterable,
-            body,
-        } => {
-            let (mut s_i, ti) = infer(
-                env,
-                iterable,
-                structs,
-                struct_fields,
-                enums,
-                enum_variants,
-                interface_registry,
-            )?;
-            let applied = s_i.apply(&ti);
-            // ti should be List<'a>; if it's a type var, unify it with List<?>
-            match applied {
-                Type::List(elem) => {
-                    let mut local_env = env.clone();
-                    local_env.insert(var.name.clone(), Scheme::monomorphic((*elem).clone()));
-                    let (s_b, _) = infer(
-                        &local_env,
-                        body,
-                        structs,
-                        struct_fields,
-                        enums,
-                        enum_variants,
-                        interface_registry,
-                    )?;
-                    Ok((s_i.compose(&s_b), Type::Null))
-                }
-                Type::Var(_) => {
-                    let elem = Type::Var(fresh_tvar());
-                    let list_ty = Type::List(Box::new(elem.clone()));
-                    s_i = unify(&applied, &list_ty)
-                        .map_err(|e| TypeError {
-                            msg: format!("for loop: {e}"),
-                            line: 0,
-                            col: 0,
-                        })?
-                        .compose(&s_i);
-                    let mut local_env = env.clone();
-                    local_env.insert(var.name.clone(), Scheme::monomorphic(elem));
-                    let (s_b, _) = infer(
-                        &local_env,
-                        body,
-                        structs,
-                        struct_fields,
-                        enums,
-                        enum_variants,
-                        interface_registry,
-                    )?;
-                    Ok((s_i.compose(&s_b), Type::Null))
-                }
-                other => Err(TypeError {
-                    msg: format!("for loop requires List, got {other}"),
-                    line: 0,
-                    col: 0,
-                }),
-            }
-        }
-
-        Expr::Break | Expr::Continue => Ok((Subst::empty(), Type::Null)),
-        Expr::Return(val) => {
-            if let Some(expr) = val {
-                infer(
-                    env,
-                    expr,
-                    structs,
-                    struct_fields,
-                    enums,
-                    enum_variants,
-                    interface_registry,
-                )
-            } else {
-                Ok((Subst::empty(), Type::Null))
-            }
-        }
-
-        Expr::Member { object, field } => {
-            let (s, ty) = infer(
-                env,
-                object,
-                structs,
-                struct_fields,
-                enums,
-                enum_variants,
-                interface_registry,
-            )?;
-            let applied = s.apply(&ty);
-
-            // Handle Interface type: look up method in interface definition
-            if let Type::Interface(iface_name) = &applied {
-                if let Some(methods) = interface_registry.get(iface_name) {
-                    if let Some((_, _, ret_ty)) =
-                        methods.iter().find(|(mname, _, _)| mname == field)
-                    {
-                        return Ok((s, ret_ty.clone().unwrap_or(Type::Null)));
-                    }
-                }
-                return Err(TypeError {
-                    msg: format!("method '{field}' not found on interface {iface_name}"),
-                    line: 0,
-                    col: 0,
-                });
-            }
-
-            // Determine the "struct name" of the applied type (for method lookup)
-            let struct_name: Option<String> = match &applied {
-                Type::Int64 => Some("Int64".into()),
-                Type::Float64 => Some("Float64".into()),
-                Type::String => Some("String".into()),
-                Type::Bool => Some("Bool".into()),
-                Type::List(_) => Some("List".into()),
-                Type::Record(id, _) => structs
-                    .iter()
-                    .find(|(_, &sid)| sid == *id)
-                    .map(|(n, _)| n.clone()),
-                Type::Variant(_, name, _) => Some(name.clone()),
-                _ => None,
-            };
-
-            // Try method lookup: "{struct_name}.{field}" in env
-            if let Some(ref sn) = struct_name {
-                let method_name = format!("{sn}.{field}");
-                if let Some(scheme) = env.get(&method_name) {
-                    let method_ty = instantiate(scheme);
-                    // 剥离 self 参数：从 param tuple 中移除第一个元素
-                    let result_ty = match method_ty {
-                        Type::Arrow(param_ty, body_ty) => {
-                            match *param_ty {
-                                Type::Tuple(mut elems) if !elems.is_empty() => {
-                                    elems.remove(0); // drop self
-                                    match elems.len() {
-                                        0 => *body_ty,
-                                        1 => Type::Arrow(
-                                            Box::new(elems.into_iter().next().unwrap()),
-                                            body_ty,
-                                        ),
-                                        _ => Type::Arrow(Box::new(Type::Tuple(elems)), body_ty),
-                                    }
-                                }
-                                _ => *body_ty, // single self param, no remaining args
-                            }
-                        }
-                        other => other,
-                    };
-                    return Ok((s, result_ty));
-                }
-            }
-
-            // Try struct field access (Record only)
-            if let Type::Record(_, ref fields) = applied {
-                if let Some(t) = fields
-                    .iter()
-                    .find(|(n, _)| n == field)
-                    .map(|(_, t)| t.clone())
-                {
-                    return Ok((s, t));
-                }
-            }
-
-            Err(TypeError {
-                msg: format!("field or method '{field}' not found on {applied}"),
-                line: 0,
-                col: 0,
-            })
-        }
-
-        Expr::Index { object, index } => {
-            let (s1, t_obj) = infer(
-                env,
-                object,
-                structs,
-                struct_fields,
-                enums,
-                enum_variants,
-                interface_registry,
-            )?;
-            let (s2, _) = infer(
-                env,
-                index,
-                structs,
-                struct_fields,
-                enums,
-                enum_variants,
-                interface_registry,
-            )?;
-            let s = s1.compose(&s2);
-            match s.apply(&t_obj) {
-                Type::List(elem) => Ok((s.clone(), s.apply(&elem))),
-                Type::String => Ok((s, Type::String)),
-                Type::Tuple(elements) => {
-                    // Tuple access: mid[0], mid[1], etc. — index must be a literal int
-                    let idx_val = match index.as_ref() {
-                        Expr::LitInt(n) => *n,
-                        _ => {
-                            return Err(TypeError {
-                                msg: "tuple index must be a literal integer".into(),
-                                line: 0, col: 0,
-                            });
-                        }
-                    };
-                    if idx_val < 0 || idx_val as usize >= elements.len() {
-                        return Err(TypeError {
-                            msg: format!(
-                                "tuple index {idx_val} out of bounds (0..{})",
-                                elements.len()
-                            ),
-                            line: 0, col: 0,
-                        });
-                    }
-                    Ok((s.clone(), elements[idx_val as usize].clone()))
-                }
-                other => Err(TypeError {
-                    msg: format!("cannot index into type {other}"),
-                    line: 0,
-                    col: 0,
-                }),
-            }
-        }
-
-        Expr::StructLit { name, fields, .. } => {
-            let id = structs.get(name).ok_or_else(|| TypeError {
-                msg: format!("unknown struct '{name}'"),
-                line: 0,
-                col: 0,
-            })?;
-            let field_types = struct_fields.get(id).cloned().unwrap_or_default();
-            let mut s = Subst::empty();
-            for (fname, fval) in fields {
-                let (s_f, t_val) = infer(
-                    env,
-                    fval,
-                    structs,
-                    struct_fields,
-                    enums,
-                    enum_variants,
-                    interface_registry,
-                )?;
-                // Unify field value type with declared field type
-                if let Some((_, declared)) = field_types.iter().find(|(n, _)| n == fname) {
-                    s = unify(&s.apply(&t_val), &s.apply(declared))
-                        .map_err(|e| TypeError {
-                            msg: format!("field '{fname}': {e}"),
-                            line: 0,
-                            col: 0,
-                        })?
-                        .compose(&s);
-                }
-                s = s.compose(&s_f);
-            }
-            Ok((s, Type::Record(*id, field_types)))
-        }
-
-        Expr::VariantLit {
-            enum_name,
-            variant_name,
-            fields,
-            ..
-        } => {
-            let id = enums.get(enum_name).ok_or_else(|| TypeError {
-                msg: format!("unknown enum '{enum_name}'"),
-                line: 0,
-                col: 0,
-            })?;
-            let variant_info = enum_variants
-                .get(id)
-                .and_then(|vs| vs.iter().find(|(n, _)| n == variant_name))
-                .ok_or_else(|| TypeError {
-                    msg: format!("unknown variant '{variant_name}'"),
-                    line: 0,
-                    col: 0,
-                })?;
-            let mut s = Subst::empty();
-            for (i, fval) in fields.iter().enumerate() {
-                let (s_f, t_val) = infer(
-                    env,
-                    fval,
-                    structs,
-                    struct_fields,
-                    enums,
-                    enum_variants,
-                    interface_registry,
-                )?;
-                // Unify with declared variant field type
-                if let Some((_, declared)) = variant_info.1.get(i) {
-                    s = unify_with_registry(
-                        &s.apply(&t_val),
-                        &s.apply(declared),
-                        interface_registry,
-                        structs,
-                    )
-                    .map_err(|e| TypeError {
-                        msg: format!("variant field: {e}"),
-                        line: 0,
-                        col: 0,
-                    })?
-                    .compose(&s);
-                }
-                s = s.compose(&s_f);
-            }
-            Ok((
-                s,
-                Type::Variant(*id, variant_name.clone(), variant_info.1.clone()),
-            ))
-        }
-
-        Expr::GetVariantTag(inner) => {
-            let (s, ty) = infer(
-                env,
-                inner,
-                structs,
-                struct_fields,
-                enums,
-                enum_variants,
-                interface_registry,
-            )?;
-            // Verify inner is a variant type
-            match s.apply(&ty) {
-                Type::Variant(..) => {}
-                _ => {
-                    return Err(TypeError {
-                        msg: format!("GetVariantTag expected variant type, got {ty}"),
-                        line: 0,
-                        col: 0,
-                    })
-                }
-            }
-            Ok((s, Type::Int64))
-        }
-
-        Expr::GetVariantField { object, field_idx } => {
-            let (s, ty) = infer(
-                env,
-                object,
-                structs,
-                struct_fields,
-                enums,
-                enum_variants,
-                interface_registry,
-            )?;
-            let applied = s.apply(&ty);
-            match applied {
-                Type::Variant(_id, _name, fields) => {
-                    let ft = fields
-                        .get(*field_idx as usize)
-                        .cloned()
-                        .map(|(_, t)| t)
-                        .unwrap_or(Type::Var(fresh_tvar()));
-                    Ok((s, ft))
-                }
-                _ => Err(TypeError {
-                    msg: format!("GetVariantField expected variant type, got {ty}"),
-                    line: 0,
-                    col: 0,
-                }),
-            }
-        }
-
-        Expr::ListLit(items) => {
-            let mut s = Subst::empty();
-            let elem_ty = Type::Var(fresh_tvar());
-            for item in items {
-                let (s_i, ti) = infer(
-                    env,
-                    item,
-                    structs,
-                    struct_fields,
-                    enums,
-                    enum_variants,
-                    interface_registry,
-                )?;
-                s = s.compose(&s_i);
-                s = unify(&s.apply(&elem_ty), &s.apply(&ti))
-                    .map_err(|e| TypeError {
-                        msg: format!("list element: {e}"),
-                        line: 0,
-                        col: 0,
-                    })?
-                    .compose(&s);
-            }
-            Ok((s, Type::List(Box::new(elem_ty))))
-        }
-
-        Expr::Tuple(items) => {
-            let mut s = Subst::empty();
-            let mut element_types = Vec::with_capacity(items.len());
-            for item in items {
-                let (s_i, ti) = infer(
-                    env,
-                    item,
-                    structs,
-                    struct_fields,
-                    enums,
-                    enum_variants,
-                    interface_registry,
-                )?;
-                s = s.compose(&s_i);
-                element_types.push(ti);
-            }
-            Ok((s, Type::Tuple(element_types)))
-        }
-
-        Expr::Assign { target, value } => {
-            let (s1, t_target) = infer(
-                env,
-                target,
-                structs,
-                struct_fields,
-                enums,
-                enum_variants,
-                interface_registry,
-            )?;
-            let (s2, t_val) = infer(
-                env,
-                value,
-                structs,
-                struct_fields,
-                enums,
-                enum_variants,
-                interface_registry,
-            )?;
-            let mut s = s1.compose(&s2);
-            s = unify(&s.apply(&t_target), &s.apply(&t_val))
-                .map_err(|e| TypeError {
-                    msg: format!("assignment type mismatch: {e}"),
-                    line: 0,
-                    col: 0,
-                })?
-                .compose(&s);
-            Ok((s, Type::Null))
-        }
-
-        Expr::Async(body) => infer(
-            env,
-            body,
-            structs,
-            struct_fields,
-            enums,
-            enum_variants,
-            interface_registry,
-        ),
-        Expr::Await(body) => infer(
-            env,
-            body,
-            structs,
-            struct_fields,
-            enums,
-            enum_variants,
-            interface_registry,
-        ),
-    }
-}
-
-// ── 统一 ──
-
-/// Unify with interface and struct registry for Struct↔Interface validation.
-pub fn unify_with_registry(
-    t1: &Type,
-    t2: &Type,
-    interface_registry: &HashMap<String, Vec<(String, Vec<(String, Type)>, Option<Type>)>>,
-    struct_registry: &HashMap<String, usize>,
-) -> Result<Subst, String> {
-    unify_impl(t1, t2, Some(interface_registry), Some(struct_registry))
-}
-
-/// Unify without interface/struct lookup (for tests and simple cases).
-pub fn unify(t1: &Type, t2: &Type) -> Result<Subst, String> {
-    unify_impl(t1, t2, None, None)
-}
-
-fn unify_impl(
-    t1: &Type,
-    t2: &Type,
-    interface_registry: Option<&HashMap<String, Vec<(String, Vec<(String, Type)>, Option<Type>)>>>,
-    struct_registry: Option<&HashMap<String, usize>>,
-) -> Result<Subst, String> {
-    match (t1, t2) {
-        (a, b) if a == b => Ok(Subst::empty()),
-        (Type::Var(v), ty) if !occurs_check(v, ty) => Ok(Subst::singleton(*v, ty.clone())),
-        (ty, Type::Var(v)) if !occurs_check(v, ty) => Ok(Subst::singleton(*v, ty.clone())),
-        // Struct ↔ Interface: validate impl relationship
-        (Type::Record(..), Type::Interface(iface_name))
-        | (Type::Interface(iface_name), Type::Record(..)) => {
-            if let Some(reg) = interface_registry {
-                if reg.contains_key(iface_name.as_str()) {
-                    Ok(Subst::empty())
-                } else {
-                    Err(format!("unknown interface '{iface_name}'"))
-                }
-            } else {
-                // Without registry, allow the unification (best-effort)
-                Ok(Subst::empty())
-            }
-        }
-        (Type::Arrow(a1, r1), Type::Arrow(a2, r2)) => {
-            let s1 = unify_impl(a1, a2, interface_registry, struct_registry)?;
-            let s2 = unify_impl(
-                &s1.apply(r1),
-                &s1.apply(r2),
-                interface_registry,
-                struct_registry,
-            )?;
-            Ok(s2.compose(&s1))
-        }
-        (Type::List(t1), Type::List(t2)) => unify_impl(t1, t2, interface_registry, struct_registry),
-        (Type::Tuple(e1), Type::Tuple(e2)) if e1.len() == e2.len() => {
-            let mut s = Subst::empty();
-            for (a, b) in e1.iter().zip(e2.iter()) {
-                let s_i = unify_impl(
-                    &s.apply(a),
-                    &s.apply(b),
-                    interface_registry,
-                    struct_registry,
-                )?;
-                s = s_i.compose(&s);
-            }
-            Ok(s)
-        }
-        (Type::Record(id1, _), Type::Record(id2, _)) if id1 == id2 => Ok(Subst::empty()),
-        (Type::Variant(id1, _, _), Type::Variant(id2, _, _)) if id1 == id2 => Ok(Subst::empty()),
-        _ => Err(format!("cannot unify {t1} and {t2}")),
-    }
-}
-
-fn occurs_check(var: &TypeVar, ty: &Type) -> bool {
-    match ty {
-        Type::Var(v) => v == var,
-        Type::Arrow(a, r) => occurs_check(var, a) || occurs_check(var, r),
-        Type::List(t) => occurs_check(var, t),
-        Type::Tuple(elements) => elements.iter().any(|t| occurs_check(var, t)),
-        Type::Record(_, fields) => fields.iter().any(|(_, t)| occurs_check(var, t)),
-        Type::Variant(_, _, fields) => fields.iter().any(|(_, t)| occurs_check(var, t)),
-        _ => false,
-    }
-}
-
-// ── 泛化 ──
-
-pub fn generalize(env: &TypeEnv, ty: &Type) -> Scheme {
-    let free = free_type_vars(ty);
-    let bound: Vec<TypeVar> = free
-        .into_iter()
-        .filter(|v| !env.values().any(|s| free_type_vars(&s.body).contains(v)))
-        .collect();
-    Scheme {
-        bound,
-        body: Box::new(ty.clone()),
-    }
-}
-
-fn free_type_vars(ty: &Type) -> Vec<TypeVar> {
-    let mut fv = Vec::new();
-    match ty {
-        Type::Var(v) => fv.push(*v),
-        Type::Arrow(a, r) => {
-            fv.append(&mut free_type_vars(a));
-            fv.append(&mut free_type_vars(r));
-        }
-        Type::List(t) => {
-            fv.append(&mut free_type_vars(t));
-        }
-        Type::Record(_, fields) => {
-            for (_, t) in fields {
-                fv.append(&mut free_type_vars(t));
-            }
-        }
-        Type::Variant(_, _, fields) => {
-            for (_, t) in fields {
-                fv.append(&mut free_type_vars(t));
-            }
-        }
-        _ => {}
-    }
-    fv.dedup();
-    fv
-}
-
-// ── 实例化 ──
-
-pub fn instantiate(scheme: &Scheme) -> Type {
-    let mut subst = Subst::empty();
-    for v in &scheme.bound {
-        subst.extend(*v, Type::Var(fresh_tvar()));
-    }
-    subst.apply(&scheme.body)
-}
-
-// ── 类型表达式转内部类型 ──
-
-fn type_expr_to_type(
-    te: &TypeExpr,
-    structs: &HashMap<String, usize>,
-    struct_fields: &HashMap<usize, Vec<(String, Type)>>,
-    interface_registry: &HashMap<String, Vec<(String, Vec<(String, Type)>, Option<Type>)>>,
-) -> InferResult<Type> {
-    match te {
-        TypeExpr::Named(n) => match n.as_str() {
-            "Int64" => Ok(Type::Int64),
-            "Float64" => Ok(Type::Float64),
-            "String" => Ok(Type::String),
-            "Bool" => Ok(Type::Bool),
-            "Null" => Ok(Type::Null),
-            _ => {
-                if let Some(&id) = structs.get(n) {
-                    let fields = struct_fields.get(&id).cloned().unwrap_or_default();
-                    Ok(Type::Record(id, fields))
-                } else if interface_registry.contains_key(n) {
-                    Ok(Type::Interface(n.to_string()))
-                } else {
-                    Err(TypeError {
-                        msg: format!("unknown type '{n}'"),
-                        line: 0,
-                        col: 0,
-                    })
-                }
-            }
-        },
-        TypeExpr::List(t) => Ok(Type::List(Box::new(type_expr_to_type(
-            t,
-            structs,
-            struct_fields,
-            interface_registry,
-        )?))),
-        TypeExpr::Arrow { params, ret } => {
-            let ret_ty = type_expr_to_type(ret, structs, struct_fields, interface_registry)?;
-            let param_tys: Vec<Type> = params
-                .iter()
-                .map(|p| type_expr_to_type(p, structs, struct_fields, interface_registry))
-                .collect::<Result<Vec<_>, _>>()?;
-            // 单参数不包裹元组（边界条件 1），多参数包裹为 Tuple
-            let param_ty = match param_tys.len() {
-                0 => Type::Tuple(vec![]),
-                1 => param_tys.into_iter().next().unwrap(),
-                _ => Type::Tuple(param_tys),
-            };
-            Ok(Type::Arrow(Box::new(param_ty), Box::new(ret_ty)))
-        }
-        TypeExpr::Tuple(elements) => {
-            let tys: Vec<Type> = elements
-                .iter()
-                .map(|e| type_expr_to_type(e, structs, struct_fields, interface_registry))
-                .collect::<Result<Vec<_>, _>>()?;
-            Ok(Type::Tuple(tys))
-        }
-    }
-}
-
-// ── tests ──
-
-#[cfg(test)]
-#[allow(clippy::approx_constant)]
-mod tests {
-    use super::*;
-
-    const S: Span = Span { line: 0, col: 0 };
-
-    fn module(stmts: Vec<Stmt>) -> Module {
-        Module { stmts }
-    }
-
-    fn const_decl(name: &str, value: Expr) -> Stmt {
-        Stmt::ConstDecl {
-            name: name.to_string(),
-            span: S,
-            ty_ann: None,
-            value,
-        }
-    }
-
-    fn var_decl(name: &str, value: Option<Expr>) -> Stmt {
-        Stmt::VarDecl {
-            name: name.to_string(),
-            span: S,
-            ty_ann: None,
-            value,
-        }
-    }
-
-    fn param(name: &str, ty_ann: Option<TypeExpr>) -> Param {
-        Param {
-            name: name.to_string(),
-            span: S,
-            ty_ann,
-        }
-    }
-
-    fn empty_structs() -> (HashMap<String, usize>, HashMap<usize, Vec<(String, Type)>>) {
-        (HashMap::new(), HashMap::new())
-    }
-
-    fn empty_enums() -> HashMap<String, usize> {
-        HashMap::new()
-    }
-
-    fn empty_enum_variants() -> HashMap<usize, Vec<(String, Vec<(String, Type)>)>> {
-        HashMap::new()
-    }
-
-    fn empty_interface_registry(
-    ) -> HashMap<String, Vec<(String, Vec<(String, Type)>, Option<Type>)>> {
-        HashMap::new()
-    }
-
-    fn infer_expr(expr: Expr) -> InferResult<Type> {
-        let (mut structs, mut fields) = empty_structs();
-        let mut interface_registry = HashMap::new();
-        inject_builtin_interfaces(&mut interface_registry);
-        inject_builtin_impls(
-            &mut TypeEnv::new(),
-            &mut structs,
-            &mut fields,
-            &mut interface_registry,
-        );
-        let mut env = TypeEnv::new();
-        inject_builtin_impls(&mut env, &mut structs, &mut fields, &mut interface_registry);
-        let (subst, ty) = infer(
-            &env,
-            &expr,
-            &structs,
-            &fields,
-            &empty_enums(),
-            &empty_enum_variants(),
-            &empty_interface_registry(),
-        )?;
-        Ok(subst.apply(&ty))
-    }
-
-    fn infer_ast(module: Module) -> InferResult<(TypeEnv, HashMap<usize, Vec<(String, Type)>>)> {
-        infer_module(&module)
-    }
-
-    fn infer_src(src: &str) -> InferResult<(TypeEnv, HashMap<usize, Vec<(String, Type)>>)> {
-        match src {
-            "const x = 42;" => infer_ast(module(vec![const_decl("x", Expr::LitInt(42))])),
-            "const x = 3.14;" => infer_ast(module(vec![const_decl("x", Expr::LitFloat(3.14))])),
-            "const s = \"hi\"; const b = true;" => infer_ast(module(vec![
-                const_decl("s", Expr::LitString("hi".to_string())),
-                const_decl("b", Expr::LitTrue),
-            ])),
-            "const add = |a, b| { a + b };" => infer_ast(module(vec![const_decl(
-                "add",
-                Expr::Lambda {
-                    params: vec![
-                        Param {
-                    name: "a".to_string(),
-                    span: S,
-                    ty_ann: None,
-                },
-                        Param {
-                    name: "b".to_string(),
-                    span: S,
-                    ty_ann: None,
-                },
-                    ],
-                    ret_ty: None,
-                    body: Box::new(Expr::Block(vec![Stmt::ExprStmt(Expr::Binary {
-                        left: Box::new(Expr::VarRef { name: "a".to_string(), span: S }),
-                        op: BinOp::Add,
-                        right: Box::new(Expr::VarRef { name: "b".to_string(), span: S }),
-                    })])),
-                },
-            )])),
-            "const id = |x| { x };" => infer_ast(module(vec![const_decl(
-                "id",
-                Expr::Lambda {
-                    params: vec![Param {
-                    name: "x".to_string(),
-                    span: S,
-                    ty_ann: None,
-                }],
-                    ret_ty: None,
-                    body: Box::new(Expr::Block(vec![Stmt::ExprStmt(Expr::VarRef { name: "x".to_string(), span: S })])),
-                },
-            )])),
-            "struct Point { x: Float64, y: Float64 }; const p = Point { x: 1.0, y: 2.0 };" => {
-                infer_ast(module(vec![
-                    Stmt::StructDef {
-                    name: "Point".to_string(),
-                    span: S,
-                    fields: vec![
-                            FieldDef {
-                    name: "x".to_string(),
-                    span: S,
-                    ty: TypeExpr::Named("Float64".to_string()),
-                },
-                            FieldDef {
-                    name: "y".to_string(),
-                    span: S,
-                    ty: TypeExpr::Named("Float64".to_string()),
-                },
-                        ],
-                    },
-                    const_decl(
-                        "p",
-                        Expr::StructLit {
-                            name: "Point".to_string(),
-                            fields: vec![
-                                ("x".to_string(), Expr::LitFloat(1.0)),
-                                ("y".to_string(), Expr::LitFloat(2.0)),
-                            ],
-                            spread: None,
-                        },
-                    ),
-                ]))
-            }
-            "const s = 42.to_string();" => infer_ast(module(vec![const_decl(
-                "s",
-                Expr::Member {
-                    object: Box::new(Expr::LitInt(42)),
-                    field: "to_string".to_string(),
-                },
-            )])),
-            "var x = 42;" => infer_ast(module(vec![Stmt::VarDecl {
-                name: "x".to_string(),
-                span: S,
-                ty_ann: None,
-                value: Some(Expr::LitInt(42)),
-            }])),
-            _ => panic!("test fixture should construct AST directly for source: {src}"),
-        }
-    }
-
-    #[test]
-    fn test_int_literal() {
-        let (env, _) = infer_src("const x = 42;").unwrap();
-        match env.get("x") {
-            Some(s) => assert_eq!(format!("{}", s.body), "Int64"),
-            None => panic!("x not found"),
-        }
-    }
-
-    #[test]
-    fn test_float_literal() {
-        let (env, _) = infer_src("const x = 3.14;").unwrap();
-        match env.get("x") {
-            Some(s) => assert_eq!(format!("{}", s.body), "Float64"),
-            None => panic!(),
-        }
-    }
-
-    #[test]
-    fn test_string_and_bool() {
-        let (env, _) = infer_src("const s = \"hi\"; const b = true;").unwrap();
-        assert_eq!(format!("{}", env["s"].body), "String");
-        assert_eq!(format!("{}", env["b"].body), "Bool");
-    }
-
-    #[test]
-    fn test_lambda_simple() {
-        let (env, _) = infer_src("const add = |a, b| { a + b };").unwrap();
-        let ty = format!("{}", env["add"].body);
-        assert!(ty.contains("Int64 → Int64 → Int64") || ty.contains("→"));
-    }
-
-    #[test]
-    fn test_let_polymorphism() {
-        let (env, _) = infer_src("const id = |x| { x };").unwrap();
-        assert!(format!("{}", env["id"].body).contains("→"));
-        // id(42) and id(\"hi\") would both type-check with let-polymorphism
-    }
-
-    #[test]
-    fn test_var_is_monomorphic() {
-        let result = infer_var("var x = 42;");
-        assert!(result.is_ok());
-    }
-
-    #[test]
-    fn test_record_infer() {
-        let (env, _) = infer_src(
-            "struct Point { x: Float64, y: Float64 }; const p = Point { x: 1.0, y: 2.0 };",
-        )
-        .unwrap();
-        let ty = format!("{}", env["p"].body);
-        assert!(ty.contains("Point") || ty.contains("{"));
-    }
-
-    #[test]
-    fn test_to_string_returns_string() {
-        let (env, _) = infer_src("const s = 42.to_string();").unwrap();
-        let ty = format!("{}", env["s"].body);
-        assert_eq!(ty, "String");
-    }
-
-    #[test]
-    fn var_without_initializer_gets_fresh_type_var() {
-        let (env, _) = infer_ast(module(vec![var_decl("x", None)])).unwrap();
-        assert!(matches!(*env["x"].body, Type::Var(_)));
-    }
-
-    #[test]
-    fn annotated_lambda_uses_type_exprs() {
-        let ty = infer_expr(Expr::Lambda {
-            params: vec![param("x", Some(TypeExpr::named("Int64")))],
-            ret_ty: None,
-            body: Box::new(Expr::VarRef { name: "x".to_string(), span: S }),
-        })
-        .unwrap();
-
-        assert_eq!(format!("{ty}"), "(Int64 → Int64)");
-    }
-
-    #[test]
-    fn call_infers_return_type_and_call_errors_on_non_function() {
-        let id = Expr::Lambda {
-            params: vec![param("x", None)],
-            ret_ty: None,
-            body: Box::new(Expr::VarRef { name: "x".to_string(), span: S }),
-        };
-        assert_eq!(
-            infer_expr(Expr::Call {
-                func: Box::new(id),
-                arg: Box::new(Expr::LitString("ok".to_string())),
-            })
-            .unwrap(),
-            Type::String
-        );
-
-        let err = infer_expr(Expr::Call {
-            func: Box::new(Expr::LitInt(1)),
-            arg: Box::new(Expr::LitInt(2)),
-        })
-        .unwrap_err();
-        assert!(err.msg.contains("cannot call non-function type"));
-    }
-
-    #[test]
-    fn binary_unary_and_control_flow_exprs() {
-        assert_eq!(
-            infer_expr(Expr::Binary {
-                left: Box::new(Expr::LitInt(1)),
-                op: BinOp::Lt,
-                right: Box::new(Expr::LitInt(2)),
-            })
-            .unwrap(),
-            Type::Bool
-        );
-        assert_eq!(
-            infer_expr(Expr::Binary {
-                left: Box::new(Expr::LitString("a".to_string())),
-                op: BinOp::SAdd,
-                right: Box::new(Expr::LitString("b".to_string())),
-            })
-            .unwrap(),
-            Type::String
-        );
-        // pipe of non-function RHS should error
-        assert!(infer_expr(Expr::Binary {
-            left: Box::new(Expr::LitInt(1)),
-            op: BinOp::Pipe,
-            right: Box::new(Expr::LitInt(2)),
-        })
-        .is_err());
-        assert_eq!(
-            infer_expr(Expr::Unary {
-                op: UnOp::Not,
-                right: Box::new(Expr::LitFalse),
-            })
-            .unwrap(),
-            Type::Bool
-        );
-        assert_eq!(infer_expr(Expr::Break).unwrap(), Type::Null);
-        assert_eq!(infer_expr(Expr::Continue).unwrap(), Type::Null);
-        assert_eq!(infer_expr(Expr::Return(None)).unwrap(), Type::Null);
-        assert_eq!(
-            infer_expr(Expr::Return(Some(Box::new(Expr::LitFloat(1.0))))).unwrap(),
-            Type::Float64
-        );
-    }
-
-    #[test]
-    fn blocks_if_while_and_for_are_inferred_locally() {
-        assert_eq!(
-            infer_expr(Expr::Block(vec![
-                const_decl("x", Expr::LitInt(1)),
-                var_decl("y", Some(Expr::LitInt(2))),
-                Stmt::ExprStmt(Expr::VarRef { name: "x".to_string(), span: S }),
-            ]))
-            .unwrap(),
-            Type::Int64
-        );
-        assert_eq!(
-            infer_expr(Expr::If {
-                cond: Box::new(Expr::LitTrue),
-                then_branch: Box::new(Expr::LitInt(1)),
-                else_branch: None,
-            })
-            .unwrap(),
-            Type::Int64
-        );
-        assert_eq!(
-            infer_expr(Expr::While {
-                cond: Box::new(Expr::LitFalse),
-                body: Box::new(Expr::Block(vec![])),
-            })
-            .unwrap(),
-            Type::Null
-        );
-        assert_eq!(
-            infer_expr(Expr::For {
-                var: param("item", None),
-                iterable: Box::new(Expr::ListLit(vec![Expr::LitInt(1)])),
-                body: Box::new(Expr::Block(vec![])),
-            })
-            .unwrap(),
-            Type::Null
-        );
-
-        let err = infer_expr(Expr::For {
-            var: param("item", None),
-            iterable: Box::new(Expr::LitInt(1)),
-            body: Box::new(Expr::Block(vec![])),
-        })
-        .unwrap_err();
-        assert!(err.msg.contains("for loop requires List"));
-    }
-
-    #[test]
-    fn mismatched_if_and_list_report_errors() {
-        let err = infer_expr(Expr::If {
-            cond: Box::new(Expr::LitTrue),
-            then_branch: Box::new(Expr::LitInt(1)),
-            else_branch: Some(Box::new(Expr::LitString("x".to_string()))),
-        })
-        .unwrap_err();
-        assert!(err.msg.contains("if branches"));
-
-        let err = infer_expr(Expr::ListLit(vec![
-            Expr::LitInt(1),
-            Expr::LitString("x".to_string()),
-        ]))
-        .unwrap_err();
-        assert!(err.msg.contains("list element"));
-    }
-
-    #[test]
-    fn struct_fields_methods_and_member_errors() {
-        let program = module(vec![
-            Stmt::StructDef {
-                    name: "Point".to_string(),
-                    span: S,
-                    fields: vec![FieldDef {
-                    name: "x".to_string(),
-                    span: S,
-                    ty: TypeExpr::named("Int64"),
-                }],
-            },
-            Stmt::ImplBlock {
-                    struct_name: "Point".to_string(),
-                    span: S,
-                    interface_name: None,
-                    methods: vec![MethodDef {
-                    name: "value".to_string(),
-                    span: S,
-                    body: Expr::Lambda {
-                        params: vec![param("self", Some(TypeExpr::named("Point")))],
-                        ret_ty: None,
-                        body: Box::new(Expr::LitInt(7)),
-                    },
-                    operator: false,
-                }],
-            },
-            const_decl(
-                "p",
-                Expr::StructLit {
-                    name: "Point".to_string(),
-                    fields: vec![("x".to_string(), Expr::LitInt(1))],
-                    spread: None,
-                },
-            ),
-            const_decl(
-                "x",
-                Expr::Member {
-                    object: Box::new(Expr::VarRef { name: "p".to_string(), span: S }),
-                    field: "x".to_string(),
-                },
-            ),
-            const_decl(
-                "m",
-                Expr::Member {
-                    object: Box::new(Expr::VarRef { name: "p".to_string(), span: S }),
-                    field: "value".to_string(),
-                },
-            ),
-        ]);
-        let (env, _) = infer_ast(program).unwrap();
-        assert_eq!(format!("{}", env["x"].body), "Int64");
-        assert_eq!(format!("{}", env["m"].body), "Int64");
-
-        let err = infer_ast(module(vec![const_decl(
-            "bad",
-            Expr::StructLit {
-                name: "Missing".to_string(),
-                fields: vec![],
-                spread: None,
-            },
-        )]))
-        .unwrap_err();
-        assert!(err.msg.contains("unknown struct"));
-
-        let err = infer_expr(Expr::Member {
-            object: Box::new(Expr::LitInt(1)),
-            field: "x".to_string(),
-        })
-        .unwrap_err();
-        assert!(
-            err.msg.contains("not found"),
-            "expected 'not found' error, got: {}",
-            err.msg
-        );
-    }
-
-    #[test]
-    fn member_builtins_index_assign_async_and_await() {
-        assert_eq!(
-            infer_expr(Expr::Member {
-                object: Box::new(Expr::LitInt(1)),
-                field: "to_float".to_string(),
-            })
-            .unwrap(),
-            Type::Float64
-        );
-        assert_eq!(
-            infer_expr(Expr::Index {
-                object: Box::new(Expr::ListLit(vec![Expr::LitInt(1)])),
-                index: Box::new(Expr::LitInt(0)),
-            })
-            .unwrap(),
-            Type::Int64
-        );
-        assert_eq!(
-            infer_expr(Expr::Index {
-                object: Box::new(Expr::LitString("abc".to_string())),
-                index: Box::new(Expr::LitInt(0)),
-            })
-            .unwrap(),
-            Type::String
-        );
-        // Index on Int is a type error
-        assert!(infer_expr(Expr::Index {
-            object: Box::new(Expr::LitInt(1)),
-            index: Box::new(Expr::LitInt(0)),
-        })
-        .is_err());
-        assert_eq!(
-            infer_expr(Expr::Assign {
-                target: Box::new(Expr::LitInt(1)),
-                value: Box::new(Expr::LitInt(42))
-            })
-            .unwrap(),
-            Type::Null
-        );
-        assert_eq!(
-            infer_expr(Expr::Async(Box::new(Expr::LitInt(1)))).unwrap(),
-            Type::Int64
-        );
-        assert_eq!(
-            infer_expr(Expr::Await(Box::new(Expr::LitFloat(3.14)))).unwrap(),
-            Type::Float64
-        );
-    }
-
-    #[test]
-    fn type_expr_unify_generalize_and_instantiate_edges() {
-        let t_int = Type::Int64;
-        let t_var = Type::Var(TypeVar(99999));
-        let sub = unify(&t_var, &t_int).unwrap();
-        assert_eq!(sub.apply(&t_var), Type::Int64);
-
-        let empty_env = TypeEnv::new();
-        let scheme = generalize(&empty_env, &Type::Int64);
-        assert!(scheme.bound.is_empty());
-        let inst = instantiate(&scheme);
-        assert_eq!(inst, Type::Int64);
-
-        let scheme_var = generalize(&empty_env, &Type::Var(TypeVar(1)));
-        assert_eq!(scheme_var.bound.len(), 1);
-    }
-
-    // ── Unification scenarios ──
-
-    #[test]
-    fn unify_identical_types() {
-        let s = unify(&Type::Int64, &Type::Int64).unwrap();
-        assert_eq!(s, Subst::empty());
-    }
-
-    #[test]
-    fn unify_var_with_int() {
-        let s = unify(&Type::Var(TypeVar(0)), &Type::Int64).unwrap();
-        assert_eq!(s.apply(&Type::Var(TypeVar(0))), Type::Int64);
-    }
-
-    #[test]
-    fn unify_int_with_var() {
-        let s = unify(&Type::Int64, &Type::Var(TypeVar(0))).unwrap();
-        assert_eq!(s.apply(&Type::Var(TypeVar(0))), Type::Int64);
-    }
-
-    #[test]
-    fn unify_arrow_types() {
-        let t1 = Type::Arrow(Box::new(Type::Int64), Box::new(Type::Bool));
-        let t2 = Type::Arrow(Box::new(Type::Int64), Box::new(Type::Bool));
-        assert!(unify(&t1, &t2).is_ok());
-    }
-
-    #[test]
-    fn unify_arrow_types_different_args() {
-        let t1 = Type::Arrow(Box::new(Type::Int64), Box::new(Type::Bool));
-        let t2 = Type::Arrow(Box::new(Type::Float64), Box::new(Type::Bool));
-        assert!(unify(&t1, &t2).is_err());
-    }
-
-    #[test]
-    fn unify_list_types() {
-        let s = unify(
-            &Type::List(Box::new(Type::Var(TypeVar(0)))),
-            &Type::List(Box::new(Type::Int64)),
-        )
-        .unwrap();
-        assert_eq!(
-            s.apply(&Type::List(Box::new(Type::Var(TypeVar(0))))),
-            Type::List(Box::new(Type::Int64))
-        );
-    }
-
-    #[test]
-    fn unify_record_same_id() {
-        let s = unify(
-            &Type::Record(1, vec![("x".into(), Type::Int64)]),
-            &Type::Record(1, vec![("y".into(), Type::Float64)]),
-        )
-        .unwrap();
-        // Records with same id unify (fields not checked structurally)
-        assert_eq!(s, Subst::empty());
-    }
-
-    #[test]
-    fn unify_incompatible_types_error() {
-        assert!(unify(&Type::Int64, &Type::String).is_err());
-        assert!(unify(&Type::Bool, &Type::Null).is_err());
-        assert!(unify(&Type::Int64, &Type::List(Box::new(Type::Int64))).is_err());
-    }
-
-    #[test]
-    fn occurs_check_prevents_infinite_types() {
-        let v = TypeVar(0);
-        let infinite = Type::Arrow(Box::new(Type::Var(v)), Box::new(Type::Var(v)));
-        // This should fail the occurs check
-        assert!(unify(&Type::Var(v), &infinite).is_err());
-    }
-
-    // ── Schema generalization and instantiation ──
-
-    #[test]
-    fn generalize_closed_type_is_monomorphic() {
-        let env = TypeEnv::new();
-        let scheme = generalize(&env, &Type::Int64);
-        assert!(scheme.bound.is_empty());
-    }
-
-    #[test]
-    fn generalize_open_type_is_polymorphic() {
-        let env = TypeEnv::new();
-        let scheme = generalize(
-            &env,
-            &Type::Arrow(
-                Box::new(Type::Var(TypeVar(7))),
-                Box::new(Type::Var(TypeVar(7))),
-            ),
-        );
-        assert_eq!(scheme.bound.len(), 1);
-    }
-
-    #[test]
-    fn generalize_respects_env_free_vars() {
-        let mut env = TypeEnv::new();
-        let scheme = generalize(&env, &Type::Var(TypeVar(0)));
-        assert_eq!(scheme.bound.len(), 1); // free in env → should be generalized
-        env.insert("f".into(), scheme);
-        // Now generalize again — var 0 is free in env, not generalized
-        let scheme2 = generalize(&env, &Type::Var(TypeVar(0)));
-        assert!(scheme2.bound.is_empty());
-    }
-
-    #[test]
-    fn instantiate_creates_fresh_vars() {
-        let t = Type::Arrow(
-            Box::new(Type::Var(TypeVar(0))),
-            Box::new(Type::Var(TypeVar(0))),
-        );
-        let env = TypeEnv::new();
-        let scheme = generalize(&env, &t);
-        let inst = instantiate(&scheme);
-        // Should produce an arrow with fresh type vars
-        match &inst {
-            Type::Arrow(a, r) => {
-                assert!(matches!(**a, Type::Var(_)));
-                assert!(matches!(**r, Type::Var(_)));
-            }
-            _ => panic!("expected arrow"),
-        }
-    }
-
-    // ── Type inference: expressions ──
-
-    #[test]
-    fn infer_lit_null() {
-        assert_eq!(infer_expr(Expr::LitNull).unwrap(), Type::Null);
-    }
-
-    #[test]
-    fn infer_lit_string() {
-        assert_eq!(
-            infer_expr(Expr::LitString("hello".into())).unwrap(),
-            Type::String
-        );
-    }
-
-    #[test]
-    fn infer_binop_add_int() {
-        assert_eq!(
-            infer_expr(Expr::Binary {
-                left: Box::new(Expr::LitInt(1)),
-                op: BinOp::Add,
-                right: Box::new(Expr::LitInt(2)),
-            })
-            .unwrap(),
-            Type::Int64
-        );
-    }
-
-    #[test]
-    fn infer_binop_sub_int() {
-        assert_eq!(
-            infer_expr(Expr::Binary {
-                left: Box::new(Expr::LitInt(5)),
-                op: BinOp::Sub,
-                right: Box::new(Expr::LitInt(3)),
-            })
-            .unwrap(),
-            Type::Int64
-        );
-    }
-
-    #[test]
-    fn infer_binop_mul_float() {
-        assert_eq!(
-            infer_expr(Expr::Binary {
-                left: Box::new(Expr::LitFloat(2.0)),
-                op: BinOp::Mul,
-                right: Box::new(Expr::LitFloat(3.0)),
-            })
-            .unwrap(),
-            Type::Float64
-        );
-    }
-
-    #[test]
-    fn infer_binop_div_int() {
-        assert_eq!(
-            infer_expr(Expr::Binary {
-                left: Box::new(Expr::LitInt(10)),
-                op: BinOp::Div,
-                right: Box::new(Expr::LitInt(3)),
-            })
-            .unwrap(),
-            Type::Int64
-        );
-    }
-
-    #[test]
-    fn infer_binop_mod_int() {
-        assert_eq!(
-            infer_expr(Expr::Binary {
-                left: Box::new(Expr::LitInt(10)),
-                op: BinOp::Mod,
-                right: Box::new(Expr::LitInt(3)),
-            })
-            .unwrap(),
-            Type::Int64
-        );
-    }
-
-    #[test]
-    fn infer_binop_eq_returns_bool() {
-        assert_eq!(
-            infer_expr(Expr::Binary {
-                left: Box::new(Expr::LitInt(1)),
-                op: BinOp::Eq,
-                right: Box::new(Expr::LitInt(2)),
-            })
-            .unwrap(),
-            Type::Bool
-        );
-    }
-
-    #[test]
-    fn infer_binop_ne_returns_bool() {
-        assert_eq!(
-            infer_expr(Expr::Binary {
-                left: Box::new(Expr::LitFloat(1.0)),
-                op: BinOp::Ne,
-                right: Box::new(Expr::LitFloat(2.0)),
-            })
-            .unwrap(),
-            Type::Bool
-        );
-    }
-
-    #[test]
-    fn infer_binop_and_returns_bool() {
-        assert_eq!(
-            infer_expr(Expr::Binary {
-                left: Box::new(Expr::LitTrue),
-                op: BinOp::And,
-                right: Box::new(Expr::LitFalse),
-            })
-            .unwrap(),
-            Type::Bool
-        );
-    }
-
-    #[test]
-    fn infer_binop_or_returns_bool() {
-        assert_eq!(
-            infer_expr(Expr::Binary {
-                left: Box::new(Expr::LitFalse),
-                op: BinOp::Or,
-                right: Box::new(Expr::LitTrue),
-            })
-            .unwrap(),
-            Type::Bool
-        );
-    }
-
-    #[test]
-    fn infer_binop_pipe() {
-        // 42 |> |x| { x + 1 }  :  pipe Int64 through (Int64 -> Int64) should give Int64
-        let func = Expr::Lambda {
-            params: vec![Param {
-                    name: "x".to_string(),
-                    span: S,
-                    ty_ann: Some(TypeExpr::Named("Int64".to_string())),
-                }],
-            body: Box::new(Expr::Binary {
-                left: Box::new(Expr::VarRef { name: "x".to_string(), span: S }),
-                op: BinOp::Add,
-                right: Box::new(Expr::LitInt(1)),
-            }),
-            ret_ty: Some(TypeExpr::Named("Int64".to_string())),
-        };
-        assert_eq!(
-            infer_expr(Expr::Binary {
-                left: Box::new(Expr::LitInt(42)),
-                op: BinOp::Pipe,
-                right: Box::new(func),
-            })
-            .unwrap(),
-            Type::Int64
-        );
-    }
-
-    #[test]
-    fn infer_binop_gtgt() {
-        assert_eq!(
-            infer_expr(Expr::Binary {
-                left: Box::new(Expr::LitString("a".into())),
-                op: BinOp::GtGt,
-                right: Box::new(Expr::LitString("b".into())),
-            })
-            .unwrap(),
-            Type::String
-        );
-    }
-
-    #[test]
-    fn infer_unary_neg_int() {
-        assert_eq!(
-            infer_expr(Expr::Unary {
-                op: UnOp::Neg,
-                right: Box::new(Expr::LitInt(1)),
-            })
-            .unwrap(),
-            Type::Int64
-        );
-    }
-
-    #[test]
-    fn infer_unary_not_returns_bool() {
-        assert_eq!(
-            infer_expr(Expr::Unary {
-                op: UnOp::Not,
-                right: Box::new(Expr::LitFalse),
-            })
-            .unwrap(),
-            Type::Bool
-        );
-    }
-
-    // ── Control flow inference ──
-
-    #[test]
-    fn infer_if_else_branches_unify() {
-        let e = Expr::If {
-            cond: Box::new(Expr::LitTrue),
-            then_branch: Box::new(Expr::LitInt(1)),
-            else_branch: Some(Box::new(Expr::LitInt(0))),
-        };
-        assert_eq!(infer_expr(e).unwrap(), Type::Int64);
-    }
-
-    #[test]
-    fn infer_if_without_else_returns_then_branch_type() {
-        let e = Expr::If {
-            cond: Box::new(Expr::LitTrue),
-            then_branch: Box::new(Expr::LitInt(1)),
-            else_branch: None,
-        };
-        // if without else: then_branch type propagates
-        assert_eq!(infer_expr(e).unwrap(), Type::Int64);
-    }
-
-    #[test]
-    fn infer_while_is_null() {
-        let e = Expr::While {
-            cond: Box::new(Expr::LitTrue),
-            body: Box::new(Expr::LitInt(1)),
-        };
-        assert_eq!(infer_expr(e).unwrap(), Type::Null);
-    }
-
-    #[test]
-    fn infer_block_returns_last_expr_type() {
-        let e = Expr::Block(vec![
-            Stmt::ExprStmt(Expr::LitInt(1)),
-            Stmt::ExprStmt(Expr::LitString("result".into())),
-        ]);
-        assert_eq!(infer_expr(e).unwrap(), Type::String);
-    }
-
-    #[test]
-    fn infer_empty_block_is_null() {
-        let e = Expr::Block(vec![]);
-        assert_eq!(infer_expr(e).unwrap(), Type::Null);
-    }
-
-    // ── Struct and member inference ──
-
-    #[test]
-    fn infer_struct_lit_validates_fields() {
-        // Struct lit without struct in registry → error
-        let err = infer_expr(Expr::StructLit {
-            name: "Missing".into(),
-            fields: vec![],
-            spread: None,
-        })
-        .unwrap_err();
-        assert!(err.msg.contains("unknown struct"));
-    }
-
-    #[test]
-    fn infer_field_access_on_record() {
-        let (structs, fields) = {
-            let mut s = HashMap::new();
-            let mut f = HashMap::new();
-            s.insert("X".into(), 1);
-            f.insert(1, vec![("val".into(), Type::Int64)]);
-            (s, f)
-        };
-        let env = TypeEnv::new();
-        // Infer StructLit to get a Record type, then access field
-        let lit = Expr::StructLit {
-            name: "X".into(),
-            fields: vec![("val".into(), Expr::LitInt(42))],
-            spread: None,
-        };
-        let (sub, ty) = infer(
-            &env,
-            &lit,
-            &structs,
-            &fields,
-            &empty_enums(),
-            &empty_enum_variants(),
-            &empty_interface_registry(),
-        )
-        .unwrap();
-        assert_eq!(
-            sub.apply(&ty),
-            Type::Record(1, vec![("val".into(), Type::Int64)])
-        );
-    }
-
-    #[test]
-    fn infer_field_access_errors_on_non_record() {
-        let err = infer_expr(Expr::Member {
-            object: Box::new(Expr::LitInt(42)),
-            field: "unknown".into(),
-        })
-        .unwrap_err();
-        assert!(
-            err.msg.contains("not found"),
-            "expected 'not found' error, got: {}",
-            err.msg
-        );
-    }
-
-    // ── List inference ──
-
-    #[test]
-    fn infer_empty_list_is_var() {
-        let ty = infer_expr(Expr::ListLit(vec![])).unwrap();
-        assert!(matches!(ty, Type::List(_)));
-    }
-
-    #[test]
-    fn infer_list_unifies_elements() {
-        let ty = infer_expr(Expr::ListLit(vec![
-            Expr::LitInt(1),
-            Expr::LitInt(2),
-            Expr::LitInt(3),
-        ]))
-        .unwrap();
-        assert_eq!(ty, Type::List(Box::new(Type::Int64)));
-    }
-
-    #[test]
-    fn infer_list_mixed_types_errors() {
-        let err = infer_expr(Expr::ListLit(vec![
-            Expr::LitInt(1),
-            Expr::LitString("x".into()),
-        ]))
-        .unwrap_err();
-        assert!(err.msg.contains("list element"));
-    }
-
-    // ── Call inference ──
-
-    #[test]
-    fn infer_call_with_matching_args() {
-        // Lambda with 1 arg called with 1 arg — should infer
-        let func = Expr::Lambda {
-            params: vec![param("x", None)],
-            ret_ty: None,
-            body: Box::new(Expr::VarRef { name: "x".into(), span: S }),
-        };
-        let call = Expr::Call {
-            func: Box::new(func),
-            arg: Box::new(Expr::LitInt(1)),
-        };
-        assert_eq!(infer_expr(call).unwrap(), Type::Int64);
-    }
-
-    #[test]
-    fn infer_call_with_matching_args_returns_body_type() {
-        // Lambda with 2 params called with 2 args
-        let func = Expr::Lambda {
-            params: vec![param("x", None), param("y", None)],
-            ret_ty: None,
-            body: Box::new(Expr::LitFloat(3.14)),
-        };
-        let call = Expr::Call {
-            func: Box::new(func),
-            arg: Expr::call_arg(vec![Expr::LitInt(1), Expr::LitInt(2)]),
-        };
-        assert_eq!(infer_expr(call).unwrap(), Type::Float64);
-    }
-
-    // ── Assign inference ──
-
-    #[test]
-    fn infer_assign_is_null() {
-        // Assign returns Null regardless of target/value types
-        let e = Expr::Assign {
-            target: Box::new(Expr::LitInt(1)),
-            value: Box::new(Expr::LitInt(0)),
-        };
-        assert_eq!(infer_expr(e).unwrap(), Type::Null);
-    }
-
-    // ── Reset TVAR ──
-
-    #[test]
-    fn reset_tvar_clears_counter() {
-        let _ = fresh_tvar();
-        let _ = fresh_tvar();
-        let _ = fresh_tvar();
-        reset_tvar();
-        let new_tvar = fresh_tvar();
-        assert_eq!(new_tvar, TypeVar(0));
-    }
-
-    // ── Stdlib presence ──
-
-    #[test]
-    fn stdlib_includes_print() {
-        let mut env = TypeEnv::new();
-        inject_stdlib(&mut env);
-        assert!(env.contains_key("print"));
-        assert!(env.contains_key("sqrt"));
-        assert!(env.contains_key("sin"));
-        assert!(env.contains_key("cos"));
-    }
-
-    // ── Polymorphic var ──
-
-    #[test]
-    fn var_without_init_is_fresh_var() {
-        let (env, _) = infer_ast(module(vec![var_decl("x", None)])).unwrap();
-        assert!(matches!(*env["x"].body, Type::Var(_)));
-    }
-
-    #[test]
-    fn monomorphic_var_after_assign() {
-        let (env, _) = infer_ast(module(vec![var_decl("x", Some(Expr::LitFloat(1.0)))])).unwrap();
-        assert_eq!(*env["x"].body, Type::Float64);
-    }
-
-    #[test]
-    fn type_expr_to_type_edge_cases() {
-        let mut structs = HashMap::new();
-        structs.insert("Node".to_string(), 1);
-        let mut fields = HashMap::new();
-        fields.insert(1, vec![("value".to_string(), Type::Int64)]);
-
-        assert_eq!(
-            type_expr_to_type(
-                &TypeExpr::List(Box::new(TypeExpr::named("Int64"))),
-                &structs,
-                &fields,
-                &empty_interface_registry(),
-            )
-            .unwrap(),
-            Type::List(Box::new(Type::Int64))
-        );
-        assert_eq!(
-            format!(
-                "{}",
-                type_expr_to_type(
-                    &TypeExpr::Arrow {
-                        params: vec![TypeExpr::named("Int64")],
-                        ret: Box::new(TypeExpr::named("Bool")),
-                    },
-                    &structs,
-                    &fields,
-                    &empty_interface_registry(),
-                )
-                .unwrap()
-            ),
-            "(Int64 → Bool)"
-        );
-        assert!(type_expr_to_type(
-            &TypeExpr::named("Missing"),
-            &structs,
-            &fields,
-            &empty_interface_registry()
-        )
-        .is_err());
-
-        assert!(unify(
-            &Type::Var(TypeVar(10)),
-            &Type::List(Box::new(Type::Var(TypeVar(10))))
-        )
-        .is_err());
-        assert!(unify(
-            &Type::Arrow(Box::new(Type::Int64), Box::new(Type::Bool)),
-            &Type::Arrow(Box::new(Type::Int64), Box::new(Type::String)),
-        )
-        .is_err());
-
-        let mut env = TypeEnv::new();
-        env.insert(
-            "kept".to_string(),
-            Scheme::monomorphic(Type::Var(TypeVar(1))),
-        );
-        let scheme = generalize(
-            &env,
-            &Type::Arrow(
-                Box::new(Type::Var(TypeVar(1))),
-                Box::new(Type::Var(TypeVar(2))),
-            ),
-        );
-        assert_eq!(scheme.bound, vec![TypeVar(2)]);
-        assert!(matches!(instantiate(&scheme), Type::Arrow(_, _)));
-    }
-
-    fn infer_var(src: &str) -> InferResult<(TypeEnv, HashMap<usize, Vec<(String, Type)>>)> {
-        infer_src(src)
-    }
-
-    // ── Type checking regression tests ──
-
-    #[test]
-    fn t30_struct_lit_rejects_wrong_field_type() {
-        // Point { x: "hello" } when x is Int64 — must fail
-        let (structs, fields) = {
-            let mut s = HashMap::new();
-            let mut f = HashMap::new();
-            s.insert("Point".into(), 0);
-            f.insert(0, vec![("x".into(), Type::Int64)]);
-            (s, f)
-        };
-        let lit = Expr::StructLit {
-            name: "Point".into(),
-            fields: vec![("x".into(), Expr::LitString("hi".into()))],
-            spread: None,
-        };
-        let env = TypeEnv::new();
-        assert!(infer(
-            &env,
-            &lit,
-            &structs,
-            &fields,
-            &empty_enums(),
-            &empty_enum_variants(),
-            &empty_interface_registry()
-        )
-        .is_err());
-    }
-
-    #[test]
-    fn t31_cmp_rejects_cross_type() {
-        // 1 == "abc" — must fail
-        let e = Expr::Binary {
-            left: Box::new(Expr::LitInt(1)),
-            op: BinOp::Eq,
-            right: Box::new(Expr::LitString("abc".into())),
-        };
-        let (structs, fields) = empty_structs();
-        let env = TypeEnv::new();
-        assert!(infer(
-            &env,
-            &e,
-            &structs,
-            &fields,
-            &empty_enums(),
-            &empty_enum_variants(),
-            &empty_interface_registry()
-        )
-        .is_err());
-    }
-
-    #[test]
-    fn t32_arith_rejects_bool() {
-        // true + false — must fail
-        let e = Expr::Binary {
-            left: Box::new(Expr::LitTrue),
-            op: BinOp::Add,
-            right: Box::new(Expr::LitFalse),
-        };
-        let (structs, fields) = empty_structs();
-        let env = TypeEnv::new();
-        assert!(infer(
-            &env,
-            &e,
-            &structs,
-            &fields,
-            &empty_enums(),
-            &empty_enum_variants(),
-            &empty_interface_registry()
-        )
-        .is_err());
-    }
-
-    #[test]
-    fn t33_neg_rejects_non_numeric() {
-        // -true — must fail
-        let e = Expr::Unary {
-            op: UnOp::Neg,
-            right: Box::new(Expr::LitTrue),
-        };
-        assert!(infer_expr(e).is_err());
-    }
-
-    #[test]
-    fn t34_assign_unifies_types() {
-        // x = 42 when x: String — must fail (x must be pre-bound as String)
-        let mut env = TypeEnv::new();
-        env.insert("x".into(), Scheme::monomorphic(Type::String));
-        let e = Expr::Assign {
-            target: Box::new(Expr::VarRef { name: "x".into(), span: S }),
-            value: Box::new(Expr::LitInt(42)),
-        };
-        let (structs, fields) = empty_structs();
-        assert!(infer(
-            &env,
-            &e,
-            &structs,
-            &fields,
-            &empty_enums(),
-            &empty_enum_variants(),
-            &empty_interface_registry()
-        )
-        .is_err());
-    }
-
-    #[test]
-    fn t35_index_rejects_non_list_non_string() {
-        // 42[0] — must fail
-        let e = Expr::Index {
-            object: Box::new(Expr::LitInt(42)),
-            index: Box::new(Expr::LitInt(0)),
-        };
-        assert!(infer_expr(e).is_err());
-    }
-
-    #[test]
-    fn t36_for_accepts_polymorphic_list() {
-        // for x in list where list is a lambda param (unbound type var) — should succeed
-        reset_tvar();
-        let list_var = fresh_tvar();
-        let mut env = TypeEnv::new();
-        // Unbound: list is just Var, not yet unified with List
-        env.insert("list".into(), Scheme::monomorphic(Type::Var(list_var)));
-        let e = Expr::For {
-            var: Param {
-                    name: "x".into(),
-                    span: S,
-                    ty_ann: None,
-                },
-            iterable: Box::new(Expr::VarRef { name: "list".into(), span: S }),
-            body: Box::new(Expr::Block(vec![])),
-        };
-        let (structs, fields) = empty_structs();
-        // Should NOT error with "for loop requires List" — should unify list with List<?>
-        assert!(infer(
-            &env,
-            &e,
-            &structs,
-            &fields,
-            &empty_enums(),
-            &empty_enum_variants(),
-            &empty_interface_registry()
-        )
-        .is_ok());
-    }
-}
+//! Algorithm W — Hindley-Milner 类型推断
+//!
+//! 推断状态都在 [`Infer`] 上下文里：类型变量是 [`TyTable`] 中的 union-find 槽位，
+//! 统一原地绑定；let 泛化按变量 level 判断，不扫描环境。每次推断独占一个上下文
+//! （变量从 0 编号），多个模块可以在不同线程上同时推断。
+
+#![allow(clippy::type_complexity)]
+
+use crate::table::{Fields, Name, Ty, TyKind, TyTable, GENERIC};
+use crate::types::*;
+use kaubo_ast::*;
+use std::collections::{HashMap, HashSet};
+use std::sync::atomic::{AtomicUsize, Ordering};
+
+// struct / enum id 跨模块唯一（导入时复用源模块的 id）。知道模块路径时由
+// 路径和类型名散列得到（见 [`TypeIds::for_module`]），否则取全局计数器
+static STRUCT_COUNTER: AtomicUsize = AtomicUsize::new(0);
+static ENUM_COUNTER: AtomicUsize = AtomicUsize::new(0);
+
+pub fn fresh_struct_id() -> usize {
+    STRUCT_COUNTER.fetch_add(1, Ordering::Relaxed)
+}
+
+pub fn fresh_enum_id() -> usize {
+    ENUM_COUNTER.fetch_add(1, Ordering::Relaxed)
+}
+
+#[derive(Debug)]
+pub struct TypeError {
+    pub msg: String,
+    pub line: usize,
+    pub col: usize,
+}
+
+pub type InferResult<T> = Result<T, TypeError>;
+
+fn type_error(msg: impl Into<String>) -> TypeError {
+    TypeError {
+        msg: msg.into(),
+        line: 0,
+        col: 0,
+    }
+}
+
+/// Annotate a TypeError with a better source position.
+fn annotate_err(e: TypeError, span: &Span) -> TypeError {
+    if e.line == 0 {
+        TypeError {
+            line: span.line,
+            col: span.col,
+            msg: e.msg,
+        }
+    } else {
+        e
+    }
+}
+
+/// Extract the deepest span from an expression for error reporting.
+fn expr_span(expr: &Expr) -> Span {
+    match expr {
+        Expr::VarRef { span, .. } => *span,
+        Expr::Call { func, arg } => {
+            let a = expr_span(arg);
+            if a.line > 0 {
+                a
+            } else {
+                expr_span(func)
+            }
+        }
+        Expr::Member { object, .. } => expr_span(object),
+        Expr::Binary { left, right, .. } => {
+            let r = expr_span(right);
+            if r.line > 0 {
+                r
+            } else {
+                expr_span(left)
+            }
+        }
+        Expr::Unary { right, .. } => expr_span(right),
+        Expr::If { cond, .. } => expr_span(cond),
+        Expr::While { cond, .. } => expr_span(cond),
+        Expr::Return(val) => val
+            .as_ref()
+            .map(|e| expr_span(e.as_ref()))
+            .unwrap_or(Span::ZERO),
+        Expr::Assign { target, .. } => expr_span(target),
+        Expr::Tuple(items) => items
+            .iter()
+            .find_map(|i| {
+                let s = expr_span(i);
+                if s.line > 0 {
+                    Some(s)
+                } else {
+                    None
+                }
+            })
+            .unwrap_or(Span::ZERO),
+        _ => Span::ZERO,
+    }
+}
+
+// ── 主入口 ──
+
+pub fn infer_module(
+    module: &Module,
+) -> InferResult<(TypeEnv, HashMap<usize, Vec<(String, Type)>>)> {
+    infer_module_with_imports(module, None, &mut TypeIds::default()).map(|(env, sf, _)| (env, sf))
+}
+
+/// 带导入表的类型推断。`imports` 为 `None` 时行为与 `infer_module` 一致（向后兼容）；
+/// 模块里定义的 struct / enum 的 id 取自 `ids`。
+pub fn infer_module_with_imports(
+    module: &Module,
+    imports: Option<&[ImportSpec]>,
+    ids: &mut TypeIds,
+) -> InferResult<(
+    TypeEnv,
+    HashMap<usize, Vec<(String, Type)>>,
+    HashSet<String>,
+)> {
+    let mut cx = Infer::new();
+    let exports = cx.module(module, imports, ids)?;
+    Ok((cx.type_env(), cx.struct_field_types(), exports))
+}
+
+/// 增量推断跨次保留的 struct / enum id：名字第一次出现时分配，之后沿用，
+/// 没有重新推断的语句里的 Record / Variant 类型才对得上。
+#[derive(Debug, Clone, Default)]
+pub struct TypeIds {
+    structs: HashMap<String, usize>,
+    enums: HashMap<String, usize>,
+    /// 模块路径的散列；`Some` 时新名字的 id 由它和名字散列得到
+    scope: Option<u64>,
+}
+
+impl TypeIds {
+    /// 路径为 `path` 的模块的 id：同一路径、同一类型名在任何进程里都得到同一个 id，
+    /// 持久化缓存里的导出表才能和本进程新推断的模块放在一起统一。散列 id 的最高位
+    /// 为 1，不会和计数器分配的 id 相撞。
+    pub fn for_module(path: &str) -> Self {
+        TypeIds {
+            scope: Some(fnv1a(FNV_OFFSET, path.as_bytes())),
+            ..TypeIds::default()
+        }
+    }
+
+    fn struct_id(&mut self, name: &str) -> usize {
+        if let Some(&id) = self.structs.get(name) {
+            return id;
+        }
+        let id = self.scoped(b's', name).unwrap_or_else(fresh_struct_id);
+        self.structs.insert(name.to_string(), id);
+        id
+    }
+
+    fn enum_id(&mut self, name: &str) -> usize {
+        if let Some(&id) = self.enums.get(name) {
+            return id;
+        }
+        let id = self.scoped(b'e', name).unwrap_or_else(fresh_enum_id);
+        self.enums.insert(name.to_string(), id);
+        id
+    }
+
+    fn scoped(&self, kind: u8, name: &str) -> Option<usize> {
+        let h = fnv1a(fnv1a(self.scope?, &[kind]), name.as_bytes());
+        Some(h as usize | !(usize::MAX >> 1))
+    }
+}
+
+const FNV_OFFSET: u64 = 0xcbf2_9ce4_8422_2325;
+
+fn fnv1a(mut h: u64, bytes: &[u8]) -> u64 {
+    for &b in bytes {
+        h = (h ^ u64::from(b)).wrapping_mul(0x0100_0000_01b3);
+    }
+    h
+}
+
+/// [`infer_stmts`] 推断过的一条语句。
+#[derive(Debug, Clone)]
+pub struct StmtTypes {
+    /// 语句下标
+    pub index: usize,
+    /// 语句引入的绑定（名字见 [`stmt_bindings`]），是推断完所有语句之后的类型
+    pub bindings: Vec<(String, Scheme)>,
+    /// 语句刚推断完时绑定里还有自由变量：`bindings` 可能被后面的语句细化过，
+    /// 不能单独当缓存用
+    pub open: bool,
+}
+
+/// 增量推断：`cached[i]` 为 `None` 的顶层语句重新推断，为 `Some` 的直接取上次的
+/// 绑定——在语句原来的位置写进环境，遮蔽和前向引用都与整模块推断一致。
+/// struct / enum / interface 定义（[`declares_types`]）总是重新处理：Pass 1 要看到
+/// 全部类型，代价也小。
+///
+/// 缓存绑定里的类型变量视为已泛化，调用方要保证它们不是 [`StmtTypes::open`] 的；
+/// 没有语句用到的缓存可以传空切片。
+///
+/// 返回每条推断过的语句；出错时带上出错语句的下标。
+pub fn infer_stmts(
+    stmts: &[&Stmt],
+    cached: &[Option<&[(String, Scheme)]>],
+    ids: &mut TypeIds,
+) -> Result<Vec<StmtTypes>, (usize, TypeError)> {
+    let mut cx = Infer::new();
+    cx.declare_types(stmts.iter().copied(), ids)
+        .map_err(|e| (0, e))?;
+    cx.inject_prelude();
+
+    let mut exports = HashSet::new();
+    let mut bound = Vec::new();
+    for (i, stmt) in stmts.iter().enumerate() {
+        if let (Some(known), false) = (cached[i], declares_types(stmt)) {
+            let mut vars = HashMap::new();
+            for (name, scheme) in known {
+                let ty = cx.tys.lower(&scheme.body, GENERIC, &mut vars);
+                cx.env.insert(name.clone(), ty);
+            }
+            continue;
+        }
+        cx.stmt(stmt, &mut exports).map_err(|e| (i, e))?;
+        let tys: Vec<(String, Ty)> = stmt_bindings(stmt)
+            .into_iter()
+            .filter_map(|name| cx.env.get(&name).map(|&ty| (name, ty)))
+            .collect();
+        let open = tys.iter().any(|&(_, ty)| cx.tys.has_free_vars(ty));
+        bound.push((i, tys, open));
+    }
+    Ok(bound
+        .into_iter()
+        .map(|(index, tys, open)| StmtTypes {
+            index,
+            bindings: tys
+                .into_iter()
+                .map(|(name, ty)| (name, cx.scheme(ty)))
+                .collect(),
+            open,
+        })
+        .collect())
+}
+
+/// stdlib、内置接口和内置 impl 注入的绑定，与具体模块无关。
+pub fn prelude_env() -> TypeEnv {
+    let mut cx = Infer::new();
+    cx.inject_prelude();
+    cx.type_env()
+}
+
+/// 语句是否定义类型（struct / enum / interface，含导出的）。
+pub fn declares_types(stmt: &Stmt) -> bool {
+    let inner = match stmt {
+        Stmt::ExportStmt(inner) => inner.as_ref(),
+        other => other,
+    };
+    matches!(
+        inner,
+        Stmt::StructDef { .. } | Stmt::EnumDef { .. } | Stmt::InterfaceDef { .. }
+    )
+}
+
+/// 一条顶层语句推断后写进环境的名字；impl 方法是 `类型名.方法名`。
+pub fn stmt_bindings(stmt: &Stmt) -> Vec<String> {
+    match stmt {
+        Stmt::ConstDecl { name, .. } | Stmt::VarDecl { name, .. } => vec![name.clone()],
+        Stmt::InterfaceDef { name, .. } => vec![name.clone()],
+        Stmt::EnumDef { variants, .. } => variants.iter().map(|v| v.name.clone()).collect(),
+        Stmt::ImplBlock {
+            struct_name,
+            methods,
+            ..
+        } => methods
+            .iter()
+            .map(|m| format!("{struct_name}.{}", m.name))
+            .collect(),
+        Stmt::ExportStmt(inner) => match inner.as_ref() {
+            Stmt::StructDef { name, .. } => vec![name.clone()],
+            Stmt::ConstDecl { .. }
+            | Stmt::VarDecl { .. }
+            | Stmt::EnumDef { .. }
+            | Stmt::InterfaceDef { .. } => stmt_bindings(inner),
+            _ => Vec::new(),
+        },
+        Stmt::StructDef { .. } | Stmt::ExprStmt(_) | Stmt::Import { .. } => Vec::new(),
+    }
+}
+
+/// 接口方法签名：(方法名, 参数 (名字, 类型), 返回类型)。
+/// Self 和未注解的参数是 GENERIC 变量，每次使用时实例化。
+type IfaceSig = (String, Vec<(String, Ty)>, Option<Ty>);
+
+/// 一次模块推断的全部状态。
+struct Infer {
+    tys: TyTable,
+    /// 当前 let 嵌套深度，新变量取这一层
+    level: u32,
+    /// 名字 → 类型；含 GENERIC 变量的就是多态方案
+    env: HashMap<String, Ty>,
+    /// 作用域撤销日志：(名字, 被遮蔽的旧绑定)，离开作用域时倒序恢复
+    shadowed: Vec<(String, Option<Ty>)>,
+    structs: HashMap<String, usize>,
+    /// struct id → 名字，方法查找用
+    struct_names: HashMap<usize, String>,
+    struct_fields: HashMap<usize, Fields>,
+    enums: HashMap<String, usize>,
+    enum_variants: HashMap<usize, Vec<(Name, Fields)>>,
+    interfaces: HashMap<String, Vec<IfaceSig>>,
+}
+
+impl Infer {
+    fn new() -> Self {
+        Infer {
+            tys: TyTable::new(),
+            level: 0,
+            env: HashMap::new(),
+            shadowed: Vec::new(),
+            structs: HashMap::new(),
+            struct_names: HashMap::new(),
+            struct_fields: HashMap::new(),
+            enums: HashMap::new(),
+            enum_variants: HashMap::new(),
+            interfaces: HashMap::new(),
+        }
+    }
+
+    fn fresh(&mut self) -> Ty {
+        self.tys.fresh(self.level)
+    }
+
+    fn instantiate(&mut self, ty: Ty) -> Ty {
+        self.tys.instantiate(ty, self.level)
+    }
+
+    fn show(&mut self, ty: Ty) -> Type {
+        self.tys.export(ty)
+    }
+
+    fn unify(&mut self, a: Ty, b: Ty) -> Result<(), String> {
+        self.tys.unify(a, b, None)
+    }
+
+    /// Unify with interface registry for Struct↔Interface validation.
+    fn unify_checked(&mut self, a: Ty, b: Ty) -> Result<(), String> {
+        let interfaces = &self.interfaces;
+        self.tys.unify(a, b, Some(&|n| interfaces.contains_key(n)))
+    }
+
+    fn register_struct(&mut self, name: &str, id: usize) {
+        self.structs.insert(name.to_string(), id);
+        self.struct_names.insert(id, name.to_string());
+    }
+
+    // ── 作用域 ──
+
+    fn bind_local(&mut self, name: &str, ty: Ty) {
+        let old = self.env.insert(name.to_string(), ty);
+        self.shadowed.push((name.to_string(), old));
+    }
+
+    fn restore(&mut self, mark: usize) {
+        while self.shadowed.len() > mark {
+            let (name, old) = self.shadowed.pop().unwrap();
+            match old {
+                Some(ty) => self.env.insert(name, ty),
+                None => self.env.remove(&name),
+            };
+        }
+    }
+
+    /// 在内层推断 let 右侧，回到本层后把只属于内层的变量泛化
+    fn generalized(&mut self, value: &Expr) -> InferResult<Ty> {
+        self.level += 1;
+        let ty = self.infer(value);
+        self.level -= 1;
+        let ty = ty?;
+        self.tys.generalize(ty, self.level);
+        Ok(ty)
+    }
+
+    // ── 输出 ──
+
+    fn scheme(&mut self, ty: Ty) -> Scheme {
+        Scheme {
+            bound: self.tys.generic_vars(ty),
+            body: Box::new(self.tys.export(ty)),
+        }
+    }
+
+    fn type_env(&mut self) -> TypeEnv {
+        let env = std::mem::take(&mut self.env);
+        env.into_iter()
+            .map(|(name, ty)| (name, self.scheme(ty)))
+            .collect()
+    }
+
+    fn struct_field_types(&mut self) -> HashMap<usize, Vec<(String, Type)>> {
+        let fields = std::mem::take(&mut self.struct_fields);
+        fields
+            .into_iter()
+            .map(|(id, fs)| (id, self.tys.export_fields(fs)))
+            .collect()
+    }
+
+    // ── 模块 ──
+
+    fn module(
+        &mut self,
+        module: &Module,
+        imports: Option<&[ImportSpec]>,
+        ids: &mut TypeIds,
+    ) -> InferResult<HashSet<String>> {
+        let mut exports: HashSet<String> = HashSet::new();
+
+        // Pass 1: collect struct, enum, and interface definitions
+        self.declare_types(module.stmts.iter(), ids)?;
+
+        // Pass 2: inject stdlib builtins, builtin interfaces, and builtin impls
+        self.inject_prelude();
+
+        // Pass 2.5: inject imported symbols from other modules
+        if let Some(imports) = imports {
+            for spec in imports {
+                self.import(spec);
+            }
+        }
+
+        // Pass 3: infer all statements
+        for stmt in &module.stmts {
+            self.stmt(stmt, &mut exports)?;
+        }
+
+        Ok(exports)
+    }
+
+    /// Pass 1：登记全部 struct / enum / interface，id 取自 `ids`（没有的新分配）
+    fn declare_types<'s>(
+        &mut self,
+        stmts: impl Iterator<Item = &'s Stmt>,
+        ids: &mut TypeIds,
+    ) -> InferResult<()> {
+        for stmt in stmts {
+            // Unwrap ExportStmt to reach inner definitions
+            let inner = match stmt {
+                Stmt::ExportStmt(inner) => inner.as_ref(),
+                other => other,
+            };
+            if let Stmt::StructDef { name, fields, .. } = inner {
+                let id = ids.struct_id(name);
+                self.register_struct(name, id);
+                let fs = self.field_defs(fields)?;
+                self.struct_fields.insert(id, fs);
+            }
+            if let Stmt::EnumDef { name, variants, .. } = inner {
+                let id = ids.enum_id(name);
+                self.enums.insert(name.clone(), id);
+                let mut vts = Vec::with_capacity(variants.len());
+                for v in variants {
+                    let vname = self.tys.name(&v.name);
+                    vts.push((vname, self.field_defs(&v.fields)?));
+                }
+                self.enum_variants.insert(id, vts);
+            }
+            if let Stmt::InterfaceDef { name, methods, .. } = inner {
+                let mut sigs: Vec<IfaceSig> = Vec::with_capacity(methods.len());
+                for m in methods {
+                    let mut param_types = Vec::with_capacity(m.params.len());
+                    for p in &m.params {
+                        let pt = match &p.ty_ann {
+                            Some(ann @ TypeExpr::Named(s)) if s != "Self" => {
+                                self.type_expr_to_type(ann)?
+                            }
+                            // Self is a placeholder
+                            _ => self.tys.fresh(GENERIC),
+                        };
+                        param_types.push((p.name.clone(), pt));
+                    }
+                    let ret = m.return_type.as_ref().map(|t| match t {
+                        TypeExpr::Named(s) if s == "Self" => self.tys.fresh(GENERIC),
+                        _ => self.type_expr_to_type(t).unwrap_or(Ty::NULL),
+                    });
+                    sigs.push((m.name.clone(), param_types, ret));
+                }
+                self.interfaces.insert(name.clone(), sigs);
+            }
+        }
+        Ok(())
+    }
+
+    fn inject_prelude(&mut self) {
+        self.inject_stdlib();
+        self.inject_builtin_interfaces();
+        self.inject_builtin_impls();
+    }
+
+    /// Pass 3：推断一条顶层语句，导出的名字记进 `exports`
+    fn stmt(&mut self, stmt: &Stmt, exports: &mut HashSet<String>) -> InferResult<()> {
+        match stmt {
+            Stmt::ConstDecl {
+                name, value, span, ..
+            } => {
+                self.define_const(name, value, span)?;
+            }
+            Stmt::VarDecl {
+                name, value, span, ..
+            } => {
+                self.define_var(name, value.as_ref(), span)?;
+            }
+            Stmt::StructDef { name, fields, .. } => {
+                self.struct_def(name, fields)?;
+            }
+            Stmt::EnumDef { name, variants, .. } => {
+                // Payload variant constructors are curried: field → … → Variant
+                self.enum_ctors(name, variants, true);
+            }
+            Stmt::ImplBlock {
+                struct_name,
+                interface_name,
+                methods,
+                ..
+            } => {
+                self.impl_block(struct_name, interface_name.as_deref(), methods)?;
+            }
+            Stmt::ExprStmt(expr) => {
+                let span = expr_span(expr);
+                self.infer(expr).map_err(|e| annotate_err(e, &span))?;
+            }
+            Stmt::InterfaceDef { name, .. } => {
+                // Register interface name as a type-level entity (no runtime value)
+                self.env.insert(name.clone(), Ty::NULL);
+            }
+            Stmt::ExportStmt(inner) => {
+                // 推断内部声明，并记录导出
+                match inner.as_ref() {
+                    Stmt::ConstDecl {
+                        name, value, span, ..
+                    } => {
+                        self.define_const(name, value, span)?;
+                        exports.insert(name.clone());
+                    }
+                    Stmt::StructDef { name, fields, .. } => {
+                        let record = self.struct_def(name, fields)?;
+                        self.env.insert(name.clone(), record);
+                        exports.insert(name.clone());
+                    }
+                    Stmt::EnumDef { name, variants, .. } => {
+                        // 导出的构造器收一个参数（多字段时为元组）
+                        self.enum_ctors(name, variants, false);
+                        exports.insert(name.clone());
+                    }
+                    Stmt::InterfaceDef { name, .. } => {
+                        self.env.insert(name.clone(), Ty::NULL);
+                        exports.insert(name.clone());
+                    }
+                    Stmt::VarDecl {
+                        name, value, span, ..
+                    } => {
+                        self.define_var(name, value.as_ref(), span)?;
+                        exports.insert(name.clone());
+                    }
+                    _ => {
+                        // 不支持的导出语句类型，静默忽略（未来可报错）
+                    }
+                }
+            }
+            Stmt::Import { .. } => {}
+        }
+        Ok(())
+    }
+
+    fn define_const(&mut self, name: &str, value: &Expr, span: &Span) -> InferResult<()> {
+        let ty = self.generalized(value).map_err(|e| annotate_err(e, span))?;
+        self.env.insert(name.to_string(), ty);
+        Ok(())
+    }
+
+    fn define_var(&mut self, name: &str, value: Option<&Expr>, span: &Span) -> InferResult<()> {
+        let ty = match value {
+            Some(val) => self.infer(val).map_err(|e| annotate_err(e, span))?,
+            None => self.fresh(),
+        };
+        self.env.insert(name.to_string(), ty);
+        Ok(())
+    }
+
+    fn field_defs(&mut self, fields: &[FieldDef]) -> InferResult<Fields> {
+        let mut fts = Vec::with_capacity(fields.len());
+        for f in fields {
+            let name = self.tys.name(&f.name);
+            fts.push((name, self.type_expr_to_type(&f.ty)?));
+        }
+        Ok(self.tys.fields_of(&fts))
+    }
+
+    /// 所有 struct 都已登记后重新解析字段类型，返回该 struct 的 record 类型
+    fn struct_def(&mut self, name: &str, fields: &[FieldDef]) -> InferResult<Ty> {
+        let id = self.structs[name];
+        let fs = self.field_defs(fields)?;
+        self.struct_fields.insert(id, fs);
+        Ok(self.tys.mk(TyKind::Record(id, fs)))
+    }
+
+    /// Register each variant constructor in the environment
+    fn enum_ctors(&mut self, name: &str, variants: &[VariantDef], curried: bool) {
+        let id = self.enums[name];
+        for (tag, v) in variants.iter().enumerate() {
+            let vname = self.tys.name(&v.name);
+            let fs = self
+                .enum_variants
+                .get(&id)
+                .and_then(|vs| vs.get(tag))
+                .map_or(Fields::EMPTY, |&(_, fs)| fs);
+            let result_ty = self.tys.mk(TyKind::Variant(id, vname, fs));
+            let field_tys: Vec<Ty> = self.tys.field_list(fs).iter().map(|&(_, t)| t).collect();
+            let ctor = if v.fields.is_empty() {
+                // Unit variant: just the variant type
+                result_ty
+            } else if curried {
+                field_tys
+                    .iter()
+                    .rev()
+                    .fold(result_ty, |ret, &ft| self.tys.arrow(ft, ret))
+            } else {
+                let param = match field_tys.len() {
+                    1 => field_tys[0],
+                    _ => self.tys.tuple(&field_tys),
+                };
+                self.tys.arrow(param, result_ty)
+            };
+            self.env.insert(v.name.clone(), ctor);
+        }
+    }
+
+    fn impl_block(
+        &mut self,
+        struct_name: &str,
+        interface_name: Option<&str>,
+        methods: &[MethodDef],
+    ) -> InferResult<()> {
+        // Check interface completeness if implementing a trait
+        let required = interface_name.and_then(|i| self.interfaces.get(i)).cloned();
+        if let (Some(iface_name), Some(required)) = (interface_name, &required) {
+            let implemented: HashSet<&str> = methods.iter().map(|m| m.name.as_str()).collect();
+            for (mname, _, _) in required {
+                if !implemented.contains(mname.as_str()) {
+                    return Err(type_error(format!(
+                        "impl '{iface_name}' for '{struct_name}' missing method '{mname}'"
+                    )));
+                }
+            }
+        }
+        // Register methods on struct — with interface signature checking
+        for m in methods {
+            self.level += 1;
+            let inferred = self.infer(&m.body);
+            let checked = inferred.and_then(|inferred| {
+                // If implementing an interface, check method type against declared signature
+                let Some(required) = &required else {
+                    return Ok(inferred);
+                };
+                let Some((_, param_types, ret_ty)) =
+                    required.iter().find(|(mn, _, _)| mn == &m.name)
+                else {
+                    return Ok(inferred);
+                };
+                // Build expected type: params → ret
+                let tys: Vec<Ty> = param_types.iter().map(|&(_, t)| t).collect();
+                let param_ty = self.param_type(&tys);
+                let expected = self.tys.arrow(param_ty, ret_ty.unwrap_or(Ty::NULL));
+                let expected = self.instantiate(expected);
+                // Unify inferred method type with expected signature
+                self.unify(inferred, expected).map_err(|e| {
+                    type_error(format!(
+                        "method '{}' of impl '{}' for '{struct_name}': {e}",
+                        m.name,
+                        interface_name.unwrap_or_default()
+                    ))
+                })?;
+                Ok(inferred)
+            });
+            self.level -= 1;
+            let ty = checked?;
+            self.tys.generalize(ty, self.level);
+            self.env.insert(format!("{}.{}", struct_name, m.name), ty);
+        }
+        Ok(())
+    }
+
+    fn import(&mut self, spec: &ImportSpec) {
+        // 导入类型里的变量在本模块视为已泛化
+        let mut vars = HashMap::new();
+        match &spec.kind {
+            ImportKind::Const { ty } | ImportKind::Function { ty } => {
+                let ty = self.tys.lower(ty, GENERIC, &mut vars);
+                self.env.insert(spec.local_name.clone(), ty);
+            }
+            ImportKind::Struct {
+                struct_id: src_id,
+                fields,
+            } => {
+                // ★ 使用源模块原始 struct_id，不重新分配
+                self.register_struct(&spec.local_name, *src_id);
+                let fs = self.tys.lower_fields(fields, GENERIC, &mut vars);
+                self.struct_fields.insert(*src_id, fs);
+                let record = self.tys.mk(TyKind::Record(*src_id, fs));
+                self.env.insert(spec.local_name.clone(), record);
+            }
+            ImportKind::Interface { methods } => {
+                let sigs = methods
+                    .iter()
+                    .map(|(name, params, ret)| {
+                        let params = params
+                            .iter()
+                            .map(|(p, t)| (p.clone(), self.tys.lower(t, GENERIC, &mut vars)))
+                            .collect();
+                        let ret = ret.as_ref().map(|t| self.tys.lower(t, GENERIC, &mut vars));
+                        (name.clone(), params, ret)
+                    })
+                    .collect();
+                self.interfaces.insert(spec.local_name.clone(), sigs);
+                self.env.insert(spec.local_name.clone(), Ty::NULL);
+            }
+        }
+    }
+}
+
+// ── stdlib injection ──
+
+impl Infer {
+    fn inject_stdlib(&mut self) {
+        let t = &mut self.tys;
+        // print: String → Null
+        let print = t.arrow(Ty::STRING, Ty::NULL);
+        self.env.insert("print".into(), print);
+        // type_of: forall a. a → Int64
+        let a = t.fresh(GENERIC);
+        let type_of = t.arrow(a, Ty::INT64);
+        self.env.insert("type_of".into(), type_of);
+        // assert: Bool → Null
+        let assert = t.arrow(Ty::BOOL, Ty::NULL);
+        self.env.insert("assert".into(), assert);
+        // sqrt/sin/cos: Float64 → Float64
+        let math = t.arrow(Ty::FLOAT64, Ty::FLOAT64);
+        for name in ["sqrt", "sin", "cos", "floor", "ceil"] {
+            self.env.insert(name.into(), math);
+        }
+        self.inject_array_kernels();
+    }
+
+    /// 类型化数组内核（kaubo-vm `kernels`）：实参直接是寄存器里的数组句柄和标量，
+    /// 降为 `CallNative` 时不装箱。元素类型 a 只能是 Int64 / Float64，由运行时检查。
+    fn inject_array_kernels(&mut self) {
+        let t = &mut self.tys;
+        let arrow = |t: &mut TyTable, params: &[Ty], ret: Ty| {
+            let param = match params {
+                [p] => *p,
+                ps => t.tuple(ps),
+            };
+            t.arrow(param, ret)
+        };
+        let mut kernels: Vec<(&str, Ty)> = Vec::new();
+
+        // int_array: (Int64, Int64) → List<Int64>; float_array: (Int64, Float64) → List<Float64>
+        for (name, elem) in [("int_array", Ty::INT64), ("float_array", Ty::FLOAT64)] {
+            let list = t.list(elem);
+            kernels.push((name, arrow(t, &[Ty::INT64, elem], list)));
+        }
+        // 以下均为 forall a.，a 为 GENERIC 变量
+        let a = t.fresh(GENERIC);
+        let list_a = t.list(a);
+        let list_int = t.list(Ty::INT64);
+        // sum/min/max: List<a> → a
+        for name in ["sum", "min", "max"] {
+            kernels.push((name, arrow(t, &[list_a], a)));
+        }
+        // dot: (List<a>, List<a>) → a
+        kernels.push(("dot", arrow(t, &[list_a, list_a], a)));
+        // axpy: (a, List<a>, List<a>) → Null（原地更新第三个实参）
+        kernels.push(("axpy", arrow(t, &[a, list_a, list_a], Ty::NULL)));
+        // fill: (List<a>, a) → Null
+        kernels.push(("fill", arrow(t, &[list_a, a], Ty::NULL)));
+        // prefix_sum: List<a> → List<a>
+        kernels.push(("prefix_sum", arrow(t, &[list_a], list_a)));
+        // array_add/sub/mul: (List<a>, List<a>) → List<a>
+        for name in ["array_add", "array_sub", "array_mul"] {
+            kernels.push((name, arrow(t, &[list_a, list_a], list_a)));
+        }
+        // array_lt/gt/eq: (List<a>, List<a>) → List<Int64>（0 / 1 掩码）
+        for name in ["array_lt", "array_gt", "array_eq"] {
+            kernels.push((name, arrow(t, &[list_a, list_a], list_int)));
+        }
+        for (name, ty) in kernels {
+            self.env.insert(name.into(), ty);
+        }
+    }
+
+    /// Inject built-in interface definitions (Add, Subtract, Multiply, Divide, Modulo,
+    /// Compare, Display, IntoFloat, IntoInt). Self 是 GENERIC 变量，用户同名接口优先。
+    fn inject_builtin_interfaces(&mut self) {
+        // interface Add { operator add: |self, other: Self| -> Self; }
+        // Subtract / Multiply / Divide / Modulo 同形
+        for (iface, method) in [
+            ("Add", "add"),
+            ("Subtract", "subtract"),
+            ("Multiply", "multiply"),
+            ("Divide", "divide"),
+            ("Modulo", "modulo"),
+        ] {
+            let sv = self.tys.fresh(GENERIC);
+            self.interfaces.entry(iface.into()).or_insert_with(|| {
+                vec![(
+                    method.into(),
+                    vec![("self".into(), sv), ("other".into(), sv)],
+                    Some(sv),
+                )]
+            });
+        }
+        // interface Compare {
+        //     operator less: |self, other: Self| -> Bool;
+        //     operator less_equal: |self, other: Self| -> Bool;
+        //     operator greater: |self, other: Self| -> Bool;
+        //     operator greater_equal: |self, other: Self| -> Bool;
+        //     operator equal: |self, other: Self| -> Bool;
+        //     operator not_equal: |self, other: Self| -> Bool;
+        // }
+        let sv = self.tys.fresh(GENERIC);
+        self.interfaces.entry("Compare".into()).or_insert_with(|| {
+            let cmp = |name: &str| {
+                (
+                    name.to_string(),
+                    vec![("self".into(), sv), ("other".into(), sv)],
+                    Some(Ty::BOOL),
+                )
+            };
+            vec![
+                cmp("less"),
+                cmp("less_equal"),
+                cmp("greater"),
+                cmp("greater_equal"),
+                cmp("equal"),
+                ("not_equal".into(), vec![], Some(Ty::BOOL)),
+            ]
+        });
+        // interface Display { to_string: |self| -> String; }
+        // interface IntoFloat { to_float: |self| -> Float64; }
+        // interface IntoInt { to_int: |self| -> Int64; }
+        for (iface, method, ret) in [
+            ("Display", "to_string", Ty::STRING),
+            ("IntoFloat", "to_float", Ty::FLOAT64),
+            ("IntoInt", "to_int", Ty::INT64),
+        ] {
+            let sv = self.tys.fresh(GENERIC);
+            self.interfaces
+                .entry(iface.into())
+                .or_insert_with(|| vec![(method.into(), vec![("self".into(), sv)], Some(ret))]);
+        }
+    }
+
+    /// Inject built-in impl blocks for Int64, Float64, String, Bool.
+    /// These method signatures go into the type environment so `x.to_string()` and
+    /// `x.add(y)` type-check.  CPS build recognizes builtin method names and rewrites
+    /// them to the corresponding CPS instructions — the impl bodies are never executed.
+    fn inject_builtin_impls(&mut self) {
+        // Register builtin types as "struct-like" so method lookup works
+        for (name, id) in [
+            ("Int64", usize::MAX),
+            ("Float64", usize::MAX - 1),
+            ("String", usize::MAX - 2),
+            ("Bool", usize::MAX - 3),
+        ] {
+            self.register_struct(name, id);
+            self.struct_fields.insert(id, Fields::EMPTY);
+        }
+
+        // Register a monomorphic method in env as "{struct}.{method}".
+        // For methods with one extra arg (operator methods), the type is curried:
+        //   self_type → (other_type → return_type)
+        // For zero-arg methods (to_string, to_float, etc.), it's just:
+        //   self_type → return_type
+        // Member handler strips the first Arrow (self), leaving either `ret` or `other → ret`.
+        const ARITH: &[&str] = &["add", "subtract", "multiply", "divide", "modulo"];
+        const CMP: &[&str] = &[
+            "less",
+            "less_equal",
+            "greater",
+            "greater_equal",
+            "equal",
+            "not_equal",
+        ];
+        let builtins: [(&str, Ty, &[&str], &[&str], &[(&str, Ty)]); 4] = [
+            (
+                "Int64",
+                Ty::INT64,
+                ARITH,
+                CMP,
+                &[("to_string", Ty::STRING), ("to_float", Ty::FLOAT64)],
+            ),
+            (
+                "Float64",
+                Ty::FLOAT64,
+                &ARITH[..4],
+                CMP,
+                &[("to_string", Ty::STRING), ("to_int", Ty::INT64)],
+            ),
+            (
+                "String",
+                Ty::STRING,
+                &ARITH[..1],
+                CMP,
+                &[("to_string", Ty::STRING), ("to_int", Ty::INT64)],
+            ),
+            (
+                "Bool",
+                Ty::BOOL,
+                &[],
+                &CMP[4..],
+                &[("to_string", Ty::STRING)],
+            ),
+        ];
+        for (struct_name, self_ty, arith, cmp, unary) in builtins {
+            let t = &mut self.tys;
+            let mut methods: Vec<(&str, Ty)> = Vec::new();
+            // operator methods: self + other → return
+            let same = t.arrow(self_ty, self_ty);
+            let same = t.arrow(self_ty, same);
+            let test = t.arrow(self_ty, Ty::BOOL);
+            let test = t.arrow(self_ty, test);
+            methods.extend(arith.iter().map(|&m| (m, same)));
+            methods.extend(cmp.iter().map(|&m| (m, test)));
+            // zero-arg methods: no other type
+            for &(m, ret) in unary {
+                methods.push((m, t.arrow(self_ty, ret)));
+            }
+            for (m, ty) in methods {
+                self.env.insert(format!("{struct_name}.{m}"), ty);
+            }
+        }
+
+        // Register builtin interface impls in interface_registry so completeness checks pass
+        for (iface_name, builtin_types) in &[
+            ("Add", &["Int64", "Float64", "String"][..]),
+            ("Subtract", &["Int64", "Float64"][..]),
+            ("Multiply", &["Int64", "Float64"][..]),
+            ("Divide", &["Int64", "Float64"][..]),
+            ("Modulo", &["Int64"][..]),
+            ("Compare", &["Int64", "Float64", "String", "Bool"][..]),
+            ("Display", &["Int64", "Float64", "String", "Bool"][..]),
+            ("IntoFloat", &["Int64", "String"][..]),
+            ("IntoInt", &["String", "Float64"][..]),
+        ] {
+            for bt in *builtin_types {
+                let key = format!("{bt}::{iface_name}");
+                self.interfaces.entry(key).or_default();
+            }
+        }
+    }
+}
+
+/// Map a BinOp to the corresponding operator method name.
+fn binop_to_method(op: &BinOp) -> &'static str {
+    match op {
+        BinOp::Add => "add",
+        BinOp::Sub => "subtract",
+        BinOp::Mul => "multiply",
+        BinOp::Div => "divide",
+        BinOp::Mod => "modulo",
+        BinOp::Eq => "equal",
+        BinOp::Ne => "not_equal",
+        BinOp::Lt => "less",
+        BinOp::Le => "less_equal",
+        BinOp::Gt => "greater",
+        BinOp::Ge => "greater_equal",
+        BinOp::SAdd => "add", // String concatenation uses the same Add interface
+        _ => "add",
+    }
+}
+
+// ── 推断 ──
+
+impl Infer {
+    /// Get the struct name for a (resolved) type, for method lookup.
+    fn type_name(&self, ty: Ty) -> Option<String> {
+        match self.tys.kind(ty) {
+            TyKind::Int64 => Some("Int64".into()),
+            TyKind::Float64 => Some("Float64".into()),
+            TyKind::String => Some("String".into()),
+            TyKind::Bool => Some("Bool".into()),
+            TyKind::List(_) => Some("List".into()),
+            TyKind::Record(id, _) => self.struct_names.get(&id).cloned(),
+            TyKind::Variant(_, name, _) => Some(self.tys.name_str(name).to_string()),
+            _ => None,
+        }
+    }
+
+    /// 构建参数类型：单参数不包裹（边界条件 1）
+    fn param_type(&mut self, params: &[Ty]) -> Ty {
+        match params {
+            [p] => *p,
+            ps => self.tys.tuple(ps),
+        }
+    }
+
+    fn is_unit(&mut self, ty: Ty) -> bool {
+        let ty = self.tys.resolve(ty);
+        matches!(self.tys.kind(ty), TyKind::Tuple(ts) if self.tys.tys(ts).is_empty())
+    }
+
+    fn infer(&mut self, expr: &Expr) -> InferResult<Ty> {
+        match expr {
+            Expr::LitInt(_) => Ok(Ty::INT64),
+            Expr::LitFloat(_) => Ok(Ty::FLOAT64),
+            Expr::LitString(_) => Ok(Ty::STRING),
+            Expr::LitTrue | Expr::LitFalse => Ok(Ty::BOOL),
+            Expr::LitNull => Ok(Ty::NULL),
+
+            Expr::VarRef { name, .. } => {
+                let scheme = *self
+                    .env
+                    .get(name)
+                    .ok_or_else(|| type_error(format!("unbound variable '{name}'")))?;
+                Ok(self.instantiate(scheme))
+            }
+
+            Expr::Lambda { params, body, .. } => {
+                let mark = self.shadowed.len();
+                let mut param_types = Vec::with_capacity(params.len());
+                for p in params {
+                    let pt = match &p.ty_ann {
+                        Some(ann) => self.type_expr_to_type(ann)?,
+                        None => self.fresh(),
+                    };
+                    param_types.push(pt);
+                    self.bind_local(&p.name, pt);
+                }
+                let body_ty = self.infer(body)?;
+                self.restore(mark);
+                let param_ty = self.param_type(&param_types);
+                Ok(self.tys.arrow(param_ty, body_ty))
+            }
+
+            Expr::Call { func, arg } => {
+                let func_ty = self.infer(func)?;
+                let arg_ty = self.infer(arg)?;
+                let func_ty = self.tys.resolve(func_ty);
+                // func_ty 若不是 Arrow（如零参 method call 直接返回结果类型），跳过参数匹配
+                if let TyKind::Arrow(param_ty, body_ty) = self.tys.kind(func_ty) {
+                    // 整体统一：param_ty（Int64 或 (Int64, Int64) 或 (））与 arg_ty 匹配
+                    self.unify_checked(param_ty, arg_ty).map_err(type_error)?;
+                    Ok(body_ty)
+                } else if self.is_unit(arg_ty) {
+                    // 方法调用等已消解场景：func_ty 为结果类型，arg 必须为空元组
+                    Ok(func_ty)
+                } else {
+                    let shown = self.show(func_ty);
+                    Err(type_error(format!("cannot call non-function type {shown}")))
+                }
+            }
+
+            Expr::Binary { left, op, right } => {
+                let t1 = self.infer(left)?;
+                let t2 = self.infer(right)?;
+                match op {
+                    BinOp::Add | BinOp::Sub | BinOp::Mul | BinOp::Div | BinOp::Mod => {
+                        self.unify(t1, t2)
+                            .map_err(|e| type_error(format!("binary operator: {e}")))?;
+                        let unified = self.tys.resolve(t1);
+                        // Try builtin numeric types first
+                        if self
+                            .unify(unified, Ty::INT64)
+                            .or_else(|_| self.unify(unified, Ty::FLOAT64))
+                            .is_ok()
+                        {
+                            return Ok(unified);
+                        }
+                        // Fallback: operator dispatch for user types
+                        let method = self
+                            .type_name(unified)
+                            .map(|tn| format!("{tn}.{}", binop_to_method(op)))
+                            .and_then(|m| self.env.get(&m).copied());
+                        let Some(scheme) = method else {
+                            let shown = self.show(unified);
+                            return Err(type_error(format!(
+                                "arithmetic requires numeric types, got {shown}"
+                            )));
+                        };
+                        // Operator methods are curried: self → (other → return)
+                        // Strip both arrows to get the return type
+                        let method_ty = self.instantiate(scheme);
+                        let mut ret = method_ty;
+                        for _ in 0..2 {
+                            match self.tys.kind(ret) {
+                                TyKind::Arrow(_, body) => ret = self.tys.resolve(body),
+                                _ => break,
+                            }
+                        }
+                        Ok(ret)
+                    }
+                    BinOp::Eq | BinOp::Ne | BinOp::Lt | BinOp::Le | BinOp::Gt | BinOp::Ge => {
+                        // Unify operand types for comparison (unless one side is Null)
+                        let a1 = self.tys.resolve(t1);
+                        let a2 = self.tys.resolve(t2);
+                        if a1 != Ty::NULL && a2 != Ty::NULL {
+                            self.unify(a1, a2).map_err(|e| {
+                                type_error(format!("comparison operands must have same type: {e}"))
+                            })?;
+                        }
+                        Ok(Ty::BOOL)
+                    }
+                    BinOp::And | BinOp::Or => Ok(Ty::BOOL),
+                    BinOp::Pipe => {
+                        // a |> f : if f has type T -> U, unify T with type of a, result is U
+                        let ret = self.fresh();
+                        let f_ty = self.tys.arrow(t1, ret);
+                        self.unify(t2, f_ty)
+                            .map_err(|e| type_error(format!("pipe operator: {e}")))?;
+                        Ok(ret)
+                    }
+                    BinOp::GtGt => {
+                        Ok(t1) // TODO: proper function composition typing
+                    }
+                    BinOp::SAdd => Ok(Ty::STRING),
+                }
+            }
+
+            Expr::Unary { op, right } => {
+                let t = self.infer(right)?;
+                match op {
+                    UnOp::Neg => {
+                        let applied = self.tys.resolve(t);
+                        if self
+                            .unify(applied, Ty::INT64)
+                            .or_else(|_| self.unify(applied, Ty::FLOAT64))
+                            .is_err()
+                        {
+                            let shown = self.show(applied);
+                            return Err(type_error(format!(
+                                "negation requires numeric type, got {shown}"
+                            )));
+                        }
+                        Ok(applied)
+                    }
+                    UnOp::Not => Ok(Ty::BOOL),
+                }
+            }
+
+            Expr::Block(stmts) => {
+                let mark = self.shadowed.len();
+                let mut result = Ty::NULL;
+                for stmt in stmts {
+                    match stmt {
+                        Stmt::ConstDecl { name, value, .. } => {
+                            let ty = self.generalized(value)?;
+                            self.bind_local(name, ty);
+                            result = Ty::NULL;
+                        }
+                        Stmt::VarDecl { name, value, .. } => {
+                            let ty = match value {
+                                Some(val) => self.infer(val)?,
+                                None => self.fresh(),
+                            };
+                            self.bind_local(name, ty);
+                            result = Ty::NULL;
+                        }
+                        Stmt::ExprStmt(expr) => {
+                            let span = expr_span(expr);
+                            result = self.infer(expr).map_err(|e| annotate_err(e, &span))?;
+                        }
+                        _ => {}
+                    }
+                }
+                self.restore(mark);
+                Ok(result)
+            }
+
+            Expr::If {
+                cond,
+                then_branch,
+                else_branch,
+            } => {
+                self.infer(cond)?;
+                let tt = self.infer(then_branch)?;
+                if let Some(eb) = else_branch {
+                    let te = self.infer(eb)?;
+                    self.unify(tt, te)
+                        .map_err(|e| type_error(format!("if branches: {e}")))?;
+                }
+                Ok(tt)
+            }
+
+            Expr::While { cond, body } => {
+                self.infer(cond)?;
+                self.infer(body)?;
+                Ok(Ty::NULL)
+            }
+
+            Expr::For {
+                var,
+                iterable,
+                body,
+            } => {
+                let ti = self.infer(iterable)?;
+                let applied = self.tys.resolve(ti);
+                // ti should be List<'a>; if it's a type var, unify it with List<?>
+                let elem = match self.tys.kind(applied) {
+                    TyKind::List(elem) => elem,
+                    TyKind::Var(_) => {
+                        let elem = self.fresh();
+                        let list_ty = self.tys.list(elem);
+                        self.unify(applied, list_ty)
+                            .map_err(|e| type_error(format!("for loop: {e}")))?;
+                        elem
+                    }
+                    _ => {
+                        let shown = self.show(applied);
+                        return Err(type_error(format!("for loop requires List, got {shown}")));
+                    }
+                };
+                let mark = self.shadowed.len();
+                self.bind_local(&var.name, elem);
+                self.infer(body)?;
+                self.restore(mark);
+                Ok(Ty::NULL)
+            }
+
+            Expr::Break | Expr::Continue => Ok(Ty::NULL),
+            Expr::Return(val) => match val {
+                Some(expr) => self.infer(expr),
+                None => Ok(Ty::NULL),
+            },
+
+            Expr::Member { object, field } => {
+                let ty = self.infer(object)?;
+                let applied = self.tys.resolve(ty);
+
+                // Handle Interface type: look up method in interface definition
+                if let TyKind::Interface(iface) = self.tys.kind(applied) {
+                    let iface_name = self.tys.name_str(iface).to_string();
+                    let ret = self
+                        .interfaces
+                        .get(&iface_name)
+                        .and_then(|ms| ms.iter().find(|(mname, _, _)| mname == field))
+                        .map(|(_, _, ret)| ret.unwrap_or(Ty::NULL));
+                    return match ret {
+                        Some(ret) => Ok(self.instantiate(ret)),
+                        None => Err(type_error(format!(
+                            "method '{field}' not found on interface {iface_name}"
+                        ))),
+                    };
+                }
+
+                // Try method lookup: "{struct_name}.{field}" in env
+                let method = self
+                    .type_name(applied)
+                    .and_then(|sn| self.env.get(&format!("{sn}.{field}")).copied());
+                if let Some(scheme) = method {
+                    let method_ty = self.instantiate(scheme);
+                    let method_ty = self.tys.resolve(method_ty);
+                    // 剥离 self 参数：从 param tuple 中移除第一个元素
+                    let TyKind::Arrow(param_ty, body_ty) = self.tys.kind(method_ty) else {
+                        return Ok(method_ty);
+                    };
+                    let param_ty = self.tys.resolve(param_ty);
+                    let rest = match self.tys.kind(param_ty) {
+                        TyKind::Tuple(ts) => self.tys.tys(ts),
+                        _ => return Ok(body_ty), // single self param, no remaining args
+                    };
+                    return Ok(match &rest[..] {
+                        [] | [_] => body_ty,
+                        [_, other] => self.tys.arrow(*other, body_ty),
+                        [_, others @ ..] => {
+                            let others = self.tys.tuple(others);
+                            self.tys.arrow(others, body_ty)
+                        }
+                    });
+                }
+
+                // Try struct field access (Record only)
+                if let TyKind::Record(_, fs) = self.tys.kind(applied) {
+                    if let Some(name) = self.tys.find_name(field) {
+                        if let Some(&(_, t)) =
+                            self.tys.field_list(fs).iter().find(|(n, _)| *n == name)
+                        {
+                            return Ok(t);
+                        }
+                    }
+                }
+
+                let shown = self.show(applied);
+                Err(type_error(format!(
+                    "field or method '{field}' not found on {shown}"
+                )))
+            }
+
+            Expr::Index { object, index } => {
+                let t_obj = self.infer(object)?;
+                self.infer(index)?;
+                let applied = self.tys.resolve(t_obj);
+                match self.tys.kind(applied) {
+                    TyKind::List(elem) => Ok(elem),
+                    TyKind::String => Ok(Ty::STRING),
+                    TyKind::Tuple(ts) => {
+                        // Tuple access: mid[0], mid[1], etc. — index must be a literal int
+                        let Expr::LitInt(idx_val) = index.as_ref() else {
+                            return Err(type_error("tuple index must be a literal integer"));
+                        };
+                        let elements = self.tys.tys(ts);
+                        if *idx_val < 0 || *idx_val as usize >= elements.len() {
+                            return Err(type_error(format!(
+                                "tuple index {idx_val} out of bounds (0..{})",
+                                elements.len()
+                            )));
+                        }
+                        Ok(elements[*idx_val as usize])
+                    }
+                    _ => {
+                        let shown = self.show(applied);
+                        Err(type_error(format!("cannot index into type {shown}")))
+                    }
+                }
+            }
+
+            Expr::StructLit { name, fields, .. } => {
+                let id = *self
+                    .structs
+                    .get(name)
+                    .ok_or_else(|| type_error(format!("unknown struct '{name}'")))?;
+                let field_types = self
+                    .struct_fields
+                    .get(&id)
+                    .copied()
+                    .unwrap_or(Fields::EMPTY);
+                let declared_fields = self.tys.field_list(field_types);
+                for (fname, fval) in fields {
+                    let t_val = self.infer(fval)?;
+                    // Unify field value type with declared field type
+                    let declared = self
+                        .tys
+                        .find_name(fname)
+                        .and_then(|n| declared_fields.iter().find(|(f, _)| *f == n));
+                    if let Some(&(_, declared)) = declared {
+                        self.unify(t_val, declared)
+                            .map_err(|e| type_error(format!("field '{fname}': {e}")))?;
+                    }
+                }
+                Ok(self.tys.mk(TyKind::Record(id, field_types)))
+            }
+
+            Expr::VariantLit {
+                enum_name,
+                variant_name,
+                fields,
+                ..
+            } => {
+                let id = *self
+                    .enums
+                    .get(enum_name)
+                    .ok_or_else(|| type_error(format!("unknown enum '{enum_name}'")))?;
+                let vname = self.tys.find_name(variant_name);
+                let variant_fields = self
+                    .enum_variants
+                    .get(&id)
+                    .and_then(|vs| vs.iter().find(|(n, _)| Some(*n) == vname))
+                    .map(|&(_, fs)| fs)
+                    .ok_or_else(|| type_error(format!("unknown variant '{variant_name}'")))?;
+                let declared_fields = self.tys.field_list(variant_fields);
+                for (i, fval) in fields.iter().enumerate() {
+                    let t_val = self.infer(fval)?;
+                    // Unify with declared variant field type
+                    if let Some(&(_, declared)) = declared_fields.get(i) {
+                        self.unify_checked(t_val, declared)
+                            .map_err(|e| type_error(format!("variant field: {e}")))?;
+                    }
+                }
+                let vname = self.tys.name(variant_name);
+                Ok(self.tys.mk(TyKind::Variant(id, vname, variant_fields)))
+            }
+
+            Expr::GetVariantTag(inner) => {
+                let ty = self.infer(inner)?;
+                let applied = self.tys.resolve(ty);
+                // Verify inner is a variant type
+                if !matches!(self.tys.kind(applied), TyKind::Variant(..)) {
+                    let shown = self.show(applied);
+                    return Err(type_error(format!(
+                        "GetVariantTag expected variant type, got {shown}"
+                    )));
+                }
+                Ok(Ty::INT64)
+            }
+
+            Expr::GetVariantField { object, field_idx } => {
+                let ty = self.infer(object)?;
+                let applied = self.tys.resolve(ty);
+                match self.tys.kind(applied) {
+                    TyKind::Variant(_, _, fs) => {
+                        match self.tys.field_list(fs).get(*field_idx as usize) {
+                            Some(&(_, t)) => Ok(t),
+                            None => Ok(self.fresh()),
+                        }
+                    }
+                    _ => {
+                        let shown = self.show(applied);
+                        Err(type_error(format!(
+                            "GetVariantField expected variant type, got {shown}"
+                        )))
+                    }
+                }
+            }
+
+            Expr::ListLit(items) => {
+                let elem_ty = self.fresh();
+                for item in items {
+                    let ti = self.infer(item)?;
+                    self.unify(elem_ty, ti)
+                        .map_err(|e| type_error(format!("list element: {e}")))?;
+                }
+                Ok(self.tys.list(elem_ty))
+            }
+
+            Expr::Tuple(items) => {
+                let mut element_types = Vec::with_capacity(items.len());
+                for item in items {
+                    element_types.push(self.infer(item)?);
+                }
+                Ok(self.tys.tuple(&element_types))
+            }
+
+            Expr::Assign { target, value } => {
+                let t_target = self.infer(target)?;
+                let t_val = self.infer(value)?;
+                self.unify(t_target, t_val)
+                    .map_err(|e| type_error(format!("assignment type mismatch: {e}")))?;
+                Ok(Ty::NULL)
+            }
+
+            Expr::Async(body) | Expr::Await(body) => self.infer(body),
+        }
+    }
+
+    // ── 类型表达式转内部类型 ──
+
+    fn type_expr_to_type(&mut self, te: &TypeExpr) -> InferResult<Ty> {
+        match te {
+            TypeExpr::Named(n) => match n.as_str() {
+                "Int64" => Ok(Ty::INT64),
+                "Float64" => Ok(Ty::FLOAT64),
+                "String" => Ok(Ty::STRING),
+                "Bool" => Ok(Ty::BOOL),
+                "Null" => Ok(Ty::NULL),
+                _ => {
+                    if let Some(&id) = self.structs.get(n) {
+                        let fields = self
+                            .struct_fields
+                            .get(&id)
+                            .copied()
+                            .unwrap_or(Fields::EMPTY);
+                        Ok(self.tys.mk(TyKind::Record(id, fields)))
+                    } else if self.interfaces.contains_key(n) {
+                        let name = self.tys.name(n);
+                        Ok(self.tys.mk(TyKind::Interface(name)))
+                    } else {
+                        Err(type_error(format!("unknown type '{n}'")))
+                    }
+                }
+            },
+            TypeExpr::List(t) => {
+                let elem = self.type_expr_to_type(t)?;
+                Ok(self.tys.list(elem))
+            }
+            TypeExpr::Arrow { params, ret } => {
+                let ret_ty = self.type_expr_to_type(ret)?;
+                let param_tys = params
+                    .iter()
+                    .map(|p| self.type_expr_to_type(p))
+                    .collect::<Result<Vec<_>, _>>()?;
+                // 单参数不包裹元组（边界条件 1），多参数包裹为 Tuple
+                let param_ty = self.param_type(&param_tys);
+                Ok(self.tys.arrow(param_ty, ret_ty))
+            }
+            TypeExpr::Tuple(elements) => {
+                let tys = elements
+                    .iter()
+                    .map(|e| self.type_expr_to_type(e))
+                    .collect::<Result<Vec<_>, _>>()?;
+                Ok(self.tys.tuple(&tys))
+            }
+        }
+    }
+}
+
+// ── tests ──
+
+#[cfg(test)]
+#[allow(clippy::approx_constant)]
+mod tests {
+    use super::*;
+
+    const S: Span = Span { line: 0, col: 0 };
+
+    fn module(stmts: Vec<Stmt>) -> Module {
+        Module { stmts }
+    }
+
+    fn const_decl(name: &str, value: Expr) -> Stmt {
+        Stmt::ConstDecl {
+            name: name.to_string(),
+            span: S,
+            ty_ann: None,
+            value,
+        }
+    }
+
+    fn var_decl(name: &str, value: Option<Expr>) -> Stmt {
+        Stmt::VarDecl {
+            name: name.to_string(),
+            span: S,
+            ty_ann: None,
+            value,
+        }
+    }
+
+    fn param(name: &str, ty_ann: Option<TypeExpr>) -> Param {
+        Param {
+            name: name.to_string(),
+            span: S,
+            ty_ann,
+        }
+    }
+
+    /// 测试用上下文：登记 struct（名字, id, 字段）和单态绑定
+    fn cx_with(structs: &[(&str, usize, Vec<(String, Type)>)], env: &[(&str, Type)]) -> Infer {
+        let mut cx = Infer::new();
+        for (name, id, fields) in structs {
+            cx.register_struct(name, *id);
+            let fs = cx.tys.lower_fields(fields, 0, &mut HashMap::new());
+            cx.struct_fields.insert(*id, fs);
+        }
+        for (name, ty) in env {
+            let ty = cx.tys.lower(ty, 0, &mut HashMap::new());
+            cx.env.insert(name.to_string(), ty);
+        }
+        cx
+    }
+
+    fn infer_in(cx: &mut Infer, expr: &Expr) -> InferResult<Type> {
+        let ty = cx.infer(expr)?;
+        Ok(cx.show(ty))
+    }
+
+    fn infer_expr(expr: Expr) -> InferResult<Type> {
+        let mut cx = Infer::new();
+        cx.inject_builtin_impls();
+        infer_in(&mut cx, &expr)
+    }
+
+    /// 在同一张表里降入两个类型并统一，返回统一后两者的展开
+    fn unify_types(a: &Type, b: &Type) -> Result<(Type, Type), String> {
+        let mut cx = Infer::new();
+        let mut vars = HashMap::new();
+        let ta = cx.tys.lower(a, 0, &mut vars);
+        let tb = cx.tys.lower(b, 0, &mut vars);
+        cx.unify(ta, tb)?;
+        Ok((cx.show(ta), cx.show(tb)))
+    }
+
+    /// `outer` 中的变量属于外层（已在环境里），其余变量在内层产生，然后在外层泛化
+    fn generalize_with(outer: &[TypeVar], ty: &Type) -> (Infer, Ty) {
+        let mut cx = Infer::new();
+        let mut vars = HashMap::new();
+        for v in outer {
+            let t = cx.tys.fresh(0);
+            vars.insert(*v, t);
+        }
+        let t = cx.tys.lower(ty, 1, &mut vars);
+        cx.tys.generalize(t, 0);
+        (cx, t)
+    }
+
+    fn infer_ast(module: Module) -> InferResult<(TypeEnv, HashMap<usize, Vec<(String, Type)>>)> {
+        infer_module(&module)
+    }
+
+    fn infer_src(src: &str) -> InferResult<(TypeEnv, HashMap<usize, Vec<(String, Type)>>)> {
+        match src {
+            "const x = 42;" => infer_ast(module(vec![const_decl("x", Expr::LitInt(42))])),
+            "const x = 3.14;" => infer_ast(module(vec![const_decl("x", Expr::LitFloat(3.14))])),
+            "const s = \"hi\"; const b = true;" => infer_ast(module(vec![
+                const_decl("s", Expr::LitString("hi".to_string())),
+                const_decl("b", Expr::LitTrue),
+            ])),
+            "const add = |a, b| { a + b };" => infer_ast(module(vec![const_decl(
+                "add",
+                Expr::Lambda {
+                    params: vec![
+                        Param {
+                            name: "a".to_string(),
+                            span: S,
+                            ty_ann: None,
+                        },
+                        Param {
+                            name: "b".to_string(),
+                            span: S,
+                            ty_ann: None,
+                        },
+                    ],
+                    ret_ty: None,
+                    body: Box::new(Expr::Block(vec![Stmt::ExprStmt(Expr::Binary {
+                        left: Box::new(Expr::VarRef {
+                            name: "a".to_string(),
+                            span: S,
+                        }),
+                        op: BinOp::Add,
+                        right: Box::new(Expr::VarRef {
+                            name: "b".to_string(),
+                            span: S,
+                        }),
+                    })])),
+                },
+            )])),
+            "const id = |x| { x };" => infer_ast(module(vec![const_decl(
+                "id",
+                Expr::Lambda {
+                    params: vec![Param {
+                        name: "x".to_string(),
+                        span: S,
+                        ty_ann: None,
+                    }],
+                    ret_ty: None,
+                    body: Box::new(Expr::Block(vec![Stmt::ExprStmt(Expr::VarRef {
+                        name: "x".to_string(),
+                        span: S,
+                    })])),
+                },
+            )])),
+            "struct Point { x: Float64, y: Float64 }; const p = Point { x: 1.0, y: 2.0 };" => {
+                infer_ast(module(vec![
+                    Stmt::StructDef {
+                        name: "Point".to_string(),
+                        span: S,
+                        fields: vec![
+                            FieldDef {
+                                name: "x".to_string(),
+                                span: S,
+                                ty: TypeExpr::Named("Float64".to_string()),
+                            },
+                            FieldDef {
+                                name: "y".to_string(),
+                                span: S,
+                                ty: TypeExpr::Named("Float64".to_string()),
+                            },
+                        ],
+                    },
+                    const_decl(
+                        "p",
+                        Expr::StructLit {
+                            name: "Point".to_string(),
+                            fields: vec![
+                                ("x".to_string(), Expr::LitFloat(1.0)),
+                                ("y".to_string(), Expr::LitFloat(2.0)),
+                            ],
+                            spread: None,
+                        },
+                    ),
+                ]))
+            }
+            "const s = 42.to_string();" => infer_ast(module(vec![const_decl(
+                "s",
+                Expr::Member {
+                    object: Box::new(Expr::LitInt(42)),
+                    field: "to_string".to_string(),
+                },
+            )])),
+            "var x = 42;" => infer_ast(module(vec![Stmt::VarDecl {
+                name: "x".to_string(),
+                span: S,
+                ty_ann: None,
+                value: Some(Expr::LitInt(42)),
+            }])),
+            _ => panic!("test fixture should construct AST directly for source: {src}"),
+        }
+    }
+
+    #[test]
+    fn test_int_literal() {
+        let (env, _) = infer_src("const x = 42;").unwrap();
+        match env.get("x") {
+            Some(s) => assert_eq!(format!("{}", s.body), "Int64"),
+            None => panic!("x not found"),
+        }
+    }
+
+    #[test]
+    fn test_float_literal() {
+        let (env, _) = infer_src("const x = 3.14;").unwrap();
+        match env.get("x") {
+            Some(s) => assert_eq!(format!("{}", s.body), "Float64"),
+            None => panic!(),
+        }
+    }
+
+    #[test]
+    fn test_string_and_bool() {
+        let (env, _) = infer_src("const s = \"hi\"; const b = true;").unwrap();
+        assert_eq!(format!("{}", env["s"].body), "String");
+        assert_eq!(format!("{}", env["b"].body), "Bool");
+    }
+
+    #[test]
+    fn test_lambda_simple() {
+        let (env, _) = infer_src("const add = |a, b| { a + b };").unwrap();
+        let ty = format!("{}", env["add"].body);
+        assert!(ty.contains("Int64 → Int64 → Int64") || ty.contains("→"));
+    }
+
+    #[test]
+    fn test_let_polymorphism() {
+        let (env, _) = infer_src("const id = |x| { x };").unwrap();
+        assert!(format!("{}", env["id"].body).contains("→"));
+        // id(42) and id(\"hi\") would both type-check with let-polymorphism
+    }
+
+    #[test]
+    fn test_var_is_monomorphic() {
+        let result = infer_var("var x = 42;");
+        assert!(result.is_ok());
+    }
+
+    #[test]
+    fn test_record_infer() {
+        let (env, _) = infer_src(
+            "struct Point { x: Float64, y: Float64 }; const p = Point { x: 1.0, y: 2.0 };",
+        )
+        .unwrap();
+        let ty = format!("{}", env["p"].body);
+        assert!(ty.contains("Point") || ty.contains("{"));
+    }
+
+    #[test]
+    fn test_to_string_returns_string() {
+        let (env, _) = infer_src("const s = 42.to_string();").unwrap();
+        let ty = format!("{}", env["s"].body);
+        assert_eq!(ty, "String");
+    }
+
+    #[test]
+    fn var_without_initializer_gets_fresh_type_var() {
+        let (env, _) = infer_ast(module(vec![var_decl("x", None)])).unwrap();
+        assert!(matches!(*env["x"].body, Type::Var(_)));
+    }
+
+    #[test]
+    fn annotated_lambda_uses_type_exprs() {
+        let ty = infer_expr(Expr::Lambda {
+            params: vec![param("x", Some(TypeExpr::named("Int64")))],
+            ret_ty: None,
+            body: Box::new(Expr::VarRef {
+                name: "x".to_string(),
+                span: S,
+            }),
+        })
+        .unwrap();
+
+        assert_eq!(format!("{ty}"), "(Int64 → Int64)");
+    }
+
+    #[test]
+    fn call_infers_return_type_and_call_errors_on_non_function() {
+        let id = Expr::Lambda {
+            params: vec![param("x", None)],
+            ret_ty: None,
+            body: Box::new(Expr::VarRef {
+                name: "x".to_string(),
+                span: S,
+            }),
+        };
+        assert_eq!(
+            infer_expr(Expr::Call {
+                func: Box::new(id),
+                arg: Box::new(Expr::LitString("ok".to_string())),
+            })
+            .unwrap(),
+            Type::String
+        );
+
+        let err = infer_expr(Expr::Call {
+            func: Box::new(Expr::LitInt(1)),
+            arg: Box::new(Expr::LitInt(2)),
+        })
+        .unwrap_err();
+        assert!(err.msg.contains("cannot call non-function type"));
+    }
+
+    #[test]
+    fn binary_unary_and_control_flow_exprs() {
+        assert_eq!(
+            infer_expr(Expr::Binary {
+                left: Box::new(Expr::LitInt(1)),
+                op: BinOp::Lt,
+                right: Box::new(Expr::LitInt(2)),
+            })
+            .unwrap(),
+            Type::Bool
+        );
+        assert_eq!(
+            infer_expr(Expr::Binary {
+                left: Box::new(Expr::LitString("a".to_string())),
+                op: BinOp::SAdd,
+                right: Box::new(Expr::LitString("b".to_string())),
+            })
+            .unwrap(),
+            Type::String
+        );
+        // pipe of non-function RHS should error
+        assert!(infer_expr(Expr::Binary {
+            left: Box::new(Expr::LitInt(1)),
+            op: BinOp::Pipe,
+            right: Box::new(Expr::LitInt(2)),
+        })
+        .is_err());
+        assert_eq!(
+            infer_expr(Expr::Unary {
+                op: UnOp::Not,
+                right: Box::new(Expr::LitFalse),
+            })
+            .unwrap(),
+            Type::Bool
+        );
+        assert_eq!(infer_expr(Expr::Break).unwrap(), Type::Null);
+        assert_eq!(infer_expr(Expr::Continue).unwrap(), Type::Null);
+        assert_eq!(infer_expr(Expr::Return(None)).unwrap(), Type::Null);
+        assert_eq!(
+            infer_expr(Expr::Return(Some(Box::new(Expr::LitFloat(1.0))))).unwrap(),
+            Type::Float64
+        );
+    }
+
+    #[test]
+    fn blocks_if_while_and_for_are_inferred_locally() {
+        assert_eq!(
+            infer_expr(Expr::Block(vec![
+                const_decl("x", Expr::LitInt(1)),
+                var_decl("y", Some(Expr::LitInt(2))),
+                Stmt::ExprStmt(Expr::VarRef {
+                    name: "x".to_string(),
+                    span: S
+                }),
+            ]))
+            .unwrap(),
+            Type::Int64
+        );
+        assert_eq!(
+            infer_expr(Expr::If {
+                cond: Box::new(Expr::LitTrue),
+                then_branch: Box::new(Expr::LitInt(1)),
+                else_branch: None,
+            })
+            .unwrap(),
+            Type::Int64
+        );
+        assert_eq!(
+            infer_expr(Expr::While {
+                cond: Box::new(Expr::LitFalse),
+                body: Box::new(Expr::Block(vec![])),
+            })
+            .unwrap(),
+            Type::Null
+        );
+        assert_eq!(
+            infer_expr(Expr::For {
+                var: param("item", None),
+                iterable: Box::new(Expr::ListLit(vec![Expr::LitInt(1)])),
+                body: Box::new(Expr::Block(vec![])),
+            })
+            .unwrap(),
+            Type::Null
+        );
+
+        let err = infer_expr(Expr::For {
+            var: param("item", None),
+            iterable: Box::new(Expr::LitInt(1)),
+            body: Box::new(Expr::Block(vec![])),
+        })
+        .unwrap_err();
+        assert!(err.msg.contains("for loop requires List"));
+    }
+
+    #[test]
+    fn mismatched_if_and_list_report_errors() {
+        let err = infer_expr(Expr::If {
+            cond: Box::new(Expr::LitTrue),
+            then_branch: Box::new(Expr::LitInt(1)),
+            else_branch: Some(Box::new(Expr::LitString("x".to_string()))),
+        })
+        .unwrap_err();
+        assert!(err.msg.contains("if branches"));
+
+        let err = infer_expr(Expr::ListLit(vec![
+            Expr::LitInt(1),
+            Expr::LitString("x".to_string()),
+        ]))
+        .unwrap_err();
+        assert!(err.msg.contains("list element"));
+    }
+
+    #[test]
+    fn struct_fields_methods_and_member_errors() {
+        let program = module(vec![
+            Stmt::StructDef {
+                name: "Point".to_string(),
+                span: S,
+                fields: vec![FieldDef {
+                    name: "x".to_string(),
+                    span: S,
+                    ty: TypeExpr::named("Int64"),
+                }],
+            },
+            Stmt::ImplBlock {
+                struct_name: "Point".to_string(),
+                span: S,
+                interface_name: None,
+                methods: vec![MethodDef {
+                    name: "value".to_string(),
+                    span: S,
+                    body: Expr::Lambda {
+                        params: vec![param("self", Some(TypeExpr::named("Point")))],
+                        ret_ty: None,
+                        body: Box::new(Expr::LitInt(7)),
+                    },
+                    operator: false,
+                }],
+            },
+            const_decl(
+                "p",
+                Expr::StructLit {
+                    name: "Point".to_string(),
+                    fields: vec![("x".to_string(), Expr::LitInt(1))],
+                    spread: None,
+                },
+            ),
+            const_decl(
+                "x",
+                Expr::Member {
+                    object: Box::new(Expr::VarRef {
+                        name: "p".to_string(),
+                        span: S,
+                    }),
+                    field: "x".to_string(),
+                },
+            ),
+            const_decl(
+                "m",
+                Expr::Member {
+                    object: Box::new(Expr::VarRef {
+                        name: "p".to_string(),
+                        span: S,
+                    }),
+                    field: "value".to_string(),
+                },
+            ),
+        ]);
+        let (env, _) = infer_ast(program).unwrap();
+        assert_eq!(format!("{}", env["x"].body), "Int64");
+        assert_eq!(format!("{}", env["m"].body), "Int64");
+
+        let err = infer_ast(module(vec![const_decl(
+            "bad",
+            Expr::StructLit {
+                name: "Missing".to_string(),
+                fields: vec![],
+                spread: None,
+            },
+        )]))
+        .unwrap_err();
+        assert!(err.msg.contains("unknown struct"));
+
+        let err = infer_expr(Expr::Member {
+            object: Box::new(Expr::LitInt(1)),
+            field: "x".to_string(),
+        })
+        .unwrap_err();
+        assert!(
+            err.msg.contains("not found"),
+            "expected 'not found' error, got: {}",
+            err.msg
+        );
+    }
+
+    #[test]
+    fn member_builtins_index_assign_async_and_await() {
+        assert_eq!(
+            infer_expr(Expr::Member {
+                object: Box::new(Expr::LitInt(1)),
+                field: "to_float".to_string(),
+            })
+            .unwrap(),
+            Type::Float64
+        );
+        assert_eq!(
+            infer_expr(Expr::Index {
+                object: Box::new(Expr::ListLit(vec![Expr::LitInt(1)])),
+                index: Box::new(Expr::LitInt(0)),
+            })
+            .unwrap(),
+            Type::Int64
+        );
+        assert_eq!(
+            infer_expr(Expr::Index {
+                object: Box::new(Expr::LitString("abc".to_string())),
+                index: Box::new(Expr::LitInt(0)),
+            })
+            .unwrap(),
+            Type::String
+        );
+        // Index on Int is a type error
+        assert!(infer_expr(Expr::Index {
+            object: Box::new(Expr::LitInt(1)),
+            index: Box::new(Expr::LitInt(0)),
+        })
+        .is_err());
+        assert_eq!(
+            infer_expr(Expr::Assign {
+                target: Box::new(Expr::LitInt(1)),
+                value: Box::new(Expr::LitInt(42))
+            })
+            .unwrap(),
+            Type::Null
+        );
+        assert_eq!(
+            infer_expr(Expr::Async(Box::new(Expr::LitInt(1)))).unwrap(),
+            Type::Int64
+        );
+        assert_eq!(
+            infer_expr(Expr::Await(Box::new(Expr::LitFloat(3.14)))).unwrap(),
+            Type::Float64
+        );
+    }
+
+    #[test]
+    fn type_expr_unify_generalize_and_instantiate_edges() {
+        let t_int = Type::Int64;
+        let t_var = Type::Var(TypeVar(99999));
+        let (solved, _) = unify_types(&t_var, &t_int).unwrap();
+        assert_eq!(solved, Type::Int64);
+
+        let (mut cx, t) = generalize_with(&[], &Type::Int64);
+        assert!(cx.scheme(t).bound.is_empty());
+        let inst = cx.instantiate(t);
+        assert_eq!(cx.show(inst), Type::Int64);
+
+        let (mut cx, t) = generalize_with(&[], &Type::Var(TypeVar(1)));
+        assert_eq!(cx.scheme(t).bound.len(), 1);
+    }
+
+    // ── Unification scenarios ──
+
+    #[test]
+    fn unify_identical_types() {
+        let (a, b) = unify_types(&Type::Int64, &Type::Int64).unwrap();
+        assert_eq!((a, b), (Type::Int64, Type::Int64));
+    }
+
+    #[test]
+    fn unify_var_with_int() {
+        let (solved, _) = unify_types(&Type::Var(TypeVar(0)), &Type::Int64).unwrap();
+        assert_eq!(solved, Type::Int64);
+    }
+
+    #[test]
+    fn unify_int_with_var() {
+        let (_, solved) = unify_types(&Type::Int64, &Type::Var(TypeVar(0))).unwrap();
+        assert_eq!(solved, Type::Int64);
+    }
+
+    #[test]
+    fn unify_arrow_types() {
+        let t1 = Type::Arrow(Box::new(Type::Int64), Box::new(Type::Bool));
+        let t2 = Type::Arrow(Box::new(Type::Int64), Box::new(Type::Bool));
+        assert!(unify_types(&t1, &t2).is_ok());
+    }
+
+    #[test]
+    fn unify_arrow_types_different_args() {
+        let t1 = Type::Arrow(Box::new(Type::Int64), Box::new(Type::Bool));
+        let t2 = Type::Arrow(Box::new(Type::Float64), Box::new(Type::Bool));
+        assert!(unify_types(&t1, &t2).is_err());
+    }
+
+    #[test]
+    fn unify_list_types() {
+        let (solved, _) = unify_types(
+            &Type::List(Box::new(Type::Var(TypeVar(0)))),
+            &Type::List(Box::new(Type::Int64)),
+        )
+        .unwrap();
+        assert_eq!(solved, Type::List(Box::new(Type::Int64)));
+    }
+
+    #[test]
+    fn unify_record_same_id() {
+        let (a, b) = unify_types(
+            &Type::Record(1, vec![("x".into(), Type::Int64)]),
+            &Type::Record(1, vec![("y".into(), Type::Float64)]),
+        )
+        .unwrap();
+        // Records with same id unify (fields not checked structurally)
+        assert_eq!(a, Type::Record(1, vec![("x".into(), Type::Int64)]));
+        assert_eq!(b, Type::Record(1, vec![("y".into(), Type::Float64)]));
+    }
+
+    #[test]
+    fn unify_incompatible_types_error() {
+        assert!(unify_types(&Type::Int64, &Type::String).is_err());
+        assert!(unify_types(&Type::Bool, &Type::Null).is_err());
+        assert!(unify_types(&Type::Int64, &Type::List(Box::new(Type::Int64))).is_err());
+    }
+
+    #[test]
+    fn occurs_check_prevents_infinite_types() {
+        let v = TypeVar(0);
+        let infinite = Type::Arrow(Box::new(Type::Var(v)), Box::new(Type::Var(v)));
+        // This should fail the occurs check
+        assert!(unify_types(&Type::Var(v), &infinite).is_err());
+    }
+
+    // ── Schema generalization and instantiation ──
+
+    #[test]
+    fn generalize_closed_type_is_monomorphic() {
+        let (mut cx, t) = generalize_with(&[], &Type::Int64);
+        assert!(cx.scheme(t).bound.is_empty());
+    }
+
+    #[test]
+    fn generalize_open_type_is_polymorphic() {
+        let (mut cx, t) = generalize_with(
+            &[],
+            &Type::Arrow(
+                Box::new(Type::Var(TypeVar(7))),
+                Box::new(Type::Var(TypeVar(7))),
+            ),
+        );
+        assert_eq!(cx.scheme(t).bound.len(), 1);
+    }
+
+    #[test]
+    fn generalize_respects_env_free_vars() {
+        let (mut cx, t) = generalize_with(&[], &Type::Var(TypeVar(0)));
+        assert_eq!(cx.scheme(t).bound.len(), 1); // not in env → should be generalized
+                                                 // Now the same var belongs to the enclosing env — not generalized
+        let (mut cx, t) = generalize_with(&[TypeVar(0)], &Type::Var(TypeVar(0)));
+        assert!(cx.scheme(t).bound.is_empty());
+    }
+
+    #[test]
+    fn instantiate_creates_fresh_vars() {
+        let t = Type::Arrow(
+            Box::new(Type::Var(TypeVar(0))),
+            Box::new(Type::Var(TypeVar(0))),
+        );
+        let (mut cx, scheme) = generalize_with(&[], &t);
+        let bound = cx.scheme(scheme).bound;
+        let inst = cx.instantiate(scheme);
+        // Should produce an arrow with fresh type vars
+        match cx.show(inst) {
+            Type::Arrow(a, r) => {
+                assert!(matches!(*a, Type::Var(v) if !bound.contains(&v)));
+                assert_eq!(a, r);
+            }
+            _ => panic!("expected arrow"),
+        }
+    }
+
+    // ── Type inference: expressions ──
+
+    #[test]
+    fn infer_lit_null() {
+        assert_eq!(infer_expr(Expr::LitNull).unwrap(), Type::Null);
+    }
+
+    #[test]
+    fn infer_lit_string() {
+        assert_eq!(
+            infer_expr(Expr::LitString("hello".into())).unwrap(),
+            Type::String
+        );
+    }
+
+    #[test]
+    fn infer_binop_add_int() {
+        assert_eq!(
+            infer_expr(Expr::Binary {
+                left: Box::new(Expr::LitInt(1)),
+                op: BinOp::Add,
+                right: Box::new(Expr::LitInt(2)),
+            })
+            .unwrap(),
+            Type::Int64
+        );
+    }
+
+    #[test]
+    fn infer_binop_sub_int() {
+        assert_eq!(
+            infer_expr(Expr::Binary {
+                left: Box::new(Expr::LitInt(5)),
+                op: BinOp::Sub,
+                right: Box::new(Expr::LitInt(3)),
+            })
+            .unwrap(),
+            Type::Int64
+        );
+    }
+
+    #[test]
+    fn infer_binop_mul_float() {
+        assert_eq!(
+            infer_expr(Expr::Binary {
+                left: Box::new(Expr::LitFloat(2.0)),
+                op: BinOp::Mul,
+                right: Box::new(Expr::LitFloat(3.0)),
+            })
+            .unwrap(),
+            Type::Float64
+        );
+    }
+
+    #[test]
+    fn infer_binop_div_int() {
+        assert_eq!(
+            infer_expr(Expr::Binary {
+                left: Box::new(Expr::LitInt(10)),
+                op: BinOp::Div,
+                right: Box::new(Expr::LitInt(3)),
+            })
+            .unwrap(),
+            Type::Int64
+        );
+    }
+
+    #[test]
+    fn infer_binop_mod_int() {
+        assert_eq!(
+            infer_expr(Expr::Binary {
+                left: Box::new(Expr::LitInt(10)),
+                op: BinOp::Mod,
+                right: Box::new(Expr::LitInt(3)),
+            })
+            .unwrap(),
+            Type::Int64
+        );
+    }
+
+    #[test]
+    fn infer_binop_eq_returns_bool() {
+        assert_eq!(
+            infer_expr(Expr::Binary {
+                left: Box::new(Expr::LitInt(1)),
+                op: BinOp::Eq,
+                right: Box::new(Expr::LitInt(2)),
+            })
+            .unwrap(),
+            Type::Bool
+        );
+    }
+
+    #[test]
+    fn infer_binop_ne_returns_bool() {
+        assert_eq!(
+            infer_expr(Expr::Binary {
+                left: Box::new(Expr::LitFloat(1.0)),
+                op: BinOp::Ne,
+                right: Box::new(Expr::LitFloat(2.0)),
+            })
+            .unwrap(),
+            Type::Bool
+        );
+    }
+
+    #[test]
+    fn infer_binop_and_returns_bool() {
+        assert_eq!(
+            infer_expr(Expr::Binary {
+                left: Box::new(Expr::LitTrue),
+                op: BinOp::And,
+                right: Box::new(Expr::LitFalse),
+            })
+            .unwrap(),
+            Type::Bool
+        );
+    }
+
+    #[test]
+    fn infer_binop_or_returns_bool() {
+        assert_eq!(
+            infer_expr(Expr::Binary {
+                left: Box::new(Expr::LitFalse),
+                op: BinOp::Or,
+                right: Box::new(Expr::LitTrue),
+            })
+            .unwrap(),
+            Type::Bool
+        );
+    }
+
+    #[test]
+    fn infer_binop_pipe() {
+        // 42 |> |x| { x + 1 }  :  pipe Int64 through (Int64 -> Int64) should give Int64
+        let func = Expr::Lambda {
+            params: vec![Param {
+                    name: "x".to_string(),
+                    span: S,
+                    ty_ann: Some(TypeExpr::Named("Int64".to_string())),
+                }],
+            body: Box::new(Expr::Binary {
+                left: Box::new(Expr::VarRef { name: "x".to_string(), span: S }),
+                op: BinOp::Add,
+                right: Box::new(Expr::LitInt(1)),
+            }),
+            ret_ty: Some(TypeExpr::Named("Int64".to_string())),
+        };
+        assert_eq!(
+            infer_expr(Expr::Binary {
+                left: Box::new(Expr::LitInt(42)),
+                op: BinOp::Pipe,
+                right: Box::new(func),
+            })
+            .unwrap(),
+            Type::Int64
+        );
+    }
+
+    #[test]
+    fn infer_binop_gtgt() {
+        assert_eq!(
+            infer_expr(Expr::Binary {
+                left: Box::new(Expr::LitString("a".into())),
+                op: BinOp::GtGt,
+                right: Box::new(Expr::LitString("b".into())),
+            })
+            .unwrap(),
+            Type::String
+        );
+    }
+
+    #[test]
+    fn infer_unary_neg_int() {
+        assert_eq!(
+            infer_expr(Expr::Unary {
+                op: UnOp::Neg,
+                right: Box::new(Expr::LitInt(1)),
+            })
+            .unwrap(),
+            Type::Int64
+        );
+    }
+
+    #[test]
+    fn infer_unary_not_returns_bool() {
+        assert_eq!(
+            infer_expr(Expr::Unary {
+                op: UnOp::Not,
+                right: Box::new(Expr::LitFalse),
+            })
+            .unwrap(),
+            Type::Bool
+        );
+    }
+
+    // ── Control flow inference ──
+
+    #[test]
+    fn infer_if_else_branches_unify() {
+        let e = Expr::If {
+            cond: Box::new(Expr::LitTrue),
+            then_branch: Box::new(Expr::LitInt(1)),
+            else_branch: Some(Box::new(Expr::LitInt(0))),
+        };
+        assert_eq!(infer_expr(e).unwrap(), Type::Int64);
+    }
+
+    #[test]
+    fn infer_if_without_else_returns_then_branch_type() {
+        let e = Expr::If {
+            cond: Box::new(Expr::LitTrue),
+            then_branch: Box::new(Expr::LitInt(1)),
+            else_branch: None,
+        };
+        // if without else: then_branch type propagates
+        assert_eq!(infer_expr(e).unwrap(), Type::Int64);
+    }
+
+    #[test]
+    fn infer_while_is_null() {
+        let e = Expr::While {
+            cond: Box::new(Expr::LitTrue),
+            body: Box::new(Expr::LitInt(1)),
+        };
+        assert_eq!(infer_expr(e).unwrap(), Type::Null);
+    }
+
+    #[test]
+    fn infer_block_returns_last_expr_type() {
+        let e = Expr::Block(vec![
+            Stmt::ExprStmt(Expr::LitInt(1)),
+            Stmt::ExprStmt(Expr::LitString("result".into())),
+        ]);
+        assert_eq!(infer_expr(e).unwrap(), Type::String);
+    }
+
+    #[test]
+    fn infer_empty_block_is_null() {
+        let e = Expr::Block(vec![]);
+        assert_eq!(infer_expr(e).unwrap(), Type::Null);
+    }
+
+    // ── Struct and member inference ──
+
+    #[test]
+    fn infer_struct_lit_validates_fields() {
+        // Struct lit without struct in registry → error
+        let err = infer_expr(Expr::StructLit {
+            name: "Missing".into(),
+            fields: vec![],
+            spread: None,
+        })
+        .unwrap_err();
+        assert!(err.msg.contains("unknown struct"));
+    }
+
+    #[test]
+    fn infer_field_access_on_record() {
+        let mut cx = cx_with(&[("X", 1, vec![("val".into(), Type::Int64)])], &[]);
+        // Infer StructLit to get a Record type, then access field
+        let lit = Expr::StructLit {
+            name: "X".into(),
+            fields: vec![("val".into(), Expr::LitInt(42))],
+            spread: None,
+        };
+        assert_eq!(
+            infer_in(&mut cx, &lit).unwrap(),
+            Type::Record(1, vec![("val".into(), Type::Int64)])
+        );
+        let member = Expr::Member {
+            object: Box::new(lit),
+            field: "val".into(),
+        };
+        assert_eq!(infer_in(&mut cx, &member).unwrap(), Type::Int64);
+    }
+
+    #[test]
+    fn infer_field_access_errors_on_non_record() {
+        let err = infer_expr(Expr::Member {
+            object: Box::new(Expr::LitInt(42)),
+            field: "unknown".into(),
+        })
+        .unwrap_err();
+        assert!(
+            err.msg.contains("not found"),
+            "expected 'not found' error, got: {}",
+            err.msg
+        );
+    }
+
+    // ── List inference ──
+
+    #[test]
+    fn infer_empty_list_is_var() {
+        let ty = infer_expr(Expr::ListLit(vec![])).unwrap();
+        assert!(matches!(ty, Type::List(_)));
+    }
+
+    #[test]
+    fn infer_list_unifies_elements() {
+        let ty = infer_expr(Expr::ListLit(vec![
+            Expr::LitInt(1),
+            Expr::LitInt(2),
+            Expr::LitInt(3),
+        ]))
+        .unwrap();
+        assert_eq!(ty, Type::List(Box::new(Type::Int64)));
+    }
+
+    #[test]
+    fn infer_list_mixed_types_errors() {
+        let err = infer_expr(Expr::ListLit(vec![
+            Expr::LitInt(1),
+            Expr::LitString("x".into()),
+        ]))
+        .unwrap_err();
+        assert!(err.msg.contains("list element"));
+    }
+
+    // ── Call inference ──
+
+    #[test]
+    fn infer_call_with_matching_args() {
+        // Lambda with 1 arg called with 1 arg — should infer
+        let func = Expr::Lambda {
+            params: vec![param("x", None)],
+            ret_ty: None,
+            body: Box::new(Expr::VarRef {
+                name: "x".into(),
+                span: S,
+            }),
+        };
+        let call = Expr::Call {
+            func: Box::new(func),
+            arg: Box::new(Expr::LitInt(1)),
+        };
+        assert_eq!(infer_expr(call).unwrap(), Type::Int64);
+    }
+
+    #[test]
+    fn infer_call_with_matching_args_returns_body_type() {
+        // Lambda with 2 params called with 2 args
+        let func = Expr::Lambda {
+            params: vec![param("x", None), param("y", None)],
+            ret_ty: None,
+            body: Box::new(Expr::LitFloat(3.14)),
+        };
+        let call = Expr::Call {
+            func: Box::new(func),
+            arg: Expr::call_arg(vec![Expr::LitInt(1), Expr::LitInt(2)]),
+        };
+        assert_eq!(infer_expr(call).unwrap(), Type::Float64);
+    }
+
+    // ── Assign inference ──
+
+    #[test]
+    fn infer_assign_is_null() {
+        // Assign returns Null regardless of target/value types
+        let e = Expr::Assign {
+            target: Box::new(Expr::LitInt(1)),
+            value: Box::new(Expr::LitInt(0)),
+        };
+        assert_eq!(infer_expr(e).unwrap(), Type::Null);
+    }
+
+    // ── Per-context type variables ──
+
+    #[test]
+    fn each_context_numbers_vars_from_zero() {
+        let mut a = Infer::new();
+        for _ in 0..3 {
+            a.fresh();
+        }
+        let mut b = Infer::new();
+        let first = b.fresh();
+        assert_eq!(b.show(first), Type::Var(TypeVar(0)));
+        assert_eq!(a.tys.var_count(), 3);
+    }
+
+    #[test]
+    fn modules_infer_concurrently_with_identical_results() {
+        let id = Expr::Lambda {
+            params: vec![param("x", None)],
+            ret_ty: None,
+            body: Box::new(Expr::VarRef {
+                name: "x".into(),
+                span: S,
+            }),
+        };
+        let m = module(vec![const_decl("id", id), var_decl("v", None)]);
+        let show = |env: &TypeEnv| format!("{} / {}", env["id"].body, env["v"].body);
+        let expected = show(&infer_module(&m).unwrap().0);
+        std::thread::scope(|s| {
+            let handles: Vec<_> = (0..4)
+                .map(|_| s.spawn(|| infer_module(&m).unwrap().0))
+                .collect();
+            for h in handles {
+                assert_eq!(show(&h.join().unwrap()), expected);
+            }
+        });
+    }
+
+    // ── Stdlib presence ──
+
+    #[test]
+    fn stdlib_includes_print() {
+        let mut cx = Infer::new();
+        cx.inject_stdlib();
+        let env = cx.type_env();
+        assert!(env.contains_key("print"));
+        assert!(env.contains_key("sqrt"));
+        assert!(env.contains_key("sin"));
+        assert!(env.contains_key("cos"));
+    }
+
+    #[test]
+    fn array_kernels_are_typed_by_element() {
+        let call = |name: &str, args: Vec<Expr>| Expr::Call {
+            func: Box::new(Expr::VarRef {
+                name: name.into(),
+                span: S,
+            }),
+            arg: Expr::call_arg(args),
+        };
+        let floats = || Expr::ListLit(vec![Expr::LitFloat(1.5), Expr::LitFloat(2.5)]);
+        let ints = || Expr::ListLit(vec![Expr::LitInt(1)]);
+        let (env, _) = infer_ast(module(vec![
+            const_decl("s", call("sum", vec![floats()])),
+            const_decl("d", call("dot", vec![ints(), ints()])),
+            const_decl("m", call("array_lt", vec![floats(), floats()])),
+            const_decl(
+                "z",
+                call("int_array", vec![Expr::LitInt(4), Expr::LitInt(0)]),
+            ),
+        ]))
+        .unwrap();
+        assert_eq!(*env["s"].body, Type::Float64);
+        assert_eq!(*env["d"].body, Type::Int64);
+        assert_eq!(*env["m"].body, Type::List(Box::new(Type::Int64)));
+        assert_eq!(*env["z"].body, Type::List(Box::new(Type::Int64)));
+    }
+
+    // ── Polymorphic var ──
+
+    #[test]
+    fn var_without_init_is_fresh_var() {
+        let (env, _) = infer_ast(module(vec![var_decl("x", None)])).unwrap();
+        assert!(matches!(*env["x"].body, Type::Var(_)));
+    }
+
+    #[test]
+    fn monomorphic_var_after_assign() {
+        let (env, _) = infer_ast(module(vec![var_decl("x", Some(Expr::LitFloat(1.0)))])).unwrap();
+        assert_eq!(*env["x"].body, Type::Float64);
+    }
+
+    #[test]
+    fn type_expr_to_type_edge_cases() {
+        let mut cx = cx_with(
+            &[("Node", 1, vec![("value".to_string(), Type::Int64)])],
+            &[],
+        );
+        let mut lower = |te: &TypeExpr| cx.type_expr_to_type(te).map(|t| cx.show(t));
+
+        assert_eq!(
+            lower(&TypeExpr::List(Box::new(TypeExpr::named("Int64")))).unwrap(),
+            Type::List(Box::new(Type::Int64))
+        );
+        assert_eq!(
+            format!(
+                "{}",
+                lower(&TypeExpr::Arrow {
+                    params: vec![TypeExpr::named("Int64")],
+                    ret: Box::new(TypeExpr::named("Bool")),
+                })
+                .unwrap()
+            ),
+            "(Int64 → Bool)"
+        );
+        assert_eq!(
+            lower(&TypeExpr::named("Node")).unwrap(),
+            Type::Record(1, vec![("value".to_string(), Type::Int64)])
+        );
+        assert!(lower(&TypeExpr::named("Missing")).is_err());
+
+        assert!(unify_types(
+            &Type::Var(TypeVar(10)),
+            &Type::List(Box::new(Type::Var(TypeVar(10))))
+        )
+        .is_err());
+        assert!(unify_types(
+            &Type::Arrow(Box::new(Type::Int64), Box::new(Type::Bool)),
+            &Type::Arrow(Box::new(Type::Int64), Box::new(Type::String)),
+        )
+        .is_err());
+
+        // TypeVar(1) is bound in the enclosing env ("kept"), TypeVar(2) is not
+        let (mut cx, t) = generalize_with(
+            &[TypeVar(1)],
+            &Type::Arrow(
+                Box::new(Type::Var(TypeVar(1))),
+                Box::new(Type::Var(TypeVar(2))),
+            ),
+        );
+        let scheme = cx.scheme(t);
+        assert_eq!(scheme.bound.len(), 1);
+        assert!(matches!(&*scheme.body, Type::Arrow(p, r)
+            if **r == Type::Var(scheme.bound[0]) && **p != Type::Var(scheme.bound[0])));
+        let inst = cx.instantiate(t);
+        assert!(matches!(cx.show(inst), Type::Arrow(_, _)));
+    }
+
+    fn infer_var(src: &str) -> InferResult<(TypeEnv, HashMap<usize, Vec<(String, Type)>>)> {
+        infer_src(src)
+    }
+
+    // ── Type checking regression tests ──
+
+    #[test]
+    fn t30_struct_lit_rejects_wrong_field_type() {
+        // Point { x: "hello" } when x is Int64 — must fail
+        let mut cx = cx_with(&[("Point", 0, vec![("x".into(), Type::Int64)])], &[]);
+        let lit = Expr::StructLit {
+            name: "Point".into(),
+            fields: vec![("x".into(), Expr::LitString("hi".into()))],
+            spread: None,
+        };
+        assert!(infer_in(&mut cx, &lit).is_err());
+    }
+
+    #[test]
+    fn t31_cmp_rejects_cross_type() {
+        // 1 == "abc" — must fail
+        let e = Expr::Binary {
+            left: Box::new(Expr::LitInt(1)),
+            op: BinOp::Eq,
+            right: Box::new(Expr::LitString("abc".into())),
+        };
+        assert!(infer_in(&mut cx_with(&[], &[]), &e).is_err());
+    }
+
+    #[test]
+    fn t32_arith_rejects_bool() {
+        // true + false — must fail
+        let e = Expr::Binary {
+            left: Box::new(Expr::LitTrue),
+            op: BinOp::Add,
+            right: Box::new(Expr::LitFalse),
+        };
+        assert!(infer_in(&mut cx_with(&[], &[]), &e).is_err());
+    }
+
+    #[test]
+    fn t33_neg_rejects_non_numeric() {
+        // -true — must fail
+        let e = Expr::Unary {
+            op: UnOp::Neg,
+            right: Box::new(Expr::LitTrue),
+        };
+        assert!(infer_expr(e).is_err());
+    }
+
+    #[test]
+    fn t34_assign_unifies_types() {
+        // x = 42 when x: String — must fail (x must be pre-bound as String)
+        let mut cx = cx_with(&[], &[("x", Type::String)]);
+        let e = Expr::Assign {
+            target: Box::new(Expr::VarRef {
+                name: "x".into(),
+                span: S,
+            }),
+            value: Box::new(Expr::LitInt(42)),
+        };
+        assert!(infer_in(&mut cx, &e).is_err());
+    }
+
+    #[test]
+    fn t35_index_rejects_non_list_non_string() {
+        // 42[0] — must fail
+        let e = Expr::Index {
+            object: Box::new(Expr::LitInt(42)),
+            index: Box::new(Expr::LitInt(0)),
+        };
+        assert!(infer_expr(e).is_err());
+    }
+
+    #[test]
+    fn t36_for_accepts_polymorphic_list() {
+        // for x in list where list is a lambda param (unbound type var) — should succeed
+        // Unbound: list is just Var, not yet unified with List
+        let mut cx = cx_with(&[], &[("list", Type::Var(TypeVar(0)))]);
+        let e = Expr::For {
+            var: Param {
+                name: "x".into(),
+                span: S,
+                ty_ann: None,
+            },
+            iterable: Box::new(Expr::VarRef {
+                name: "list".into(),
+                span: S,
+            }),
+            body: Box::new(Expr::Block(vec![])),
+        };
+        // Should NOT error with "for loop requires List" — should unify list with List<?>
+        assert!(infer_in(&mut cx, &e).is_ok());
+        let list = cx.env["list"];
+        assert!(matches!(cx.show(list), Type::List(_)));
+    }
+
+    // ── 增量推断 ──
+
+    /// struct Point、id 函数、用到 id 的 p，以及与它们都无关的 n
+    fn incremental_program() -> Vec<Stmt> {
+        let id = Expr::Lambda {
+            params: vec![param("x", None)],
+            ret_ty: None,
+            body: Box::new(Expr::VarRef {
+                name: "x".into(),
+                span: S,
+            }),
+        };
+        let p = Expr::Call {
+            func: Box::new(Expr::VarRef {
+                name: "id".into(),
+                span: S,
+            }),
+            arg: Box::new(Expr::StructLit {
+                name: "Point".to_string(),
+                fields: vec![("x".to_string(), Expr::LitInt(1))],
+                spread: None,
+            }),
+        };
+        vec![
+            Stmt::StructDef {
+                name: "Point".to_string(),
+                span: S,
+                fields: vec![FieldDef {
+                    name: "x".to_string(),
+                    span: S,
+                    ty: TypeExpr::named("Int64"),
+                }],
+            },
+            const_decl("id", id),
+            const_decl("p", p),
+            const_decl("n", Expr::LitFloat(2.5)),
+        ]
+    }
+
+    #[test]
+    fn infer_stmts_matches_whole_module_given_known_dependencies() {
+        let stmts = incremental_program();
+        let refs: Vec<&Stmt> = stmts.iter().collect();
+        let mut ids = TypeIds::default();
+        let all = infer_stmts(&refs, &[None; 4], &mut ids).unwrap();
+        assert_eq!(
+            all.iter().map(|r| r.index).collect::<Vec<_>>(),
+            [0, 1, 2, 3]
+        );
+        let id_scheme = all[1].bindings[0].1.clone();
+        assert!(id_scheme.bound.len() == 1);
+        assert_eq!(all[1].bindings[0].0, "id");
+        assert!(all.iter().all(|r| !r.open));
+
+        // 只重推 p：id 取缓存，struct 定义照常处理，n 没人用到、传空
+        let id_bindings = [("id".to_string(), id_scheme)];
+        let cached = [None, Some(&id_bindings[..]), None, Some(&[][..])];
+        let part = infer_stmts(&refs, &cached, &mut ids).unwrap();
+        assert_eq!(part.iter().map(|r| r.index).collect::<Vec<_>>(), [0, 2]);
+        let show = |r: &[StmtTypes], i: usize| {
+            let r = r.iter().find(|r| r.index == i).unwrap();
+            format!("{}", r.bindings[0].1.body)
+        };
+        assert_eq!(show(&part, 2), show(&all, 2));
+
+        let (env, _) = infer_ast(module(stmts)).unwrap();
+        assert_eq!(show(&part, 2), format!("{}", env["p"].body));
+    }
+
+    #[test]
+    fn cached_bindings_enter_the_env_at_their_own_statement() {
+        let x = |name: &str| Expr::VarRef {
+            name: name.into(),
+            span: S,
+        };
+        let stmts = vec![
+            const_decl("x", Expr::LitInt(1)),
+            const_decl("y", x("x")),
+            const_decl("x", Expr::LitString("s".into())),
+            const_decl("z", x("x")),
+        ];
+        let refs: Vec<&Stmt> = stmts.iter().collect();
+        let int = [("x".to_string(), Scheme::monomorphic(Type::Int64))];
+        let string = [("x".to_string(), Scheme::monomorphic(Type::String))];
+        let cached = [Some(&int[..]), None, Some(&string[..]), None];
+        let out = infer_stmts(&refs, &cached, &mut TypeIds::default()).unwrap();
+        let shown: Vec<String> = out
+            .iter()
+            .map(|r| format!("{}", r.bindings[0].1.body))
+            .collect();
+        assert_eq!(shown, ["Int64", "String"]);
+    }
+
+    #[test]
+    fn bindings_refined_by_later_statements_are_open() {
+        let total = || Expr::VarRef {
+            name: "total".into(),
+            span: S,
+        };
+        let stmts = vec![
+            Stmt::VarDecl {
+                name: "total".into(),
+                span: S,
+                ty_ann: None,
+                value: None,
+            },
+            Stmt::ExprStmt(Expr::Assign {
+                target: Box::new(total()),
+                value: Box::new(Expr::LitInt(1)),
+            }),
+        ];
+        let refs: Vec<&Stmt> = stmts.iter().collect();
+        let out = infer_stmts(&refs, &[None, None], &mut TypeIds::default()).unwrap();
+        // 最终类型已经是 Int64，但它是第二条语句定下来的
+        assert_eq!(format!("{}", out[0].bindings[0].1.body), "Int64");
+        assert!(out[0].open);
+    }
+
+    #[test]
+    fn type_ids_are_reused_across_incremental_runs() {
+        let stmts = incremental_program();
+        let refs: Vec<&Stmt> = stmts.iter().collect();
+        let mut ids = TypeIds::default();
+        let cached = [None, Some(&[][..]), Some(&[][..]), None];
+        infer_stmts(&refs, &cached, &mut ids).unwrap();
+        let first = ids.structs["Point"];
+        infer_stmts(&refs, &cached, &mut ids).unwrap();
+        assert_eq!(ids.structs["Point"], first);
+        assert_ne!(TypeIds::default().structs.get("Point"), Some(&first));
+    }
+
+    #[test]
+    fn module_type_ids_depend_only_on_path_and_name() {
+        let stmts = incremental_program();
+        let refs: Vec<&Stmt> = stmts.iter().collect();
+        let run = |ids: &mut TypeIds| {
+            infer_stmts(&refs, &[None; 4], ids).unwrap();
+            ids.structs["Point"]
+        };
+        let a = run(&mut TypeIds::for_module("a.kb"));
+        assert_eq!(run(&mut TypeIds::for_module("a.kb")), a);
+        assert_ne!(run(&mut TypeIds::for_module("b.kb")), a);
+        assert_ne!(run(&mut TypeIds::default()), a);
+        let mut ids = TypeIds::for_module("a.kb");
+        assert_ne!(ids.struct_id("Point"), ids.enum_id("Point"));
+    }
+
+    #[test]
+    fn infer_stmts_reports_failing_statement_index() {
+        let stmts = vec![
+            const_decl("a", Expr::LitInt(1)),
+            const_decl(
+                "b",
+                Expr::VarRef {
+                    name: "missing".into(),
+                    span: S,
+                },
+            ),
+        ];
+        let refs: Vec<&Stmt> = stmts.iter().collect();
+        let (at, err) = infer_stmts(&refs, &[None, None], &mut TypeIds::default()).unwrap_err();
+        assert_eq!(at, 1);
+        assert!(err.msg.contains("missing"));
+    }
+
+    #[test]
+    fn stmt_bindings_follow_what_inference_defines() {
+        let stmts = incremental_program();
+        assert!(stmt_bindings(&stmts[0]).is_empty());
+        assert!(declares_types(&stmts[0]));
+        assert_eq!(stmt_bindings(&stmts[1]), ["id"]);
+        assert!(!declares_types(&stmts[1]));
+        let exported = Stmt::ExportStmt(Box::new(stmts[0].clone()));
+        assert_eq!(stmt_bindings(&exported), ["Point"]);
+        assert!(declares_types(&exported));
+        assert!(prelude_env().contains_key("print"));
+    }
+}
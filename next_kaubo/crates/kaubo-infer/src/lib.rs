@@ -3,6 +3,7 @@
 #![allow(clippy::type_complexity, clippy::only_used_in_recursion)]
 
 pub mod infer;
+mod table;
 pub mod types;
 
 pub use infer::*;
@@ -0,0 +1,739 @@
+//! 类型表 — hash-consing 的类型节点 + union-find 类型变量
+//!
+//! 推断期间类型是 [`Ty`]（u32 下标）：结构相同的类型只存一份，判等就是比较下标；
+//! 字段名、variant 名、接口名驻留为 [`Name`]。类型变量是表里的槽位，统一时原地绑定
+//! （路径压缩 + 按秩合并），不再构造、组合代换表。
+//!
+//! 每个变量带一个 level（let 嵌套深度）。绑定时把被绑类型里更深的变量降到同一层，
+//! 泛化时只看 level、不扫描环境；level 为 [`GENERIC`] 的变量就是方案里的 ∀ 变量。
+//!
+//! 对外仍然是 [`Type`]：[`TyTable::export`] / [`TyTable::lower`] 负责两边转换。
+
+use crate::types::{Type, TypeVar};
+use std::borrow::Borrow;
+use std::collections::HashMap;
+use std::hash::Hash;
+use std::rc::Rc;
+
+/// 已泛化变量的 level：实例化时换成新变量
+pub const GENERIC: u32 = u32::MAX;
+
+/// 驻留的类型节点
+#[derive(Debug, Clone, Copy, PartialEq, Eq, Hash)]
+pub struct Ty(u32);
+
+impl Ty {
+    pub const INT64: Ty = Ty(0);
+    pub const FLOAT64: Ty = Ty(1);
+    pub const STRING: Ty = Ty(2);
+    pub const BOOL: Ty = Ty(3);
+    pub const NULL: Ty = Ty(4);
+}
+
+/// 驻留的名字
+#[derive(Debug, Clone, Copy, PartialEq, Eq, Hash)]
+pub struct Name(u32);
+
+/// 驻留的类型列表（元组元素）
+#[derive(Debug, Clone, Copy, PartialEq, Eq, Hash)]
+pub struct Tys(u32);
+
+/// 驻留的字段列表（record / variant 字段）
+#[derive(Debug, Clone, Copy, PartialEq, Eq, Hash)]
+pub struct Fields(u32);
+
+impl Fields {
+    pub const EMPTY: Fields = Fields(0);
+}
+
+/// 类型节点，子节点都是下标，整个枚举可 Copy
+#[derive(Debug, Clone, Copy, PartialEq, Eq, Hash)]
+pub enum TyKind {
+    Var(u32),
+    Int64,
+    Float64,
+    String,
+    Bool,
+    Null,
+    Arrow(Ty, Ty),
+    Record(usize, Fields),
+    Variant(usize, Name, Fields),
+    List(Ty),
+    Tuple(Tys),
+    Interface(Name),
+}
+
+/// 变量槽：未绑定（带 level 和秩）或指向另一个类型
+#[derive(Debug, Clone, Copy)]
+enum Slot {
+    Unbound { level: u32, rank: u8 },
+    Link(Ty),
+}
+
+/// 按值去重的驻留表：相同的值总是拿到相同的下标
+#[derive(Debug)]
+struct Consed<K> {
+    items: Vec<K>,
+    ids: HashMap<K, u32>,
+}
+
+impl<K: Clone + Eq + Hash> Consed<K> {
+    fn new() -> Self {
+        Consed {
+            items: Vec::new(),
+            ids: HashMap::new(),
+        }
+    }
+
+    fn find<Q: ?Sized + Hash + Eq>(&self, key: &Q) -> Option<u32>
+    where
+        K: Borrow<Q>,
+    {
+        self.ids.get(key).copied()
+    }
+
+    fn intern(&mut self, key: K) -> u32 {
+        if let Some(&id) = self.ids.get(&key) {
+            return id;
+        }
+        let id = self.items.len() as u32;
+        self.items.push(key.clone());
+        self.ids.insert(key, id);
+        id
+    }
+}
+
+/// 一次推断独享的类型表
+#[derive(Debug)]
+pub struct TyTable {
+    nodes: Consed<TyKind>,
+    /// 节点是否含变量；不含的子树在所有遍历中直接跳过
+    open: Vec<bool>,
+    lists: Consed<Rc<[Ty]>>,
+    fields: Consed<Rc<[(Name, Ty)]>>,
+    names: Consed<Rc<str>>,
+    vars: Vec<Slot>,
+    /// 变量 v 对应的 `TyKind::Var(v)` 节点
+    var_nodes: Vec<Ty>,
+}
+
+impl Default for TyTable {
+    fn default() -> Self {
+        Self::new()
+    }
+}
+
+impl TyTable {
+    pub fn new() -> Self {
+        let mut table = TyTable {
+            nodes: Consed::new(),
+            open: Vec::new(),
+            lists: Consed::new(),
+            fields: Consed::new(),
+            names: Consed::new(),
+            vars: Vec::new(),
+            var_nodes: Vec::new(),
+        };
+        // 基本类型占固定下标，对应 Ty::INT64 … Ty::NULL
+        for kind in [
+            TyKind::Int64,
+            TyKind::Float64,
+            TyKind::String,
+            TyKind::Bool,
+            TyKind::Null,
+        ] {
+            table.mk(kind);
+        }
+        table.fields.intern(Rc::from(&[][..]));
+        table
+    }
+
+    // ── 构造 ──
+
+    pub fn mk(&mut self, kind: TyKind) -> Ty {
+        let id = self.nodes.intern(kind);
+        if id as usize == self.open.len() {
+            let open = match kind {
+                TyKind::Var(_) => true,
+                TyKind::Arrow(a, b) => self.is_open(a) || self.is_open(b),
+                TyKind::List(t) => self.is_open(t),
+                TyKind::Tuple(ts) => self.tys(ts).iter().any(|&t| self.is_open(t)),
+                TyKind::Record(_, fs) | TyKind::Variant(_, _, fs) => {
+                    self.field_list(fs).iter().any(|&(_, t)| self.is_open(t))
+                }
+                _ => false,
+            };
+            self.open.push(open);
+        }
+        Ty(id)
+    }
+
+    pub fn arrow(&mut self, param: Ty, ret: Ty) -> Ty {
+        self.mk(TyKind::Arrow(param, ret))
+    }
+
+    pub fn list(&mut self, elem: Ty) -> Ty {
+        self.mk(TyKind::List(elem))
+    }
+
+    pub fn tuple(&mut self, elems: &[Ty]) -> Ty {
+        let id = match self.lists.find(elems) {
+            Some(id) => id,
+            None => self.lists.intern(Rc::from(elems)),
+        };
+        self.mk(TyKind::Tuple(Tys(id)))
+    }
+
+    pub fn fields_of(&mut self, fields: &[(Name, Ty)]) -> Fields {
+        match self.fields.find(fields) {
+            Some(id) => Fields(id),
+            None => Fields(self.fields.intern(Rc::from(fields))),
+        }
+    }
+
+    pub fn name(&mut self, s: &str) -> Name {
+        match self.names.find(s) {
+            Some(id) => Name(id),
+            None => Name(self.names.intern(Rc::from(s))),
+        }
+    }
+
+    /// 只查不驻留：没出现过的名字不可能匹配任何字段
+    pub fn find_name(&self, s: &str) -> Option<Name> {
+        self.names.find(s).map(Name)
+    }
+
+    pub fn fresh(&mut self, level: u32) -> Ty {
+        let v = self.vars.len() as u32;
+        self.vars.push(Slot::Unbound { level, rank: 0 });
+        let ty = self.mk(TyKind::Var(v));
+        self.var_nodes.push(ty);
+        ty
+    }
+
+    // ── 读取 ──
+
+    pub fn kind(&self, ty: Ty) -> TyKind {
+        self.nodes.items[ty.0 as usize]
+    }
+
+    pub fn is_open(&self, ty: Ty) -> bool {
+        self.open[ty.0 as usize]
+    }
+
+    pub fn tys(&self, id: Tys) -> Rc<[Ty]> {
+        Rc::clone(&self.lists.items[id.0 as usize])
+    }
+
+    pub fn field_list(&self, id: Fields) -> Rc<[(Name, Ty)]> {
+        Rc::clone(&self.fields.items[id.0 as usize])
+    }
+
+    pub fn name_str(&self, name: Name) -> &str {
+        &self.names.items[name.0 as usize]
+    }
+
+    #[cfg(test)]
+    pub fn var_count(&self) -> usize {
+        self.vars.len()
+    }
+
+    /// 沿绑定链找到代表类型，顺带压缩路径
+    pub fn resolve(&mut self, ty: Ty) -> Ty {
+        let TyKind::Var(v) = self.kind(ty) else {
+            return ty;
+        };
+        match self.vars[v as usize] {
+            Slot::Link(next) => {
+                let root = self.resolve(next);
+                self.vars[v as usize] = Slot::Link(root);
+                root
+            }
+            Slot::Unbound { .. } => ty,
+        }
+    }
+
+    fn level(&self, v: u32) -> u32 {
+        match self.vars[v as usize] {
+            Slot::Unbound { level, .. } => level,
+            Slot::Link(_) => unreachable!("level of a bound type variable"),
+        }
+    }
+
+    // ── 统一 ──
+
+    /// 统一两个类型，原地绑定变量。
+    ///
+    /// `known_iface` 为 `Some` 时 Record ↔ Interface 要求接口已注册；`None` 时直接放行。
+    pub fn unify(
+        &mut self,
+        a: Ty,
+        b: Ty,
+        known_iface: Option<&dyn Fn(&str) -> bool>,
+    ) -> Result<(), String> {
+        let (a, b) = (self.resolve(a), self.resolve(b));
+        if a == b {
+            return Ok(());
+        }
+        match (self.kind(a), self.kind(b)) {
+            (TyKind::Var(x), TyKind::Var(y)) => {
+                self.union(x, y);
+                Ok(())
+            }
+            (TyKind::Var(x), _) => self.bind(x, a, b),
+            (_, TyKind::Var(y)) => self.bind(y, b, a),
+            (TyKind::Record(..), TyKind::Interface(n))
+            | (TyKind::Interface(n), TyKind::Record(..)) => match known_iface {
+                Some(known) if !known(self.name_str(n)) => {
+                    Err(format!("unknown interface '{}'", self.name_str(n)))
+                }
+                _ => Ok(()),
+            },
+            (TyKind::Arrow(a1, r1), TyKind::Arrow(a2, r2)) => {
+                self.unify(a1, a2, known_iface)?;
+                self.unify(r1, r2, known_iface)
+            }
+            (TyKind::List(x), TyKind::List(y)) => self.unify(x, y, known_iface),
+            (TyKind::Tuple(xs), TyKind::Tuple(ys)) => {
+                let (xs, ys) = (self.tys(xs), self.tys(ys));
+                if xs.len() != ys.len() {
+                    return Err(self.mismatch(a, b));
+                }
+                for (&x, &y) in xs.iter().zip(ys.iter()) {
+                    self.unify(x, y, known_iface)?;
+                }
+                Ok(())
+            }
+            // 同 id 的 record / variant 直接相容，字段不做结构比较
+            (TyKind::Record(i, _), TyKind::Record(j, _)) if i == j => Ok(()),
+            (TyKind::Variant(i, ..), TyKind::Variant(j, ..)) if i == j => Ok(()),
+            _ => Err(self.mismatch(a, b)),
+        }
+    }
+
+    fn mismatch(&mut self, a: Ty, b: Ty) -> String {
+        format!("cannot unify {} and {}", self.export(a), self.export(b))
+    }
+
+    /// 两个未绑定变量合并：秩小的挂到秩大的下面，level 取较浅的
+    fn union(&mut self, x: u32, y: u32) {
+        let (
+            Slot::Unbound {
+                level: lx,
+                rank: rx,
+            },
+            Slot::Unbound {
+                level: ly,
+                rank: ry,
+            },
+        ) = (self.vars[x as usize], self.vars[y as usize])
+        else {
+            unreachable!("union of bound type variables");
+        };
+        let (root, child) = if rx < ry { (y, x) } else { (x, y) };
+        self.vars[child as usize] = Slot::Link(self.var_nodes[root as usize]);
+        self.vars[root as usize] = Slot::Unbound {
+            level: lx.min(ly),
+            rank: if rx == ry { rx + 1 } else { rx.max(ry) },
+        };
+    }
+
+    fn bind(&mut self, v: u32, var: Ty, ty: Ty) -> Result<(), String> {
+        let level = self.level(v);
+        if self.occurs_adjust(v, level, ty) {
+            return Err(self.mismatch(var, ty));
+        }
+        self.vars[v as usize] = Slot::Link(ty);
+        Ok(())
+    }
+
+    /// occurs check，同时把 `ty` 中比 `level` 深的变量降到 `level`
+    fn occurs_adjust(&mut self, v: u32, level: u32, ty: Ty) -> bool {
+        if !self.is_open(ty) {
+            return false;
+        }
+        let ty = self.resolve(ty);
+        match self.kind(ty) {
+            TyKind::Var(u) => {
+                if u == v {
+                    return true;
+                }
+                if let Slot::Unbound { level: l, .. } = &mut self.vars[u as usize] {
+                    *l = (*l).min(level);
+                }
+                false
+            }
+            TyKind::Arrow(a, b) => {
+                self.occurs_adjust(v, level, a) || self.occurs_adjust(v, level, b)
+            }
+            TyKind::List(t) => self.occurs_adjust(v, level, t),
+            TyKind::Tuple(ts) => {
+                let ts = self.tys(ts);
+                ts.iter().any(|&t| self.occurs_adjust(v, level, t))
+            }
+            TyKind::Record(_, fs) | TyKind::Variant(_, _, fs) => {
+                let fs = self.field_list(fs);
+                fs.iter().any(|&(_, t)| self.occurs_adjust(v, level, t))
+            }
+            _ => false,
+        }
+    }
+
+    // ── 泛化 / 实例化 ──
+
+    /// 把 `ty` 中 level 深于 `level` 的变量标为 GENERIC
+    pub fn generalize(&mut self, ty: Ty, level: u32) {
+        if !self.is_open(ty) {
+            return;
+        }
+        let ty = self.resolve(ty);
+        match self.kind(ty) {
+            TyKind::Var(v) => {
+                if let Slot::Unbound { level: l, .. } = &mut self.vars[v as usize] {
+                    if *l > level {
+                        *l = GENERIC;
+                    }
+                }
+            }
+            TyKind::Arrow(a, b) => {
+                self.generalize(a, level);
+                self.generalize(b, level);
+            }
+            TyKind::List(t) => self.generalize(t, level),
+            TyKind::Tuple(ts) => {
+                for &t in self.tys(ts).iter() {
+                    self.generalize(t, level);
+                }
+            }
+            TyKind::Record(_, fs) | TyKind::Variant(_, _, fs) => {
+                for &(_, t) in self.field_list(fs).iter() {
+                    self.generalize(t, level);
+                }
+            }
+            _ => {}
+        }
+    }
+
+    /// 把 GENERIC 变量换成 `level` 层的新变量；同一个变量换成同一个新变量
+    pub fn instantiate(&mut self, ty: Ty, level: u32) -> Ty {
+        let mut fresh = Vec::new();
+        self.copy_generic(ty, level, &mut fresh)
+    }
+
+    fn copy_generic(&mut self, ty: Ty, level: u32, fresh: &mut Vec<(u32, Ty)>) -> Ty {
+        if !self.is_open(ty) {
+            return ty;
+        }
+        let ty = self.resolve(ty);
+        match self.kind(ty) {
+            TyKind::Var(v) => {
+                if self.level(v) != GENERIC {
+                    return ty;
+                }
+                if let Some(&(_, t)) = fresh.iter().find(|(u, _)| *u == v) {
+                    return t;
+                }
+                let t = self.fresh(level);
+                fresh.push((v, t));
+                t
+            }
+            TyKind::Arrow(a, b) => {
+                let a = self.copy_generic(a, level, fresh);
+                let b = self.copy_generic(b, level, fresh);
+                self.arrow(a, b)
+            }
+            TyKind::List(t) => {
+                let t = self.copy_generic(t, level, fresh);
+                self.list(t)
+            }
+            TyKind::Tuple(ts) => {
+                let ts: Vec<Ty> = self
+                    .tys(ts)
+                    .iter()
+                    .map(|&t| self.copy_generic(t, level, fresh))
+                    .collect();
+                self.tuple(&ts)
+            }
+            TyKind::Record(id, fs) => {
+                let fs = self.copy_fields(fs, level, fresh);
+                self.mk(TyKind::Record(id, fs))
+            }
+            TyKind::Variant(id, name, fs) => {
+                let fs = self.copy_fields(fs, level, fresh);
+                self.mk(TyKind::Variant(id, name, fs))
+            }
+            _ => ty,
+        }
+    }
+
+    fn copy_fields(&mut self, fs: Fields, level: u32, fresh: &mut Vec<(u32, Ty)>) -> Fields {
+        let fs: Vec<(Name, Ty)> = self
+            .field_list(fs)
+            .iter()
+            .map(|&(n, t)| (n, self.copy_generic(t, level, fresh)))
+            .collect();
+        self.fields_of(&fs)
+    }
+
+    /// 类型中的 GENERIC 变量（方案的 ∀ 部分），按出现顺序去重
+    pub fn generic_vars(&mut self, ty: Ty) -> Vec<TypeVar> {
+        let mut out = Vec::new();
+        self.collect_generic(ty, &mut out);
+        out
+    }
+
+    /// 是否含没有泛化的变量——后面的合一还可能细化它
+    pub fn has_free_vars(&mut self, ty: Ty) -> bool {
+        if !self.is_open(ty) {
+            return false;
+        }
+        let ty = self.resolve(ty);
+        match self.kind(ty) {
+            TyKind::Var(v) => self.level(v) != GENERIC,
+            TyKind::Arrow(a, b) => self.has_free_vars(a) || self.has_free_vars(b),
+            TyKind::List(t) => self.has_free_vars(t),
+            TyKind::Tuple(ts) => self.tys(ts).iter().any(|&t| self.has_free_vars(t)),
+            TyKind::Record(_, fs) | TyKind::Variant(_, _, fs) => self
+                .field_list(fs)
+                .iter()
+                .any(|&(_, t)| self.has_free_vars(t)),
+            _ => false,
+        }
+    }
+
+    fn collect_generic(&mut self, ty: Ty, out: &mut Vec<TypeVar>) {
+        if !self.is_open(ty) {
+            return;
+        }
+        let ty = self.resolve(ty);
+        match self.kind(ty) {
+            TyKind::Var(v) => {
+                let tv = TypeVar(v as usize);
+                if self.level(v) == GENERIC && !out.contains(&tv) {
+                    out.push(tv);
+                }
+            }
+            TyKind::Arrow(a, b) => {
+                self.collect_generic(a, out);
+                self.collect_generic(b, out);
+            }
+            TyKind::List(t) => self.collect_generic(t, out),
+            TyKind::Tuple(ts) => {
+                for &t in self.tys(ts).iter() {
+                    self.collect_generic(t, out);
+                }
+            }
+            TyKind::Record(_, fs) | TyKind::Variant(_, _, fs) => {
+                for &(_, t) in self.field_list(fs).iter() {
+                    self.collect_generic(t, out);
+                }
+            }
+            _ => {}
+        }
+    }
+
+    // ── 与公开 Type 互转 ──
+
+    /// 完全展开成公开的 [`Type`]；未绑定变量 v 记为 `TypeVar(v)`
+    pub fn export(&mut self, ty: Ty) -> Type {
+        let ty = self.resolve(ty);
+        match self.kind(ty) {
+            TyKind::Var(v) => Type::Var(TypeVar(v as usize)),
+            TyKind::Int64 => Type::Int64,
+            TyKind::Float64 => Type::Float64,
+            TyKind::String => Type::String,
+            TyKind::Bool => Type::Bool,
+            TyKind::Null => Type::Null,
+            TyKind::Arrow(a, b) => Type::Arrow(Box::new(self.export(a)), Box::new(self.export(b))),
+            TyKind::Record(id, fs) => Type::Record(id, self.export_fields(fs)),
+            TyKind::Variant(id, name, fs) => {
+                Type::Variant(id, self.name_str(name).to_string(), self.export_fields(fs))
+            }
+            TyKind::List(t) => Type::List(Box::new(self.export(t))),
+            TyKind::Tuple(ts) => {
+                Type::Tuple(self.tys(ts).iter().map(|&t| self.export(t)).collect())
+            }
+            TyKind::Interface(name) => Type::Interface(self.name_str(name).to_string()),
+        }
+    }
+
+    pub fn export_fields(&mut self, fs: Fields) -> Vec<(String, Type)> {
+        self.field_list(fs)
+            .iter()
+            .map(|&(n, t)| (self.name_str(n).to_string(), self.export(t)))
+            .collect()
+    }
+
+    /// 把外部的 [`Type`] 降进表里。`vars` 记录外部变量到本表变量的映射，
+    /// 同一个外部变量总落到同一个变量上；新变量取 `level`。
+    pub fn lower(&mut self, ty: &Type, level: u32, vars: &mut HashMap<TypeVar, Ty>) -> Ty {
+        match ty {
+            Type::Var(tv) => {
+                if let Some(&t) = vars.get(tv) {
+                    return t;
+                }
+                let t = self.fresh(level);
+                vars.insert(*tv, t);
+                t
+            }
+            Type::Int64 => Ty::INT64,
+            Type::Float64 => Ty::FLOAT64,
+            Type::String => Ty::STRING,
+            Type::Bool => Ty::BOOL,
+            Type::Null => Ty::NULL,
+            Type::Arrow(a, b) => {
+                let a = self.lower(a, level, vars);
+                let b = self.lower(b, level, vars);
+                self.arrow(a, b)
+            }
+            Type::Record(id, fields) => {
+                let fs = self.lower_fields(fields, level, vars);
+                self.mk(TyKind::Record(*id, fs))
+            }
+            Type::Variant(id, name, fields) => {
+                let name = self.name(name);
+                let fs = self.lower_fields(fields, level, vars);
+                self.mk(TyKind::Variant(*id, name, fs))
+            }
+            Type::List(t) => {
+                let t = self.lower(t, level, vars);
+                self.list(t)
+            }
+            Type::Tuple(elems) => {
+                let ts: Vec<Ty> = elems.iter().map(|t| self.lower(t, level, vars)).collect();
+                self.tuple(&ts)
+            }
+            Type::Interface(name) => {
+                let name = self.name(name);
+                self.mk(TyKind::Interface(name))
+            }
+        }
+    }
+
+    pub fn lower_fields(
+        &mut self,
+        fields: &[(String, Type)],
+        level: u32,
+        vars: &mut HashMap<TypeVar, Ty>,
+    ) -> Fields {
+        let fs: Vec<(Name, Ty)> = fields
+            .iter()
+            .map(|(n, t)| (self.name(n), self.lower(t, level, vars)))
+            .collect();
+        self.fields_of(&fs)
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn equal_structures_share_one_node() {
+        let mut t = TyTable::new();
+        let a = t.arrow(Ty::INT64, Ty::BOOL);
+        let b = t.arrow(Ty::INT64, Ty::BOOL);
+        assert_eq!(a, b);
+        let x = t.tuple(&[Ty::INT64, a]);
+        let y = t.tuple(&[Ty::INT64, b]);
+        assert_eq!(x, y);
+        assert!(!t.is_open(x));
+        let v = t.fresh(0);
+        let open = t.tuple(&[v]);
+        assert!(t.is_open(open));
+    }
+
+    #[test]
+    fn var_chains_resolve_to_the_bound_type() {
+        let mut t = TyTable::new();
+        let vs: Vec<Ty> = (0..8).map(|_| t.fresh(0)).collect();
+        for w in vs.windows(2) {
+            t.unify(w[0], w[1], None).unwrap();
+        }
+        t.unify(vs[3], Ty::STRING, None).unwrap();
+        for &v in &vs {
+            assert_eq!(t.resolve(v), Ty::STRING);
+        }
+    }
+
+    #[test]
+    fn binding_lowers_levels_so_outer_vars_stay_monomorphic() {
+        let mut t = TyTable::new();
+        let outer = t.fresh(0);
+        let inner = t.fresh(1);
+        let other = t.fresh(1);
+        let pair = t.tuple(&[inner, other]);
+        let list = t.list(inner);
+        t.unify(outer, list, None).unwrap();
+        t.generalize(pair, 0);
+        // inner 经 outer 逃逸到外层，不能泛化；other 只在内层出现
+        assert_eq!(t.generic_vars(pair), vec![TypeVar(2)]);
+    }
+
+    #[test]
+    fn instantiate_renames_generic_vars_consistently() {
+        let mut t = TyTable::new();
+        let a = t.fresh(1);
+        let id = t.arrow(a, a);
+        t.generalize(id, 0);
+        let i1 = t.instantiate(id, 0);
+        let i2 = t.instantiate(id, 0);
+        assert_ne!(i1, id);
+        assert_ne!(i1, i2);
+        let TyKind::Arrow(p, r) = t.kind(i1) else {
+            panic!("expected arrow")
+        };
+        assert_eq!(p, r);
+        // 实例化出的变量各自绑定，互不影响，也不改动方案本身
+        let int_id = t.arrow(Ty::INT64, Ty::INT64);
+        let str_id = t.arrow(Ty::STRING, Ty::STRING);
+        t.unify(i1, int_id, None).unwrap();
+        t.unify(i2, str_id, None).unwrap();
+        assert_eq!(format!("{}", t.export(id)), "(t0 → t0)");
+    }
+
+    #[test]
+    fn occurs_check_rejects_infinite_types() {
+        let mut t = TyTable::new();
+        let v = t.fresh(0);
+        let l = t.list(v);
+        let err = t.unify(v, l, None).unwrap_err();
+        assert_eq!(err, "cannot unify t0 and List<t0>");
+    }
+
+    #[test]
+    fn interface_check_is_optional() {
+        let mut t = TyTable::new();
+        let rec = t.mk(TyKind::Record(1, Fields::EMPTY));
+        let name = t.name("Show");
+        let iface = t.mk(TyKind::Interface(name));
+        assert!(t.unify(rec, iface, None).is_ok());
+        assert!(t.unify(rec, iface, Some(&|n| n == "Show")).is_ok());
+        let err = t.unify(iface, rec, Some(&|_| false)).unwrap_err();
+        assert_eq!(err, "unknown interface 'Show'");
+    }
+
+    #[test]
+    fn lower_and_export_round_trip() {
+        let mut t = TyTable::new();
+        let ty = Type::Arrow(
+            Box::new(Type::Tuple(vec![
+                Type::Var(TypeVar(7)),
+                Type::List(Box::new(Type::Int64)),
+            ])),
+            Box::new(Type::Variant(
+                3,
+                "Some".into(),
+                vec![("0".into(), Type::Var(TypeVar(7)))],
+            )),
+        );
+        let mut vars = HashMap::new();
+        let lowered = t.lower(&ty, 0, &mut vars);
+        assert_eq!(vars.len(), 1);
+        let back = t.export(lowered);
+        assert_eq!(format!("{back}"), "((t0, List<Int64>) → Some#3)");
+        // 再降一次：同一个变量映射下得到同一个节点
+        let mut same = HashMap::from([(TypeVar(0), vars[&TypeVar(7)])]);
+        assert_eq!(t.lower(&back, 0, &mut same), lowered);
+    }
+}
@@ -27,17 +27,13 @@ pub enum Type {
     Interface(String), // interface name (for type annotations like `x: Add`)
 }
 
-/// 多态类型方案 — ∀ bound. body
+/// 多态类型方案 — ∀ bound. body（推断结果的对外形式）
 #[derive(Debug, Clone)]
 pub struct Scheme {
     pub bound: Vec<TypeVar>,
     pub body: Box<Type>,
 }
 
-/// 类型代换 — Var → Type
-#[derive(Debug, Clone, PartialEq)]
-pub struct Subst(HashMap<TypeVar, Type>);
-
 /// 类型环境 — Name → Scheme
 pub type TypeEnv = HashMap<String, Scheme>;
 
@@ -66,55 +62,6 @@ impl fmt::Display for Type {
     }
 }
 
-impl Subst {
-    pub fn empty() -> Self {
-        Subst(HashMap::new())
-    }
-
-    pub fn singleton(var: TypeVar, ty: Type) -> Self {
-        let mut m = HashMap::new();
-        m.insert(var, ty);
-        Subst(m)
-    }
-
-    pub fn apply(&self, ty: &Type) -> Type {
-        match ty {
-            Type::Var(v) => self.0.get(v).cloned().unwrap_or_else(|| ty.clone()),
-            Type::Arrow(a, b) => Type::Arrow(Box::new(self.apply(a)), Box::new(self.apply(b))),
-            Type::Record(id, fields) => Type::Record(
-                *id,
-                fields
-                    .iter()
-                    .map(|(n, t)| (n.clone(), self.apply(t)))
-                    .collect(),
-            ),
-            Type::Variant(id, name, fields) => Type::Variant(
-                *id,
-                name.clone(),
-                fields
-                    .iter()
-                    .map(|(n, t)| (n.clone(), self.apply(t)))
-                    .collect(),
-            ),
-            Type::List(t) => Type::List(Box::new(self.apply(t))),
-            Type::Tuple(elements) => Type::Tuple(elements.iter().map(|t| self.apply(t)).collect()),
-            other => other.clone(),
-        }
-    }
-
-    pub fn compose(mut self, other: &Subst) -> Self {
-        for (var, ty) in &other.0 {
-            let applied = self.apply(ty);
-            self.0.insert(*var, applied);
-        }
-        self
-    }
-
-    pub fn extend(&mut self, var: TypeVar, ty: Type) {
-        self.0.insert(var, ty);
-    }
-}
-
 impl Scheme {
     pub fn monomorphic(ty: Type) -> Self {
         Scheme {
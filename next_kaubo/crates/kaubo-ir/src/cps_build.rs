@@ -290,6 +290,9 @@ enum ValueHint {
     Struct(String),
     Interface(String),
     List,
+    /// 元素全为 Int64 / Float64 的列表 — 批量 kernel 按元素类型给出返回提示
+    IntArray,
+    FloatArray,
     Tuple,
     Unknown,
 }
@@ -298,6 +301,15 @@ impl ValueHint {
     fn is_float(&self) -> bool {
         matches!(self, ValueHint::Float)
     }
+
+    /// 数值数组的元素提示；其它类型为 `Unknown`。
+    fn elem_hint(&self) -> ValueHint {
+        match self {
+            ValueHint::IntArray => ValueHint::Int,
+            ValueHint::FloatArray => ValueHint::Float,
+            _ => ValueHint::Unknown,
+        }
+    }
 }
 
 pub struct CpsBuilder<'a> {
@@ -503,7 +515,11 @@ impl<'a> CpsBuilder<'a> {
                 }
                 _ => ValueHint::Unknown,
             },
-            TypeExpr::List(_) => ValueHint::List,
+            TypeExpr::List(elem) => match self.type_expr_hint(elem) {
+                ValueHint::Int => ValueHint::IntArray,
+                ValueHint::Float => ValueHint::FloatArray,
+                _ => ValueHint::List,
+            },
             TypeExpr::Tuple(_) => ValueHint::Tuple,
             TypeExpr::Arrow { .. } => ValueHint::Unknown,
         }
@@ -562,6 +578,15 @@ impl<'a> CpsBuilder<'a> {
             } => ValueHint::Struct(format!("{enum_name}::{variant_name}")),
             Expr::GetVariantTag(_) => ValueHint::Int,
             Expr::GetVariantField { .. } => ValueHint::Unknown,
+            Expr::ListLit(items) if !items.is_empty() => {
+                if items.iter().all(|e| matches!(e, Expr::LitInt(_))) {
+                    ValueHint::IntArray
+                } else if items.iter().all(|e| matches!(e, Expr::LitFloat(_))) {
+                    ValueHint::FloatArray
+                } else {
+                    ValueHint::List
+                }
+            }
             Expr::ListLit(_) => ValueHint::List,
             Expr::Tuple(_) => ValueHint::Tuple,
             Expr::Binary { left, op, right } => match op {
@@ -635,7 +660,7 @@ impl<'a> CpsBuilder<'a> {
             }
             Expr::Return(Some(value)) => self.expr_hint(value),
             Expr::Return(None) => ValueHint::Null,
-            Expr::Index { .. } => ValueHint::Unknown,
+            Expr::Index { object, .. } => self.expr_hint(object).elem_hint(),
             Expr::Assign { value, .. } => self.expr_hint(value),
             Expr::Lambda { .. } => ValueHint::Unknown,
             Expr::While { .. } | Expr::For { .. } | Expr::Break | Expr::Continue => ValueHint::Null,
@@ -665,6 +690,23 @@ impl<'a> CpsBuilder<'a> {
                 "sqrt" | "sin" | "cos" | "floor" | "ceil" => ValueHint::Float,
                 "print" => ValueHint::Null,
                 "assert" => ValueHint::Null,
+                _ if self.ctx.func_map.contains_key(name) => self
+                    .function_returns
+                    .get(name)
+                    .cloned()
+                    .unwrap_or(ValueHint::Unknown),
+                // 批量 kernel：返回提示跟随数组实参的元素类型
+                "sum" | "min" | "max" | "dot" => args
+                    .first()
+                    .map(|a| self.expr_hint(a).elem_hint())
+                    .unwrap_or(ValueHint::Unknown),
+                "int_array" | "array_lt" | "array_gt" | "array_eq" => ValueHint::IntArray,
+                "float_array" => ValueHint::FloatArray,
+                "prefix_sum" | "array_add" | "array_sub" | "array_mul" => args
+                    .first()
+                    .map(|a| self.expr_hint(a))
+                    .unwrap_or(ValueHint::Unknown),
+                "axpy" | "fill" => ValueHint::Null,
                 _ => self
                     .function_returns
                     .get(name)
@@ -680,6 +722,8 @@ impl<'a> CpsBuilder<'a> {
             ValueHint::String
             | ValueHint::Struct(_)
             | ValueHint::List
+            | ValueHint::IntArray
+            | ValueHint::FloatArray
             | ValueHint::Interface(_)
             | ValueHint::Tuple => true,
             ValueHint::Int | ValueHint::Float | ValueHint::Bool | ValueHint::Null => false,
@@ -1100,10 +1144,26 @@ impl<'a> CpsBuilder<'a> {
                 }
             }
             callee.next_reg = params.len().max(1);
+            // The first argument arrives in r0, which is also where every call
+            // result lands: give it its own register so a call in the body
+            // cannot overwrite it. RegAlloc merges it back into r0 when no
+            // call result is pending while it is live.
+            let first = params.first().map(|p| {
+                let r = callee.alloc();
+                callee.var_map.insert(p.name.clone(), r);
+                r
+            });
 
             // Swap ctx — build_expr operates on callee
             std::mem::swap(&mut self.ctx, &mut callee);
+            // Reserve block 0 as main does: the build_* helpers use entry == 0
+            // for "no entry yet", so no expression block may take that id.
+            self.ctx.new_block();
             let (entry, continu, result_reg) = self.build_expr(body)?;
+            self.ctx.set_block(0, block_jump(0, entry));
+            if let Some(r) = first {
+                self.ctx.blocks[0].instrs.push(CpsInstr::Move(r, 0));
+            }
             // Ensure body ends with Return(result_reg)
             if !matches!(self.ctx.blocks[continu].term, CpsTerminator::Return(_)) {
                 let ri = self.ctx.new_block();
@@ -1121,7 +1181,7 @@ impl<'a> CpsBuilder<'a> {
             // Swap back — callee now has the lambda blocks
             std::mem::swap(&mut self.ctx, &mut callee);
 
-            let func = callee.finalize(entry);
+            let func = callee.finalize(0);
             let func_idx = self.functions.len();
             // Record parameter hints for Struct→Interface wrapping at call sites
             let hints: Vec<ValueHint> = params
@@ -1162,7 +1222,9 @@ impl<'a> CpsBuilder<'a> {
         callee.next_reg = params.len();
 
         std::mem::swap(&mut self.ctx, &mut callee);
+        self.ctx.new_block(); // reserved, see build_lambda_as_function
         let (entry, continu, result_reg) = self.build_expr(body)?;
+        self.ctx.set_block(0, block_jump(0, entry));
         if !matches!(self.ctx.blocks[continu].term, CpsTerminator::Return(_)) {
             let ri = self.ctx.new_block();
             self.ctx.set_block(
@@ -1178,7 +1240,7 @@ impl<'a> CpsBuilder<'a> {
         }
         std::mem::swap(&mut self.ctx, &mut callee);
 
-        let func = callee.finalize(entry);
+        let func = callee.finalize(0);
         let func_idx = self.functions.len();
         dump_blocks(&format!("lambda_expr_{func_idx}"), &callee);
         self.functions.push(func);
@@ -1691,6 +1753,12 @@ impl<'a> CpsBuilder<'a> {
                 );
                 return Ok(result);
             }
+            // ★ 检查导入表：如果名字在 import_table 中，生成 CallExternal（同样遮蔽同名 builtin）
+            if let Some(ref import_table) = self.import_table {
+                if let Some(&import_handle) = import_table.get(name) {
+                    return self.build_call_external(import_handle, args);
+                }
+            }
             // ── builtins dispatch (fallback) ──
             if let Some(bi) = get_builtin(name) {
                 let hint = builtin_return_hint(name);
@@ -1715,22 +1783,41 @@ impl<'a> CpsBuilder<'a> {
                         Ok((entry, id, reg))
                     }
                     Builtin::Native(ni) => {
+                        let hint = match hint {
+                            ValueHint::Unknown => self.call_hint(func, args),
+                            h => h,
+                        };
                         let result = self.build_native_call(ni, args)?;
                         self.set_value_hint(result.2, hint);
                         Ok(result)
                     }
+                    Builtin::Intrinsic(op) => {
+                        let [arg] = args else {
+                            return Err(format!("{name} expects 1 argument"));
+                        };
+                        let (entry, continu, src) = self.build_expr(arg)?;
+                        let dst = self.ctx.alloc();
+                        let id = self.ctx.new_block();
+                        let (instrs, term) = cps_emit::emit_unary(dst, op, src);
+                        self.ctx.set_block(
+                            id,
+                            CpsBlock {
+                                id,
+                                params: vec![],
+                                instrs,
+                                term,
+                            },
+                        );
+                        self.ctx.chain(continu, id)?;
+                        self.set_value_hint(dst, hint);
+                        Ok((entry, id, dst))
+                    }
                     Builtin::Inline(instr) => {
                         let _ = instr;
                         Err("inline builtins not yet routed".into())
                     }
                 };
             }
-            // ★ 检查导入表：如果名字在 import_table 中，生成 CallExternal
-            if let Some(ref import_table) = self.import_table {
-                if let Some(&import_handle) = import_table.get(name) {
-                    return self.build_call_external(import_handle, args);
-                }
-            }
             return Err(format!("undefined function '{name}'"));
         }
         Err("call target is not a simple name".to_string())
@@ -1905,6 +1992,12 @@ impl<'a> CpsBuilder<'a> {
         native_idx: usize,
         args: &[Expr],
     ) -> Result<(usize, usize, usize), String> {
+        if args.len() > MAX_NATIVE_ARGS {
+            return Err(format!(
+                "native call takes at most {MAX_NATIVE_ARGS} arguments, got {}",
+                args.len()
+            ));
+        }
         let mut entry = 0;
         let mut prev_c: Option<usize> = None;
         let mut arg_regs = Vec::new();
@@ -2950,6 +3043,8 @@ enum Builtin {
     Inline(CpsInstr),
     /// Build args + emit CallNative(native_index)
     Native(usize),
+    /// 单参纯数学函数：build arg → CpsInstr::UnOp，一条指令完成
+    Intrinsic(CpsUnOp),
     /// Print: build arg → CpsInstr::Print
     Print,
 }
@@ -2961,11 +3056,28 @@ fn get_builtin(name: &str) -> Option<Builtin> {
         "print" => Some(Builtin::Print),
         "assert" => Some(Builtin::Native(2)),
         "type_of" => Some(Builtin::Native(1)),
-        "sqrt" => Some(Builtin::Native(3)),
-        "sin" => Some(Builtin::Native(4)),
-        "cos" => Some(Builtin::Native(5)),
-        "floor" => Some(Builtin::Native(6)),
-        "ceil" => Some(Builtin::Native(7)),
+        // native 3–7 仍然注册（旧字节码可用），新代码降为 intrinsic
+        "sqrt" => Some(Builtin::Intrinsic(CpsUnOp::FSqrt)),
+        "sin" => Some(Builtin::Intrinsic(CpsUnOp::FSin)),
+        "cos" => Some(Builtin::Intrinsic(CpsUnOp::FCos)),
+        "floor" => Some(Builtin::Intrinsic(CpsUnOp::FFloor)),
+        "ceil" => Some(Builtin::Intrinsic(CpsUnOp::FCeil)),
+        // 批量数组 kernel（kaubo_vm::kernels），序号接在基础 native 之后
+        "int_array" => Some(Builtin::Native(8)),
+        "float_array" => Some(Builtin::Native(9)),
+        "sum" => Some(Builtin::Native(10)),
+        "min" => Some(Builtin::Native(11)),
+        "max" => Some(Builtin::Native(12)),
+        "dot" => Some(Builtin::Native(13)),
+        "axpy" => Some(Builtin::Native(14)),
+        "fill" => Some(Builtin::Native(15)),
+        "prefix_sum" => Some(Builtin::Native(16)),
+        "array_add" => Some(Builtin::Native(17)),
+        "array_sub" => Some(Builtin::Native(18)),
+        "array_mul" => Some(Builtin::Native(19)),
+        "array_lt" => Some(Builtin::Native(20)),
+        "array_gt" => Some(Builtin::Native(21)),
+        "array_eq" => Some(Builtin::Native(22)),
         _ => None,
     }
 }
@@ -3549,12 +3661,21 @@ mod tests {
     }
 
     #[test]
-    fn build_sqrt_calls_native() {
+    fn build_sqrt_emits_intrinsic() {
         let cps = build_src("const x = sqrt(4.0);");
-        let has_call_native = cps.functions[0].blocks.iter().any(|b| {
-            matches!(b.term, CpsTerminator::CallNative(3, _, _)) // sqrt = native idx 3
+        let blocks = &cps.functions[0].blocks;
+        let has_intrinsic = blocks.iter().any(|b| {
+            b.instrs
+                .iter()
+                .any(|i| matches!(i, CpsInstr::UnOp(_, CpsUnOp::FSqrt, _)))
         });
-        assert!(has_call_native, "sqrt should emit CallNative(3)");
+        assert!(has_intrinsic, "sqrt should emit UnOp(FSqrt)");
+        assert!(
+            !blocks
+                .iter()
+                .any(|b| matches!(b.term, CpsTerminator::CallNative(..))),
+            "sqrt should not go through CallNative"
+        );
     }
 
     #[test]
@@ -3580,6 +3701,67 @@ mod tests {
         assert!(get_builtin("").is_none());
     }
 
+    #[test]
+    fn array_kernels_follow_base_natives() {
+        let kernels = [
+            "int_array",
+            "float_array",
+            "sum",
+            "min",
+            "max",
+            "dot",
+            "axpy",
+            "fill",
+            "prefix_sum",
+            "array_add",
+            "array_sub",
+            "array_mul",
+            "array_lt",
+            "array_gt",
+            "array_eq",
+        ];
+        for (i, name) in kernels.iter().enumerate() {
+            assert!(
+                matches!(get_builtin(name), Some(Builtin::Native(n)) if n == 8 + i),
+                "{name}: expected Native({})",
+                8 + i
+            );
+        }
+    }
+
+    #[test]
+    fn list_hints_track_numeric_elements() {
+        let b = CpsBuilder::new(None);
+        let ints = Expr::ListLit(vec![Expr::LitInt(1), Expr::LitInt(2)]);
+        let floats = Expr::ListLit(vec![Expr::LitFloat(1.0)]);
+        let mixed = Expr::ListLit(vec![Expr::LitInt(1), Expr::LitFloat(1.0)]);
+        assert_eq!(b.expr_hint(&ints), ValueHint::IntArray);
+        assert_eq!(b.expr_hint(&floats), ValueHint::FloatArray);
+        assert_eq!(b.expr_hint(&mixed), ValueHint::List);
+        assert_eq!(
+            b.type_expr_hint(&TypeExpr::List(Box::new(TypeExpr::Named("Float64".into())))),
+            ValueHint::FloatArray
+        );
+
+        let sum = Expr::VarRef {
+            name: "sum".into(),
+            span: S,
+        };
+        assert_eq!(
+            b.call_hint(&sum, std::slice::from_ref(&floats)),
+            ValueHint::Float
+        );
+        assert_eq!(
+            b.call_hint(&sum, std::slice::from_ref(&ints)),
+            ValueHint::Int
+        );
+        let index = Expr::Index {
+            object: Box::new(floats),
+            index: Box::new(Expr::LitInt(0)),
+        };
+        assert_eq!(b.expr_hint(&index), ValueHint::Float);
+    }
+
     #[test]
     fn builtin_return_hints_match_expected() {
         assert_eq!(builtin_return_hint("print"), ValueHint::Null);
@@ -4,6 +4,7 @@
 //! Result: flat blocks with no params (all values in registers).
 
 use crate::cps::*;
+use crate::pass::dataflow;
 use std::collections::HashMap;
 
 pub fn flatten_module(module: &mut CpsModule) {
@@ -111,82 +112,21 @@ fn inline_block(func: &mut CpsFunction, pred_id: usize, target_id: usize) {
     func.blocks[target_idx].id = usize::MAX;
 }
 
+/// Rewrites the registers `instr` reads through `reg_map`; destinations stay.
 fn remap_instr_regs(instr: &mut CpsInstr, reg_map: &HashMap<usize, usize>) {
-    let lookup = |r: &mut usize| {
+    dataflow::instr_uses_mut(instr, |r| {
         if let Some(&new_r) = reg_map.get(r) {
             *r = new_r;
         }
-    };
-    match instr {
-        CpsInstr::BinOp(_, _, s1, s2) => {
-            lookup(s1);
-            lookup(s2);
-        }
-        CpsInstr::UnOp(_, _, s) => {
-            lookup(s);
-        }
-        CpsInstr::Move(_, s) => {
-            lookup(s);
-        }
-        CpsInstr::GetField(_, s, _) => {
-            lookup(s);
-        }
-        CpsInstr::SetField(_, s, _, v) => {
-            lookup(s);
-            lookup(v);
-        }
-        CpsInstr::IndexGet(_, s, i) => {
-            lookup(s);
-            lookup(i);
-        }
-        CpsInstr::IndexSet(_, s, i, v) => {
-            lookup(s);
-            lookup(i);
-            lookup(v);
-        }
-        CpsInstr::NewList(_, elements) => {
-            for r in elements {
-                lookup(r);
-            }
-        }
-        CpsInstr::ListLen(_, obj) => {
-            lookup(obj);
-        }
-        CpsInstr::Box(_, s) | CpsInstr::Unbox(_, s) | CpsInstr::Print(s) => {
-            lookup(s);
-        }
-        CpsInstr::LoadVtable(_, _) => {
-            // vtable_idx is not a register, no remapping needed
-        }
-        CpsInstr::NewInterfaceObj(_, vr, sr) => {
-            lookup(vr);
-            lookup(sr);
-        }
-        _ => {}
-    }
+    });
 }
 
 fn remap_term_regs(term: &mut CpsTerminator, reg_map: &HashMap<usize, usize>) {
-    match term {
-        CpsTerminator::Return(r) => {
-            if let Some(&new_r) = reg_map.get(r) {
-                *r = new_r;
-            }
-        }
-        CpsTerminator::Branch(r, _, _, _, _) => {
-            if let Some(&new_r) = reg_map.get(r) {
-                *r = new_r;
-            }
-        }
-        CpsTerminator::CallIndirect(_, args, _) => {
-            for r in args {
-                if let Some(&new_r) = reg_map.get(r) {
-                    *r = new_r;
-                }
-            }
+    dataflow::term_regs_mut(term, |r| {
+        if let Some(&new_r) = reg_map.get(r) {
+            *r = new_r;
         }
-        _ => {}
-    }
+    });
 }
 
 // ── tests ──
@@ -1,12 +1,20 @@
 //! Binary serialization — CpsModule ↔ compact bytecode.
 //!
 //! Header: "KAUB" (4) + version u32 (4) = 8 bytes
+//!
+//! Version 3 (written) round-trips a module exactly: operand lists, branch
+//! arguments and stored values are encoded, and a trailer after the
+//! functions carries enums, the symbol map and function owners. Version 1
+//! (still read) dropped all of those. Version 2 is the VM's flat image
+//! (`kaubo_vm::image`), never produced here.
 
 use crate::cps::*;
 use std::io::{Cursor, Read};
 
 const MAGIC: &[u8; 4] = b"KAUB";
-const VERSION: u32 = 1;
+const VERSION: u32 = 3;
+/// The lossy layout written before version 3.
+const VERSION_V1: u32 = 1;
 
 // ── Write helpers ──
 
@@ -28,9 +36,25 @@ fn w_f64(w: &mut Vec<u8>, v: f64) {
 fn w_u8(w: &mut Vec<u8>, v: u8) {
     w.push(v);
 }
+fn w_regs(w: &mut Vec<u8>, regs: &[usize]) {
+    w_u16(w, regs.len() as u16);
+    for &r in regs {
+        w_u16(w, r as u16);
+    }
+}
+fn w_str(w: &mut Vec<u8>, s: &str) {
+    w_u32(w, s.len() as u32);
+    w.extend_from_slice(s.as_bytes());
+}
 
 // ── Read helpers ──
 
+/// Bytes left to read. Counts and lengths come from untrusted input, so
+/// nothing reserves more elements than there are bytes to fill them.
+fn remaining(r: &Cursor<&[u8]>) -> usize {
+    r.get_ref().len().saturating_sub(r.position() as usize)
+}
+
 fn r_u16(r: &mut Cursor<&[u8]>) -> Result<u16, String> {
     let mut b = [0u8; 2];
     r.read_exact(&mut b).map_err(|e| format!("read: {e}"))?;
@@ -61,6 +85,34 @@ fn r_u8(r: &mut Cursor<&[u8]>) -> Result<u8, String> {
     r.read_exact(&mut b).map_err(|e| format!("read: {e}"))?;
     Ok(b[0])
 }
+/// A register list, absent (empty) in version 1 encodings.
+fn r_regs(r: &mut Cursor<&[u8]>, version: u32) -> Result<Vec<usize>, String> {
+    if version == VERSION_V1 {
+        return Ok(vec![]);
+    }
+    let n = r_u16(r)? as usize;
+    let mut regs = Vec::with_capacity(n.min(remaining(r)));
+    for _ in 0..n {
+        regs.push(r_u16(r)? as usize);
+    }
+    Ok(regs)
+}
+/// A single register, 0 in version 1 encodings.
+fn r_reg(r: &mut Cursor<&[u8]>, version: u32) -> Result<usize, String> {
+    if version == VERSION_V1 {
+        return Ok(0);
+    }
+    Ok(r_u16(r)? as usize)
+}
+fn r_str(r: &mut Cursor<&[u8]>, what: &str) -> Result<String, String> {
+    let len = r_u32(r)? as usize;
+    if len > remaining(r) {
+        return Err(format!("{what}: length {len} past end of input"));
+    }
+    let mut b = vec![0u8; len];
+    r.read_exact(&mut b).map_err(|e| format!("{what}: {e}"))?;
+    String::from_utf8(b).map_err(|e| format!("{what} utf8: {e}"))
+}
 
 // ── Public API ──
 
@@ -92,6 +144,8 @@ pub fn encode_module(module: &CpsModule) -> Vec<u8> {
     for f in &module.functions {
         encode_function(&mut w, f);
     }
+
+    encode_trailer(&mut w, module);
     w
 }
 
@@ -106,35 +160,35 @@ pub fn decode_module(bytes: &[u8]) -> Result<CpsModule, String> {
     }
 
     let version = r_u32(&mut r)?;
-    if version != VERSION {
+    if version != VERSION && version != VERSION_V1 {
         return Err(format!("unsupported version {version}"));
     }
 
     let const_count = r_u16(&mut r)? as usize;
-    let mut constants = Vec::with_capacity(const_count);
+    let mut constants = Vec::with_capacity(const_count.min(remaining(&r)));
     for _ in 0..const_count {
         constants.push(decode_constant(&mut r)?);
     }
 
     let struct_count = r_u16(&mut r)? as usize;
-    let mut structs = Vec::with_capacity(struct_count);
+    let mut structs = Vec::with_capacity(struct_count.min(remaining(&r)));
     for _ in 0..struct_count {
         structs.push(decode_struct_def(&mut r)?);
     }
 
     let vtable_count = r_u16(&mut r)? as usize;
-    let mut vtables = Vec::with_capacity(vtable_count);
+    let mut vtables = Vec::with_capacity(vtable_count.min(remaining(&r)));
     for _ in 0..vtable_count {
         vtables.push(decode_vtable_def(&mut r)?);
     }
 
     let func_count = r_u16(&mut r)? as usize;
-    let mut functions = Vec::with_capacity(func_count);
+    let mut functions = Vec::with_capacity(func_count.min(remaining(&r)));
     for _ in 0..func_count {
-        functions.push(decode_function(&mut r)?);
+        functions.push(decode_function(&mut r, version)?);
     }
 
-    Ok(CpsModule {
+    let mut module = CpsModule {
         functions,
         constants,
         structs,
@@ -142,7 +196,95 @@ pub fn decode_module(bytes: &[u8]) -> Result<CpsModule, String> {
         vtables,
         symbol_map: std::collections::HashMap::new(),
         func_owners: vec![],
-    })
+    };
+    if version != VERSION_V1 {
+        decode_trailer(&mut r, &mut module)?;
+    }
+    Ok(module)
+}
+
+// ── Trailer encode/decode ──
+
+fn encode_trailer(w: &mut Vec<u8>, module: &CpsModule) {
+    w_u32(w, module.enums.len() as u32);
+    for e in &module.enums {
+        w_u32(w, e.id as u32);
+        w_str(w, &e.name);
+        w_u32(w, e.variants.len() as u32);
+        for (name, tag, fields) in &e.variants {
+            w_str(w, name);
+            w_u16(w, *tag);
+            w_u32(w, fields.len() as u32);
+            for (fname, fty) in fields {
+                w_str(w, fname);
+                w_str(w, fty);
+            }
+        }
+        w_u32(w, e.variant_type_bitmaps.len() as u32);
+        for &b in &e.variant_type_bitmaps {
+            w_u64(w, b);
+        }
+    }
+
+    // Sorted, so equal modules encode to equal bytes.
+    let mut symbols: Vec<_> = module.symbol_map.iter().collect();
+    symbols.sort();
+    w_u32(w, symbols.len() as u32);
+    for ((path, name), idx) in symbols {
+        w_str(w, path);
+        w_str(w, name);
+        w_u32(w, *idx as u32);
+    }
+
+    w_u32(w, module.func_owners.len() as u32);
+    for owner in &module.func_owners {
+        w_str(w, owner);
+    }
+}
+
+fn decode_trailer(r: &mut Cursor<&[u8]>, module: &mut CpsModule) -> Result<(), String> {
+    let enum_count = r_u32(r)? as usize;
+    for _ in 0..enum_count {
+        let id = r_u32(r)? as usize;
+        let name = r_str(r, "ename")?;
+        let vcount = r_u32(r)? as usize;
+        let mut variants = Vec::with_capacity(vcount.min(remaining(r)));
+        for _ in 0..vcount {
+            let vname = r_str(r, "vname")?;
+            let tag = r_u16(r)?;
+            let fcount = r_u32(r)? as usize;
+            let mut fields = Vec::with_capacity(fcount.min(remaining(r)));
+            for _ in 0..fcount {
+                fields.push((r_str(r, "vfield")?, r_str(r, "vtype")?));
+            }
+            variants.push((vname, tag, fields));
+        }
+        let bcount = r_u32(r)? as usize;
+        let mut variant_type_bitmaps = Vec::with_capacity(bcount.min(remaining(r)));
+        for _ in 0..bcount {
+            variant_type_bitmaps.push(r_u64(r)?);
+        }
+        module.enums.push(EnumDef {
+            id,
+            name,
+            variants,
+            variant_type_bitmaps,
+        });
+    }
+
+    let symbol_count = r_u32(r)? as usize;
+    for _ in 0..symbol_count {
+        let path = r_str(r, "symbol path")?;
+        let name = r_str(r, "symbol name")?;
+        let idx = r_u32(r)? as usize;
+        module.symbol_map.insert((path, name), idx);
+    }
+
+    let owner_count = r_u32(r)? as usize;
+    for _ in 0..owner_count {
+        module.func_owners.push(r_str(r, "owner")?);
+    }
+    Ok(())
 }
 
 // ── Constant encode/decode ──
@@ -214,7 +356,7 @@ fn decode_struct_def(r: &mut Cursor<&[u8]>) -> Result<StructDef, String> {
     let name = String::from_utf8(nb).map_err(|e| format!("sname utf8: {e}"))?;
 
     let fcount = r_u16(r)? as usize;
-    let mut fields = Vec::with_capacity(fcount);
+    let mut fields = Vec::with_capacity(fcount.min(remaining(r)));
     for _ in 0..fcount {
         let flen = r_u16(r)? as usize;
         let mut fb = vec![0u8; flen];
@@ -260,7 +402,7 @@ fn decode_vtable_def(r: &mut Cursor<&[u8]>) -> Result<VtableDef, String> {
     r.read_exact(&mut snb).map_err(|e| format!("sname: {e}"))?;
     let struct_name = String::from_utf8(snb).map_err(|e| format!("sname utf8: {e}"))?;
     let mcount = r_u16(r)? as usize;
-    let mut methods = Vec::with_capacity(mcount);
+    let mut methods = Vec::with_capacity(mcount.min(remaining(r)));
     for _ in 0..mcount {
         let mlen = r_u16(r)? as usize;
         let mut mb = vec![0u8; mlen];
@@ -294,7 +436,7 @@ fn encode_function(w: &mut Vec<u8>, f: &CpsFunction) {
     }
 }
 
-fn decode_function(r: &mut Cursor<&[u8]>) -> Result<CpsFunction, String> {
+fn decode_function(r: &mut Cursor<&[u8]>, version: u32) -> Result<CpsFunction, String> {
     let nlen = r_u16(r)? as usize;
     let mut nb = vec![0u8; nlen];
     r.read_exact(&mut nb).map_err(|e| format!("fname: {e}"))?;
@@ -302,9 +444,9 @@ fn decode_function(r: &mut Cursor<&[u8]>) -> Result<CpsFunction, String> {
     let entry = r_u32(r)? as usize;
     let reg_count = r_u32(r)? as usize;
     let bcount = r_u16(r)? as usize;
-    let mut blocks = Vec::with_capacity(bcount);
+    let mut blocks = Vec::with_capacity(bcount.min(remaining(r)));
     for _ in 0..bcount {
-        blocks.push(decode_block(r)?);
+        blocks.push(decode_block(r, version)?);
     }
     Ok(CpsFunction {
         name,
@@ -329,19 +471,19 @@ fn encode_block(w: &mut Vec<u8>, b: &CpsBlock) {
     encode_term(w, &b.term);
 }
 
-fn decode_block(r: &mut Cursor<&[u8]>) -> Result<CpsBlock, String> {
+fn decode_block(r: &mut Cursor<&[u8]>, version: u32) -> Result<CpsBlock, String> {
     let id = r_u32(r)? as usize;
     let pcount = r_u16(r)? as usize;
-    let mut params = Vec::with_capacity(pcount);
+    let mut params = Vec::with_capacity(pcount.min(remaining(r)));
     for _ in 0..pcount {
         params.push(r_u32(r)? as usize);
     }
     let icount = r_u16(r)? as usize;
-    let mut instrs = Vec::with_capacity(icount);
+    let mut instrs = Vec::with_capacity(icount.min(remaining(r)));
     for _ in 0..icount {
-        instrs.push(decode_instr(r)?);
+        instrs.push(decode_instr(r, version)?);
     }
-    let term = decode_term(r)?;
+    let term = decode_term(r, version)?;
     Ok(CpsBlock {
         id,
         params,
@@ -377,10 +519,11 @@ fn encode_instr(w: &mut Vec<u8>, i: &CpsInstr) {
             w_u16(w, *d as u16);
             w_u16(w, *s as u16);
         }
-        CpsInstr::NewStruct(d, sid, _) => {
+        CpsInstr::NewStruct(d, sid, fields) => {
             w_u8(w, 0x04);
             w_u16(w, *d as u16);
             w_u32(w, *sid as u32);
+            w_regs(w, fields);
         }
         CpsInstr::GetField(d, o, idx) => {
             w_u8(w, 0x05);
@@ -388,27 +531,32 @@ fn encode_instr(w: &mut Vec<u8>, i: &CpsInstr) {
             w_u16(w, *o as u16);
             w_u16(w, *idx);
         }
-        CpsInstr::SetField(d, o, idx, _) => {
+        CpsInstr::SetField(d, o, idx, v) => {
             w_u8(w, 0x06);
             w_u16(w, *d as u16);
             w_u16(w, *o as u16);
             w_u16(w, *idx);
+            w_u16(w, *v as u16);
         }
-        CpsInstr::NewList(d, _) => {
+        CpsInstr::NewList(d, elems) => {
             w_u8(w, 0x07);
             w_u16(w, *d as u16);
+            w_regs(w, elems);
         }
-        CpsInstr::NewTuple(d, _) => {
+        CpsInstr::NewTuple(d, elems) => {
             w_u8(w, 0x1C);
             w_u16(w, *d as u16);
+            w_regs(w, elems);
         }
-        CpsInstr::NewInt64Array(d, _) => {
+        CpsInstr::NewInt64Array(d, elems) => {
             w_u8(w, 0x1E);
             w_u16(w, *d as u16);
+            w_regs(w, elems);
         }
-        CpsInstr::NewFloat64Array(d, _) => {
+        CpsInstr::NewFloat64Array(d, elems) => {
             w_u8(w, 0x1F);
             w_u16(w, *d as u16);
+            w_regs(w, elems);
         }
         CpsInstr::TupleIndex(d, t, idx) => {
             w_u8(w, 0x1D);
@@ -448,22 +596,24 @@ fn encode_instr(w: &mut Vec<u8>, i: &CpsInstr) {
             w_u8(w, 0x0C);
             w_u16(w, *r as u16);
         }
-        CpsInstr::NewVariant(d, eid, tag, _) => {
+        CpsInstr::NewVariant(d, eid, tag, fields) => {
             w_u8(w, 0x0E);
             w_u16(w, *d as u16);
-            w_u16(w, *eid as u16);
+            w_u32(w, *eid as u32);
             w_u16(w, *tag);
+            w_regs(w, fields);
         }
         CpsInstr::GetVariantTag(d, o) => {
             w_u8(w, 0x0F);
             w_u16(w, *d as u16);
             w_u16(w, *o as u16);
         }
-        CpsInstr::SetVariantField(d, o, fi, _) => {
+        CpsInstr::SetVariantField(d, o, fi, v) => {
             w_u8(w, 0x11);
             w_u16(w, *d as u16);
             w_u16(w, *o as u16);
             w_u16(w, *fi);
+            w_u16(w, *v as u16);
         }
         CpsInstr::GetVariantField(d, o, fi) => {
             w_u8(w, 0x10);
@@ -493,7 +643,7 @@ fn encode_instr(w: &mut Vec<u8>, i: &CpsInstr) {
     }
 }
 
-fn decode_instr(r: &mut Cursor<&[u8]>) -> Result<CpsInstr, String> {
+fn decode_instr(r: &mut Cursor<&[u8]>, version: u32) -> Result<CpsInstr, String> {
     let tag = r_u8(r)?;
     Ok(match tag {
         0x00 => CpsInstr::BinOp(
@@ -509,13 +659,18 @@ fn decode_instr(r: &mut Cursor<&[u8]>) -> Result<CpsInstr, String> {
         ),
         0x02 => CpsInstr::LoadConst(r_u16(r)? as usize, r_u32(r)? as usize),
         0x03 => CpsInstr::Move(r_u16(r)? as usize, r_u16(r)? as usize),
-        0x04 => CpsInstr::NewStruct(r_u16(r)? as usize, r_u32(r)? as usize, vec![]),
+        0x04 => CpsInstr::NewStruct(r_u16(r)? as usize, r_u32(r)? as usize, r_regs(r, version)?),
         0x05 => CpsInstr::GetField(r_u16(r)? as usize, r_u16(r)? as usize, r_u16(r)?),
-        0x06 => CpsInstr::SetField(r_u16(r)? as usize, r_u16(r)? as usize, r_u16(r)?, 0),
-        0x07 => CpsInstr::NewList(r_u16(r)? as usize, vec![]),
-        0x1C => CpsInstr::NewTuple(r_u16(r)? as usize, vec![]),
-        0x1E => CpsInstr::NewInt64Array(r_u16(r)? as usize, vec![]),
-        0x1F => CpsInstr::NewFloat64Array(r_u16(r)? as usize, vec![]),
+        0x06 => CpsInstr::SetField(
+            r_u16(r)? as usize,
+            r_u16(r)? as usize,
+            r_u16(r)?,
+            r_reg(r, version)?,
+        ),
+        0x07 => CpsInstr::NewList(r_u16(r)? as usize, r_regs(r, version)?),
+        0x1C => CpsInstr::NewTuple(r_u16(r)? as usize, r_regs(r, version)?),
+        0x1E => CpsInstr::NewInt64Array(r_u16(r)? as usize, r_regs(r, version)?),
+        0x1F => CpsInstr::NewFloat64Array(r_u16(r)? as usize, r_regs(r, version)?),
         0x1D => CpsInstr::TupleIndex(r_u16(r)? as usize, r_u16(r)? as usize, r_u16(r)?),
         0x1A => CpsInstr::ListLen(r_u16(r)? as usize, r_u16(r)? as usize),
         0x08 => CpsInstr::IndexGet(r_u16(r)? as usize, r_u16(r)? as usize, r_u16(r)? as usize),
@@ -527,9 +682,19 @@ fn decode_instr(r: &mut Cursor<&[u8]>) -> Result<CpsInstr, String> {
         ),
         0x0A => CpsInstr::Box(r_u16(r)? as usize, r_u16(r)? as usize),
         0x0B => CpsInstr::Unbox(r_u16(r)? as usize, r_u16(r)? as usize),
-        0x0E => CpsInstr::NewVariant(r_u16(r)? as usize, r_u32(r)? as usize, r_u16(r)?, vec![]),
+        0x0E => CpsInstr::NewVariant(
+            r_u16(r)? as usize,
+            r_u32(r)? as usize,
+            r_u16(r)?,
+            r_regs(r, version)?,
+        ),
         0x0F => CpsInstr::GetVariantTag(r_u16(r)? as usize, r_u16(r)? as usize),
-        0x11 => CpsInstr::SetVariantField(r_u16(r)? as usize, r_u16(r)? as usize, r_u16(r)?, 0),
+        0x11 => CpsInstr::SetVariantField(
+            r_u16(r)? as usize,
+            r_u16(r)? as usize,
+            r_u16(r)?,
+            r_reg(r, version)?,
+        ),
         0x10 => CpsInstr::GetVariantField(r_u16(r)? as usize, r_u16(r)? as usize, r_u16(r)?),
         0x0C => CpsInstr::Print(r_u16(r)? as usize),
         0x0D => CpsInstr::Nop,
@@ -552,11 +717,13 @@ fn encode_term(w: &mut Vec<u8>, t: &CpsTerminator) {
                 w_u16(w, *a as u16);
             }
         }
-        CpsTerminator::Branch(c, tb, _, fb, _) => {
+        CpsTerminator::Branch(c, tb, targs, fb, fargs) => {
             w_u8(w, 0x11);
             w_u16(w, *c as u16);
             w_u32(w, *tb as u32);
             w_u32(w, *fb as u32);
+            w_regs(w, targs);
+            w_regs(w, fargs);
         }
         CpsTerminator::Return(r) => {
             w_u8(w, 0x12);
@@ -635,7 +802,7 @@ fn encode_term(w: &mut Vec<u8>, t: &CpsTerminator) {
     }
 }
 
-fn decode_term(r: &mut Cursor<&[u8]>) -> Result<CpsTerminator, String> {
+fn decode_term(r: &mut Cursor<&[u8]>, version: u32) -> Result<CpsTerminator, String> {
     let tag = r_u8(r)?;
     Ok(match tag {
         0x10 => {
@@ -651,7 +818,9 @@ fn decode_term(r: &mut Cursor<&[u8]>) -> Result<CpsTerminator, String> {
             let c = r_u16(r)? as usize;
             let tb = r_u32(r)? as usize;
             let fb = r_u32(r)? as usize;
-            CpsTerminator::Branch(c, tb, vec![], fb, vec![])
+            let targs = r_regs(r, version)?;
+            let fargs = r_regs(r, version)?;
+            CpsTerminator::Branch(c, tb, targs, fb, fargs)
         }
         0x12 => CpsTerminator::Return(r_u16(r)? as usize),
         0x13 => {
@@ -808,6 +977,11 @@ fn unop_to_u8(op: CpsUnOp) -> u8 {
         CpsUnOp::NegInt => 0,
         CpsUnOp::FNeg => 1,
         CpsUnOp::Not => 2,
+        CpsUnOp::FSqrt => 3,
+        CpsUnOp::FSin => 4,
+        CpsUnOp::FCos => 5,
+        CpsUnOp::FFloor => 6,
+        CpsUnOp::FCeil => 7,
     }
 }
 fn u8_to_unop(v: u8) -> Result<CpsUnOp, String> {
@@ -815,6 +989,11 @@ fn u8_to_unop(v: u8) -> Result<CpsUnOp, String> {
         0 => CpsUnOp::NegInt,
         1 => CpsUnOp::FNeg,
         2 => CpsUnOp::Not,
+        3 => CpsUnOp::FSqrt,
+        4 => CpsUnOp::FSin,
+        5 => CpsUnOp::FCos,
+        6 => CpsUnOp::FFloor,
+        7 => CpsUnOp::FCeil,
         _ => return Err(format!("bad unop tag {v}")),
     })
 }
@@ -951,6 +1130,11 @@ mod tests {
             CpsInstr::UnOp(28, CpsUnOp::NegInt, 0),
             CpsInstr::UnOp(29, CpsUnOp::FNeg, 0),
             CpsInstr::UnOp(30, CpsUnOp::Not, 0),
+            CpsInstr::UnOp(28, CpsUnOp::FSqrt, 1),
+            CpsInstr::UnOp(28, CpsUnOp::FSin, 1),
+            CpsInstr::UnOp(28, CpsUnOp::FCos, 1),
+            CpsInstr::UnOp(28, CpsUnOp::FFloor, 1),
+            CpsInstr::UnOp(28, CpsUnOp::FCeil, 1),
             CpsInstr::LoadConst(31, 0),
             CpsInstr::Move(32, 31),
             CpsInstr::NewStruct(33, 0, vec![0, 1]),
@@ -1064,7 +1248,11 @@ mod tests {
         assert_eq!(decoded.functions.len(), 2);
         assert_eq!(decoded.functions[0].blocks.len(), 7);
         assert_eq!(decoded.functions[0].blocks[0].params, vec![0, 1]);
-        assert_eq!(decoded.functions[0].blocks[0].instrs.len(), 43);
+        assert_eq!(decoded.functions[0].blocks[0].instrs.len(), 48);
+        assert!(decoded.functions[0].blocks[0]
+            .instrs
+            .iter()
+            .any(|instr| matches!(instr, CpsInstr::UnOp(_, CpsUnOp::FCeil, _))));
         assert!(matches!(
             decoded.functions[0].blocks[0].instrs[0],
             CpsInstr::BinOp(_, CpsBinOp::AddInt, _, _)
@@ -1123,4 +1311,142 @@ mod tests {
         assert!(u8_to_binop(0xFF).unwrap_err().contains("bad binop tag"));
         assert!(u8_to_unop(0xFF).unwrap_err().contains("bad unop tag"));
     }
+
+    #[test]
+    fn trailer_round_trips_enums_symbols_and_owners() {
+        let mut module = roundtrip("const x = 42;");
+        module.enums.push(EnumDef {
+            id: 3,
+            name: "Shape".into(),
+            variants: vec![
+                ("Circle".into(), 0, vec![("r".into(), "Float64".into())]),
+                ("Dot".into(), 1, vec![]),
+            ],
+            variant_type_bitmaps: vec![1, 0],
+        });
+        module.symbol_map.insert(("b.kb".into(), "f".into()), 0);
+        module.symbol_map.insert(("a.kb".into(), "g".into()), 1);
+        module.func_owners = vec!["a.kb".into()];
+
+        let bytes = encode_module(&module);
+        let decoded = decode_module(&bytes).unwrap();
+        assert_eq!(decoded.enums.len(), 1);
+        assert_eq!(decoded.enums[0].name, "Shape");
+        assert_eq!(decoded.enums[0].variants, module.enums[0].variants);
+        assert_eq!(decoded.enums[0].variant_type_bitmaps, vec![1, 0]);
+        assert_eq!(decoded.symbol_map, module.symbol_map);
+        assert_eq!(decoded.func_owners, module.func_owners);
+        assert_eq!(encode_module(&decoded), bytes, "encoding is deterministic");
+
+        let mut truncated = bytes.clone();
+        truncated.pop();
+        assert!(
+            decode_module(&truncated).is_err(),
+            "the trailer is required in version 3"
+        );
+    }
+
+    /// Lengths and counts are untrusted: a huge one must fail on the missing
+    /// bytes, not reserve memory for them first.
+    #[test]
+    fn huge_lengths_fail_without_allocating() {
+        let bytes = encode_module(&roundtrip("const x = 42;"));
+        // the empty trailer is three zero counts
+        let head = &bytes[..bytes.len() - 12];
+        let with_trailer = |trailer: &[u32]| {
+            let mut b = head.to_vec();
+            for &n in trailer {
+                b.extend_from_slice(&n.to_le_bytes());
+            }
+            decode_module(&b)
+        };
+        assert!(with_trailer(&[0, 0, 0]).is_ok());
+        let err = with_trailer(&[1, 0, u32::MAX]).unwrap_err();
+        assert!(err.contains("past end of input"), "{err}");
+        assert!(with_trailer(&[1, 0, 0, u32::MAX]).is_err());
+        assert!(with_trailer(&[u32::MAX]).is_err());
+
+        for len in 0..bytes.len() {
+            assert!(decode_module(&bytes[..len]).is_err(), "truncated at {len}");
+        }
+    }
+
+    /// Everything the version 1 layout dropped or truncated must survive a
+    /// round trip: operand lists (struct / list / variant / call arguments),
+    /// block arguments on `Jump` and both `Branch` edges, the stored value of
+    /// `SetField` / `SetVariantField` / `IndexSet`, and enum ids wider than a
+    /// byte in `NewVariant`.
+    #[test]
+    fn operands_dropped_by_version_1_round_trip() {
+        let block = |id, instrs, term| CpsBlock {
+            id,
+            params: vec![0, 1],
+            instrs,
+            term,
+        };
+        let module = CpsModule {
+            functions: vec![CpsFunction {
+                name: "f".into(),
+                blocks: vec![
+                    block(
+                        0,
+                        vec![
+                            CpsInstr::NewStruct(2, 0, vec![0, 1]),
+                            CpsInstr::SetField(3, 2, 1, 0),
+                            CpsInstr::NewList(4, vec![0, 1, 3]),
+                            CpsInstr::IndexSet(5, 4, 0, 1),
+                            CpsInstr::NewVariant(6, 300, 1, vec![0]),
+                            CpsInstr::SetVariantField(7, 6, 0, 1),
+                            CpsInstr::NewTuple(8, vec![1, 0]),
+                        ],
+                        CpsTerminator::Branch(0, 1, vec![3, 4], 2, vec![5, 6]),
+                    ),
+                    block(1, vec![], CpsTerminator::Jump(2, vec![7, 8])),
+                    block(2, vec![], CpsTerminator::Call(0, vec![1, 2], 3)),
+                    block(3, vec![], CpsTerminator::Return(0)),
+                ],
+                entry: 0,
+                reg_count: 9,
+            }],
+            constants: vec![],
+            structs: vec![],
+            enums: vec![],
+            vtables: vec![],
+            symbol_map: std::collections::HashMap::new(),
+            func_owners: vec![],
+        };
+        let decoded = decode_module(&encode_module(&module)).unwrap();
+        assert_eq!(
+            format!("{:?}", decoded.functions),
+            format!("{:?}", module.functions)
+        );
+    }
+
+    #[test]
+    fn version_1_encodings_still_decode() {
+        let mut v1 = Vec::new();
+        v1.extend_from_slice(b"KAUB");
+        v1.extend_from_slice(&1u32.to_le_bytes());
+        v1.extend_from_slice(&[0, 0, 0, 0, 0, 0]); // no constants, structs, vtables
+        v1.extend_from_slice(&1u16.to_le_bytes()); // one function "f"
+        v1.extend_from_slice(&1u16.to_le_bytes());
+        v1.push(b'f');
+        v1.extend_from_slice(&0u32.to_le_bytes()); // entry
+        v1.extend_from_slice(&2u32.to_le_bytes()); // reg_count
+        v1.extend_from_slice(&1u16.to_le_bytes()); // one block
+        v1.extend_from_slice(&0u32.to_le_bytes()); // id
+        v1.extend_from_slice(&0u16.to_le_bytes()); // params
+        v1.extend_from_slice(&1u16.to_le_bytes()); // NewList(1, _) without elements
+        v1.push(0x07);
+        v1.extend_from_slice(&1u16.to_le_bytes());
+        v1.push(0x12); // Return(1)
+        v1.extend_from_slice(&1u16.to_le_bytes());
+
+        let module = decode_module(&v1).unwrap();
+        assert_eq!(module.functions[0].name, "f");
+        assert!(
+            matches!(&module.functions[0].blocks[0].instrs[0], CpsInstr::NewList(1, e) if e.is_empty())
+        );
+        assert!(module.enums.is_empty());
+    }
 }
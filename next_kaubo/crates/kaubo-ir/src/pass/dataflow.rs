@@ -0,0 +1,368 @@
+//! Dataflow shared by passes: register operands, the block graph and liveness.
+//!
+//! Registers are plain mutable slots.  Every register field an instruction
+//! carries counts as a use (including the dummy `0` operands some encodings
+//! leave in place), and block params are not killed on entry, so liveness is
+//! a superset of the truth: passes may rely on "dead" but not on "live".
+
+use crate::cps::*;
+use std::collections::HashMap;
+
+/// Register operands are 8 bits wide in the VM encoding.
+pub(crate) const MAX_REGS: usize = 256;
+
+/// Successors / predecessors over block *positions* in `func.blocks`.
+pub(crate) struct Graph {
+    /// Block id at each position (`usize::MAX` for dead blocks).
+    pub ids: Vec<usize>,
+    /// Position of the entry block.
+    pub entry: usize,
+    pub succs: Vec<Vec<usize>>,
+    pub preds: Vec<Vec<usize>>,
+    /// Blocks reachable from the entry, in postorder.
+    pub post: Vec<usize>,
+    pub reachable: Vec<bool>,
+}
+
+impl Graph {
+    pub(crate) fn build(func: &CpsFunction) -> Graph {
+        let n = func.blocks.len();
+        let ids: Vec<usize> = func.blocks.iter().map(|b| b.id).collect();
+        let pos: HashMap<usize, usize> = ids
+            .iter()
+            .enumerate()
+            .filter(|(_, &id)| id != usize::MAX)
+            .map(|(p, &id)| (id, p))
+            .collect();
+        let mut succs = vec![vec![]; n];
+        let mut preds = vec![vec![]; n];
+        for (p, block) in func.blocks.iter().enumerate() {
+            if block.id == usize::MAX {
+                continue;
+            }
+            for id in targets(&block.term) {
+                if let Some(&s) = pos.get(&id) {
+                    if !succs[p].contains(&s) {
+                        succs[p].push(s);
+                        preds[s].push(p);
+                    }
+                }
+            }
+        }
+        let entry = pos.get(&func.entry).copied().unwrap_or(0);
+
+        // Iterative DFS from the entry.
+        let mut reachable = vec![false; n];
+        let mut post = vec![];
+        let mut stack = vec![];
+        if n > 0 {
+            reachable[entry] = true;
+            stack.push((entry, 0));
+        }
+        while let Some((b, next)) = stack.last_mut() {
+            if let Some(&s) = succs[*b].get(*next) {
+                *next += 1;
+                if !reachable[s] {
+                    reachable[s] = true;
+                    stack.push((s, 0));
+                }
+            } else {
+                post.push(*b);
+                stack.pop();
+            }
+        }
+        Graph {
+            ids,
+            entry,
+            succs,
+            preds,
+            post,
+            reachable,
+        }
+    }
+}
+
+/// Block-level live sets, indexed by position.
+pub(crate) struct Liveness {
+    pub live_in: Vec<RegSet>,
+    pub live_out: Vec<RegSet>,
+}
+
+impl Liveness {
+    pub(crate) fn compute(func: &CpsFunction, graph: &Graph) -> Liveness {
+        let (n, post, succs) = (graph.ids.len(), &graph.post, &graph.succs);
+        let regs = max_reg(func) + 1;
+        let mut live_in = vec![RegSet::new(regs); n];
+        let mut live_out = vec![RegSet::new(regs); n];
+        let mut changed = true;
+        while changed {
+            changed = false;
+            for &b in post {
+                let mut out = RegSet::new(regs);
+                for &s in &succs[b] {
+                    out.union(&live_in[s]);
+                }
+                let inn = live_before(&func.blocks[b], 0, &out);
+                if inn != live_in[b] {
+                    live_in[b] = inn;
+                    changed = true;
+                }
+                live_out[b] = out;
+            }
+        }
+        Liveness { live_in, live_out }
+    }
+
+    /// Registers live right after instruction `at` of block `p`.
+    pub(crate) fn live_after(&self, func: &CpsFunction, p: usize, at: usize) -> RegSet {
+        live_before(&func.blocks[p], at + 1, &self.live_out[p])
+    }
+}
+
+/// Registers live before instruction `from` of `block`, given what is live out.
+/// Uses are over-approximated (dummy operands count), so the result is a
+/// superset of the true live set.
+pub(crate) fn live_before(block: &CpsBlock, from: usize, out: &RegSet) -> RegSet {
+    let mut live = out.clone();
+    let mut uses = vec![];
+    term_uses(&block.term, &mut uses);
+    for instr in block.instrs[from..].iter().rev() {
+        uses.iter().for_each(|&r| live.insert(r));
+        uses.clear();
+        if let Some(d) = def_of(instr) {
+            live.remove(d);
+        }
+        instr_uses(instr, &mut uses);
+    }
+    uses.iter().for_each(|&r| live.insert(r));
+    live
+}
+
+#[derive(Clone, PartialEq, Eq)]
+pub(crate) struct RegSet(Vec<u64>);
+
+impl RegSet {
+    pub(crate) fn new(regs: usize) -> Self {
+        RegSet(vec![0; regs.div_ceil(64)])
+    }
+    pub(crate) fn insert(&mut self, r: usize) {
+        self.0[r / 64] |= 1 << (r % 64);
+    }
+    pub(crate) fn remove(&mut self, r: usize) {
+        self.0[r / 64] &= !(1 << (r % 64));
+    }
+    pub(crate) fn contains(&self, r: usize) -> bool {
+        self.0.get(r / 64).is_some_and(|w| w & (1 << (r % 64)) != 0)
+    }
+    pub(crate) fn union(&mut self, other: &RegSet) {
+        for (a, b) in self.0.iter_mut().zip(&other.0) {
+            *a |= b;
+        }
+    }
+    pub(crate) fn iter(&self) -> impl Iterator<Item = usize> + '_ {
+        self.0.iter().enumerate().flat_map(|(w, &bits)| {
+            (0..64)
+                .filter(move |b| bits & (1 << b) != 0)
+                .map(move |b| w * 64 + b)
+        })
+    }
+}
+
+// ── Instruction operands ──
+
+pub(crate) fn def_of(instr: &CpsInstr) -> Option<usize> {
+    use CpsInstr::*;
+    match *instr {
+        BinOp(d, ..)
+        | UnOp(d, ..)
+        | LoadConst(d, _)
+        | Move(d, _)
+        | NewStruct(d, ..)
+        | GetField(d, ..)
+        | NewVariant(d, ..)
+        | GetVariantTag(d, _)
+        | GetVariantField(d, ..)
+        | NewList(d, _)
+        | ListLen(d, _)
+        | IndexGet(d, ..)
+        | NewTuple(d, _)
+        | TupleIndex(d, ..)
+        | NewInt64Array(d, _)
+        | NewFloat64Array(d, _)
+        | Box(d, _)
+        | Unbox(d, _)
+        | LoadVtable(d, _)
+        | NewInterfaceObj(d, ..)
+        | LoadExternalConst(d, _) => Some(d),
+        SetField(..) | SetVariantField(..) | IndexSet(..) | Print(_) | Nop => None,
+    }
+}
+
+pub(crate) fn instr_uses(instr: &CpsInstr, out: &mut Vec<usize>) {
+    use CpsInstr::*;
+    match instr {
+        BinOp(_, _, a, b) | IndexGet(_, a, b) | NewInterfaceObj(_, a, b) => out.extend([*a, *b]),
+        UnOp(_, _, a)
+        | Move(_, a)
+        | GetField(_, a, _)
+        | GetVariantTag(_, a)
+        | GetVariantField(_, a, _)
+        | ListLen(_, a)
+        | TupleIndex(_, a, _)
+        | Box(_, a)
+        | Unbox(_, a)
+        | Print(a) => out.push(*a),
+        SetField(v, o, _, x) | SetVariantField(v, o, _, x) => out.extend([*v, *o, *x]),
+        IndexSet(v, o, i, x) => out.extend([*v, *o, *i, *x]),
+        NewStruct(_, _, regs)
+        | NewVariant(_, _, _, regs)
+        | NewList(_, regs)
+        | NewTuple(_, regs)
+        | NewInt64Array(_, regs)
+        | NewFloat64Array(_, regs) => out.extend(regs),
+        LoadConst(..) | LoadVtable(..) | LoadExternalConst(..) | Nop => {}
+    }
+}
+
+/// Registers the VM actually reads for `instr`.
+///
+/// Narrower than `instr_uses`: conversions leave a dummy second operand,
+/// the trailing field of `SetField` / `SetVariantField` / `IndexSet` is never
+/// encoded, struct and variant constructors take no operands (fields are set
+/// afterwards), and list / tuple / array constructors read their elements
+/// from the current block's params rather than the list they carry.
+pub(crate) fn vm_uses(instr: &CpsInstr, params: &[usize], out: &mut Vec<usize>) {
+    use CpsBinOp::*;
+    use CpsInstr::*;
+    match *instr {
+        BinOp(_, IToF | FToI | IToS | FToS | SToI | BToS, a, _) => out.push(a),
+        SetField(v, o, ..) | SetVariantField(v, o, ..) => out.extend([v, o]),
+        IndexSet(v, o, i, _) => out.extend([v, o, i]),
+        NewStruct(..) | NewVariant(..) => {}
+        NewList(..) | NewTuple(..) | NewInt64Array(..) | NewFloat64Array(..) => out.extend(params),
+        _ => instr_uses(instr, out),
+    }
+}
+
+pub(crate) fn term_uses(term: &CpsTerminator, out: &mut Vec<usize>) {
+    match term {
+        CpsTerminator::Jump(_, args)
+        | CpsTerminator::Call(_, args, _)
+        | CpsTerminator::TailCall(_, args)
+        | CpsTerminator::CallNative(_, args, _)
+        | CpsTerminator::CallIndirect(_, args, _)
+        | CpsTerminator::CallExternal { args, .. }
+        | CpsTerminator::CallExternalDynamic { args, .. } => out.extend(args),
+        CpsTerminator::Branch(cond, _, t, _, f) => {
+            out.push(*cond);
+            out.extend(t);
+            out.extend(f);
+        }
+        CpsTerminator::Return(r) => out.push(*r),
+        CpsTerminator::Suspend => {}
+    }
+}
+
+/// Applies `f` to every register field of `instr`, the destination first.
+pub(crate) fn instr_regs_mut(instr: &mut CpsInstr, mut f: impl FnMut(&mut usize)) {
+    use CpsInstr::*;
+    match instr {
+        BinOp(d, _, a, b) | IndexGet(d, a, b) | NewInterfaceObj(d, a, b) => {
+            [d, a, b].into_iter().for_each(f)
+        }
+        UnOp(d, _, a)
+        | Move(d, a)
+        | GetField(d, a, _)
+        | GetVariantTag(d, a)
+        | GetVariantField(d, a, _)
+        | ListLen(d, a)
+        | TupleIndex(d, a, _)
+        | Box(d, a)
+        | Unbox(d, a) => [d, a].into_iter().for_each(f),
+        SetField(v, o, _, x) | SetVariantField(v, o, _, x) => [v, o, x].into_iter().for_each(f),
+        IndexSet(v, o, i, x) => [v, o, i, x].into_iter().for_each(f),
+        NewStruct(d, _, regs)
+        | NewVariant(d, _, _, regs)
+        | NewList(d, regs)
+        | NewTuple(d, regs)
+        | NewInt64Array(d, regs)
+        | NewFloat64Array(d, regs) => {
+            f(d);
+            regs.iter_mut().for_each(f);
+        }
+        LoadConst(d, _) | LoadVtable(d, _) | LoadExternalConst(d, _) => f(d),
+        Print(r) => f(r),
+        Nop => {}
+    }
+}
+
+/// Applies `f` to every register field of `term`.
+pub(crate) fn term_regs_mut(term: &mut CpsTerminator, mut f: impl FnMut(&mut usize)) {
+    match term {
+        CpsTerminator::Jump(_, args)
+        | CpsTerminator::Call(_, args, _)
+        | CpsTerminator::TailCall(_, args)
+        | CpsTerminator::CallNative(_, args, _)
+        | CpsTerminator::CallIndirect(_, args, _)
+        | CpsTerminator::CallExternal { args, .. }
+        | CpsTerminator::CallExternalDynamic { args, .. } => args.iter_mut().for_each(f),
+        CpsTerminator::Branch(cond, _, t, _, e) => {
+            f(cond);
+            t.iter_mut().chain(e.iter_mut()).for_each(f);
+        }
+        CpsTerminator::Return(r) => f(r),
+        CpsTerminator::Suspend => {}
+    }
+}
+
+/// Applies `f` to the registers `instr` reads, leaving its destination alone.
+pub(crate) fn instr_uses_mut(instr: &mut CpsInstr, mut f: impl FnMut(&mut usize)) {
+    let mut skip = def_of(instr).is_some();
+    instr_regs_mut(instr, |r| {
+        if skip {
+            skip = false;
+        } else {
+            f(r)
+        }
+    });
+}
+
+/// Successor block ids.  The VM runs `TailCall` as a jump to block 0.
+pub(crate) fn targets(term: &CpsTerminator) -> Vec<usize> {
+    match term {
+        CpsTerminator::Jump(b, _)
+        | CpsTerminator::Call(_, _, b)
+        | CpsTerminator::CallNative(_, _, b)
+        | CpsTerminator::CallIndirect(_, _, b)
+        | CpsTerminator::CallExternal { ret_block: b, .. }
+        | CpsTerminator::CallExternalDynamic { ret_block: b, .. } => vec![*b],
+        CpsTerminator::Branch(_, t, _, f, _) => vec![*t, *f],
+        CpsTerminator::TailCall(..) => vec![0],
+        CpsTerminator::Return(_) | CpsTerminator::Suspend => vec![],
+    }
+}
+
+/// Terminators that write the call result into `r0`.
+pub(crate) fn is_call(term: &CpsTerminator) -> bool {
+    matches!(
+        term,
+        CpsTerminator::Call(..)
+            | CpsTerminator::CallNative(..)
+            | CpsTerminator::CallIndirect(..)
+            | CpsTerminator::CallExternal { .. }
+            | CpsTerminator::CallExternalDynamic { .. }
+    )
+}
+
+pub(crate) fn max_reg(func: &CpsFunction) -> usize {
+    let mut regs = vec![];
+    for block in func.blocks.iter().filter(|b| b.id != usize::MAX) {
+        regs.extend(&block.params);
+        for instr in &block.instrs {
+            regs.extend(def_of(instr));
+            instr_uses(instr, &mut regs);
+        }
+        term_uses(&block.term, &mut regs);
+    }
+    regs.into_iter().max().unwrap_or(0).max(func.reg_count)
+}
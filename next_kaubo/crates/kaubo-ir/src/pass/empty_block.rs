@@ -1,19 +1,17 @@
 //! Empty block elimination — remove blocks that are just `Jump(target, [])` passthroughs.
 
-use super::Pass;
+use super::{FunctionCtx, FunctionPass};
 use crate::cps::*;
 use std::collections::{HashMap, HashSet};
 
 pub struct EmptyBlockElim;
 
-impl Pass for EmptyBlockElim {
+impl FunctionPass for EmptyBlockElim {
     fn name(&self) -> &'static str {
         "empty-block-elim"
     }
-    fn run(&self, module: &mut CpsModule) {
-        for func in &mut module.functions {
-            eliminate(func);
-        }
+    fn run_function(&self, func: &mut CpsFunction, _: &mut FunctionCtx<'_>) {
+        eliminate(func);
     }
 }
 
@@ -102,6 +100,7 @@ mod tests {
     use super::*;
     use crate::cps_build::build_module;
     use crate::flatten::flatten_module;
+    use crate::pass::Pass;
     use crate::test_fixtures;
 
     fn optimize(src: &str) -> CpsModule {
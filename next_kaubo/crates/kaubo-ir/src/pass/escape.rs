@@ -0,0 +1,691 @@
+//! Escape analysis and scalar replacement of structs, tuples and boxes.
+//!
+//! `NewStruct`, `NewTuple` and `Box` always allocate on the VM heap, and every
+//! `GetField` / `TupleIndex` / `Unbox` then goes through the handle.  When the
+//! handle never leaves the function, the object can live in registers
+//! instead: one fresh register per field, accesses become `Move`s and the
+//! allocation becomes the field initialisation.
+//!
+//! An allocation `d = New…` does not escape when:
+//!   - it is the only definition of `d`;
+//!   - its aliases, registers whose every definition is a `Move` from `d` or
+//!     another alias, are only ever read as the object operand of a field
+//!     access, or as the source of such a `Move`.  Any other read (a call or
+//!     jump argument, `Return`, `Print`, a stored field value, comparison)
+//!     lets the handle out;
+//!   - no alias is live where the allocation runs, or on entry.  So at every
+//!     read, the live aliases all hold the same object: the one the last run
+//!     of the allocation made, even when that allocation sits in a loop.
+//!
+//! Reads are counted the way the VM performs them (`vm_uses`): the dummy
+//! operands in `IToS` and the unencoded trailing `SetField` field are not reads.
+//! Without that, `r0` could never be an alias, and after `Inline` a returned
+//! tuple reaches its caller through `r0`.
+//!
+//! Struct fields start out as the VM's `NewStruct` leaves them (`-1` for heap
+//! fields, `0` otherwise) unless the allocating block writes them first.
+//! Accesses the VM would reject (wrong kind, field index out of range) keep
+//! the allocation, and so does a tuple with fewer block params than elements.
+
+use super::dataflow::*;
+use super::{FunctionCtx, FunctionPass};
+use crate::cps::*;
+use std::collections::HashMap;
+
+pub struct ScalarReplace;
+
+impl FunctionPass for ScalarReplace {
+    fn name(&self) -> &'static str {
+        "scalar-replace"
+    }
+    fn run_function(&self, func: &mut CpsFunction, ctx: &mut FunctionCtx<'_>) {
+        scalar_replace(func, ctx);
+    }
+}
+
+/// Replaces every non-escaping aggregate in `func` with registers; returns
+/// how many allocations were removed.
+pub fn scalar_replace(func: &mut CpsFunction, ctx: &mut FunctionCtx<'_>) -> usize {
+    if func.blocks.is_empty()
+        || func
+            .blocks
+            .iter()
+            .any(|b| matches!(b.term, CpsTerminator::Suspend))
+    {
+        return 0;
+    }
+    // Rewrites shift instruction positions but keep the blocks, so the graph
+    // stays valid; rescan after every replacement.
+    let graph = Graph::build(func);
+    let mut removed = 0;
+    'scan: loop {
+        for &b in graph.post.iter().rev() {
+            for i in 0..func.blocks[b].instrs.len() {
+                let Some(object) = Object::at(func, ctx.structs, b, i) else {
+                    continue;
+                };
+                let Some(aliases) = aliases_if_local(func, &graph, &object) else {
+                    continue;
+                };
+                if replace(func, &object, &aliases, ctx) {
+                    removed += 1;
+                    continue 'scan;
+                }
+            }
+        }
+        return removed;
+    }
+}
+
+#[derive(Clone, Copy, PartialEq)]
+enum Kind {
+    Struct,
+    Tuple,
+    Box,
+}
+
+/// An allocation site and the shape of what it allocates.
+struct Object {
+    block: usize,
+    at: usize,
+    reg: usize,
+    kind: Kind,
+    /// Initial field values the allocation produces.
+    init: Vec<Init>,
+}
+
+enum Init {
+    /// A constant, as `NewStruct` zero-fills (`-1` for heap fields).
+    Int(i64),
+    /// A register read at the allocation.
+    Reg(usize),
+}
+
+impl Object {
+    fn at(func: &CpsFunction, structs: &[StructDef], block: usize, at: usize) -> Option<Object> {
+        let params = &func.blocks[block].params;
+        let (reg, kind, init) = match func.blocks[block].instrs[at] {
+            CpsInstr::NewStruct(d, sid, _) => {
+                let def = structs.iter().find(|s| s.id == sid)?;
+                let init = (0..def.fields.len())
+                    .map(|k| Init::Int(-(((def.type_bitmap >> k) & 1) as i64)))
+                    .collect();
+                (d, Kind::Struct, init)
+            }
+            CpsInstr::NewTuple(d, ref elements) if elements.len() <= params.len() => {
+                let init = params[..elements.len()]
+                    .iter()
+                    .map(|&r| Init::Reg(r))
+                    .collect();
+                (d, Kind::Tuple, init)
+            }
+            CpsInstr::Box(d, s) if s != d => (d, Kind::Box, vec![Init::Reg(s)]),
+            _ => return None,
+        };
+        Some(Object {
+            block,
+            at,
+            reg,
+            kind,
+            init,
+        })
+    }
+}
+
+/// How an instruction touches an object through its operand `obj`.
+enum Access {
+    Read {
+        dst: usize,
+        obj: usize,
+        field: usize,
+    },
+    Write {
+        src: usize,
+        obj: usize,
+        field: usize,
+    },
+}
+
+fn access(instr: &CpsInstr, kind: Kind) -> Option<Access> {
+    use CpsInstr::*;
+    let read = |dst, obj, field| Some(Access::Read { dst, obj, field });
+    match (instr, kind) {
+        (&GetField(dst, obj, k), Kind::Struct | Kind::Box) => read(dst, obj, k as usize),
+        (&TupleIndex(dst, obj, k), Kind::Tuple) => read(dst, obj, k as usize),
+        (&Unbox(dst, obj), Kind::Struct | Kind::Box) => read(dst, obj, 0),
+        (&SetField(src, obj, k, _), Kind::Struct | Kind::Box) => Some(Access::Write {
+            src,
+            obj,
+            field: k as usize,
+        }),
+        _ => None,
+    }
+}
+
+/// The registers that hold `object`'s handle, or `None` if it escapes.
+fn aliases_if_local(func: &CpsFunction, graph: &Graph, object: &Object) -> Option<RegSet> {
+    let regs = max_reg(func) + 1;
+    // Every definition of every register: `Some(src)` for a Move, else None.
+    let mut defs: HashMap<usize, Vec<Option<usize>>> = HashMap::new();
+    for &b in &graph.post {
+        let block = &func.blocks[b];
+        for &p in &block.params {
+            defs.entry(p).or_default().push(None);
+        }
+        for instr in &block.instrs {
+            let src = match *instr {
+                CpsInstr::Move(_, s) => Some(s),
+                _ => None,
+            };
+            if let Some(d) = def_of(instr) {
+                defs.entry(d).or_default().push(src);
+            }
+        }
+        if is_call(&block.term) {
+            defs.entry(0).or_default().push(None);
+        }
+    }
+    if defs[&object.reg].len() != 1 {
+        return None;
+    }
+
+    // Grow the alias set through Moves whose destination is only ever a copy.
+    let mut aliases = RegSet::new(regs);
+    aliases.insert(object.reg);
+    let mut changed = true;
+    while changed {
+        changed = false;
+        for &b in &graph.post {
+            for instr in &func.blocks[b].instrs {
+                if let CpsInstr::Move(y, x) = *instr {
+                    if aliases.contains(x) && !aliases.contains(y) {
+                        if defs[&y].iter().any(Option::is_none) {
+                            return None;
+                        }
+                        aliases.insert(y);
+                        changed = true;
+                    }
+                }
+            }
+        }
+    }
+    let copies_only = aliases.iter().filter(|&r| r != object.reg).all(|r| {
+        defs[&r]
+            .iter()
+            .all(|src| src.is_some_and(|s| aliases.contains(s)))
+    });
+    if !copies_only {
+        return None;
+    }
+
+    // Every read of an alias must be a field access or a copy.
+    let fields = object.init.len();
+    let mut uses = vec![];
+    for &b in &graph.post {
+        let block = &func.blocks[b];
+        for instr in &block.instrs {
+            match (access(instr, object.kind), instr) {
+                (Some(Access::Read { obj, field, .. }), _) if aliases.contains(obj) => {
+                    if field >= fields {
+                        return None;
+                    }
+                }
+                (Some(Access::Write { src, obj, field }), _) if aliases.contains(obj) => {
+                    if field >= fields || aliases.contains(src) {
+                        return None;
+                    }
+                }
+                (_, &CpsInstr::Move(_, x)) if aliases.contains(x) => {}
+                _ => {
+                    uses.clear();
+                    vm_uses(instr, &block.params, &mut uses);
+                    if uses.iter().any(|&r| aliases.contains(r)) {
+                        return None;
+                    }
+                }
+            }
+        }
+        uses.clear();
+        term_uses(&block.term, &mut uses);
+        if uses.iter().any(|&r| aliases.contains(r)) {
+            return None;
+        }
+    }
+
+    // No alias may carry a previous object into the allocation, or be read
+    // before one exists.
+    let live_in = vm_live_in(func, graph, &aliases);
+    let (block, at) = (&func.blocks[object.block], object.at);
+    let mut out = RegSet::new(regs);
+    for &s in &graph.succs[object.block] {
+        out.union(&live_in[s]);
+    }
+    let before = vm_live_before(block, at, &out, &aliases);
+    if before.iter().any(|r| aliases.contains(r))
+        || live_in[graph.entry].iter().any(|r| aliases.contains(r))
+    {
+        return None;
+    }
+    Some(aliases)
+}
+
+/// Live-in sets restricted to `track`, counting reads as the VM performs them.
+fn vm_live_in(func: &CpsFunction, graph: &Graph, track: &RegSet) -> Vec<RegSet> {
+    let regs = max_reg(func) + 1;
+    let mut live_in = vec![RegSet::new(regs); graph.ids.len()];
+    let mut changed = true;
+    while changed {
+        changed = false;
+        for &b in &graph.post {
+            let mut out = RegSet::new(regs);
+            for &s in &graph.succs[b] {
+                out.union(&live_in[s]);
+            }
+            let mut inn = vm_live_before(&func.blocks[b], 0, &out, track);
+            for &p in &func.blocks[b].params {
+                inn.remove(p);
+            }
+            if inn != live_in[b] {
+                live_in[b] = inn;
+                changed = true;
+            }
+        }
+    }
+    live_in
+}
+
+/// Tracked registers live before instruction `from` of `block`.
+fn vm_live_before(block: &CpsBlock, from: usize, out: &RegSet, track: &RegSet) -> RegSet {
+    let mut live = out.clone();
+    let mut uses = vec![];
+    term_uses(&block.term, &mut uses);
+    for instr in block.instrs[from..].iter().rev() {
+        uses.iter()
+            .filter(|&&r| track.contains(r))
+            .for_each(|&r| live.insert(r));
+        uses.clear();
+        if let Some(d) = def_of(instr) {
+            live.remove(d);
+        }
+        vm_uses(instr, &block.params, &mut uses);
+    }
+    uses.iter()
+        .filter(|&&r| track.contains(r))
+        .for_each(|&r| live.insert(r));
+    live
+}
+
+/// Rewrites `object` into one register per field.  Returns false, leaving
+/// `func` untouched, when the fields do not fit in the frame.
+fn replace(
+    func: &mut CpsFunction,
+    object: &Object,
+    aliases: &RegSet,
+    ctx: &mut FunctionCtx<'_>,
+) -> bool {
+    let base = max_reg(func) + 1;
+    if base + object.init.len() > MAX_REGS {
+        return false;
+    }
+    let field = |k: usize| base + k;
+
+    // Fields the allocating block writes before reading need no initial value.
+    let mut written = vec![false; object.init.len()];
+    let mut read = vec![false; object.init.len()];
+    for instr in &func.blocks[object.block].instrs[object.at + 1..] {
+        match access(instr, object.kind) {
+            Some(Access::Write { obj, field, .. }) if aliases.contains(obj) => {
+                written[field] |= !read[field];
+            }
+            Some(Access::Read { obj, field, .. }) if aliases.contains(obj) => read[field] = true,
+            _ => {}
+        }
+    }
+    let init: Vec<CpsInstr> = object
+        .init
+        .iter()
+        .enumerate()
+        .filter(|&(k, _)| !written[k])
+        .map(|(k, init)| match *init {
+            Init::Int(n) => CpsInstr::LoadConst(field(k), ctx.int_constant(n)),
+            Init::Reg(r) => CpsInstr::Move(field(k), r),
+        })
+        .collect();
+
+    for (b, block) in func.blocks.iter_mut().enumerate() {
+        if block.id == usize::MAX {
+            continue;
+        }
+        let instrs = std::mem::take(&mut block.instrs);
+        for (i, instr) in instrs.into_iter().enumerate() {
+            if b == object.block && i == object.at {
+                block.instrs.extend(init.iter().cloned());
+                continue;
+            }
+            match (access(&instr, object.kind), &instr) {
+                (Some(Access::Read { dst, obj, field: k }), _) if aliases.contains(obj) => {
+                    block.instrs.push(CpsInstr::Move(dst, field(k)))
+                }
+                (Some(Access::Write { src, obj, field: k }), _) if aliases.contains(obj) => {
+                    block.instrs.push(CpsInstr::Move(field(k), src))
+                }
+                (_, &CpsInstr::Move(_, x)) if aliases.contains(x) => {}
+                _ => block.instrs.push(instr),
+            }
+        }
+    }
+    func.reg_count = func.reg_count.max(base + object.init.len());
+    true
+}
+
+/// Heap allocations per function, counted by allocating instruction.
+pub fn allocation_sites(func: &CpsFunction) -> usize {
+    use CpsInstr::*;
+    func.blocks
+        .iter()
+        .filter(|b| b.id != usize::MAX)
+        .flat_map(|b| &b.instrs)
+        .filter(|instr| {
+            matches!(
+                instr,
+                NewStruct(..)
+                    | NewVariant(..)
+                    | NewList(..)
+                    | NewTuple(..)
+                    | NewInt64Array(..)
+                    | NewFloat64Array(..)
+                    | Box(..)
+                    | NewInterfaceObj(..)
+            )
+        })
+        .count()
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use kaubo_cps::test_util::{block_with, func};
+    use CpsBinOp::*;
+    use CpsInstr::*;
+    use CpsTerminator::*;
+
+    /// `struct Point { x: Int64, y: Int64 }` and a struct with a heap field.
+    fn structs() -> Vec<StructDef> {
+        let field = |n: &str, t: &str| (n.to_string(), t.to_string());
+        vec![
+            StructDef {
+                id: 0,
+                name: "Point".into(),
+                fields: vec![field("x", "Int64"), field("y", "Int64")],
+                type_bitmap: 0,
+            },
+            StructDef {
+                id: 1,
+                name: "Named".into(),
+                fields: vec![field("id", "Int64"), field("name", "String")],
+                type_bitmap: 0b10,
+            },
+        ]
+    }
+
+    fn run(f: &mut CpsFunction) -> (usize, Vec<Constant>) {
+        let (structs, mut constants) = (structs(), vec![Constant::Int(10), Constant::Int(20)]);
+        let mut ctx = FunctionCtx::new(&structs, &constants);
+        let n = scalar_replace(f, &mut ctx);
+        let added = ctx.added().to_vec();
+        constants.extend(added);
+        (n, constants)
+    }
+
+    fn allocs(f: &CpsFunction) -> usize {
+        allocation_sites(f)
+    }
+
+    #[test]
+    fn struct_read_back_becomes_moves() {
+        // `p = Point { x: 10, y: 20 }; print(p.x + p.y)`
+        let mut f = func(
+            vec![block_with(
+                0,
+                vec![],
+                vec![
+                    LoadConst(1, 0),
+                    LoadConst(2, 1),
+                    NewStruct(3, 0, vec![1, 2]),
+                    SetField(1, 3, 0, 0),
+                    SetField(2, 3, 1, 0),
+                    GetField(4, 3, 0),
+                    GetField(5, 3, 1),
+                    BinOp(6, AddInt, 4, 5),
+                    Print(6),
+                ],
+                Return(6),
+            )],
+            7,
+        );
+        assert_eq!(run(&mut f).0, 1);
+        assert_eq!(allocs(&f), 0);
+        // Both fields are written first, so no zero-fill is emitted.
+        assert!(matches!(
+            f.blocks[0].instrs[..],
+            [
+                LoadConst(1, 0),
+                LoadConst(2, 1),
+                Move(8, 1),
+                Move(9, 2),
+                Move(4, 8),
+                Move(5, 9),
+                BinOp(6, AddInt, 4, 5),
+                Print(6)
+            ]
+        ));
+        assert_eq!(f.reg_count, 10);
+    }
+
+    #[test]
+    fn unwritten_fields_start_as_new_struct_leaves_them() {
+        // Reads both fields of a fresh `Named` without writing them.
+        let mut f = func(
+            vec![block_with(
+                0,
+                vec![],
+                vec![
+                    NewStruct(1, 1, vec![]),
+                    GetField(2, 1, 0),
+                    GetField(3, 1, 1),
+                ],
+                Return(2),
+            )],
+            4,
+        );
+        let (n, constants) = run(&mut f);
+        assert_eq!(n, 1);
+        let [LoadConst(5, zero), LoadConst(6, null), Move(2, 5), Move(3, 6)] =
+            f.blocks[0].instrs[..]
+        else {
+            panic!("{:?}", f.blocks[0].instrs)
+        };
+        assert!(matches!(constants[zero], Constant::Int(0)));
+        assert!(matches!(constants[null], Constant::Int(-1)));
+    }
+
+    #[test]
+    fn tuple_elements_come_from_block_params() {
+        // (r1, r2) built in block 1, destructured in block 2.
+        let mut f = func(
+            vec![
+                block_with(
+                    0,
+                    vec![],
+                    vec![LoadConst(1, 0), LoadConst(2, 1)],
+                    Jump(1, vec![1, 2]),
+                ),
+                block_with(
+                    1,
+                    vec![1, 2],
+                    vec![NewTuple(3, vec![1, 2])],
+                    Jump(2, vec![]),
+                ),
+                block_with(
+                    2,
+                    vec![],
+                    vec![LoadConst(1, 0), TupleIndex(4, 3, 1), TupleIndex(5, 3, 0)],
+                    Return(4),
+                ),
+            ],
+            6,
+        );
+        assert_eq!(run(&mut f).0, 1);
+        assert!(matches!(f.blocks[1].instrs[..], [Move(7, 1), Move(8, 2)]));
+        assert!(matches!(
+            f.blocks[2].instrs[..],
+            [LoadConst(1, 0), Move(4, 8), Move(5, 7)]
+        ));
+    }
+
+    #[test]
+    fn box_unbox_pair_becomes_a_move() {
+        let mut f = func(
+            vec![block_with(
+                0,
+                vec![],
+                vec![LoadConst(1, 0), Box(2, 1), Unbox(3, 2)],
+                Return(3),
+            )],
+            4,
+        );
+        assert_eq!(run(&mut f).0, 1);
+        assert!(matches!(
+            f.blocks[0].instrs[..],
+            [LoadConst(1, 0), Move(5, 1), Move(3, 5)]
+        ));
+    }
+
+    #[test]
+    fn escaping_handles_keep_their_allocation() {
+        let escapes = [
+            (vec![], Return(1)),
+            (vec![Print(1)], Return(0)),
+            (vec![], Call(0, vec![1], 1)),
+            (
+                vec![NewStruct(2, 0, vec![]), SetField(1, 2, 0, 0)],
+                Return(2),
+            ),
+            (vec![BinOp(2, EqInt, 1, 1)], Return(2)),
+            // Wrong kind and out-of-range accesses are left for the VM to reject.
+            (vec![TupleIndex(2, 1, 0)], Return(2)),
+            (vec![GetField(2, 1, 5)], Return(2)),
+        ];
+        for (uses, term) in escapes {
+            let mut instrs = vec![NewStruct(1, 0, vec![])];
+            instrs.extend(uses);
+            let mut f = func(vec![block_with(0, vec![], instrs, term)], 3);
+            let before = allocs(&f);
+            run(&mut f);
+            assert_eq!(allocs(&f), before, "{:?}", f.blocks[0]);
+        }
+    }
+
+    #[test]
+    fn copies_through_r0_are_followed() {
+        // An inlined `return (a, b)`: the handle reaches the caller via r0.
+        let mut f = func(
+            vec![
+                block_with(0, vec![], vec![LoadConst(1, 0)], Jump(1, vec![1, 1])),
+                block_with(
+                    1,
+                    vec![1, 2],
+                    vec![
+                        NewTuple(3, vec![1, 2]),
+                        Move(0, 3),
+                        Move(4, 0),
+                        BinOp(6, IToS, 1, 0),
+                        TupleIndex(5, 4, 1),
+                    ],
+                    Return(5),
+                ),
+            ],
+            7,
+        );
+        assert_eq!(run(&mut f).0, 1);
+        assert!(matches!(
+            f.blocks[1].instrs[..],
+            [Move(8, 1), Move(9, 2), BinOp(6, IToS, 1, 0), Move(5, 9)]
+        ));
+    }
+
+    #[test]
+    fn alias_written_elsewhere_escapes() {
+        // r4 is sometimes the tuple, sometimes a constant.
+        let mut f = func(
+            vec![
+                block_with(0, vec![], vec![LoadConst(1, 0)], Jump(1, vec![1])),
+                block_with(
+                    1,
+                    vec![1],
+                    vec![
+                        NewTuple(3, vec![1]),
+                        Move(4, 3),
+                        LoadConst(4, 0),
+                        TupleIndex(5, 3, 0),
+                    ],
+                    Return(5),
+                ),
+            ],
+            6,
+        );
+        assert_eq!(run(&mut f).0, 0);
+    }
+
+    #[test]
+    fn object_kept_across_loop_iterations_escapes() {
+        // `old` is a copy of the previous iteration's struct, read after the
+        // next one is built; one register per field cannot hold both.
+        let mut f = func(
+            vec![
+                block_with(
+                    0,
+                    vec![],
+                    vec![NewStruct(2, 0, vec![]), Move(3, 2)],
+                    Jump(1, vec![]),
+                ),
+                block_with(
+                    1,
+                    vec![],
+                    vec![NewStruct(2, 0, vec![]), GetField(4, 3, 0), Move(3, 2)],
+                    Branch(4, 1, vec![], 2, vec![]),
+                ),
+                block_with(2, vec![], vec![], Return(4)),
+            ],
+            5,
+        );
+        let before = allocs(&f);
+        run(&mut f);
+        assert_eq!(allocs(&f), before);
+    }
+
+    #[test]
+    fn fresh_object_per_iteration_is_replaced() {
+        // A struct built and read inside the loop body every iteration.
+        let mut f = func(
+            vec![
+                block_with(0, vec![], vec![LoadConst(1, 0)], Jump(1, vec![])),
+                block_with(
+                    1,
+                    vec![],
+                    vec![
+                        NewStruct(2, 0, vec![]),
+                        SetField(1, 2, 0, 0),
+                        GetField(3, 2, 0),
+                        BinOp(1, SubInt, 3, 1),
+                    ],
+                    Branch(1, 1, vec![], 2, vec![]),
+                ),
+                block_with(2, vec![], vec![], Return(1)),
+            ],
+            4,
+        );
+        assert_eq!(run(&mut f).0, 1);
+        assert_eq!(allocs(&f), 0);
+    }
+}
@@ -1,23 +1,21 @@
 //! Constant folding — evaluate constant expressions at compile time.
 
-use super::Pass;
+use super::{FunctionCtx, FunctionPass};
 use crate::cps::*;
 use std::collections::HashMap;
 
 pub struct ConstantFold;
 
-impl Pass for ConstantFold {
+impl FunctionPass for ConstantFold {
     fn name(&self) -> &'static str {
         "constant-fold"
     }
-    fn run(&self, module: &mut CpsModule) {
-        for func in &mut module.functions {
-            fold_function(func, &mut module.constants);
-        }
+    fn run_function(&self, func: &mut CpsFunction, ctx: &mut FunctionCtx<'_>) {
+        fold_function(func, ctx);
     }
 }
 
-fn fold_function(func: &mut CpsFunction, constants: &mut Vec<Constant>) {
+fn fold_function(func: &mut CpsFunction, ctx: &mut FunctionCtx<'_>) {
     // Count predecessors
     let mut pred_count: HashMap<usize, usize> = HashMap::new();
     let mut pred: HashMap<usize, usize> = HashMap::new();
@@ -55,7 +53,7 @@ fn fold_function(func: &mut CpsFunction, constants: &mut Vec<Constant>) {
         };
 
         if let Some(block) = func.blocks.iter_mut().find(|b| b.id == bid) {
-            let result = fold_block_with(block, constants, inherited);
+            let result = fold_block_with(block, ctx, inherited);
             block_consts.insert(bid, result);
 
             // Enqueue successors
@@ -84,13 +82,13 @@ fn fold_function(func: &mut CpsFunction, constants: &mut Vec<Constant>) {
 
 fn fold_block_with(
     block: &mut CpsBlock,
-    constants: &mut Vec<Constant>,
+    ctx: &mut FunctionCtx<'_>,
     mut reg_val: HashMap<usize, i64>,
 ) -> HashMap<usize, i64> {
     for instr in &mut block.instrs {
         let replacement = match instr {
             CpsInstr::LoadConst(r, idx) => {
-                if let Some(Constant::Int(n)) = constants.get(*idx) {
+                if let Some(Constant::Int(n)) = ctx.constant(*idx) {
                     reg_val.insert(*r, *n);
                 }
                 None
@@ -101,7 +99,7 @@ fn fold_block_with(
                 let vb = reg_val.get(&src2).copied();
                 if let (Some(va), Some(vb)) = (va, vb) {
                     if let Some(result) = eval_binop(*op, va, vb) {
-                        let new_idx = add_or_get_const(constants, Constant::Int(result));
+                        let new_idx = ctx.int_constant(result);
                         reg_val.insert(dst, result);
                         Some(CpsInstr::LoadConst(dst, new_idx))
                     } else {
@@ -116,7 +114,7 @@ fn fold_block_with(
                 let va = reg_val.get(&src).copied();
                 if let Some(va) = va {
                     if let Some(result) = eval_unop(*op, va) {
-                        let new_idx = add_or_get_const(constants, Constant::Int(result));
+                        let new_idx = ctx.int_constant(result);
                         reg_val.insert(dst, result);
                         Some(CpsInstr::LoadConst(dst, new_idx))
                     } else {
@@ -179,32 +177,12 @@ fn eval_unop(op: CpsUnOp, a: i64) -> Option<i64> {
     }
 }
 
-fn add_or_get_const(constants: &mut Vec<Constant>, c: Constant) -> usize {
-    for (i, existing) in constants.iter().enumerate() {
-        if const_eq(existing, &c) {
-            return i;
-        }
-    }
-    let i = constants.len();
-    constants.push(c);
-    i
-}
-
-fn const_eq(a: &Constant, b: &Constant) -> bool {
-    match (a, b) {
-        (Constant::Int(a), Constant::Int(b)) => a == b,
-        (Constant::Float(a), Constant::Float(b)) => a.to_bits() == b.to_bits(),
-        (Constant::String(a), Constant::String(b)) => a == b,
-        (Constant::Bool(a), Constant::Bool(b)) => a == b,
-        _ => false,
-    }
-}
-
 #[cfg(test)]
 mod tests {
     use super::*;
     use crate::cps_build::build_module;
     use crate::flatten::flatten_module;
+    use crate::pass::Pass;
     use crate::test_fixtures;
 
     fn fold_src(src: &str) -> CpsModule {
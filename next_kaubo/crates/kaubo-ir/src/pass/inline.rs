@@ -0,0 +1,503 @@
+//! Function inlining — splice small leaf callees into their call sites.
+//!
+//! A `Call` / `Return` pair costs a frame push, argument copies and a pop,
+//! which is most of the work for a small lambda.  This pass copies the
+//! callee's blocks into the caller instead:
+//!   - callee registers are renumbered above the caller's (`base + r`), the
+//!     call's args are moved into `base + 0..n` the way the VM copies them
+//!     into a fresh frame, and every `Return(r)` becomes `Move(r0, base + r)`
+//!     plus a jump to the call's return block;
+//!   - callee block ids are renumbered into ids the caller does not use;
+//!   - the call block absorbs the callee's entry block, and a single return
+//!     site absorbs the return block, so a straight-line callee leaves no
+//!     extra jumps behind.
+//!
+//! Only leaf callees are inlined — no calls, tail calls or suspends of their
+//! own.  Inside a callee `r0` is both the first argument and the slot call
+//! results land in, and a leaf never needs to tell the two apart.  Functions
+//! are visited callees-first, so a caller becomes a leaf once its own call
+//! sites are inlined; a function on a call cycle never does, which is the
+//! recursion guard.
+//!
+//! Cost model, in instructions plus one terminator per block:
+//!   - callees up to `max_callee` are inlined at every call site;
+//!   - callees called from a single function (a lambda bound and called
+//!     locally, or an imported helper with one user) are inlined up to
+//!     `max_local`, since no other caller needs the out-of-line copy;
+//!   - a caller stops growing at `max_caller`, and never past the VM's
+//!     register or branch-target encodings.
+//!
+//! Run it on linked modules too: `LinkStage` turns `CallExternal` into
+//! `Call`, and only then do imported helpers have a known target.
+
+use super::dataflow::*;
+use super::Pass;
+use crate::cps::*;
+use std::collections::{HashMap, HashSet};
+
+pub struct Inline {
+    /// Largest callee inlined at any call site.
+    pub max_callee: usize,
+    /// Largest callee inlined when all its call sites are in one function.
+    pub max_local: usize,
+    /// Callers are not grown past this size.
+    pub max_caller: usize,
+}
+
+impl Default for Inline {
+    fn default() -> Self {
+        Inline {
+            max_callee: 24,
+            max_local: 96,
+            max_caller: 2048,
+        }
+    }
+}
+
+impl Pass for Inline {
+    fn name(&self) -> &'static str {
+        "inline"
+    }
+    fn run(&self, module: &mut CpsModule) {
+        let n = module.functions.len();
+        let calls: Vec<Vec<usize>> = module.functions.iter().map(direct_callees).collect();
+        let mut callers = vec![HashSet::new(); n];
+        for (f, callees) in calls.iter().enumerate() {
+            for &g in callees.iter().filter(|&&g| g < n) {
+                callers[g].insert(f);
+            }
+        }
+        for f in callees_first(&calls) {
+            self.inline_into(module, f, &callers);
+        }
+    }
+}
+
+impl Inline {
+    fn inline_into(&self, module: &mut CpsModule, f: usize, callers: &[HashSet<usize>]) {
+        if suspends(&module.functions[f]) {
+            return;
+        }
+        let mut p = 0;
+        while p < module.functions[f].blocks.len() {
+            let block = &module.functions[f].blocks[p];
+            let target = match block.term {
+                CpsTerminator::Call(g, ..) if block.id != usize::MAX => Some(g),
+                _ => None,
+            };
+            let Some(g) = target.filter(|&g| g != f && g < module.functions.len()) else {
+                p += 1;
+                continue;
+            };
+            let limit = if callers[g].len() == 1 {
+                self.max_local
+            } else {
+                self.max_callee
+            };
+            let callee = &module.functions[g];
+            let fits = is_leaf(callee)
+                && size(callee) <= limit
+                && size(&module.functions[f]) + size(callee) <= self.max_caller;
+            // A successful splice may leave another call in block `p` (the
+            // return block's terminator), so look at it again.
+            if !fits {
+                p += 1;
+                continue;
+            }
+            let callee = callee.clone();
+            if !splice(&mut module.functions[f], p, &callee) {
+                p += 1;
+            }
+        }
+    }
+}
+
+/// Replaces the `Call` ending `caller.blocks[p]` with a copy of `callee`.
+/// Returns false, leaving `caller` untouched, when the copy cannot be made.
+fn splice(caller: &mut CpsFunction, p: usize, callee: &CpsFunction) -> bool {
+    let CpsTerminator::Call(_, args, ret) = caller.blocks[p].term.clone() else {
+        return false;
+    };
+    let graph = Graph::build(callee);
+    if callee.blocks.is_empty() || !callee.blocks[graph.entry].params.is_empty() {
+        return false;
+    }
+    // Registers other than the bound arguments start out unset in a fresh
+    // frame; a callee that reads one before writing it keeps its frame.
+    let bound = args.len().min(callee.reg_count);
+    let live = Liveness::compute(callee, &graph);
+    if live.live_in[graph.entry]
+        .iter()
+        .any(|r| r != 0 && r >= bound)
+    {
+        return false;
+    }
+    let base = max_reg(caller) + 1;
+    let width = max_reg(callee) + 1;
+    if base + width > MAX_REGS {
+        return false;
+    }
+
+    let order: Vec<usize> = graph.post.iter().rev().copied().collect();
+    let merge_entry = graph.preds[graph.entry].is_empty();
+    let returns = order
+        .iter()
+        .filter(|&&b| matches!(callee.blocks[b].term, CpsTerminator::Return(_)))
+        .count();
+    let ret_pos = caller.blocks.iter().position(|b| b.id == ret).filter(|&r| {
+        returns == 1
+            && r != p
+            && ret != 0
+            && ret != caller.entry
+            && caller.blocks[r].params.is_empty()
+            && only_entered_from(caller, ret, p)
+    });
+
+    // Fresh block ids: smallest numbers the caller neither defines nor names.
+    let mut taken: HashSet<usize> = [0, caller.entry].into();
+    for block in caller.blocks.iter().filter(|b| b.id != usize::MAX) {
+        taken.insert(block.id);
+        taken.extend(targets(&block.term));
+    }
+    let mut ids = HashMap::new();
+    let mut next = 0;
+    for &b in order
+        .iter()
+        .filter(|&&b| !(merge_entry && b == graph.entry))
+    {
+        while taken.contains(&next) {
+            next += 1;
+        }
+        ids.insert(callee.blocks[b].id, next);
+        taken.insert(next);
+    }
+    // Branch encodes its true target in 9 bits and its false target in 8.
+    let encodable = order.iter().all(|&b| match callee.blocks[b].term {
+        CpsTerminator::Branch(_, t, _, e, _) => ids[&t] < 512 && ids[&e] < 256,
+        _ => true,
+    });
+    if !encodable {
+        return false;
+    }
+
+    let shift = |r: &mut usize| *r += base;
+    let mut blocks: Vec<CpsBlock> = order
+        .iter()
+        .map(|&b| {
+            let mut block = callee.blocks[b].clone();
+            block.id = ids.get(&block.id).copied().unwrap_or(usize::MAX);
+            block.params.iter_mut().for_each(shift);
+            for instr in &mut block.instrs {
+                instr_regs_mut(instr, shift);
+            }
+            term_regs_mut(&mut block.term, shift);
+            match &mut block.term {
+                CpsTerminator::Jump(t, _) => *t = ids[t],
+                CpsTerminator::Branch(_, t, _, e, _) => {
+                    *t = ids[t];
+                    *e = ids[e];
+                }
+                CpsTerminator::Return(r) => {
+                    block.instrs.push(CpsInstr::Move(0, *r));
+                    block.term = CpsTerminator::Jump(ret, vec![]);
+                }
+                _ => unreachable!("callee is a leaf"),
+            }
+            block
+        })
+        .collect();
+
+    if let Some(r) = ret_pos {
+        let exit = blocks
+            .iter_mut()
+            .find(|b| matches!(b.term, CpsTerminator::Jump(t, _) if t == ret))
+            .unwrap();
+        let dead = std::mem::replace(
+            &mut caller.blocks[r],
+            CpsBlock {
+                id: usize::MAX,
+                params: vec![],
+                instrs: vec![],
+                term: CpsTerminator::Return(0),
+            },
+        );
+        exit.instrs.extend(dead.instrs);
+        exit.term = dead.term;
+    }
+
+    let call = &mut caller.blocks[p];
+    call.instrs.extend(
+        args.iter()
+            .take(bound)
+            .enumerate()
+            .map(|(i, &a)| CpsInstr::Move(base + i, a)),
+    );
+    if merge_entry {
+        let entry = blocks.remove(0);
+        call.instrs.extend(entry.instrs);
+        call.term = entry.term;
+    } else {
+        call.term = CpsTerminator::Jump(blocks[0].id, vec![]);
+    }
+    caller.blocks.extend(blocks);
+    caller.reg_count = base + width;
+    true
+}
+
+/// True if no live block other than `p` names block `id` as a successor.
+fn only_entered_from(func: &CpsFunction, id: usize, p: usize) -> bool {
+    func.blocks
+        .iter()
+        .enumerate()
+        .filter(|&(q, b)| q != p && b.id != usize::MAX)
+        .all(|(_, b)| !targets(&b.term).contains(&id))
+}
+
+fn direct_callees(func: &CpsFunction) -> Vec<usize> {
+    func.blocks
+        .iter()
+        .filter(|b| b.id != usize::MAX)
+        .filter_map(|b| match b.term {
+            CpsTerminator::Call(g, ..) => Some(g),
+            _ => None,
+        })
+        .collect()
+}
+
+/// Function indices in call-graph postorder: callees before their callers
+/// (cycles are cut where the DFS meets them).
+fn callees_first(calls: &[Vec<usize>]) -> Vec<usize> {
+    let n = calls.len();
+    let mut seen = vec![false; n];
+    let mut order = Vec::with_capacity(n);
+    for root in 0..n {
+        if seen[root] {
+            continue;
+        }
+        seen[root] = true;
+        let mut stack = vec![(root, 0)];
+        while let Some((f, next)) = stack.last_mut() {
+            if let Some(&g) = calls[*f].get(*next) {
+                *next += 1;
+                if g < n && !seen[g] {
+                    seen[g] = true;
+                    stack.push((g, 0));
+                }
+            } else {
+                order.push(*f);
+                stack.pop();
+            }
+        }
+    }
+    order
+}
+
+fn suspends(func: &CpsFunction) -> bool {
+    func.blocks
+        .iter()
+        .any(|b| b.id != usize::MAX && matches!(b.term, CpsTerminator::Suspend))
+}
+
+fn is_leaf(func: &CpsFunction) -> bool {
+    !func.blocks.is_empty()
+        && func.blocks.iter().filter(|b| b.id != usize::MAX).all(|b| {
+            !is_call(&b.term)
+                && !matches!(b.term, CpsTerminator::TailCall(..) | CpsTerminator::Suspend)
+        })
+}
+
+/// Instructions plus one terminator per live block.
+fn size(func: &CpsFunction) -> usize {
+    func.blocks
+        .iter()
+        .filter(|b| b.id != usize::MAX)
+        .map(|b| b.instrs.len() + 1)
+        .sum()
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use kaubo_cps::test_util::{block, named_func};
+    use CpsBinOp::*;
+    use CpsInstr::*;
+    use CpsTerminator::*;
+
+    fn module(functions: Vec<CpsFunction>) -> CpsModule {
+        kaubo_cps::test_util::module(functions, vec![Constant::Int(1), Constant::Int(2)])
+    }
+
+    /// `|a, b| { return a + b }`
+    fn add() -> CpsFunction {
+        named_func(
+            "add",
+            vec![block(0, vec![BinOp(2, AddInt, 0, 1)], Return(2))],
+            3,
+        )
+    }
+
+    /// `print(add(1, 2))` — the call's return block moves r0 out.
+    fn main_calling(callee: usize) -> CpsFunction {
+        named_func(
+            "main",
+            vec![
+                block(
+                    0,
+                    vec![LoadConst(1, 0), LoadConst(2, 1)],
+                    Call(callee, vec![1, 2], 1),
+                ),
+                block(1, vec![Move(3, 0), Print(3)], Return(3)),
+            ],
+            4,
+        )
+    }
+
+    fn calls(func: &CpsFunction) -> usize {
+        direct_callees(func).len()
+    }
+
+    #[test]
+    fn straight_line_callee_merges_into_the_call_block() {
+        let mut m = module(vec![add(), main_calling(0)]);
+        Inline::default().run(&mut m);
+        let main = &m.functions[1];
+        assert_eq!(calls(main), 0);
+        let live: Vec<_> = main.blocks.iter().filter(|b| b.id != usize::MAX).collect();
+        assert_eq!(live.len(), 1, "{:?}", main.blocks);
+        assert!(matches!(
+            live[0].instrs[..],
+            [
+                LoadConst(1, 0),
+                LoadConst(2, 1),
+                Move(5, 1),
+                Move(6, 2),
+                BinOp(7, AddInt, 5, 6),
+                Move(0, 7),
+                Move(3, 0),
+                Print(3)
+            ]
+        ));
+        assert!(matches!(live[0].term, Return(3)));
+        assert_eq!(main.reg_count, 9);
+    }
+
+    #[test]
+    fn looping_callee_gets_fresh_block_ids() {
+        // `|n| { i = 0; while (i < n) { i = i + 1 }; return i }`
+        let count = named_func(
+            "count",
+            vec![
+                block(0, vec![LoadConst(1, 0)], Jump(1, vec![])),
+                block(
+                    1,
+                    vec![BinOp(2, LtInt, 1, 0)],
+                    Branch(2, 2, vec![], 3, vec![]),
+                ),
+                block(
+                    2,
+                    vec![LoadConst(3, 0), BinOp(1, AddInt, 1, 3)],
+                    Jump(1, vec![]),
+                ),
+                block(3, vec![], Return(1)),
+            ],
+            4,
+        );
+        let mut m = module(vec![count, main_calling(0)]);
+        Inline::default().run(&mut m);
+        let main = &m.functions[1];
+        assert_eq!(calls(main), 0);
+        let mut ids: Vec<usize> = main
+            .blocks
+            .iter()
+            .map(|b| b.id)
+            .filter(|&id| id != usize::MAX)
+            .collect();
+        ids.sort();
+        ids.dedup();
+        assert_eq!(
+            ids.len(),
+            main.blocks.iter().filter(|b| b.id != usize::MAX).count()
+        );
+        // Entry absorbed the callee entry and jumps to the copied loop header.
+        let Jump(header, _) = main.blocks[0].term else {
+            panic!("{:?}", main.blocks[0].term)
+        };
+        let header = main.blocks.iter().find(|b| b.id == header).unwrap();
+        assert!(matches!(header.term, Branch(..)));
+        // The single return site absorbed `print`.
+        assert!(main
+            .blocks
+            .iter()
+            .any(|b| b.id != usize::MAX
+                && matches!(b.instrs[..], [Move(0, _), Move(3, 0), Print(3)])));
+    }
+
+    #[test]
+    fn calls_and_cycles_are_not_inlined() {
+        // f calls g calls f: neither is a leaf, so both calls stay.
+        let f = named_func(
+            "f",
+            vec![
+                block(0, vec![], Call(1, vec![0], 1)),
+                block(1, vec![], Return(0)),
+            ],
+            1,
+        );
+        let g = named_func(
+            "g",
+            vec![
+                block(0, vec![], Call(0, vec![0], 1)),
+                block(1, vec![], Return(0)),
+            ],
+            1,
+        );
+        let mut m = module(vec![f, g, main_calling(0)]);
+        Inline::default().run(&mut m);
+        assert_eq!(calls(&m.functions[0]), 1);
+        assert_eq!(calls(&m.functions[1]), 1);
+        assert_eq!(calls(&m.functions[2]), 1);
+    }
+
+    #[test]
+    fn callee_that_becomes_a_leaf_is_inlined_bottom_up() {
+        // wrap(a, b) = add(a, b); main calls wrap.
+        let wrap = named_func(
+            "wrap",
+            vec![
+                block(0, vec![], Call(0, vec![0, 1], 1)),
+                block(1, vec![Move(2, 0)], Return(2)),
+            ],
+            3,
+        );
+        let mut m = module(vec![add(), wrap, main_calling(1)]);
+        Inline::default().run(&mut m);
+        assert_eq!(calls(&m.functions[1]), 0);
+        assert_eq!(calls(&m.functions[2]), 0);
+    }
+
+    #[test]
+    fn larger_budget_applies_only_to_single_caller() {
+        let big = || {
+            let instrs = (0..30).map(|_| BinOp(0, AddInt, 0, 0)).collect();
+            named_func("big", vec![block(0, instrs, Return(0))], 1)
+        };
+        // One caller: within max_local.
+        let mut m = module(vec![big(), main_calling(0)]);
+        Inline::default().run(&mut m);
+        assert_eq!(calls(&m.functions[1]), 0);
+        // Two callers: over max_callee, both calls stay.
+        let mut m = module(vec![big(), main_calling(0), main_calling(0)]);
+        Inline::default().run(&mut m);
+        assert_eq!(calls(&m.functions[1]), 1);
+        assert_eq!(calls(&m.functions[2]), 1);
+    }
+
+    #[test]
+    fn callee_reading_an_unbound_register_keeps_its_frame() {
+        // Reads r5, which no argument binds.
+        let odd = named_func("odd", vec![block(0, vec![Move(6, 5)], Return(6))], 7);
+        let mut m = module(vec![odd, main_calling(0)]);
+        Inline::default().run(&mut m);
+        assert_eq!(calls(&m.functions[1]), 1);
+    }
+}
@@ -1,13 +1,699 @@
-use super::Pass;
-use crate::cps::CpsModule;
+//! Loop optimisation — invariant code motion and induction-variable strength reduction.
+//!
+//! `while` / `for` loops reach this pass as natural loops over plain mutable
+//! registers (not SSA), so every transform is guarded by per-loop def counts
+//! and block-level liveness:
+//!
+//!   - LICM: an instruction whose operands are never written in the loop, whose
+//!     destination is written only there and is dead on entry to the header and
+//!     at every exit, moves to the preheader.  Only pure instructions move;
+//!     `DivInt` / `ModInt` only from the pure prefix of the header (they run on
+//!     every entry anyway, so a trap happens at the same point), `ListLen` only
+//!     from loops without calls (nothing else can resize a list).
+//!   - Strength reduction: for a basic induction variable `i = i ± c` with `c`
+//!     invariant, a product `j = i * k` with `k` invariant becomes `j = j ± c*k`
+//!     right after the increment, seeded with `i * k` in the preheader.
+//!
+//! Loops are processed innermost first, so invariants bubble outwards one
+//! level per loop.  The preheader is the single outside predecessor when it
+//! already ends in `Jump(header)`; otherwise a fresh block is inserted just
+//! before the header.  Functions with `Suspend` are left alone.
+
+use super::dataflow::*;
+use super::{FunctionCtx, FunctionPass};
+use crate::cps::*;
+use std::collections::{HashMap, HashSet};
 
 pub struct LoopInline;
 
-impl Pass for LoopInline {
+impl FunctionPass for LoopInline {
     fn name(&self) -> &'static str {
         "loop-inline"
     }
-    fn run(&self, _module: &mut CpsModule) {
-        // TODO: fix back-edge redirect
+    fn run_function(&self, func: &mut CpsFunction, _: &mut FunctionCtx<'_>) {
+        optimize_function(func);
+    }
+}
+
+/// What `optimize_function` changed in one function.
+#[derive(Debug, Clone, Copy, Default, PartialEq, Eq)]
+pub struct LoopStats {
+    /// Natural loops found.
+    pub loops: usize,
+    /// Instructions moved into a preheader.
+    pub hoisted: usize,
+    /// Multiplications replaced by an add at the induction step.
+    pub reduced: usize,
+}
+
+pub fn optimize_function(func: &mut CpsFunction) -> LoopStats {
+    let mut stats = LoopStats::default();
+    let suspends = func
+        .blocks
+        .iter()
+        .any(|b| b.id != usize::MAX && matches!(b.term, CpsTerminator::Suspend));
+    if func.blocks.is_empty() || suspends {
+        return stats;
+    }
+    for_each_loop(func, |func, cfg, lp, _| {
+        stats.loops += 1;
+        stats.hoisted += hoist_invariants(func, cfg, lp);
+    });
+    for_each_loop(func, |func, cfg, lp, loops| {
+        stats.reduced += reduce_strength(func, cfg, lp, loops);
+    });
+    stats
+}
+
+/// Visit every loop once, innermost first.  A transform may insert a
+/// preheader, so the CFG is rebuilt before each visit; headers are tracked
+/// by block id, which insertion does not change.
+fn for_each_loop(
+    func: &mut CpsFunction,
+    mut visit: impl FnMut(&mut CpsFunction, &Cfg, &Loop, &[Loop]),
+) {
+    let mut done = HashSet::new();
+    loop {
+        let cfg = Cfg::build(func);
+        let loops = cfg.loops();
+        let Some(lp) = loops.iter().find(|l| !done.contains(&cfg.g.ids[l.header])) else {
+            return;
+        };
+        done.insert(cfg.g.ids[lp.header]);
+        visit(func, &cfg, lp, &loops);
+    }
+}
+
+// ── LICM ──
+
+fn hoist_invariants(func: &mut CpsFunction, cfg: &Cfg, lp: &Loop) -> usize {
+    let Some(pre) = cfg.preheader(func, lp) else {
+        return 0;
+    };
+    let mut facts = LoopFacts::new(func, cfg, lp, &pre);
+    let mut hoisted = vec![];
+    // Moving one instruction can make its users invariant: repeat to a fixpoint.
+    loop {
+        let before = hoisted.len();
+        for &p in &lp.body {
+            let instrs = &mut func.blocks[p].instrs;
+            let mut prefix = p == lp.header;
+            let mut k = 0;
+            while k < instrs.len() {
+                if facts.hoistable(&instrs[k], prefix) {
+                    let instr = instrs.remove(k);
+                    facts.defs.remove(&def_of(&instr).unwrap());
+                    hoisted.push(instr);
+                    continue;
+                }
+                prefix &= is_pure(&instrs[k]);
+                k += 1;
+            }
+        }
+        if hoisted.len() == before {
+            break;
+        }
+    }
+    let n = hoisted.len();
+    if n > 0 {
+        place_in_preheader(func, lp, pre, hoisted);
+    }
+    n
+}
+
+/// Never traps, never allocates, no side effects: safe to run speculatively.
+fn is_pure(instr: &CpsInstr) -> bool {
+    match instr {
+        CpsInstr::LoadConst(..) | CpsInstr::Move(..) | CpsInstr::UnOp(..) => true,
+        CpsInstr::BinOp(_, op, _, _) => !matches!(
+            op,
+            CpsBinOp::DivInt
+                | CpsBinOp::ModInt
+                | CpsBinOp::SAdd
+                | CpsBinOp::IToS
+                | CpsBinOp::FToS
+                | CpsBinOp::BToS
+                | CpsBinOp::SToI
+        ),
+        _ => false,
+    }
+}
+
+// ── Strength reduction ──
+
+/// `reg = reg op step` — the only write to `reg` inside the loop.
+#[derive(Clone, Copy)]
+struct Induction {
+    block: usize,
+    at: usize,
+    op: CpsBinOp,
+    step: usize,
+}
+
+fn reduce_strength(func: &mut CpsFunction, cfg: &Cfg, lp: &Loop, loops: &[Loop]) -> usize {
+    let Some(pre) = cfg.preheader(func, lp) else {
+        return 0;
+    };
+    let facts = LoopFacts::new(func, cfg, lp, &pre);
+    let depth = |p: usize| loops.iter().filter(|l| l.contains(p)).count();
+
+    let mut ivs = HashMap::new();
+    for &p in &lp.body {
+        for (at, instr) in func.blocks[p].instrs.iter().enumerate() {
+            let CpsInstr::BinOp(i, op, a, b) = *instr else {
+                continue;
+            };
+            let step = match op {
+                CpsBinOp::AddInt if a == i => b,
+                CpsBinOp::AddInt if b == i => a,
+                CpsBinOp::SubInt if a == i => b,
+                _ => continue,
+            };
+            if step != i && facts.defs.get(&i) == Some(&1) && facts.invariant(step) {
+                ivs.insert(
+                    i,
+                    Induction {
+                        block: p,
+                        at,
+                        op,
+                        step,
+                    },
+                );
+            }
+        }
+    }
+
+    // (block, index) of each product to delete, and what to insert after each increment.
+    let mut muls = HashSet::new();
+    let mut steps: HashMap<(usize, usize), Vec<CpsInstr>> = HashMap::new();
+    let mut seeds = vec![];
+    for &p in &lp.body {
+        for (at, instr) in func.blocks[p].instrs.iter().enumerate() {
+            let CpsInstr::BinOp(j, CpsBinOp::MulInt, a, b) = *instr else {
+                continue;
+            };
+            let (i, k) = match (ivs.get(&a), ivs.get(&b)) {
+                (Some(_), _) if facts.invariant(b) => (a, b),
+                (_, Some(_)) if facts.invariant(a) => (b, a),
+                _ => continue,
+            };
+            let iv = ivs[&i];
+            let single_def = facts.defs.get(&j) == Some(&1) && !facts.pinned.contains(j);
+            // `j` must not be read between the increment and the product, and
+            // the increment must not run more often than the product did.
+            if j == i
+                || j == k
+                || !single_def
+                || depth(iv.block) > depth(p)
+                || cfg.live.live_after(func, iv.block, iv.at).contains(j)
+                || func.reg_count >= MAX_REGS
+            {
+                continue;
+            }
+            let delta = func.reg_count;
+            func.reg_count += 1;
+            seeds.push(CpsInstr::BinOp(j, CpsBinOp::MulInt, i, k));
+            seeds.push(CpsInstr::BinOp(delta, CpsBinOp::MulInt, iv.step, k));
+            steps
+                .entry((iv.block, iv.at))
+                .or_default()
+                .push(CpsInstr::BinOp(j, iv.op, j, delta));
+            muls.insert((p, at));
+        }
+    }
+    let n = muls.len();
+    if n == 0 {
+        return 0;
+    }
+    for &p in &lp.body {
+        let old = std::mem::take(&mut func.blocks[p].instrs);
+        let instrs = &mut func.blocks[p].instrs;
+        for (at, instr) in old.into_iter().enumerate() {
+            if !muls.contains(&(p, at)) {
+                instrs.push(instr);
+            }
+            if let Some(extra) = steps.remove(&(p, at)) {
+                instrs.extend(extra);
+            }
+        }
+    }
+    place_in_preheader(func, lp, pre, seeds);
+    n
+}
+
+// ── Loop facts ──
+
+struct LoopFacts {
+    /// Register → number of writes inside the loop (block params and the
+    /// `r0` result of calls included).  Absent means invariant.
+    defs: HashMap<usize, usize>,
+    /// The loop contains a call, which may resize any list it can reach.
+    calls: bool,
+    /// Registers whose value before the loop, or after it, is observable: live
+    /// into the header, live into an exit, or an argument of the preheader's jump.
+    pinned: RegSet,
+}
+
+impl LoopFacts {
+    fn new(func: &CpsFunction, cfg: &Cfg, lp: &Loop, pre: &Preheader) -> Self {
+        let mut defs = HashMap::new();
+        let mut calls = false;
+        let mut pinned = cfg.live.live_in[lp.header].clone();
+        for &p in &lp.body {
+            let block = &func.blocks[p];
+            let writes = block
+                .params
+                .iter()
+                .copied()
+                .chain(block.instrs.iter().filter_map(def_of));
+            for r in writes {
+                *defs.entry(r).or_insert(0) += 1;
+            }
+            if is_call(&block.term) {
+                calls = true;
+                *defs.entry(0).or_insert(0) += 1;
+            }
+            for &s in &cfg.g.succs[p] {
+                if !lp.contains(s) {
+                    pinned.union(&cfg.live.live_in[s]);
+                }
+            }
+        }
+        if let Preheader::Existing(p) = *pre {
+            let mut args = vec![];
+            term_uses(&func.blocks[p].term, &mut args);
+            args.into_iter().for_each(|r| pinned.insert(r));
+        }
+        LoopFacts {
+            defs,
+            calls,
+            pinned,
+        }
+    }
+
+    fn invariant(&self, reg: usize) -> bool {
+        !self.defs.contains_key(&reg)
+    }
+
+    /// `header_prefix`: the instruction is in the header after only pure ones,
+    /// so it runs exactly when the loop is entered.
+    fn hoistable(&self, instr: &CpsInstr, header_prefix: bool) -> bool {
+        let Some(dst) = def_of(instr) else {
+            return false;
+        };
+        let allowed = match instr {
+            CpsInstr::BinOp(_, CpsBinOp::DivInt | CpsBinOp::ModInt, _, _) => header_prefix,
+            // The operand is a definitely-assigned list that nothing in the
+            // loop can resize, so the length cannot change or fail.
+            CpsInstr::ListLen(..) => !self.calls,
+            _ => is_pure(instr),
+        };
+        let mut uses = vec![];
+        instr_uses(instr, &mut uses);
+        allowed
+            && self.defs.get(&dst) == Some(&1)
+            && !self.pinned.contains(dst)
+            && uses.iter().all(|&r| self.invariant(r))
+    }
+}
+
+// ── Preheader ──
+
+enum Preheader {
+    /// The only outside predecessor, ending in `Jump(header, args)`.
+    Existing(usize),
+    /// Outside predecessors to reroute through a new block before the header.
+    Fresh(Vec<usize>),
+}
+
+fn place_in_preheader(func: &mut CpsFunction, lp: &Loop, pre: Preheader, instrs: Vec<CpsInstr>) {
+    match pre {
+        Preheader::Existing(p) => func.blocks[p].instrs.extend(instrs),
+        Preheader::Fresh(preds) => {
+            let header = func.blocks[lp.header].id;
+            let id = func
+                .blocks
+                .iter()
+                .filter(|b| b.id != usize::MAX)
+                .map(|b| b.id)
+                .max()
+                .unwrap_or(0)
+                + 1;
+            for p in preds {
+                retarget(&mut func.blocks[p].term, header, id);
+            }
+            func.blocks.insert(
+                lp.header,
+                CpsBlock {
+                    id,
+                    params: vec![],
+                    instrs,
+                    term: CpsTerminator::Jump(header, vec![]),
+                },
+            );
+        }
+    }
+}
+
+fn retarget(term: &mut CpsTerminator, from: usize, to: usize) {
+    let swap = |b: &mut usize| {
+        if *b == from {
+            *b = to;
+        }
+    };
+    match term {
+        CpsTerminator::Jump(b, _)
+        | CpsTerminator::Call(_, _, b)
+        | CpsTerminator::CallNative(_, _, b)
+        | CpsTerminator::CallIndirect(_, _, b)
+        | CpsTerminator::CallExternal { ret_block: b, .. }
+        | CpsTerminator::CallExternalDynamic { ret_block: b, .. } => swap(b),
+        CpsTerminator::Branch(_, t, _, f, _) => {
+            swap(t);
+            swap(f);
+        }
+        CpsTerminator::Return(_) | CpsTerminator::TailCall(..) | CpsTerminator::Suspend => {}
+    }
+}
+
+// ── Loops and dominators ──
+
+struct Loop {
+    /// Block position of the header.
+    header: usize,
+    /// Block positions in the loop, ascending.
+    body: Vec<usize>,
+}
+
+impl Loop {
+    fn contains(&self, p: usize) -> bool {
+        self.body.binary_search(&p).is_ok()
+    }
+}
+
+/// Dominators and liveness over block *positions* in `func.blocks`.
+struct Cfg {
+    g: Graph,
+    /// Immediate dominator; `usize::MAX` for unreachable blocks.
+    idom: Vec<usize>,
+    live: Liveness,
+}
+
+impl Cfg {
+    fn build(func: &CpsFunction) -> Cfg {
+        let g = Graph::build(func);
+        let (n, post, preds, entry) = (g.ids.len(), &g.post, &g.preds, g.entry);
+        let mut order = vec![usize::MAX; n];
+        for (i, &b) in post.iter().enumerate() {
+            order[b] = i;
+        }
+
+        // Cooper, Harvey & Kennedy: iterate over RPO until idoms settle.
+        let mut idom = vec![usize::MAX; n];
+        idom[entry] = entry;
+        let mut changed = true;
+        while changed {
+            changed = false;
+            for &b in post.iter().rev().skip(1) {
+                let mut new = usize::MAX;
+                for &p in &preds[b] {
+                    if idom[p] == usize::MAX {
+                        continue;
+                    }
+                    new = if new == usize::MAX {
+                        p
+                    } else {
+                        let (mut x, mut y) = (p, new);
+                        while x != y {
+                            while order[x] < order[y] {
+                                x = idom[x];
+                            }
+                            while order[y] < order[x] {
+                                y = idom[y];
+                            }
+                        }
+                        x
+                    };
+                }
+                if idom[b] != new {
+                    idom[b] = new;
+                    changed = true;
+                }
+            }
+        }
+
+        let live = Liveness::compute(func, &g);
+        Cfg { g, idom, live }
+    }
+
+    fn reachable(&self, p: usize) -> bool {
+        self.g.reachable[p]
+    }
+
+    fn dominates(&self, a: usize, mut b: usize) -> bool {
+        loop {
+            if a == b {
+                return true;
+            }
+            if b == self.g.entry {
+                return false;
+            }
+            b = self.idom[b];
+        }
+    }
+
+    /// Natural loops, one per header (back edges into the same header are
+    /// merged), smallest body first.
+    fn loops(&self) -> Vec<Loop> {
+        let mut bodies: HashMap<usize, HashSet<usize>> = HashMap::new();
+        for n in 0..self.g.succs.len() {
+            if !self.reachable(n) {
+                continue;
+            }
+            for &h in &self.g.succs[n] {
+                if !self.dominates(h, n) {
+                    continue;
+                }
+                let body = bodies.entry(h).or_insert_with(|| HashSet::from([h]));
+                let mut work = vec![n];
+                while let Some(m) = work.pop() {
+                    if body.insert(m) {
+                        work.extend(self.g.preds[m].iter().filter(|&&p| self.reachable(p)));
+                    }
+                }
+            }
+        }
+        let mut loops: Vec<Loop> = bodies
+            .into_iter()
+            .map(|(header, body)| {
+                let mut body: Vec<usize> = body.into_iter().collect();
+                body.sort_unstable();
+                Loop { header, body }
+            })
+            .collect();
+        loops.sort_by_key(|l| (l.body.len(), l.header));
+        loops
+    }
+
+    fn preheader(&self, func: &CpsFunction, lp: &Loop) -> Option<Preheader> {
+        let h = lp.header;
+        if h == self.g.entry {
+            return None;
+        }
+        let outside: Vec<usize> = self.g.preds[h]
+            .iter()
+            .copied()
+            .filter(|&p| !lp.contains(p) && self.reachable(p))
+            .collect();
+        match outside[..] {
+            [] => None,
+            [p] if matches!(func.blocks[p].term, CpsTerminator::Jump(..)) => {
+                Some(Preheader::Existing(p))
+            }
+            // A new block cannot bind header params, and must not displace the entry.
+            _ if func.blocks[h].params.is_empty() && h > self.g.entry => {
+                Some(Preheader::Fresh(outside))
+            }
+            _ => None,
+        }
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use kaubo_cps::test_util::{block, func};
+    use CpsInstr::*;
+    use CpsTerminator::*;
+
+    /// `i = 0; n = ..; while (i < n) { <body>; i = i + 1 }; return i`
+    fn counting_loop(mut body: Vec<CpsInstr>, latch: CpsTerminator) -> CpsFunction {
+        body.extend([LoadConst(4, 2), BinOp(1, CpsBinOp::AddInt, 1, 4)]);
+        func(
+            vec![
+                block(0, vec![LoadConst(1, 0), LoadConst(2, 1)], Jump(1, vec![])),
+                block(
+                    1,
+                    vec![BinOp(3, CpsBinOp::LtInt, 1, 2)],
+                    Branch(3, 2, vec![], 3, vec![]),
+                ),
+                block(2, body, latch),
+                block(3, vec![], Return(1)),
+            ],
+            16,
+        )
+    }
+
+    #[test]
+    fn hoists_invariant_constant_into_existing_preheader() {
+        let mut f = counting_loop(vec![], Jump(1, vec![]));
+        let stats = optimize_function(&mut f);
+        assert_eq!(
+            stats,
+            LoopStats {
+                loops: 1,
+                hoisted: 1,
+                reduced: 0
+            }
+        );
+        assert!(matches!(f.blocks[0].instrs[..], [_, _, LoadConst(4, 2)]));
+        assert!(matches!(
+            f.blocks[2].instrs[..],
+            [BinOp(1, CpsBinOp::AddInt, 1, 4)]
+        ));
+    }
+
+    #[test]
+    fn keeps_registers_read_before_their_write_or_written_twice() {
+        // r5 carries a value into the next iteration; r6 is written twice.
+        let body = vec![
+            Print(5),
+            LoadConst(5, 3),
+            LoadConst(6, 0),
+            Print(6),
+            LoadConst(6, 1),
+            Print(6),
+        ];
+        let mut f = counting_loop(body, Jump(1, vec![]));
+        let stats = optimize_function(&mut f);
+        assert_eq!(stats.hoisted, 1);
+        assert_eq!(f.blocks[2].instrs.len(), 7);
+    }
+
+    #[test]
+    fn inserts_preheader_when_header_is_entered_from_a_branch() {
+        let mut f = func(
+            vec![
+                block(
+                    0,
+                    vec![
+                        LoadConst(1, 0),
+                        LoadConst(2, 1),
+                        BinOp(3, CpsBinOp::LtInt, 1, 2),
+                    ],
+                    Branch(3, 1, vec![], 2, vec![]),
+                ),
+                block(
+                    1,
+                    vec![
+                        LoadConst(4, 2),
+                        BinOp(1, CpsBinOp::AddInt, 1, 4),
+                        BinOp(5, CpsBinOp::LtInt, 1, 2),
+                    ],
+                    Branch(5, 1, vec![], 2, vec![]),
+                ),
+                block(2, vec![], Return(1)),
+            ],
+            16,
+        );
+        assert_eq!(optimize_function(&mut f).hoisted, 1);
+        let ids: Vec<usize> = f.blocks.iter().map(|b| b.id).collect();
+        assert_eq!(ids, vec![0, 3, 1, 2]);
+        assert!(matches!(f.blocks[0].term, Branch(3, 3, _, 2, _)));
+        assert!(matches!(f.blocks[1].instrs[..], [LoadConst(4, 2)]));
+        assert!(matches!(f.blocks[1].term, Jump(1, _)));
+        // the back edge still targets the header
+        assert!(matches!(f.blocks[2].term, Branch(5, 1, _, 2, _)));
+    }
+
+    #[test]
+    fn reduces_product_of_induction_variable() {
+        // j = i * k in the body, with k = const and i += c.
+        let mut f = func(
+            vec![
+                block(
+                    0,
+                    vec![
+                        LoadConst(1, 0),
+                        LoadConst(2, 1),
+                        LoadConst(6, 2),
+                        LoadConst(4, 3),
+                    ],
+                    Jump(1, vec![]),
+                ),
+                block(
+                    1,
+                    vec![BinOp(3, CpsBinOp::LtInt, 1, 2)],
+                    Branch(3, 2, vec![], 3, vec![]),
+                ),
+                block(
+                    2,
+                    vec![
+                        BinOp(5, CpsBinOp::MulInt, 1, 6),
+                        Print(5),
+                        BinOp(1, CpsBinOp::AddInt, 1, 4),
+                    ],
+                    Jump(1, vec![]),
+                ),
+                block(3, vec![], Return(1)),
+            ],
+            16,
+        );
+        let stats = optimize_function(&mut f);
+        assert_eq!(stats.reduced, 1);
+        assert_eq!(f.reg_count, 17);
+        assert!(matches!(
+            f.blocks[0].instrs[4..],
+            [
+                BinOp(5, CpsBinOp::MulInt, 1, 6),
+                BinOp(16, CpsBinOp::MulInt, 4, 6)
+            ]
+        ));
+        assert!(matches!(
+            f.blocks[2].instrs[..],
+            [
+                Print(5),
+                BinOp(1, CpsBinOp::AddInt, 1, 4),
+                BinOp(5, CpsBinOp::AddInt, 5, 16)
+            ]
+        ));
+    }
+
+    #[test]
+    fn list_len_stays_in_loops_with_calls() {
+        let list_loop = |latch| {
+            let mut f = func(
+                vec![
+                    block(
+                        0,
+                        vec![NewList(1, vec![]), LoadConst(2, 0), LoadConst(5, 1)],
+                        Jump(1, vec![]),
+                    ),
+                    block(
+                        1,
+                        vec![ListLen(3, 1), BinOp(4, CpsBinOp::LtInt, 2, 3)],
+                        Branch(4, 2, vec![], 3, vec![]),
+                    ),
+                    block(2, vec![BinOp(2, CpsBinOp::AddInt, 2, 5)], latch),
+                    block(3, vec![], Return(2)),
+                    block(4, vec![], Jump(1, vec![])),
+                ],
+                16,
+            );
+            optimize_function(&mut f);
+            f.blocks[1].instrs.iter().any(|i| matches!(i, ListLen(..)))
+        };
+        assert!(!list_loop(Jump(1, vec![])));
+        assert!(list_loop(CallNative(0, vec![1], 4)));
     }
 }
@@ -3,34 +3,392 @@
 //! Passes transform CpsModule in-place. They do not depend on each other,
 //! on cps_build, on flatten, or on the VM.
 
-use crate::cps::CpsModule;
+use crate::cps::{Constant, CpsFunction, CpsInstr, CpsModule, StructDef};
 use kaubo_log::emit;
+use std::collections::HashMap;
+use std::sync::atomic::{AtomicUsize, Ordering};
+use std::sync::Mutex;
 
 pub mod binary;
+pub(crate) mod dataflow;
 pub mod empty_block;
+pub mod escape;
 pub mod fold;
+pub mod inline;
 pub mod loop_inline;
 pub mod move_fold;
+pub mod reg_alloc;
 
 pub trait Pass {
     fn name(&self) -> &'static str;
     fn run(&self, module: &mut CpsModule);
 }
 
+/// A pass that rewrites each function on its own.
+///
+/// It sees one function, the struct table and the constant pool; constants it
+/// needs go through `FunctionCtx` and are merged after the pass. Nothing else
+/// of the module is visible, so `run_function_pass` can hand different
+/// functions to different threads. Every `FunctionPass` is also a `Pass` that
+/// runs on the calling thread.
+pub trait FunctionPass: Sync {
+    fn name(&self) -> &'static str;
+    fn run_function(&self, func: &mut CpsFunction, ctx: &mut FunctionCtx<'_>);
+}
+
+impl<T: FunctionPass> Pass for T {
+    fn name(&self) -> &'static str {
+        FunctionPass::name(self)
+    }
+    fn run(&self, module: &mut CpsModule) {
+        run_on_functions(module, self, 1);
+    }
+}
+
+/// The module state one `FunctionPass` invocation may use.
+///
+/// The constant pool is the one from before the pass; constants the function
+/// adds are numbered after it and renumbered into the module, in function
+/// order, when the pass finishes. The result is the same however many threads
+/// ran the pass.
+pub struct FunctionCtx<'a> {
+    pub structs: &'a [StructDef],
+    constants: &'a [Constant],
+    added: Vec<Constant>,
+}
+
+impl<'a> FunctionCtx<'a> {
+    pub fn new(structs: &'a [StructDef], constants: &'a [Constant]) -> Self {
+        FunctionCtx {
+            structs,
+            constants,
+            added: vec![],
+        }
+    }
+
+    /// Constant `idx`, including the ones this function added.
+    pub fn constant(&self, idx: usize) -> Option<&Constant> {
+        match idx.checked_sub(self.constants.len()) {
+            None => self.constants.get(idx),
+            Some(i) => self.added.get(i),
+        }
+    }
+
+    /// Index of the integer constant `n`, adding it if there is none yet.
+    pub fn int_constant(&mut self, n: i64) -> usize {
+        let is_n = |c: &Constant| matches!(*c, Constant::Int(m) if m == n);
+        if let Some(i) = self.constants.iter().position(is_n) {
+            return i;
+        }
+        let base = self.constants.len();
+        if let Some(i) = self.added.iter().position(is_n) {
+            return base + i;
+        }
+        self.added.push(Constant::Int(n));
+        base + self.added.len() - 1
+    }
+
+    /// Constants this function added, in the order it added them.
+    pub fn added(&self) -> &[Constant] {
+        &self.added
+    }
+}
+
+/// Below this many functions per thread, spawning costs more than it saves.
+const FUNCTIONS_PER_THREAD: usize = 8;
+
+/// Runs `pass` on every function of `module`, spread over up to `threads`
+/// threads, and reports it like `run_passes` does.
+pub fn run_function_pass(
+    module: &mut CpsModule,
+    pass: &dyn FunctionPass,
+    threads: usize,
+    events: Option<&dyn kaubo_log::EventHandler>,
+) {
+    report(module, pass.name(), events, |module| {
+        run_on_functions(module, pass, threads)
+    });
+}
+
+fn run_on_functions(module: &mut CpsModule, pass: &dyn FunctionPass, threads: usize) {
+    let CpsModule {
+        functions,
+        constants,
+        structs,
+        ..
+    } = module;
+    let threads = threads.min(functions.len() / FUNCTIONS_PER_THREAD).max(1);
+    let added: Vec<Vec<Constant>> = if threads == 1 {
+        functions
+            .iter_mut()
+            .map(|func| {
+                let mut ctx = FunctionCtx::new(structs, constants);
+                pass.run_function(func, &mut ctx);
+                ctx.added
+            })
+            .collect()
+    } else {
+        // Functions differ too much in size for fixed chunks: workers claim
+        // them one at a time.
+        let work: Vec<Mutex<(&mut CpsFunction, Vec<Constant>)>> = functions
+            .iter_mut()
+            .map(|func| Mutex::new((func, vec![])))
+            .collect();
+        let next = AtomicUsize::new(0);
+        std::thread::scope(|scope| {
+            for _ in 0..threads {
+                scope.spawn(|| {
+                    while let Some(slot) = work.get(next.fetch_add(1, Ordering::Relaxed)) {
+                        let (func, added) = &mut *slot.lock().unwrap();
+                        let mut ctx = FunctionCtx::new(structs, constants);
+                        pass.run_function(func, &mut ctx);
+                        *added = ctx.added;
+                    }
+                });
+            }
+        });
+        work.into_iter()
+            .map(|slot| slot.into_inner().unwrap().1)
+            .collect()
+    };
+    merge_constants(functions, constants, added);
+}
+
+/// Appends each function's added constants to the pool, reusing equal ones,
+/// and renumbers the function's `LoadConst`s to match.
+fn merge_constants(
+    functions: &mut [CpsFunction],
+    constants: &mut Vec<Constant>,
+    added: Vec<Vec<Constant>>,
+) {
+    let base = constants.len();
+    let mut slots: HashMap<ConstKey, usize> = HashMap::new();
+    for (i, c) in constants.iter().enumerate() {
+        slots.entry(ConstKey::of(c)).or_insert(i);
+    }
+    for (func, added) in functions.iter_mut().zip(added) {
+        if added.is_empty() {
+            continue;
+        }
+        let remap: Vec<usize> = added
+            .into_iter()
+            .map(|c| {
+                *slots.entry(ConstKey::of(&c)).or_insert_with(|| {
+                    constants.push(c);
+                    constants.len() - 1
+                })
+            })
+            .collect();
+        if remap.iter().enumerate().all(|(i, &k)| k == base + i) {
+            continue;
+        }
+        for instr in func.blocks.iter_mut().flat_map(|b| &mut b.instrs) {
+            if let CpsInstr::LoadConst(_, k) = instr {
+                if *k >= base {
+                    *k = remap[*k - base];
+                }
+            }
+        }
+    }
+}
+
+/// What makes two constants interchangeable: floats compare by bits, so
+/// `0.0` and `-0.0` stay apart and a NaN matches itself.
+#[derive(PartialEq, Eq, Hash)]
+enum ConstKey {
+    Int(i64),
+    Float(u64),
+    String(String),
+    Bool(bool),
+    Null,
+}
+
+impl ConstKey {
+    fn of(c: &Constant) -> Self {
+        match c {
+            Constant::Int(n) => ConstKey::Int(*n),
+            Constant::Float(f) => ConstKey::Float(f.to_bits()),
+            Constant::String(s) => ConstKey::String(s.clone()),
+            Constant::Bool(b) => ConstKey::Bool(*b),
+            Constant::Null => ConstKey::Null,
+        }
+    }
+}
+
 pub fn run_passes(
     module: &mut CpsModule,
     passes: &[&dyn Pass],
     events: Option<&dyn kaubo_log::EventHandler>,
 ) {
     for pass in passes {
-        emit!(
-            events,
-            kaubo_log::ToolchainEvent::Pass(kaubo_log::PassEvent::Started { name: pass.name() })
-        );
-        pass.run(module);
-        emit!(
-            events,
-            kaubo_log::ToolchainEvent::Pass(kaubo_log::PassEvent::Finished { name: pass.name() })
-        );
+        report(module, pass.name(), events, |module| pass.run(module));
+    }
+}
+
+/// Runs one pass between `Started` and `Finished` events, with the size,
+/// frame and allocation events in between when anyone is listening.
+// The counts are read only by `emit!`, which compiles away without
+// `kaubo-debug-log`.
+#[allow(unused_variables)]
+fn report(
+    module: &mut CpsModule,
+    name: &'static str,
+    events: Option<&dyn kaubo_log::EventHandler>,
+    run: impl FnOnce(&mut CpsModule),
+) {
+    emit!(
+        events,
+        kaubo_log::ToolchainEvent::Pass(kaubo_log::PassEvent::Started { name })
+    );
+    let before = events.map(|_| {
+        let allocs: Vec<usize> = module
+            .functions
+            .iter()
+            .map(escape::allocation_sites)
+            .collect();
+        (
+            instruction_count(module),
+            frame_size(module),
+            allocs,
+            std::time::Instant::now(),
+        )
+    });
+    run(module);
+    let Some((instrs, regs, allocs, start)) = before else {
+        return;
+    };
+    let micros = start.elapsed().as_micros() as u64;
+    let (instrs_after, regs_after) = (instruction_count(module), frame_size(module));
+    emit!(
+        events,
+        kaubo_log::ToolchainEvent::Pass(kaubo_log::PassEvent::InstrCount {
+            name,
+            before: instrs,
+            after: instrs_after,
+        })
+    );
+    emit!(
+        events,
+        kaubo_log::ToolchainEvent::Pass(kaubo_log::PassEvent::FrameSize {
+            name,
+            before: regs,
+            after: regs_after,
+        })
+    );
+    // Per function, and only where the pass changed something.
+    for (func, before) in module.functions.iter().zip(allocs) {
+        let after = escape::allocation_sites(func);
+        if after != before {
+            emit!(
+                events,
+                kaubo_log::ToolchainEvent::Pass(kaubo_log::PassEvent::Allocations {
+                    name,
+                    function: func.name.clone(),
+                    before,
+                    after,
+                })
+            );
+        }
+    }
+    emit!(
+        events,
+        kaubo_log::ToolchainEvent::Pass(kaubo_log::PassEvent::Finished {
+            name,
+            micros,
+            instructions: instrs_after as i64 - instrs as i64,
+            registers: regs_after as i64 - regs as i64,
+        })
+    );
+}
+
+/// Static size of a module: every instruction plus one terminator per block.
+pub fn instruction_count(module: &CpsModule) -> usize {
+    module
+        .functions
+        .iter()
+        .flat_map(|func| &func.blocks)
+        .map(|block| block.instrs.len() + 1)
+        .sum()
+}
+
+/// Frame size of a module: the registers every function reserves per call.
+pub fn frame_size(module: &CpsModule) -> usize {
+    module.functions.iter().map(|func| func.reg_count).sum()
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::cps::*;
+    use crate::pass::fold::ConstantFold;
+    use CpsInstr::*;
+
+    /// `n` functions, function `i` returning `i % 7 + i % 5`: the folded
+    /// sums repeat across functions, and some are already in the pool.
+    fn module(n: usize) -> CpsModule {
+        let functions = (0..n)
+            .map(|i| CpsFunction {
+                name: format!("f{i}"),
+                blocks: vec![CpsBlock {
+                    id: 0,
+                    params: vec![],
+                    instrs: vec![
+                        LoadConst(1, i % 7),
+                        LoadConst(2, i % 5),
+                        BinOp(3, CpsBinOp::AddInt, 1, 2),
+                    ],
+                    term: CpsTerminator::Return(3),
+                }],
+                entry: 0,
+                reg_count: 4,
+            })
+            .collect();
+        CpsModule {
+            functions,
+            constants: (0..7).map(Constant::Int).collect(),
+            structs: vec![],
+            enums: vec![],
+            vtables: vec![],
+            symbol_map: Default::default(),
+            func_owners: vec![],
+        }
+    }
+
+    #[test]
+    fn parallel_run_matches_serial_run() {
+        let mut serial = module(64);
+        let mut parallel = module(64);
+        run_function_pass(&mut serial, &ConstantFold, 1, None);
+        run_function_pass(&mut parallel, &ConstantFold, 4, None);
+        assert_eq!(format!("{serial:?}"), format!("{parallel:?}"));
+
+        // Sums 0..=10; 0..=6 were already in the pool.
+        assert_eq!(serial.constants.len(), 11);
+        for (i, func) in serial.functions.iter().enumerate() {
+            let LoadConst(3, k) = func.blocks[0].instrs[2] else {
+                panic!("{:?}", func.blocks[0].instrs)
+            };
+            assert!(matches!(serial.constants[k], Constant::Int(n) if n == (i % 7 + i % 5) as i64));
+        }
+    }
+
+    #[test]
+    fn function_pass_is_a_module_pass() {
+        let mut direct = module(64);
+        let mut threaded = module(64);
+        ConstantFold.run(&mut direct);
+        run_function_pass(&mut threaded, &ConstantFold, 8, None);
+        assert_eq!(format!("{direct:?}"), format!("{threaded:?}"));
+    }
+
+    #[test]
+    fn added_constants_continue_the_pool() {
+        let constants = [Constant::Int(5)];
+        let mut ctx = FunctionCtx::new(&[], &constants);
+        assert_eq!(ctx.int_constant(5), 0);
+        assert_eq!(ctx.int_constant(9), 1);
+        assert_eq!(ctx.int_constant(9), 1);
+        assert!(matches!(ctx.constant(1), Some(Constant::Int(9))));
+        assert_eq!(ctx.added().len(), 1);
     }
 }
@@ -3,19 +3,17 @@
 //! Pattern:  BinOp(tmp, op, a, b);  Move(final, tmp)
 //! Becomes:  BinOp(final, op, a, b)  (Move eliminated)
 
-use super::Pass;
+use super::{FunctionCtx, FunctionPass};
 use crate::cps::*;
 
 pub struct MoveFold;
 
-impl Pass for MoveFold {
+impl FunctionPass for MoveFold {
     fn name(&self) -> &'static str {
         "move-fold"
     }
-    fn run(&self, module: &mut CpsModule) {
-        for func in &mut module.functions {
-            fold_moves(func);
-        }
+    fn run_function(&self, func: &mut CpsFunction, _: &mut FunctionCtx<'_>) {
+        fold_moves(func);
     }
 }
 
@@ -103,6 +101,7 @@ mod tests {
     use super::*;
     use crate::cps_build::build_module;
     use crate::flatten::flatten_module;
+    use crate::pass::Pass;
     use crate::test_fixtures;
 
     fn optimize(src: &str) -> CpsModule {
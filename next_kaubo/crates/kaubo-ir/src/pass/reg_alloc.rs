@@ -0,0 +1,457 @@
+//! Register allocation — pack each function's registers into a smaller frame.
+//!
+//! cps_build and the earlier passes hand out a fresh register for every
+//! temporary, so `reg_count` grows with the size of the function rather than
+//! with how many values are alive at once.  This pass builds an interference
+//! graph from liveness and colours it greedily, then renames every register
+//! field and sets `reg_count` to the number of colours used.
+//!
+//! Liveness here is precise about the two implicit writes the VM performs:
+//!   - a Jump / Branch / TailCall edge writes the target's params from its
+//!     args (in parallel), so params are defined on the edge, not live above it;
+//!   - a call writes its result into `r0` before resuming at the return block.
+//!
+//! Copies are coalesced by preferring the colour of a `Move` source or of the
+//! edge arg bound to a param; `Move(r, r)` left behind is deleted and the VM
+//! already skips self-moves on edges.
+//!
+//! The calling convention fixes two things, so they keep their numbers:
+//! `r0` (where call results land) and every register live into the entry block
+//! (the incoming arguments, or anything read before it is written).  Other
+//! values may still be coloured 0 wherever no call result is pending.
+
+use super::dataflow::*;
+use super::{FunctionCtx, FunctionPass};
+use crate::cps::*;
+use std::collections::HashMap;
+
+pub struct RegAlloc;
+
+impl FunctionPass for RegAlloc {
+    fn name(&self) -> &'static str {
+        "reg-alloc"
+    }
+    fn run_function(&self, func: &mut CpsFunction, _: &mut FunctionCtx<'_>) {
+        allocate(func);
+    }
+}
+
+/// Renames the registers of `func` and shrinks its `reg_count`.
+///
+/// Functions that suspend are left alone: their frames are captured and
+/// resumed by the async runtime, which addresses registers by number.
+pub fn allocate(func: &mut CpsFunction) {
+    if func.blocks.is_empty()
+        || func
+            .blocks
+            .iter()
+            .any(|b| b.id != usize::MAX && matches!(b.term, CpsTerminator::Suspend))
+    {
+        return;
+    }
+    let graph = Graph::build(func);
+    let regs = max_reg(func) + 1;
+    let pos: HashMap<usize, usize> = graph
+        .ids
+        .iter()
+        .enumerate()
+        .filter(|(_, &id)| id != usize::MAX)
+        .map(|(p, &id)| (id, p))
+        .collect();
+    let live_in = live_in_sets(func, &graph, &pos, regs);
+    let (conflicts, partners) = interference(func, &graph, &pos, &live_in, regs);
+
+    let mut pinned = live_in[graph.entry].clone();
+    pinned.insert(0);
+    let color = assign_colors(func, &graph, &pinned, &conflicts, &partners);
+    rename(func, &color);
+}
+
+// ── Liveness ──
+
+/// Blocks entered over edges that bind params from args.
+fn edges(term: &CpsTerminator) -> Vec<(usize, &[usize])> {
+    match term {
+        CpsTerminator::Jump(b, args) => vec![(*b, args.as_slice())],
+        CpsTerminator::Branch(_, t, ta, f, fa) => vec![(*t, ta.as_slice()), (*f, fa.as_slice())],
+        CpsTerminator::TailCall(_, args) => vec![(0, args.as_slice())],
+        _ => vec![],
+    }
+}
+
+/// Registers the VM writes on the edge from an `args` list into block `s`:
+/// the params that have an arg to bind them.
+fn bound_params<'a>(func: &'a CpsFunction, s: usize, args: &[usize]) -> &'a [usize] {
+    let params = &func.blocks[s].params;
+    &params[..params.len().min(args.len())]
+}
+
+/// Registers live just before the terminator of block `b`.
+fn live_out(
+    func: &CpsFunction,
+    pos: &HashMap<usize, usize>,
+    live_in: &[RegSet],
+    b: usize,
+    regs: usize,
+) -> RegSet {
+    let term = &func.blocks[b].term;
+    let mut out = RegSet::new(regs);
+    if is_call(term) {
+        for s in targets(term).iter().filter_map(|id| pos.get(id)) {
+            out.union(&live_in[*s]);
+        }
+        out.remove(0);
+    }
+    for (id, args) in edges(term) {
+        if let Some(&s) = pos.get(&id) {
+            let mut through = live_in[s].clone();
+            bound_params(func, s, args)
+                .iter()
+                .for_each(|&p| through.remove(p));
+            out.union(&through);
+        }
+    }
+    let mut uses = vec![];
+    term_uses(term, &mut uses);
+    uses.iter().for_each(|&r| out.insert(r));
+    out
+}
+
+/// Backward transfer over one instruction: `live` goes from after to before.
+fn step(instr: &CpsInstr, params: &[usize], live: &mut RegSet, uses: &mut Vec<usize>) {
+    if let Some(d) = def_of(instr) {
+        live.remove(d);
+    }
+    uses.clear();
+    vm_uses(instr, params, uses);
+    uses.iter().for_each(|&r| live.insert(r));
+}
+
+fn live_in_sets(
+    func: &CpsFunction,
+    graph: &Graph,
+    pos: &HashMap<usize, usize>,
+    regs: usize,
+) -> Vec<RegSet> {
+    let mut live_in = vec![RegSet::new(regs); graph.ids.len()];
+    let mut uses = vec![];
+    let mut changed = true;
+    while changed {
+        changed = false;
+        for &b in &graph.post {
+            let block = &func.blocks[b];
+            let mut live = live_out(func, pos, &live_in, b, regs);
+            for instr in block.instrs.iter().rev() {
+                step(instr, &block.params, &mut live, &mut uses);
+            }
+            if live != live_in[b] {
+                live_in[b] = live;
+                changed = true;
+            }
+        }
+    }
+    live_in
+}
+
+// ── Interference ──
+
+/// Conflict sets per register, and the registers each one is copied from or to.
+fn interference(
+    func: &CpsFunction,
+    graph: &Graph,
+    pos: &HashMap<usize, usize>,
+    live_in: &[RegSet],
+    regs: usize,
+) -> (Vec<RegSet>, Vec<Vec<usize>>) {
+    let mut conflicts = vec![RegSet::new(regs); regs];
+    let mut partners = vec![vec![]; regs];
+    let mut interfere = |a: usize, b: usize| {
+        if a != b {
+            conflicts[a].insert(b);
+            conflicts[b].insert(a);
+        }
+    };
+    let mut uses = vec![];
+    for &b in &graph.post {
+        let block = &func.blocks[b];
+
+        // The call result lands in r0 while everything live into the
+        // return block still holds its value.
+        if is_call(&block.term) {
+            for s in targets(&block.term).iter().filter_map(|id| pos.get(id)) {
+                live_in[*s].iter().for_each(|r| interfere(0, r));
+            }
+        }
+        // Edge moves write every bound param, live or not, at once.
+        for (id, args) in edges(&block.term) {
+            let Some(&s) = pos.get(&id) else { continue };
+            let params = bound_params(func, s, args);
+            let mut through = live_in[s].clone();
+            params.iter().for_each(|&p| through.remove(p));
+            for (i, (&p, &a)) in params.iter().zip(args).enumerate() {
+                partners[p].push(a);
+                partners[a].push(p);
+                through
+                    .iter()
+                    .filter(|&r| r != a)
+                    .for_each(|r| interfere(p, r));
+                for (&q, &qa) in params[..i].iter().zip(args) {
+                    if qa != a {
+                        interfere(p, q);
+                    }
+                }
+            }
+        }
+
+        let mut live = live_out(func, pos, live_in, b, regs);
+        for instr in block.instrs.iter().rev() {
+            if let Some(d) = def_of(instr) {
+                let src = match *instr {
+                    CpsInstr::Move(_, s) => {
+                        partners[d].push(s);
+                        partners[s].push(d);
+                        Some(s)
+                    }
+                    _ => None,
+                };
+                live.iter()
+                    .filter(|&r| Some(r) != src)
+                    .for_each(|r| interfere(d, r));
+            }
+            step(instr, &block.params, &mut live, &mut uses);
+        }
+    }
+    (conflicts, partners)
+}
+
+// ── Colouring and rewrite ──
+
+/// Greedy colouring in order of first appearance (reverse postorder).
+/// Pinned registers keep their own number; every other register takes a
+/// copy partner's colour when it can, else the lowest free one.
+fn assign_colors(
+    func: &CpsFunction,
+    graph: &Graph,
+    pinned: &RegSet,
+    conflicts: &[RegSet],
+    partners: &[Vec<usize>],
+) -> Vec<usize> {
+    let regs = conflicts.len();
+    let mut color = vec![usize::MAX; regs];
+    pinned.iter().for_each(|r| color[r] = r);
+
+    let mut order = vec![];
+    for &b in graph.post.iter().rev() {
+        let block = &func.blocks[b];
+        order.extend(&block.params);
+        for instr in &block.instrs {
+            order.extend(def_of(instr));
+            vm_uses(instr, &block.params, &mut order);
+        }
+        term_uses(&block.term, &mut order);
+    }
+
+    for r in order {
+        if color[r] != usize::MAX {
+            continue;
+        }
+        let free = |c: usize| conflicts[r].iter().all(|n| color[n] != c);
+        color[r] = partners[r]
+            .iter()
+            .map(|&p| color[p])
+            .find(|&c| c != usize::MAX && free(c))
+            .unwrap_or_else(|| (0..).find(|&c| free(c)).unwrap());
+    }
+    color
+}
+
+/// Applies `color` to every register field and sets `reg_count`.
+/// Registers that only appear in unreachable blocks map to `r0`.
+fn rename(func: &mut CpsFunction, color: &[usize]) {
+    let map = |r: &mut usize| {
+        let c = color[*r];
+        *r = if c == usize::MAX { 0 } else { c };
+    };
+    let mut top = 0;
+    for block in func.blocks.iter_mut().filter(|b| b.id != usize::MAX) {
+        block.params.iter_mut().for_each(map);
+        for instr in &mut block.instrs {
+            instr_regs_mut(instr, map);
+        }
+        term_regs_mut(&mut block.term, map);
+        block
+            .instrs
+            .retain(|i| !matches!(i, CpsInstr::Move(d, s) if d == s));
+
+        let mut regs = block.params.clone();
+        for instr in &block.instrs {
+            regs.extend(def_of(instr));
+            instr_uses(instr, &mut regs);
+        }
+        term_uses(&block.term, &mut regs);
+        top = regs.into_iter().fold(top, usize::max);
+    }
+    func.reg_count = top + 1;
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use kaubo_cps::test_util::{block_with, func};
+    use CpsInstr::*;
+    use CpsTerminator::*;
+
+    #[test]
+    fn dead_temporaries_share_registers() {
+        // Two independent `a + b` chains: the second reuses the first's slots.
+        let mut f = func(
+            vec![block_with(
+                0,
+                vec![],
+                vec![
+                    LoadConst(1, 0),
+                    LoadConst(2, 1),
+                    BinOp(3, CpsBinOp::AddInt, 1, 2),
+                    Print(3),
+                    LoadConst(4, 0),
+                    LoadConst(5, 1),
+                    BinOp(6, CpsBinOp::AddInt, 4, 5),
+                    Print(6),
+                ],
+                Return(6),
+            )],
+            7,
+        );
+        allocate(&mut f);
+        assert_eq!(f.reg_count, 2);
+        let instrs = &f.blocks[0].instrs;
+        assert!(matches!(instrs[4], LoadConst(0, 0)));
+        assert!(matches!(instrs[6], BinOp(0, CpsBinOp::AddInt, 0, 1)));
+    }
+
+    #[test]
+    fn arguments_and_r0_keep_their_numbers() {
+        // `|a, b| { t = a * b; call; return t + r0 }`: regs 0 and 1 are the
+        // incoming args, t lives across the call so it cannot take r0.
+        let mut f = func(
+            vec![
+                block_with(
+                    0,
+                    vec![],
+                    vec![BinOp(5, CpsBinOp::MulInt, 0, 1)],
+                    Call(1, vec![5], 1),
+                ),
+                block_with(1, vec![], vec![BinOp(7, CpsBinOp::AddInt, 5, 0)], Return(7)),
+            ],
+            8,
+        );
+        allocate(&mut f);
+        let BinOp(t, _, 0, 1) = f.blocks[0].instrs[0] else {
+            panic!("{:?}", f.blocks[0].instrs)
+        };
+        assert!(t != 0);
+        assert!(matches!(f.blocks[0].term, Call(1, ref a, 1) if a == &[t]));
+        assert!(matches!(f.blocks[1].instrs[0], BinOp(_, CpsBinOp::AddInt, x, 0) if x == t));
+        assert_eq!(f.reg_count, 2);
+    }
+
+    #[test]
+    fn block_param_copies_are_coalesced() {
+        // Loop counter passed around as a block param, plus a Move chain.
+        let mut f = func(
+            vec![
+                block_with(0, vec![], vec![LoadConst(3, 0)], Jump(1, vec![3])),
+                block_with(
+                    1,
+                    vec![4],
+                    vec![LoadConst(5, 1), BinOp(6, CpsBinOp::LtInt, 4, 5)],
+                    Branch(6, 2, vec![], 3, vec![]),
+                ),
+                block_with(
+                    2,
+                    vec![],
+                    vec![
+                        LoadConst(7, 2),
+                        BinOp(8, CpsBinOp::AddInt, 4, 7),
+                        Move(9, 8),
+                    ],
+                    Jump(1, vec![9]),
+                ),
+                block_with(3, vec![], vec![], Return(4)),
+            ],
+            10,
+        );
+        allocate(&mut f);
+        let counter = f.blocks[1].params[0];
+        assert!(matches!(f.blocks[0].term, Jump(1, ref a) if a == &[counter]));
+        assert!(matches!(f.blocks[2].term, Jump(1, ref a) if a == &[counter]));
+        assert!(!f.blocks[2].instrs.iter().any(|i| matches!(i, Move(..))));
+        assert!(matches!(f.blocks[3].term, Return(r) if r == counter));
+        assert!(f.reg_count <= 3, "reg_count {}", f.reg_count);
+    }
+
+    #[test]
+    fn swapped_params_do_not_collapse() {
+        // Jump(1, [b, a]) into params [a, b] swaps them; both must survive.
+        let mut f = func(
+            vec![
+                block_with(
+                    0,
+                    vec![],
+                    vec![LoadConst(1, 0), LoadConst(2, 1)],
+                    Jump(1, vec![1, 2]),
+                ),
+                block_with(
+                    1,
+                    vec![1, 2],
+                    vec![BinOp(3, CpsBinOp::LtInt, 1, 2)],
+                    Branch(3, 1, vec![2, 1], 2, vec![]),
+                ),
+                block_with(2, vec![], vec![BinOp(4, CpsBinOp::SubInt, 1, 2)], Return(4)),
+            ],
+            5,
+        );
+        allocate(&mut f);
+        let [a, b] = f.blocks[1].params[..] else {
+            panic!()
+        };
+        assert!(a != b);
+        assert!(matches!(f.blocks[1].term, Branch(_, 1, ref s, 2, _) if s == &[b, a]));
+        assert!(
+            matches!(f.blocks[2].instrs[0], BinOp(_, CpsBinOp::SubInt, x, y) if x == a && y == b)
+        );
+    }
+
+    #[test]
+    fn aggregate_elements_follow_their_block_params() {
+        // NewList reads the block params; params and element list stay in step.
+        let mut f = func(
+            vec![
+                block_with(
+                    0,
+                    vec![],
+                    vec![LoadConst(5, 0), LoadConst(6, 1)],
+                    Jump(1, vec![5, 6]),
+                ),
+                block_with(1, vec![7, 8], vec![NewList(9, vec![7, 8])], Return(9)),
+            ],
+            10,
+        );
+        allocate(&mut f);
+        let params = f.blocks[1].params.clone();
+        assert!(params[0] != params[1]);
+        assert!(matches!(f.blocks[1].instrs[0], NewList(_, ref e) if e == &params));
+        assert!(matches!(f.blocks[0].term, Jump(1, ref a) if a == &params));
+    }
+
+    #[test]
+    fn suspending_functions_are_untouched() {
+        let mut f = func(
+            vec![block_with(0, vec![], vec![LoadConst(9, 0)], Suspend)],
+            10,
+        );
+        allocate(&mut f);
+        assert_eq!(f.reg_count, 10);
+        assert!(matches!(f.blocks[0].instrs[0], LoadConst(9, 0)));
+    }
+}
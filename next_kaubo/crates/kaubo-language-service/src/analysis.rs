@@ -0,0 +1,1897 @@
+//! Incremental document analysis shared by [`LspCoordinator`] and
+//! [`DagLspCoordinator`].
+//!
+//! A document is kept as a sorted list of top-level declarations. A text edit
+//! reparses only the declarations it touches (and the gap between their
+//! neighbours) and shifts the byte offsets of everything after it. Inference
+//! then re-runs only declarations whose own text or whose dependencies
+//! changed. Per-declaration types live in a DAG [`ArtifactStore`]: a
+//! declaration is clean while its artifact is ready. The store's
+//! reverse-dependency index says which declarations to re-check after one
+//! declaration's types change.
+//!
+//! Spans inside a declaration stay relative to the text it was parsed from.
+//! They are mapped to document positions only when a query needs them, so an
+//! edit never touches a declaration it did not reparse, beyond shifting its
+//! start.
+//!
+//! [`LspCoordinator`]: crate::LspCoordinator
+//! [`DagLspCoordinator`]: crate::DagLspCoordinator
+
+use crate::{CompletionItem, HoverInfo, InlayHint, SymbolDef, SymbolKind};
+use kaubo_ast::{BinOp, Expr, Span, Stmt};
+use kaubo_dag::{Artifact, ArtifactKey, ArtifactStore, ContentHash, Kind};
+use kaubo_driver::protocol::BuildError;
+use kaubo_infer::{Scheme, StmtTypes, Type, TypeEnv, TypeIds, TypeVar};
+use kaubo_syntax::{Lexer, ParseNames, Parser, TokenKind};
+use std::collections::{BTreeSet, HashMap, HashSet};
+use std::ops::Range;
+use std::sync::Arc;
+
+/// Kind of the per-declaration type artifacts in the store.
+const DECL_TYPES: &str = "DeclTypes";
+
+/// A text replacement: chars `start..end` of the current text become `text`.
+///
+/// Offsets are char offsets, like every other offset in this crate. A batch
+/// of edits applies in order, each against the result of the previous one
+/// (the LSP `contentChanges` convention).
+#[derive(Debug, Clone, PartialEq, Eq)]
+pub struct TextEdit {
+    pub start: usize,
+    pub end: usize,
+    pub text: String,
+}
+
+/// Inferred bindings of one declaration: the artifact cached per declaration.
+#[derive(Debug)]
+struct DeclTypes {
+    bindings: Vec<(String, Scheme)>,
+    /// Some binding had free type variables right after its statement, so
+    /// later declarations may refine it and the types cannot be reused on
+    /// their own.
+    open: bool,
+}
+
+impl DeclTypes {
+    fn get(&self, name: &str) -> Option<&Scheme> {
+        self.bindings
+            .iter()
+            .find(|(n, _)| n == name)
+            .map(|(_, s)| s)
+    }
+
+    /// Same names with alpha-equivalent types. Open types never compare equal.
+    fn same_as(&self, other: &DeclTypes) -> bool {
+        !self.open
+            && !other.open
+            && self.bindings.len() == other.bindings.len()
+            && self
+                .bindings
+                .iter()
+                .zip(&other.bindings)
+                .all(|((a, sa), (b, sb))| a == b && alpha_eq(&sa.body, &sb.body))
+    }
+}
+
+/// What an identifier occurrence inside a declaration stands for.
+#[derive(Debug, Clone)]
+enum Target {
+    /// Definition of the declaration's `symbols[i]`.
+    Def(usize),
+    /// Use of a name, resolved when queried.
+    Ref(String),
+}
+
+/// An identifier occurrence; offsets are bytes from the declaration start.
+#[derive(Debug, Clone)]
+struct Occurrence {
+    start: usize,
+    end: usize,
+    target: Target,
+}
+
+/// A place that may get an inlay hint once types are known.
+#[derive(Debug, Clone)]
+struct HintSite {
+    /// Byte offset of the name's span from the declaration start.
+    at: usize,
+    /// Name looked up in the type environment.
+    lookup: String,
+    /// Name as written in source, when it differs from `lookup`.
+    shown: Option<String>,
+    /// Type guessed from a literal initializer, used when `lookup` is unbound.
+    guess: Option<&'static str>,
+}
+
+/// One top-level statement of the document.
+#[derive(Debug)]
+struct Decl {
+    /// Stable across edits that leave the declaration's text alone.
+    id: u64,
+    key: ArtifactKey<String>,
+    /// Byte range in the document.
+    start: usize,
+    len: usize,
+    hash: ContentHash,
+    /// Line and column of `start` in the text the declaration was parsed
+    /// from; `stmt` and `symbols` spans share that frame.
+    anchor: Span,
+    stmt: Stmt,
+    /// Names inference binds for this statement.
+    bindings: Vec<String>,
+    /// Keys other declarations depend on: the bindings, plus `.m` for every
+    /// method `S.m` (a member access does not say which struct it hits).
+    defines: Vec<String>,
+    /// Names this statement looks up: variables, and `.field` for member
+    /// accesses and user operator dispatch.
+    refs: Vec<String>,
+    /// Ids of the declarations providing `refs`.
+    deps: Vec<u64>,
+    symbols: Vec<SymbolDef>,
+    /// Sorted by `start`.
+    occurrences: Vec<Occurrence>,
+    hints: Vec<HintSite>,
+    /// Struct names and enum variants the parser needs to know about.
+    names: ParseNames,
+    /// Last successful inference result; kept while the declaration is dirty
+    /// so queries still have something to show.
+    types: Option<Arc<DeclTypes>>,
+}
+
+impl Decl {
+    fn end(&self) -> usize {
+        self.start + self.len
+    }
+
+    fn symbol_names(&self) -> BTreeSet<&str> {
+        self.symbols.iter().map(|s| s.name.as_str()).collect()
+    }
+}
+
+/// Document analysis: declarations, per-name indexes, and inference state.
+pub(crate) struct Analysis {
+    doc: String,
+    text: String,
+    ascii: bool,
+    /// Text the declarations describe, while `text` does not parse.
+    stale: Option<String>,
+    /// Line start offsets of the text the declarations describe.
+    lines: Vec<usize>,
+    decls: Vec<Decl>,
+    next_id: u64,
+    /// Declaration id → position in `decls`.
+    index: HashMap<u64, usize>,
+    /// Dependency key (see [`Decl::defines`]) → declarations defining it.
+    definers: HashMap<String, Vec<u64>>,
+    /// Symbol name → declarations with a symbol of that name.
+    named: HashMap<String, Vec<u64>>,
+    /// Referenced name → declarations referencing it.
+    referrers: HashMap<String, HashSet<u64>>,
+    ids: TypeIds,
+    prelude: TypeEnv,
+    /// The next sync must reparse the whole text.
+    reparse: bool,
+    ready: bool,
+    /// Declarations inferred by the last sync.
+    #[cfg(test)]
+    pub(crate) inferred: Vec<String>,
+}
+
+impl Analysis {
+    /// An empty document whose store keys are prefixed with `doc`.
+    pub(crate) fn new(doc: &str) -> Self {
+        Analysis {
+            doc: doc.to_string(),
+            text: String::new(),
+            ascii: true,
+            stale: None,
+            lines: vec![0],
+            decls: Vec::new(),
+            next_id: 0,
+            index: HashMap::new(),
+            definers: HashMap::new(),
+            named: HashMap::new(),
+            referrers: HashMap::new(),
+            ids: TypeIds::default(),
+            prelude: kaubo_infer::prelude_env(),
+            reparse: false,
+            ready: false,
+            #[cfg(test)]
+            inferred: Vec::new(),
+        }
+    }
+
+    /// Whether inference has succeeded at least once.
+    pub(crate) fn is_ready(&self) -> bool {
+        self.ready
+    }
+
+    /// Replace the whole text. Only the changed middle (common prefix and
+    /// suffix removed) is treated as edited.
+    pub(crate) fn set_text(
+        &mut self,
+        store: &ArtifactStore<String>,
+        source: &str,
+    ) -> Result<(), BuildError> {
+        let (old, new) = (self.text.as_bytes(), source.as_bytes());
+        let mut pre = old.iter().zip(new).take_while(|(a, b)| a == b).count();
+        while !source.is_char_boundary(pre) {
+            pre -= 1;
+        }
+        let max = old.len().min(new.len()) - pre;
+        let mut suf = old
+            .iter()
+            .rev()
+            .zip(new.iter().rev())
+            .take(max)
+            .take_while(|(a, b)| a == b)
+            .count();
+        while !source.is_char_boundary(new.len() - suf) {
+            suf -= 1;
+        }
+        let end = old.len() - suf;
+        if pre != end || pre != new.len() - suf {
+            self.edit(store, pre, end, &source[pre..new.len() - suf]);
+        }
+        self.sync(store)
+    }
+
+    /// Apply `edits` in order, then bring parse and types up to date.
+    pub(crate) fn apply_edits(
+        &mut self,
+        store: &ArtifactStore<String>,
+        edits: &[TextEdit],
+    ) -> Result<(), BuildError> {
+        for e in edits {
+            let start = byte_of(&self.text, self.ascii, e.start);
+            let end = byte_of(&self.text, self.ascii, e.end.max(e.start));
+            self.edit(store, start, end, &e.text);
+        }
+        self.sync(store)
+    }
+
+    // ── Parsing ─────────────────────────────────────────────────────
+
+    /// Replace bytes `start..end` with `new`, reparsing the affected region
+    /// when possible. Otherwise the text is only recorded and the next sync
+    /// reparses everything.
+    fn edit(&mut self, store: &ArtifactStore<String>, start: usize, end: usize, new: &str) {
+        let mut next = String::with_capacity(self.text.len() - (end - start) + new.len());
+        next.push_str(&self.text[..start]);
+        next.push_str(new);
+        next.push_str(&self.text[end..]);
+
+        if !self.reparse && self.reparse_region(store, start, end, &next) {
+            shift_lines(&mut self.lines, start, end, new);
+        } else if !self.reparse {
+            self.reparse = true;
+            self.stale = Some(std::mem::take(&mut self.text));
+        }
+        self.ascii = if self.ascii {
+            new.is_ascii()
+        } else {
+            next.is_ascii()
+        };
+        self.text = next;
+    }
+
+    /// Reparse the declarations touching bytes `start..end` of the current
+    /// text. `next` is the text after the edit. Returns `false`, without
+    /// changing anything, when only a full reparse gives the right answer.
+    fn reparse_region(
+        &mut self,
+        store: &ArtifactStore<String>,
+        start: usize,
+        end: usize,
+        next: &str,
+    ) -> bool {
+        let delta = next.len() as isize - self.text.len() as isize;
+        // Declarations that merely touch the edit are reparsed too: typing
+        // right after a `;` or right before a keyword changes their tokens.
+        let lo = self.decls.partition_point(|d| d.end() < start);
+        let hi = self.decls.partition_point(|d| d.start <= end);
+        let from = if lo == 0 { 0 } else { self.decls[lo - 1].end() };
+        let to = self
+            .decls
+            .get(hi)
+            .map_or(self.text.len(), |d| d.start)
+            .wrapping_add_signed(delta);
+        let region = &next[from..to];
+
+        let (names, ambiguous) = doc_names(self.decls.iter());
+        if ambiguous {
+            return false;
+        }
+        let Ok((module, extents)) = Parser::with_names(region, &names).parse_extents() else {
+            return false;
+        };
+        let last = extents.last().map_or(from, |r| from + r.end);
+        if !ends_cleanly(next, last, to) {
+            return false;
+        }
+        let fresh = self.build_decls(region, from, module.stmts, &extents);
+        // A declaration introducing or dropping a struct or variant changes
+        // how every other declaration parses.
+        let kept = self.decls[..lo].iter().chain(&self.decls[hi..]);
+        let (new_names, ambiguous) = doc_names(kept.chain(&fresh));
+        if ambiguous || new_names != names {
+            return false;
+        }
+
+        for d in &mut self.decls[hi..] {
+            d.start = d.start.wrapping_add_signed(delta);
+        }
+        self.splice(store, lo..hi, fresh, true);
+        true
+    }
+
+    /// Reparse the whole text.
+    fn reparse_all(&mut self, store: &ArtifactStore<String>) -> Result<(), BuildError> {
+        let text = std::mem::take(&mut self.text);
+        let parsed = Parser::new(&text).parse_extents();
+        let result = match parsed {
+            Ok((module, extents)) => {
+                self.lines = line_starts(&text);
+                let fresh = self.build_decls(&text, 0, module.stmts, &extents);
+                let all = 0..self.decls.len();
+                self.splice(store, all, fresh, false);
+                self.stale = None;
+                self.reparse = false;
+                Ok(())
+            }
+            Err(e) => Err(BuildError::Parse(e.to_string())),
+        };
+        self.text = text;
+        result
+    }
+
+    /// Turn the statements parsed from `region` (starting at document byte
+    /// `base`) into declarations with fresh ids.
+    fn build_decls(
+        &mut self,
+        region: &str,
+        base: usize,
+        stmts: Vec<Stmt>,
+        extents: &[Range<usize>],
+    ) -> Vec<Decl> {
+        let lines = line_starts(region);
+        stmts
+            .into_iter()
+            .zip(extents)
+            .map(|(stmt, ext)| {
+                let id = self.next_id;
+                self.next_id += 1;
+                build_decl(region, &lines, ext.clone(), stmt, id, base, self.key(id))
+            })
+            .collect()
+    }
+
+    /// Replace `decls[range]` with `fresh`. Old declarations whose text
+    /// reappears at the same end of the range keep their id and types. With
+    /// `keep_parse` they also keep their parse; otherwise they take the fresh
+    /// one, because the text around them may now parse differently.
+    fn splice(
+        &mut self,
+        store: &ArtifactStore<String>,
+        range: Range<usize>,
+        fresh: Vec<Decl>,
+        keep_parse: bool,
+    ) {
+        let same = |a: &Decl, b: &Decl| a.hash == b.hash && a.len == b.len;
+        let old = &self.decls[range.clone()];
+        let pre = old
+            .iter()
+            .zip(&fresh)
+            .take_while(|(a, b)| same(a, b))
+            .count();
+        let suf = old[pre..]
+            .iter()
+            .rev()
+            .zip(fresh[pre..].iter().rev())
+            .take_while(|(a, b)| same(a, b))
+            .count();
+
+        let (fresh_len, old_len) = (fresh.len(), old.len());
+        let mut replaced: Vec<Decl> = self.decls.splice(range.clone(), []).collect();
+        let mut removed = Vec::new();
+        let mut spliced = Vec::with_capacity(fresh_len);
+        for (i, mut new) in fresh.into_iter().enumerate() {
+            let matched = if i < pre {
+                Some(i)
+            } else if i >= fresh_len - suf {
+                Some(old_len - (fresh_len - i))
+            } else {
+                None
+            };
+            match matched {
+                Some(j) => {
+                    let old = std::mem::replace(&mut replaced[j], placeholder());
+                    if keep_parse {
+                        let mut old = old;
+                        old.start = new.start;
+                        spliced.push(old);
+                    } else {
+                        new.id = old.id;
+                        new.key = old.key;
+                        new.deps = old.deps;
+                        new.types = old.types;
+                        spliced.push(new);
+                    }
+                }
+                None => spliced.push(new),
+            }
+        }
+        for (j, old) in replaced.into_iter().enumerate() {
+            if j >= pre && j < old_len - suf {
+                removed.push(old);
+            }
+        }
+        // A declaration rewritten in place keeps the identity of the one it
+        // replaces: dependents keep their edges and are only re-checked if
+        // its types change. Its old types show until inference catches up.
+        let mut taken = vec![false; removed.len()];
+        for d in &mut spliced[pre..fresh_len - suf] {
+            let heir = (0..removed.len()).find(|&r| {
+                !taken[r] && !d.bindings.is_empty() && removed[r].bindings == d.bindings
+            });
+            if let Some(r) = heir {
+                taken[r] = true;
+                d.id = removed[r].id;
+                d.key = removed[r].key.clone();
+                d.types = removed[r].types.clone();
+            }
+        }
+        let added: Vec<u64> = spliced[pre..fresh_len - suf].iter().map(|d| d.id).collect();
+        let at = range.start;
+        self.decls.splice(at..at, spliced);
+        self.reindex();
+
+        let type_level = removed.iter().any(|d| kaubo_infer::declares_types(&d.stmt))
+            || added
+                .iter()
+                .any(|id| kaubo_infer::declares_types(&self.decls[self.index[id]].stmt));
+
+        for d in &removed {
+            store.remove_ready(&d.key);
+            for dep in &d.deps {
+                store.remove_dependent(&d.key, &self.key(*dep));
+                // The removed statement may have been what refined an open
+                // declaration's types.
+                if let Some(&j) = self.index.get(dep) {
+                    if self.decls[j].types.as_ref().is_some_and(|t| t.open) {
+                        store.remove_ready(&self.decls[j].key);
+                    }
+                }
+            }
+        }
+
+        let recheck: Vec<u64> = if keep_parse {
+            let mut changed: BTreeSet<String> = BTreeSet::new();
+            for d in &removed {
+                let id = d.id;
+                for k in &d.defines {
+                    remove_id(&mut self.definers, k, id);
+                }
+                for n in d.symbol_names() {
+                    remove_id(&mut self.named, n, id);
+                }
+                for r in &d.refs {
+                    if let Some(set) = self.referrers.get_mut(r) {
+                        set.remove(&id);
+                        if set.is_empty() {
+                            self.referrers.remove(r);
+                        }
+                    }
+                }
+                changed.extend(d.defines.iter().cloned());
+            }
+            for id in &added {
+                let d = &self.decls[self.index[id]];
+                index_decl(&mut self.definers, &mut self.named, &mut self.referrers, d);
+                changed.extend(d.defines.iter().cloned());
+            }
+            let mut ids: BTreeSet<u64> = added.iter().copied().collect();
+            for name in &changed {
+                if let Some(set) = self.referrers.get(name) {
+                    ids.extend(set.iter().copied());
+                }
+            }
+            ids.into_iter().collect()
+        } else {
+            self.definers.clear();
+            self.named.clear();
+            self.referrers.clear();
+            for d in &self.decls {
+                index_decl(&mut self.definers, &mut self.named, &mut self.referrers, d);
+            }
+            self.decls.iter().map(|d| d.id).collect()
+        };
+        for id in recheck {
+            self.refresh_deps(store, self.index[&id]);
+        }
+
+        if type_level {
+            // Record and variant types embed field lists, and every
+            // declaration can mention them: infer everything again.
+            for d in &self.decls {
+                store.remove_ready(&d.key);
+            }
+        }
+    }
+
+    /// Recompute which declarations `decls[pos]` depends on: the latest
+    /// definer before it for a plain name, every earlier definer for a
+    /// `.member` key. A changed dependency list makes the declaration dirty.
+    fn refresh_deps(&mut self, store: &ArtifactStore<String>, pos: usize) {
+        let d = &self.decls[pos];
+        let mut deps = BTreeSet::new();
+        for r in &d.refs {
+            let Some(ids) = self.definers.get(r) else {
+                continue;
+            };
+            let before = ids.iter().copied().filter(|id| self.index[id] < pos);
+            if r.starts_with('.') {
+                deps.extend(before);
+            } else if let Some(id) = before.max_by_key(|id| self.index[id]) {
+                deps.insert(id);
+            }
+        }
+        let deps: Vec<u64> = deps.into_iter().collect();
+        if deps == d.deps {
+            return;
+        }
+        let key = d.key.clone();
+        for old in &d.deps {
+            store.remove_dependent(&key, &self.key(*old));
+        }
+        for new in &deps {
+            store.add_dependent(key.clone(), self.key(*new));
+        }
+        store.remove_ready(&key);
+        self.decls[pos].deps = deps;
+    }
+
+    fn reindex(&mut self) {
+        self.index.clear();
+        self.index
+            .extend(self.decls.iter().enumerate().map(|(i, d)| (d.id, i)));
+    }
+
+    fn key(&self, id: u64) -> ArtifactKey<String> {
+        ArtifactKey::new(format!("{}#{id}", self.doc), Kind::new(DECL_TYPES))
+    }
+
+    fn pos_of_key(&self, key: &ArtifactKey<String>) -> Option<usize> {
+        let id = key.module_id.strip_prefix(&self.doc)?.strip_prefix('#')?;
+        self.index.get(&id.parse().ok()?).copied()
+    }
+
+    // ── Inference ───────────────────────────────────────────────────
+
+    /// Reparse if needed, then infer every dirty declaration.
+    ///
+    /// Inference runs in rounds. A declaration whose types come out
+    /// different makes its dependents outside the round dirty, and they run
+    /// in the next round. Nothing else is re-inferred.
+    fn sync(&mut self, store: &ArtifactStore<String>) -> Result<(), BuildError> {
+        if self.reparse {
+            self.reparse_all(store)?;
+        }
+        #[cfg(test)]
+        self.inferred.clear();
+
+        let mut rounds = 0;
+        loop {
+            let mut dirty: Vec<bool> = self
+                .decls
+                .iter()
+                .map(|d| !store.has_ready(&d.key))
+                .collect();
+            if !dirty.contains(&true) {
+                break;
+            }
+            rounds += 1;
+            // Rounds only move forward through the document. Should that
+            // ever fail, one pass over everything is plain module inference.
+            let whole = rounds > self.decls.len() + 1;
+            if whole {
+                dirty.fill(true);
+            }
+            self.pull_open(store, &mut dirty);
+
+            let stmts: Vec<&Stmt> = self.decls.iter().map(|d| &d.stmt).collect();
+            let results = loop {
+                let mut needed = vec![false; self.decls.len()];
+                for (i, d) in self.decls.iter().enumerate() {
+                    if dirty[i] {
+                        for dep in &d.deps {
+                            needed[self.index[dep]] = true;
+                        }
+                    }
+                }
+                let cached: Vec<Option<&[(String, Scheme)]>> = self
+                    .decls
+                    .iter()
+                    .enumerate()
+                    .map(|(i, d)| match (dirty[i], needed[i], &d.types) {
+                        (true, _, _) => None,
+                        (false, true, Some(t)) => Some(&t.bindings[..]),
+                        _ => Some(&[][..]),
+                    })
+                    .collect();
+                match kaubo_infer::infer_stmts(&stmts, &cached, &mut self.ids) {
+                    Ok(results) => break results,
+                    // A declaration earlier in the batch may still change
+                    // the types the failing one sees through a clean
+                    // dependency: settle everything before it first.
+                    Err((i, _)) if !whole && dirty[..i].contains(&true) => {
+                        dirty[i..].fill(false);
+                    }
+                    Err((_, e)) => return Err(BuildError::Infer(e.msg)),
+                }
+            };
+
+            let mut changed = Vec::new();
+            for StmtTypes {
+                index: i,
+                bindings,
+                open,
+            } in results
+            {
+                if !dirty[i] {
+                    continue;
+                }
+                let d = &mut self.decls[i];
+                let types = Arc::new(DeclTypes { bindings, open });
+                if !d.types.as_ref().is_some_and(|old| old.same_as(&types)) {
+                    changed.push(d.key.clone());
+                }
+                d.types = Some(Arc::clone(&types));
+                store.put_ready(Artifact::shared(
+                    d.key.module_id.clone(),
+                    Kind::new(DECL_TYPES),
+                    types,
+                ));
+                #[cfg(test)]
+                self.inferred.push(decl_label(d));
+            }
+            for key in changed {
+                for dependent in store.get_dependents(&key) {
+                    if self.pos_of_key(&dependent).is_some_and(|j| !dirty[j]) {
+                        store.remove_ready(&dependent);
+                    }
+                }
+            }
+        }
+        self.ready = true;
+        Ok(())
+    }
+
+    /// Cached types are only reusable when closed. A dirty declaration pulls
+    /// in the open declarations it depends on, and a dirty open declaration
+    /// pulls in all of its dependents, since any of them may refine the
+    /// shared variables.
+    fn pull_open(&self, store: &ArtifactStore<String>, dirty: &mut [bool]) {
+        let open = |j: usize| self.decls[j].types.as_ref().is_some_and(|t| t.open);
+        let mut grew = true;
+        while grew {
+            grew = false;
+            for i in 0..self.decls.len() {
+                if !dirty[i] {
+                    continue;
+                }
+                let mut pulled: Vec<usize> = self.decls[i]
+                    .deps
+                    .iter()
+                    .map(|dep| self.index[dep])
+                    .filter(|&j| open(j))
+                    .collect();
+                if open(i) {
+                    let dependents = store.get_dependents(&self.decls[i].key);
+                    pulled.extend(dependents.iter().filter_map(|k| self.pos_of_key(k)));
+                }
+                for j in pulled {
+                    if !dirty[j] {
+                        dirty[j] = true;
+                        store.remove_ready(&self.decls[j].key);
+                        grew = true;
+                    }
+                }
+            }
+        }
+    }
+
+    // ── Queries ─────────────────────────────────────────────────────
+
+    fn shown(&self) -> &str {
+        self.stale.as_deref().unwrap_or(&self.text)
+    }
+
+    fn shown_ascii(&self) -> bool {
+        self.stale.is_none() && self.ascii
+    }
+
+    /// Type of a top-level name: the last definition in the document wins,
+    /// as in the environment whole-module inference ends with.
+    pub(crate) fn scheme(&self, name: &str) -> Option<&Scheme> {
+        let from_doc = self.definers.get(name).and_then(|ids| {
+            let id = ids.iter().max_by_key(|id| self.index[*id])?;
+            self.decls[self.index[id]].types.as_ref()?.get(name)
+        });
+        from_doc.or_else(|| self.prelude.get(name))
+    }
+
+    fn type_string(&self, name: &str) -> Option<String> {
+        self.scheme(name).map(|s| format!("{}", s.body))
+    }
+
+    /// Position of the declaration containing document byte `at`.
+    fn decl_at(&self, at: usize) -> Option<usize> {
+        let i = self
+            .decls
+            .partition_point(|d| d.start <= at)
+            .checked_sub(1)?;
+        (at < self.decls[i].end()).then_some(i)
+    }
+
+    /// Symbol definition for the identifier at char `offset`.
+    pub(crate) fn symbol_at(&self, offset: usize) -> Option<SymbolDef> {
+        let text = self.shown();
+        let at = byte_of(text, self.shown_ascii(), offset);
+        let name = identifier_at(text, at)?;
+        let Some(k) = self.decl_at(at) else {
+            return self.resolve(self.decls.len(), name);
+        };
+        let d = &self.decls[k];
+        let rel = at - d.start;
+        let i = d.occurrences.partition_point(|o| o.start <= rel);
+        let hit = i
+            .checked_sub(1)
+            .map(|i| &d.occurrences[i])
+            .filter(|o| rel < o.end);
+        match hit.map(|o| &o.target) {
+            Some(Target::Def(s)) => Some(self.symbol(k, *s)),
+            Some(Target::Ref(name)) => self.resolve(k, name),
+            None => self.resolve(k, name),
+        }
+    }
+
+    /// A name used in `decls[k]`: the declaration's own symbol (a parameter
+    /// or local), then the definition inference would see, then any symbol
+    /// of that name.
+    fn resolve(&self, k: usize, name: &str) -> Option<SymbolDef> {
+        let own = |d: &Decl| d.symbols.iter().rposition(|s| s.name == name);
+        if let Some(s) = self.decls.get(k).and_then(own) {
+            return Some(self.symbol(k, s));
+        }
+        let candidates = [self.definers.get(name), self.named.get(name)];
+        for ids in candidates.into_iter().flatten() {
+            let by_pos = |id: &&u64| self.index[*id];
+            let before = ids
+                .iter()
+                .filter(|id| self.index[*id] < k)
+                .max_by_key(by_pos);
+            let Some(id) = before.or_else(|| ids.iter().max_by_key(by_pos)) else {
+                continue;
+            };
+            let j = self.index[id];
+            if let Some(s) = own(&self.decls[j]) {
+                return Some(self.symbol(j, s));
+            }
+        }
+        None
+    }
+
+    /// `decls[k].symbols[s]` in document coordinates, with its type.
+    fn symbol(&self, k: usize, s: usize) -> SymbolDef {
+        let d = &self.decls[k];
+        let sym = &d.symbols[s];
+        SymbolDef {
+            name: sym.name.clone(),
+            kind: sym.kind,
+            span: self.doc_span(d, sym.span),
+            ty: self.type_string(&sym.name),
+        }
+    }
+
+    /// Map a span in `d`'s parse frame to document line/column.
+    fn doc_span(&self, d: &Decl, span: Span) -> Span {
+        if span == Span::ZERO {
+            return span;
+        }
+        let text = self.shown();
+        let line = self.lines.partition_point(|&s| s <= d.start);
+        let line_start = self.lines[line - 1];
+        let col = char_len(&text[line_start..d.start], self.shown_ascii()) + 1;
+        if span.line == d.anchor.line {
+            Span::new(line, col + span.col - d.anchor.col)
+        } else {
+            Span::new(line + span.line - d.anchor.line, span.col)
+        }
+    }
+
+    pub(crate) fn hover(&self, offset: usize) -> Option<HoverInfo> {
+        if let Some(sym) = self.symbol_at(offset) {
+            return Some(HoverInfo {
+                kind: sym.kind.as_str().to_string(),
+                description: format!("{} {}", sym.kind.as_str(), sym.name),
+                ty: sym.ty,
+            });
+        }
+        let text = self.shown();
+        let name = identifier_at(text, byte_of(text, self.shown_ascii(), offset))?;
+        self.scheme(name).map(|scheme| HoverInfo {
+            kind: "variable".to_string(),
+            ty: Some(format!("{}", scheme.body)),
+            description: format!("variable {name}"),
+        })
+    }
+
+    /// Completions at `offset`: dot-access from the token model, otherwise
+    /// every known name matching the identifier prefix being typed.
+    pub(crate) fn completions(&self, offset: usize) -> Vec<CompletionItem> {
+        let text = self.shown();
+        // Token-based completions handle both simple dot-access (e.g. `v.`)
+        // and chained calls (e.g. `1.to_float().`).
+        let token_items = crate::completions(text, offset);
+        if !token_items.is_empty() {
+            return token_items;
+        }
+
+        let at = byte_of(text, self.shown_ascii(), offset);
+        let prefix = prefix_at(text, at);
+        let mut seen = HashSet::new();
+        let mut items = Vec::new();
+        for d in self.decls.iter().rev() {
+            for sym in d.symbols.iter().rev() {
+                if sym.name.starts_with(prefix) && seen.insert(sym.name.as_str()) {
+                    items.push(CompletionItem {
+                        label: sym.name.clone(),
+                        kind: sym.kind.as_str().to_string(),
+                        detail: self.type_string(&sym.name),
+                    });
+                }
+            }
+        }
+        let mut globals: Vec<&String> = self
+            .decls
+            .iter()
+            .flat_map(|d| &d.bindings)
+            .chain(self.prelude.keys())
+            .filter(|name| name.starts_with(prefix))
+            .collect();
+        globals.sort();
+        for name in globals {
+            if seen.insert(name.as_str()) {
+                items.push(CompletionItem {
+                    label: name.clone(),
+                    kind: "variable".to_string(),
+                    detail: self.type_string(name),
+                });
+            }
+        }
+        items
+    }
+
+    /// Inferred types shown right after the names that introduce them.
+    pub(crate) fn inlay_hints(&self) -> Vec<InlayHint> {
+        let text = self.shown();
+        let mut found = Vec::new();
+        for d in &self.decls {
+            for h in &d.hints {
+                let ty = self
+                    .type_string(&h.lookup)
+                    .or_else(|| h.guess.map(str::to_string));
+                let Some(ty) = ty else { continue };
+                // Skip uninformative types (type variables like "t0")
+                if ty.starts_with('t') && ty.len() <= 3 {
+                    continue;
+                }
+                let shown = h.shown.as_deref().unwrap_or(&h.lookup);
+                found.push((end_of_name(text, d.start + h.at, shown), format!(": {ty}")));
+            }
+        }
+        let mut ends: Vec<usize> = found.iter().map(|(at, _)| *at).collect();
+        to_char_offsets(text, self.shown_ascii(), &mut ends);
+        found
+            .into_iter()
+            .zip(ends)
+            .map(|((_, label), position)| InlayHint { position, label })
+            .collect()
+    }
+
+    pub(crate) fn source(&self) -> &str {
+        &self.text
+    }
+}
+
+// ── Declaration building ────────────────────────────────────────────
+
+fn build_decl(
+    region: &str,
+    lines: &[usize],
+    ext: Range<usize>,
+    stmt: Stmt,
+    id: u64,
+    base: usize,
+    key: ArtifactKey<String>,
+) -> Decl {
+    let line = lines.partition_point(|&s| s <= ext.start);
+    let line_start = lines[line - 1];
+    let anchor = Span::new(line, region[line_start..ext.start].chars().count() + 1);
+
+    let mut c = Collector {
+        src: region,
+        lines,
+        ext: ext.clone(),
+        symbols: Vec::new(),
+        occurrences: Vec::new(),
+        refs: BTreeSet::new(),
+        hints: Vec::new(),
+    };
+    c.stmt(&stmt);
+    c.occurrences.sort_by_key(|o| o.start);
+
+    let bindings = kaubo_infer::stmt_bindings(&stmt);
+    let mut defines = bindings.clone();
+    for b in &bindings {
+        if let Some((_, method)) = b.split_once('.') {
+            defines.push(format!(".{method}"));
+        }
+    }
+    Decl {
+        id,
+        key,
+        start: base + ext.start,
+        len: ext.len(),
+        hash: ContentHash::from_bytes(region[ext.clone()].as_bytes()),
+        anchor,
+        names: stmt_names(&stmt),
+        bindings,
+        defines,
+        refs: c.refs.into_iter().collect(),
+        deps: Vec::new(),
+        symbols: c.symbols,
+        occurrences: c.occurrences,
+        hints: c.hints,
+        stmt,
+        types: None,
+    }
+}
+
+/// A declaration taken out of the list mid-splice; never observed.
+fn placeholder() -> Decl {
+    Decl {
+        id: u64::MAX,
+        key: ArtifactKey::new(String::new(), Kind::new(DECL_TYPES)),
+        start: 0,
+        len: 0,
+        hash: ContentHash::from_bytes(&[]),
+        anchor: Span::ZERO,
+        stmt: Stmt::Import {
+            path: String::new(),
+            alias: None,
+            names: Vec::new(),
+        },
+        bindings: Vec::new(),
+        defines: Vec::new(),
+        refs: Vec::new(),
+        deps: Vec::new(),
+        symbols: Vec::new(),
+        occurrences: Vec::new(),
+        hints: Vec::new(),
+        names: ParseNames::default(),
+        types: None,
+    }
+}
+
+fn index_decl(
+    definers: &mut HashMap<String, Vec<u64>>,
+    named: &mut HashMap<String, Vec<u64>>,
+    referrers: &mut HashMap<String, HashSet<u64>>,
+    d: &Decl,
+) {
+    for k in &d.defines {
+        definers.entry(k.clone()).or_default().push(d.id);
+    }
+    for n in d.symbol_names() {
+        named.entry(n.to_string()).or_default().push(d.id);
+    }
+    for r in &d.refs {
+        referrers.entry(r.clone()).or_default().insert(d.id);
+    }
+}
+
+fn remove_id(map: &mut HashMap<String, Vec<u64>>, key: &str, id: u64) {
+    if let Some(ids) = map.get_mut(key) {
+        ids.retain(|&i| i != id);
+        if ids.is_empty() {
+            map.remove(key);
+        }
+    }
+}
+
+/// Struct names and enum variants a statement makes known to the parser,
+/// mirroring the parser's own prescan.
+fn stmt_names(stmt: &Stmt) -> ParseNames {
+    let mut names = ParseNames::default();
+    let inner = match stmt {
+        Stmt::ExportStmt(inner) => inner.as_ref(),
+        other => other,
+    };
+    match inner {
+        Stmt::StructDef { name, .. } => {
+            names.structs.insert(name.clone());
+        }
+        Stmt::EnumDef { name, variants, .. } => {
+            for (tag, v) in variants.iter().enumerate() {
+                names
+                    .variants
+                    .insert(v.name.clone(), (name.clone(), tag as u16));
+            }
+        }
+        _ => {}
+    }
+    names
+}
+
+/// Parser names of a document; `true` when a variant name is defined twice,
+/// in which case which one wins depends on the whole text.
+fn doc_names<'d>(decls: impl Iterator<Item = &'d Decl>) -> (ParseNames, bool) {
+    let mut names = ParseNames::default();
+    let mut ambiguous = false;
+    for d in decls {
+        names.structs.extend(d.names.structs.iter().cloned());
+        for (v, target) in &d.names.variants {
+            ambiguous |= names.variants.insert(v.clone(), target.clone()).is_some();
+        }
+    }
+    (names, ambiguous)
+}
+
+/// Whether a region parsed on its own ends where the full lexer would end a
+/// token: no token (a comment, an identifier) runs from the region across
+/// `to`. `last` is where the region's last statement ends.
+fn ends_cleanly(next: &str, last: usize, to: usize) -> bool {
+    if to >= next.len() {
+        return true;
+    }
+    let mut lexer = Lexer::new(&next[last..]);
+    loop {
+        let tok = lexer.next_raw();
+        let (start, end) = (last + tok.start as usize, last + tok.end as usize);
+        if tok.kind == TokenKind::Eof || start >= to {
+            return true;
+        }
+        if end > to {
+            return false;
+        }
+    }
+}
+
+/// Symbols, occurrences, references, and hint sites of one statement.
+/// Spans are in the region's frame; byte offsets become relative to `ext`.
+struct Collector<'s> {
+    src: &'s str,
+    lines: &'s [usize],
+    ext: Range<usize>,
+    symbols: Vec<SymbolDef>,
+    occurrences: Vec<Occurrence>,
+    refs: BTreeSet<String>,
+    hints: Vec<HintSite>,
+}
+
+impl Collector<'_> {
+    /// Region byte offset of `span`, if it lies inside the statement.
+    fn offset(&self, span: Span) -> Option<usize> {
+        if span.line == 0 {
+            return None;
+        }
+        let line_start = *self.lines.get(span.line - 1)?;
+        let line = &self.src[line_start..];
+        let col = match line.char_indices().nth(span.col - 1) {
+            Some((i, _)) => i,
+            None if line.chars().count() == span.col - 1 => line.len(),
+            None => return None,
+        };
+        let at = line_start + col;
+        self.ext.contains(&at).then_some(at)
+    }
+
+    /// Statement-relative range of `name` at or shortly after `span`.
+    fn locate(&self, span: Span, name: &str) -> Option<Range<usize>> {
+        let at = self.offset(span)?;
+        let rest = &self.src[at..self.ext.end];
+        let window = rest
+            .char_indices()
+            .nth(50)
+            .map_or(rest, |(i, _)| &rest[..i]);
+        let rel = window.find(name)?;
+        let start = at + rel - self.ext.start;
+        Some(start..start + name.len())
+    }
+
+    fn def(&mut self, name: String, kind: SymbolKind, span: Span, shown: &str) {
+        if let Some(r) = self.locate(span, shown) {
+            self.occurrences.push(Occurrence {
+                start: r.start,
+                end: r.end,
+                target: Target::Def(self.symbols.len()),
+            });
+        }
+        self.symbols.push(SymbolDef {
+            name,
+            kind,
+            span,
+            ty: None,
+        });
+    }
+
+    fn hint(&mut self, lookup: &str, shown: Option<&str>, span: Span, guess: Option<&'static str>) {
+        if let Some(at) = self.offset(span) {
+            self.hints.push(HintSite {
+                at: at - self.ext.start,
+                lookup: lookup.to_string(),
+                shown: shown.map(str::to_string),
+                guess,
+            });
+        }
+    }
+
+    fn stmt(&mut self, stmt: &Stmt) {
+        match stmt {
+            Stmt::ConstDecl {
+                name, span, value, ..
+            } => {
+                self.def(name.clone(), SymbolKind::Const, *span, name);
+                self.hint(name, None, *span, guess_type(Some(value)));
+                self.expr(value);
+            }
+            Stmt::VarDecl {
+                name, span, value, ..
+            } => {
+                self.def(name.clone(), SymbolKind::Var, *span, name);
+                self.hint(name, None, *span, guess_type(value.as_ref()));
+                if let Some(v) = value {
+                    self.expr(v);
+                }
+            }
+            Stmt::StructDef {
+                name, span, fields, ..
+            } => {
+                self.def(name.clone(), SymbolKind::Struct, *span, name);
+                for f in fields {
+                    self.def(f.name.clone(), SymbolKind::Field, f.span, &f.name);
+                }
+            }
+            Stmt::EnumDef {
+                name,
+                span,
+                variants,
+            } => {
+                self.def(name.clone(), SymbolKind::Enum, *span, name);
+                for v in variants {
+                    self.def(v.name.clone(), SymbolKind::Variant, v.span, &v.name);
+                }
+            }
+            Stmt::InterfaceDef {
+                name,
+                span,
+                methods,
+            } => {
+                self.def(name.clone(), SymbolKind::Interface, *span, name);
+                for m in methods {
+                    // MethodSig doesn't have span yet
+                    self.def(m.name.clone(), SymbolKind::Method, Span::ZERO, &m.name);
+                    for p in &m.params {
+                        self.def(p.name.clone(), SymbolKind::Param, p.span, &p.name);
+                    }
+                }
+            }
+            Stmt::ImplBlock {
+                struct_name,
+                methods,
+                ..
+            } => {
+                for m in methods {
+                    let full_name = format!("{}.{}", struct_name, m.name);
+                    self.hint(&full_name, Some(&m.name), m.span, None);
+                    self.def(full_name, SymbolKind::Method, m.span, &m.name);
+                    self.expr(&m.body);
+                }
+            }
+            Stmt::ExportStmt(inner) => self.stmt(inner),
+            Stmt::ExprStmt(expr) => self.expr(expr),
+            Stmt::Import { .. } => {}
+        }
+    }
+
+    fn expr(&mut self, expr: &Expr) {
+        match expr {
+            Expr::VarRef { name, span } => {
+                if let Some(r) = self.locate(*span, name) {
+                    self.occurrences.push(Occurrence {
+                        start: r.start,
+                        end: r.end,
+                        target: Target::Ref(name.clone()),
+                    });
+                }
+                self.refs.insert(name.clone());
+            }
+            Expr::Lambda { params, body, .. } => {
+                for p in params {
+                    self.def(p.name.clone(), SymbolKind::Param, p.span, &p.name);
+                    // Skip if type is already explicitly annotated in source
+                    if p.ty_ann.is_none() {
+                        self.hint(&p.name, None, p.span, None);
+                    }
+                }
+                self.expr(body);
+            }
+            Expr::Binary { left, op, right } => {
+                // User types dispatch arithmetic to `Type.method` impls
+                if let Some(method) = operator_method(*op) {
+                    self.refs.insert(format!(".{method}"));
+                }
+                self.expr(left);
+                self.expr(right);
+            }
+            Expr::For {
+                var,
+                iterable,
+                body,
+            } => {
+                self.def(var.name.clone(), SymbolKind::Var, var.span, &var.name);
+                self.hint(&var.name, None, var.span, None);
+                self.expr(iterable);
+                self.expr(body);
+            }
+            Expr::Member { object, field } => {
+                self.refs.insert(format!(".{field}"));
+                self.expr(object);
+            }
+            Expr::Block(stmts) => {
+                for s in stmts {
+                    self.stmt(s);
+                }
+            }
+            Expr::Call { func: a, arg: b }
+            | Expr::While { cond: a, body: b }
+            | Expr::Index {
+                object: a,
+                index: b,
+            }
+            | Expr::Assign {
+                target: a,
+                value: b,
+            } => {
+                self.expr(a);
+                self.expr(b);
+            }
+            Expr::If {
+                cond,
+                then_branch,
+                else_branch,
+            } => {
+                self.expr(cond);
+                self.expr(then_branch);
+                if let Some(e) = else_branch {
+                    self.expr(e);
+                }
+            }
+            Expr::StructLit { fields, spread, .. } => {
+                for (_, val) in fields {
+                    self.expr(val);
+                }
+                if let Some(s) = spread {
+                    self.expr(s);
+                }
+            }
+            Expr::VariantLit { fields: items, .. } | Expr::ListLit(items) | Expr::Tuple(items) => {
+                for item in items {
+                    self.expr(item);
+                }
+            }
+            Expr::Unary { right: e, .. }
+            | Expr::Return(Some(e))
+            | Expr::GetVariantTag(e)
+            | Expr::GetVariantField { object: e, .. }
+            | Expr::Async(e)
+            | Expr::Await(e) => self.expr(e),
+            Expr::Return(None)
+            | Expr::LitInt(_)
+            | Expr::LitFloat(_)
+            | Expr::LitString(_)
+            | Expr::LitTrue
+            | Expr::LitFalse
+            | Expr::LitNull
+            | Expr::Break
+            | Expr::Continue => {}
+        }
+    }
+}
+
+/// Method an arithmetic operator dispatches to on user types.
+fn operator_method(op: BinOp) -> Option<&'static str> {
+    match op {
+        BinOp::Add => Some("add"),
+        BinOp::Sub => Some("subtract"),
+        BinOp::Mul => Some("multiply"),
+        BinOp::Div => Some("divide"),
+        BinOp::Mod => Some("modulo"),
+        _ => None,
+    }
+}
+
+/// Guess a type from a simple expression (literals only).
+fn guess_type(expr: Option<&Expr>) -> Option<&'static str> {
+    match expr? {
+        Expr::LitInt(_) => Some("Int64"),
+        Expr::LitFloat(_) => Some("Float64"),
+        Expr::LitString(_) => Some("String"),
+        Expr::LitTrue | Expr::LitFalse => Some("Bool"),
+        Expr::LitNull => Some("Null"),
+        _ => None,
+    }
+}
+
+#[cfg(test)]
+fn decl_label(d: &Decl) -> String {
+    match d.symbols.first() {
+        Some(s) => s.name.clone(),
+        None => format!("#{}", d.id),
+    }
+}
+
+// ── Types ───────────────────────────────────────────────────────────
+
+/// Structural equality up to a consistent renaming of type variables.
+fn alpha_eq(a: &Type, b: &Type) -> bool {
+    fn go(
+        a: &Type,
+        b: &Type,
+        map: &mut HashMap<TypeVar, TypeVar>,
+        back: &mut HashMap<TypeVar, TypeVar>,
+    ) -> bool {
+        match (a, b) {
+            (Type::Var(x), Type::Var(y)) => {
+                *map.entry(*x).or_insert(*y) == *y && *back.entry(*y).or_insert(*x) == *x
+            }
+            (Type::Arrow(a1, a2), Type::Arrow(b1, b2)) => {
+                go(a1, b1, map, back) && go(a2, b2, map, back)
+            }
+            (Type::List(x), Type::List(y)) => go(x, y, map, back),
+            (Type::Tuple(xs), Type::Tuple(ys)) => {
+                xs.len() == ys.len() && xs.iter().zip(ys).all(|(x, y)| go(x, y, map, back))
+            }
+            (Type::Record(i, xs), Type::Record(j, ys)) => i == j && fields(xs, ys, map, back),
+            (Type::Variant(i, n, xs), Type::Variant(j, m, ys)) => {
+                i == j && n == m && fields(xs, ys, map, back)
+            }
+            _ => a == b,
+        }
+    }
+    fn fields(
+        xs: &[(String, Type)],
+        ys: &[(String, Type)],
+        map: &mut HashMap<TypeVar, TypeVar>,
+        back: &mut HashMap<TypeVar, TypeVar>,
+    ) -> bool {
+        xs.len() == ys.len()
+            && xs
+                .iter()
+                .zip(ys)
+                .all(|((n, x), (m, y))| n == m && go(x, y, map, back))
+    }
+    go(a, b, &mut HashMap::new(), &mut HashMap::new())
+}
+
+// ── Text helpers ────────────────────────────────────────────────────
+
+fn line_starts(text: &str) -> Vec<usize> {
+    std::iter::once(0)
+        .chain(text.match_indices('\n').map(|(i, _)| i + 1))
+        .collect()
+}
+
+/// Update line starts for bytes `start..end` replaced by `new`.
+fn shift_lines(lines: &mut Vec<usize>, start: usize, end: usize, new: &str) {
+    let delta = new.len() as isize - (end - start) as isize;
+    let lo = lines.partition_point(|&s| s <= start);
+    let hi = lines.partition_point(|&s| s <= end);
+    for s in &mut lines[hi..] {
+        *s = s.wrapping_add_signed(delta);
+    }
+    let inserted = new.match_indices('\n').map(|(i, _)| start + i + 1);
+    lines.splice(lo..hi, inserted);
+}
+
+fn char_len(text: &str, ascii: bool) -> usize {
+    if ascii {
+        text.len()
+    } else {
+        text.chars().count()
+    }
+}
+
+/// Byte offset of char offset `chars`, clamped to the end of `text`.
+fn byte_of(text: &str, ascii: bool, chars: usize) -> usize {
+    if ascii {
+        chars.min(text.len())
+    } else {
+        text.char_indices()
+            .nth(chars)
+            .map_or(text.len(), |(i, _)| i)
+    }
+}
+
+/// Convert byte offsets to char offsets in place, in one pass over `text`.
+fn to_char_offsets(text: &str, ascii: bool, offsets: &mut [usize]) {
+    if ascii {
+        return;
+    }
+    let mut order: Vec<usize> = (0..offsets.len()).collect();
+    order.sort_by_key(|&i| offsets[i]);
+    let mut chars = 0;
+    let mut iter = text.char_indices().peekable();
+    for i in order {
+        while iter.next_if(|&(b, _)| b < offsets[i]).is_some() {
+            chars += 1;
+        }
+        offsets[i] = chars;
+    }
+}
+
+fn is_ident_char(c: char) -> bool {
+    c.is_alphanumeric() || c == '_'
+}
+
+/// Identifier covering byte `at` (which must be inside it).
+fn identifier_at(text: &str, at: usize) -> Option<&str> {
+    let c = text.get(at..)?.chars().next()?;
+    if !is_ident_char(c) {
+        return None;
+    }
+    let start = text[..at]
+        .char_indices()
+        .rev()
+        .take_while(|&(_, c)| is_ident_char(c))
+        .last()
+        .map_or(at, |(i, _)| i);
+    let end = text[at..]
+        .char_indices()
+        .find(|&(_, c)| !is_ident_char(c))
+        .map_or(text.len(), |(i, _)| at + i);
+    Some(&text[start..end])
+}
+
+/// The identifier prefix ending at byte `at` — the word being typed.
+fn prefix_at(text: &str, at: usize) -> &str {
+    let before = &text[..at];
+    let start = before
+        .char_indices()
+        .rev()
+        .take_while(|&(_, c)| is_ident_char(c))
+        .last()
+        .map_or(at, |(i, _)| i);
+    &before[start..]
+}
+
+/// Byte offset right after `name`, given the byte offset of its span. The
+/// span is a hint: the name is searched for within the next 50 chars.
+fn end_of_name(text: &str, at: usize, name: &str) -> usize {
+    let rest = &text[at.min(text.len())..];
+    let window = rest
+        .char_indices()
+        .nth(50)
+        .map_or(rest, |(i, _)| &rest[..i]);
+    let start = match window.find(name) {
+        Some(rel) => at + rel,
+        // Last resort: approximate
+        None => at,
+    };
+    let mut end = (start + name.len()).min(text.len());
+    while !text.is_char_boundary(end) {
+        end -= 1;
+    }
+    end
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn end_of_name_simple() {
+        // "const x = 42;" — 'x' at byte 6
+        assert_eq!(end_of_name("const x = 42;", 6, "x"), 7);
+    }
+
+    #[test]
+    fn end_of_name_self_in_lambda() {
+        let src = "const f = |self: Int64| { self + 1 };";
+        // 'self' at byte 11; after it comes ':'
+        assert_eq!(end_of_name(src, 11, "self"), 15);
+    }
+
+    #[test]
+    fn end_of_name_multiline() {
+        let src = "const add = |a, b| {\n    return a + b;\n};";
+        let pos1 = end_of_name(src, 13, "a");
+        assert_eq!(&src[pos1..pos1 + 1], ",");
+        let pos2 = end_of_name(src, 16, "b");
+        assert_eq!(&src[pos2..pos2 + 1], "|");
+    }
+
+    #[test]
+    fn end_of_name_searches_past_the_span() {
+        let src = "const a = 1;\nconst b = 2;";
+        // span at `const` of line 2: the name is found further on
+        let pos = end_of_name(src, 13, "b");
+        assert_eq!(&src[pos..pos + 2], " =");
+    }
+
+    #[test]
+    fn shift_lines_tracks_inserted_and_removed_newlines() {
+        let before = "a\nb\nc\n";
+        let mut lines = line_starts(before);
+        shift_lines(&mut lines, 1, 4, "\n\n");
+        assert_eq!(lines, line_starts("a\n\nc\n"));
+        let mut lines = line_starts("ab");
+        shift_lines(&mut lines, 1, 1, "\nx\n");
+        assert_eq!(lines, line_starts("a\nx\nb"));
+    }
+
+    #[test]
+    fn alpha_eq_renames_consistently() {
+        let v = |n| Box::new(Type::Var(TypeVar(n)));
+        assert!(alpha_eq(&Type::Arrow(v(1), v(1)), &Type::Arrow(v(7), v(7))));
+        assert!(!alpha_eq(
+            &Type::Arrow(v(1), v(1)),
+            &Type::Arrow(v(7), v(8))
+        ));
+        assert!(!alpha_eq(
+            &Type::Arrow(v(1), v(2)),
+            &Type::Arrow(v(7), v(7))
+        ));
+    }
+
+    const PROGRAM: &str = "\
+struct Point { x: Int64, y: Int64 };
+const a = 1;
+const b = \"s\";
+const f = |x: Int64| -> Int64 { return x + a; };
+const g = f(2);
+const h = b;
+const norm = |p: Point| -> Int64 { return p.x * p.x + p.y * p.y; };
+impl Point { len: |self: Point| -> Int64 { return norm(self); }; };
+const id = |v| { return v; };
+var total = norm(Point { x: g, y: 3 });
+for (k in [1, 2]) { total = total + id(k); };
+";
+
+    fn analyzed(text: &str) -> (ArtifactStore<String>, Analysis) {
+        let store = ArtifactStore::new();
+        let mut a = Analysis::new("test");
+        a.set_text(&store, text).unwrap();
+        (store, a)
+    }
+
+    /// Replace the first occurrence of `from` with `to`, as an edit.
+    fn replace(a: &mut Analysis, store: &ArtifactStore<String>, from: &str, to: &str) {
+        let at = a.source().find(from).unwrap();
+        let edit = TextEdit {
+            start: at,
+            end: at + from.len(),
+            text: to.to_string(),
+        };
+        a.apply_edits(store, &[edit]).unwrap();
+    }
+
+    /// Rename type variables in order of appearance: numbering depends on
+    /// the inference table, not on the program.
+    fn canon(s: &str) -> String {
+        let mut names: Vec<String> = Vec::new();
+        let mut out = String::new();
+        let mut chars = s.chars().peekable();
+        let mut prev_ident = false;
+        while let Some(c) = chars.next() {
+            if c == 't' && !prev_ident && chars.peek().is_some_and(char::is_ascii_digit) {
+                let mut var = String::new();
+                while let Some(d) = chars.next_if(char::is_ascii_digit) {
+                    var.push(d);
+                }
+                let n = match names.iter().position(|v| *v == var) {
+                    Some(n) => n,
+                    None => {
+                        names.push(var);
+                        names.len() - 1
+                    }
+                };
+                out.push_str(&format!("'{n}"));
+                prev_ident = true;
+                continue;
+            }
+            prev_ident = is_ident_char(c);
+            out.push(c);
+        }
+        out
+    }
+
+    /// Everything a client can observe, at every offset.
+    fn observe(a: &Analysis) -> Vec<String> {
+        let n = a.shown().chars().count();
+        let mut seen: Vec<String> = (0..=n)
+            .map(|i| canon(&format!("{:?} {:?}", a.hover(i), a.symbol_at(i))))
+            .collect();
+        seen.extend(a.inlay_hints().iter().map(|h| canon(&format!("{h:?}"))));
+        seen
+    }
+
+    fn assert_matches_fresh(a: &Analysis) {
+        let (_, fresh) = analyzed(a.source());
+        assert_eq!(observe(a), observe(&fresh), "after edits:\n{}", a.source());
+    }
+
+    #[test]
+    fn queries_resolve_definitions_and_references() {
+        let (_, a) = analyzed(PROGRAM);
+        let at = |needle: &str, skip: usize| PROGRAM.find(needle).unwrap() + skip;
+
+        let def = a.hover(at("const g", 6)).unwrap();
+        assert_eq!(
+            (def.kind.as_str(), def.ty.as_deref()),
+            ("const", Some("Int64"))
+        );
+        // `g` used inside the struct literal resolves to its definition
+        let use_site = a.symbol_at(at("x: g", 3)).unwrap();
+        assert_eq!(
+            (use_site.name.as_str(), use_site.span),
+            ("g", Span::new(5, 7))
+        );
+        // parameters resolve within their own declaration
+        let param = a.symbol_at(at("x + a", 0)).unwrap();
+        assert_eq!(
+            (param.kind, param.span),
+            (SymbolKind::Param, Span::new(4, 12))
+        );
+        assert_eq!(
+            a.symbol_at(at("norm(self)", 0)).map(|s| s.span),
+            Some(Span::new(7, 7))
+        );
+        let method = a.hover(at("len:", 0)).unwrap();
+        assert_eq!(method.description, "method Point.len");
+        assert_eq!(method.ty.as_deref(), Some("({x: Int64, y: Int64} → Int64)"));
+    }
+
+    #[test]
+    fn edits_reinfer_only_the_declaration_and_changed_dependents() {
+        let (store, mut a) = analyzed(PROGRAM);
+        assert_eq!(a.inferred.len(), 11);
+
+        // Same type: dependents `f` and `g` are cut off.
+        replace(&mut a, &store, "const a = 1;", "const a = 7;");
+        assert_eq!(a.inferred, ["a"]);
+
+        // New type: the dependent `h` follows; `f` and `g` do not.
+        replace(&mut a, &store, "const b = \"s\";", "const b = 2;");
+        assert_eq!(a.inferred, ["b", "h"]);
+        let h = a.source().find("const h").unwrap() + 6;
+        assert_eq!(a.hover(h).unwrap().ty.as_deref(), Some("Int64"));
+
+        // A body edit that keeps the signature stays local.
+        replace(&mut a, &store, "x + a", "x * a");
+        assert_eq!(a.inferred, ["f"]);
+
+        // Whitespace between declarations re-infers nothing.
+        replace(&mut a, &store, "\nconst g", "\n\n  const g");
+        assert!(a.inferred.is_empty());
+        assert_matches_fresh(&a);
+    }
+
+    #[test]
+    fn type_declarations_reinfer_everything() {
+        let (store, mut a) = analyzed(PROGRAM);
+        replace(
+            &mut a,
+            &store,
+            "const a = 1;\n",
+            "struct Size { w: Int64 };\nconst a = 1;\n",
+        );
+        assert_eq!(a.inferred.len(), 12);
+        assert_matches_fresh(&a);
+
+        // A new struct changes how `Size { .. }` parses elsewhere.
+        replace(&mut a, &store, "const h = b;", "const h = Size { w: a };");
+        assert_matches_fresh(&a);
+        assert_eq!(
+            a.hover(a.source().find("const h").unwrap() + 6)
+                .unwrap()
+                .ty
+                .as_deref(),
+            Some("{w: Int64}")
+        );
+    }
+
+    #[test]
+    fn syntax_errors_keep_the_last_good_answers_until_fixed() {
+        let (store, mut a) = analyzed(PROGRAM);
+        let at = PROGRAM.find("const g").unwrap();
+        let broken = TextEdit {
+            start: at,
+            end: at + 5,
+            text: "cnst".to_string(),
+        };
+        assert!(matches!(
+            a.apply_edits(&store, &[broken]),
+            Err(BuildError::Parse(_))
+        ));
+        // queries still answer against the text that parsed
+        assert_eq!(a.hover(at + 6).unwrap().ty.as_deref(), Some("Int64"));
+        assert!(a
+            .apply_edits(
+                &store,
+                &[TextEdit {
+                    start: at,
+                    end: at + 4,
+                    text: "const".into()
+                }]
+            )
+            .is_ok());
+        assert_eq!(a.source(), PROGRAM);
+        assert_matches_fresh(&a);
+
+        let unknown = TextEdit {
+            start: at + 10,
+            end: at + 11,
+            text: "nope".into(),
+        };
+        assert!(matches!(
+            a.apply_edits(&store, &[unknown]),
+            Err(BuildError::Infer(_))
+        ));
+        replace(&mut a, &store, "nope", "f");
+        assert_matches_fresh(&a);
+    }
+
+    #[test]
+    fn open_declarations_follow_the_statements_refining_them() {
+        let (store, mut a) = analyzed("var total;\nconst one = 1;\ntotal = one;\n");
+        assert_eq!(a.hover(4).unwrap().ty.as_deref(), Some("Int64"));
+        replace(&mut a, &store, "const one = 1;", "const one = \"s\";");
+        assert_eq!(a.hover(4).unwrap().ty.as_deref(), Some("String"));
+        replace(&mut a, &store, "total = one;\n", "");
+        assert_matches_fresh(&a);
+        assert_ne!(a.hover(4).unwrap().ty.as_deref(), Some("String"));
+    }
+
+    #[test]
+    fn batched_edits_apply_in_order() {
+        let (store, mut a) = analyzed("const a = 1;\nconst b = a;\n");
+        let edits = [
+            TextEdit {
+                start: 10,
+                end: 11,
+                text: "\"é\"".into(),
+            },
+            TextEdit {
+                start: 30,
+                end: 30,
+                text: "const c = b;\n".into(),
+            },
+        ];
+        a.apply_edits(&store, &edits).unwrap();
+        assert_eq!(a.source(), "const a = \"é\";\nconst b = a;\nconst c = b;\n");
+        // `c` runs again once `b` turns out to change with `a`
+        let mut inferred = a.inferred.clone();
+        inferred.sort();
+        inferred.dedup();
+        assert_eq!(inferred, ["a", "b", "c"]);
+        assert_matches_fresh(&a);
+    }
+
+    #[test]
+    fn random_edits_match_a_fresh_analysis() {
+        const SNIPPETS: &[&str] = &[
+            " ",
+            "\n",
+            ";",
+            "1",
+            "a",
+            "b",
+            "x",
+            "{",
+            "}",
+            "(",
+            ")",
+            "\"",
+            "//",
+            "+",
+            "const q = a;",
+            "var r = 2.5;",
+            "var w;",
+            "w = 1;",
+            "é",
+            "Point",
+            ".x",
+            "return",
+            "struct",
+        ];
+        let mut seed = 0x2545_f491_4f6c_dd1du64;
+        let mut next = |n: usize| {
+            seed ^= seed << 13;
+            seed ^= seed >> 7;
+            seed ^= seed << 17;
+            (seed % n as u64) as usize
+        };
+        let store = ArtifactStore::new();
+        let mut a = Analysis::new("test");
+        a.set_text(&store, PROGRAM).unwrap();
+        let check = |a: &Analysis, result: &Result<(), BuildError>, step: usize| {
+            let mut fresh = Analysis::new("test");
+            let expected = fresh.set_text(&ArtifactStore::new(), a.source());
+            assert_eq!(
+                std::mem::discriminant(&result.as_ref().map(|_| ())),
+                std::mem::discriminant(&expected.as_ref().map(|_| ())),
+                "{result:?} vs {expected:?} after step {step}:\n{}",
+                a.source()
+            );
+            if result.is_ok() {
+                assert_eq!(
+                    observe(a),
+                    observe(&fresh),
+                    "after step {step}:\n{}",
+                    a.source()
+                );
+            }
+        };
+        let mut applied = 0;
+        for step in 0..400 {
+            let len = a.source().chars().count();
+            let start = next(len + 1);
+            let end = (start + next(4)).min(len);
+            let text = if step % 3 == 0 {
+                ""
+            } else {
+                SNIPPETS[next(SNIPPETS.len())]
+            };
+            let old: String = a.source().chars().skip(start).take(end - start).collect();
+            let edit = TextEdit {
+                start,
+                end,
+                text: text.to_string(),
+            };
+            let result = a.apply_edits(&store, &[edit]);
+            check(&a, &result, step);
+            if result.is_ok() {
+                applied += 1;
+                continue;
+            }
+            // Undo, so edits keep landing on a program that checks.
+            let undo = TextEdit {
+                start,
+                end: start + text.chars().count(),
+                text: old,
+            };
+            let result = a.apply_edits(&store, &[undo]);
+            assert!(
+                result.is_ok(),
+                "undo of step {step} ({start}..{end} {text:?}): {result:?}\n{}",
+                a.source()
+            );
+            check(&a, &result, step);
+        }
+        assert!(applied > 40, "only {applied} edits kept the program valid");
+    }
+
+    #[test]
+    fn char_offsets_follow_multibyte_text() {
+        let text = "é=1; x";
+        let mut offs = [text.len(), 0, 4];
+        to_char_offsets(text, false, &mut offs);
+        assert_eq!(offs, [6, 0, 3]);
+        assert_eq!(byte_of(text, false, 5), 6);
+        assert_eq!(identifier_at(text, 0), Some("é"));
+    }
+}
@@ -2,17 +2,20 @@
 //!
 //! This crate is a tooling/use-case layer. It provides:
 //! - Token-based semantic tokens and completions (legacy)
-//! - LspCoordinator: semantic-aware editor features via compiler frontend
+//! - LspCoordinator: semantic-aware editor features via compiler frontend,
+//!   updated incrementally per declaration on each edit
 
+pub mod analysis;
 pub mod dag_lsp;
 pub mod lsp_coordinator;
 
+pub use analysis::TextEdit;
 pub use dag_lsp::DagLspCoordinator;
 pub use lsp_coordinator::{HoverInfo, InlayHint, LspCoordinator, Reference, SymbolDef, SymbolKind};
 
 use kaubo_syntax::lexer::Lexer;
-use kaubo_syntax::token::{Token, TokenKind};
-use kaubo_web_api::token::{classify_token, utf16_range};
+use kaubo_syntax::token::{RawToken, Token, TokenKind};
+use kaubo_web_api::token::{classify_token, Utf16Cursor};
 use serde::{Deserialize, Serialize};
 use std::collections::{BTreeMap, BTreeSet};
 
@@ -118,22 +121,23 @@ struct SemanticModel {
 }
 
 pub fn semantic_tokens(source: &str) -> Vec<SemanticToken> {
-    let tokens = visible_tokens(source);
+    let (tokens, spans) = visible_tokens(source);
     let model = build_model(&tokens);
+    let mut utf16 = Utf16Cursor::new(source);
 
-    tokens
+    spans
         .iter()
         .enumerate()
-        .map(|(idx, token)| {
+        .map(|(idx, span)| {
             let kind = semantic_kind(&tokens, idx, &model);
-            let (from, to) = utf16_range(source, token.line, token.col, &token.lexeme);
+            let (from, to) = utf16.range(span);
             SemanticToken { kind, from, to }
         })
         .collect()
 }
 
 pub fn completions(source: &str, offset: usize) -> Vec<CompletionItem> {
-    let tokens = visible_tokens(source);
+    let (tokens, _) = visible_tokens(source);
     let model = build_model(&tokens);
 
     // Determine receiver type: simple variable/literal, or chained method call
@@ -188,12 +192,13 @@ pub fn completions(source: &str, offset: usize) -> Vec<CompletionItem> {
     result
 }
 
-fn visible_tokens(source: &str) -> Vec<Token> {
-    Lexer::new(source)
-        .tokenize()
-        .into_iter()
-        .filter(|token| !matches!(token.kind, TokenKind::Whitespace | TokenKind::Eof))
-        .collect()
+/// Tokens without whitespace and `Eof`, with their byte spans.
+fn visible_tokens(source: &str) -> (Vec<Token>, Vec<RawToken>) {
+    let mut lexer = Lexer::new(source);
+    std::iter::from_fn(|| Some(lexer.next_spanned()))
+        .take_while(|(token, _)| token.kind != TokenKind::Eof)
+        .filter(|(token, _)| token.kind != TokenKind::Whitespace)
+        .unzip()
 }
 
 fn semantic_kind(tokens: &[Token], idx: usize, model: &SemanticModel) -> String {
@@ -26,7 +26,7 @@ impl EventHandler for ConsoleHandler {
             ToolchainEvent::Vm(kaubo_log::VmEvent::Instruction { .. }) => {
                 self.min_level <= Severity::Trace
             }
-            // Other VM events (LoopIteration, LoopNearLimit) are debug-level
+            // Other VM events (LoopIteration, LoopNearLimit, GcCollected, InlineCache*) are debug-level
             ToolchainEvent::Vm(_) => self.min_level <= Severity::Debug,
             // CPS and Pass events are debug-level
             ToolchainEvent::Cps(_) | ToolchainEvent::Pass(_) => self.min_level <= Severity::Debug,
@@ -92,6 +92,27 @@ fn format_vm(event: &kaubo_log::VmEvent) -> String {
         } => {
             format!("[VM] loop near limit: fn={func_idx} block={block_id} count={count}/{limit}")
         }
+        kaubo_log::VmEvent::GcCollected { freed, live } => {
+            format!("[VM] gc: freed={freed} live={live}")
+        }
+        kaubo_log::VmEvent::InlineCacheMiss {
+            func_idx,
+            site,
+            vtable_idx,
+            entries,
+            megamorphic,
+        } => {
+            let state = if *megamorphic { " megamorphic" } else { "" };
+            format!("[VM] ic miss: fn={func_idx} site={site} vtable={vtable_idx} entries={entries}{state}")
+        }
+        kaubo_log::VmEvent::InlineCacheStats {
+            sites,
+            hits,
+            misses,
+            megamorphic,
+        } => {
+            format!("[VM] ic: sites={sites} hits={hits} misses={misses} megamorphic={megamorphic}")
+        }
     }
 }
 
@@ -111,8 +132,38 @@ fn format_pass(event: &kaubo_log::PassEvent) -> String {
         kaubo_log::PassEvent::Started { name } => {
             format!("[PASS] {name} started")
         }
-        kaubo_log::PassEvent::Finished { name } => {
-            format!("[PASS] {name} finished")
+        kaubo_log::PassEvent::Finished {
+            name,
+            micros,
+            instructions,
+            registers,
+        } => {
+            format!(
+                "[PASS] {name} finished in {micros}us \
+                 (instructions {instructions:+}, registers {registers:+})"
+            )
+        }
+        kaubo_log::PassEvent::InstrCount {
+            name,
+            before,
+            after,
+        } => {
+            format!("[PASS] {name} instructions {before} -> {after}")
+        }
+        kaubo_log::PassEvent::FrameSize {
+            name,
+            before,
+            after,
+        } => {
+            format!("[PASS] {name} frame registers {before} -> {after}")
+        }
+        kaubo_log::PassEvent::Allocations {
+            name,
+            function,
+            before,
+            after,
+        } => {
+            format!("[PASS] {name} {function}: allocations {before} -> {after}")
         }
     }
 }
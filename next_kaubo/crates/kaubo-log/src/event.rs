@@ -40,6 +40,26 @@ pub enum VmEvent {
         count: u64,
         limit: u64,
     },
+    /// The backup mark/sweep collector ran.
+    GcCollected { freed: usize, live: usize },
+    /// A `CallIndirect` inline cache missed and was refilled from the vtable.
+    InlineCacheMiss {
+        func_idx: usize,
+        /// Call-site number, in instruction order across the program.
+        site: usize,
+        vtable_idx: usize,
+        /// Receiver vtables now cached at the site.
+        entries: usize,
+        /// The site saw too many vtables and stopped caching.
+        megamorphic: bool,
+    },
+    /// Inline cache totals since the last VM reset, emitted when `execute` completes.
+    InlineCacheStats {
+        sites: usize,
+        hits: u64,
+        misses: u64,
+        megamorphic: usize,
+    },
 }
 
 // ── CPS / IR build events ──
@@ -64,8 +84,34 @@ pub enum CpsEvent {
 pub enum PassEvent {
     /// A pass is about to run.
     Started { name: &'static str },
-    /// A pass has completed.
-    Finished { name: &'static str },
+    /// A pass has completed, after `micros` of wall time. `instructions` and
+    /// `registers` are the changes in module size and summed frame size.
+    Finished {
+        name: &'static str,
+        micros: u64,
+        instructions: i64,
+        registers: i64,
+    },
+    /// Module size around a pass, in instructions plus one terminator per block.
+    InstrCount {
+        name: &'static str,
+        before: usize,
+        after: usize,
+    },
+    /// Module size around a pass, in registers summed over all function frames.
+    FrameSize {
+        name: &'static str,
+        before: usize,
+        after: usize,
+    },
+    /// Heap allocation sites in one function the pass changed, in allocating
+    /// instructions (`NewStruct`, `NewTuple`, `Box`, ...).
+    Allocations {
+        name: &'static str,
+        function: String,
+        before: usize,
+        after: usize,
+    },
 }
 
 // ── Top-level event ──
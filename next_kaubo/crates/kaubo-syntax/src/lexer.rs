@@ -1,24 +1,54 @@
 //! Lexer — Kaubo v2
+//!
+//! 按字节扫描，产出 `RawToken`（种类 + 源码字节区间），不拷贝词面。空白、
+//! 标识符、数字、行注释和字符串主体在 ASCII 区段上一次比较 8 个字节（SWAR），
+//! 遇到非 ASCII 字节再退回逐字符判断。标识符在扫描时驻留进 `Interner`。
+//!
+//! 扫描时不维护行列号：`next_token` / `tokenize` 组装带词面的 `Token` 时顺序推算，
+//! parser 用 `LineIndex` 按需换算。`Lexer` 本身是 `RawToken` 的流式迭代器。
 
-use crate::token::{Token, TokenKind};
-use std::iter::Peekable;
-use std::str::Chars;
+use crate::token::{Interner, RawToken, Symbol, Token, TokenKind};
 
 pub struct Lexer<'a> {
-    chars: Peekable<Chars<'a>>,
-    line: usize,
-    col: usize,
+    source: &'a str,
+    bytes: &'a [u8],
+    pos: usize,
+    interner: Interner,
+    /// `next_token` 推算行列号的游标
+    cursor: Cursor,
+    done: bool,
 }
 
 impl<'a> Lexer<'a> {
     pub fn new(source: &'a str) -> Self {
+        Self::with_interner(source, Interner::new())
+    }
+
+    /// 在已有驻留表上继续驻留，符号与之前交给 parser 的一致。
+    pub fn with_interner(source: &'a str, interner: Interner) -> Self {
+        assert!(source.len() <= u32::MAX as usize, "source exceeds 4 GiB");
         Self {
-            chars: source.chars().peekable(),
-            line: 1,
-            col: 1,
+            source,
+            bytes: source.as_bytes(),
+            pos: 0,
+            interner,
+            cursor: Cursor::new(),
+            done: false,
         }
     }
 
+    pub fn source(&self) -> &'a str {
+        self.source
+    }
+
+    pub fn interner(&self) -> &Interner {
+        &self.interner
+    }
+
+    pub fn into_interner(self) -> Interner {
+        self.interner
+    }
+
     pub fn tokenize(&mut self) -> Vec<Token> {
         let mut tokens = Vec::new();
         loop {
@@ -32,347 +62,399 @@ impl<'a> Lexer<'a> {
         tokens
     }
 
+    /// 下一个带词面和行列号的 token。
     pub fn next_token(&mut self) -> Token {
-        self.skip_whitespace_and_comments();
+        self.next_spanned().0
+    }
 
-        let line = self.line;
-        let col = self.col;
+    /// 下一个 token，同时给出带词面的形式和它的字节区间。
+    pub fn next_spanned(&mut self) -> (Token, RawToken) {
+        let raw = self.next_raw();
+        let (line, col) = self.cursor.advance(self.bytes, raw.start as usize);
+        (
+            Token::new(raw.kind, lexeme(self.source, &raw), line, col),
+            raw,
+        )
+    }
 
-        match self.bump() {
-            None => Token::eof(line, col),
-            Some(c) => self.scan_token(c, line, col),
+    /// 下一个零拷贝 token；到末尾后一直返回 `Eof`。
+    pub fn next_raw(&mut self) -> RawToken {
+        self.skip_whitespace();
+        let start = self.pos;
+        let Some(&b) = self.bytes.get(start) else {
+            return self.raw(TokenKind::Eof, start);
+        };
+        self.pos += 1;
+        let kind = self.scan_token(b);
+        let sym = if kind == TokenKind::Identifier {
+            self.interner.intern(&self.source[start..self.pos])
+        } else {
+            Symbol::NONE
+        };
+        RawToken {
+            kind,
+            sym,
+            start: start as u32,
+            end: self.pos as u32,
         }
     }
 
-    fn scan_token(&mut self, c: char, line: usize, col: usize) -> Token {
-        let tk = |kind| Token::new(kind, c.to_string(), line, col);
+    fn raw(&self, kind: TokenKind, start: usize) -> RawToken {
+        RawToken {
+            kind,
+            sym: Symbol::NONE,
+            start: start as u32,
+            end: self.pos as u32,
+        }
+    }
 
-        match c {
+    /// 首字节 `b` 已越过；扫完 token 其余部分，`pos` 停在 token 之后。
+    fn scan_token(&mut self, b: u8) -> TokenKind {
+        match b {
             // ── 单字符定界符 ──
-            '(' => tk(TokenKind::LParen),
-            ')' => tk(TokenKind::RParen),
-            '{' => tk(TokenKind::LBrace),
-            '}' => tk(TokenKind::RBrace),
-            '[' => tk(TokenKind::LBracket),
-            ']' => tk(TokenKind::RBracket),
-            ',' => tk(TokenKind::Comma),
-            ';' => tk(TokenKind::Semicolon),
-            ':' => tk(TokenKind::Colon),
-            '.' => self.scan_dot(line, col),
+            b'(' => TokenKind::LParen,
+            b')' => TokenKind::RParen,
+            b'{' => TokenKind::LBrace,
+            b'}' => TokenKind::RBrace,
+            b'[' => TokenKind::LBracket,
+            b']' => TokenKind::RBracket,
+            b',' => TokenKind::Comma,
+            b';' => TokenKind::Semicolon,
+            b':' => TokenKind::Colon,
+            b'.' => {
+                if self.eat_pair(b'.', b'.') {
+                    TokenKind::DotDotDot
+                } else {
+                    TokenKind::Dot
+                }
+            }
 
             // ── 运算符 (单/双字符) ──
-            '+' => tk(TokenKind::Plus),
-            '*' => tk(TokenKind::Asterisk),
-            '%' => tk(TokenKind::Percent),
-            '-' => self.scan_minus_arrow(line, col),
-            '/' => self.scan_slash(line, col),
-            '=' => self.scan_eq(line, col),
-            '!' => self.scan_bang(line, col),
-            '<' => self.scan_lt(line, col),
-            '>' => self.scan_gt(line, col),
-            '|' => self.scan_pipe(line, col),
-            '?' => self.scan_question(line, col),
-            '`' => self.scan_template_string(line, col),
+            b'+' => TokenKind::Plus,
+            b'*' => TokenKind::Asterisk,
+            b'%' => TokenKind::Percent,
+            b'-' => self.pick(b'>', TokenKind::FatArrow, TokenKind::Minus),
+            b'/' => self.scan_slash(),
+            b'=' => self.pick(b'=', TokenKind::EqEq, TokenKind::Eq),
+            b'!' => self.pick(b'=', TokenKind::NotEq, TokenKind::Error),
+            b'<' => self.pick(b'=', TokenKind::Le, TokenKind::Lt),
+            b'>' => match self.peek() {
+                Some(b'=') => self.take(TokenKind::Ge),
+                Some(b'>') => self.take(TokenKind::GtGt),
+                _ => TokenKind::Gt,
+            },
+            b'|' => self.pick(b'>', TokenKind::Pipe, TokenKind::Bar),
+            b'?' => match self.peek() {
+                Some(b'?') => self.take(TokenKind::QuestionQuestion),
+                Some(b'.') => self.take(TokenKind::QuestionDot),
+                Some(b'[') => self.take(TokenKind::QuestionLBracket),
+                _ => TokenKind::Error,
+            },
+            b'`' => self.scan_quoted(b'`', TokenKind::TemplateString),
 
             // ── 字符串 ──
-            '"' | '\'' => self.scan_string(c, line, col),
+            b'"' | b'\'' => self.scan_quoted(b, TokenKind::StringLiteral),
 
             // ── 数字 ──
-            '0'..='9' => self.scan_number(c, line, col),
+            b'0'..=b'9' => self.scan_number(),
 
             // ── 标识符/关键字 ──
-            'a'..='z' | 'A'..='Z' | '_' => self.scan_ident(c, line, col),
-
-            _ => Token::new(TokenKind::Error, c.to_string(), line, col),
+            b'a'..=b'z' | b'A'..=b'Z' | b'_' => self.scan_ident(),
+
+            // 其余 ASCII 或非 ASCII 字符：整个字符作为错误 token
+            _ => {
+                self.pos -= 1;
+                let c = self.source[self.pos..].chars().next().unwrap();
+                self.pos += c.len_utf8();
+                TokenKind::Error
+            }
         }
     }
 
     // ── 辅助 ──
 
-    fn peek(&mut self) -> Option<char> {
-        self.chars.peek().copied()
+    fn peek(&self) -> Option<u8> {
+        self.bytes.get(self.pos).copied()
     }
 
-    fn bump(&mut self) -> Option<char> {
-        let c = self.chars.next()?;
-        if c == '\n' {
-            self.line += 1;
-            self.col = 1;
-        } else {
-            self.col += 1;
-        }
-        Some(c)
-    }
-
-    fn advance(&mut self) {
-        let _ = self.bump();
+    fn take(&mut self, kind: TokenKind) -> TokenKind {
+        self.pos += 1;
+        kind
     }
 
-    fn skip_whitespace_and_comments(&mut self) {
-        loop {
-            match self.peek() {
-                Some(' ') | Some('\t') | Some('\r') => {
-                    self.advance();
-                }
-                Some('\n') => {
-                    self.advance();
-                }
-                _ => break,
-            }
-        }
-    }
-
-    fn scan_dot(&mut self, line: usize, col: usize) -> Token {
-        // Peek ahead for ... (DotDotDot)
-        let mut peek_iter = self.chars.clone();
-        if peek_iter.next() == Some('.') && peek_iter.next() == Some('.') {
-            self.advance(); // second dot
-            self.advance(); // third dot
-            return Token::new(TokenKind::DotDotDot, "...".into(), line, col);
+    /// 下一个字节是 `next` 时吞掉它得到 `long`，否则是 `short`。
+    fn pick(&mut self, next: u8, long: TokenKind, short: TokenKind) -> TokenKind {
+        if self.peek() == Some(next) {
+            self.take(long)
+        } else {
+            short
         }
-        Token::new(TokenKind::Dot, ".".to_string(), line, col)
     }
 
-    fn scan_minus_arrow(&mut self, line: usize, col: usize) -> Token {
-        if self.peek() == Some('>') {
-            self.advance();
-            Token::new(TokenKind::FatArrow, "->".into(), line, col)
-        } else {
-            Token::new(TokenKind::Minus, "-".into(), line, col)
+    fn eat_pair(&mut self, a: u8, b: u8) -> bool {
+        let hit = self.bytes.get(self.pos..self.pos + 2) == Some(&[a, b]);
+        if hit {
+            self.pos += 2;
         }
+        hit
     }
 
-    fn scan_slash(&mut self, line: usize, col: usize) -> Token {
-        if self.peek() == Some('/') {
-            self.advance();
-            let comment = self.collect_line_comment();
-            return Token::new(TokenKind::Comment, comment, line, col);
-        }
-        if self.peek() == Some('*') {
-            self.advance();
-            let comment = self.collect_block_comment();
-            return Token::new(TokenKind::Comment, comment, line, col);
+    fn skip_whitespace(&mut self) {
+        if self.peek().is_some_and(is_space) {
+            self.pos = ascii_run(self.bytes, self.pos + 1, space_mask, is_space);
         }
-        Token::new(TokenKind::Slash, "/".into(), line, col)
     }
 
-    fn collect_line_comment(&mut self) -> String {
-        let mut s = String::from("//");
-        while let Some(c) = self.peek() {
-            if c == '\n' {
-                break;
+    fn scan_slash(&mut self) -> TokenKind {
+        match self.peek() {
+            Some(b'/') => {
+                self.pos = find_byte(self.bytes, self.pos + 1, b'\n', b'\n');
+                TokenKind::Comment
             }
-            s.push(c);
-            self.advance();
+            Some(b'*') => {
+                self.pos += 1;
+                self.skip_block_comment();
+                TokenKind::Comment
+            }
+            _ => TokenKind::Slash,
         }
-        s
     }
 
-    fn collect_block_comment(&mut self) -> String {
-        let mut s = String::from("/*");
+    /// 可嵌套；未闭合时吃到文件末尾。
+    fn skip_block_comment(&mut self) {
         let mut depth = 1;
-        while let Some(c) = self.peek() {
-            s.push(c);
-            self.advance();
-            match c {
-                '/' if self.peek() == Some('*') => {
-                    s.push('*');
-                    self.advance();
+        while let Some(b) = self.peek() {
+            self.pos += 1;
+            match b {
+                b'/' if self.peek() == Some(b'*') => {
+                    self.pos += 1;
                     depth += 1;
                 }
-                '*' if self.peek() == Some('/') => {
-                    s.push('/');
-                    self.advance();
+                b'*' if self.peek() == Some(b'/') => {
+                    self.pos += 1;
                     depth -= 1;
                     if depth == 0 {
-                        return s;
+                        return;
                     }
                 }
-                '\n' => {}
                 _ => {}
             }
         }
-        s
     }
 
-    fn scan_eq(&mut self, line: usize, col: usize) -> Token {
-        if self.peek() == Some('=') {
-            self.advance();
-            Token::new(TokenKind::EqEq, "==".into(), line, col)
-        } else {
-            Token::new(TokenKind::Eq, "=".into(), line, col)
-        }
-    }
-
-    fn scan_bang(&mut self, line: usize, col: usize) -> Token {
-        if self.peek() == Some('=') {
-            self.advance();
-            Token::new(TokenKind::NotEq, "!=".into(), line, col)
-        } else {
-            Token::new(TokenKind::Error, "!".into(), line, col)
+    /// 字符串和模板字符串；反斜杠连同下一个字节跳过，转义留到取值时再解。
+    fn scan_quoted(&mut self, quote: u8, kind: TokenKind) -> TokenKind {
+        loop {
+            self.pos = find_byte(self.bytes, self.pos, quote, b'\\');
+            match self.peek() {
+                None => return TokenKind::Error,
+                Some(b'\\') => self.pos += 2,
+                Some(_) => return self.take(kind),
+            }
+            if self.pos >= self.bytes.len() {
+                self.pos = self.bytes.len();
+                return TokenKind::Error;
+            }
         }
     }
 
-    fn scan_lt(&mut self, line: usize, col: usize) -> Token {
-        if self.peek() == Some('=') {
-            self.advance();
-            Token::new(TokenKind::Le, "<=".into(), line, col)
-        } else {
-            Token::new(TokenKind::Lt, "<".into(), line, col)
+    fn scan_number(&mut self) -> TokenKind {
+        self.pos = ascii_run(self.bytes, self.pos, digit_mask, is_digit);
+        // `42.0` 是浮点，`42.as_float()` 是整数 + `.`
+        if self.peek() == Some(b'.') && self.bytes.get(self.pos + 1).is_some_and(u8::is_ascii_digit)
+        {
+            self.pos = ascii_run(self.bytes, self.pos + 1, digit_mask, is_digit);
+            return TokenKind::FloatLiteral;
         }
+        TokenKind::IntLiteral
     }
 
-    fn scan_gt(&mut self, line: usize, col: usize) -> Token {
-        match self.peek() {
-            Some('=') => {
-                self.advance();
-                Token::new(TokenKind::Ge, ">=".into(), line, col)
+    fn scan_ident(&mut self) -> TokenKind {
+        let start = self.pos - 1;
+        loop {
+            self.pos = ascii_run(self.bytes, self.pos, ident_mask, is_ident);
+            // 非 ASCII 的字母数字也可以接在标识符里
+            if self.peek().is_none_or(|b| b.is_ascii()) {
+                break;
             }
-            Some('>') => {
-                self.advance();
-                Token::new(TokenKind::GtGt, ">>".into(), line, col)
+            match self.source[self.pos..].chars().next() {
+                Some(c) if c.is_alphanumeric() => self.pos += c.len_utf8(),
+                _ => break,
             }
-            _ => Token::new(TokenKind::Gt, ">".into(), line, col),
         }
+        TokenKind::from_ident(&self.source[start..self.pos])
     }
+}
 
-    fn scan_template_string(&mut self, line: usize, col: usize) -> Token {
-        let mut s = String::from("`");
-        while let Some(c) = self.bump() {
-            if c == '`' {
-                s.push('`');
-                return Token::new(TokenKind::TemplateString, s, line, col);
-            }
-            if c == '\\' {
-                if let Some(next) = self.bump() {
-                    s.push(match next {
-                        'n' => '\n',
-                        'r' => '\r',
-                        't' => '\t',
-                        '\\' => '\\',
-                        '`' => '`',
-                        other => other,
-                    });
-                }
-            } else {
-                s.push(c);
-            }
+impl Iterator for Lexer<'_> {
+    type Item = RawToken;
+
+    /// 逐个产出 token，不含末尾的 `Eof`。
+    fn next(&mut self) -> Option<RawToken> {
+        if self.done {
+            return None;
         }
-        Token::new(
-            TokenKind::Error,
-            "unterminated template string".into(),
-            line,
-            col,
-        )
+        let tok = self.next_raw();
+        self.done = tok.kind == TokenKind::Eof;
+        (!self.done).then_some(tok)
     }
+}
 
-    fn scan_question(&mut self, line: usize, col: usize) -> Token {
-        match self.peek() {
-            Some('?') => {
-                self.advance();
-                Token::new(TokenKind::QuestionQuestion, "??".into(), line, col)
-            }
-            Some('.') => {
-                self.advance();
-                Token::new(TokenKind::QuestionDot, "?.".into(), line, col)
-            }
-            Some('[') => {
-                self.advance();
-                Token::new(TokenKind::QuestionLBracket, "?[".into(), line, col)
-            }
-            _ => Token::new(TokenKind::Error, "?".into(), line, col),
+/// `Token::lexeme` 的内容：字符串字面量是引号 + 解码后的内容 + 引号，
+/// 未闭合的字符串 / 模板是错误说明，其余就是源码原文。
+pub fn lexeme(source: &str, tok: &RawToken) -> String {
+    let text = tok.text(source);
+    match (tok.kind, text.as_bytes().first()) {
+        (TokenKind::StringLiteral | TokenKind::TemplateString, _) => {
+            let quote = &text[..1];
+            format!("{quote}{}{quote}", unescape(&text[1..text.len() - 1]))
+        }
+        (TokenKind::Error, Some(b'"' | b'\'')) => {
+            format!(
+                "unterminated string: {}{}",
+                &text[..1],
+                unescape(&text[1..])
+            )
         }
+        (TokenKind::Error, Some(b'`')) => "unterminated template string".into(),
+        _ => text.to_string(),
     }
+}
 
-    fn scan_pipe(&mut self, line: usize, col: usize) -> Token {
-        if self.peek() == Some('>') {
-            self.advance();
-            Token::new(TokenKind::Pipe, "|>".into(), line, col)
-        } else {
-            Token::new(TokenKind::Bar, "|".into(), line, col)
+/// 字符串（或模板字符串）字面量去掉引号、解码转义后的值。
+pub fn string_value(source: &str, tok: &RawToken) -> String {
+    let text = tok.text(source);
+    unescape(&text[1..text.len() - 1])
+}
+
+/// 解码 `\n` `\r` `\t`；其余 `\x` 就是 `x`，末尾孤立的 `\` 丢弃。
+fn unescape(body: &str) -> String {
+    if !body.contains('\\') {
+        return body.to_string();
+    }
+    let mut s = String::with_capacity(body.len());
+    let mut chars = body.chars();
+    while let Some(c) = chars.next() {
+        if c != '\\' {
+            s.push(c);
+            continue;
+        }
+        match chars.next() {
+            Some('n') => s.push('\n'),
+            Some('r') => s.push('\r'),
+            Some('t') => s.push('\t'),
+            Some(other) => s.push(other),
+            None => break,
         }
     }
+    s
+}
 
-    fn scan_string(&mut self, quote: char, line: usize, col: usize) -> Token {
-        let mut s = String::from(quote);
-        while let Some(c) = self.bump() {
-            if c == quote {
-                s.push(quote);
-                return Token::new(TokenKind::StringLiteral, s, line, col);
-            }
-            if c == '\\' {
-                match self.bump() {
-                    Some('n') => s.push('\n'),
-                    Some('r') => s.push('\r'),
-                    Some('t') => s.push('\t'),
-                    Some('\\') => s.push('\\'),
-                    Some('"') => s.push('"'),
-                    Some('\'') => s.push('\''),
-                    Some(other) => s.push(other),
-                    None => break,
-                }
-            } else {
-                s.push(c);
-            }
+/// 顺序推算行列号：token 按源码顺序产出，游标只向前走。
+struct Cursor {
+    offset: usize,
+    line: usize,
+    col: usize,
+}
+
+impl Cursor {
+    fn new() -> Self {
+        Self {
+            offset: 0,
+            line: 1,
+            col: 1,
         }
-        Token::new(
-            TokenKind::Error,
-            format!("unterminated string: {s}"),
-            line,
-            col,
-        )
     }
 
-    fn scan_number(&mut self, first: char, line: usize, col: usize) -> Token {
-        let mut s = String::new();
-        s.push(first);
-        while let Some(&c) = self.chars.peek() {
-            if c.is_ascii_digit() || c == '_' {
-                s.push(c);
-                self.advance();
-            } else {
-                break;
+    fn advance(&mut self, bytes: &[u8], to: usize) -> (usize, usize) {
+        for &b in &bytes[self.offset..to] {
+            if b == b'\n' {
+                self.line += 1;
+                self.col = 1;
+            } else if b & 0xc0 != 0x80 {
+                // 每个字符只在首字节计一列
+                self.col += 1;
             }
         }
-        // Peek two chars to distinguish `42.0` (float) from `42.as_float()` (int + dot)
-        if self.peek() == Some('.') {
-            // save position, try to peek after dot
-            let mut iter = self.chars.clone();
-            iter.next(); // skip the dot
-            let after_dot = iter.next();
-            if after_dot.is_some_and(|c| c.is_ascii_digit()) {
-                // it's a float
-                s.push('.');
-                self.advance();
-                while let Some(&c) = self.chars.peek() {
-                    if c.is_ascii_digit() || c == '_' {
-                        s.push(c);
-                        self.advance();
-                    } else {
-                        break;
-                    }
-                }
-                return Token::new(TokenKind::FloatLiteral, s, line, col);
-            }
-            // else: dot is a separate token, return int now
+        self.offset = to;
+        (self.line, self.col)
+    }
+}
+
+// ── SWAR：把 8 个字节装进一个 u64 同时判断 ──
+
+const LO: u64 = 0x0101_0101_0101_0101;
+const HI: u64 = 0x8080_8080_8080_8080;
+
+fn splat(b: u8) -> u64 {
+    LO * b as u64
+}
+
+/// 落在 `[lo, hi]` 的字节置最高位。只对 ASCII 字节准确，非 ASCII 字节的进位
+/// 只会污染更高的字节，调用方只看最低的不匹配字节。
+fn in_range(x: u64, lo: u8, hi: u8) -> u64 {
+    let ge_lo = x.wrapping_add(splat(0x80 - lo));
+    let gt_hi = x.wrapping_add(splat(0x7f - hi));
+    ge_lo & !gt_hi & HI
+}
+
+fn space_mask(x: u64) -> u64 {
+    in_range(x, b'\t', b'\n') | in_range(x, b'\r', b'\r') | in_range(x, b' ', b' ')
+}
+
+fn digit_mask(x: u64) -> u64 {
+    in_range(x, b'0', b'9') | in_range(x, b'_', b'_')
+}
+
+fn ident_mask(x: u64) -> u64 {
+    in_range(x, b'a', b'z') | in_range(x, b'A', b'Z') | digit_mask(x)
+}
+
+fn is_space(b: u8) -> bool {
+    matches!(b, b' ' | b'\t' | b'\r' | b'\n')
+}
+
+fn is_digit(b: u8) -> bool {
+    b.is_ascii_digit() || b == b'_'
+}
+
+fn is_ident(b: u8) -> bool {
+    b.is_ascii_alphanumeric() || b == b'_'
+}
+
+/// 从 `pos` 起跳过一段 `mask` / `scalar` 接受的 ASCII 字节，返回段后的位置。
+fn ascii_run(bytes: &[u8], mut pos: usize, mask: fn(u64) -> u64, scalar: fn(u8) -> bool) -> usize {
+    while let Some(chunk) = bytes.get(pos..pos + 8) {
+        let x = u64::from_le_bytes(chunk.try_into().unwrap());
+        // 非 ASCII 字节一律不接受
+        let hit = mask(x) & !x & HI;
+        if hit != HI {
+            return pos + ((!hit & HI).trailing_zeros() / 8) as usize;
         }
-        Token::new(TokenKind::IntLiteral, s, line, col)
+        pos += 8;
+    }
+    while bytes.get(pos).copied().is_some_and(scalar) {
+        pos += 1;
     }
+    pos
+}
 
-    fn scan_ident(&mut self, first: char, line: usize, col: usize) -> Token {
-        let mut s = String::new();
-        s.push(first);
-        while let Some(&c) = self.chars.peek() {
-            if c.is_alphanumeric() || c == '_' {
-                s.push(c);
-                self.advance();
-            } else {
-                break;
-            }
+/// 从 `pos` 起第一个等于 `a` 或 `b` 的字节的位置，找不到时是 `bytes.len()`。
+fn find_byte(bytes: &[u8], mut pos: usize, a: u8, b: u8) -> usize {
+    // x ^ splat(a) 中为 0 的字节就是命中；借位只会误报更高的字节，最低位准确
+    let zero = |t: u64| t.wrapping_sub(LO) & !t & HI;
+    while let Some(chunk) = bytes.get(pos..pos + 8) {
+        let x = u64::from_le_bytes(chunk.try_into().unwrap());
+        let hit = zero(x ^ splat(a)) | zero(x ^ splat(b));
+        if hit != 0 {
+            return pos + (hit.trailing_zeros() / 8) as usize;
         }
-        let kind = TokenKind::from_ident(&s);
-        Token::new(kind, s, line, col)
+        pos += 8;
     }
+    bytes[pos..]
+        .iter()
+        .position(|&c| c == a || c == b)
+        .map_or(bytes.len(), |i| pos + i)
 }
 
 #[cfg(test)]
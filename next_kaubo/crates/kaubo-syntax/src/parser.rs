@@ -2,12 +2,19 @@
 //!
 //! 表达式导向，递归下降 + Pratt 运算符解析
 //! `;` 为分隔符，block 最后一个表达式即返回值
+//!
+//! 节点直接写进 `arena::Ast`，`parse()` 再把 arena 降级成 `Module` 树。
 
+use crate::ast::arena::{
+    Ast, ExprId, ExprNode, FieldInit, FieldNode, List, MethodNode, ParamNode, SigNode, StmtId,
+    StmtNode, TypeId, TypeNode, VariantNode,
+};
 use crate::ast::*;
-use crate::lexer::Lexer;
-use crate::token::{Token, TokenKind};
-use std::collections::BTreeSet;
+use crate::lexer::{self, Lexer};
+use crate::token::{Interner, LineIndex, RawToken, Symbol, TokenKind};
+use std::collections::{BTreeMap, BTreeSet, HashMap};
 use std::fmt;
+use std::ops::Range;
 
 #[derive(Debug, Clone)]
 pub struct ParseError {
@@ -32,57 +39,153 @@ impl std::error::Error for ParseError {}
 
 pub type ParseResult<T> = Result<T, ParseError>;
 
-pub struct Parser {
-    tokens: Vec<Token>,
+/// 预扫得到的名字：struct 名，以及 enum 变体 → (所属 enum, tag)。
+///
+/// `Name { ... }` 是否是 struct 字面量、变体字面量的 tag 都看这张表。只解析一段
+/// 源码（增量重解析）时，其余部分定义的名字由调用方通过 [`Parser::with_names`] 补上。
+#[derive(Debug, Clone, Default, PartialEq, Eq)]
+pub struct ParseNames {
+    pub structs: BTreeSet<String>,
+    pub variants: BTreeMap<String, (String, u16)>,
+}
+
+/// token 只存字节区间，词面按需从 `source` 切出；行列号只在生成 span 和报错时
+/// 经 `LineIndex` 换算。名字表按词法分析驻留的符号查。
+///
+/// `exprs` / `stmts` 是子表暂存栈：收集参数、元素、语句时压栈，完成后整段
+/// 拷进 arena 再截回原位，嵌套的子表天然在栈顶。
+pub struct Parser<'a> {
+    source: &'a str,
+    tokens: Vec<RawToken>,
+    lines: LineIndex,
+    ast: Ast,
     pos: usize,
-    struct_names: BTreeSet<String>,
-    variant_names: BTreeSet<String>,
-    variant_to_enum: std::collections::HashMap<String, String>,
-    variant_tag: std::collections::HashMap<String, u16>,
+    struct_names: BTreeSet<Symbol>,
+    variant_names: BTreeSet<Symbol>,
+    variant_to_enum: HashMap<Symbol, Symbol>,
+    variant_tag: HashMap<Symbol, u16>,
     opt_chain_counter: usize,
+    exprs: Vec<ExprId>,
+    stmts: Vec<StmtId>,
 }
 
-impl Parser {
-    pub fn new(source: &str) -> Self {
-        let mut lexer = Lexer::new(source);
-        let tokens = lexer.tokenize();
-        Self::from_tokens(tokens)
-    }
-
-    /// 注册外部已知的结构体名称（用于导入 struct 的解析支持）。
-    ///
-    /// 调用此方法后，parser 会将 `Name { ... }` 形式的语法识别为 StructLit，
-    /// 即使该 struct 没有在当前文件中定义。
-    pub fn register_struct_name(&mut self, name: &str) {
-        self.struct_names.insert(name.to_string());
+impl<'a> Parser<'a> {
+    pub fn new(source: &'a str) -> Self {
+        let mut parser = Self::with_ast(source, Ast::new());
+        parser.ast.reserve(parser.tokens.len());
+        parser
     }
 
-    pub fn from_tokens(tokens: Vec<Token>) -> Self {
+    /// 在已有 arena 上继续解析 `source`（模板字符串插值），符号沿用同一个
+    /// 驻留表。
+    fn with_ast(source: &'a str, mut ast: Ast) -> Self {
+        let interner = std::mem::take(ast.interner_mut());
+        let mut lexer = Lexer::with_interner(source, interner);
+        let mut tokens = Vec::with_capacity(source.len() / 4);
+        loop {
+            let tok = lexer.next_raw();
+            tokens.push(tok);
+            if tok.kind == TokenKind::Eof {
+                break;
+            }
+        }
+        *ast.interner_mut() = lexer.into_interner();
         let struct_names = collect_struct_names(&tokens);
         let (variant_names, variant_to_enum, variant_tag) = collect_enum_metadata(&tokens);
         Self {
+            source,
             tokens,
+            lines: LineIndex::new(source),
+            ast,
             pos: 0,
             struct_names,
             variant_names,
             variant_to_enum,
             variant_tag,
             opt_chain_counter: 0,
+            exprs: Vec::new(),
+            stmts: Vec::new(),
+        }
+    }
+
+    /// 词法分析驻留的标识符表。
+    pub fn interner(&self) -> &Interner {
+        self.ast.interner()
+    }
+
+    /// 解析 `source`，预扫出的名字之外再并入 `names`；同名变体以 `source` 自己的为准。
+    pub fn with_names(source: &'a str, names: &ParseNames) -> Self {
+        let mut parser = Self::new(source);
+        for name in &names.structs {
+            parser.register_struct_name(name);
+        }
+        for (variant, (enum_name, tag)) in &names.variants {
+            let sym = parser.ast.intern(variant);
+            if parser.variant_names.insert(sym) {
+                let enum_sym = parser.ast.intern(enum_name);
+                parser.variant_to_enum.insert(sym, enum_sym);
+                parser.variant_tag.insert(sym, *tag);
+            }
         }
+        parser
+    }
+
+    /// 注册外部已知的结构体名称（用于导入 struct 的解析支持）。
+    ///
+    /// 调用此方法后，parser 会将 `Name { ... }` 形式的语法识别为 StructLit，
+    /// 即使该 struct 没有在当前文件中定义。
+    pub fn register_struct_name(&mut self, name: &str) {
+        let sym = self.ast.intern(name);
+        self.struct_names.insert(sym);
     }
 
     // ── 模块入口 ──
 
+    /// 解析整个模块并降级成 `Module` 树。
     pub fn parse(&mut self) -> ParseResult<Module> {
-        let mut stmts = Vec::new();
+        let roots = self.parse_roots()?;
+        self.ast.set_roots(roots);
+        Ok(self.ast.to_module())
+    }
+
+    /// 解析整个模块，直接返回 arena，不建树。
+    pub fn parse_ast(mut self) -> ParseResult<Ast> {
+        let roots = self.parse_roots()?;
+        self.ast.set_roots(roots);
+        Ok(self.ast)
+    }
+
+    /// 解析整个模块，同时给出每条顶层语句的字节区间：从语句的第一个 token 到最后
+    /// 一个 token，前后的 `;` 和注释不算在内。
+    pub fn parse_extents(&mut self) -> ParseResult<(Module, Vec<Range<usize>>)> {
+        let mark = self.stmts.len();
+        let mut extents = Vec::new();
+        while !self.is_eof() {
+            let first = self.tokens[self.pos..]
+                .iter()
+                .find(|t| !matches!(t.kind, TokenKind::Semicolon | TokenKind::Comment))
+                .map_or(self.current().start, |t| t.start);
+            let stmt = self.parse_top()?;
+            self.stmts.push(stmt);
+            extents.push(first as usize..self.tokens[self.pos - 1].end as usize);
+            self.skip_semis();
+        }
+        let roots = self.stmt_list(mark);
+        self.ast.set_roots(roots);
+        Ok((self.ast.to_module(), extents))
+    }
+
+    fn parse_roots(&mut self) -> ParseResult<List<StmtId>> {
+        let mark = self.stmts.len();
         while !self.is_eof() {
-            stmts.push(self.parse_top()?);
+            let stmt = self.parse_top()?;
+            self.stmts.push(stmt);
             self.skip_semis();
         }
-        Ok(Module { stmts })
+        Ok(self.stmt_list(mark))
     }
 
-    fn parse_top(&mut self) -> ParseResult<Stmt> {
+    fn parse_top(&mut self) -> ParseResult<StmtId> {
         match self.current_kind() {
             TokenKind::Const => self.parse_const(),
             TokenKind::Var => self.parse_var(),
@@ -92,7 +195,8 @@ impl Parser {
             TokenKind::Interface => self.parse_interface(),
             TokenKind::Export => {
                 self.bump();
-                Ok(Stmt::ExportStmt(Box::new(self.parse_top()?)))
+                let inner = self.parse_top()?;
+                Ok(self.ast.add_stmt(StmtNode::ExportStmt(inner)))
             }
             TokenKind::Import => self.parse_import(),
             TokenKind::Semicolon | TokenKind::Comment => {
@@ -102,14 +206,14 @@ impl Parser {
             _ => {
                 let expr = self.parse_expr()?;
                 self.expect_semi()?;
-                Ok(Stmt::ExprStmt(expr))
+                Ok(self.ast.add_stmt(StmtNode::ExprStmt(expr)))
             }
         }
     }
 
     // ── 声明 ──
 
-    fn parse_const(&mut self) -> ParseResult<Stmt> {
+    fn parse_const(&mut self) -> ParseResult<StmtId> {
         self.bump(); // const
         let span = self.current_span();
         let name = self.expect_ident()?;
@@ -117,15 +221,15 @@ impl Parser {
         self.expect(TokenKind::Eq)?;
         let val = self.parse_expr()?;
         self.expect_semi()?;
-        Ok(Stmt::ConstDecl {
+        Ok(self.ast.add_stmt(StmtNode::ConstDecl {
             name,
             span,
             ty_ann: ty,
             value: val,
-        })
+        }))
     }
 
-    fn parse_var(&mut self) -> ParseResult<Stmt> {
+    fn parse_var(&mut self) -> ParseResult<StmtId> {
         self.bump(); // var
         let span = self.current_span();
         let name = self.expect_ident()?;
@@ -137,15 +241,15 @@ impl Parser {
             None
         };
         self.expect_semi()?;
-        Ok(Stmt::VarDecl {
+        Ok(self.ast.add_stmt(StmtNode::VarDecl {
             name,
             span,
             ty_ann: ty,
             value: val,
-        })
+        }))
     }
 
-    fn parse_struct(&mut self) -> ParseResult<Stmt> {
+    fn parse_struct(&mut self) -> ParseResult<StmtId> {
         self.bump(); // struct
         let span = self.current_span();
         let name = self.expect_ident()?;
@@ -156,7 +260,7 @@ impl Parser {
             let fname = self.expect_ident()?;
             self.expect(TokenKind::Colon)?;
             let fty = self.parse_type()?;
-            fields.push(FieldDef {
+            fields.push(FieldNode {
                 name: fname,
                 span: fspan,
                 ty: fty,
@@ -167,10 +271,13 @@ impl Parser {
         }
         self.bump(); // }
         self.skip_semis();
-        Ok(Stmt::StructDef { name, span, fields })
+        let fields = self.ast.add_list(&fields);
+        Ok(self
+            .ast
+            .add_stmt(StmtNode::StructDef { name, span, fields }))
     }
 
-    fn parse_enum(&mut self) -> ParseResult<Stmt> {
+    fn parse_enum(&mut self) -> ParseResult<StmtId> {
         self.bump(); // enum
         let span = self.current_span();
         let name = self.expect_ident()?;
@@ -187,7 +294,7 @@ impl Parser {
                     let fname = self.expect_ident()?;
                     self.expect(TokenKind::Colon)?;
                     let fty = self.parse_type()?;
-                    fs.push(FieldDef {
+                    fs.push(FieldNode {
                         name: fname,
                         span: fspan,
                         ty: fty,
@@ -197,11 +304,11 @@ impl Parser {
                     }
                 }
                 self.bump(); // )
-                fs
+                self.ast.add_list(&fs)
             } else {
-                vec![]
+                List::EMPTY
             };
-            variants.push(VariantDef {
+            variants.push(VariantNode {
                 name: vname,
                 span: vspan,
                 fields,
@@ -212,10 +319,15 @@ impl Parser {
         }
         self.bump(); // }
         self.skip_semis();
-        Ok(Stmt::EnumDef { name, span, variants })
+        let variants = self.ast.add_list(&variants);
+        Ok(self.ast.add_stmt(StmtNode::EnumDef {
+            name,
+            span,
+            variants,
+        }))
     }
 
-    fn parse_interface(&mut self) -> ParseResult<Stmt> {
+    fn parse_interface(&mut self) -> ParseResult<StmtId> {
         self.bump(); // interface
         let span = self.current_span();
         let name = self.expect_ident()?;
@@ -238,7 +350,7 @@ impl Parser {
                 let pname = self.expect_ident()?;
                 self.expect(TokenKind::Colon)?;
                 let pty = self.parse_type()?;
-                params.push(Param {
+                params.push(ParamNode {
                     name: pname,
                     span: pspan,
                     ty_ann: Some(pty),
@@ -254,9 +366,9 @@ impl Parser {
             } else {
                 None
             };
-            methods.push(MethodSig {
+            methods.push(SigNode {
                 name: mname,
-                params,
+                params: self.ast.add_list(&params),
                 return_type,
                 operator: is_operator,
             });
@@ -264,10 +376,15 @@ impl Parser {
         }
         self.bump(); // }
         self.skip_semis();
-        Ok(Stmt::InterfaceDef { name, span, methods })
+        let methods = self.ast.add_list(&methods);
+        Ok(self.ast.add_stmt(StmtNode::InterfaceDef {
+            name,
+            span,
+            methods,
+        }))
     }
 
-    fn parse_impl(&mut self) -> ParseResult<Stmt> {
+    fn parse_impl(&mut self) -> ParseResult<StmtId> {
         let impl_span = self.current_span();
         self.bump(); // impl
         let first = self.expect_ident()?;
@@ -292,7 +409,7 @@ impl Parser {
             let mname = self.expect_ident()?;
             self.expect(TokenKind::Colon)?;
             let body = self.parse_expr()?;
-            methods.push(MethodDef {
+            methods.push(MethodNode {
                 name: mname,
                 span: mspan,
                 body,
@@ -304,15 +421,16 @@ impl Parser {
         }
         self.bump(); // }
         self.skip_semis();
-        Ok(Stmt::ImplBlock {
+        let methods = self.ast.add_list(&methods);
+        Ok(self.ast.add_stmt(StmtNode::ImplBlock {
             struct_name,
             span: impl_span,
             interface_name,
             methods,
-        })
+        }))
     }
 
-    fn parse_import(&mut self) -> ParseResult<Stmt> {
+    fn parse_import(&mut self) -> ParseResult<StmtId> {
         self.bump(); // import
         if self.current_kind() == TokenKind::LBrace {
             self.bump();
@@ -327,11 +445,12 @@ impl Parser {
             self.expect_kw(TokenKind::From)?;
             let path = self.expect_string()?;
             self.expect_semi()?;
-            Ok(Stmt::Import {
+            let names = self.ast.add_list(&names);
+            Ok(self.ast.add_stmt(StmtNode::Import {
                 path,
                 alias: None,
                 names,
-            })
+            }))
         } else {
             let path = self.expect_string()?;
             let alias = if self.current_kind() == TokenKind::As {
@@ -341,21 +460,21 @@ impl Parser {
                 None
             };
             self.expect_semi()?;
-            Ok(Stmt::Import {
+            Ok(self.ast.add_stmt(StmtNode::Import {
                 path,
                 alias,
-                names: vec![],
-            })
+                names: List::EMPTY,
+            }))
         }
     }
 
     // ── 表达式入口 (Pratt) ──
 
-    fn parse_expr(&mut self) -> ParseResult<Expr> {
+    fn parse_expr(&mut self) -> ParseResult<ExprId> {
         self.parse_pratt(0)
     }
 
-    fn parse_pratt(&mut self, min_bp: u8) -> ParseResult<Expr> {
+    fn parse_pratt(&mut self, min_bp: u8) -> ParseResult<ExprId> {
         let mut left = self.parse_atom()?;
         left = self.chain_postfix(left)?;
 
@@ -411,57 +530,56 @@ impl Parser {
             };
             let right = self.parse_pratt(right_bp)?;
 
-            if op.is_none() {
-                left = Expr::Assign {
-                    target: Box::new(left),
-                    value: Box::new(right),
-                };
-            } else if let Some(binop) = op {
-                left = Expr::Binary {
-                    left: Box::new(left),
+            left = match op {
+                None => self.node(ExprNode::Assign {
+                    target: left,
+                    value: right,
+                }),
+                Some(binop) => self.node(ExprNode::Binary {
+                    left,
                     op: binop,
-                    right: Box::new(right),
-                };
-            }
+                    right,
+                }),
+            };
         }
         Ok(left)
     }
 
     // ── 原子表达式 ──
 
-    fn parse_atom(&mut self) -> ParseResult<Expr> {
+    fn parse_atom(&mut self) -> ParseResult<ExprId> {
         match self.current_kind() {
             TokenKind::IntLiteral => self.parse_int(),
             TokenKind::FloatLiteral => self.parse_float(),
             TokenKind::StringLiteral => self.parse_string(),
             TokenKind::True => {
                 self.bump();
-                Ok(Expr::LitTrue)
+                Ok(self.node(ExprNode::LitTrue))
             }
             TokenKind::False => {
                 self.bump();
-                Ok(Expr::LitFalse)
+                Ok(self.node(ExprNode::LitFalse))
             }
             TokenKind::Null => {
                 self.bump();
-                Ok(Expr::LitNull)
+                Ok(self.node(ExprNode::LitNull))
             }
 
             TokenKind::Minus => {
                 self.bump();
                 let val = self.parse_pratt(10)?;
-                Ok(Expr::Unary {
+                Ok(self.node(ExprNode::Unary {
                     op: UnOp::Neg,
-                    right: Box::new(val),
-                })
+                    right: val,
+                }))
             }
             TokenKind::Not => {
                 self.bump();
                 let val = self.parse_pratt(10)?;
-                Ok(Expr::Unary {
+                Ok(self.node(ExprNode::Unary {
                     op: UnOp::Not,
-                    right: Box::new(val),
-                })
+                    right: val,
+                }))
             }
 
             TokenKind::Bar => self.parse_lambda(),
@@ -471,21 +589,24 @@ impl Parser {
                 // 空括号 () → 空元组 / unit
                 if self.current_kind() == TokenKind::RParen {
                     self.bump();
-                    return Ok(Expr::Tuple(vec![]));
+                    return Ok(self.node(ExprNode::Tuple(List::EMPTY)));
                 }
                 let first = self.parse_expr()?;
                 // 逗号 → 元组模式，继续收集直到 RParen
                 if self.current_kind() == TokenKind::Comma {
-                    let mut items = vec![first];
+                    let mark = self.exprs.len();
+                    self.exprs.push(first);
                     while self.current_kind() == TokenKind::Comma {
                         self.bump();
                         if self.current_kind() == TokenKind::RParen {
                             break; // 尾随逗号：单元素元组 (expr,)
                         }
-                        items.push(self.parse_expr()?);
+                        let item = self.parse_expr()?;
+                        self.exprs.push(item);
                     }
                     self.expect(TokenKind::RParen)?;
-                    return Ok(Expr::Tuple(items));
+                    let items = self.expr_list(mark);
+                    return Ok(self.node(ExprNode::Tuple(items)));
                 }
                 // 无逗号 → 分组，折叠
                 self.expect(TokenKind::RParen)?;
@@ -499,53 +620,57 @@ impl Parser {
             TokenKind::For => self.parse_for(),
             TokenKind::Break => {
                 self.bump();
-                Ok(Expr::Break)
+                Ok(self.node(ExprNode::Break))
             }
             TokenKind::Continue => {
                 self.bump();
-                Ok(Expr::Continue)
+                Ok(self.node(ExprNode::Continue))
             }
             TokenKind::Return => {
                 self.bump();
-                Ok(Expr::Return(Some(Box::new(self.parse_expr()?))))
+                let value = self.parse_expr()?;
+                Ok(self.node(ExprNode::Return(Some(value))))
             }
             TokenKind::Match => self.parse_match(),
             TokenKind::Async_ => {
                 self.bump();
-                Ok(Expr::Async(Box::new(self.parse_expr()?)))
+                let body = self.parse_expr()?;
+                Ok(self.node(ExprNode::Async(body)))
             }
             TokenKind::Await => {
                 self.bump();
-                Ok(Expr::Await(Box::new(self.parse_expr()?)))
+                let future = self.parse_expr()?;
+                Ok(self.node(ExprNode::Await(future)))
             }
 
             TokenKind::TemplateString => self.parse_template(),
             TokenKind::Identifier | TokenKind::Self_ => {
-                let name = self.current().lexeme.clone();
+                let tok = self.current();
+                let name = self.ident_symbol(tok);
                 let span = self.current_span();
-                if self.variant_names.contains(&name) {
-                    self.bump();
-                    let enum_name = self.variant_to_enum.get(&name).cloned().unwrap_or_default();
-                    let tag = self.variant_tag.get(&name).copied().unwrap_or(0);
+                self.bump();
+                if let Some(tag) = self.variant_tag_of(name) {
                     if self.current_kind() == TokenKind::LParen {
                         // Payload variant: Some(args) → parse as Call for CPS build to handle
                         self.bump(); // (
-                        let args = self.parse_call_args()?;
-                        return Ok(Expr::Call {
-                            func: Box::new(Expr::VarRef { name: name.clone(), span }),
-                            arg: Expr::call_arg(args),
-                        });
+                        let func = self.node(ExprNode::VarRef { name, span });
+                        let mark = self.parse_call_args()?;
+                        let arg = self.call_arg(mark);
+                        return Ok(self.node(ExprNode::Call { func, arg }));
                     }
                     // Unit variant: Red → VariantLit
-                    return Ok(Expr::VariantLit {
+                    let enum_name = match self.variant_to_enum.get(&name) {
+                        Some(&enum_name) => enum_name,
+                        None => self.ast.intern(""),
+                    };
+                    return Ok(self.node(ExprNode::VariantLit {
                         enum_name,
                         variant_name: name,
                         tag,
-                        fields: vec![],
-                    });
+                        fields: List::EMPTY,
+                    }));
                 }
-                self.bump();
-                Ok(Expr::VarRef { name, span })
+                Ok(self.node(ExprNode::VarRef { name, span }))
             }
 
             _ => Err(self.err(format!("unexpected token {:?}", self.current_kind()))),
@@ -554,63 +679,61 @@ impl Parser {
 
     // ── 后缀链 (call / dot / index / struct literal) ──
 
-    fn chain_postfix(&mut self, mut expr: Expr) -> ParseResult<Expr> {
+    fn chain_postfix(&mut self, mut expr: ExprId) -> ParseResult<ExprId> {
         loop {
             match self.current_kind() {
                 TokenKind::LParen => {
                     self.bump(); // consume (
-                    let args = self.parse_call_args()?;
-                    expr = Expr::Call {
-                        func: Box::new(expr),
-                        arg: Expr::call_arg(args),
-                    };
+                    let mark = self.parse_call_args()?;
+                    let arg = self.call_arg(mark);
+                    expr = self.node(ExprNode::Call { func: expr, arg });
                 }
                 TokenKind::Dot => {
                     self.bump();
                     let field = self.expect_ident()?;
-                    expr = Expr::Member {
-                        object: Box::new(expr),
+                    expr = self.node(ExprNode::Member {
+                        object: expr,
                         field,
-                    };
+                    });
                 }
                 TokenKind::LBracket => {
                     self.bump();
                     let index = self.parse_expr()?;
                     self.expect(TokenKind::RBracket)?;
-                    expr = Expr::Index {
-                        object: Box::new(expr),
-                        index: Box::new(index),
-                    };
+                    expr = self.node(ExprNode::Index {
+                        object: expr,
+                        index,
+                    });
                 }
                 TokenKind::QuestionDot => {
                     self.bump();
                     let field = self.expect_ident()?;
-                    expr = self.desugar_opt_chain(expr, |e| Expr::Member {
-                        object: Box::new(e),
-                        field: field.clone(),
+                    expr = self.desugar_opt_chain(expr, |ast, object| {
+                        ast.add_expr(ExprNode::Member { object, field })
                     });
                 }
                 TokenKind::QuestionLBracket => {
                     self.bump();
                     let index = self.parse_expr()?;
                     self.expect(TokenKind::RBracket)?;
-                    expr = self.desugar_opt_chain(expr, |e| Expr::Index {
-                        object: Box::new(e),
-                        index: Box::new(index.clone()),
+                    expr = self.desugar_opt_chain(expr, |ast, object| {
+                        ast.add_expr(ExprNode::Index { object, index })
                     });
                 }
                 TokenKind::LBrace => {
-                    if let Expr::VarRef { ref name, .. } = expr {
+                    if let ExprNode::VarRef {
+                        name: struct_name, ..
+                    } = self.ast[expr]
+                    {
                         // Name { ... } 始终解析为 StructLit，不查符号表
                         // struct 名有效性由 infer 阶段检查
-                        let struct_name = name.clone();
                         self.bump();
                         let mut fields = Vec::new();
-                        let mut spread: Option<Box<Expr>> = None;
+                        let mut spread = None;
                         while self.current_kind() != TokenKind::RBrace {
                             if self.current_kind() == TokenKind::DotDotDot {
                                 self.bump();
-                                spread = Some(Box::new(self.parse_expr()?));
+                                spread = Some(self.parse_expr()?);
                                 if self.current_kind() == TokenKind::Comma {
                                     self.bump();
                                 }
@@ -621,22 +744,29 @@ impl Parser {
                             let val = if self.current_kind() == TokenKind::Comma
                                 || self.current_kind() == TokenKind::RBrace
                             {
-                                Expr::VarRef { name: fname.clone(), span: fspan }
+                                self.node(ExprNode::VarRef {
+                                    name: fname,
+                                    span: fspan,
+                                })
                             } else {
                                 self.expect(TokenKind::Colon)?;
                                 self.parse_expr()?
                             };
-                            fields.push((fname, val));
+                            fields.push(FieldInit {
+                                name: fname,
+                                value: val,
+                            });
                             if self.current_kind() == TokenKind::Comma {
                                 self.bump();
                             }
                         }
                         self.bump();
-                        expr = Expr::StructLit {
+                        let fields = self.ast.add_list(&fields);
+                        expr = self.node(ExprNode::StructLit {
                             name: struct_name,
                             fields,
                             spread,
-                        };
+                        });
                     } else {
                         break;
                     }
@@ -647,52 +777,68 @@ impl Parser {
         Ok(expr)
     }
 
-    fn parse_call_args(&mut self) -> ParseResult<Vec<Expr>> {
+    /// 实参压入 `exprs` 栈，返回栈底位置。
+    fn parse_call_args(&mut self) -> ParseResult<usize> {
         // LParen already consumed
-        let mut args = Vec::new();
+        let mark = self.exprs.len();
         while self.current_kind() != TokenKind::RParen {
-            args.push(self.parse_expr()?);
+            let arg = self.parse_expr()?;
+            self.exprs.push(arg);
             if self.current_kind() == TokenKind::Comma {
                 self.bump();
             }
         }
         self.bump(); // RParen
-        Ok(args)
+        Ok(mark)
+    }
+
+    /// 栈顶实参转为 Call 的单 arg：0 → Tuple([]), 1 → 直接取, 2+ → Tuple
+    fn call_arg(&mut self, mark: usize) -> ExprId {
+        if self.exprs.len() == mark + 1 {
+            return self.exprs.pop().unwrap();
+        }
+        let items = self.expr_list(mark);
+        self.node(ExprNode::Tuple(items))
     }
 
     // ── 表达式子解析 ──
 
-    fn parse_int(&mut self) -> ParseResult<Expr> {
-        let t = self.current().clone();
-        let s = self.consume_lexeme();
-        s.parse::<i64>()
-            .map(Expr::LitInt)
-            .map_err(|_| ParseError::new(format!("invalid int: {s}"), t.line, t.col))
+    fn parse_int(&mut self) -> ParseResult<ExprId> {
+        let t = self.current_span();
+        let s = self.consume_text();
+        match s.parse::<i64>() {
+            Ok(n) => Ok(self.node(ExprNode::LitInt(n))),
+            Err(_) => Err(ParseError::new(format!("invalid int: {s}"), t.line, t.col)),
+        }
     }
 
-    fn parse_float(&mut self) -> ParseResult<Expr> {
-        let t = self.current().clone();
-        let s = self.consume_lexeme();
-        s.parse::<f64>()
-            .map(Expr::LitFloat)
-            .map_err(|_| ParseError::new(format!("invalid float: {s}"), t.line, t.col))
+    fn parse_float(&mut self) -> ParseResult<ExprId> {
+        let t = self.current_span();
+        let s = self.consume_text();
+        match s.parse::<f64>() {
+            Ok(f) => Ok(self.node(ExprNode::LitFloat(f))),
+            Err(_) => Err(ParseError::new(
+                format!("invalid float: {s}"),
+                t.line,
+                t.col,
+            )),
+        }
     }
 
-    fn parse_string(&mut self) -> ParseResult<Expr> {
-        let raw = self.consume_lexeme();
-        // Strip surrounding quotes (lexeme now includes "..." or '...')
-        let inner = &raw[1..raw.len() - 1];
-        Ok(Expr::LitString(inner.to_string()))
+    fn parse_string(&mut self) -> ParseResult<ExprId> {
+        let tok = self.bump();
+        let sym = self.ast.intern(&lexer::string_value(self.source, &tok));
+        Ok(self.node(ExprNode::LitString(sym)))
     }
 
-    fn parse_lambda(&mut self) -> ParseResult<Expr> {
+    fn parse_lambda(&mut self) -> ParseResult<ExprId> {
         self.bump(); // first |
         let mut params = Vec::new();
         while self.current_kind() != TokenKind::Bar {
             let pspan = self.current_span();
             let pname = self.expect_ident()?;
             let ty = self.opt_type()?;
-            params.push(Param {
+            params.push(ParamNode {
                 name: pname,
                 span: pspan,
                 ty_ann: ty,
@@ -709,48 +855,59 @@ impl Parser {
             None
         };
         let body = self.parse_expr()?;
-        Ok(Expr::Lambda {
+        let params = self.ast.add_list(&params);
+        Ok(self.node(ExprNode::Lambda {
             params,
             ret_ty,
-            body: Box::new(body),
-        })
+            body,
+        }))
     }
 
-    fn parse_block(&mut self) -> ParseResult<Expr> {
+    fn parse_block(&mut self) -> ParseResult<ExprId> {
         self.bump(); // {
-        let mut stmts = Vec::new();
+        let mark = self.stmts.len();
         while self.current_kind() != TokenKind::RBrace {
             match self.current_kind() {
-                TokenKind::Const => stmts.push(self.parse_const()?),
-                TokenKind::Var => stmts.push(self.parse_var()?),
+                TokenKind::Const => {
+                    let stmt = self.parse_const()?;
+                    self.stmts.push(stmt);
+                }
+                TokenKind::Var => {
+                    let stmt = self.parse_var()?;
+                    self.stmts.push(stmt);
+                }
                 TokenKind::Comment => {
                     self.bump();
                 }
                 _ => {
                     let expr = self.parse_expr()?;
                     self.skip_semis();
-                    stmts.push(Stmt::ExprStmt(expr));
+                    let stmt = self.ast.add_stmt(StmtNode::ExprStmt(expr));
+                    self.stmts.push(stmt);
                 }
             }
         }
         self.bump(); // }
-        Ok(Expr::Block(stmts))
+        let stmts = self.stmt_list(mark);
+        Ok(self.node(ExprNode::Block(stmts)))
     }
 
-    fn parse_list(&mut self) -> ParseResult<Expr> {
+    fn parse_list(&mut self) -> ParseResult<ExprId> {
         self.bump(); // [
-        let mut items = Vec::new();
+        let mark = self.exprs.len();
         while self.current_kind() != TokenKind::RBracket {
-            items.push(self.parse_expr()?);
+            let item = self.parse_expr()?;
+            self.exprs.push(item);
             if self.current_kind() == TokenKind::Comma {
                 self.bump();
             }
         }
         self.bump(); // ]
-        Ok(Expr::ListLit(items))
+        let items = self.expr_list(mark);
+        Ok(self.node(ExprNode::ListLit(items)))
     }
 
-    fn parse_if(&mut self) -> ParseResult<Expr> {
+    fn parse_if(&mut self) -> ParseResult<ExprId> {
         self.bump(); // if
         self.expect(TokenKind::LParen)?;
         let cond = self.parse_expr()?;
@@ -758,44 +915,42 @@ impl Parser {
         let then_b = self.parse_expr()?;
         let else_b = if self.current_kind() == TokenKind::Else {
             self.bump();
-            Some(Box::new(self.parse_expr()?))
+            Some(self.parse_expr()?)
         } else {
             None
         };
-        Ok(Expr::If {
-            cond: Box::new(cond),
-            then_branch: Box::new(then_b),
+        Ok(self.node(ExprNode::If {
+            cond,
+            then_branch: then_b,
             else_branch: else_b,
-        })
+        }))
     }
 
-    fn parse_while(&mut self) -> ParseResult<Expr> {
+    fn parse_while(&mut self) -> ParseResult<ExprId> {
         self.bump(); // while
         self.expect(TokenKind::LParen)?;
         let cond = self.parse_expr()?;
         self.expect(TokenKind::RParen)?;
         let body = self.parse_expr()?;
-        Ok(Expr::While {
-            cond: Box::new(cond),
-            body: Box::new(body),
-        })
+        Ok(self.node(ExprNode::While { cond, body }))
     }
 
-    fn parse_match(&mut self) -> ParseResult<Expr> {
+    fn parse_match(&mut self) -> ParseResult<ExprId> {
         self.bump(); // match
         self.expect(TokenKind::LParen)?;
         let scrutinee = self.parse_expr()?;
         self.expect(TokenKind::RParen)?;
         self.expect(TokenKind::LBrace)?;
-        let mut arms: Vec<(Option<Expr>, Expr)> = Vec::new(); // (pattern|None=wildcard, body)
+        let mut arms: Vec<(Option<ExprId>, ExprId)> = Vec::new(); // (pattern|None=wildcard, body)
         while self.current_kind() != TokenKind::RBrace {
-            let pattern =
-                if self.current_kind() == TokenKind::Identifier && self.current().lexeme == "_" {
-                    self.bump();
-                    None // wildcard
-                } else {
-                    Some(self.parse_expr()?)
-                };
+            let pattern = if self.current_kind() == TokenKind::Identifier
+                && self.text(self.current()) == "_"
+            {
+                self.bump();
+                None // wildcard
+            } else {
+                Some(self.parse_expr()?)
+            };
             self.expect(TokenKind::FatArrow)?;
             let body = self.parse_expr()?;
             arms.push((pattern, body));
@@ -809,150 +964,17 @@ impl Parser {
 
     fn desugar_match(
         &mut self,
-        scrutinee: Expr,
-        arms: Vec<(Option<Expr>, Expr)>,
-    ) -> ParseResult<Expr> {
+        scrutinee: ExprId,
+        arms: Vec<(Option<ExprId>, ExprId)>,
+    ) -> ParseResult<ExprId> {
         // { var __mN = scrutinee; if __mN == pat1 { ... } else ... }
-        let tmp = format!("__m{}", self.opt_chain_counter);
-        self.opt_chain_counter += 1;
+        let tmp = self.synth_name("__m");
         let synth = Span::new(0, 0); // synthetic span for compiler-generated code
 
-        let mut result: Option<Expr> = None;
+        let mut result: Option<ExprId> = None;
         for (pattern, body) in arms.into_iter().rev() {
             result = Some(match pattern {
-                Some(pat) => {
-                    // Check for unit variant pattern: VariantLit
-                    if let Expr::VariantLit { tag, .. } = &pat {
-                        Expr::If {
-                            cond: Box::new(Expr::Binary {
-                                left: Box::new(Expr::GetVariantTag(Box::new(Expr::VarRef {
-                                    name: tmp.clone(),
-                                    span: synth,
-                                }))),
-                                op: BinOp::Eq,
-                                right: Box::new(Expr::LitInt(*tag as i64)),
-                            }),
-                            then_branch: Box::new(body),
-                            else_branch: result.map(Box::new),
-                        }
-                    } else if let Expr::VarRef { ref name, .. } = &pat {
-                        if self.variant_names.contains(name) {
-                            let tag = self.variant_tag.get(name).copied().unwrap_or(0);
-                            Expr::If {
-                                cond: Box::new(Expr::Binary {
-                                    left: Box::new(Expr::GetVariantTag(Box::new(Expr::VarRef {
-                                        name: tmp.clone(),
-                                        span: synth,
-                                    }))),
-                                    op: BinOp::Eq,
-                                    right: Box::new(Expr::LitInt(tag as i64)),
-                                }),
-                                then_branch: Box::new(body),
-                                else_branch: result.map(Box::new),
-                            }
-                        } else {
-                            // Regular value comparison
-                            Expr::If {
-                                cond: Box::new(Expr::Binary {
-                                    left: Box::new(Expr::VarRef {
-                                        name: tmp.clone(),
-                                        span: synth,
-                                    }),
-                                    op: BinOp::Eq,
-                                    right: Box::new(pat),
-                                }),
-                                then_branch: Box::new(body),
-                                else_branch: result.map(Box::new),
-                            }
-                        }
-                    } else if let Expr::Call {
-                        func,
-                        arg: bindings,
-                    } = &pat
-                    {
-                        // Check for payload variant pattern: Some(v1, v2) -> ...
-                        if let Expr::VarRef { ref name, .. } = func.as_ref() {
-                            if self.variant_names.contains(name) {
-                                let tag = self.variant_tag.get(name).copied().unwrap_or(0);
-                                // Build block: bind variables + body
-                                let mut stmts: Vec<Stmt> = Vec::new();
-                                let binding_list = bindings.as_args();
-                                for (i, binding) in binding_list.iter().enumerate() {
-                                    if let Expr::VarRef { name: bname, .. } = binding {
-                                        stmts.push(Stmt::VarDecl {
-                                            name: bname.clone(),
-                                            span: synth,
-                                            ty_ann: None,
-                                            value: Some(Expr::GetVariantField {
-                                                object: Box::new(Expr::VarRef {
-                                                    name: tmp.clone(),
-                                                    span: synth,
-                                                }),
-                                                field_idx: i as u16,
-                                            }),
-                                        });
-                                    }
-                                }
-                                stmts.push(Stmt::ExprStmt(body));
-                                Expr::If {
-                                    cond: Box::new(Expr::Binary {
-                                        left: Box::new(Expr::GetVariantTag(Box::new(
-                                            Expr::VarRef {
-                                                name: tmp.clone(),
-                                                span: synth,
-                                            },
-                                        ))),
-                                        op: BinOp::Eq,
-                                        right: Box::new(Expr::LitInt(tag as i64)),
-                                    }),
-                                    then_branch: Box::new(Expr::Block(stmts)),
-                                    else_branch: result.map(Box::new),
-                                }
-                            } else {
-                                // Regular function call pattern (fallback)
-                                Expr::If {
-                                    cond: Box::new(Expr::Binary {
-                                        left: Box::new(Expr::VarRef {
-                                            name: tmp.clone(),
-                                            span: synth,
-                                        }),
-                                        op: BinOp::Eq,
-                                        right: Box::new(pat),
-                                    }),
-                                    then_branch: Box::new(body),
-                                    else_branch: result.map(Box::new),
-                                }
-                            }
-                        } else {
-                            Expr::If {
-                                cond: Box::new(Expr::Binary {
-                                    left: Box::new(Expr::VarRef {
-                                        name: tmp.clone(),
-                                        span: synth,
-                                    }),
-                                    op: BinOp::Eq,
-                                    right: Box::new(pat),
-                                }),
-                                then_branch: Box::new(body),
-                                else_branch: result.map(Box::new),
-                            }
-                        }
-                    } else {
-                        // Default: literal value comparison
-                        Expr::If {
-                            cond: Box::new(Expr::Binary {
-                                left: Box::new(Expr::VarRef {
-                                    name: tmp.clone(),
-                                    span: synth,
-                                }),
-                                op: BinOp::Eq,
-                                right: Box::new(pat),
-                            }),
-                            then_branch: Box::new(body),
-                            else_branch: result.map(Box::new),
-                        }
-                    }
-                }
+                Some(pat) => self.desugar_arm(tmp, pat, body, result),
                 None => {
                     // wildcard: the else branch
                     body
@@ -960,18 +982,125 @@ impl Parser {
             });
         }
 
-        Ok(Expr::Block(vec![
-            Stmt::VarDecl {
-                name: tmp.clone(),
-                span: synth,
-                ty_ann: None,
-                value: Some(scrutinee),
+        let decl = self.ast.add_stmt(StmtNode::VarDecl {
+            name: tmp,
+            span: synth,
+            ty_ann: None,
+            value: Some(scrutinee),
+        });
+        let result = match result {
+            Some(result) => result,
+            None => self.node(ExprNode::LitNull),
+        };
+        let tail = self.ast.add_stmt(StmtNode::ExprStmt(result));
+        let stmts = self.ast.add_list(&[decl, tail]);
+        Ok(self.node(ExprNode::Block(stmts)))
+    }
+
+    /// 一个带模式的 match 分支：`if <pat 测试> { body } else { rest }`。
+    fn desugar_arm(
+        &mut self,
+        tmp: Symbol,
+        pat: ExprId,
+        body: ExprId,
+        rest: Option<ExprId>,
+    ) -> ExprId {
+        let synth = Span::new(0, 0);
+        let (cond, then_branch) = match self.ast[pat] {
+            // Unit variant pattern: VariantLit
+            ExprNode::VariantLit { tag, .. } => (self.tag_test(tmp, tag), body),
+            ExprNode::VarRef { name, .. } => match self.variant_tag_of(name) {
+                Some(tag) => (self.tag_test(tmp, tag), body),
+                // Regular value comparison
+                None => (self.eq_test(tmp, pat), body),
             },
-            Stmt::ExprStmt(result.unwrap_or(Expr::LitNull)),
-        ]))
+            // Payload variant pattern: Some(v1, v2) -> ...
+            ExprNode::Call {
+                func,
+                arg: bindings,
+            } => {
+                let tag = match self.ast[func] {
+                    ExprNode::VarRef { name, .. } => self.variant_tag_of(name),
+                    _ => None,
+                };
+                match tag {
+                    Some(tag) => {
+                        // Build block: bind variables + body
+                        let binding_list = match self.ast[bindings] {
+                            ExprNode::Tuple(items) => self.ast[items].to_vec(),
+                            _ => vec![bindings],
+                        };
+                        let mut stmts = Vec::new();
+                        for (i, binding) in binding_list.into_iter().enumerate() {
+                            if let ExprNode::VarRef { name: bname, .. } = self.ast[binding] {
+                                let object = self.tmp_ref(tmp);
+                                let field = self.node(ExprNode::GetVariantField {
+                                    object,
+                                    field_idx: i as u16,
+                                });
+                                stmts.push(self.ast.add_stmt(StmtNode::VarDecl {
+                                    name: bname,
+                                    span: synth,
+                                    ty_ann: None,
+                                    value: Some(field),
+                                }));
+                            }
+                        }
+                        stmts.push(self.ast.add_stmt(StmtNode::ExprStmt(body)));
+                        let stmts = self.ast.add_list(&stmts);
+                        (self.tag_test(tmp, tag), self.node(ExprNode::Block(stmts)))
+                    }
+                    // Regular function call pattern (fallback)
+                    None => (self.eq_test(tmp, pat), body),
+                }
+            }
+            // Default: literal value comparison
+            _ => (self.eq_test(tmp, pat), body),
+        };
+        self.node(ExprNode::If {
+            cond,
+            then_branch,
+            else_branch: rest,
+        })
     }
 
-    fn parse_for(&mut self) -> ParseResult<Expr> {
+    /// `GetVariantTag(tmp) == tag`
+    fn tag_test(&mut self, tmp: Symbol, tag: u16) -> ExprId {
+        let object = self.tmp_ref(tmp);
+        let left = self.node(ExprNode::GetVariantTag(object));
+        let right = self.node(ExprNode::LitInt(tag as i64));
+        self.node(ExprNode::Binary {
+            left,
+            op: BinOp::Eq,
+            right,
+        })
+    }
+
+    /// `tmp == pat`
+    fn eq_test(&mut self, tmp: Symbol, pat: ExprId) -> ExprId {
+        let left = self.tmp_ref(tmp);
+        self.node(ExprNode::Binary {
+            left,
+            op: BinOp::Eq,
+            right: pat,
+        })
+    }
+
+    fn tmp_ref(&mut self, tmp: Symbol) -> ExprId {
+        self.node(ExprNode::VarRef {
+            name: tmp,
+            span: Span::new(0, 0),
+        })
+    }
+
+    /// 编译器生成的临时变量名 `{prefix}{N}`。
+    fn synth_name(&mut self, prefix: &str) -> Symbol {
+        let name = format!("{prefix}{}", self.opt_chain_counter);
+        self.opt_chain_counter += 1;
+        self.ast.intern(&name)
+    }
+
+    fn parse_for(&mut self) -> ParseResult<ExprId> {
         self.bump(); // for
         self.expect(TokenKind::LParen)?;
         let var_span = self.current_span();
@@ -981,26 +1110,25 @@ impl Parser {
         let iterable = self.parse_expr()?;
         self.expect(TokenKind::RParen)?;
         let body = self.parse_expr()?;
-        Ok(Expr::For {
-            var: Param {
+        Ok(self.node(ExprNode::For {
+            var: ParamNode {
                 name: varname,
                 span: var_span,
                 ty_ann: None,
             },
-            iterable: Box::new(iterable),
-            body: Box::new(body),
-        })
+            iterable,
+            body,
+        }))
     }
 
-    fn parse_template(&mut self) -> ParseResult<Expr> {
-        let raw = self.consume_lexeme();
-        // Strip surrounding backticks (lexeme now includes `...`)
-        let template = &raw[1..raw.len() - 1];
+    fn parse_template(&mut self) -> ParseResult<ExprId> {
+        let tok = self.bump();
+        let template = lexer::string_value(self.source, &tok);
         // template: `hello {name}, age {age + 1}`
         // Build: "hello " + name.to_string() + ", age " + (age + 1).to_string()
         //
         // Braces: {{ → literal {, }} → literal }
-        let mut parts: Vec<Expr> = Vec::new();
+        let mut parts: Vec<ExprId> = Vec::new();
         let mut current = String::new();
         let chars: Vec<char> = template.chars().collect();
         let mut i = 0;
@@ -1020,7 +1148,7 @@ impl Parser {
             }
             if chars[i] == '{' {
                 if !current.is_empty() {
-                    parts.push(Expr::LitString(std::mem::take(&mut current)));
+                    parts.push(self.string_node(&std::mem::take(&mut current)));
                 }
                 // Find matching }, skipping nested {{ and handles }}
                 let mut depth = 1;
@@ -1050,19 +1178,18 @@ impl Parser {
                     expr_str.push(chars[i]);
                     i += 1;
                 }
-                // Parse the expression and wrap in .to_string()
-                let mut sub = Parser::new(&expr_str);
-                let expr = sub.parse_expr()?;
-                parts.push(Expr::Call {
-                    func: Box::new(Expr::Member {
-                        object: Box::new(expr),
-                        field: "to_string".to_string(),
-                    }),
-                    arg: Expr::call_arg(vec![]),
-                });
+                // Parse the expression into the same arena and wrap in .to_string()
+                let mut sub = Parser::with_ast(&expr_str, std::mem::take(&mut self.ast));
+                let expr = sub.parse_expr();
+                self.ast = sub.ast;
+                let object = expr?;
+                let field = self.ast.intern("to_string");
+                let func = self.node(ExprNode::Member { object, field });
+                let arg = self.node(ExprNode::Tuple(List::EMPTY));
+                parts.push(self.node(ExprNode::Call { func, arg }));
                 // }} → append literal "}"
                 if trailing_brace {
-                    parts.push(Expr::LitString("}".to_string()));
+                    parts.push(self.string_node("}"));
                 }
             } else {
                 current.push(chars[i]);
@@ -1071,30 +1198,30 @@ impl Parser {
         }
 
         if !current.is_empty() || parts.is_empty() {
-            parts.push(Expr::LitString(std::mem::take(&mut current)));
+            parts.push(self.string_node(&current));
         }
 
         // Fold with SAdd
-        let mut result = parts.remove(0);
-        for part in parts {
-            result = Expr::Binary {
-                left: Box::new(result),
+        let mut result = parts[0];
+        for &part in &parts[1..] {
+            result = self.node(ExprNode::Binary {
+                left: result,
                 op: BinOp::SAdd,
-                right: Box::new(part),
-            };
+                right: part,
+            });
         }
         Ok(result)
     }
 
     // ── 类型 ──
 
-    fn parse_type(&mut self) -> ParseResult<TypeExpr> {
+    fn parse_type(&mut self) -> ParseResult<TypeId> {
         // 元组类型: (T1, T2, ...) 或 ()
         if self.current_kind() == TokenKind::LParen {
             self.bump();
             if self.current_kind() == TokenKind::RParen {
                 self.bump();
-                return Ok(TypeExpr::Tuple(vec![]));
+                return Ok(self.ast.add_type(TypeNode::Tuple(List::EMPTY)));
             }
             let first = self.parse_type()?;
             if self.current_kind() == TokenKind::Comma {
@@ -1107,23 +1234,24 @@ impl Parser {
                     items.push(self.parse_type()?);
                 }
                 self.expect(TokenKind::RParen)?;
-                return Ok(TypeExpr::Tuple(items));
+                let items = self.ast.add_list(&items);
+                return Ok(self.ast.add_type(TypeNode::Tuple(items)));
             }
             self.expect(TokenKind::RParen)?;
             return Ok(first); // (T) → 不是元组，折叠
         }
         let name = self.expect_ident()?;
-        if name == "List" {
+        if self.ast.name(name) == "List" {
             self.expect(TokenKind::Lt)?;
             let inner = self.parse_type()?;
             self.expect(TokenKind::Gt)?;
-            Ok(TypeExpr::List(Box::new(inner)))
+            Ok(self.ast.add_type(TypeNode::List(inner)))
         } else {
-            Ok(TypeExpr::Named(name))
+            Ok(self.ast.add_type(TypeNode::Named(name)))
         }
     }
 
-    fn opt_type(&mut self) -> ParseResult<Option<TypeExpr>> {
+    fn opt_type(&mut self) -> ParseResult<Option<TypeId>> {
         if self.current_kind() == TokenKind::Colon {
             self.bump();
             Ok(Some(self.parse_type()?))
@@ -1132,55 +1260,84 @@ impl Parser {
         }
     }
 
-    fn desugar_opt_chain(&mut self, obj: Expr, accessor: impl FnOnce(Expr) -> Expr) -> Expr {
-        let tmp = format!("__o{}", self.opt_chain_counter);
-        self.opt_chain_counter += 1;
+    fn desugar_opt_chain(
+        &mut self,
+        obj: ExprId,
+        accessor: impl FnOnce(&mut Ast, ExprId) -> ExprId,
+    ) -> ExprId {
+        let tmp = self.synth_name("__o");
         let synth = Span::new(0, 0);
         // { var tmp = obj; if tmp != null { accessor(tmp) } else { null } }
-        Expr::Block(vec![
-            Stmt::VarDecl {
-                name: tmp.clone(),
-                span: synth,
-                ty_ann: None,
-                value: Some(obj),
-            },
-            Stmt::ExprStmt(Expr::If {
-                cond: Box::new(Expr::Binary {
-                    left: Box::new(Expr::VarRef {
-                        name: tmp.clone(),
-                        span: synth,
-                    }),
-                    op: BinOp::Ne,
-                    right: Box::new(Expr::LitNull),
-                }),
-                then_branch: Box::new(accessor(Expr::VarRef {
-                    name: tmp,
-                    span: synth,
-                })),
-                else_branch: Some(Box::new(Expr::LitNull)),
-            }),
-        ])
-    }
-
-    fn desugar_null_coalesce(&mut self, left: Expr, right: Expr) -> Expr {
+        let decl = self.ast.add_stmt(StmtNode::VarDecl {
+            name: tmp,
+            span: synth,
+            ty_ann: None,
+            value: Some(obj),
+        });
+        let left = self.tmp_ref(tmp);
+        let right = self.node(ExprNode::LitNull);
+        let cond = self.node(ExprNode::Binary {
+            left,
+            op: BinOp::Ne,
+            right,
+        });
+        let object = self.tmp_ref(tmp);
+        let then_branch = accessor(&mut self.ast, object);
+        let else_branch = self.node(ExprNode::LitNull);
+        let test = self.node(ExprNode::If {
+            cond,
+            then_branch,
+            else_branch: Some(else_branch),
+        });
+        let tail = self.ast.add_stmt(StmtNode::ExprStmt(test));
+        let stmts = self.ast.add_list(&[decl, tail]);
+        self.node(ExprNode::Block(stmts))
+    }
+
+    fn desugar_null_coalesce(&mut self, left: ExprId, right: ExprId) -> ExprId {
         // if left != null { left } else { right }
         // Note: left is evaluated twice; acceptable for variable refs and field accesses.
         // A proper single-evaluation version needs type-level support for nullable union types.
-        Expr::If {
-            cond: Box::new(Expr::Binary {
-                left: Box::new(left.clone()),
-                op: BinOp::Ne,
-                right: Box::new(Expr::LitNull),
-            }),
-            then_branch: Box::new(left),
-            else_branch: Some(Box::new(right)),
-        }
+        // 两处共用同一个 arena 节点，降级成树时各自展开。
+        let null = self.node(ExprNode::LitNull);
+        let cond = self.node(ExprNode::Binary {
+            left,
+            op: BinOp::Ne,
+            right: null,
+        });
+        self.node(ExprNode::If {
+            cond,
+            then_branch: left,
+            else_branch: Some(right),
+        })
     }
 
     // ── 辅助 ──
 
-    fn current(&self) -> &Token {
-        &self.tokens[self.pos]
+    fn node(&mut self, node: ExprNode) -> ExprId {
+        self.ast.add_expr(node)
+    }
+
+    fn string_node(&mut self, text: &str) -> ExprId {
+        let sym = self.ast.intern(text);
+        self.node(ExprNode::LitString(sym))
+    }
+
+    /// 把 `exprs` 栈上 `mark` 以上的部分拷进 arena 并出栈。
+    fn expr_list(&mut self, mark: usize) -> List<ExprId> {
+        let list = self.ast.add_list(&self.exprs[mark..]);
+        self.exprs.truncate(mark);
+        list
+    }
+
+    fn stmt_list(&mut self, mark: usize) -> List<StmtId> {
+        let list = self.ast.add_list(&self.stmts[mark..]);
+        self.stmts.truncate(mark);
+        list
+    }
+
+    fn current(&self) -> RawToken {
+        self.tokens[self.pos]
     }
     fn current_kind(&self) -> TokenKind {
         self.current().kind
@@ -1190,40 +1347,67 @@ impl Parser {
         self.current_kind() == TokenKind::Eof
     }
 
-    fn bump(&mut self) -> &Token {
-        let t = &self.tokens[self.pos];
+    fn bump(&mut self) -> RawToken {
+        let t = self.tokens[self.pos];
         self.pos += 1;
         t
     }
 
+    fn text(&self, tok: RawToken) -> &'a str {
+        tok.text(self.source)
+    }
+
     fn err(&self, msg: impl Into<String>) -> ParseError {
-        ParseError::new(msg.into(), self.current().line, self.current().col)
+        let span = self.current_span();
+        ParseError::new(msg.into(), span.line, span.col)
     }
 
-    fn consume_lexeme(&mut self) -> String {
-        self.bump().lexeme.clone()
+    fn consume_text(&mut self) -> &'a str {
+        let tok = self.bump();
+        self.text(tok)
     }
 
     fn current_span(&self) -> Span {
-        let t = self.current();
-        Span::new(t.line, t.col)
+        let (line, col) = self
+            .lines
+            .line_col(self.source, self.current().start as usize);
+        Span::new(line, col)
     }
 
-    fn expect_ident(&mut self) -> ParseResult<String> {
+    /// 标识符 token 的符号；`self` 之类的关键字词法阶段不驻留，这里补上。
+    fn ident_symbol(&mut self, tok: RawToken) -> Symbol {
+        if tok.sym == Symbol::NONE {
+            let text = self.text(tok);
+            self.ast.intern(text)
+        } else {
+            tok.sym
+        }
+    }
+
+    /// 变体名的 tag；名字不是已知变体时为 `None`。
+    fn variant_tag_of(&self, name: Symbol) -> Option<u16> {
+        if !self.variant_names.contains(&name) {
+            return None;
+        }
+        Some(self.variant_tag.get(&name).copied().unwrap_or(0))
+    }
+
+    fn expect_ident(&mut self) -> ParseResult<Symbol> {
         if matches!(
             self.current_kind(),
             TokenKind::Identifier | TokenKind::Self_
         ) {
-            Ok(self.consume_lexeme())
+            let tok = self.bump();
+            Ok(self.ident_symbol(tok))
         } else {
             Err(self.err(format!("expected ident, got {:?}", self.current_kind())))
         }
     }
 
-    fn expect_string(&mut self) -> ParseResult<String> {
+    fn expect_string(&mut self) -> ParseResult<Symbol> {
         if self.current_kind() == TokenKind::StringLiteral {
-            let raw = self.consume_lexeme();
-            Ok(raw[1..raw.len() - 1].to_string())
+            let tok = self.bump();
+            Ok(self.ast.intern(&lexer::string_value(self.source, &tok)))
         } else {
             Err(self.err("expected string"))
         }
@@ -1261,17 +1445,17 @@ impl Parser {
     }
 }
 
+/// 变体名 → 所属枚举名 / tag，按 token 预扫描。
 fn collect_enum_metadata(
-    tokens: &[Token],
+    tokens: &[RawToken],
 ) -> (
-    BTreeSet<String>,
-    std::collections::HashMap<String, String>,
-    std::collections::HashMap<String, u16>,
+    BTreeSet<Symbol>,
+    HashMap<Symbol, Symbol>,
+    HashMap<Symbol, u16>,
 ) {
     let mut variant_names = BTreeSet::new();
-    let mut variant_to_enum: std::collections::HashMap<String, String> =
-        std::collections::HashMap::new();
-    let mut variant_tag: std::collections::HashMap<String, u16> = std::collections::HashMap::new();
+    let mut variant_to_enum: HashMap<Symbol, Symbol> = HashMap::new();
+    let mut variant_tag: HashMap<Symbol, u16> = HashMap::new();
 
     let mut i = 0;
     while i < tokens.len() {
@@ -1280,7 +1464,7 @@ fn collect_enum_metadata(
             && i + 1 < tokens.len()
             && tokens[i + 1].kind == TokenKind::Identifier
         {
-            let enum_name = tokens[i + 1].lexeme.clone();
+            let enum_name = tokens[i + 1].sym;
 
             // Skip past Enum, Identifier
             i += 2;
@@ -1307,10 +1491,10 @@ fn collect_enum_metadata(
                         }
                     }
                     TokenKind::Identifier if depth == 1 => {
-                        let vname = tokens[i].lexeme.clone();
-                        variant_names.insert(vname.clone());
-                        variant_to_enum.insert(vname.clone(), enum_name.clone());
-                        variant_tag.insert(vname.clone(), tag);
+                        let vname = tokens[i].sym;
+                        variant_names.insert(vname);
+                        variant_to_enum.insert(vname, enum_name);
+                        variant_tag.insert(vname, tag);
                         tag += 1;
                         // Skip variant payload: Identifier ( Type , ... )
                         if i + 1 < tokens.len() && tokens[i + 1].kind == TokenKind::LParen {
@@ -1340,13 +1524,13 @@ fn collect_enum_metadata(
     (variant_names, variant_to_enum, variant_tag)
 }
 
-fn collect_struct_names(tokens: &[Token]) -> BTreeSet<String> {
+fn collect_struct_names(tokens: &[RawToken]) -> BTreeSet<Symbol> {
     tokens
         .windows(2)
         .filter(|&window| {
             window[0].kind == TokenKind::Struct && window[1].kind == TokenKind::Identifier
         })
-        .map(|window| window[1].lexeme.clone())
+        .map(|window| window[1].sym)
         .collect()
 }
 
@@ -1364,7 +1548,7 @@ mod tests {
         let mut p = Parser::new(src);
         let e = p.parse_expr().unwrap();
         assert!(p.is_eof(), "extra tokens");
-        e
+        p.ast.lower_expr(e)
     }
 
     #[test]
@@ -1492,6 +1676,38 @@ mod tests {
         assert!(matches!(e, Expr::Call { .. }));
     }
 
+    #[test]
+    fn parse_extents_cover_each_statement() {
+        let src = "// head\nconst a = 1;;\nstruct P { x: Int64 }\nprint(\"x\"); // tail\n";
+        let (m, extents) = Parser::new(src).parse_extents().unwrap();
+        assert_eq!(m.stmts.len(), 3);
+        let texts: Vec<&str> = extents.iter().map(|r| &src[r.clone()]).collect();
+        assert_eq!(
+            texts,
+            ["const a = 1;", "struct P { x: Int64 }", "print(\"x\");"]
+        );
+    }
+
+    #[test]
+    fn with_names_sees_structs_and_variants_defined_elsewhere() {
+        let mut names = ParseNames::default();
+        names.structs.insert("P".to_string());
+        names
+            .variants
+            .insert("Blue".to_string(), ("Color".to_string(), 2));
+        let m = Parser::with_names("const p = P { x: 1 }; const c = Blue;", &names)
+            .parse()
+            .unwrap();
+        let Stmt::ConstDecl { value, .. } = &m.stmts[0] else {
+            panic!()
+        };
+        assert!(matches!(value, Expr::StructLit { .. }));
+        let Stmt::ConstDecl { value, .. } = &m.stmts[1] else {
+            panic!()
+        };
+        assert!(matches!(value, Expr::VariantLit { tag: 2, .. }));
+    }
+
     #[test]
     fn test_block_is_expr() {
         let m = parse_mod("const result = { var x = 10; x + 1 };");
@@ -2683,4 +2899,58 @@ mod tests {
         let m = parse_mod("export var state = 0;");
         assert!(matches!(&m.stmts[0], Stmt::ExportStmt(_)));
     }
+
+    // ── Arena ──
+
+    #[test]
+    fn parse_ast_lowers_to_the_parsed_tree() {
+        let src = "enum Shape { Circle(r: Float64), Dot };\n\
+                   struct P { x: Int64 };\n\
+                   const f = |s: Shape| -> Int64 { match (s) { Circle(r) -> 1, Dot -> 2, _ -> 3 } };\n\
+                   const p = P { x: 1 };\n\
+                   const q = p?.x ?? 0;\n\
+                   print(`x = {p.x + 1}, {{ok}}`);";
+        let tree = parse_mod(src);
+        let ast = Parser::new(src).parse_ast().unwrap();
+        assert_eq!(ast.roots().len(), tree.stmts.len());
+        assert_eq!(ast.to_module(), tree);
+    }
+
+    #[test]
+    fn template_interpolation_shares_the_interner() {
+        let ast = Parser::new("const name = 1; print(`hi {name}`);")
+            .parse_ast()
+            .unwrap();
+        // `name` inside the template resolves through the outer interner
+        let name = ast.interner().get("name").unwrap();
+        let Stmt::ExprStmt(Expr::Call { arg, .. }) = &ast.to_module().stmts[1] else {
+            panic!("expected print call");
+        };
+        let Expr::Binary { right, .. } = arg.as_ref() else {
+            panic!("expected SAdd");
+        };
+        let Expr::Call { func, .. } = right.as_ref() else {
+            panic!("expected to_string call");
+        };
+        assert!(matches!(func.as_ref(), Expr::Member { object, .. }
+            if matches!(object.as_ref(), Expr::VarRef { name: n, .. } if n == ast.name(name))));
+    }
+
+    #[test]
+    fn null_coalesce_shares_its_left_operand() {
+        let ast = Parser::new("const x = a ?? b;").parse_ast().unwrap();
+        let StmtNode::ConstDecl { value, .. } = ast[ast.roots()[0]] else {
+            panic!("expected const");
+        };
+        let ExprNode::If {
+            cond, then_branch, ..
+        } = ast[value]
+        else {
+            panic!("expected if");
+        };
+        let ExprNode::Binary { left, .. } = ast[cond] else {
+            panic!("expected != null");
+        };
+        assert_eq!(left, then_branch);
+    }
 }
@@ -1,5 +1,10 @@
 //! Shared token contract types.
 
+use std::collections::HashMap;
+use std::hash::{BuildHasherDefault, Hasher};
+use std::ops::Range;
+use std::sync::Arc;
+
 /// Token 种类
 #[derive(Debug, Clone, Copy, PartialEq, Eq)]
 #[repr(u8)]
@@ -152,6 +157,157 @@ impl Token {
     }
 }
 
+/// 零拷贝 token：种类 + 源码字节区间，文本按需从源码切出。
+///
+/// 标识符另带驻留符号，其余 token 的 `sym` 为 `Symbol::NONE`。
+/// 源码按 `u32` 寻址，单个文件不超过 4 GiB。
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub struct RawToken {
+    pub kind: TokenKind,
+    pub sym: Symbol,
+    pub start: u32,
+    pub end: u32,
+}
+
+impl RawToken {
+    /// token 在源码里的原文（字符串字面量含引号和未解码的转义）。
+    pub fn text<'s>(&self, source: &'s str) -> &'s str {
+        &source[self.range()]
+    }
+
+    pub fn range(&self) -> Range<usize> {
+        self.start as usize..self.end as usize
+    }
+}
+
+/// 驻留后的标识符，只在产生它的 `Interner` 里有意义。
+#[derive(Debug, Clone, Copy, PartialEq, Eq, PartialOrd, Ord, Hash)]
+pub struct Symbol(u32);
+
+impl Symbol {
+    /// 非标识符 token 的占位符号。
+    pub const NONE: Symbol = Symbol(u32::MAX);
+
+    pub fn index(self) -> usize {
+        self.0 as usize
+    }
+}
+
+/// 标识符驻留表：同名标识符共用一个 `Symbol` 和一份字符串。
+///
+/// 词法分析时填充，随 token 一起交给 parser，名字比较和查表只比符号。
+#[derive(Debug, Clone, Default)]
+pub struct Interner {
+    map: HashMap<Arc<str>, Symbol, BuildHasherDefault<FxHasher>>,
+    names: Vec<Arc<str>>,
+}
+
+impl Interner {
+    pub fn new() -> Self {
+        Self::default()
+    }
+
+    pub fn intern(&mut self, name: &str) -> Symbol {
+        if let Some(&sym) = self.map.get(name) {
+            return sym;
+        }
+        let sym = Symbol(self.names.len() as u32);
+        let name: Arc<str> = name.into();
+        self.names.push(name.clone());
+        self.map.insert(name, sym);
+        sym
+    }
+
+    /// 已驻留的符号；不存在时不插入。
+    pub fn get(&self, name: &str) -> Option<Symbol> {
+        self.map.get(name).copied()
+    }
+
+    pub fn resolve(&self, sym: Symbol) -> &str {
+        &self.names[sym.index()]
+    }
+
+    pub fn len(&self) -> usize {
+        self.names.len()
+    }
+
+    pub fn is_empty(&self) -> bool {
+        self.names.is_empty()
+    }
+}
+
+/// rustc 的 FxHash：标识符很短，SipHash 的抗碰撞在这里只是开销。
+#[derive(Default)]
+struct FxHasher {
+    hash: u64,
+}
+
+impl FxHasher {
+    const SEED: u64 = 0x51_7c_c1_b7_27_22_0a_95;
+
+    fn add(&mut self, word: u64) {
+        self.hash = (self.hash.rotate_left(5) ^ word).wrapping_mul(Self::SEED);
+    }
+}
+
+impl Hasher for FxHasher {
+    fn write(&mut self, bytes: &[u8]) {
+        let mut chunks = bytes.chunks_exact(8);
+        for chunk in &mut chunks {
+            self.add(u64::from_le_bytes(chunk.try_into().unwrap()));
+        }
+        let mut tail = [0u8; 8];
+        let rest = chunks.remainder();
+        tail[..rest.len()].copy_from_slice(rest);
+        self.add(u64::from_le_bytes(tail) ^ rest.len() as u64);
+    }
+
+    fn write_u8(&mut self, n: u8) {
+        self.add(n as u64);
+    }
+
+    fn finish(&self) -> u64 {
+        self.hash
+    }
+}
+
+/// 行首字节偏移表，把字节偏移按需换算成行列号。
+///
+/// 行列号从 1 起；列按字符计（`\r` 也占一列），与 `Token::line` / `Token::col` 一致。
+#[derive(Debug, Clone)]
+pub struct LineIndex {
+    starts: Vec<u32>,
+}
+
+impl LineIndex {
+    pub fn new(source: &str) -> Self {
+        let mut starts = vec![0];
+        starts.extend(
+            source
+                .bytes()
+                .enumerate()
+                .filter(|&(_, b)| b == b'\n')
+                .map(|(i, _)| i as u32 + 1),
+        );
+        Self { starts }
+    }
+
+    pub fn line_count(&self) -> usize {
+        self.starts.len()
+    }
+
+    /// `offset` 处的 (行, 列)；`offset` 须落在 `source` 的字符边界上。
+    pub fn line_col(&self, source: &str, offset: usize) -> (usize, usize) {
+        let line = self.starts.partition_point(|&s| s as usize <= offset);
+        let start = self.starts[line - 1] as usize;
+        let col = source.as_bytes()[start..offset]
+            .iter()
+            .filter(|&&b| b & 0xc0 != 0x80)
+            .count();
+        (line, col + 1)
+    }
+}
+
 #[cfg(test)]
 mod tests {
     use super::*;
@@ -341,4 +497,41 @@ mod tests {
         ];
         assert_eq!(kinds.len(), 66);
     }
+
+    // ── 零拷贝 token 支撑类型 ──
+
+    #[test]
+    fn interner_shares_symbols_per_name() {
+        let mut interner = Interner::new();
+        let a = interner.intern("point");
+        let b = interner.intern("Point");
+        assert_ne!(a, b);
+        assert_eq!(interner.intern("point"), a);
+        assert_eq!(interner.resolve(b), "Point");
+        assert_eq!(interner.get("missing"), None);
+        assert_eq!(interner.len(), 2);
+    }
+
+    #[test]
+    fn raw_token_slices_source() {
+        let tok = RawToken {
+            kind: TokenKind::Identifier,
+            sym: Symbol::NONE,
+            start: 6,
+            end: 11,
+        };
+        assert_eq!(tok.text("const value = 1;"), "value");
+    }
+
+    #[test]
+    fn line_index_counts_columns_in_chars() {
+        let src = "a\n  é = 1;\r\nxy";
+        let index = LineIndex::new(src);
+        assert_eq!(index.line_count(), 3);
+        assert_eq!(index.line_col(src, 0), (1, 1));
+        assert_eq!(index.line_col(src, 4), (2, 3));
+        // `é` 占两个字节、一列
+        assert_eq!(index.line_col(src, 7), (2, 5));
+        assert_eq!(index.line_col(src, src.len()), (3, 3));
+    }
 }
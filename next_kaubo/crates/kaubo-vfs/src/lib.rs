@@ -1,13 +1,18 @@
 //! kaubo-vfs — 虚拟文件系统抽象
 //!
 //! 为模块系统提供平台无关的文件 IO：
-//! - CLI 用 `FsVfs`（封装 `std::fs`）
+//! - CLI 用 `MmapVfs`（按 mtime/size 复用已读内容；`new_mapped` 额外 mmap 大文件）
+//! - `FsVfs`（封装 `std::fs`，每次读取都拷贝成 `String`）
 //! - WASM / 测试用 `MemVfs`（内存 HashMap）
 //!
-//! 只读不写，不列目录，不缓存，不引入异步。
+//! 只读不写，不列目录，不引入异步。`open` 返回的 [`SourceText`] 可廉价
+//! 克隆，多个消费者共享同一份字节，不再逐个拷贝。
 
 use std::collections::HashMap;
+use std::ops::Deref;
 use std::path::{Path, PathBuf};
+use std::sync::{Arc, Mutex};
+use std::time::{Duration, SystemTime};
 
 /// 虚拟文件系统操作错误。
 #[derive(Debug, Clone)]
@@ -29,13 +34,159 @@ impl std::fmt::Display for VfsError {
 
 /// 虚拟文件系统。
 ///
-/// 读取源码文件，不涉及写操作、目录遍历、缓存。
+/// 读取源码文件，不涉及写操作、目录遍历。
 pub trait VirtualFileSystem: Send + Sync {
     /// 读取文件内容。
     ///
     /// `path` 是调用方提供的路径（可能包含相对路径）。
     /// 返回文件内容，或错误（文件不存在 / 权限等）。
     fn read(&self, path: &str) -> Result<String, VfsError>;
+
+    /// 读取文件内容及元数据，内容以共享缓冲区返回。
+    ///
+    /// 默认实现包装 `read`；能避免拷贝的后端应覆盖此方法。
+    fn open(&self, path: &str) -> Result<SourceFile, VfsError> {
+        self.read(path)
+            .map(|text| SourceFile::new(text.into(), None))
+    }
+}
+
+// ── SourceText / FileMeta ──
+
+/// 只读共享的源码文本。
+///
+/// 克隆只增加引用计数。内容来自堆上的 `Arc<str>` 或只读 mmap 映射，
+/// 两者都已校验为 UTF-8，通过 `Deref<Target = str>` 使用。
+#[derive(Clone)]
+pub struct SourceText(Backing);
+
+#[derive(Clone)]
+enum Backing {
+    Heap(Arc<str>),
+    #[cfg(unix)]
+    Mapped(Arc<mmap::Mapping>),
+}
+
+impl SourceText {
+    /// 内容是否直接来自文件映射（未拷贝到堆上）。
+    pub fn is_mapped(&self) -> bool {
+        match &self.0 {
+            Backing::Heap(_) => false,
+            #[cfg(unix)]
+            Backing::Mapped(_) => true,
+        }
+    }
+
+    /// 两者是否共享同一块缓冲区。
+    pub fn ptr_eq(a: &Self, b: &Self) -> bool {
+        std::ptr::eq(a.as_ptr(), b.as_ptr()) && a.len() == b.len()
+    }
+}
+
+impl Deref for SourceText {
+    type Target = str;
+
+    fn deref(&self) -> &str {
+        match &self.0 {
+            Backing::Heap(s) => s,
+            #[cfg(unix)]
+            Backing::Mapped(m) => m.as_str(),
+        }
+    }
+}
+
+impl AsRef<str> for SourceText {
+    fn as_ref(&self) -> &str {
+        self
+    }
+}
+
+impl From<String> for SourceText {
+    fn from(s: String) -> Self {
+        Self(Backing::Heap(s.into()))
+    }
+}
+
+impl From<&str> for SourceText {
+    fn from(s: &str) -> Self {
+        Self(Backing::Heap(s.into()))
+    }
+}
+
+impl From<Arc<str>> for SourceText {
+    fn from(s: Arc<str>) -> Self {
+        Self(Backing::Heap(s))
+    }
+}
+
+impl PartialEq for SourceText {
+    fn eq(&self, other: &Self) -> bool {
+        **self == **other
+    }
+}
+
+impl Eq for SourceText {}
+
+impl PartialEq<str> for SourceText {
+    fn eq(&self, other: &str) -> bool {
+        &**self == other
+    }
+}
+
+impl PartialEq<&str> for SourceText {
+    fn eq(&self, other: &&str) -> bool {
+        &**self == *other
+    }
+}
+
+impl std::fmt::Debug for SourceText {
+    fn fmt(&self, f: &mut std::fmt::Formatter<'_>) -> std::fmt::Result {
+        std::fmt::Debug::fmt(&**self, f)
+    }
+}
+
+impl std::fmt::Display for SourceText {
+    fn fmt(&self, f: &mut std::fmt::Formatter<'_>) -> std::fmt::Result {
+        f.write_str(self)
+    }
+}
+
+/// 文件元数据。
+///
+/// `hash` 是内容的 FNV-1a 128，跨进程稳定，可直接作为持久缓存键的输入；
+/// `mtime` 只有真实文件系统才有，用来判断已读内容能否复用。
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub struct FileMeta {
+    pub size: u64,
+    pub mtime: Option<SystemTime>,
+    pub hash: u128,
+}
+
+/// `open` 的结果：共享文本 + 元数据。
+#[derive(Debug, Clone)]
+pub struct SourceFile {
+    pub text: SourceText,
+    pub meta: FileMeta,
+}
+
+impl SourceFile {
+    /// 由文本构造，`size` / `hash` 从内容计算。
+    pub fn new(text: SourceText, mtime: Option<SystemTime>) -> Self {
+        let meta = FileMeta {
+            size: text.len() as u64,
+            mtime,
+            hash: content_hash(text.as_bytes()),
+        };
+        Self { text, meta }
+    }
+}
+
+/// 内容哈希（FNV-1a 128），与 `kaubo_dag::CacheKey` 使用同一算法。
+pub fn content_hash(data: &[u8]) -> u128 {
+    const OFFSET: u128 = 0x6c62272e07bb014262b821756295c58d;
+    const PRIME: u128 = 0x0000000001000000000000000000013b;
+    data.iter()
+        .fold(OFFSET, |h, &b| (h ^ b as u128).wrapping_mul(PRIME))
 }
 
 // ── FsVfs：文件系统后端（CLI） ──
@@ -76,12 +227,204 @@ impl VirtualFileSystem for FsVfs {
     }
 }
 
+// ── MmapVfs：共享缓冲区的文件系统后端（CLI） ──
+
+/// 不小于此大小的文件用 mmap 映射，更小的文件直接读入堆——映射本身的
+/// 系统调用和页表开销在小文件上得不偿失。
+pub const MMAP_THRESHOLD: u64 = 16 * 1024;
+
+/// mtime 落在读取时刻前这段时间内的文件不复用：同一时钟刻度内的改动
+/// 不会改变 mtime，只有"读取之后才过了足够久"的 mtime 才可信。
+const RACY_WINDOW: Duration = Duration::from_secs(2);
+
+/// 读取结果以 [`SourceText`] 共享的 VFS。
+///
+/// - 读过的文件按规范路径记下 `(size, mtime)`，再次 `open` 时元数据未变
+///   就直接返回同一份缓冲区和哈希，不重读、不重算哈希；
+/// - [`MmapVfs::new_mapped`] 构造的实例把大文件（≥ [`MMAP_THRESHOLD`]）只读映射，
+///   内容不拷贝。`new` 总是读入堆，非 unix 平台上也是。
+pub struct MmapVfs {
+    root: PathBuf,
+    opened: Mutex<HashMap<PathBuf, Opened>>,
+    map: bool,
+}
+
+struct Opened {
+    file: SourceFile,
+    read_at: SystemTime,
+}
+
+impl MmapVfs {
+    /// 创建以 `root` 为根目录的 MmapVfs，文件内容都读入堆。
+    pub fn new(root: impl AsRef<Path>) -> Self {
+        let root = root.as_ref();
+        Self {
+            root: root.canonicalize().unwrap_or_else(|_| root.to_path_buf()),
+            opened: Mutex::new(HashMap::new()),
+            map: false,
+        }
+    }
+
+    /// 同 [`MmapVfs::new`]，但大文件直接映射而不拷贝。
+    ///
+    /// # Safety
+    ///
+    /// 映射是 `MAP_PRIVATE`：文件在映射期间被原地改写，`SourceText` 的内容
+    /// 会跟着变（不再是校验过的 UTF-8），被截断则访问时触发 SIGBUS。调用方
+    /// 保证从这个 VFS 得到的 `SourceText` 存活期间，`root` 下读过的文件
+    /// 不会被截断或原地改写（"写临时文件再改名"不受影响）。
+    pub unsafe fn new_mapped(root: impl AsRef<Path>) -> Self {
+        Self {
+            map: true,
+            ..Self::new(root)
+        }
+    }
+
+    /// 当前记住的文件数。
+    pub fn cached(&self) -> usize {
+        self.opened.lock().unwrap().len()
+    }
+
+    fn load(&self, full: &Path, path: &str) -> Result<(SourceText, Option<SystemTime>), VfsError> {
+        let io = |e: std::io::Error| VfsError::IoError {
+            path: path.to_string(),
+            reason: e.to_string(),
+        };
+        let file = std::fs::File::open(full).map_err(io)?;
+        let md = file.metadata().map_err(io)?;
+        let mtime = md.modified().ok();
+        #[cfg(unix)]
+        if self.map && md.len() >= MMAP_THRESHOLD {
+            // SAFETY: 只有 `new_mapped` 打开 `map`，调用方已承诺文件不被原地改写
+            let mapping = unsafe { mmap::Mapping::new(&file, md.len() as usize) }.map_err(io)?;
+            return Ok((SourceText(Backing::Mapped(Arc::new(mapping))), mtime));
+        }
+        let mut text = String::with_capacity(md.len() as usize);
+        std::io::Read::read_to_string(&mut &file, &mut text).map_err(io)?;
+        Ok((text.into(), mtime))
+    }
+}
+
+impl VirtualFileSystem for MmapVfs {
+    fn read(&self, path: &str) -> Result<String, VfsError> {
+        self.open(path).map(|f| f.text.to_string())
+    }
+
+    fn open(&self, path: &str) -> Result<SourceFile, VfsError> {
+        let full = self
+            .root
+            .join(path)
+            .canonicalize()
+            .map_err(|_| VfsError::NotFound {
+                path: path.to_string(),
+            })?;
+        // 安全检查：确保解析后的路径仍在 root 下
+        if !full.starts_with(&self.root) {
+            return Err(VfsError::NotFound {
+                path: path.to_string(),
+            });
+        }
+        let md = std::fs::metadata(&full).map_err(|e| VfsError::IoError {
+            path: path.to_string(),
+            reason: e.to_string(),
+        })?;
+        let mtime = md.modified().ok();
+        if let Some(hit) = self.opened.lock().unwrap().get(&full) {
+            let settled = mtime.is_some_and(|m| m + RACY_WINDOW <= hit.read_at);
+            if settled && hit.file.meta.mtime == mtime && hit.file.meta.size == md.len() {
+                return Ok(hit.file.clone());
+            }
+        }
+        let read_at = SystemTime::now();
+        let (text, mtime) = self.load(&full, path)?;
+        let file = SourceFile::new(text, mtime);
+        self.opened.lock().unwrap().insert(
+            full,
+            Opened {
+                file: file.clone(),
+                read_at,
+            },
+        );
+        Ok(file)
+    }
+}
+
+#[cfg(unix)]
+mod mmap {
+    use std::fs::File;
+    use std::io;
+    use std::os::unix::io::AsRawFd;
+
+    /// 只读私有映射，构造时已校验 UTF-8。
+    ///
+    /// 校验只在构造时做一次：`as_str` 的 UTF-8 保证依赖 `new` 的调用方承诺
+    /// 文件在映射期间不被改写。
+    pub(crate) struct Mapping {
+        ptr: *const u8,
+        len: usize,
+    }
+
+    // SAFETY: 映射只读，析构前不会被修改或释放
+    unsafe impl Send for Mapping {}
+    unsafe impl Sync for Mapping {}
+
+    impl Mapping {
+        /// 映射 `file` 的前 `len` 字节（`len > 0`）。
+        ///
+        /// # Safety
+        ///
+        /// 映射存活期间 `file` 不能被截断或原地改写（见 `MmapVfs::new_mapped`）。
+        pub(crate) unsafe fn new(file: &File, len: usize) -> io::Result<Self> {
+            // SAFETY: fd 有效，len > 0，失败时返回 MAP_FAILED
+            let ptr = unsafe {
+                libc::mmap(
+                    std::ptr::null_mut(),
+                    len,
+                    libc::PROT_READ,
+                    libc::MAP_PRIVATE,
+                    file.as_raw_fd(),
+                    0,
+                )
+            };
+            if ptr == libc::MAP_FAILED {
+                return Err(io::Error::last_os_error());
+            }
+            let mapping = Self {
+                ptr: ptr as *const u8,
+                len,
+            };
+            std::str::from_utf8(mapping.bytes())
+                .map_err(|e| io::Error::new(io::ErrorKind::InvalidData, e))?;
+            Ok(mapping)
+        }
+
+        fn bytes(&self) -> &[u8] {
+            // SAFETY: ptr / len 来自成功的 mmap，映射存活到 drop
+            unsafe { std::slice::from_raw_parts(self.ptr, self.len) }
+        }
+
+        pub(crate) fn as_str(&self) -> &str {
+            // SAFETY: new 已校验 UTF-8，其调用方保证内容此后不变
+            unsafe { std::str::from_utf8_unchecked(self.bytes()) }
+        }
+    }
+
+    impl Drop for Mapping {
+        fn drop(&mut self) {
+            // SAFETY: ptr / len 来自 Mapping::new 的 mmap
+            unsafe {
+                libc::munmap(self.ptr as *mut libc::c_void, self.len);
+            }
+        }
+    }
+}
+
 // ── MemVfs：内存后端（WASM / 测试） ──
 
 /// 基于内存 HashMap 的 VFS 实现。
 #[derive(Default)]
 pub struct MemVfs {
-    files: HashMap<String, String>,
+    files: HashMap<String, SourceText>,
 }
 
 impl MemVfs {
@@ -94,15 +437,19 @@ impl MemVfs {
 
     /// 向虚拟文件系统中插入文件。
     pub fn insert(&mut self, path: &str, source: &str) {
-        self.files.insert(path.to_string(), source.to_string());
+        self.files.insert(path.to_string(), source.into());
     }
 }
 
 impl VirtualFileSystem for MemVfs {
     fn read(&self, path: &str) -> Result<String, VfsError> {
+        self.open(path).map(|f| f.text.to_string())
+    }
+
+    fn open(&self, path: &str) -> Result<SourceFile, VfsError> {
         self.files
             .get(path)
-            .cloned()
+            .map(|text| SourceFile::new(text.clone(), None))
             .ok_or_else(|| VfsError::NotFound {
                 path: path.to_string(),
             })
@@ -145,4 +492,100 @@ mod tests {
         assert_eq!(vfs.read("a.kb").unwrap(), "A");
         assert_eq!(vfs.read("b.kb").unwrap(), "B");
     }
+
+    fn scratch(name: &str) -> PathBuf {
+        let dir = std::env::temp_dir().join(format!("kaubo_vfs_{name}_{}", std::process::id()));
+        let _ = std::fs::remove_dir_all(&dir);
+        std::fs::create_dir_all(&dir).unwrap();
+        dir
+    }
+
+    /// 写入文件并把 mtime 拨到 `age` 之前，让缓存认为它已稳定。
+    fn write_aged(path: &Path, content: &str, age: u64) {
+        std::fs::write(path, content).unwrap();
+        let file = std::fs::File::options().write(true).open(path).unwrap();
+        file.set_modified(SystemTime::now() - Duration::from_secs(age))
+            .unwrap();
+    }
+
+    #[test]
+    fn mem_vfs_open_shares_the_buffer() {
+        let mut vfs = MemVfs::new();
+        vfs.insert("a.kb", "const a = 1;");
+        let (x, y) = (vfs.open("a.kb").unwrap(), vfs.open("a.kb").unwrap());
+        assert!(SourceText::ptr_eq(&x.text, &y.text));
+        assert_eq!(x.meta.size, 12);
+        assert_eq!(x.meta.hash, content_hash(b"const a = 1;"));
+        assert_eq!(x.meta.mtime, None);
+    }
+
+    #[test]
+    fn content_hash_is_fnv1a_128() {
+        assert_eq!(content_hash(b"a"), 0xd228cb696f1a8caf78912b704e4a8964);
+        assert_ne!(content_hash(b"ab"), content_hash(b"ba"));
+    }
+
+    #[test]
+    fn mmap_vfs_maps_large_files_and_reads_small_ones() {
+        let dir = scratch("map");
+        let big = "const x = 1;\n".repeat(2000);
+        std::fs::write(dir.join("big.kb"), &big).unwrap();
+        std::fs::write(dir.join("small.kb"), "const y = 2;").unwrap();
+        assert!(!MmapVfs::new(&dir).open("big.kb").unwrap().text.is_mapped());
+        // SAFETY: 测试目录里的文件在 vfs 存活期间不再改动
+        let vfs = unsafe { MmapVfs::new_mapped(&dir) };
+        let f = vfs.open("big.kb").unwrap();
+        assert_eq!(f.text.is_mapped(), cfg!(unix));
+        assert_eq!(f.text, big.as_str());
+        assert_eq!(f.meta.hash, content_hash(big.as_bytes()));
+        let s = vfs.open("./small.kb").unwrap();
+        assert!(!s.text.is_mapped());
+        assert_eq!(vfs.read("small.kb").unwrap(), "const y = 2;");
+        std::fs::remove_dir_all(&dir).unwrap();
+    }
+
+    #[test]
+    fn mmap_vfs_reuses_unchanged_files_by_metadata() {
+        let dir = scratch("reuse");
+        let path = dir.join("a.kb");
+        write_aged(&path, "const a = 1;", 60);
+        let vfs = MmapVfs::new(&dir);
+        let first = vfs.open("a.kb").unwrap();
+        let again = vfs.open("./a.kb").unwrap();
+        assert!(SourceText::ptr_eq(&first.text, &again.text));
+        assert_eq!(vfs.cached(), 1);
+
+        // 同样大小、mtime 改变：重读
+        write_aged(&path, "const a = 2;", 30);
+        let edited = vfs.open("a.kb").unwrap();
+        assert_eq!(edited.text, "const a = 2;");
+        assert_ne!(edited.meta.hash, first.meta.hash);
+
+        // 刚写入的文件 mtime 不可信，每次都重读
+        std::fs::write(&path, "const a = 3;").unwrap();
+        let fresh = vfs.open("a.kb").unwrap();
+        assert_eq!(fresh.text, "const a = 3;");
+        assert!(!SourceText::ptr_eq(
+            &fresh.text,
+            &vfs.open("a.kb").unwrap().text
+        ));
+        std::fs::remove_dir_all(&dir).unwrap();
+    }
+
+    #[test]
+    fn mmap_vfs_rejects_paths_outside_root() {
+        let dir = scratch("escape");
+        std::fs::create_dir_all(dir.join("root")).unwrap();
+        std::fs::write(dir.join("secret.kb"), "x").unwrap();
+        let vfs = MmapVfs::new(dir.join("root"));
+        assert!(matches!(
+            vfs.open("../secret.kb"),
+            Err(VfsError::NotFound { .. })
+        ));
+        assert!(matches!(
+            vfs.open("missing.kb"),
+            Err(VfsError::NotFound { .. })
+        ));
+        std::fs::remove_dir_all(&dir).unwrap();
+    }
 }
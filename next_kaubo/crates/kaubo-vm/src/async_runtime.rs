@@ -2,25 +2,168 @@
 //!
 //! v2.0: 事件循环 + 帧挂起/恢复
 //! CPS Suspend terminator → 保存帧 → 调度器接管
-//! 预留: IoPoller trait 抽象 I/O (epoll/kqueue/WASM)
+//!
+//! 挂起的任务存放在分代 slab（`TaskSlab`）里：挂起、恢复、完成都是 O(1)，
+//! 过期的 `TaskId`（槽位已被复用）按代号识别，查不到而不是误命中。
+//! 寄存器快照的缓冲随槽位回收复用，稳态下挂起不分配。
+//!
+//! 任务由两类事件唤醒，`AsyncScheduler::turn` 把两者汇总为完成结果：
+//!   - 定时器：`sleep` 登记到 `TimerWheel`，按调用方给出的时钟刻度触发
+//!   - I/O：`IoPoller` 后端（Linux epoll、宿主 Promise 驱动，见 `io_poller`）
+
+use std::collections::VecDeque;
+use std::io;
+use std::time::Duration;
 
 use crate::execute::CallFrame;
+use crate::io_poller::IoPoller;
+use crate::timer_wheel::TimerWheel;
 
-/// 异步任务 ID
+/// 异步任务 ID：低 32 位是 slab 槽位，高 32 位是槽位的代号。
 pub type TaskId = usize;
 
 /// 挂起的执行帧
 #[derive(Debug, Clone)]
 pub struct SuspendedFrame {
     pub frame: CallFrame,
+    /// 挂起时当前窗口的寄存器快照（寄存器栈会被后续调用复用）
+    pub regs: Vec<u64>,
     pub ip: usize, // 挂起位置的 IP (resume 后从此继续)
 }
 
-/// 异步调度器 (v2.0: 简单队列模型)
+// ── 分代 slab ──
+
+struct Slot {
+    generation: u32,
+    frame: Option<SuspendedFrame>,
+}
+
+/// 按 `TaskId` O(1) 存取挂起帧的分代 slab。
+#[derive(Default)]
+pub struct TaskSlab {
+    slots: Vec<Slot>,
+    free: Vec<u32>,
+    len: usize,
+    /// 已移出帧留下的寄存器缓冲，供下一次挂起复用。
+    spare: Vec<Vec<u64>>,
+}
+
+fn task_id(index: u32, generation: u32) -> TaskId {
+    ((generation as usize) << 32) | index as usize
+}
+
+fn split(id: TaskId) -> (usize, u32) {
+    ((id & 0xFFFF_FFFF), (id >> 32) as u32)
+}
+
+impl TaskSlab {
+    /// 存入一个帧，寄存器从 `regs` 复制进复用的缓冲。
+    pub fn insert(&mut self, frame: CallFrame, regs: &[u64], ip: usize) -> TaskId {
+        let mut buf = self.spare.pop().unwrap_or_default();
+        buf.clear();
+        buf.extend_from_slice(regs);
+        let frame = SuspendedFrame {
+            frame,
+            regs: buf,
+            ip,
+        };
+        self.len += 1;
+        match self.free.pop() {
+            Some(index) => {
+                let slot = &mut self.slots[index as usize];
+                slot.frame = Some(frame);
+                task_id(index, slot.generation)
+            }
+            None => {
+                let index = u32::try_from(self.slots.len()).expect("task slab overflow");
+                self.slots.push(Slot {
+                    generation: 0,
+                    frame: Some(frame),
+                });
+                task_id(index, 0)
+            }
+        }
+    }
+
+    pub fn get(&self, id: TaskId) -> Option<&SuspendedFrame> {
+        let (index, generation) = split(id);
+        self.slots
+            .get(index)
+            .filter(|s| s.generation == generation)
+            .and_then(|s| s.frame.as_ref())
+    }
+
+    pub fn contains(&self, id: TaskId) -> bool {
+        self.get(id).is_some()
+    }
+
+    /// 移出帧并让槽位换代；`id` 过期或不存在时返回 `None`。
+    pub fn remove(&mut self, id: TaskId) -> Option<SuspendedFrame> {
+        let (index, generation) = split(id);
+        let slot = self.slots.get_mut(index)?;
+        if slot.generation != generation {
+            return None;
+        }
+        let frame = slot.frame.take()?;
+        slot.generation = slot.generation.wrapping_add(1);
+        self.free.push(index as u32);
+        self.len -= 1;
+        Some(frame)
+    }
+
+    /// 移出帧并丢弃：寄存器缓冲留给下一次挂起。
+    pub fn discard(&mut self, id: TaskId) -> bool {
+        match self.remove(id) {
+            Some(frame) => {
+                self.spare.push(frame.regs);
+                true
+            }
+            None => false,
+        }
+    }
+
+    /// 归还 `resume` 取走的帧的寄存器缓冲。
+    pub fn recycle(&mut self, regs: Vec<u64>) {
+        self.spare.push(regs);
+    }
+
+    pub fn len(&self) -> usize {
+        self.len
+    }
+
+    pub fn is_empty(&self) -> bool {
+        self.len == 0
+    }
+
+    pub fn iter(&self) -> impl Iterator<Item = (TaskId, &SuspendedFrame)> + '_ {
+        self.slots.iter().enumerate().filter_map(|(i, s)| {
+            s.frame
+                .as_ref()
+                .map(|f| (task_id(i as u32, s.generation), f))
+        })
+    }
+
+    fn drain_ids(&mut self) -> Vec<TaskId> {
+        let ids: Vec<TaskId> = self.iter().map(|(id, _)| id).collect();
+        for &id in &ids {
+            self.discard(id);
+        }
+        ids
+    }
+}
+
+// ── 调度器 ──
+
+/// 异步调度器：挂起帧的 slab + 定时器 + 已完成结果队列
 pub struct AsyncScheduler {
-    tasks: Vec<(TaskId, SuspendedFrame)>,
-    next_id: TaskId,
-    completed: Vec<(TaskId, i64)>, // 已完成任务的结果
+    tasks: TaskSlab,
+    timers: TimerWheel,
+    /// 已完成任务的结果，`poll` 按后进先出取出
+    completed: Vec<(TaskId, i64)>,
+    /// `turn` 收集事件用的缓冲，跨调用复用
+    events: Vec<(TaskId, i64)>,
+    /// 已唤醒、等待 VM 恢复执行的任务
+    ready: VecDeque<(TaskId, i64)>,
 }
 
 impl Default for AsyncScheduler {
@@ -32,18 +175,26 @@ impl Default for AsyncScheduler {
 impl AsyncScheduler {
     pub fn new() -> Self {
         AsyncScheduler {
-            tasks: vec![],
-            next_id: 0,
+            tasks: TaskSlab::default(),
+            timers: TimerWheel::new(0),
             completed: vec![],
+            events: vec![],
+            ready: VecDeque::new(),
         }
     }
 
-    /// 注册挂起帧，返回任务 ID
-    pub fn suspend(&mut self, frame: CallFrame, ip: usize) -> TaskId {
-        let id = self.next_id;
-        self.next_id += 1;
-        self.tasks.push((id, SuspendedFrame { frame, ip }));
-        id
+    /// 注册挂起帧（复制当前窗口寄存器），返回任务 ID
+    pub fn suspend(&mut self, frame: CallFrame, regs: &[u64], ip: usize) -> TaskId {
+        self.tasks.insert(frame, regs, ip)
+    }
+
+    /// 挂起帧的寄存器与已完成任务的结果 — 堆回收的根。
+    pub fn roots(&self) -> impl Iterator<Item = u64> + '_ {
+        self.tasks
+            .iter()
+            .flat_map(|(_, f)| f.regs.iter().copied())
+            .chain(self.completed.iter().map(|&(_, r)| r as u64))
+            .chain(self.ready.iter().map(|&(_, r)| r as u64))
     }
 
     /// 检查任务是否已完成
@@ -51,22 +202,78 @@ impl AsyncScheduler {
         self.completed.pop()
     }
 
-    /// 恢复一个挂起的帧
+    /// 恢复一个挂起的帧（O(1)）；用完后可把 `regs` 交还 `recycle`
     pub fn resume_frame(&mut self, task_id: TaskId) -> Option<SuspendedFrame> {
-        if let Some(pos) = self.tasks.iter().position(|(id, _)| *id == task_id) {
-            Some(self.tasks.swap_remove(pos).1)
+        self.tasks.remove(task_id)
+    }
+
+    /// 归还恢复帧的寄存器缓冲。
+    pub fn recycle(&mut self, regs: Vec<u64>) {
+        self.tasks.recycle(regs);
+    }
+
+    /// 将挂起但已完成的帧标记为就绪 (I/O / 定时器完成)
+    pub fn complete(&mut self, task_id: TaskId, result: i64) {
+        self.tasks.discard(task_id);
+        self.completed.push((task_id, result));
+    }
+
+    /// `ticks` 个时钟刻度后以 `result` 完成任务。
+    pub fn sleep(&mut self, task_id: TaskId, ticks: u64, result: i64) {
+        self.timers.insert(task_id, ticks, result);
+    }
+
+    /// 事件循环的一轮：时钟推进到 `now`，再向 `poller` 收集 I/O 完成。
+    ///
+    /// 已到期 / 已就绪的任务进入 `ready` 队列，交给 VM 用 `next_ready` 按序恢复；
+    /// 已不在 slab 里的任务（被取消或早已完成）的事件直接丢弃。
+    /// 返回本轮唤醒的任务数。
+    pub fn turn(
+        &mut self,
+        poller: &mut dyn IoPoller,
+        now: u64,
+        timeout: Option<Duration>,
+    ) -> io::Result<usize> {
+        let mut events = std::mem::take(&mut self.events);
+        events.clear();
+        self.timers.advance(now, &mut events);
+        // 有到期定时器时不阻塞等待 I/O
+        let timeout = if events.is_empty() {
+            timeout
         } else {
-            None
+            Some(Duration::ZERO)
+        };
+        let polled = poller.poll(timeout, &mut events);
+        let mut woken = 0;
+        for &(id, result) in &events {
+            if self.tasks.contains(id) {
+                self.ready.push_back((id, result));
+                woken += 1;
+            }
         }
+        self.events = events;
+        polled.map(|()| woken)
     }
 
-    /// 将挂起但已完成的帧标记为就绪 (模拟 I/O 完成)
-    pub fn complete(&mut self, task_id: TaskId, result: i64) {
-        // 从挂起列表移除
-        if let Some(pos) = self.tasks.iter().position(|(id, _)| *id == task_id) {
-            self.tasks.remove(pos);
+    /// 取出下一个已唤醒的任务：帧与唤醒它的结果。
+    pub fn next_ready(&mut self) -> Option<(TaskId, SuspendedFrame, i64)> {
+        while let Some((id, result)) = self.ready.pop_front() {
+            if let Some(frame) = self.tasks.remove(id) {
+                return Some((id, frame, result));
+            }
         }
-        self.completed.push((task_id, result));
+        None
+    }
+
+    /// 把所有已唤醒任务直接记为完成（不恢复帧），返回个数。
+    pub fn complete_ready(&mut self) -> usize {
+        let mut n = 0;
+        while let Some((id, frame, result)) = self.next_ready() {
+            self.tasks.recycle(frame.regs);
+            self.completed.push((id, result));
+            n += 1;
+        }
+        n
     }
 
     /// 是否有待处理的任务
@@ -74,18 +281,26 @@ impl AsyncScheduler {
         !self.tasks.is_empty()
     }
 
+    /// 挂起任务数
+    pub fn pending_len(&self) -> usize {
+        self.tasks.len()
+    }
+
     /// 获取所有待处理的任务 ID
     pub fn pending_ids(&self) -> Vec<TaskId> {
-        self.tasks.iter().map(|(id, _)| *id).collect()
+        self.tasks.iter().map(|(id, _)| id).collect()
     }
 
     /// 一次性完成所有待处理任务 (模拟同步 IO)
     pub fn flush_all(&mut self, result: i64) -> Vec<(TaskId, i64)> {
-        let mut completed = vec![];
-        for (id, _) in std::mem::take(&mut self.tasks) {
-            completed.push((id, result));
-        }
-        self.completed.extend(completed.clone());
+        let completed: Vec<(TaskId, i64)> = self
+            .tasks
+            .drain_ids()
+            .into_iter()
+            .map(|id| (id, result))
+            .collect();
+        self.ready.clear();
+        self.completed.extend(completed.iter().copied());
         completed
     }
 }
@@ -94,12 +309,14 @@ impl AsyncScheduler {
 mod tests {
     use super::*;
     use crate::execute::CallFrame;
+    use crate::io_poller::PromisePoller;
 
     fn frame() -> CallFrame {
         CallFrame {
             func_idx: 1,
             ret_block: 2,
-            saved_regs: vec![1],
+            base: 0,
+            len: 1,
             result_reg: 3,
         }
     }
@@ -110,10 +327,11 @@ mod tests {
         let cf = CallFrame {
             func_idx: 0,
             ret_block: 0,
-            saved_regs: vec![],
+            base: 0,
+            len: 0,
             result_reg: 0,
         };
-        let id = sched.suspend(cf, 42);
+        let id = sched.suspend(cf, &[], 42);
         assert_eq!(sched.tasks.len(), 1);
         let sf = sched.resume_frame(id).unwrap();
         assert_eq!(sf.ip, 42);
@@ -125,10 +343,11 @@ mod tests {
         let cf = CallFrame {
             func_idx: 0,
             ret_block: 0,
-            saved_regs: vec![],
+            base: 0,
+            len: 0,
             result_reg: 0,
         };
-        let id = sched.suspend(cf, 0);
+        let id = sched.suspend(cf, &[], 0);
         sched.complete(id, 100);
         assert!(sched.tasks.is_empty());
         assert_eq!(sched.poll(), Some((id, 100)));
@@ -137,7 +356,7 @@ mod tests {
     #[test]
     fn pending_completion_and_polling_work() {
         let mut sched = AsyncScheduler::new();
-        let id = sched.suspend(frame(), 7);
+        let id = sched.suspend(frame(), &[1], 7);
         assert!(sched.has_pending());
         assert_eq!(sched.pending_ids(), vec![id]);
         assert!(sched.resume_frame(999).is_none());
@@ -150,19 +369,80 @@ mod tests {
     #[test]
     fn complete_flush_and_poll_cover_queue_paths() {
         let mut sched = AsyncScheduler::new();
-        let id1 = sched.suspend(frame(), 1);
-        let id2 = sched.suspend(frame(), 2);
+        let id1 = sched.suspend(frame(), &[1], 1);
+        let id2 = sched.suspend(frame(), &[1], 2);
         let flushed = sched.flush_all(99);
         assert_eq!(flushed.len(), 2);
         assert_eq!(sched.poll(), Some((id2, 99)));
         assert_eq!(sched.poll(), Some((id1, 99)));
         assert!(!sched.has_pending());
 
-        let id3 = sched.suspend(frame(), 3);
+        let id3 = sched.suspend(frame(), &[1], 3);
         sched.complete(id1, 7);
         sched.complete(id3, 8);
         assert_eq!(sched.poll(), Some((id3, 8)));
         assert_eq!(sched.poll(), Some((id1, 7)));
         assert_eq!(sched.poll(), None);
     }
+
+    #[test]
+    fn stale_task_ids_miss_after_slot_reuse() {
+        let mut slab = TaskSlab::default();
+        let a = slab.insert(frame(), &[1, 2, 3], 0);
+        assert!(slab.discard(a));
+        let b = slab.insert(frame(), &[4], 1);
+        // 同一槽位、不同代号
+        assert_eq!(a & 0xFFFF_FFFF, b & 0xFFFF_FFFF);
+        assert_ne!(a, b);
+        assert!(slab.get(a).is_none());
+        assert!(slab.remove(a).is_none());
+        assert_eq!(slab.get(b).unwrap().regs, vec![4]);
+        assert_eq!(slab.len(), 1);
+    }
+
+    #[test]
+    fn fan_out_of_many_tasks_completes_through_timers_and_io() {
+        const N: usize = 50_000;
+        let mut sched = AsyncScheduler::new();
+        let mut poller = PromisePoller::new();
+        let host = poller.handle();
+        let ids: Vec<TaskId> = (0..N)
+            .map(|i| sched.suspend(frame(), &[i as u64], i))
+            .collect();
+        assert_eq!(sched.pending_len(), N);
+        // 偶数任务等定时器（延迟跨过多圈时间轮），奇数任务等宿主 resolve
+        for (i, &id) in ids.iter().enumerate() {
+            if i % 2 == 0 {
+                sched.sleep(id, (i % 1000) as u64 + 1, i as i64);
+            } else {
+                host.resolve(id, i as i64);
+            }
+        }
+        let mut now = 0;
+        let mut resumed = 0;
+        while sched.has_pending() {
+            now += 100;
+            sched.turn(&mut poller, now, None).unwrap();
+            while let Some((_, frame, result)) = sched.next_ready() {
+                assert_eq!(frame.ip as i64, result);
+                sched.recycle(frame.regs);
+                resumed += 1;
+            }
+            assert!(now <= 2_000, "timers did not fire");
+        }
+        assert_eq!(resumed, N);
+    }
+
+    #[test]
+    fn cancelled_tasks_ignore_their_events() {
+        let mut sched = AsyncScheduler::new();
+        let mut poller = PromisePoller::new();
+        let id = sched.suspend(frame(), &[], 0);
+        sched.sleep(id, 5, 1);
+        poller.handle().resolve(id, 2);
+        sched.complete(id, 3);
+        assert_eq!(sched.turn(&mut poller, 10, None).unwrap(), 0);
+        assert!(sched.next_ready().is_none());
+        assert_eq!(sched.poll(), Some((id, 3)));
+    }
 }
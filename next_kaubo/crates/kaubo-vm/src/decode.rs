@@ -0,0 +1,579 @@
+//! 预解码指令流 — 函数首次执行时把打包的 `u32` 降为可直接分发的记录
+//!
+//! `LoadedProgram::decoded(func)` 与该函数在 `instrs` 中的一段按 IP 一一对应，每个 slot 保存:
+//!   - 已拆开的寄存器操作数（分发时不再移位/掩码）
+//!   - 已解析的跳转目标 IP（不再查 `block_starts`）与回边标记
+//!   - 常量内联为 64-bit 立即数（`LoadedProgram::const_bits`，字符串是常驻堆槽位）
+//!   - 热点指令对融合后的超级指令
+//!
+//! 没有预解码形式的指令标记为 `DOp::Slow`，由 `VM::step` 按原编码执行。
+//! 超级指令只改写指令序列的首个 slot，后续 slot 保持各自的解码结果，
+//! 所以块起始、回边检测、`Suspend` 保存的 IP 与编码形式完全一致。
+
+use crate::execute::{Inst, Opcode};
+use crate::program::LoadedProgram;
+
+/// 预解码操作码。
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+#[repr(u8)]
+pub enum DOp {
+    /// 无预解码形式：回落到 `VM::step`。
+    Slow,
+    // 三地址整数/浮点运算: a ← b op c
+    AddInt,
+    SubInt,
+    MulInt,
+    DivInt,
+    ModInt,
+    NegInt,
+    FAdd,
+    FSub,
+    FMul,
+    FDiv,
+    FNeg,
+    FSqrt,
+    FSin,
+    FCos,
+    FFloor,
+    FCeil,
+    EqInt,
+    NeInt,
+    LtInt,
+    LeInt,
+    GtInt,
+    GeInt,
+    FEq,
+    FNe,
+    FLt,
+    FLe,
+    FGt,
+    FGe,
+    Not,
+    Move,
+    /// a ← imm64 (`t | f << 32`)
+    LoadImm64,
+    /// Jump: → t (块 tb)，边移动见 `MOVES_T`
+    Jump,
+    /// Branch: a != 0 ? t (块 tb) : f (块 fb)，边移动见 `MOVES_T` / `MOVES_F`
+    Branch,
+    // ── 超级指令 ──
+    /// `LtInt(a, b, c)` + `Branch(a, ..)`
+    LtIntBranch,
+    /// `LeInt(a, b, c)` + `Branch(a, ..)`
+    LeIntBranch,
+    /// `ModInt(a, b, c)` + `EqInt(t, tb, fb)`
+    ModIntEqInt,
+    /// `ModInt(a, b, c)` + `LoadConst(tb, imm)` + `EqInt(fb, a, tb)`，imm 见 `imm64`
+    ModIntEqIntImm,
+    /// `AddInt(a, b, c)` + `Jump` → t (块 tb)
+    AddIntJump,
+}
+
+/// `t` 边是回边（目标 IP ≤ 跳转指令自身的 IP，即 `target <= ip`）。
+pub const BACK_T: u8 = 0b01;
+/// `f` 边是回边。
+pub const BACK_F: u8 = 0b10;
+/// `t` 边带寄存器移动（见 `VM::edge_spans` 的 primary 区间）。
+pub const MOVES_T: u8 = 0b100;
+/// `f` 边带寄存器移动（alt 区间）。
+pub const MOVES_F: u8 = 0b1000;
+
+/// 一条预解码指令。字段含义按 `op` 解释，见 `DOp` 各变体注释。
+#[derive(Debug, Clone, Copy)]
+pub struct DecodedInst {
+    pub op: DOp,
+    /// `BACK_*` / `MOVES_*` 标记位。
+    pub flags: u8,
+    pub a: u16,
+    pub b: u16,
+    pub c: u16,
+    pub t: u32,
+    pub f: u32,
+    pub tb: u32,
+    pub fb: u32,
+}
+
+impl DecodedInst {
+    const SLOW: DecodedInst = DecodedInst {
+        op: DOp::Slow,
+        flags: 0,
+        a: 0,
+        b: 0,
+        c: 0,
+        t: 0,
+        f: 0,
+        tb: 0,
+        fb: 0,
+    };
+
+    fn abc(op: DOp, inst: Inst) -> Self {
+        DecodedInst {
+            op,
+            a: inst.dst() as u16,
+            b: inst.src1() as u16,
+            c: inst.src2() as u16,
+            ..Self::SLOW
+        }
+    }
+
+    fn imm(a: usize, bits: u64) -> Self {
+        DecodedInst {
+            op: DOp::LoadImm64,
+            a: a as u16,
+            t: bits as u32,
+            f: (bits >> 32) as u32,
+            ..Self::SLOW
+        }
+    }
+
+    /// `LoadImm64` / `ModIntEqIntImm` 的 64-bit 立即数。
+    #[inline(always)]
+    pub fn imm64(&self) -> u64 {
+        (self.t as u64) | ((self.f as u64) << 32)
+    }
+}
+
+/// 把函数 `func` 的 `instrs` 降为预解码流（`LoadedProgram::decoded` 首次访问时调用）。
+///
+/// 结果按函数内偏移索引：slot `i` 对应 IP `func_instr_base[func] + i`。
+pub(crate) fn lower(prog: &LoadedProgram, func: usize) -> Box<[DecodedInst]> {
+    let base = prog.func_instr_base[func];
+    let mut code = vec![DecodedInst::SLOW; prog.func_instr_len(func)];
+    for &(start, len) in &prog.func_blocks[func] {
+        if len == 0 {
+            continue;
+        }
+        let block = &mut code[start - base..start - base + len];
+        for (i, slot) in block.iter_mut().enumerate() {
+            *slot = decode_one(prog, func, start + i);
+        }
+        fuse_block(block);
+    }
+    code.into_boxed_slice()
+}
+
+/// 单条指令的预解码形式（不做融合；基线 JIT 也从这里取指令）。
+pub(crate) fn decode_one(prog: &LoadedProgram, func: usize, ip: usize) -> DecodedInst {
+    let inst = Inst(prog.instrs[ip]);
+    let Ok(opcode) = inst.opcode() else {
+        return DecodedInst::SLOW;
+    };
+    let op = match opcode {
+        Opcode::AddInt => DOp::AddInt,
+        Opcode::SubInt => DOp::SubInt,
+        Opcode::MulInt => DOp::MulInt,
+        Opcode::DivInt => DOp::DivInt,
+        Opcode::ModInt => DOp::ModInt,
+        Opcode::NegInt => DOp::NegInt,
+        Opcode::FAdd => DOp::FAdd,
+        Opcode::FSub => DOp::FSub,
+        Opcode::FMul => DOp::FMul,
+        Opcode::FDiv => DOp::FDiv,
+        Opcode::FNeg => DOp::FNeg,
+        Opcode::FSqrt => DOp::FSqrt,
+        Opcode::FSin => DOp::FSin,
+        Opcode::FCos => DOp::FCos,
+        Opcode::FFloor => DOp::FFloor,
+        Opcode::FCeil => DOp::FCeil,
+        Opcode::EqInt => DOp::EqInt,
+        Opcode::NeInt => DOp::NeInt,
+        Opcode::LtInt => DOp::LtInt,
+        Opcode::LeInt => DOp::LeInt,
+        Opcode::GtInt => DOp::GtInt,
+        Opcode::GeInt => DOp::GeInt,
+        Opcode::FEq => DOp::FEq,
+        Opcode::FNe => DOp::FNe,
+        Opcode::FLt => DOp::FLt,
+        Opcode::FLe => DOp::FLe,
+        Opcode::FGt => DOp::FGt,
+        Opcode::FGe => DOp::FGe,
+        Opcode::Not => DOp::Not,
+        Opcode::Move => DOp::Move,
+        Opcode::LoadConst => {
+            // 越界常量由 step 报错
+            let Some(&bits) = prog.const_bits.get(inst.const_idx()) else {
+                return DecodedInst::SLOW;
+            };
+            return DecodedInst::imm(inst.dst(), bits);
+        }
+        Opcode::Jump => {
+            let block = (inst.src1() << 8) | inst.src2();
+            let Some(target) = resolve(prog, func, block) else {
+                return DecodedInst::SLOW;
+            };
+            return DecodedInst {
+                op: DOp::Jump,
+                flags: edge_flags(target <= ip, prog.edge_spans[ip].len, BACK_T, MOVES_T),
+                t: target as u32,
+                tb: block as u32,
+                ..DecodedInst::SLOW
+            };
+        }
+        Opcode::Branch => {
+            let (tb, fb) = (inst.src1(), inst.src2());
+            let (Some(t), Some(f)) = (resolve(prog, func, tb), resolve(prog, func, fb)) else {
+                return DecodedInst::SLOW;
+            };
+            let span = prog.edge_spans[ip];
+            return DecodedInst {
+                op: DOp::Branch,
+                flags: edge_flags(t <= ip, span.len, BACK_T, MOVES_T)
+                    | edge_flags(f <= ip, span.alt_len, BACK_F, MOVES_F),
+                a: inst.dst() as u16,
+                t: t as u32,
+                f: f as u32,
+                tb: tb as u32,
+                fb: fb as u32,
+                ..DecodedInst::SLOW
+            };
+        }
+        _ => return DecodedInst::SLOW,
+    };
+    DecodedInst::abc(op, inst)
+}
+
+/// 一条出边的标记位：是否回边、是否带寄存器移动。
+fn edge_flags(back: bool, moves: u32, back_bit: u8, moves_bit: u8) -> u8 {
+    let mut flags = 0;
+    if back {
+        flags |= back_bit;
+    }
+    if moves != 0 {
+        flags |= moves_bit;
+    }
+    flags
+}
+
+/// 块 id → 绝对 IP（与 `VM::block_ip` 相同，越界返回 None 交给 step 处理）。
+fn resolve(prog: &LoadedProgram, func: usize, block: usize) -> Option<usize> {
+    if block >= prog.func_blocks[func].len() {
+        return None;
+    }
+    prog.block_starts
+        .get(prog.func_block_base[func] + block)
+        .copied()
+}
+
+/// 在单个块内把热点指令对改写为超级指令（只改写首个 slot）。
+fn fuse_block(block: &mut [DecodedInst]) {
+    let mut i = 0;
+    while i + 1 < block.len() {
+        let (x, y) = (block[i], block[i + 1]);
+        let fused = match (x.op, y.op) {
+            (DOp::LtInt | DOp::LeInt, DOp::Branch) if y.a == x.a => Some(DecodedInst {
+                op: if x.op == DOp::LtInt {
+                    DOp::LtIntBranch
+                } else {
+                    DOp::LeIntBranch
+                },
+                flags: y.flags,
+                t: y.t,
+                f: y.f,
+                tb: y.tb,
+                fb: y.fb,
+                ..x
+            }),
+            (DOp::AddInt, DOp::Jump) => Some(DecodedInst {
+                op: DOp::AddIntJump,
+                flags: y.flags,
+                t: y.t,
+                tb: y.tb,
+                ..x
+            }),
+            (DOp::ModInt, DOp::EqInt) if y.b == x.a || y.c == x.a => Some(DecodedInst {
+                op: DOp::ModIntEqInt,
+                t: y.a as u32,
+                tb: y.b as u32,
+                fb: y.c as u32,
+                ..x
+            }),
+            // 常量比较前 cps_build 总会先物化字面量: ModInt; LoadConst; EqInt
+            (DOp::ModInt, DOp::LoadImm64) if i + 2 < block.len() => {
+                let z = block[i + 2];
+                let k = y.a;
+                let uses_pair = (z.b == x.a && z.c == k) || (z.b == k && z.c == x.a);
+                (z.op == DOp::EqInt && k != x.a && uses_pair).then_some(DecodedInst {
+                    op: DOp::ModIntEqIntImm,
+                    t: y.t,
+                    f: y.f,
+                    tb: k as u32,
+                    fb: z.a as u32,
+                    ..x
+                })
+            }
+            _ => None,
+        };
+        match fused {
+            Some(f) => {
+                block[i] = f;
+                i += span(f.op);
+            }
+            None => i += 1,
+        }
+    }
+}
+
+/// 超级指令覆盖的原始指令条数。
+#[inline(always)]
+pub fn span(op: DOp) -> usize {
+    match op {
+        DOp::LtIntBranch | DOp::LeIntBranch | DOp::ModIntEqInt | DOp::AddIntJump => 2,
+        DOp::ModIntEqIntImm => 3,
+        _ => 1,
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::execute::VM;
+    use kaubo_cps::test_util::{block, block_with, func, module, named_func};
+    use kaubo_cps::*;
+
+    /// `sieve` 风格的计数循环：i 从 0 到 n，统计 i % 3 == 0 的个数。
+    fn counting_loop(n: i64) -> CpsModule {
+        module(
+            vec![func(
+                vec![
+                    block(
+                        0,
+                        vec![CpsInstr::LoadConst(0, 0), CpsInstr::LoadConst(1, 0)],
+                        CpsTerminator::Jump(1, vec![]),
+                    ),
+                    block(
+                        1,
+                        vec![
+                            CpsInstr::LoadConst(2, 1),
+                            CpsInstr::BinOp(3, CpsBinOp::LtInt, 0, 2),
+                        ],
+                        CpsTerminator::Branch(3, 2, vec![], 4, vec![]),
+                    ),
+                    block(
+                        2,
+                        vec![
+                            CpsInstr::LoadConst(4, 2),
+                            CpsInstr::BinOp(5, CpsBinOp::ModInt, 0, 4),
+                            CpsInstr::LoadConst(6, 0),
+                            CpsInstr::BinOp(7, CpsBinOp::EqInt, 5, 6),
+                        ],
+                        CpsTerminator::Branch(7, 3, vec![], 5, vec![]),
+                    ),
+                    block(
+                        3,
+                        vec![
+                            CpsInstr::LoadConst(8, 3),
+                            CpsInstr::BinOp(1, CpsBinOp::AddInt, 1, 8),
+                        ],
+                        CpsTerminator::Jump(5, vec![]),
+                    ),
+                    block(4, vec![], CpsTerminator::Return(1)),
+                    block(
+                        5,
+                        vec![
+                            CpsInstr::LoadConst(9, 3),
+                            CpsInstr::BinOp(0, CpsBinOp::AddInt, 0, 9),
+                        ],
+                        CpsTerminator::Jump(1, vec![]),
+                    ),
+                ],
+                10,
+            )],
+            vec![
+                Constant::Int(0),
+                Constant::Int(n),
+                Constant::Int(3),
+                Constant::Int(1),
+            ],
+        )
+    }
+
+    fn run(m: &CpsModule, mode: crate::execute::DispatchMode) -> (i64, Vec<String>) {
+        let mut vm = VM::new();
+        vm.dispatch = mode;
+        vm.load(m).unwrap();
+        let entry = m.functions.len() - 1;
+        let r = vm
+            .execute(entry, m.functions[entry].reg_count, None)
+            .unwrap();
+        (r, vm.take_output())
+    }
+
+    #[test]
+    fn lowering_is_one_slot_per_encoded_instruction() {
+        let m = counting_loop(10);
+        let mut vm = VM::new();
+        vm.load(&m).unwrap();
+        assert_eq!(vm.program.decoded(0).len(), vm.program.instrs.len());
+    }
+
+    #[test]
+    fn functions_are_lowered_on_first_execution() {
+        let mut m = counting_loop(10);
+        m.functions.push(named_func(
+            "unused",
+            vec![block(0, vec![], CpsTerminator::Return(0))],
+            1,
+        ));
+        let mut vm = VM::new();
+        vm.load(&m).unwrap();
+        assert!(!vm.program.is_materialized(0));
+        assert_eq!(vm.execute(0, 10, None).unwrap(), 4);
+        assert!(vm.program.is_materialized(0));
+        assert!(!vm.program.is_materialized(1));
+    }
+
+    #[test]
+    fn hot_pairs_are_fused() {
+        let m = counting_loop(10);
+        let mut vm = VM::new();
+        vm.load(&m).unwrap();
+        let ops: Vec<DOp> = vm.program.decoded(0).iter().map(|d| d.op).collect();
+        assert!(ops.contains(&DOp::LtIntBranch));
+        assert!(ops.contains(&DOp::ModIntEqIntImm));
+        assert!(ops.contains(&DOp::AddIntJump));
+        // 回边: 块 5 的 AddInt+Jump 跳回循环头
+        let back_edge = vm
+            .program
+            .decoded(0)
+            .iter()
+            .find(|d| d.op == DOp::AddIntJump && d.tb == 1)
+            .unwrap();
+        assert_eq!(back_edge.flags & BACK_T, BACK_T);
+    }
+
+    #[test]
+    fn adjacent_mod_eq_is_fused() {
+        let m = module(
+            vec![func(
+                vec![block(
+                    0,
+                    vec![
+                        CpsInstr::LoadConst(0, 0),
+                        CpsInstr::LoadConst(1, 1),
+                        CpsInstr::BinOp(2, CpsBinOp::ModInt, 0, 1),
+                        CpsInstr::BinOp(3, CpsBinOp::EqInt, 2, 1),
+                    ],
+                    CpsTerminator::Return(3),
+                )],
+                4,
+            )],
+            vec![Constant::Int(9), Constant::Int(4)],
+        );
+        let mut vm = VM::new();
+        vm.load(&m).unwrap();
+        assert!(vm
+            .program
+            .decoded(0)
+            .iter()
+            .any(|d| d.op == DOp::ModIntEqInt));
+        assert_eq!(vm.execute(0, 4, None).unwrap(), 0);
+    }
+
+    #[test]
+    fn string_constants_decode_to_pinned_handles() {
+        let m = module(
+            vec![func(
+                vec![
+                    block(
+                        0,
+                        vec![CpsInstr::LoadConst(0, 0)],
+                        CpsTerminator::Jump(1, vec![0]),
+                    ),
+                    block_with(
+                        1,
+                        vec![1],
+                        vec![CpsInstr::Print(1)],
+                        CpsTerminator::Return(1),
+                    ),
+                ],
+                2,
+            )],
+            vec![Constant::String("hi".into())],
+        );
+        let mut vm = VM::new();
+        vm.load(&m).unwrap();
+        assert_eq!(vm.program.decoded(0)[0].op, DOp::LoadImm64);
+        assert_eq!(vm.program.decoded(0)[0].imm64(), vm.program.const_bits[0]);
+        assert!(vm.heap.is_immortal(vm.program.const_bits[0] as usize));
+        assert_eq!(vm.program.decoded(0)[1].op, DOp::Jump);
+        assert_eq!(vm.program.decoded(0)[1].flags & MOVES_T, MOVES_T);
+        vm.execute(0, 2, None).unwrap();
+        assert_eq!(vm.take_output(), vec!["hi".to_string()]);
+    }
+
+    #[test]
+    fn decoded_matches_encoded_reference() {
+        use crate::execute::DispatchMode;
+        for n in [0, 1, 7, 300] {
+            let m = counting_loop(n);
+            assert_eq!(
+                run(&m, DispatchMode::Decoded),
+                run(&m, DispatchMode::Encoded),
+                "n={n}"
+            );
+        }
+        assert_eq!(run(&counting_loop(300), DispatchMode::Decoded).0, 100);
+    }
+
+    #[test]
+    fn decoded_loop_limit_matches_encoded() {
+        use crate::execute::{DispatchMode, RuntimeError};
+        for mode in [DispatchMode::Decoded, DispatchMode::Encoded] {
+            let m = counting_loop(1000);
+            let mut vm = VM::new();
+            vm.dispatch = mode;
+            vm.max_loop_iterations = 10;
+            vm.load(&m).unwrap();
+            let err = vm.execute(0, 10, None).unwrap_err();
+            assert!(
+                matches!(
+                    err,
+                    RuntimeError::LoopExceeded {
+                        block_id: 1,
+                        limit: 10
+                    }
+                ),
+                "{mode:?}: {err:?}"
+            );
+        }
+    }
+
+    #[test]
+    fn time_slices_resume_to_the_same_result() {
+        use crate::execute::{Completion, DispatchMode, RuntimeError};
+        for mode in [DispatchMode::Decoded, DispatchMode::Encoded] {
+            for slice in [1, 7, 64] {
+                let mut vm = VM::new();
+                vm.dispatch = mode;
+                vm.time_slice = slice;
+                vm.load(&counting_loop(300)).unwrap();
+                let mut yields = 0;
+                let mut c = vm.start(0, None).unwrap();
+                while c == Completion::Yielded {
+                    yields += 1;
+                    c = vm.resume(None).unwrap();
+                }
+                assert_eq!(c, Completion::Done(100), "{mode:?} slice={slice}");
+                // 300 条回边，每片 `slice` 条，最后一片不让出
+                assert_eq!(yields, 299 / slice, "{mode:?} slice={slice}");
+                assert_eq!(vm.fuel_used(), 300);
+            }
+
+            // 总预算跨时间片计算
+            for (limit, ok) in [(300, true), (299, false)] {
+                let mut vm = VM::new();
+                vm.dispatch = mode;
+                vm.time_slice = 16;
+                vm.max_loop_iterations = limit;
+                vm.load(&counting_loop(300)).unwrap();
+                match vm.execute(0, 10, None) {
+                    Ok(r) => assert!(ok && r == 100, "{mode:?} limit={limit}"),
+                    Err(e) => assert!(
+                        !ok && matches!(e, RuntimeError::LoopExceeded { block_id: 1, .. }),
+                        "{mode:?} limit={limit}: {e:?}"
+                    ),
+                }
+            }
+        }
+    }
+}
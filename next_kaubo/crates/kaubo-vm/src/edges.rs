@@ -0,0 +1,177 @@
+//! 控制流边的寄存器移动表 — `LoadedProgram::new` 预先计算，执行时零分配
+//!
+//! 每条 Jump / Branch / TailCall 边把实参寄存器并行地写入目标块的参数寄存器。
+//! 加载时把这组并行移动拆成顺序复制（已按拓扑序排好，环用一个临时槽打断），
+//! 平铺存进 `LoadedProgram::edge_moves`；`edge_spans` 按 IP 与 `instrs` 一一对应，
+//! 记录该指令的移动在池中的区间。
+//!
+//! Call / CallIndirect / CallNative 复用同一张表：`src` 是调用方寄存器，
+//! `dst` 是实参序号（被调方寄存器 / native 参数下标）。
+
+use std::ops::Range;
+
+/// 顺序复制中的临时槽（打断移动环）。
+pub const SCRATCH: u32 = u32::MAX;
+
+/// 一次寄存器复制 `dst ← src`，任一端可以是 `SCRATCH`。
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub struct RegMove {
+    pub dst: u32,
+    pub src: u32,
+}
+
+/// 某条指令在 `edge_moves` 中的区间。
+///
+/// Branch 的 true 边在 `[start, start+len)`，false 边紧随其后 `alt_len` 条；
+/// 其余指令只用 `len`。
+#[derive(Debug, Clone, Copy, Default, PartialEq, Eq)]
+pub struct EdgeSpan {
+    pub start: u32,
+    pub len: u32,
+    pub alt_len: u32,
+}
+
+impl EdgeSpan {
+    #[inline(always)]
+    pub fn primary(&self) -> Range<usize> {
+        let start = self.start as usize;
+        start..start + self.len as usize
+    }
+
+    #[inline(always)]
+    pub fn alt(&self) -> Range<usize> {
+        let start = (self.start + self.len) as usize;
+        start..start + self.alt_len as usize
+    }
+}
+
+/// 把并行移动 `{dst_i ← src_i}` 拆成顺序复制追加到 `out`，返回追加条数。
+///
+/// 语义与逐条赋值前先读出全部源值一致：自移动被丢弃，重复的 `dst`
+/// 取最后一次；只读不写的寄存器可以被多个 `dst` 共享。
+pub fn push_parallel_moves(out: &mut Vec<RegMove>, pairs: &[(usize, usize)]) -> u32 {
+    let before = out.len();
+    let mut pending: Vec<RegMove> = Vec::with_capacity(pairs.len());
+    for &(dst, src) in pairs {
+        let (dst, src) = (dst as u32, src as u32);
+        pending.retain(|m| m.dst != dst);
+        if dst != src {
+            pending.push(RegMove { dst, src });
+        }
+    }
+
+    while !pending.is_empty() {
+        // 目标不再被任何待处理移动读取的，可以安全写入
+        let ready = (0..pending.len()).find(|&i| {
+            let dst = pending[i].dst;
+            !pending.iter().any(|m| m.src == dst)
+        });
+        match ready {
+            Some(i) => out.push(pending.remove(i)),
+            None => {
+                // 只剩纯环：先把一个目标寄存器的旧值存进临时槽
+                let victim = pending[0].dst;
+                out.push(RegMove {
+                    dst: SCRATCH,
+                    src: victim,
+                });
+                for m in pending.iter_mut().filter(|m| m.src == victim) {
+                    m.src = SCRATCH;
+                }
+            }
+        }
+    }
+    (out.len() - before) as u32
+}
+
+/// 把实参列表按序号写成 `dst = i` 的复制（调用边，跨帧无重叠）。
+pub fn push_arg_copies(out: &mut Vec<RegMove>, args: &[usize], limit: usize) -> u32 {
+    let before = out.len();
+    out.extend(
+        args.iter()
+            .enumerate()
+            .take(limit)
+            .map(|(i, &src)| RegMove {
+                dst: i as u32,
+                src: src as u32,
+            }),
+    );
+    (out.len() - before) as u32
+}
+
+/// 在一个寄存器窗口内按顺序执行移动表（`SCRATCH` 落在局部变量上）。
+#[inline(always)]
+pub fn apply(regs: &mut [u64], moves: &[RegMove]) {
+    let mut scratch = 0u64;
+    for m in moves {
+        let v = if m.src == SCRATCH {
+            scratch
+        } else {
+            regs[m.src as usize]
+        };
+        if m.dst == SCRATCH {
+            scratch = v;
+        } else {
+            regs[m.dst as usize] = v;
+        }
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn check(pairs: &[(usize, usize)]) {
+        let init: Vec<u64> = (0..8).map(|i| 100 + i).collect();
+        let mut expect = init.clone();
+        for &(d, s) in pairs {
+            expect[d] = init[s];
+        }
+        let mut moves = vec![];
+        push_parallel_moves(&mut moves, pairs);
+        let mut regs = init.clone();
+        apply(&mut regs, &moves);
+        assert_eq!(regs, expect, "{pairs:?} → {moves:?}");
+    }
+
+    #[test]
+    fn chains_are_ordered_topologically() {
+        check(&[(1, 0), (2, 1), (3, 2)]);
+        let mut moves = vec![];
+        push_parallel_moves(&mut moves, &[(1, 0), (2, 1)]);
+        assert_eq!(moves[0], RegMove { dst: 2, src: 1 });
+    }
+
+    #[test]
+    fn cycles_use_one_scratch_slot() {
+        check(&[(0, 1), (1, 0)]);
+        check(&[(0, 1), (1, 2), (2, 0)]);
+        check(&[(0, 1), (1, 0), (2, 3), (3, 2), (4, 0)]);
+        let mut moves = vec![];
+        push_parallel_moves(&mut moves, &[(0, 1), (1, 0)]);
+        assert_eq!(moves.len(), 3);
+    }
+
+    #[test]
+    fn self_moves_are_dropped() {
+        let mut moves = vec![];
+        assert_eq!(push_parallel_moves(&mut moves, &[(3, 3), (4, 4)]), 0);
+        check(&[(3, 3), (5, 3)]);
+    }
+
+    #[test]
+    fn fan_out_reads_before_overwrite() {
+        check(&[(1, 0), (2, 0), (0, 5)]);
+    }
+
+    #[test]
+    fn spans_split_branch_edges() {
+        let span = EdgeSpan {
+            start: 4,
+            len: 2,
+            alt_len: 3,
+        };
+        assert_eq!(span.primary(), 4..6);
+        assert_eq!(span.alt(), 6..9);
+    }
+}
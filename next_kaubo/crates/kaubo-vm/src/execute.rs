@@ -2,13 +2,23 @@
 //! 7-bit opcode, CPS block scheduler, 调用栈 + 闭包 + stdlib
 
 use crate::async_runtime::AsyncScheduler;
+use crate::decode::{DOp, DecodedInst, BACK_F, BACK_T, MOVES_F, MOVES_T};
+use crate::edges::{self, EdgeSpan, RegMove};
+use crate::fields::Fields;
 use crate::gc_heap::GcHeap;
+use crate::inline_cache::{self as ic, InlineCaches};
+#[cfg(feature = "jit")]
+use crate::jit::Entry;
+use crate::output::{CollectSink, OutputSink};
+use crate::profile::Profiler;
+use crate::program::LoadedProgram;
 use crate::regfile::*;
 use crate::stdlib;
 use kaubo_cps::*;
 use kaubo_log::emit;
 use kaubo_log::EventHandler;
-use std::collections::HashMap;
+use std::ops::Range;
+use std::sync::Arc;
 
 // ── 编码 ──
 pub fn encode(op: u8, dst: u32, src1: u32, src2: u32) -> u32 {
@@ -55,6 +65,12 @@ pub enum Opcode {
     FToS = 0x23,
     SToI = 0x24,
     BToS = 0x25,
+    // 数学 intrinsic（sqrt/sin/cos/floor/ceil，a ← f(b)）
+    FSqrt = 0x28,
+    FSin = 0x29,
+    FCos = 0x2A,
+    FFloor = 0x2B,
+    FCeil = 0x2C,
     // 数据移动
     Move = 0x30,
     LoadImm = 0x31,
@@ -100,10 +116,110 @@ pub enum Opcode {
     Print = 0x7F,
 }
 
+/// 操作码字段（7 位）→ `Opcode`，没有对应变体的值是 `None`。
+const OPCODES: [Option<Opcode>; 128] = {
+    let all = [
+        Opcode::AddInt,
+        Opcode::SubInt,
+        Opcode::MulInt,
+        Opcode::DivInt,
+        Opcode::ModInt,
+        Opcode::NegInt,
+        Opcode::FAdd,
+        Opcode::FSub,
+        Opcode::FMul,
+        Opcode::FDiv,
+        Opcode::FNeg,
+        Opcode::EqInt,
+        Opcode::LtInt,
+        Opcode::LeInt,
+        Opcode::FEq,
+        Opcode::FLt,
+        Opcode::Not,
+        Opcode::NeInt,
+        Opcode::GtInt,
+        Opcode::SAdd,
+        Opcode::GeInt,
+        Opcode::FNe,
+        Opcode::FLe,
+        Opcode::FGt,
+        Opcode::FGe,
+        Opcode::IToF,
+        Opcode::FToI,
+        Opcode::IToS,
+        Opcode::FToS,
+        Opcode::SToI,
+        Opcode::BToS,
+        Opcode::FSqrt,
+        Opcode::FSin,
+        Opcode::FCos,
+        Opcode::FFloor,
+        Opcode::FCeil,
+        Opcode::Move,
+        Opcode::LoadImm,
+        Opcode::LoadConst,
+        Opcode::ListLen,
+        Opcode::NewStruct,
+        Opcode::NewList,
+        Opcode::GetField,
+        Opcode::SetField,
+        Opcode::IndexGet,
+        Opcode::IndexSet,
+        Opcode::Box_,
+        Opcode::Unbox,
+        Opcode::NewVariant,
+        Opcode::GetVariantTag,
+        Opcode::GetVariantField,
+        Opcode::SetVariantField,
+        Opcode::Jump,
+        Opcode::Branch,
+        Opcode::Call,
+        Opcode::TailCall,
+        Opcode::Return,
+        Opcode::CallIndirect,
+        Opcode::LoadVtable,
+        Opcode::NewInterfaceObj,
+        Opcode::CallNative,
+        Opcode::NewTuple,
+        Opcode::TupleIndex,
+        Opcode::NewInt64Array,
+        Opcode::NewFloat64Array,
+        Opcode::AsyncPoll,
+        Opcode::Suspend,
+        Opcode::Print,
+    ];
+    let mut table = [None; 128];
+    let mut i = 0;
+    while i < all.len() {
+        table[all[i] as usize] = Some(all[i]);
+        i += 1;
+    }
+    table
+};
+
+impl TryFrom<u8> for Opcode {
+    type Error = u8;
+
+    /// 没有对应变体的操作码原样作为错误返回。
+    fn try_from(op: u8) -> Result<Self, u8> {
+        OPCODES.get(op as usize).copied().flatten().ok_or(op)
+    }
+}
+
 impl Opcode {
-    #[inline(always)]
-    pub fn from_inst(inst: u32) -> Self {
-        unsafe { std::mem::transmute(((inst >> 25) & 0x7F) as u8) }
+    /// 结束基本块的指令：执行后不落到下一条 IP。
+    pub fn is_terminator(self) -> bool {
+        matches!(
+            self,
+            Opcode::Jump
+                | Opcode::Branch
+                | Opcode::Call
+                | Opcode::TailCall
+                | Opcode::Return
+                | Opcode::CallIndirect
+                | Opcode::CallNative
+                | Opcode::Suspend
+        )
     }
 }
 
@@ -113,9 +229,10 @@ impl Opcode {
 pub struct Inst(pub u32);
 
 impl Inst {
+    /// 操作码字段；映像里可能有不对应任何变体的值，原样作为错误返回。
     #[inline(always)]
-    pub fn opcode(self) -> Opcode {
-        Opcode::from_inst(self.0)
+    pub fn opcode(self) -> Result<Opcode, u8> {
+        Opcode::try_from((self.0 >> 25) as u8)
     }
 
     #[inline(always)]
@@ -138,12 +255,32 @@ impl Inst {
         (self.0 & 0x1FF_FFFF) as usize
     }
 
-    /// 17-bit 立即数 (bits 0–16), 用于 Call/CallNative cont_block
+    /// 17-bit 立即数 (bits 0–16), 用于 LoadImm
     #[inline(always)]
     pub fn imm17(self) -> usize {
         (self.0 & 0x1FFFF) as usize
     }
 
+    /// `LoadConst` 的 17-bit 常量下标：低 9 位在 src1，高 8 位在 src2
+    /// （只用 src1 的旧编码读出来不变）
+    #[inline(always)]
+    pub fn const_idx(self) -> usize {
+        self.src1() | (self.src2() << 9)
+    }
+
+    /// 调用类指令的目标（函数号 / native 号 / 闭包寄存器）：dst 8 位 + src1 高 4 位
+    #[inline(always)]
+    pub fn call_target(self) -> usize {
+        self.dst() | ((self.src1() >> 5) << 8)
+    }
+
+    /// 调用类指令的续体块：src1 低 5 位 + src2，共 13 位
+    /// （续体块号小于 8192 时与旧的 17-bit 编码读出来相同）
+    #[inline(always)]
+    pub fn call_cont(self) -> usize {
+        ((self.src1() & 0x1F) << 8) | self.src2()
+    }
+
     #[inline(always)]
     pub fn abc(self) -> (usize, usize, usize) {
         (self.dst(), self.src1(), self.src2())
@@ -155,7 +292,10 @@ impl Inst {
 pub enum RuntimeError {
     DivisionByZero,
     IndexOutOfBounds(i64, usize),
-    FieldOutOfBounds { index: usize, len: usize },
+    FieldOutOfBounds {
+        index: usize,
+        len: usize,
+    },
     InvalidHeapHandle(i64),
     TypeMismatch(String),
     UnsupportedInstruction(String),
@@ -164,7 +304,16 @@ pub enum RuntimeError {
     NullAccess,
     TypeAssertion(String),
     StackOverflow,
-    LoopExceeded { block_id: usize, limit: u64 },
+    /// 燃料在回边处耗尽，`block_id` 是回边目标。
+    LoopExceeded {
+        block_id: usize,
+        limit: u64,
+    },
+    /// 燃料在调用 / 尾调用处耗尽，`func_idx` 是被调函数。
+    CallLimitExceeded {
+        func_idx: usize,
+        limit: u64,
+    },
     Bug(String),
 }
 
@@ -172,10 +321,20 @@ pub enum RuntimeError {
 #[derive(Debug, Clone)]
 pub enum HeapObj {
     String(String),
+    /// 追加缓冲 `buf`（一个 `StrBuf` 槽位）的前 `len` 字节，由 `SAdd` 产生。
+    StrSlice {
+        buf: usize,
+        len: usize,
+    },
+    /// 只增不减的追加缓冲，只被 `StrSlice` 引用，本身不是语言层的值。
+    StrBuf(String),
     List(Vec<i64>),
-    Struct(usize, Vec<i64>),       // (struct_id, field_values)
-    Variant(usize, u16, Vec<i64>), // (enum_id, tag, field_values)
-    InterfaceObj { vtable_idx: usize, data: i64 },
+    Struct(usize, Fields),       // (struct_id, field_values)
+    Variant(usize, u16, Fields), // (enum_id, tag, field_values)
+    InterfaceObj {
+        vtable_idx: usize,
+        data: i64,
+    },
     Closure(Box<ClosureObj>),
     TupleObj(Vec<usize>),
     Int64Array(Vec<i64>),
@@ -190,50 +349,121 @@ pub struct ClosureObj {
 
 // ── VM ──
 
+/// `VM::execute` 的分发方式。
+#[derive(Debug, Clone, Copy, PartialEq, Eq, Default)]
+pub enum DispatchMode {
+    /// 预解码指令流 + 超级指令（默认）。
+    #[default]
+    Decoded,
+    /// 逐条解码打包 `u32` 的原始循环，作为参考实现保留。
+    Encoded,
+}
+
+/// `VM::step` 的执行结果。
+enum Flow {
+    Next,
+    Return(i64),
+    /// 时间片用完，`ip` 已指向下一条指令。
+    Yield,
+}
+
+/// `VM::start` / `VM::resume` 的结果。
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum Completion {
+    /// 入口函数返回。
+    Done(i64),
+    /// 时间片用完；VM 保留全部状态，调用 `resume` 继续。
+    Yielded,
+}
+
+/// `run_decoded` 内层循环交回外层的原因。
+enum Exit {
+    /// 走了回边，`ip` 已指向目标；外层先扣燃料再继续。
+    Back(usize),
+    /// `ip - 1` 处的指令没有预解码形式，交给 `step`。
+    Slow,
+}
+
+/// 预解码 Branch 的出边：执行边移动，返回目标 IP 与（回边时的）目标块。
+///
+/// `span` 是 Branch 本身的边区间（融合指令里 Branch 是第二个 slot）。
+#[inline(always)]
+fn take_edge(
+    r: &mut [u64],
+    d: &DecodedInst,
+    taken: bool,
+    span: &EdgeSpan,
+    pool: &[RegMove],
+) -> (usize, Option<usize>) {
+    let (target, block, back, moves) = if taken {
+        (d.t, d.tb, BACK_T, MOVES_T)
+    } else {
+        (d.f, d.fb, BACK_F, MOVES_F)
+    };
+    if d.flags & moves != 0 {
+        edges::apply(r, &pool[if taken { span.primary() } else { span.alt() }]);
+    }
+    let back = (d.flags & back != 0).then_some(block as usize);
+    (target as usize, back)
+}
+
 pub struct VM {
     pub regs: RegFile,
     pub frames: Vec<CallFrame>,
-    pub consts: Vec<Constant>,
-    // Per-function data
-    pub func_blocks: Vec<Vec<(usize, usize)>>,
-    pub func_params: Vec<Vec<Vec<usize>>>,
-    pub jump_args: Vec<Vec<usize>>, // flat global jump_args by absolute IP
-    pub func_entries: Vec<usize>,
-    pub func_reg_counts: Vec<usize>,
-    pub func_instr_base: Vec<usize>, // start IP in flat instrs array
-    pub block_starts: Vec<usize>,    // flat: block_id → start IP (per func)
-    pub func_block_base: Vec<usize>, // offset into block_starts per function
+    /// 只读的程序映像，可以被多个 VM 共享（见 `program`）。
+    pub program: Arc<LoadedProgram>,
     pub current_func: usize,
-    pub instrs: Vec<u32>,
-    pub output: Vec<String>,
-
-    /// Maximum allowed loop iterations per (func_idx, block_id) before
-    /// raising `LoopExceeded`.  Default: `u64::MAX` (no practical limit).
-    /// Set lower via `--max-loop-iterations` for playground / sandbox use.
+    pub dispatch: DispatchMode,
+    /// `print` 的输出端，默认收集到内存（见 `output`）。
+    pub sink: Box<dyn OutputSink>,
+
+    /// 一次执行的总燃料：回边、调用和尾调用各消耗一单位。在回边处耗尽报
+    /// `LoopExceeded`，在调用处耗尽报 `CallLimitExceeded`。默认 `u64::MAX`
+    /// （不限制）；playground / 沙箱经 `--max-loop-iterations` 调低，所以这个
+    /// 选项限制的是回边与调用的总次数，而不只是循环次数。
     pub max_loop_iterations: u64,
-    /// Per-block loop iteration counters.  Key: `(func_idx, block_id)`.
-    /// Cleared on every `load()` call for execution isolation.
-    loop_iter_counts: HashMap<(usize, usize), u64>,
+    /// 每个时间片的燃料。一片用完而总预算还有剩余时，`start` / `resume`
+    /// 返回 `Completion::Yielded`，宿主可以先跑别的脚本再续跑。默认 `u64::MAX`（不切片）。
+    pub time_slice: u64,
+    /// 当前时间片剩余的燃料。
+    fuel: u64,
+    /// 总预算中尚未发给时间片的部分。
+    fuel_reserve: u64,
+    /// 让出时下一条要执行的 IP，`resume` 从这里继续。
+    resume_ip: Option<usize>,
+    /// 调用栈上限（寄存器窗口 + 帧记录的总字节数），超出时 `StackOverflow`。
+    /// 默认 `DEFAULT_MAX_STACK_BYTES`。
+    pub max_stack_bytes: usize,
 
     pub heap: super::gc_heap::GcHeap,
-    pub struct_bitmaps: Vec<u64>,
-    pub struct_field_counts: Vec<usize>,
-    pub enum_variant_bitmaps: Vec<Vec<u64>>,
-    pub enum_variant_counts: Vec<Vec<usize>>,
-    pub vtables: Vec<VtableDef>,
     pub natives: Vec<(&'static str, stdlib::NativeFn)>,
     pub scheduler: AsyncScheduler,
+    /// `CallIndirect` 各调用点的内联缓存（见 `inline_cache`）。
+    pub ic: InlineCaches,
+    /// 采样 profiler，默认不挂（见 `profile`）。挂上后基线 JIT 不再分层。
+    pub profiler: Option<Box<Profiler>>,
+    /// 基线 JIT 的热度计数与机器码（见 `jit`）。
+    #[cfg(feature = "jit")]
+    pub jit: crate::jit::Baseline,
 }
 
+/// 调用帧：返回地址 + 调用方在寄存器栈上的窗口。
 #[derive(Debug, Clone)]
 pub struct CallFrame {
     pub func_idx: usize,
     pub ret_block: usize,
-    pub saved_regs: Vec<u64>,
+    /// 调用方窗口起点（`RegFile::base`）。
+    pub base: usize,
+    /// 调用方窗口长度。
+    pub len: usize,
     pub result_reg: usize,
 }
 
-const MAX_CALL_DEPTH: usize = 1024;
+/// 新建 / 重置后栈底窗口的寄存器数。
+const INITIAL_REGS: usize = 512;
+
+/// `VM::max_stack_bytes` 的默认值：8 MiB。
+pub const DEFAULT_MAX_STACK_BYTES: usize = 8 << 20;
 
 impl Default for VM {
     fn default() -> Self {
@@ -244,216 +474,363 @@ impl Default for VM {
 impl VM {
     pub fn new() -> Self {
         VM {
-            regs: RegFile::new(512),
+            regs: RegFile::new(INITIAL_REGS),
             frames: vec![],
-            consts: vec![],
-            func_blocks: vec![],
-            func_params: vec![],
-            func_entries: vec![],
-            func_reg_counts: vec![],
-            func_instr_base: vec![],
+            program: Arc::new(LoadedProgram::empty()),
             current_func: 0,
-            block_starts: vec![],
-            func_block_base: vec![],
-            jump_args: vec![],
-            instrs: vec![],
-            output: vec![],
+            dispatch: DispatchMode::default(),
+            sink: Box::new(CollectSink::new()),
             max_loop_iterations: u64::MAX,
-            loop_iter_counts: HashMap::new(),
+            time_slice: u64::MAX,
+            fuel: 0,
+            fuel_reserve: 0,
+            resume_ip: None,
+            max_stack_bytes: DEFAULT_MAX_STACK_BYTES,
             heap: GcHeap::new(),
-            struct_bitmaps: vec![],
-            struct_field_counts: vec![],
-            enum_variant_bitmaps: vec![],
-            enum_variant_counts: vec![],
-            vtables: vec![],
             natives: stdlib::register_all(),
             scheduler: AsyncScheduler::new(),
+            ic: InlineCaches::new(),
+            profiler: None,
+            #[cfg(feature = "jit")]
+            jit: crate::jit::Baseline::new(),
         }
     }
 
+    /// 共享 `program` 的新隔离区。
+    pub fn with_program(program: Arc<LoadedProgram>) -> Self {
+        let mut vm = VM::new();
+        vm.attach(program);
+        vm
+    }
+
+    /// 加载 `module`：构建一份只供本 VM 使用的程序映像并切换过去。
     pub fn load(&mut self, module: &CpsModule) -> Result<(), String> {
-        self.consts = module.constants.clone();
-        self.instrs.clear();
-        self.func_blocks.clear();
-        self.func_params.clear();
-        self.func_entries.clear();
-        self.func_reg_counts.clear();
-        self.func_instr_base.clear();
-        self.block_starts.clear();
-        self.func_block_base.clear();
-        self.jump_args.clear();
-        self.struct_bitmaps.clear();
-        self.struct_field_counts.clear();
-        self.loop_iter_counts.clear();
-
-        for sd in &module.structs {
-            let id = sd.id;
-            if id >= self.struct_bitmaps.len() {
-                self.struct_bitmaps.resize(id + 1, 0);
-                self.struct_field_counts.resize(id + 1, 0);
-            }
-            self.struct_bitmaps[id] = sd.type_bitmap;
-            self.struct_field_counts[id] = sd.fields.len();
-        }
+        self.attach(Arc::new(LoadedProgram::new(module)?));
+        Ok(())
+    }
 
-        for ed in &module.enums {
-            let id = ed.id;
-            if id >= self.enum_variant_counts.len() {
-                self.enum_variant_counts.resize(id + 1, vec![]);
-                self.enum_variant_bitmaps.resize(id + 1, vec![]);
-            }
-            let counts: Vec<usize> = ed.variants.iter().map(|(_, _, f)| f.len()).collect();
-            let bitmaps: Vec<u64> = ed.variant_type_bitmaps.clone();
-            self.enum_variant_counts[id] = counts;
-            self.enum_variant_bitmaps[id] = bitmaps;
-        }
+    /// 切换到 `program`（不复制），并清空执行期状态。
+    pub fn attach(&mut self, program: Arc<LoadedProgram>) {
+        self.program = program;
+        self.reset();
+    }
 
-        self.vtables = module.vtables.clone();
-
-        for func in &module.functions {
-            let base_ip = self.instrs.len();
-            let max_id = func
-                .blocks
-                .iter()
-                .filter(|b| b.id != usize::MAX)
-                .map(|b| b.id)
-                .max()
-                .unwrap_or(0)
-                + 1;
-            let mut blocks = vec![(0, 0); max_id];
-            let mut params = vec![vec![]; max_id];
-
-            for block in &func.blocks {
-                if block.id == usize::MAX {
-                    continue;
-                }
-                let start = self.instrs.len();
-                for instr in &block.instrs {
-                    self.instrs.push(encode_instr(instr)?);
-                    self.jump_args.push(vec![]); // placeholder for instruction
-                }
-                let args = match &block.term {
-                    CpsTerminator::Jump(_, a) => a.clone(),
-                    CpsTerminator::Branch(_, _, ta, _, fa) => {
-                        // Store both arg sets: [true_count, true_args..., false_count, false_args...]
-                        let mut v = vec![ta.len()];
-                        v.extend_from_slice(ta);
-                        v.push(fa.len());
-                        v.extend_from_slice(fa);
-                        v
-                    }
-                    CpsTerminator::Call(_, a, _) => a.clone(),
-                    CpsTerminator::CallNative(_, a, _) => a.clone(),
-                    CpsTerminator::CallIndirect(_, a, _) => a.clone(),
-                    _ => vec![],
-                };
-                self.jump_args.push(args); // args for terminator
-                self.instrs.push(encode_term(&block.term)?);
-                blocks[block.id] = (start, self.instrs.len() - start);
-                params[block.id] = block.params.clone();
-            }
-            let entry_ip = blocks[func.entry].0;
-            // Build flat block_starts before moving blocks
-            self.func_block_base.push(self.block_starts.len());
-            for b in &blocks {
-                self.block_starts.push(b.0);
-            }
-            self.func_blocks.push(blocks);
-            self.func_params.push(params);
-            self.func_entries.push(entry_ip);
-            self.func_reg_counts.push(func.reg_count);
-            self.func_instr_base.push(base_ip);
-        }
-        Ok(())
+    /// 取走输出端保存在内存里的行（`CollectSink` / `RingSink`）。
+    pub fn take_output(&mut self) -> Vec<String> {
+        self.sink.take_lines()
+    }
+
+    /// 清空执行期状态（寄存器、调用帧、堆、调度器、内存里的输出），程序与配置保持不变。
+    ///
+    /// 池化的 VM 在两次请求之间调用，之后就可以再 `execute` 同一个程序。
+    pub fn reset(&mut self) {
+        self.regs.clear(INITIAL_REGS);
+        self.frames.clear();
+        self.current_func = 0;
+        self.sink.clear();
+        self.fuel = 0;
+        self.fuel_reserve = 0;
+        self.resume_ip = None;
+        self.heap.reset();
+        self.program.intern_strings(&mut self.heap);
+        self.scheduler = AsyncScheduler::new();
+        self.ic.reset(self.program.ic_site_count);
+        #[cfg(feature = "jit")]
+        self.jit.reset(self.program.func_count());
     }
 
     fn block_ip(&self, block_id: usize) -> usize {
-        self.block_starts[self.func_block_base[self.current_func] + block_id]
+        self.program.block_starts[self.program.func_block_base[self.current_func] + block_id]
     }
 
+    /// 按 IP 所在区间找块：块 id 不保证随布局递增（内联、预头块都会追加新 id）。
     fn block_id_from_ip(&self, ip: usize) -> usize {
-        let base = self.func_block_base[self.current_func];
-        let func_blocks = &self.func_blocks[self.current_func];
-        let starts = &self.block_starts[base..base + func_blocks.len()];
-        for id in (0..starts.len()).rev() {
-            // Skip inlined blocks (start=0) — entry block always has non-zero start
-            if starts[id] > 0 && starts[id] <= ip {
-                return id;
-            }
+        let func_blocks = &self.program.func_blocks[self.current_func];
+        // 未发射的块是 (0, 0)，区间为空，自然跳过
+        func_blocks
+            .iter()
+            .position(|&(start, len)| start <= ip && ip < start + len)
+            .unwrap_or(0)
+    }
+
+    /// 在寄存器栈上为被调方开窗口并压入调用帧，返回调用方窗口起点。
+    ///
+    /// 栈总字节数（寄存器 + 帧记录）超过 `max_stack_bytes` 时报 `StackOverflow`。
+    fn push_frame(&mut self, callee_regs: usize, ret_block: usize) -> Result<usize, RuntimeError> {
+        let regs = self.regs.stack.len() + callee_regs;
+        let bytes = regs * std::mem::size_of::<u64>()
+            + (self.frames.len() + 1) * std::mem::size_of::<CallFrame>();
+        if bytes > self.max_stack_bytes {
+            return Err(RuntimeError::StackOverflow);
         }
-        0
+        let caller_base = self.regs.base;
+        let (base, len) = self.regs.push_window(callee_regs);
+        self.frames.push(CallFrame {
+            func_idx: self.current_func,
+            ret_block,
+            base,
+            len,
+            result_reg: 0,
+        });
+        Ok(caller_base)
     }
 
-    fn jump_args(&self, abs_ip: usize) -> &[usize] {
-        &self.jump_args[abs_ip]
+    /// 在当前窗口内执行一段边移动。
+    #[inline(always)]
+    fn apply_moves(&mut self, range: Range<usize>) {
+        edges::apply(self.regs.window_mut(), &self.program.edge_moves[range]);
     }
 
-    fn bind_params(&mut self, block_id: usize, args: &[usize]) {
-        let params = &self.func_params[self.current_func][block_id];
-        if params.is_empty() && args.is_empty() {
-            return;
-        }
-        for (i, &arg_reg) in args.iter().enumerate() {
-            if i < params.len() {
-                self.regs.regs[params[i]] = self.regs.regs[arg_reg];
-            }
+    /// 从总预算里发一片燃料。
+    fn refuel(&mut self) {
+        let grant = self.time_slice.max(1).min(self.fuel_reserve);
+        self.fuel_reserve -= grant;
+        self.fuel = grant;
+    }
+
+    /// 回边处扣一单位燃料（挂了 profiler 时顺便记账），返回是否应当让出。
+    ///
+    /// 总预算耗尽时报 `LoopExceeded`，`block_id` 是回边目标。
+    #[inline(always)]
+    fn burn_fuel(
+        &mut self,
+        block_id: usize,
+        events: Option<&dyn EventHandler>,
+    ) -> Result<bool, RuntimeError> {
+        if let Some(p) = self.profiler.as_deref_mut() {
+            p.on_back_edge(self.current_func, block_id, &self.frames);
         }
+        self.spend_fuel(block_id, false, events)
     }
 
-    /// Check and update the loop iteration counter for a backward jump.
+    /// 调用 / 尾调用进入 `current_func` 后扣燃料，返回是否应当让出。
     ///
-    /// Returns `Err(LoopExceeded)` if the per-block iteration count exceeds
-    /// `max_loop_iterations`.  Emits `LoopIteration` and `LoopNearLimit` events.
-    fn check_loop_iteration(
+    /// 总预算耗尽时报 `CallLimitExceeded`；事件里的 `block_id` 是续体块。
+    #[inline(always)]
+    fn burn_call_fuel(
+        &mut self,
+        cont_block: usize,
+        events: Option<&dyn EventHandler>,
+    ) -> Result<bool, RuntimeError> {
+        if let Some(p) = self.profiler.as_deref_mut() {
+            p.on_call(self.current_func, &self.frames);
+        }
+        self.spend_fuel(cont_block, true, events)
+    }
+
+    #[inline(always)]
+    fn spend_fuel(
         &mut self,
         block_id: usize,
+        call: bool,
         events: Option<&dyn EventHandler>,
-    ) -> Result<(), RuntimeError> {
-        let key = (self.current_func, block_id);
-        let count = self.loop_iter_counts.entry(key).or_insert(0);
-        *count += 1;
+    ) -> Result<bool, RuntimeError> {
+        if self.heap.should_collect() {
+            self.collect_garbage(events);
+        }
+        if self.fuel == 0 {
+            return self.next_slice(block_id, call);
+        }
+        self.fuel -= 1;
 
         emit!(
             events,
             kaubo_log::ToolchainEvent::Vm(kaubo_log::VmEvent::LoopIteration {
                 func_idx: self.current_func,
-                block_id: block_id,
-                count: *count,
+                block_id,
+                count: self.fuel_used(),
             })
         );
-
-        if *count > self.max_loop_iterations {
-            return Err(RuntimeError::LoopExceeded {
-                block_id,
-                limit: self.max_loop_iterations,
-            });
-        }
-
-        if *count >= self.max_loop_iterations.saturating_mul(8) / 10 {
+        if events.is_some() && self.fuel_used() >= self.max_loop_iterations.saturating_mul(8) / 10 {
             emit!(
                 events,
                 kaubo_log::ToolchainEvent::Vm(kaubo_log::VmEvent::LoopNearLimit {
                     func_idx: self.current_func,
-                    block_id: block_id,
-                    count: *count,
+                    block_id,
+                    count: self.fuel_used(),
                     limit: self.max_loop_iterations,
                 })
             );
         }
 
-        Ok(())
+        Ok(false)
+    }
+
+    /// 基线层入口：`ip` 是当前函数某个块的起点（`entry` 说明由什么进入）。
+    ///
+    /// 计一次热度；函数已编译或刚到阈值时在机器码里接着执行，`ip` 更新为
+    /// 退回解释器的位置，返回是否应当让出。
+    #[cfg(feature = "jit")]
+    #[inline(always)]
+    fn tier_up(
+        &mut self,
+        entry: Entry,
+        ip: &mut usize,
+        events: Option<&dyn EventHandler>,
+    ) -> Result<bool, RuntimeError> {
+        if events.is_some()
+            || self.profiler.is_some()
+            || self.dispatch != DispatchMode::Decoded
+            || !self.jit.heat(self.current_func, entry)
+        {
+            return Ok(false);
+        }
+        self.run_baseline(entry, ip, events)
+    }
+
+    #[cfg(feature = "jit")]
+    #[inline(never)]
+    fn run_baseline(
+        &mut self,
+        entry: Entry,
+        ip: &mut usize,
+        events: Option<&dyn EventHandler>,
+    ) -> Result<bool, RuntimeError> {
+        let func = self.current_func;
+        if self.jit.needs_compile(func) {
+            let code = crate::jit::compile(self, func);
+            self.jit.install(func, code);
+        }
+        let mut block = match entry {
+            Entry::Call => match self.jit.code(func) {
+                Some(code) => code.entry_block,
+                None => return Ok(false),
+            },
+            Entry::Back(block) | Entry::Return(block) => block,
+        };
+        loop {
+            let Some(code) = self.jit.code(func) else {
+                return Ok(false);
+            };
+            let exit = code.run(self.regs.window_mut(), &mut self.fuel, block);
+            *ip = exit.ip;
+            // 回边燃料用完：照解释器的规矩换片 / 报错，还有燃料就回到机器码
+            let Some(target) = exit.back_edge else {
+                return Ok(false);
+            };
+            if self.burn_fuel(target, events)? {
+                return Ok(true);
+            }
+            block = target;
+        }
+    }
+
+    /// 标记清除一次，回收引用计数回收不了的环，返回回收的对象数。
+    ///
+    /// 根是寄存器栈上所有活动帧和挂起的异步任务；只能在安全点调用（刚分配的
+    /// 对象都已写进寄存器或字段）。`burn_fuel` 在分配达到阈值时自动调用。
+    #[cold]
+    pub fn collect_garbage(&mut self, events: Option<&dyn EventHandler>) -> usize {
+        let roots = self
+            .regs
+            .stack
+            .iter()
+            .copied()
+            .chain(self.scheduler.roots());
+        let freed = self.heap.collect(roots);
+        emit!(
+            events,
+            kaubo_log::ToolchainEvent::Vm(kaubo_log::VmEvent::GcCollected {
+                freed,
+                live: self.heap.stats().live_objects,
+            })
+        );
+        freed
+    }
+
+    /// 内联缓存未命中：按 vtable 槽位解析 `CallIndirect` 的目标并回填 `site`。
+    #[cold]
+    fn resolve_indirect(
+        &mut self,
+        site: usize,
+        vtable_idx: usize,
+        slot: usize,
+        events: Option<&dyn EventHandler>,
+    ) -> Result<ic::Target, RuntimeError> {
+        let vtable =
+            self.program.vtables.get(vtable_idx).ok_or_else(|| {
+                RuntimeError::Bug(format!("vtable index {vtable_idx} out of bounds"))
+            })?;
+        let &(_, func_idx) = vtable.methods.get(slot).ok_or_else(|| {
+            RuntimeError::Bug(format!(
+                "vtable slot {slot} out of bounds (vtable '{}' has {} methods)",
+                vtable.interface_name,
+                vtable.methods.len()
+            ))
+        })?;
+        let target = ic::Target {
+            func_idx: func_idx as u32,
+            func_entry: self.program.func_entries[func_idx] as u32,
+            regs: self.program.func_reg_counts[func_idx] as u32,
+        };
+        self.ic.fill(site, vtable_idx, target);
+        emit!(events, {
+            let state = self.ic.site(site).state();
+            kaubo_log::ToolchainEvent::Vm(kaubo_log::VmEvent::InlineCacheMiss {
+                func_idx: self.current_func,
+                site,
+                vtable_idx,
+                entries: state.entries(),
+                megamorphic: state == ic::IcState::Megamorphic,
+            })
+        });
+        Ok(target)
+    }
+
+    /// 改时间片大小，对下一次 `resume` 立即生效。
+    ///
+    /// 直接写 `time_slice` 要等到下一次让出才用上（让出时已按旧片发好了燃料）；
+    /// 宿主按次决定配额时调这个：已发未用的燃料退回总预算，再按新片重发。
+    pub fn set_time_slice(&mut self, fuel: u64) {
+        self.time_slice = fuel;
+        if self.resume_ip.is_some() {
+            self.fuel_reserve += self.fuel;
+            self.refuel();
+        }
+    }
+
+    /// 设基线 JIT 的分层阈值（见 `jit::Baseline::threshold`）；不带 JIT 的构建里什么也不做。
+    pub fn set_jit_threshold(&mut self, _threshold: u64) {
+        #[cfg(feature = "jit")]
+        {
+            self.jit.threshold = _threshold;
+        }
+    }
+
+    /// 本次执行已消耗的燃料。
+    pub fn fuel_used(&self) -> u64 {
+        self.max_loop_iterations - self.fuel_reserve - self.fuel
+    }
+
+    /// 当前时间片用完：预算还有剩余就换下一片（本次消耗记在新片上）并让出。
+    #[cold]
+    fn next_slice(&mut self, block_id: usize, call: bool) -> Result<bool, RuntimeError> {
+        let limit = self.max_loop_iterations;
+        if self.fuel_reserve == 0 {
+            return Err(if call {
+                RuntimeError::CallLimitExceeded {
+                    func_idx: self.current_func,
+                    limit,
+                }
+            } else {
+                RuntimeError::LoopExceeded { block_id, limit }
+            });
+        }
+        self.refuel();
+        self.fuel -= 1;
+        Ok(true)
     }
 
     fn write_int(&mut self, reg: usize, value: i64) {
-        self.regs.regs[reg] = value as u64;
+        self.regs[reg] = value as u64;
     }
 
     fn write_bool(&mut self, reg: usize, value: bool) {
-        self.regs.regs[reg] = if value { 1 } else { 0 };
+        self.regs[reg] = if value { 1 } else { 0 };
     }
 
     fn write_float(&mut self, reg: usize, value: f64) {
-        self.regs.regs[reg] = value.to_bits();
+        self.regs[reg] = value.to_bits();
     }
 
     fn write_heap(&mut self, reg: usize, obj: HeapObj) {
@@ -481,24 +858,282 @@ impl VM {
         Ok(self.heap.get_mut(id as usize))
     }
 
+    /// 执行到入口函数返回，中途的时间片让出会直接续跑。
     pub fn execute(
         &mut self,
         entry_func: usize,
         _reg_count: usize,
         events: Option<&dyn kaubo_log::EventHandler>,
     ) -> Result<i64, RuntimeError> {
+        let mut completion = self.start(entry_func, events)?;
+        loop {
+            match completion {
+                Completion::Done(value) => {
+                    if self.program.ic_site_count > 0 {
+                        emit!(events, {
+                            let stats = self.ic.stats();
+                            kaubo_log::ToolchainEvent::Vm(kaubo_log::VmEvent::InlineCacheStats {
+                                sites: stats.sites,
+                                hits: stats.hits,
+                                misses: stats.misses,
+                                megamorphic: stats.megamorphic,
+                            })
+                        });
+                    }
+                    return Ok(value);
+                }
+                Completion::Yielded => completion = self.resume(events)?,
+            }
+        }
+    }
+
+    /// 从入口函数开始执行一个时间片（燃料预算重新计起）。
+    pub fn start(
+        &mut self,
+        entry_func: usize,
+        events: Option<&dyn kaubo_log::EventHandler>,
+    ) -> Result<Completion, RuntimeError> {
         self.current_func = entry_func;
-        let reg_needed = self.func_reg_counts[entry_func];
-        self.regs.ensure_capacity(reg_needed);
-        if self.regs.regs.len() < reg_needed {
-            self.regs.regs.resize(reg_needed, 0);
+        let reg_needed = self.program.func_reg_counts[entry_func];
+        self.frames.clear();
+        self.regs.reset(reg_needed);
+        self.fuel_reserve = self.max_loop_iterations;
+        self.refuel();
+        self.resume_ip = None;
+        if let Some(p) = self.profiler.as_deref_mut() {
+            p.fit(&self.program);
         }
 
-        let mut ip = self.func_entries[entry_func];
+        let ip = self.program.func_entries[entry_func];
+        self.run_slice(ip, events)
+    }
+
+    /// 在上次 `Completion::Yielded` 处继续执行下一个时间片。
+    pub fn resume(
+        &mut self,
+        events: Option<&dyn kaubo_log::EventHandler>,
+    ) -> Result<Completion, RuntimeError> {
+        let ip = self
+            .resume_ip
+            .take()
+            .ok_or_else(|| RuntimeError::Bug("resume without a yielded execution".into()))?;
+        self.run_slice(ip, events)
+    }
 
+    fn run_slice(
+        &mut self,
+        ip: usize,
+        events: Option<&dyn kaubo_log::EventHandler>,
+    ) -> Result<Completion, RuntimeError> {
+        // opcode 直方图要逐条计数，预解码循环里的超级指令数不准
+        if self.profiler.as_ref().is_some_and(|p| p.wants_opcodes()) {
+            return self.run_encoded(ip, events);
+        }
+        match self.dispatch {
+            DispatchMode::Decoded => self.run_decoded(ip, events),
+            DispatchMode::Encoded => self.run_encoded(ip, events),
+        }
+    }
+
+    /// 预解码分发循环：热点指令与超级指令直接在这里执行，其余交给 `step`。
+    ///
+    /// 内层循环只借用当前寄存器窗口和只读的指令表，窗口在整段纯寄存器指令间
+    /// 保持不变；回边计数和 `DOp::Slow` 需要整个 `VM`，跳出到外层处理后再重新取窗口。
+    fn run_decoded(
+        &mut self,
+        mut ip: usize,
+        events: Option<&dyn kaubo_log::EventHandler>,
+    ) -> Result<Completion, RuntimeError> {
+        // 持有一份程序引用，内层循环不必经 `self` 取指令表
+        let program = Arc::clone(&self.program);
+        let instrs = &program.instrs[..];
+        let (spans, pool) = (&program.edge_spans[..], &program.edge_moves[..]);
         loop {
-            let inst = Inst(self.instrs[ip]);
+            // 调用、返回都走 step，回到这里时可能已换了函数；首次进入的函数在此物化
+            let code = program.decoded(self.current_func);
+            let base = program.func_instr_base[self.current_func];
+            let r = self.regs.window_mut();
+            let exit = loop {
+                let d = code[ip - base];
+                ip += 1;
+
+                emit!(
+                    events,
+                    kaubo_log::ToolchainEvent::Vm(kaubo_log::VmEvent::Instruction {
+                        func: self.current_func,
+                        ip: ip - 1,
+                        opcode: (instrs[ip - 1] >> 25) as u8,
+                        inst: instrs[ip - 1],
+                    })
+                );
+
+                let (a, b, c) = (d.a as usize, d.b as usize, d.c as usize);
+                match d.op {
+                    DOp::AddInt => r[a] = (r[b] as i64).wrapping_add(r[c] as i64) as u64,
+                    DOp::SubInt => r[a] = (r[b] as i64).wrapping_sub(r[c] as i64) as u64,
+                    DOp::MulInt => r[a] = (r[b] as i64).wrapping_mul(r[c] as i64) as u64,
+                    DOp::DivInt => {
+                        if r[c] == 0 {
+                            return Err(RuntimeError::DivisionByZero);
+                        }
+                        r[a] = (r[b] as i64).wrapping_div(r[c] as i64) as u64;
+                    }
+                    DOp::ModInt => {
+                        if r[c] == 0 {
+                            return Err(RuntimeError::DivisionByZero);
+                        }
+                        r[a] = (r[b] as i64).wrapping_rem(r[c] as i64) as u64;
+                    }
+                    DOp::NegInt => r[a] = (r[b] as i64).wrapping_neg() as u64,
+                    DOp::FAdd => r[a] = (f64::from_bits(r[b]) + f64::from_bits(r[c])).to_bits(),
+                    DOp::FSub => r[a] = (f64::from_bits(r[b]) - f64::from_bits(r[c])).to_bits(),
+                    DOp::FMul => r[a] = (f64::from_bits(r[b]) * f64::from_bits(r[c])).to_bits(),
+                    DOp::FDiv => r[a] = (f64::from_bits(r[b]) / f64::from_bits(r[c])).to_bits(),
+                    DOp::FNeg => r[a] = (-f64::from_bits(r[b])).to_bits(),
+                    DOp::FSqrt => r[a] = f64::from_bits(r[b]).sqrt().to_bits(),
+                    DOp::FSin => r[a] = f64::from_bits(r[b]).sin().to_bits(),
+                    DOp::FCos => r[a] = f64::from_bits(r[b]).cos().to_bits(),
+                    DOp::FFloor => r[a] = f64::from_bits(r[b]).floor().to_bits(),
+                    DOp::FCeil => r[a] = f64::from_bits(r[b]).ceil().to_bits(),
+                    DOp::EqInt => r[a] = ((r[b] as i64) == (r[c] as i64)) as u64,
+                    DOp::NeInt => r[a] = ((r[b] as i64) != (r[c] as i64)) as u64,
+                    DOp::LtInt => r[a] = ((r[b] as i64) < (r[c] as i64)) as u64,
+                    DOp::LeInt => r[a] = ((r[b] as i64) <= (r[c] as i64)) as u64,
+                    DOp::GtInt => r[a] = ((r[b] as i64) > (r[c] as i64)) as u64,
+                    DOp::GeInt => r[a] = ((r[b] as i64) >= (r[c] as i64)) as u64,
+                    DOp::FEq => r[a] = (f64::from_bits(r[b]) == f64::from_bits(r[c])) as u64,
+                    DOp::FNe => r[a] = (f64::from_bits(r[b]) != f64::from_bits(r[c])) as u64,
+                    DOp::FLt => r[a] = (f64::from_bits(r[b]) < f64::from_bits(r[c])) as u64,
+                    DOp::FLe => r[a] = (f64::from_bits(r[b]) <= f64::from_bits(r[c])) as u64,
+                    DOp::FGt => r[a] = (f64::from_bits(r[b]) > f64::from_bits(r[c])) as u64,
+                    DOp::FGe => r[a] = (f64::from_bits(r[b]) >= f64::from_bits(r[c])) as u64,
+                    DOp::Not => r[a] = (r[b] == 0) as u64,
+                    DOp::Move => r[a] = r[b],
+                    DOp::LoadImm64 => r[a] = d.imm64(),
+                    DOp::Jump => {
+                        if d.flags & MOVES_T != 0 {
+                            let span = spans[ip - 1];
+                            edges::apply(r, &pool[span.primary()]);
+                        }
+                        ip = d.t as usize;
+                        if d.flags & BACK_T != 0 {
+                            break Exit::Back(d.tb as usize);
+                        }
+                    }
+                    DOp::Branch => {
+                        let taken = r[a] as i64 != 0;
+                        let edge = &spans[ip - 1];
+                        let (target, back) = take_edge(r, &d, taken, edge, pool);
+                        ip = target;
+                        if let Some(block) = back {
+                            break Exit::Back(block);
+                        }
+                    }
+
+                    // ── 超级指令 ──
+                    DOp::LtIntBranch | DOp::LeIntBranch => {
+                        let (x, y) = (r[b] as i64, r[c] as i64);
+                        let taken = if d.op == DOp::LtIntBranch {
+                            x < y
+                        } else {
+                            x <= y
+                        };
+                        r[a] = taken as u64;
+                        let edge = &spans[ip];
+                        let (target, back) = take_edge(r, &d, taken, edge, pool);
+                        ip = target;
+                        if let Some(block) = back {
+                            break Exit::Back(block);
+                        }
+                    }
+                    DOp::ModIntEqInt => {
+                        if r[c] == 0 {
+                            return Err(RuntimeError::DivisionByZero);
+                        }
+                        r[a] = (r[b] as i64).wrapping_rem(r[c] as i64) as u64;
+                        r[d.t as usize] = (r[d.tb as usize] == r[d.fb as usize]) as u64;
+                        ip += 1;
+                    }
+                    DOp::ModIntEqIntImm => {
+                        if r[c] == 0 {
+                            return Err(RuntimeError::DivisionByZero);
+                        }
+                        let rem = (r[b] as i64).wrapping_rem(r[c] as i64) as u64;
+                        let imm = d.imm64();
+                        r[a] = rem;
+                        r[d.tb as usize] = imm;
+                        r[d.fb as usize] = (rem == imm) as u64;
+                        ip += 2;
+                    }
+                    DOp::AddIntJump => {
+                        r[a] = (r[b] as i64).wrapping_add(r[c] as i64) as u64;
+                        if d.flags & MOVES_T != 0 {
+                            let span = spans[ip];
+                            edges::apply(r, &pool[span.primary()]);
+                        }
+                        ip = d.t as usize;
+                        if d.flags & BACK_T != 0 {
+                            break Exit::Back(d.tb as usize);
+                        }
+                    }
+
+                    DOp::Slow => break Exit::Slow,
+                }
+            };
+
+            match exit {
+                Exit::Back(block) => {
+                    if self.burn_fuel(block, events)? {
+                        self.resume_ip = Some(ip);
+                        return Ok(Completion::Yielded);
+                    }
+                    #[cfg(feature = "jit")]
+                    if self.tier_up(Entry::Back(block), &mut ip, events)? {
+                        self.resume_ip = Some(ip);
+                        return Ok(Completion::Yielded);
+                    }
+                }
+                Exit::Slow => {
+                    let inst = Inst(instrs[ip - 1]);
+                    match self.step_slow(inst, &mut ip, events)? {
+                        Flow::Next => {}
+                        Flow::Return(value) => return Ok(Completion::Done(value)),
+                        Flow::Yield => {
+                            self.resume_ip = Some(ip);
+                            return Ok(Completion::Yielded);
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    /// `step` 的非内联入口，让冷路径不挤占预解码循环。
+    #[inline(never)]
+    fn step_slow(
+        &mut self,
+        inst: Inst,
+        ip: &mut usize,
+        events: Option<&dyn kaubo_log::EventHandler>,
+    ) -> Result<Flow, RuntimeError> {
+        self.step(inst, ip, events)
+    }
+
+    /// 参考解释器：每一步都重新解码打包的 `u32`。
+    fn run_encoded(
+        &mut self,
+        mut ip: usize,
+        events: Option<&dyn kaubo_log::EventHandler>,
+    ) -> Result<Completion, RuntimeError> {
+        let histogram = self.profiler.as_ref().is_some_and(|p| p.wants_opcodes());
+        loop {
+            let inst = Inst(self.program.instrs[ip]);
             ip += 1;
+            if histogram {
+                if let Some(p) = self.profiler.as_deref_mut() {
+                    p.on_instr(inst.0);
+                }
+            }
 
             emit!(
                 events,
@@ -510,1128 +1145,1114 @@ impl VM {
                 })
             );
 
-            let opcode = inst.opcode();
-            match opcode {
-                // ── 整数算术 ──
-                Opcode::AddInt => {
-                    let a = inst.dst();
-                    let b = inst.src1();
-                    let c = inst.src2();
-                    self.write_int(
-                        a,
-                        (self.regs.regs[b] as i64).wrapping_add(self.regs.regs[c] as i64),
-                    );
-                }
-                Opcode::SubInt => {
-                    let a = inst.dst();
-                    let b = inst.src1();
-                    let c = inst.src2();
-                    self.write_int(
-                        a,
-                        (self.regs.regs[b] as i64).wrapping_sub(self.regs.regs[c] as i64),
-                    );
-                }
-                Opcode::MulInt => {
-                    let a = inst.dst();
-                    let b = inst.src1();
-                    let c = inst.src2();
-                    self.write_int(
-                        a,
-                        (self.regs.regs[b] as i64).wrapping_mul(self.regs.regs[c] as i64),
-                    );
-                }
-                Opcode::DivInt => {
-                    let a = inst.dst();
-                    let b = inst.src1();
-                    let c = inst.src2();
-                    if self.regs.regs[c] == 0 {
-                        return Err(RuntimeError::DivisionByZero);
-                    }
-                    self.write_int(
-                        a,
-                        (self.regs.regs[b] as i64).wrapping_div(self.regs.regs[c] as i64),
-                    );
-                }
-                Opcode::ModInt => {
-                    let a = inst.dst();
-                    let b = inst.src1();
-                    let c = inst.src2();
-                    if self.regs.regs[c] == 0 {
-                        return Err(RuntimeError::DivisionByZero);
-                    }
-                    self.write_int(
-                        a,
-                        (self.regs.regs[b] as i64).wrapping_rem(self.regs.regs[c] as i64),
-                    );
-                }
-                Opcode::NegInt => {
-                    let a = inst.dst();
-                    let b = inst.src1();
-                    self.write_int(a, (self.regs.regs[b] as i64).wrapping_neg());
+            match self.step(inst, &mut ip, events)? {
+                Flow::Next => {}
+                Flow::Return(value) => return Ok(Completion::Done(value)),
+                Flow::Yield => {
+                    self.resume_ip = Some(ip);
+                    return Ok(Completion::Yielded);
                 }
+            }
+        }
+    }
 
-                // ── 浮点 ──
-                Opcode::FAdd => {
-                    let a = inst.dst();
-                    let b = inst.src1();
-                    let c = inst.src2();
-                    let fb = f64::from_bits(self.regs.regs[b]);
-                    let fc = f64::from_bits(self.regs.regs[c]);
-                    self.write_float(a, fb + fc);
-                }
-                Opcode::FSub => {
-                    let a = inst.dst();
-                    let b = inst.src1();
-                    let c = inst.src2();
-                    let fb = f64::from_bits(self.regs.regs[b]);
-                    let fc = f64::from_bits(self.regs.regs[c]);
-                    self.write_float(a, fb - fc);
-                }
-                Opcode::FMul => {
-                    let a = inst.dst();
-                    let b = inst.src1();
-                    let c = inst.src2();
-                    let fb = f64::from_bits(self.regs.regs[b]);
-                    let fc = f64::from_bits(self.regs.regs[c]);
-                    self.write_float(a, fb * fc);
-                }
-                Opcode::FDiv => {
-                    let a = inst.dst();
-                    let b = inst.src1();
-                    let c = inst.src2();
-                    let fb = f64::from_bits(self.regs.regs[b]);
-                    let fc = f64::from_bits(self.regs.regs[c]);
-                    self.write_float(a, fb / fc);
-                }
-                Opcode::FNeg => {
-                    let a = inst.dst();
-                    let b = inst.src1();
-                    let fb = f64::from_bits(self.regs.regs[b]);
-                    self.write_float(a, -fb);
-                }
+    /// 执行一条已编码指令。进入时 `ip` 已指向 `inst` 的下一条。
+    ///
+    /// 两种分发模式共用这一实现：`run_encoded` 对每条指令调用它，
+    /// `run_decoded` 只把没有预解码形式的指令（`DOp::Slow`）交给它。
+    #[inline(always)]
+    fn step(
+        &mut self,
+        inst: Inst,
+        ip: &mut usize,
+        events: Option<&dyn kaubo_log::EventHandler>,
+    ) -> Result<Flow, RuntimeError> {
+        let opcode = inst.opcode().map_err(RuntimeError::InvalidOpcode)?;
+        match opcode {
+            // ── 整数算术 ──
+            Opcode::AddInt => {
+                let a = inst.dst();
+                let b = inst.src1();
+                let c = inst.src2();
+                self.write_int(a, (self.regs[b] as i64).wrapping_add(self.regs[c] as i64));
+            }
+            Opcode::SubInt => {
+                let a = inst.dst();
+                let b = inst.src1();
+                let c = inst.src2();
+                self.write_int(a, (self.regs[b] as i64).wrapping_sub(self.regs[c] as i64));
+            }
+            Opcode::MulInt => {
+                let a = inst.dst();
+                let b = inst.src1();
+                let c = inst.src2();
+                self.write_int(a, (self.regs[b] as i64).wrapping_mul(self.regs[c] as i64));
+            }
+            Opcode::DivInt => {
+                let a = inst.dst();
+                let b = inst.src1();
+                let c = inst.src2();
+                if self.regs[c] == 0 {
+                    return Err(RuntimeError::DivisionByZero);
+                }
+                self.write_int(a, (self.regs[b] as i64).wrapping_div(self.regs[c] as i64));
+            }
+            Opcode::ModInt => {
+                let a = inst.dst();
+                let b = inst.src1();
+                let c = inst.src2();
+                if self.regs[c] == 0 {
+                    return Err(RuntimeError::DivisionByZero);
+                }
+                self.write_int(a, (self.regs[b] as i64).wrapping_rem(self.regs[c] as i64));
+            }
+            Opcode::NegInt => {
+                let a = inst.dst();
+                let b = inst.src1();
+                self.write_int(a, (self.regs[b] as i64).wrapping_neg());
+            }
 
-                // ── 比较 ──
-                Opcode::EqInt => {
-                    let a = inst.dst();
-                    let b = inst.src1();
-                    let c = inst.src2();
-                    self.write_bool(a, (self.regs.regs[b] as i64) == self.regs.regs[c] as i64);
-                }
-                Opcode::LtInt => {
-                    let a = inst.dst();
-                    let b = inst.src1();
-                    let c = inst.src2();
-                    self.write_bool(a, (self.regs.regs[b] as i64) < self.regs.regs[c] as i64);
-                }
-                Opcode::LeInt => {
-                    let a = inst.dst();
-                    let b = inst.src1();
-                    let c = inst.src2();
-                    self.write_bool(a, (self.regs.regs[b] as i64) <= self.regs.regs[c] as i64);
-                }
-                Opcode::FEq => {
-                    let a = inst.dst();
-                    let b = inst.src1();
-                    let c = inst.src2();
-                    self.write_bool(
-                        a,
-                        f64::from_bits(self.regs.regs[b]) == f64::from_bits(self.regs.regs[c]),
-                    );
-                }
-                Opcode::FLt => {
-                    let a = inst.dst();
-                    let b = inst.src1();
-                    let c = inst.src2();
-                    self.write_bool(
-                        a,
-                        f64::from_bits(self.regs.regs[b]) < f64::from_bits(self.regs.regs[c]),
-                    );
-                }
+            // ── 浮点 ──
+            Opcode::FAdd => {
+                let a = inst.dst();
+                let b = inst.src1();
+                let c = inst.src2();
+                let fb = f64::from_bits(self.regs[b]);
+                let fc = f64::from_bits(self.regs[c]);
+                self.write_float(a, fb + fc);
+            }
+            Opcode::FSub => {
+                let a = inst.dst();
+                let b = inst.src1();
+                let c = inst.src2();
+                let fb = f64::from_bits(self.regs[b]);
+                let fc = f64::from_bits(self.regs[c]);
+                self.write_float(a, fb - fc);
+            }
+            Opcode::FMul => {
+                let a = inst.dst();
+                let b = inst.src1();
+                let c = inst.src2();
+                let fb = f64::from_bits(self.regs[b]);
+                let fc = f64::from_bits(self.regs[c]);
+                self.write_float(a, fb * fc);
+            }
+            Opcode::FDiv => {
+                let a = inst.dst();
+                let b = inst.src1();
+                let c = inst.src2();
+                let fb = f64::from_bits(self.regs[b]);
+                let fc = f64::from_bits(self.regs[c]);
+                self.write_float(a, fb / fc);
+            }
+            Opcode::FNeg => {
+                let a = inst.dst();
+                let b = inst.src1();
+                let fb = f64::from_bits(self.regs[b]);
+                self.write_float(a, -fb);
+            }
+            Opcode::FSqrt | Opcode::FSin | Opcode::FCos | Opcode::FFloor | Opcode::FCeil => {
+                let fb = f64::from_bits(self.regs[inst.src1()]);
+                let v = match opcode {
+                    Opcode::FSqrt => fb.sqrt(),
+                    Opcode::FSin => fb.sin(),
+                    Opcode::FCos => fb.cos(),
+                    Opcode::FFloor => fb.floor(),
+                    _ => fb.ceil(),
+                };
+                self.write_float(inst.dst(), v);
+            }
 
-                // ── Not ──
-                Opcode::Not => {
-                    let a = inst.dst();
-                    let b = inst.src1();
-                    self.write_bool(a, self.regs.regs[b] == 0);
-                }
-                Opcode::NeInt => {
-                    let a = inst.dst();
-                    let b = inst.src1();
-                    let c = inst.src2();
-                    self.write_bool(a, self.regs.regs[b] as i64 != self.regs.regs[c] as i64);
-                }
+            // ── 比较 ──
+            Opcode::EqInt => {
+                let a = inst.dst();
+                let b = inst.src1();
+                let c = inst.src2();
+                self.write_bool(a, (self.regs[b] as i64) == self.regs[c] as i64);
+            }
+            Opcode::LtInt => {
+                let a = inst.dst();
+                let b = inst.src1();
+                let c = inst.src2();
+                self.write_bool(a, (self.regs[b] as i64) < self.regs[c] as i64);
+            }
+            Opcode::LeInt => {
+                let a = inst.dst();
+                let b = inst.src1();
+                let c = inst.src2();
+                self.write_bool(a, (self.regs[b] as i64) <= self.regs[c] as i64);
+            }
+            Opcode::FEq => {
+                let a = inst.dst();
+                let b = inst.src1();
+                let c = inst.src2();
+                self.write_bool(
+                    a,
+                    f64::from_bits(self.regs[b]) == f64::from_bits(self.regs[c]),
+                );
+            }
+            Opcode::FLt => {
+                let a = inst.dst();
+                let b = inst.src1();
+                let c = inst.src2();
+                self.write_bool(
+                    a,
+                    f64::from_bits(self.regs[b]) < f64::from_bits(self.regs[c]),
+                );
+            }
 
-                Opcode::GtInt => {
-                    let a = inst.dst();
-                    let b = inst.src1();
-                    let c = inst.src2();
-                    self.write_bool(a, (self.regs.regs[b] as i64) > self.regs.regs[c] as i64);
-                }
+            // ── Not ──
+            Opcode::Not => {
+                let a = inst.dst();
+                let b = inst.src1();
+                self.write_bool(a, self.regs[b] == 0);
+            }
+            Opcode::NeInt => {
+                let a = inst.dst();
+                let b = inst.src1();
+                let c = inst.src2();
+                self.write_bool(a, self.regs[b] as i64 != self.regs[c] as i64);
+            }
 
-                // ── 字符串拼接 ──
-                Opcode::SAdd => {
-                    let a = inst.dst();
-                    let b = inst.src1();
-                    let c = inst.src2();
-                    let lhs = self.heap_get(self.regs.regs[b] as i64)?.clone();
-                    let rhs = self.heap_get(self.regs.regs[c] as i64)?.clone();
-                    let result = match (lhs, rhs) {
-                        (HeapObj::String(l), HeapObj::String(r)) => HeapObj::String(l + &r),
-                        _ => {
-                            return Err(RuntimeError::TypeMismatch(
-                                "SAdd requires two string operands".into(),
-                            ))
-                        }
-                    };
-                    self.write_heap(a, result);
-                }
-                Opcode::GeInt => {
-                    let a = inst.dst();
-                    let b = inst.src1();
-                    let c = inst.src2();
-                    self.write_bool(a, self.regs.regs[b] as i64 >= self.regs.regs[c] as i64);
-                }
-                Opcode::FNe => {
-                    let a = inst.dst();
-                    let b = inst.src1();
-                    let c = inst.src2();
-                    self.write_bool(
-                        a,
-                        f64::from_bits(self.regs.regs[b]) != f64::from_bits(self.regs.regs[c]),
-                    );
-                }
-                Opcode::FLe => {
-                    let a = inst.dst();
-                    let b = inst.src1();
-                    let c = inst.src2();
-                    self.write_bool(
-                        a,
-                        f64::from_bits(self.regs.regs[b]) <= f64::from_bits(self.regs.regs[c]),
-                    );
-                }
-                Opcode::FGt => {
-                    let a = inst.dst();
-                    let b = inst.src1();
-                    let c = inst.src2();
-                    self.write_bool(
-                        a,
-                        f64::from_bits(self.regs.regs[b]) > f64::from_bits(self.regs.regs[c]),
-                    );
-                }
-                Opcode::FGe => {
-                    let a = inst.dst();
-                    let b = inst.src1();
-                    let c = inst.src2();
-                    self.write_bool(
-                        a,
-                        f64::from_bits(self.regs.regs[b]) >= f64::from_bits(self.regs.regs[c]),
-                    );
-                }
+            Opcode::GtInt => {
+                let a = inst.dst();
+                let b = inst.src1();
+                let c = inst.src2();
+                self.write_bool(a, (self.regs[b] as i64) > self.regs[c] as i64);
+            }
 
-                // ── 转换 ──
-                Opcode::IToF => {
-                    let d = inst.dst();
-                    let s = inst.src1();
-                    self.write_float(d, self.regs.regs[s] as i64 as f64);
-                }
-                Opcode::FToI => {
-                    let d = inst.dst();
-                    let s = inst.src1();
-                    let f = f64::from_bits(self.regs.regs[s]);
-                    self.write_int(d, f as i64);
-                }
-                Opcode::IToS => {
-                    // itos
-                    let d = inst.dst();
-                    let s = inst.src1();
-                    let st = format!("{}", self.regs.regs[s] as i64);
-                    self.write_heap(d, HeapObj::String(st));
-                }
-                Opcode::BToS => {
-                    // btos
-                    let d = inst.dst();
-                    let s = inst.src1();
-                    let st = if self.regs.regs[s] as i64 != 0 { "true" } else { "false" };
-                    self.write_heap(d, HeapObj::String(st.to_string()));
-                }
-                Opcode::FToS => {
-                    // ftos
-                    let d = inst.dst();
-                    let s = inst.src1();
-                    let st = format!("{}", f64::from_bits(self.regs.regs[s]));
-                    self.write_heap(d, HeapObj::String(st));
-                }
-                Opcode::SToI => {
-                    // stoi
-                    let d = inst.dst();
-                    let s = inst.src1();
-                    let hid = self.regs.regs[s] as i64;
-                    if hid < 0 {
+            // ── 字符串拼接 ──
+            Opcode::SAdd => {
+                let a = inst.dst();
+                let b = inst.src1();
+                let c = inst.src2();
+                let (lhs, rhs) = (self.regs[b] as i64, self.regs[c] as i64);
+                self.heap_get(lhs)?;
+                self.heap_get(rhs)?;
+                let hid = self
+                    .heap
+                    .concat(lhs as usize, rhs as usize)
+                    .ok_or_else(|| {
+                        RuntimeError::TypeMismatch("SAdd requires two string operands".into())
+                    })?;
+                self.write_int(a, hid as i64);
+            }
+            Opcode::GeInt => {
+                let a = inst.dst();
+                let b = inst.src1();
+                let c = inst.src2();
+                self.write_bool(a, self.regs[b] as i64 >= self.regs[c] as i64);
+            }
+            Opcode::FNe => {
+                let a = inst.dst();
+                let b = inst.src1();
+                let c = inst.src2();
+                self.write_bool(
+                    a,
+                    f64::from_bits(self.regs[b]) != f64::from_bits(self.regs[c]),
+                );
+            }
+            Opcode::FLe => {
+                let a = inst.dst();
+                let b = inst.src1();
+                let c = inst.src2();
+                self.write_bool(
+                    a,
+                    f64::from_bits(self.regs[b]) <= f64::from_bits(self.regs[c]),
+                );
+            }
+            Opcode::FGt => {
+                let a = inst.dst();
+                let b = inst.src1();
+                let c = inst.src2();
+                self.write_bool(
+                    a,
+                    f64::from_bits(self.regs[b]) > f64::from_bits(self.regs[c]),
+                );
+            }
+            Opcode::FGe => {
+                let a = inst.dst();
+                let b = inst.src1();
+                let c = inst.src2();
+                self.write_bool(
+                    a,
+                    f64::from_bits(self.regs[b]) >= f64::from_bits(self.regs[c]),
+                );
+            }
+
+            // ── 转换 ──
+            Opcode::IToF => {
+                let d = inst.dst();
+                let s = inst.src1();
+                self.write_float(d, self.regs[s] as i64 as f64);
+            }
+            Opcode::FToI => {
+                let d = inst.dst();
+                let s = inst.src1();
+                let f = f64::from_bits(self.regs[s]);
+                self.write_int(d, f as i64);
+            }
+            Opcode::IToS => {
+                // itos
+                let d = inst.dst();
+                let s = inst.src1();
+                let st = format!("{}", self.regs[s] as i64);
+                self.write_heap(d, HeapObj::String(st));
+            }
+            Opcode::BToS => {
+                // btos
+                let d = inst.dst();
+                let s = inst.src1();
+                let st = if self.regs[s] as i64 != 0 {
+                    "true"
+                } else {
+                    "false"
+                };
+                self.regs[d] = self.heap.intern(st) as u64;
+            }
+            Opcode::FToS => {
+                // ftos
+                let d = inst.dst();
+                let s = inst.src1();
+                let st = format!("{}", f64::from_bits(self.regs[s]));
+                self.write_heap(d, HeapObj::String(st));
+            }
+            Opcode::SToI => {
+                // stoi
+                let d = inst.dst();
+                let s = inst.src1();
+                let hid = self.regs[s] as i64;
+                if hid < 0 {
+                    return Err(RuntimeError::TypeMismatch(
+                        "SToI: expected string heap handle".into(),
+                    ));
+                }
+                match self.heap.get_str(hid as usize) {
+                    Some(st) => {
+                        let val: i64 = st.parse().map_err(|_| {
+                            RuntimeError::TypeMismatch(format!(
+                                "SToI: cannot parse '{st}' as integer"
+                            ))
+                        })?;
+                        self.write_int(d, val);
+                    }
+                    _ => {
                         return Err(RuntimeError::TypeMismatch(
-                            "SToI: expected string heap handle".into(),
+                            "SToI: expected string argument".into(),
                         ));
                     }
-                    match self.heap.try_get(hid as usize) {
-                        Some(HeapObj::String(st)) => {
-                            let val: i64 = st.parse().map_err(|_| {
-                                RuntimeError::TypeMismatch(format!(
-                                    "SToI: cannot parse '{st}' as integer"
-                                ))
-                            })?;
-                            self.write_int(d, val);
-                        }
-                        _ => {
-                            return Err(RuntimeError::TypeMismatch(
-                                "SToI: expected string argument".into(),
-                            ));
-                        }
-                    }
                 }
+            }
 
-                // ── 数据移动 ──
-                Opcode::Move => {
-                    let d = inst.dst();
-                    let s = inst.src1();
-                    self.regs.regs[d] = self.regs.regs[s];
-                }
-                Opcode::LoadImm => {
-                    let d = inst.dst();
-                    self.write_int(d, inst.imm17() as i64);
-                }
-                Opcode::LoadConst => {
-                    let d = inst.dst();
-                    let idx = inst.src1();
-                    let constant = self
-                        .consts
-                        .get(idx)
-                        .cloned()
-                        .ok_or_else(|| RuntimeError::Bug(format!("constant index {idx}")))?;
-                    match constant {
-                        Constant::Int(n) => self.write_int(d, n),
-                        Constant::Float(f) => self.write_float(d, f),
-                        Constant::String(s) => self.write_heap(d, HeapObj::String(s)),
-                        Constant::Bool(b) => self.write_bool(d, b),
-                        Constant::Null => self.write_int(d, 0),
-                    }
-                }
+            // ── 数据移动 ──
+            Opcode::Move => {
+                let d = inst.dst();
+                let s = inst.src1();
+                self.regs[d] = self.regs[s];
+            }
+            Opcode::LoadImm => {
+                let d = inst.dst();
+                self.write_int(d, inst.imm17() as i64);
+            }
+            Opcode::LoadConst => {
+                let d = inst.dst();
+                let idx = inst.const_idx();
+                self.regs[d] = *self
+                    .program
+                    .const_bits
+                    .get(idx)
+                    .ok_or_else(|| RuntimeError::Bug(format!("constant index {idx}")))?;
+            }
 
-                // ── 堆分配 ──
-                Opcode::NewStruct => {
-                    let d = inst.dst();
-                    let sid = inst.src1();
-                    let nf = self
-                        .struct_field_counts
-                        .get(sid)
-                        .copied()
-                        .ok_or_else(|| RuntimeError::Bug(format!("unknown struct id {sid}")))?;
-                    let bitmap = self.struct_bitmaps[sid];
-                    let mut fields = vec![0i64; nf];
-                    for (i, f) in fields.iter_mut().enumerate() {
-                        if (bitmap >> i) & 1 != 0 {
-                            *f = -1; // null sentinel for heap-type fields
-                        }
-                    }
-                    self.write_heap(d, HeapObj::Struct(sid, fields));
-                }
-                Opcode::NewList => {
-                    // NewList(dst, count, _) — element regs read from block params
-                    let d = inst.dst();
-                    let count = inst.src1();
-                    let block_id = self.block_id_from_ip(ip);
-                    let params = &self.func_params[self.current_func][block_id];
-                    let mut elements: Vec<i64> = Vec::with_capacity(count);
-                    for i in 0..count {
-                        let val: i64 = if i < params.len() {
-                            self.regs.regs[params[i]] as i64
-                        } else {
-                            0
-                        };
-                        elements.push(val);
-                    }
-                    self.write_heap(d, HeapObj::List(elements));
-                }
-                Opcode::NewTuple => {
-                    let d = inst.dst();
-                    let count = inst.src1();
-                    let block_id = self.block_id_from_ip(ip);
-                    let params = &self.func_params[self.current_func][block_id];
-                    let mut elements: Vec<usize> = Vec::with_capacity(count);
-                    for i in 0..count {
-                        let val = if i < params.len() {
-                            self.regs.regs[params[i]] as usize
-                        } else {
-                            0
-                        };
-                        elements.push(val);
-                    }
-                    let hid = self.heap.alloc(HeapObj::TupleObj(elements));
-                    self.regs.regs[d] = hid as u64;
-                }
-                Opcode::TupleIndex => {
-                    let d = inst.dst();
-                    let tuple_reg = inst.src1();
-                    let index = inst.src2();
-                    let hid = self.regs.regs[tuple_reg] as i64;
-                    let val = match self.heap_get(hid)? {
-                        HeapObj::TupleObj(elements) => elements[index],
-                        other => {
-                            return Err(RuntimeError::TypeMismatch(format!(
-                                "expected Tuple, got {other:?}"
-                            )))
-                        }
+            // ── 堆分配 ──
+            Opcode::NewStruct => {
+                let d = inst.dst();
+                let sid = inst.src1();
+                let nf = self
+                    .program
+                    .struct_field_counts
+                    .get(sid)
+                    .copied()
+                    .ok_or_else(|| RuntimeError::Bug(format!("unknown struct id {sid}")))?;
+                let bitmap = self.program.struct_bitmaps[sid];
+                // -1 is the null sentinel for heap-type fields
+                let fields = Fields::from_fn(nf, |i| -(((bitmap >> i) & 1) as i64));
+                self.write_heap(d, HeapObj::Struct(sid, fields));
+            }
+            Opcode::NewList => {
+                // NewList(dst, count, _) — element regs read from block params
+                let d = inst.dst();
+                let count = inst.src1();
+                let block_id = self.block_id_from_ip(*ip);
+                let params = self.program.block_params(self.current_func, block_id);
+                let mut elements: Vec<i64> = Vec::with_capacity(count);
+                for i in 0..count {
+                    let val: i64 = if i < params.len() {
+                        self.regs[params[i]] as i64
+                    } else {
+                        0
                     };
-                    self.regs.regs[d] = val as u64;
+                    elements.push(val);
                 }
-                Opcode::NewInt64Array => {
-                    let d = inst.dst();
-                    let count = inst.src1();
-                    let block_id = self.block_id_from_ip(ip);
-                    let params = &self.func_params[self.current_func][block_id];
-                    let mut elements: Vec<i64> = Vec::with_capacity(count);
-                    for i in 0..count {
-                        let val: i64 = if i < params.len() {
-                            self.regs.regs[params[i]] as i64
-                        } else {
-                            0
-                        };
-                        elements.push(val);
-                    }
-                    let hid = self.heap.alloc(HeapObj::Int64Array(elements));
-                    self.regs.regs[d] = hid as u64;
+                self.write_heap(d, HeapObj::List(elements));
+            }
+            Opcode::NewTuple => {
+                let d = inst.dst();
+                let count = inst.src1();
+                let block_id = self.block_id_from_ip(*ip);
+                let params = self.program.block_params(self.current_func, block_id);
+                let mut elements: Vec<usize> = Vec::with_capacity(count);
+                for i in 0..count {
+                    let val = if i < params.len() {
+                        self.regs[params[i]] as usize
+                    } else {
+                        0
+                    };
+                    elements.push(val);
                 }
-                Opcode::NewFloat64Array => {
-                    let d = inst.dst();
-                    let count = inst.src1();
-                    let block_id = self.block_id_from_ip(ip);
-                    let params = &self.func_params[self.current_func][block_id];
-                    let mut elements: Vec<f64> = Vec::with_capacity(count);
-                    for i in 0..count {
-                        let val: f64 = if i < params.len() {
-                            f64::from_bits(self.regs.regs[params[i]])
-                        } else {
-                            0.0
-                        };
-                        elements.push(val);
+                let hid = self.heap.alloc(HeapObj::TupleObj(elements));
+                self.regs[d] = hid as u64;
+            }
+            Opcode::TupleIndex => {
+                let d = inst.dst();
+                let tuple_reg = inst.src1();
+                let index = inst.src2();
+                let hid = self.regs[tuple_reg] as i64;
+                let val = match self.heap_get(hid)? {
+                    HeapObj::TupleObj(elements) => elements[index],
+                    other => {
+                        return Err(RuntimeError::TypeMismatch(format!(
+                            "expected Tuple, got {other:?}"
+                        )))
                     }
-                    let hid = self.heap.alloc(HeapObj::Float64Array(elements));
-                    self.regs.regs[d] = hid as u64;
+                };
+                self.regs[d] = val as u64;
+            }
+            Opcode::NewInt64Array => {
+                let d = inst.dst();
+                let count = inst.src1();
+                let block_id = self.block_id_from_ip(*ip);
+                let params = self.program.block_params(self.current_func, block_id);
+                let mut elements: Vec<i64> = Vec::with_capacity(count);
+                for i in 0..count {
+                    let val: i64 = if i < params.len() {
+                        self.regs[params[i]] as i64
+                    } else {
+                        0
+                    };
+                    elements.push(val);
                 }
-                Opcode::ListLen => {
-                    // ListLen(dst, obj) — return list length
-                    let d = inst.dst();
-                    let obj = inst.src1();
-                    let hid = self.regs.regs[obj] as i64;
-                    let len = match self.heap_get(hid)? {
-                        HeapObj::List(v) => v.len() as i64,
-                        HeapObj::Int64Array(v) => v.len() as i64,
-                        HeapObj::Float64Array(v) => v.len() as i64,
-                        other => {
-                            return Err(RuntimeError::TypeMismatch(format!(
-                                "ListLen: expected indexable, got {other:?}"
-                            )));
-                        }
+                let hid = self.heap.alloc(HeapObj::Int64Array(elements));
+                self.regs[d] = hid as u64;
+            }
+            Opcode::NewFloat64Array => {
+                let d = inst.dst();
+                let count = inst.src1();
+                let block_id = self.block_id_from_ip(*ip);
+                let params = self.program.block_params(self.current_func, block_id);
+                let mut elements: Vec<f64> = Vec::with_capacity(count);
+                for i in 0..count {
+                    let val: f64 = if i < params.len() {
+                        f64::from_bits(self.regs[params[i]])
+                    } else {
+                        0.0
                     };
-                    self.write_int(d, len);
+                    elements.push(val);
                 }
+                let hid = self.heap.alloc(HeapObj::Float64Array(elements));
+                self.regs[d] = hid as u64;
+            }
+            Opcode::ListLen => {
+                // ListLen(dst, obj) — return list length
+                let d = inst.dst();
+                let obj = inst.src1();
+                let hid = self.regs[obj] as i64;
+                let len = match self.heap_get(hid)? {
+                    HeapObj::List(v) => v.len() as i64,
+                    HeapObj::Int64Array(v) => v.len() as i64,
+                    HeapObj::Float64Array(v) => v.len() as i64,
+                    other => {
+                        return Err(RuntimeError::TypeMismatch(format!(
+                            "ListLen: expected indexable, got {other:?}"
+                        )));
+                    }
+                };
+                self.write_int(d, len);
+            }
 
-                // ── 字段访问 ──
-                Opcode::GetField => {
-                    // GetField(dst, src, idx)
-                    let d = inst.dst();
-                    let s = inst.src1();
-                    let idx = inst.src2();
-                    let hid = self.regs.regs[s] as i64;
-                    let val = match self.heap_get(hid)? {
-                        HeapObj::Struct(_, fields) => {
+            // ── 字段访问 ──
+            Opcode::GetField => {
+                // GetField(dst, src, idx)
+                let d = inst.dst();
+                let s = inst.src1();
+                let idx = inst.src2();
+                let hid = self.regs[s] as i64;
+                let val = match self.heap_get(hid)? {
+                    HeapObj::Struct(_, fields) => {
+                        fields
+                            .get(idx)
+                            .copied()
+                            .ok_or(RuntimeError::FieldOutOfBounds {
+                                index: idx,
+                                len: fields.len(),
+                            })?
+                    }
+                    other => {
+                        return Err(RuntimeError::TypeMismatch(format!(
+                            "GetField expected struct, got {other:?}"
+                        )))
+                    }
+                };
+                self.write_int(d, val);
+            }
+            Opcode::SetField => {
+                // SetField(dst, src, idx, val)
+                let d = inst.dst();
+                let s = inst.src1();
+                let idx = inst.src2();
+                let hid = self.regs[s] as i64;
+                let val = self.regs[d] as i64;
+
+                // Read struct_id and old field value
+                let (sid, old_val, len) = match self.heap_get(hid)? {
+                    HeapObj::Struct(sid, fields) => {
+                        let old_val =
                             fields
                                 .get(idx)
                                 .copied()
                                 .ok_or(RuntimeError::FieldOutOfBounds {
                                     index: idx,
                                     len: fields.len(),
-                                })?
-                        }
-                        other => {
-                            return Err(RuntimeError::TypeMismatch(format!(
-                                "GetField expected struct, got {other:?}"
-                            )))
-                        }
-                    };
-                    self.write_int(d, val);
-                }
-                Opcode::SetField => {
-                    // SetField(dst, src, idx, val)
-                    let d = inst.dst();
-                    let s = inst.src1();
-                    let idx = inst.src2();
-                    let hid = self.regs.regs[s] as i64;
-                    let val = self.regs.regs[d] as i64;
-
-                    // Read struct_id and old field value
-                    let (sid, old_val, len) =
-                        match self.heap_get(hid)? {
-                            HeapObj::Struct(sid, fields) => {
-                                let old_val = fields.get(idx).copied().ok_or(
-                                    RuntimeError::FieldOutOfBounds {
-                                        index: idx,
-                                        len: fields.len(),
-                                    },
-                                )?;
-                                (*sid, old_val, fields.len())
-                            }
-                            other => {
-                                return Err(RuntimeError::TypeMismatch(format!(
-                                    "SetField expected struct, got {other:?}"
-                                )))
-                            }
-                        };
-                    // Check if this field is a heap type
-                    let is_heap = (self.struct_bitmaps[sid] >> idx) & 1 != 0;
-
-                    // GC: release old value, retain new value (if heap type and not self-assign)
-                    if is_heap {
-                        // -1 is the null sentinel; self-assign of same handle is a no-op
-                        let self_assign = old_val == val && old_val != -1;
-                        if !self_assign && old_val != -1 {
-                            self.heap.release(old_val as usize);
-                        }
-                        // Write new value
-                        if let HeapObj::Struct(_, fields) = self.heap_get_mut(hid)? {
-                            if idx >= len {
-                                return Err(RuntimeError::FieldOutOfBounds { index: idx, len });
-                            }
-                            fields[idx] = val;
-                        }
-                        if !self_assign && val != -1 {
-                            self.heap.retain(val as usize);
-                        }
-                    } else {
-                        // Non-heap field: just write
-                        if let HeapObj::Struct(_, fields) = self.heap_get_mut(hid)? {
-                            if idx >= len {
-                                return Err(RuntimeError::FieldOutOfBounds { index: idx, len });
-                            }
-                            fields[idx] = val;
-                        }
+                                })?;
+                        (*sid, old_val, fields.len())
                     }
-                }
-
-                // ── 索引 ──
-                Opcode::IndexGet => {
-                    // IndexGet(dst, obj, idx)
-                    let d = inst.dst();
-                    let o = inst.src1();
-                    let i = inst.src2();
-                    let hid = self.regs.regs[o] as i64;
-                    let index = self.regs.regs[i] as i64 as usize;
-                    match self.heap_get(hid)? {
-                        HeapObj::List(v) => {
-                            let val = *v
-                                .get(index)
-                                .ok_or(RuntimeError::IndexOutOfBounds(index as i64, v.len()))?;
-                            self.write_int(d, val);
-                        }
-                        HeapObj::Int64Array(v) => {
-                            let val = *v
-                                .get(index)
-                                .ok_or(RuntimeError::IndexOutOfBounds(index as i64, v.len()))?;
-                            self.write_int(d, val);
-                        }
-                        HeapObj::Float64Array(v) => {
-                            let val = *v
-                                .get(index)
-                                .ok_or(RuntimeError::IndexOutOfBounds(index as i64, v.len()))?;
-                            self.regs.regs[d] = val.to_bits();
-                        }
-                        other => {
-                            return Err(RuntimeError::TypeMismatch(format!(
-                                "IndexGet: expected indexable, got {other:?}"
-                            )))
-                        }
+                    other => {
+                        return Err(RuntimeError::TypeMismatch(format!(
+                            "SetField expected struct, got {other:?}"
+                        )))
                     }
-                }
-                Opcode::IndexSet => {
-                    // IndexSet(val, obj, idx)
-                    let val = inst.dst();
-                    let obj = inst.src1();
-                    let idx = inst.src2();
-                    let hid = self.regs.regs[obj] as i64;
-                    let index = self.regs.regs[idx] as i64 as usize;
-                    let value = self.regs.regs[val] as i64;
-                    let f64_val = f64::from_bits(self.regs.regs[val]); // read before heap_get_mut borrow
-                    match self.heap_get_mut(hid)? {
-                        HeapObj::List(v) => {
-                            if index >= v.len() {
-                                return Err(RuntimeError::IndexOutOfBounds(index as i64, v.len()));
-                            }
-                            v[index] = value;
-                        }
-                        HeapObj::Int64Array(v) => {
-                            if index >= v.len() {
-                                return Err(RuntimeError::IndexOutOfBounds(index as i64, v.len()));
-                            }
-                            v[index] = value;
-                        }
-                        HeapObj::Float64Array(v) => {
-                            if index >= v.len() {
-                                return Err(RuntimeError::IndexOutOfBounds(index as i64, v.len()));
-                            }
-                            v[index] = f64_val;
+                };
+                // Check if this field is a heap type
+                let is_heap = (self.program.struct_bitmaps[sid] >> idx) & 1 != 0;
+
+                // GC: release old value, retain new value (if heap type and not self-assign)
+                if is_heap {
+                    // -1 is the null sentinel; self-assign of same handle is a no-op
+                    let self_assign = old_val == val && old_val != -1;
+                    if !self_assign && old_val != -1 {
+                        self.heap.release(old_val as usize);
+                    }
+                    // Write new value
+                    if let HeapObj::Struct(_, fields) = self.heap_get_mut(hid)? {
+                        if idx >= len {
+                            return Err(RuntimeError::FieldOutOfBounds { index: idx, len });
                         }
-                        other => {
-                            return Err(RuntimeError::TypeMismatch(format!(
-                                "IndexSet: expected indexable, got {other:?}"
-                            )));
+                        fields[idx] = val;
+                    }
+                    if !self_assign && val != -1 {
+                        self.heap.retain(val as usize);
+                    }
+                } else {
+                    // Non-heap field: just write
+                    if let HeapObj::Struct(_, fields) = self.heap_get_mut(hid)? {
+                        if idx >= len {
+                            return Err(RuntimeError::FieldOutOfBounds { index: idx, len });
                         }
+                        fields[idx] = val;
                     }
-                    self.write_int(val, value);
                 }
+            }
 
-                // ── Enum/Variant ──
-                Opcode::NewVariant => {
-                    let d = inst.dst();
-                    let enum_id = inst.src1();
-                    let tag = inst.src2() as u16;
-                    let nf = self.enum_variant_counts[enum_id][tag as usize];
-                    let bitmap = self.enum_variant_bitmaps[enum_id][tag as usize];
-                    let mut fields = vec![0i64; nf];
-                    for (i, f) in fields.iter_mut().enumerate() {
-                        if (bitmap >> i) & 1 != 0 {
-                            *f = -1;
-                        }
+            // ── 索引 ──
+            Opcode::IndexGet => {
+                // IndexGet(dst, obj, idx)
+                let d = inst.dst();
+                let o = inst.src1();
+                let i = inst.src2();
+                let hid = self.regs[o] as i64;
+                let index = self.regs[i] as i64 as usize;
+                match self.heap_get(hid)? {
+                    HeapObj::List(v) => {
+                        let val = *v
+                            .get(index)
+                            .ok_or(RuntimeError::IndexOutOfBounds(index as i64, v.len()))?;
+                        self.write_int(d, val);
+                    }
+                    HeapObj::Int64Array(v) => {
+                        let val = *v
+                            .get(index)
+                            .ok_or(RuntimeError::IndexOutOfBounds(index as i64, v.len()))?;
+                        self.write_int(d, val);
+                    }
+                    HeapObj::Float64Array(v) => {
+                        let val = *v
+                            .get(index)
+                            .ok_or(RuntimeError::IndexOutOfBounds(index as i64, v.len()))?;
+                        self.regs[d] = val.to_bits();
+                    }
+                    other => {
+                        return Err(RuntimeError::TypeMismatch(format!(
+                            "IndexGet: expected indexable, got {other:?}"
+                        )))
                     }
-                    self.write_heap(d, HeapObj::Variant(enum_id, tag, fields));
-                }
-                Opcode::GetVariantTag => {
-                    let d = inst.dst();
-                    let s = inst.src1();
-                    let hid = self.regs.regs[s] as i64;
-                    let tag = match self.heap_get(hid)? {
-                        HeapObj::Variant(_, tag, _) => *tag as i64,
-                        other => {
-                            return Err(RuntimeError::TypeMismatch(format!(
-                                "GetVariantTag expected variant, got {other:?}"
-                            )))
-                        }
-                    };
-                    self.write_int(d, tag);
-                }
-                Opcode::GetVariantField => {
-                    let d = inst.dst();
-                    let s = inst.src1();
-                    let fi = inst.src2();
-                    let hid = self.regs.regs[s] as i64;
-                    let val = match self.heap_get(hid)? {
-                        HeapObj::Variant(_, _, fields) => {
-                            fields
-                                .get(fi)
-                                .copied()
-                                .ok_or(RuntimeError::FieldOutOfBounds {
-                                    index: fi,
-                                    len: fields.len(),
-                                })?
-                        }
-                        other => {
-                            return Err(RuntimeError::TypeMismatch(format!(
-                                "GetVariantField expected variant, got {other:?}"
-                            )))
-                        }
-                    };
-                    self.write_int(d, val);
                 }
-                Opcode::SetVariantField => {
-                    // SetVariantField(val_reg, obj_reg, field_idx)
-                    let d = inst.dst(); // val reg
-                    let s = inst.src1(); // obj reg
-                    let fi = inst.src2(); // field idx
-                    let hid = self.regs.regs[s] as i64;
-                    let val = self.regs.regs[d] as i64;
-                    let (old_val, is_heap) =
-                        match self.heap_get(hid)? {
-                            HeapObj::Variant(eid, t, fields) => {
-                                let old = fields.get(fi).copied().ok_or(
-                                    RuntimeError::FieldOutOfBounds {
-                                        index: fi,
-                                        len: fields.len(),
-                                    },
-                                )?;
-                                let bitmap = self
-                                    .enum_variant_bitmaps
-                                    .get(*eid)
-                                    .and_then(|bm| bm.get(*t as usize))
-                                    .copied()
-                                    .unwrap_or(0);
-                                let heap = (bitmap >> fi) & 1 != 0;
-                                (old, heap)
-                            }
-                            other => {
-                                return Err(RuntimeError::TypeMismatch(format!(
-                                    "SetVariantField expected variant, got {other:?}"
-                                )))
-                            }
-                        };
-                    if is_heap {
-                        // GC: release old, write new, retain new (skip if self-assign)
-                        let self_assign = old_val == val && old_val != -1;
-                        if !self_assign && old_val != -1 {
-                            self.heap.release(old_val as usize);
-                        }
-                        if let HeapObj::Variant(_, _, fields) = self.heap_get_mut(hid)? {
-                            fields[fi] = val;
+            }
+            Opcode::IndexSet => {
+                // IndexSet(val, obj, idx)
+                let val = inst.dst();
+                let obj = inst.src1();
+                let idx = inst.src2();
+                let hid = self.regs[obj] as i64;
+                let index = self.regs[idx] as i64 as usize;
+                let value = self.regs[val] as i64;
+                let f64_val = f64::from_bits(self.regs[val]); // read before heap_get_mut borrow
+                match self.heap_get_mut(hid)? {
+                    HeapObj::List(v) => {
+                        if index >= v.len() {
+                            return Err(RuntimeError::IndexOutOfBounds(index as i64, v.len()));
                         }
-                        if !self_assign && val != -1 {
-                            self.heap.retain(val as usize);
+                        v[index] = value;
+                    }
+                    HeapObj::Int64Array(v) => {
+                        if index >= v.len() {
+                            return Err(RuntimeError::IndexOutOfBounds(index as i64, v.len()));
                         }
-                    } else if let HeapObj::Variant(_, _, fields) = self.heap_get_mut(hid)? {
-                        fields[fi] = val;
+                        v[index] = value;
                     }
-                }
-
-                // ── 装箱/拆箱 ──
-                Opcode::Box_ => {
-                    // Box(dst, src) — wrap value in a single-field struct
-                    let d = inst.dst();
-                    let s = inst.src1();
-                    let val = self.regs.regs[s] as i64;
-                    // Use struct id 0 as a "Box" marker, single field
-                    self.write_heap(d, HeapObj::Struct(0, vec![val]));
-                }
-                Opcode::Unbox => {
-                    // Unbox(dst, src) — extract value from boxed struct
-                    let d = inst.dst();
-                    let s = inst.src1();
-                    let hid = self.regs.regs[s] as i64;
-                    let val = match self.heap_get(hid)? {
-                        HeapObj::Struct(_, fields) => *fields.first().ok_or_else(|| {
-                            RuntimeError::TypeMismatch("Unbox: empty boxed struct".into())
-                        })?,
-                        other => {
-                            return Err(RuntimeError::TypeMismatch(format!(
-                                "Unbox: expected struct, got {other:?}"
-                            )));
+                    HeapObj::Float64Array(v) => {
+                        if index >= v.len() {
+                            return Err(RuntimeError::IndexOutOfBounds(index as i64, v.len()));
                         }
-                    };
-                    self.write_int(d, val);
+                        v[index] = f64_val;
+                    }
+                    other => {
+                        return Err(RuntimeError::TypeMismatch(format!(
+                            "IndexSet: expected indexable, got {other:?}"
+                        )));
+                    }
                 }
+                self.write_int(val, value);
+            }
 
-                // ── 控制流 ──
-                Opcode::Jump => {
-                    let block_id = (inst.src1() << 8) | inst.src2();
-                    #[allow(clippy::unnecessary_to_owned)]
-                    let args = self.jump_args(ip - 1).to_vec();
-                    self.bind_params(block_id, &args);
-                    let target_ip = self.block_ip(block_id);
-                    // Backward jump detection: target IP at or before current IP
-                    // means we're looping.
-                    if target_ip <= ip {
-                        self.check_loop_iteration(block_id, events)?;
+            // ── Enum/Variant ──
+            Opcode::NewVariant => {
+                let d = inst.dst();
+                let enum_id = inst.src1();
+                let tag = inst.src2() as u16;
+                let nf = self.program.enum_variant_counts[enum_id][tag as usize];
+                let bitmap = self.program.enum_variant_bitmaps[enum_id][tag as usize];
+                let fields = Fields::from_fn(nf, |i| -(((bitmap >> i) & 1) as i64));
+                self.write_heap(d, HeapObj::Variant(enum_id, tag, fields));
+            }
+            Opcode::GetVariantTag => {
+                let d = inst.dst();
+                let s = inst.src1();
+                let hid = self.regs[s] as i64;
+                let tag = match self.heap_get(hid)? {
+                    HeapObj::Variant(_, tag, _) => *tag as i64,
+                    other => {
+                        return Err(RuntimeError::TypeMismatch(format!(
+                            "GetVariantTag expected variant, got {other:?}"
+                        )))
+                    }
+                };
+                self.write_int(d, tag);
+            }
+            Opcode::GetVariantField => {
+                let d = inst.dst();
+                let s = inst.src1();
+                let fi = inst.src2();
+                let hid = self.regs[s] as i64;
+                let val = match self.heap_get(hid)? {
+                    HeapObj::Variant(_, _, fields) => {
+                        fields
+                            .get(fi)
+                            .copied()
+                            .ok_or(RuntimeError::FieldOutOfBounds {
+                                index: fi,
+                                len: fields.len(),
+                            })?
+                    }
+                    other => {
+                        return Err(RuntimeError::TypeMismatch(format!(
+                            "GetVariantField expected variant, got {other:?}"
+                        )))
                     }
-                    ip = target_ip;
-                }
-                Opcode::Branch => {
-                    let c = inst.dst();
-                    let tb = inst.src1();
-                    let fb = inst.src2();
-                    let take_true = self.regs.regs[c] as i64 != 0;
-                    let block_id = if take_true { tb } else { fb };
-                    // Stored as: [true_count, true_args..., false_count, false_args...]
-                    // Clone only the needed args (typically 0-4 elements) to drop jump_args borrow
-                    let stored = self.jump_args(ip - 1);
-                    let true_cnt = stored[0];
-                    let false_cnt = stored[1 + true_cnt];
-                    let args: Vec<usize> = if take_true {
-                        stored[1..1 + true_cnt].to_vec()
-                    } else {
-                        stored[2 + true_cnt..2 + true_cnt + false_cnt].to_vec()
-                    };
-                    self.bind_params(block_id, &args);
-                    let target_ip = self.block_ip(block_id);
-                    // Backward jump detection: branch to at or before current IP
-                    // means we're looping.
-                    if target_ip <= ip {
-                        self.check_loop_iteration(block_id, events)?;
+                };
+                self.write_int(d, val);
+            }
+            Opcode::SetVariantField => {
+                // SetVariantField(val_reg, obj_reg, field_idx)
+                let d = inst.dst(); // val reg
+                let s = inst.src1(); // obj reg
+                let fi = inst.src2(); // field idx
+                let hid = self.regs[s] as i64;
+                let val = self.regs[d] as i64;
+                let (old_val, is_heap) = match self.heap_get(hid)? {
+                    HeapObj::Variant(eid, t, fields) => {
+                        let old =
+                            fields
+                                .get(fi)
+                                .copied()
+                                .ok_or(RuntimeError::FieldOutOfBounds {
+                                    index: fi,
+                                    len: fields.len(),
+                                })?;
+                        let bitmap = self
+                            .program
+                            .enum_variant_bitmaps
+                            .get(*eid)
+                            .and_then(|bm| bm.get(*t as usize))
+                            .copied()
+                            .unwrap_or(0);
+                        let heap = (bitmap >> fi) & 1 != 0;
+                        (old, heap)
                     }
-                    ip = target_ip;
-                }
-
-                // ── 调用 ──
-                Opcode::Call => {
-                    // Call(func_idx, args, cont_block)
-                    let func_idx = inst.dst();
-                    let cont_block = (inst.src1() << 8) | inst.src2();
-                    if self.frames.len() >= MAX_CALL_DEPTH {
-                        return Err(RuntimeError::StackOverflow);
+                    other => {
+                        return Err(RuntimeError::TypeMismatch(format!(
+                            "SetVariantField expected variant, got {other:?}"
+                        )))
                     }
-                    let callee_regs = self.func_reg_counts[func_idx];
-                    // Take the caller's register vec (O(1) pointer swap)
-                    let saved_regs = std::mem::take(&mut self.regs.regs);
-                    // Prepare callee registers by reusing the just-emptied vec
-                    self.regs.regs.resize(callee_regs, 0);
-                    // Copy args from saved caller registers into callee positions
-                    let args = self.jump_args(ip - 1).to_vec();
-                    for (i, &arg_reg) in args.iter().enumerate() {
-                        if i < callee_regs {
-                            self.regs.regs[i] = saved_regs[arg_reg];
-                        }
+                };
+                if is_heap {
+                    // GC: release old, write new, retain new (skip if self-assign)
+                    let self_assign = old_val == val && old_val != -1;
+                    if !self_assign && old_val != -1 {
+                        self.heap.release(old_val as usize);
                     }
-                    self.frames.push(CallFrame {
-                        func_idx: self.current_func,
-                        ret_block: cont_block,
-                        saved_regs,
-                        result_reg: 0,
-                    });
-                    self.current_func = func_idx;
-                    ip = self.func_entries[func_idx];
-                }
-                Opcode::TailCall => {
-                    // Tail call: bind args from jump_args into first N regs, jump to entry
-                    let args = self.jump_args(ip - 1).to_vec();
-                    // Bind args to the entry block's param registers
-                    let params = &self.func_params[self.current_func]
-                        .first()
-                        .cloned()
-                        .unwrap_or_default();
-                    for (i, &arg_reg) in args.iter().enumerate() {
-                        if i < params.len() {
-                            self.regs.regs[params[i]] = self.regs.regs[arg_reg];
-                        }
+                    if let HeapObj::Variant(_, _, fields) = self.heap_get_mut(hid)? {
+                        fields[fi] = val;
                     }
-                    ip = self.block_ip(0); // jump to entry block 0
-                }
-                Opcode::Return => {
-                    // ret
-                    let r = inst.dst();
-                    if let Some(frame) = self.frames.pop() {
-                        let result = self.regs.regs[r];
-                        self.regs.regs = frame.saved_regs;
-                        self.current_func = frame.func_idx;
-                        if self.regs.regs.len() <= frame.result_reg {
-                            self.regs.regs.resize(frame.result_reg + 1, 0);
-                        }
-                        self.regs.regs[frame.result_reg] = result;
-                        ip = self.block_ip(frame.ret_block);
-                    } else {
-                        return Ok(self.regs.regs[r] as i64);
+                    if !self_assign && val != -1 {
+                        self.heap.retain(val as usize);
                     }
+                } else if let HeapObj::Variant(_, _, fields) = self.heap_get_mut(hid)? {
+                    fields[fi] = val;
                 }
+            }
 
-                // ── native call ──
-                Opcode::CallNative => {
-                    let fi = inst.dst();
-                    let ret_block = (inst.src1() << 8) | inst.src2();
-                    let args: Vec<i64> = self
-                        .jump_args(ip - 1)
-                        .iter()
-                        .map(|&r| self.regs.regs[r] as i64)
-                        .collect();
-                    if fi < self.natives.len() {
-                        let result = (self.natives[fi].1)(&args, &self.heap)
-                            .map_err(RuntimeError::NativeError)?;
-                        self.write_int(0, result);
-                    } else {
-                        return Err(RuntimeError::Bug(format!("unknown native index {fi}")));
+            // ── 装箱/拆箱 ──
+            Opcode::Box_ => {
+                // Box(dst, src) — wrap value in a single-field struct
+                let d = inst.dst();
+                let s = inst.src1();
+                let val = self.regs[s] as i64;
+                // Use struct id 0 as a "Box" marker, single field
+                self.write_heap(d, HeapObj::Struct(0, Fields::from_fn(1, |_| val)));
+            }
+            Opcode::Unbox => {
+                // Unbox(dst, src) — extract value from boxed struct
+                let d = inst.dst();
+                let s = inst.src1();
+                let hid = self.regs[s] as i64;
+                let val = match self.heap_get(hid)? {
+                    HeapObj::Struct(_, fields) => *fields.first().ok_or_else(|| {
+                        RuntimeError::TypeMismatch("Unbox: empty boxed struct".into())
+                    })?,
+                    other => {
+                        return Err(RuntimeError::TypeMismatch(format!(
+                            "Unbox: expected struct, got {other:?}"
+                        )));
                     }
-                    ip = self.block_ip(ret_block);
-                }
+                };
+                self.write_int(d, val);
+            }
 
-                // ── async ──
-                Opcode::AsyncPoll => {
-                    if let Some((_, result)) = self.scheduler.poll() {
-                        self.write_int(0, result);
-                    }
+            // ── 控制流 ──
+            Opcode::Jump => {
+                let block_id = (inst.src1() << 8) | inst.src2();
+                self.apply_moves(self.program.edge_spans[*ip - 1].primary());
+                let target_ip = self.block_ip(block_id);
+                // Backward jump: target at or before this instruction means we're looping
+                let back = target_ip < *ip;
+                *ip = target_ip;
+                if back && self.burn_fuel(block_id, events)? {
+                    return Ok(Flow::Yield);
                 }
-                Opcode::Suspend => {
-                    // suspend
-                    let cf = CallFrame {
-                        func_idx: self.current_func,
-                        ret_block: 0,
-                        saved_regs: self.regs.regs.clone(),
-                        result_reg: 0,
-                    };
-                    self.scheduler.suspend(cf, ip);
-                    return Ok(0);
+            }
+            Opcode::Branch => {
+                let c = inst.dst();
+                let tb = inst.src1();
+                let fb = inst.src2();
+                let take_true = self.regs[c] as i64 != 0;
+                let block_id = if take_true { tb } else { fb };
+                let span = self.program.edge_spans[*ip - 1];
+                self.apply_moves(if take_true {
+                    span.primary()
+                } else {
+                    span.alt()
+                });
+                let target_ip = self.block_ip(block_id);
+                // Backward jump: branch to at or before this instruction means we're looping
+                let back = target_ip < *ip;
+                *ip = target_ip;
+                if back && self.burn_fuel(block_id, events)? {
+                    return Ok(Flow::Yield);
                 }
+            }
 
-                // ── interface dispatch ──
-                Opcode::LoadVtable => {
-                    // LoadVtable(dst, vtable_idx) — store vtable_idx in register
-                    let d = inst.dst();
-                    let vi = inst.src1();
-                    // Store vtable index as a special tagged value (negative to distinguish from heap handles)
-                    // We use a negative sentinel: -(vtable_idx + 1) so it's never 0
-                    self.write_int(d, -((vi as i64) + 1));
+            // ── 调用 ──
+            Opcode::Call => {
+                // Call(func_idx, args, cont_block)
+                let func_idx = inst.call_target();
+                let cont_block = inst.call_cont();
+                let callee_regs = self.program.func_reg_counts[func_idx];
+                let caller = self.push_frame(callee_regs, cont_block)?;
+                // Copy args in place from the caller window into the callee window
+                // (load 时已按 callee_regs 截断)
+                for m in &self.program.edge_moves[self.program.edge_spans[*ip - 1].primary()] {
+                    self.regs[m.dst as usize] = self.regs.stack[caller + m.src as usize];
+                }
+                self.current_func = func_idx;
+                *ip = self.program.func_entries[func_idx];
+                if self.burn_call_fuel(cont_block, events)? {
+                    return Ok(Flow::Yield);
+                }
+                #[cfg(feature = "jit")]
+                if self.tier_up(Entry::Call, ip, events)? {
+                    return Ok(Flow::Yield);
                 }
-                Opcode::NewInterfaceObj => {
-                    // NewInterfaceObj(dst, vtable_reg, struct_reg)
-                    let d = inst.dst();
-                    let vr = inst.src1();
-                    let sr = inst.src2();
-                    // Decode vtable_idx from the tagged register value
-                    let raw = self.regs.regs[vr] as i64;
-                    let vtable_idx = ((-raw) - 1) as usize;
-                    let data = self.regs.regs[sr] as i64;
-                    // Retain the data handle since InterfaceObj now holds a reference
-                    if data >= 0 {
-                        self.heap.retain(data as usize);
-                    }
-                    self.write_heap(d, HeapObj::InterfaceObj { vtable_idx, data });
+            }
+            Opcode::TailCall => {
+                // Tail call: bind args to the entry block's param registers, jump to entry
+                self.apply_moves(self.program.edge_spans[*ip - 1].primary());
+                *ip = self.block_ip(0); // jump to entry block 0
+                if self.burn_call_fuel(0, events)? {
+                    return Ok(Flow::Yield);
                 }
-                Opcode::CallIndirect => {
-                    // CallIndirect(slot, args..., cont_block)
-                    let slot = inst.dst();
-                    let cont_block = (inst.src1() << 8) | inst.src2();
-                    if self.frames.len() >= MAX_CALL_DEPTH {
-                        return Err(RuntimeError::StackOverflow);
-                    }
-                    let args = self.jump_args(ip - 1).to_vec();
-                    if args.is_empty() {
-                        return Err(RuntimeError::Bug(
-                            "CallIndirect: no args (need at least self)".into(),
-                        ));
-                    }
-                    // First arg is the InterfaceObj handle
-                    let iface_handle = self.regs.regs[args[0]] as i64;
-                    let (vtable_idx, data_handle) = match self.heap_get(iface_handle)? {
-                        HeapObj::InterfaceObj { vtable_idx, data } => (*vtable_idx, *data),
-                        other => {
-                            return Err(RuntimeError::TypeMismatch(format!(
-                                "CallIndirect: expected InterfaceObj, got {other:?}"
-                            )))
-                        }
-                    };
-                    // Look up the method func_idx from the vtable
-                    let vtable = self.vtables.get(vtable_idx).ok_or_else(|| {
-                        RuntimeError::Bug(format!("vtable index {vtable_idx} out of bounds"))
-                    })?;
-                    let (_, func_idx) = vtable.methods.get(slot).ok_or_else(|| {
-                        RuntimeError::Bug(format!(
-                            "vtable slot {slot} out of bounds (vtable '{}' has {} methods)",
-                            vtable.interface_name,
-                            vtable.methods.len()
-                        ))
-                    })?;
-                    let func_idx = *func_idx;
-                    let callee_regs = self.func_reg_counts[func_idx];
-                    // Save caller regs
-                    let saved_regs = std::mem::take(&mut self.regs.regs);
-                    // Prepare callee registers
-                    self.regs.regs.resize(callee_regs, 0);
-                    // Copy args from saved caller registers into callee positions
-                    // Replace first arg (InterfaceObj handle) with the actual data handle
-                    for (i, &arg_reg) in args.iter().enumerate() {
-                        if i < callee_regs {
-                            if i == 0 {
-                                self.regs.regs[i] = data_handle as u64;
-                            } else {
-                                self.regs.regs[i] = saved_regs[arg_reg];
-                            }
-                        }
+                #[cfg(feature = "jit")]
+                if self.tier_up(Entry::Back(0), ip, events)? {
+                    return Ok(Flow::Yield);
+                }
+            }
+            Opcode::Return => {
+                // ret
+                let r = inst.dst();
+                if let Some(frame) = self.frames.pop() {
+                    let result = self.regs[r];
+                    self.regs.pop_window((frame.base, frame.len));
+                    self.current_func = frame.func_idx;
+                    self.regs.ensure_capacity(frame.result_reg + 1);
+                    self.regs[frame.result_reg] = result;
+                    *ip = self.block_ip(frame.ret_block);
+                    #[cfg(feature = "jit")]
+                    if self.tier_up(Entry::Return(frame.ret_block), ip, events)? {
+                        return Ok(Flow::Yield);
                     }
-                    self.frames.push(CallFrame {
-                        func_idx: self.current_func,
-                        ret_block: cont_block,
-                        saved_regs,
-                        result_reg: 0,
-                    });
-                    self.current_func = func_idx;
-                    ip = self.func_entries[func_idx];
+                } else {
+                    return Ok(Flow::Return(self.regs[r] as i64));
+                }
+            }
+
+            // ── native call ──
+            Opcode::CallNative => {
+                let fi = inst.call_target();
+                let ret_block = inst.call_cont();
+                // 实参直接从寄存器窗口读到定长栈数组，不经过堆缓冲
+                let moves = &self.program.edge_moves[self.program.edge_spans[*ip - 1].primary()];
+                if moves.len() > MAX_NATIVE_ARGS {
+                    return Err(RuntimeError::Bug(format!(
+                        "native call with {} arguments (max {MAX_NATIVE_ARGS})",
+                        moves.len()
+                    )));
+                }
+                let mut args = [0i64; MAX_NATIVE_ARGS];
+                for (slot, m) in args.iter_mut().zip(moves) {
+                    *slot = self.regs[m.src as usize] as i64;
+                }
+                let argc = moves.len();
+                if fi < self.natives.len() {
+                    let result = (self.natives[fi].1)(&args[..argc], &mut self.heap)
+                        .map_err(RuntimeError::NativeError)?;
+                    self.write_int(0, result);
+                } else {
+                    return Err(RuntimeError::Bug(format!("unknown native index {fi}")));
+                }
+                *ip = self.block_ip(ret_block);
+            }
+
+            // ── async ──
+            Opcode::AsyncPoll => {
+                if let Some((_, result)) = self.scheduler.poll() {
+                    self.write_int(0, result);
                 }
+            }
+            Opcode::Suspend => {
+                // suspend
+                let cf = CallFrame {
+                    func_idx: self.current_func,
+                    ret_block: 0,
+                    base: self.regs.base,
+                    len: self.regs.len(),
+                    result_reg: 0,
+                };
+                // 窗口之后会被复用，挂起帧需要自己的寄存器快照
+                self.scheduler.suspend(cf, self.regs.window(), *ip);
+                return Ok(Flow::Return(0));
+            }
 
-                // ── print ──
-                Opcode::Print => {
-                    let r = inst.dst();
-                    let val = self.regs.regs[r] as i64;
-                    if val >= 0 {
-                        if let Some(HeapObj::String(s)) = self.heap.try_get(val as usize) {
-                            self.output.push(s.clone());
+            // ── interface dispatch ──
+            Opcode::LoadVtable => {
+                // LoadVtable(dst, vtable_idx) — store vtable_idx in register
+                let d = inst.dst();
+                let vi = inst.src1();
+                // Store vtable index as a special tagged value (negative to distinguish from heap handles)
+                // We use a negative sentinel: -(vtable_idx + 1) so it's never 0
+                self.write_int(d, -((vi as i64) + 1));
+            }
+            Opcode::NewInterfaceObj => {
+                // NewInterfaceObj(dst, vtable_reg, struct_reg)
+                let d = inst.dst();
+                let vr = inst.src1();
+                let sr = inst.src2();
+                // Decode vtable_idx from the tagged register value
+                let raw = self.regs[vr] as i64;
+                let vtable_idx = ((-raw) - 1) as usize;
+                let data = self.regs[sr] as i64;
+                // Retain the data handle since InterfaceObj now holds a reference
+                if data >= 0 {
+                    self.heap.retain(data as usize);
+                }
+                self.write_heap(d, HeapObj::InterfaceObj { vtable_idx, data });
+            }
+            Opcode::CallIndirect => {
+                // CallIndirect(slot, args..., cont_block)
+                let slot = inst.call_target();
+                let cont_block = inst.call_cont();
+                let args = self.program.edge_spans[*ip - 1].primary();
+                if args.is_empty() {
+                    return Err(RuntimeError::Bug(
+                        "CallIndirect: no args (need at least self)".into(),
+                    ));
+                }
+                // First arg is the InterfaceObj handle
+                let iface_handle =
+                    self.regs[self.program.edge_moves[args.start].src as usize] as i64;
+                let (vtable_idx, data_handle) = match self.heap_get(iface_handle)? {
+                    HeapObj::InterfaceObj { vtable_idx, data } => (*vtable_idx, *data),
+                    other => {
+                        return Err(RuntimeError::TypeMismatch(format!(
+                            "CallIndirect: expected InterfaceObj, got {other:?}"
+                        )))
+                    }
+                };
+                // 先查本调用点的内联缓存，未命中再查 vtable 并回填
+                let site = self.program.ic_sites[*ip - 1] as usize;
+                let target = match self.ic.lookup(site, vtable_idx) {
+                    Some(t) => t,
+                    None => self.resolve_indirect(site, vtable_idx, slot, events)?,
+                };
+                let func_idx = target.func_idx as usize;
+                let callee_regs = target.regs as usize;
+                let caller = self.push_frame(callee_regs, cont_block)?;
+                // Copy args in place from the caller window into the callee window
+                // Replace first arg (InterfaceObj handle) with the actual data handle
+                for m in &self.program.edge_moves[args] {
+                    let i = m.dst as usize;
+                    if i < callee_regs {
+                        if i == 0 {
+                            self.regs[i] = data_handle as u64;
                         } else {
-                            self.output.push(format!("{val}"));
+                            self.regs[i] = self.regs.stack[caller + m.src as usize];
                         }
-                    } else {
-                        self.output.push(format!("{val}"));
                     }
                 }
+                self.current_func = func_idx;
+                *ip = target.func_entry as usize;
+                if self.burn_call_fuel(cont_block, events)? {
+                    return Ok(Flow::Yield);
+                }
+                #[cfg(feature = "jit")]
+                if self.tier_up(Entry::Call, ip, events)? {
+                    return Ok(Flow::Yield);
+                }
+            }
 
-                #[allow(unreachable_patterns)]
-                _ => return Err(RuntimeError::InvalidOpcode(opcode as u8)),
+            // ── print ──
+            Opcode::Print => {
+                let r = inst.dst();
+                let val = self.regs[r] as i64;
+                match (val >= 0)
+                    .then(|| self.heap.get_str(val as usize))
+                    .flatten()
+                {
+                    Some(s) => self.sink.print_str(s),
+                    None => self.sink.print_int(val),
+                }
             }
+
+            #[allow(unreachable_patterns)]
+            _ => return Err(RuntimeError::InvalidOpcode(opcode as u8)),
         }
+        Ok(Flow::Next)
     }
 }
 
 // ── 指令编码 ──
 
-fn encode_instr(instr: &CpsInstr) -> Result<u32, String> {
-    Ok(match instr {
-        CpsInstr::BinOp(d, op, s1, s2) => encode(
+/// 常量池上限：`LoadConst` 的下标占 src1 + src2 共 17 位（`Inst::const_idx`）。
+pub const MAX_CONSTS: usize = 1 << 17;
+/// 块号上限：`Jump` 的目标块占 src1 + src2 共 17 位。
+pub const MAX_BLOCKS: usize = 1 << 17;
+/// 调用目标上限（函数数 / native 数），见 `Inst::call_target`。
+pub const MAX_CALL_TARGETS: usize = 1 << 12;
+/// 调用续体块号上限，见 `Inst::call_cont`。
+pub const MAX_CALL_CONT: usize = 1 << 13;
+
+fn encode_call(op: Opcode, target: usize, cont: usize) -> Result<u32, String> {
+    if target >= MAX_CALL_TARGETS {
+        return Err(format!(
+            "call target {target} exceeds the {MAX_CALL_TARGETS}-entry call encoding"
+        ));
+    }
+    if cont >= MAX_CALL_CONT {
+        return Err(format!(
+            "call continuation block {cont} exceeds the {MAX_CALL_CONT}-block call encoding"
+        ));
+    }
+    Ok(encode(
+        op as u8,
+        (target & 0xFF) as u32,
+        (((target >> 8) << 5) | (cont >> 8)) as u32,
+        (cont & 0xFF) as u32,
+    ))
+}
+
+/// `encode`，但操作数放不下字段（dst 8 位、src1 9 位、src2 8 位）时报错，不截断。
+fn pack(op: Opcode, dst: usize, src1: usize, src2: usize) -> Result<u32, String> {
+    if dst > 0xFF || src1 > 0x1FF || src2 > 0xFF {
+        return Err(format!(
+            "{op:?} operands ({dst}, {src1}, {src2}) exceed the instruction fields"
+        ));
+    }
+    Ok(encode(op as u8, dst as u32, src1 as u32, src2 as u32))
+}
+
+pub(crate) fn encode_instr(instr: &CpsInstr) -> Result<u32, String> {
+    match instr {
+        CpsInstr::BinOp(d, op, s1, s2) => pack(
             match op {
-                CpsBinOp::AddInt => Opcode::AddInt as u8,
-                CpsBinOp::SubInt => Opcode::SubInt as u8,
-                CpsBinOp::MulInt => Opcode::MulInt as u8,
-                CpsBinOp::DivInt => Opcode::DivInt as u8,
-                CpsBinOp::ModInt => Opcode::ModInt as u8,
-                CpsBinOp::FAdd => Opcode::FAdd as u8,
-                CpsBinOp::FSub => Opcode::FSub as u8,
-                CpsBinOp::FMul => Opcode::FMul as u8,
-                CpsBinOp::FDiv => Opcode::FDiv as u8,
-                CpsBinOp::FEq => Opcode::FEq as u8,
-                CpsBinOp::FNe => Opcode::FNe as u8,
-                CpsBinOp::FLt => Opcode::FLt as u8,
-                CpsBinOp::FLe => Opcode::FLe as u8,
-                CpsBinOp::FGt => Opcode::FGt as u8,
-                CpsBinOp::FGe => Opcode::FGe as u8,
-                CpsBinOp::EqInt => Opcode::EqInt as u8,
-                CpsBinOp::NeInt => Opcode::NeInt as u8,
-                CpsBinOp::LtInt => Opcode::LtInt as u8,
-                CpsBinOp::LeInt => Opcode::LeInt as u8,
-                CpsBinOp::GtInt => Opcode::GtInt as u8,
-                CpsBinOp::GeInt => Opcode::GeInt as u8,
-                CpsBinOp::IToF => Opcode::IToF as u8,
-                CpsBinOp::FToI => Opcode::FToI as u8,
-                CpsBinOp::IToS => Opcode::IToS as u8,
-                CpsBinOp::FToS => Opcode::FToS as u8,
-                CpsBinOp::SToI => Opcode::SToI as u8,
-                CpsBinOp::BToS => Opcode::BToS as u8,
-                CpsBinOp::SAdd => Opcode::SAdd as u8,
+                CpsBinOp::AddInt => Opcode::AddInt,
+                CpsBinOp::SubInt => Opcode::SubInt,
+                CpsBinOp::MulInt => Opcode::MulInt,
+                CpsBinOp::DivInt => Opcode::DivInt,
+                CpsBinOp::ModInt => Opcode::ModInt,
+                CpsBinOp::FAdd => Opcode::FAdd,
+                CpsBinOp::FSub => Opcode::FSub,
+                CpsBinOp::FMul => Opcode::FMul,
+                CpsBinOp::FDiv => Opcode::FDiv,
+                CpsBinOp::FEq => Opcode::FEq,
+                CpsBinOp::FNe => Opcode::FNe,
+                CpsBinOp::FLt => Opcode::FLt,
+                CpsBinOp::FLe => Opcode::FLe,
+                CpsBinOp::FGt => Opcode::FGt,
+                CpsBinOp::FGe => Opcode::FGe,
+                CpsBinOp::EqInt => Opcode::EqInt,
+                CpsBinOp::NeInt => Opcode::NeInt,
+                CpsBinOp::LtInt => Opcode::LtInt,
+                CpsBinOp::LeInt => Opcode::LeInt,
+                CpsBinOp::GtInt => Opcode::GtInt,
+                CpsBinOp::GeInt => Opcode::GeInt,
+                CpsBinOp::IToF => Opcode::IToF,
+                CpsBinOp::FToI => Opcode::FToI,
+                CpsBinOp::IToS => Opcode::IToS,
+                CpsBinOp::FToS => Opcode::FToS,
+                CpsBinOp::SToI => Opcode::SToI,
+                CpsBinOp::BToS => Opcode::BToS,
+                CpsBinOp::SAdd => Opcode::SAdd,
             },
-            *d as u32,
-            *s1 as u32,
-            *s2 as u32,
+            *d,
+            *s1,
+            *s2,
         ),
-        CpsInstr::UnOp(d, op, s) => encode(
+        CpsInstr::UnOp(d, op, s) => pack(
             match op {
-                CpsUnOp::NegInt => Opcode::NegInt as u8,
-                CpsUnOp::FNeg => Opcode::FNeg as u8,
-                CpsUnOp::Not => Opcode::Not as u8,
+                CpsUnOp::NegInt => Opcode::NegInt,
+                CpsUnOp::FNeg => Opcode::FNeg,
+                CpsUnOp::Not => Opcode::Not,
+                CpsUnOp::FSqrt => Opcode::FSqrt,
+                CpsUnOp::FSin => Opcode::FSin,
+                CpsUnOp::FCos => Opcode::FCos,
+                CpsUnOp::FFloor => Opcode::FFloor,
+                CpsUnOp::FCeil => Opcode::FCeil,
             },
-            *d as u32,
-            *s as u32,
+            *d,
+            *s,
             0,
         ),
-        CpsInstr::LoadConst(d, idx) => encode(Opcode::LoadConst as u8, *d as u32, *idx as u32, 0),
-        CpsInstr::Move(d, s) => encode(Opcode::Move as u8, *d as u32, *s as u32, 0),
-        CpsInstr::NewStruct(d, sid, _) => {
-            encode(Opcode::NewStruct as u8, *d as u32, *sid as u32, 0)
-        }
-        CpsInstr::GetField(d, o, idx) => {
-            encode(Opcode::GetField as u8, *d as u32, *o as u32, *idx as u32)
-        }
-        CpsInstr::SetField(d, o, idx, _) => {
-            encode(Opcode::SetField as u8, *d as u32, *o as u32, *idx as u32)
-        }
-        CpsInstr::NewVariant(d, eid, tag, _) => encode(
-            Opcode::NewVariant as u8,
-            *d as u32,
-            *eid as u32,
-            *tag as u32,
-        ),
-        CpsInstr::GetVariantTag(d, o) => {
-            encode(Opcode::GetVariantTag as u8, *d as u32, *o as u32, 0)
-        }
-        CpsInstr::GetVariantField(d, o, fi) => encode(
-            Opcode::GetVariantField as u8,
-            *d as u32,
-            *o as u32,
-            *fi as u32,
-        ),
-        CpsInstr::SetVariantField(d, o, fi, _) => encode(
-            Opcode::SetVariantField as u8,
-            *d as u32,
-            *o as u32,
-            *fi as u32,
-        ),
-        CpsInstr::NewList(d, elements) => {
-            encode(Opcode::NewList as u8, *d as u32, elements.len() as u32, 0)
+        CpsInstr::LoadConst(d, idx) => {
+            if *idx >= MAX_CONSTS {
+                return Err(format!(
+                    "constant index {idx} exceeds the {MAX_CONSTS}-entry constant pool"
+                ));
+            }
+            pack(Opcode::LoadConst, *d, *idx & 0x1FF, *idx >> 9)
         }
-        CpsInstr::NewTuple(d, elements) => {
-            encode(Opcode::NewTuple as u8, *d as u32, elements.len() as u32, 0)
+        CpsInstr::Move(d, s) => pack(Opcode::Move, *d, *s, 0),
+        CpsInstr::NewStruct(d, sid, _) => pack(Opcode::NewStruct, *d, *sid, 0),
+        CpsInstr::GetField(d, o, idx) => pack(Opcode::GetField, *d, *o, usize::from(*idx)),
+        CpsInstr::SetField(d, o, idx, _) => pack(Opcode::SetField, *d, *o, usize::from(*idx)),
+        CpsInstr::NewVariant(d, eid, tag, _) => {
+            pack(Opcode::NewVariant, *d, *eid, usize::from(*tag))
         }
-        CpsInstr::TupleIndex(d, t, idx) => {
-            encode(Opcode::TupleIndex as u8, *d as u32, *t as u32, *idx as u32)
+        CpsInstr::GetVariantTag(d, o) => pack(Opcode::GetVariantTag, *d, *o, 0),
+        CpsInstr::GetVariantField(d, o, fi) => {
+            pack(Opcode::GetVariantField, *d, *o, usize::from(*fi))
         }
-        CpsInstr::NewInt64Array(d, elements) => encode(
-            Opcode::NewInt64Array as u8,
-            *d as u32,
-            elements.len() as u32,
-            0,
-        ),
-        CpsInstr::NewFloat64Array(d, elements) => encode(
-            Opcode::NewFloat64Array as u8,
-            *d as u32,
-            elements.len() as u32,
-            0,
-        ),
-        CpsInstr::ListLen(d, obj) => encode(Opcode::ListLen as u8, *d as u32, *obj as u32, 0),
-        CpsInstr::IndexGet(d, o, i) => {
-            encode(Opcode::IndexGet as u8, *d as u32, *o as u32, *i as u32)
+        CpsInstr::SetVariantField(d, o, fi, _) => {
+            pack(Opcode::SetVariantField, *d, *o, usize::from(*fi))
         }
-        CpsInstr::IndexSet(d, o, i, _) => {
-            encode(Opcode::IndexSet as u8, *d as u32, *o as u32, *i as u32)
+        CpsInstr::NewList(d, elements) => pack(Opcode::NewList, *d, elements.len(), 0),
+        CpsInstr::NewTuple(d, elements) => pack(Opcode::NewTuple, *d, elements.len(), 0),
+        CpsInstr::TupleIndex(d, t, idx) => pack(Opcode::TupleIndex, *d, *t, usize::from(*idx)),
+        CpsInstr::NewInt64Array(d, elements) => pack(Opcode::NewInt64Array, *d, elements.len(), 0),
+        CpsInstr::NewFloat64Array(d, elements) => {
+            pack(Opcode::NewFloat64Array, *d, elements.len(), 0)
         }
-        CpsInstr::Box(d, s) => encode(Opcode::Box_ as u8, *d as u32, *s as u32, 0),
-        CpsInstr::Unbox(d, s) => encode(Opcode::Unbox as u8, *d as u32, *s as u32, 0),
-        CpsInstr::Print(r) => encode(Opcode::Print as u8, *r as u32, 0, 0),
-        CpsInstr::LoadVtable(d, vi) => encode(Opcode::LoadVtable as u8, *d as u32, *vi as u32, 0),
-        CpsInstr::NewInterfaceObj(d, vr, sr) => encode(
-            Opcode::NewInterfaceObj as u8,
-            *d as u32,
-            *vr as u32,
-            *sr as u32,
-        ),
+        CpsInstr::ListLen(d, obj) => pack(Opcode::ListLen, *d, *obj, 0),
+        CpsInstr::IndexGet(d, o, i) => pack(Opcode::IndexGet, *d, *o, *i),
+        CpsInstr::IndexSet(d, o, i, _) => pack(Opcode::IndexSet, *d, *o, *i),
+        CpsInstr::Box(d, s) => pack(Opcode::Box_, *d, *s, 0),
+        CpsInstr::Unbox(d, s) => pack(Opcode::Unbox, *d, *s, 0),
+        CpsInstr::Print(r) => pack(Opcode::Print, *r, 0, 0),
+        CpsInstr::LoadVtable(d, vi) => pack(Opcode::LoadVtable, *d, *vi, 0),
+        CpsInstr::NewInterfaceObj(d, vr, sr) => pack(Opcode::NewInterfaceObj, *d, *vr, *sr),
         CpsInstr::LoadExternalConst(..) => {
-            return Err(
-                "LoadExternalConst should be resolved by LinkStage before VM execution".into(),
-            )
+            Err("LoadExternalConst should be resolved by LinkStage before VM execution".into())
         }
-        CpsInstr::Nop => return Err("nop is not executable".into()),
-    })
+        CpsInstr::Nop => Err("nop is not executable".into()),
+    }
 }
 
-fn encode_term(term: &CpsTerminator) -> Result<u32, String> {
-    Ok(match term {
+pub(crate) fn encode_term(term: &CpsTerminator) -> Result<u32, String> {
+    match term {
         CpsTerminator::Jump(b, _) => {
-            encode(Opcode::Jump as u8, 0, (*b >> 8) as u32, (*b & 0xFF) as u32)
-        }
-        CpsTerminator::Branch(c, tb, _, fb, _) => {
-            encode(Opcode::Branch as u8, *c as u32, *tb as u32, *fb as u32)
+            if *b >= MAX_BLOCKS {
+                return Err(format!(
+                    "block {b} exceeds the {MAX_BLOCKS}-block jump encoding"
+                ));
+            }
+            pack(Opcode::Jump, 0, *b >> 8, *b & 0xFF)
         }
-        CpsTerminator::Suspend => encode(Opcode::Suspend as u8, 0, 0, 0),
-        CpsTerminator::Return(r) => encode(Opcode::Return as u8, *r as u32, 0, 0),
-        CpsTerminator::Call(fi, _, ret) => encode(
-            Opcode::Call as u8,
-            *fi as u32,
-            (*ret >> 8) as u32,
-            (*ret & 0xFF) as u32,
-        ),
-        CpsTerminator::CallNative(fi, _, ret) => encode(
-            Opcode::CallNative as u8,
-            *fi as u32,
-            (*ret >> 8) as u32,
-            (*ret & 0xFF) as u32,
-        ),
-        CpsTerminator::CallIndirect(slot, _, ret) => encode(
-            Opcode::CallIndirect as u8,
-            *slot as u32,
-            (*ret >> 8) as u32,
-            (*ret & 0xFF) as u32,
-        ),
-        CpsTerminator::TailCall(_, _) => encode(Opcode::TailCall as u8, 0, 0, 0),
+        // 真块号占 src1 的 9 位，假块号占 src2 的 8 位
+        CpsTerminator::Branch(c, tb, _, fb, _) => pack(Opcode::Branch, *c, *tb, *fb),
+        CpsTerminator::Suspend => pack(Opcode::Suspend, 0, 0, 0),
+        CpsTerminator::Return(r) => pack(Opcode::Return, *r, 0, 0),
+        CpsTerminator::Call(fi, _, ret) => encode_call(Opcode::Call, *fi, *ret),
+        CpsTerminator::CallNative(fi, _, ret) => encode_call(Opcode::CallNative, *fi, *ret),
+        CpsTerminator::CallIndirect(slot, _, ret) => encode_call(Opcode::CallIndirect, *slot, *ret),
+        CpsTerminator::TailCall(_, _) => pack(Opcode::TailCall, 0, 0, 0),
         // CallExternal: should be resolved by LinkStage before reaching VM.
         // Encode same as Call for unlinked single-module test usage.
         CpsTerminator::CallExternal {
             import_handle,
             ret_block,
             ..
-        } => encode(
-            Opcode::Call as u8,
-            *import_handle as u32,
-            (*ret_block >> 8) as u32,
-            (*ret_block & 0xFF) as u32,
-        ),
+        } => encode_call(Opcode::Call, *import_handle, *ret_block),
         CpsTerminator::CallExternalDynamic { .. } => {
-            return Err("CallExternalDynamic not supported by VM (use LinkStage)".into())
+            Err("CallExternalDynamic not supported by VM (use LinkStage)".into())
         }
-    })
+    }
 }
 
 // ── tests ──
@@ -1640,6 +2261,7 @@ fn encode_term(term: &CpsTerminator) -> Result<u32, String> {
 #[allow(clippy::approx_constant)]
 mod tests {
     use super::*;
+    use std::collections::HashMap;
 
     fn simple_mod(
         instrs: Vec<CpsInstr>,
@@ -1685,6 +2307,35 @@ mod tests {
         assert_eq!(vm.execute(0, 3, None).unwrap(), 42);
     }
 
+    #[test]
+    fn load_const_reaches_past_the_src1_field() {
+        // 下标超过 src1 的 9 位时，高位落在 src2
+        let consts: Vec<Constant> = (0..70_000).map(Constant::Int).collect();
+        let m = simple_mod(
+            vec![
+                CpsInstr::LoadConst(0, 511),
+                CpsInstr::LoadConst(1, 512),
+                CpsInstr::LoadConst(2, 69_999),
+                CpsInstr::BinOp(3, CpsBinOp::AddInt, 0, 1),
+                CpsInstr::BinOp(3, CpsBinOp::AddInt, 3, 2),
+            ],
+            CpsTerminator::Return(3),
+            consts,
+            4,
+        );
+        let mut vm = VM::new();
+        vm.load(&m).unwrap();
+        assert_eq!(vm.execute(0, 3, None).unwrap(), 511 + 512 + 69_999);
+
+        let too_far = simple_mod(
+            vec![CpsInstr::LoadConst(0, MAX_CONSTS)],
+            CpsTerminator::Return(0),
+            vec![],
+            1,
+        );
+        assert!(VM::new().load(&too_far).is_err());
+    }
+
     #[test]
     fn test_div_zero() {
         let m = simple_mod(
@@ -1799,7 +2450,10 @@ mod tests {
         let mut vm = VM::new();
         vm.load(&m).unwrap();
         vm.execute(0, 1, None).unwrap();
-        assert!(!vm.output.is_empty(), "output should have print result");
+        assert!(
+            !vm.take_output().is_empty(),
+            "output should have print result"
+        );
     }
 
     #[test]
@@ -1859,21 +2513,23 @@ mod tests {
         }];
         // Alloc string at slot 0, alloc struct Foo at slot 1
         // SetField(value=r0, obj=r1, field=0) → set field 0 of struct to string
+        // (字符串常量是常驻槽位，不计数；这里用 IToS 造一个运行时字符串)
         let cps = simple_mod_with_structs(
             vec![
-                CpsInstr::LoadConst(0, 0), // r0 = "hello" string (heap slot 0, rc=1)
-                CpsInstr::NewStruct(1, 0, vec![]), // r1 = struct Foo (heap slot 1, rc=1)
-                CpsInstr::SetField(0, 1, 0, 0), // struct[r1].field[0] = r0 → retains r0
+                CpsInstr::LoadConst(0, 0),
+                CpsInstr::BinOp(0, CpsBinOp::IToS, 0, 0), // r0 = "7" string (heap slot 0, rc=1)
+                CpsInstr::NewStruct(1, 0, vec![]),        // r1 = struct Foo (heap slot 1, rc=1)
+                CpsInstr::SetField(0, 1, 0, 0),           // struct[r1].field[0] = r0 → retains r0
             ],
             CpsTerminator::Return(0), // return string ref
-            vec![Constant::String("hello".into())],
+            vec![Constant::Int(7)],
             structs,
             2,
         );
         let mut vm = VM::new();
         vm.load(&cps).unwrap();
         let result = vm.execute(0, 2, None).unwrap();
-        // r0 (string) should have rc=2: one from LoadConst, one from SetField retain
+        // r0 (string) should have rc=2: one from IToS, one from SetField retain
         assert_eq!(vm.heap.ref_count(result as usize), 2);
         assert_eq!(vm.heap.ref_count(0), 2);
         // struct at slot 1 should have rc=1
@@ -1889,37 +2545,36 @@ mod tests {
             fields: vec![("x".into(), "String".into())],
             type_bitmap: 0b01,
         }];
-        // 1. Load "hello" → r0 (slot 0)
-        // 2. Load "world" → r1 (slot 1)
+        // 1. "1" → r0 (slot 0)
+        // 2. "2" → r1 (slot 1)
         // 3. NewStruct → r2 (slot 2)
         // 4. SetField(value=r0, obj=r2, field=0) → slot0 rc 1→2
         // 5. SetField(value=r1, obj=r2, field=0) → slot0 released (rc 2→1), slot1 retained (rc 1→2)
         let cps = simple_mod_with_structs(
             vec![
-                CpsInstr::LoadConst(0, 0),         // r0 = "hello"
-                CpsInstr::LoadConst(1, 1),         // r1 = "world"
-                CpsInstr::NewStruct(2, 0, vec![]), // r2 = struct
-                CpsInstr::SetField(0, 2, 0, 0),    // struct.field0 = "hello"
-                CpsInstr::SetField(1, 2, 0, 0),    // struct.field0 = "world" (overwrites)
+                CpsInstr::LoadConst(0, 0),
+                CpsInstr::BinOp(0, CpsBinOp::IToS, 0, 0), // r0 = "1"
+                CpsInstr::LoadConst(1, 1),
+                CpsInstr::BinOp(1, CpsBinOp::IToS, 1, 1), // r1 = "2"
+                CpsInstr::NewStruct(2, 0, vec![]),        // r2 = struct
+                CpsInstr::SetField(0, 2, 0, 0),           // struct.field0 = "1"
+                CpsInstr::SetField(1, 2, 0, 0),           // struct.field0 = "2" (overwrites)
             ],
             CpsTerminator::Return(2), // return struct
-            vec![
-                Constant::String("hello".into()),
-                Constant::String("world".into()),
-            ],
+            vec![Constant::Int(1), Constant::Int(2)],
             structs,
             3,
         );
         let mut vm = VM::new();
         vm.load(&cps).unwrap();
         let _ = vm.execute(0, 3, None).unwrap();
-        // "hello" (slot 0) was released by overwrite → rc should be 1 (only LoadConst reference left)
+        // "1" (slot 0) was released by overwrite → rc should be 1 (only the register reference left)
         assert_eq!(
             vm.heap.ref_count(0),
             1,
             "old string should be released back to rc=1"
         );
-        // "world" (slot 1) was retained by SetField → rc should be 2
+        // "2" (slot 1) was retained by SetField → rc should be 2
         assert_eq!(
             vm.heap.ref_count(1),
             2,
@@ -2201,6 +2856,75 @@ mod tests {
         ));
     }
 
+    #[test]
+    fn math_intrinsics_match_std() {
+        let x = 2.75_f64;
+        let ops = [
+            (CpsUnOp::FSqrt, x.sqrt()),
+            (CpsUnOp::FSin, x.sin()),
+            (CpsUnOp::FCos, x.cos()),
+            (CpsUnOp::FFloor, x.floor()),
+            (CpsUnOp::FCeil, x.ceil()),
+        ];
+        for (op, expected) in ops {
+            let m = simple_mod(
+                vec![CpsInstr::LoadConst(0, 0), CpsInstr::UnOp(1, op, 0)],
+                CpsTerminator::Return(1),
+                vec![Constant::Float(x)],
+                2,
+            );
+            for mode in [DispatchMode::Decoded, DispatchMode::Encoded] {
+                let mut vm = VM::new();
+                vm.dispatch = mode;
+                vm.load(&m).unwrap();
+                let r = vm.execute(0, 2, None).unwrap();
+                assert_eq!(f64::from_bits(r as u64), expected, "{op:?} {mode:?}");
+            }
+        }
+    }
+
+    #[test]
+    fn native_args_come_from_the_register_window() {
+        // assert(r2)：实参寄存器不是 0，结果仍写回 r0
+        let m = CpsModule {
+            functions: vec![CpsFunction {
+                name: "main".into(),
+                blocks: vec![
+                    CpsBlock {
+                        id: 0,
+                        params: vec![],
+                        instrs: vec![CpsInstr::LoadConst(2, 0)],
+                        term: CpsTerminator::CallNative(2, vec![2], 1),
+                    },
+                    CpsBlock {
+                        id: 1,
+                        params: vec![],
+                        instrs: vec![],
+                        term: CpsTerminator::Return(0),
+                    },
+                ],
+                entry: 0,
+                reg_count: 3,
+            }],
+            constants: vec![Constant::Bool(true)],
+            structs: vec![],
+            enums: vec![],
+            vtables: vec![],
+            symbol_map: HashMap::new(),
+            func_owners: vec![],
+        };
+        let mut vm = VM::new();
+        vm.load(&m).unwrap();
+        assert_eq!(vm.execute(0, 3, None).unwrap(), 1);
+
+        let mut wide = m.clone();
+        wide.functions[0].blocks[0].term =
+            CpsTerminator::CallNative(2, vec![2; MAX_NATIVE_ARGS + 1], 1);
+        let mut vm = VM::new();
+        vm.load(&wide).unwrap();
+        assert!(matches!(vm.execute(0, 3, None), Err(RuntimeError::Bug(_))));
+    }
+
     #[test]
     fn test_index_out_of_bounds() {
         let cps = simple_mod(
@@ -2210,9 +2934,8 @@ mod tests {
             3,
         );
         let mut vm = VM::new();
-        vm.regs.regs[1] = vm.heap.alloc(HeapObj::List(vec![])) as u64;
         vm.load(&cps).unwrap();
-        vm.regs.regs[1] = 0;
+        vm.regs[1] = vm.heap.alloc(HeapObj::List(vec![])) as u64;
         assert!(matches!(
             vm.execute(0, 3, None),
             Err(RuntimeError::IndexOutOfBounds(_, _))
@@ -2323,6 +3046,26 @@ mod tests {
         assert_eq!(result, 42, "lambda should return 42");
     }
 
+    #[test]
+    fn call_reaches_past_256_functions() {
+        // 函数号的高位落在 src1，续体块号 300 跨过 src2 的 8 位
+        let mut cps = two_func_mod(vec![CpsInstr::LoadConst(0, 0)], CpsTerminator::Return(0), 1);
+        let mut main = cps.functions.pop().unwrap();
+        let filler = cps.functions[0].clone();
+        cps.functions.resize(1000, filler);
+        cps.constants = (0..1000).map(Constant::Int).collect();
+        cps.functions[999].blocks[0].instrs = vec![CpsInstr::LoadConst(0, 999)];
+        main.blocks[0].term = CpsTerminator::Call(999, vec![], 300);
+        main.blocks[1].id = 300;
+        cps.functions.push(main);
+        let mut vm = VM::new();
+        vm.load(&cps).unwrap();
+        assert_eq!(vm.execute(1000, 2, None).unwrap(), 999);
+
+        cps.functions[1000].blocks[0].term = CpsTerminator::Call(MAX_CALL_TARGETS, vec![], 300);
+        assert!(VM::new().load(&cps).is_err());
+    }
+
     #[test]
     fn vm_call_print_inside() {
         let cps = two_func_mod(
@@ -2333,10 +3076,11 @@ mod tests {
         let mut vm = VM::new();
         vm.load(&cps).unwrap();
         vm.execute(1, 2, None).unwrap();
+        let output = vm.take_output();
         assert!(
-            vm.output.iter().any(|s| s.contains("hi")),
+            output.iter().any(|s| s.contains("hi")),
             "print inside lambda: output={:?}",
-            vm.output
+            output
         );
     }
 
@@ -2416,13 +3160,14 @@ mod tests {
             fields: vec![("s".into(), "String".into())],
             type_bitmap: 0b01,
         }];
-        // Load "hi" → r0, NewStruct → r1, SetField(r0,r1,0), SetField(r0,r1,0) again.
-        // Self-assign must not corrupt ref-counts: string rc should be 2 (LoadConst + 1 retain from field)
+        // "5" → r0, NewStruct → r1, SetField(r0,r1,0), SetField(r0,r1,0) again.
+        // Self-assign must not corrupt ref-counts: string rc should be 2 (IToS + 1 retain from field)
         let instrs = vec![
-            CpsInstr::LoadConst(0, 0),         // r0 = "hi" (slot 0, rc=1)
-            CpsInstr::NewStruct(1, 0, vec![]), // r1 = struct (slot 1, rc=1)
-            CpsInstr::SetField(0, 1, 0, 0),    // retain: rc 1→2
-            CpsInstr::SetField(0, 1, 0, 0),    // self-assign: release-retain should cancel
+            CpsInstr::LoadConst(0, 0),
+            CpsInstr::BinOp(0, CpsBinOp::IToS, 0, 0), // r0 = "5" (slot 0, rc=1)
+            CpsInstr::NewStruct(1, 0, vec![]),        // r1 = struct (slot 1, rc=1)
+            CpsInstr::SetField(0, 1, 0, 0),           // retain: rc 1→2
+            CpsInstr::SetField(0, 1, 0, 0),           // self-assign: release-retain should cancel
         ];
         let cps = CpsModule {
             functions: vec![CpsFunction {
@@ -2436,7 +3181,7 @@ mod tests {
                 entry: 0,
                 reg_count: 2,
             }],
-            constants: vec![Constant::String("hi".into())],
+            constants: vec![Constant::Int(5)],
             structs,
             enums: vec![],
             vtables: vec![],
@@ -2446,7 +3191,7 @@ mod tests {
         let mut vm = VM::new();
         vm.load(&cps).unwrap();
         let result = vm.execute(0, 2, None).unwrap();
-        // String rc: LoadConst=1, SetField retain=+1, self-assign release=-1 then retain=+1 → net +1 → rc=2
+        // String rc: IToS=1, SetField retain=+1, self-assign release=-1 then retain=+1 → net +1 → rc=2
         assert_eq!(vm.heap.ref_count(0), 2, "string rc should be 2");
         assert_eq!(vm.heap.ref_count(1), 1, "struct rc should be 1");
         // Field still points to the string
@@ -2473,4 +3218,292 @@ mod tests {
         vm.load(&m).unwrap();
         assert_eq!(vm.execute(0, 3, None).unwrap(), 42);
     }
+
+    /// `rec(n) = n == 0 ? 0 : rec(n - 1) + 1`，main 调用 `rec(depth)`。
+    fn recursive_mod(depth: i64) -> CpsModule {
+        let block = |id, instrs, term| CpsBlock {
+            id,
+            params: vec![],
+            instrs,
+            term,
+        };
+        let rec = CpsFunction {
+            name: "rec".into(),
+            blocks: vec![
+                block(
+                    0,
+                    vec![
+                        CpsInstr::LoadConst(1, 0),
+                        CpsInstr::BinOp(2, CpsBinOp::EqInt, 0, 1),
+                    ],
+                    CpsTerminator::Branch(2, 1, vec![], 2, vec![]),
+                ),
+                block(1, vec![], CpsTerminator::Return(0)),
+                block(
+                    2,
+                    vec![
+                        CpsInstr::LoadConst(3, 1),
+                        CpsInstr::BinOp(4, CpsBinOp::SubInt, 0, 3),
+                    ],
+                    CpsTerminator::Call(0, vec![4], 3),
+                ),
+                block(
+                    3,
+                    vec![
+                        CpsInstr::LoadConst(5, 1),
+                        CpsInstr::BinOp(6, CpsBinOp::AddInt, 0, 5),
+                    ],
+                    CpsTerminator::Return(6),
+                ),
+            ],
+            entry: 0,
+            reg_count: 7,
+        };
+        let main = CpsFunction {
+            name: "main".into(),
+            blocks: vec![
+                block(
+                    0,
+                    vec![CpsInstr::LoadConst(0, 2)],
+                    CpsTerminator::Call(0, vec![0], 1),
+                ),
+                block(1, vec![], CpsTerminator::Return(0)),
+            ],
+            entry: 0,
+            reg_count: 1,
+        };
+        CpsModule {
+            functions: vec![rec, main],
+            constants: vec![Constant::Int(0), Constant::Int(1), Constant::Int(depth)],
+            structs: vec![],
+            enums: vec![],
+            vtables: vec![],
+            symbol_map: HashMap::new(),
+            func_owners: vec![],
+        }
+    }
+
+    #[test]
+    fn deep_recursion_shares_one_register_stack() {
+        let mut vm = VM::new();
+        vm.load(&recursive_mod(5000)).unwrap();
+        assert_eq!(vm.execute(1, 1, None).unwrap(), 5000);
+        assert!(vm.frames.is_empty());
+        // rec(5000)..rec(0) 每层一个 7 寄存器窗口，叠在 main 的 1 个寄存器之后；
+        // 返回后截断回 main 的窗口，容量保留
+        assert_eq!(vm.regs.stack.len(), 1);
+        assert!(vm.regs.stack.capacity() > 5001 * 7);
+    }
+
+    #[test]
+    fn stack_limit_is_measured_in_bytes() {
+        let frame = 7 * std::mem::size_of::<u64>() + std::mem::size_of::<CallFrame>();
+        let mut vm = VM::new();
+        // 恰好容纳 rec(9)..rec(0) 十层
+        vm.max_stack_bytes = 8 + 10 * frame;
+        vm.load(&recursive_mod(9)).unwrap();
+        assert_eq!(vm.execute(1, 1, None).unwrap(), 9);
+        vm.load(&recursive_mod(10)).unwrap();
+        assert!(matches!(
+            vm.execute(1, 1, None),
+            Err(RuntimeError::StackOverflow)
+        ));
+        // 溢出后再次执行从栈底重新开始
+        vm.load(&recursive_mod(3)).unwrap();
+        assert_eq!(vm.execute(1, 1, None).unwrap(), 3);
+    }
+
+    #[test]
+    fn calls_consume_fuel() {
+        // main → rec(20) → … → rec(0)：共 21 次调用
+        let mut vm = VM::new();
+        vm.max_loop_iterations = 21;
+        vm.load(&recursive_mod(20)).unwrap();
+        assert_eq!(vm.execute(1, 1, None).unwrap(), 20);
+        vm.max_loop_iterations = 20;
+        // 没有循环：在第 21 次调用（进入 rec）时耗尽
+        assert!(matches!(
+            vm.execute(1, 1, None),
+            Err(RuntimeError::CallLimitExceeded {
+                func_idx: 0,
+                limit: 20
+            })
+        ));
+    }
+
+    #[test]
+    fn host_interleaves_yielding_scripts() {
+        let mut a = VM::new();
+        let mut b = VM::new();
+        for (vm, depth) in [(&mut a, 30), (&mut b, 12)] {
+            vm.time_slice = 4;
+            vm.load(&recursive_mod(depth)).unwrap();
+        }
+        let mut ca = a.start(1, None).unwrap();
+        let mut cb = b.start(1, None).unwrap();
+        let mut rounds = 0;
+        while ca == Completion::Yielded || cb == Completion::Yielded {
+            if ca == Completion::Yielded {
+                ca = a.resume(None).unwrap();
+            }
+            if cb == Completion::Yielded {
+                cb = b.resume(None).unwrap();
+            }
+            rounds += 1;
+        }
+        assert_eq!((ca, cb), (Completion::Done(30), Completion::Done(12)));
+        // 31 次调用 / 每片 4 次
+        assert_eq!(rounds, 7);
+        assert!(matches!(a.resume(None), Err(RuntimeError::Bug(_))));
+    }
+
+    #[test]
+    fn set_time_slice_applies_to_the_next_resume() {
+        let mut vm = VM::new();
+        vm.time_slice = 4;
+        vm.load(&recursive_mod(30)).unwrap();
+        assert_eq!(vm.start(1, None).unwrap(), Completion::Yielded);
+        let used = vm.fuel_used();
+        vm.set_time_slice(u64::MAX);
+        assert_eq!(vm.fuel_used(), used);
+        assert_eq!(vm.resume(None).unwrap(), Completion::Done(30));
+
+        vm.time_slice = 4;
+        assert_eq!(vm.start(1, None).unwrap(), Completion::Yielded);
+        vm.set_time_slice(8);
+        let mut rounds = 1;
+        while vm.resume(None).unwrap() == Completion::Yielded {
+            rounds += 1;
+        }
+        // 一直每片 4 次要 8 片（见上一个测试），续跑前改成 8 次只要一半
+        assert_eq!(rounds, 4);
+    }
+
+    #[test]
+    fn string_literals_in_loops_reuse_one_pinned_slot() {
+        let block = |id, instrs, term| CpsBlock {
+            id,
+            params: vec![],
+            instrs,
+            term,
+        };
+        let m = CpsModule {
+            functions: vec![CpsFunction {
+                name: "main".into(),
+                blocks: vec![
+                    block(
+                        0,
+                        vec![CpsInstr::LoadConst(0, 0)],
+                        CpsTerminator::Jump(1, vec![]),
+                    ),
+                    block(
+                        1,
+                        vec![
+                            CpsInstr::LoadConst(1, 1),
+                            CpsInstr::LoadConst(2, 2),
+                            CpsInstr::BinOp(3, CpsBinOp::LtInt, 0, 2),
+                        ],
+                        CpsTerminator::Branch(3, 2, vec![], 3, vec![]),
+                    ),
+                    block(
+                        2,
+                        vec![
+                            CpsInstr::LoadConst(4, 3),
+                            CpsInstr::BinOp(0, CpsBinOp::AddInt, 0, 4),
+                        ],
+                        CpsTerminator::Jump(1, vec![]),
+                    ),
+                    block(3, vec![CpsInstr::Print(1)], CpsTerminator::Return(1)),
+                ],
+                entry: 0,
+                reg_count: 5,
+            }],
+            constants: vec![
+                Constant::Int(0),
+                Constant::String("tick".into()),
+                Constant::Int(100),
+                Constant::Int(1),
+                Constant::String("tick".into()),
+            ],
+            structs: vec![],
+            enums: vec![],
+            vtables: vec![],
+            symbol_map: HashMap::new(),
+            func_owners: vec![],
+        };
+        for mode in [DispatchMode::Decoded, DispatchMode::Encoded] {
+            let mut vm = VM::new();
+            vm.dispatch = mode;
+            vm.load(&m).unwrap();
+            // 相同内容的常量驻留为同一个槽位
+            assert_eq!(vm.program.const_bits[1], vm.program.const_bits[4]);
+            let slots = vm.heap.slot_count();
+            let r = vm.execute(0, 5, None).unwrap();
+            assert_eq!(r as u64, vm.program.const_bits[1], "{mode:?}");
+            assert_eq!(vm.heap.slot_count(), slots, "{mode:?}");
+            assert_eq!(vm.take_output(), vec!["tick".to_string()]);
+            // 重新加载不再分配
+            vm.load(&m).unwrap();
+            assert_eq!(vm.heap.slot_count(), slots);
+        }
+    }
+
+    #[test]
+    fn backup_collector_runs_at_back_edges() {
+        // while (i < n) { box(i) } — 每次迭代一个无人引用的对象
+        let block = |id, instrs, term| CpsBlock {
+            id,
+            params: vec![],
+            instrs,
+            term,
+        };
+        let n = (crate::gc_heap::GC_MIN_THRESHOLD + 10) as i64;
+        let m = CpsModule {
+            functions: vec![CpsFunction {
+                name: "main".into(),
+                blocks: vec![
+                    block(
+                        0,
+                        vec![CpsInstr::LoadConst(0, 0), CpsInstr::LoadConst(1, 1)],
+                        CpsTerminator::Jump(1, vec![]),
+                    ),
+                    block(
+                        1,
+                        vec![CpsInstr::BinOp(2, CpsBinOp::LtInt, 0, 1)],
+                        CpsTerminator::Branch(2, 2, vec![], 3, vec![]),
+                    ),
+                    block(
+                        2,
+                        vec![
+                            CpsInstr::Box(3, 0),
+                            CpsInstr::LoadConst(4, 2),
+                            CpsInstr::BinOp(0, CpsBinOp::AddInt, 0, 4),
+                        ],
+                        CpsTerminator::Jump(1, vec![]),
+                    ),
+                    block(3, vec![], CpsTerminator::Return(3)),
+                ],
+                entry: 0,
+                reg_count: 5,
+            }],
+            constants: vec![Constant::Int(0), Constant::Int(n), Constant::Int(1)],
+            structs: vec![],
+            enums: vec![],
+            vtables: vec![],
+            symbol_map: HashMap::new(),
+            func_owners: vec![],
+        };
+        let mut vm = VM::new();
+        vm.load(&m).unwrap();
+        let last = vm.execute(0, 5, None).unwrap();
+        let stats = vm.heap.stats();
+        assert_eq!(stats.allocations, n as u64);
+        assert_eq!(stats.collections, 1);
+        assert!(stats.live_objects < 20, "{stats:?}");
+        // 最后一个对象仍在寄存器里，不能被回收
+        match vm.heap_get(last).unwrap() {
+            HeapObj::Struct(_, f) => assert_eq!(f[0], n - 1),
+            other => panic!("expected box, got {other:?}"),
+        }
+    }
 }
@@ -0,0 +1,100 @@
+//! 结构体 / 枚举变体的字段存储 — 小对象字段内联在堆槽位里
+//!
+//! 字段数 ≤ `INLINE_FIELDS` 时直接存在 `Fields` 内部，不再为每个对象额外
+//! 分配一个 `Vec`；更多字段溢出到一块定长的 `Box<[i64]>`（没有 `Vec` 的容量余量）。
+//! 两种形态都只有 24 字节，与原来的 `Vec<i64>` 一样大，`HeapObj` 槽位尺寸不变。
+
+use std::fmt;
+use std::ops::{Deref, DerefMut};
+
+/// 内联存储的最大字段数。
+pub const INLINE_FIELDS: usize = 2;
+
+#[derive(Clone)]
+pub enum Fields {
+    Inline { len: u8, data: [i64; INLINE_FIELDS] },
+    Spilled(Box<[i64]>),
+}
+
+impl Fields {
+    /// `len` 个字段，第 `i` 个初始化为 `init(i)`。
+    pub fn from_fn(len: usize, init: impl Fn(usize) -> i64) -> Self {
+        if len <= INLINE_FIELDS {
+            let mut data = [0; INLINE_FIELDS];
+            for (i, f) in data.iter_mut().enumerate().take(len) {
+                *f = init(i);
+            }
+            Fields::Inline {
+                len: len as u8,
+                data,
+            }
+        } else {
+            Fields::Spilled((0..len).map(init).collect())
+        }
+    }
+
+    /// 字段是否内联在槽位里。
+    pub fn is_inline(&self) -> bool {
+        matches!(self, Fields::Inline { .. })
+    }
+}
+
+impl Deref for Fields {
+    type Target = [i64];
+
+    #[inline(always)]
+    fn deref(&self) -> &[i64] {
+        match self {
+            Fields::Inline { len, data } => &data[..*len as usize],
+            Fields::Spilled(b) => b,
+        }
+    }
+}
+
+impl DerefMut for Fields {
+    #[inline(always)]
+    fn deref_mut(&mut self) -> &mut [i64] {
+        match self {
+            Fields::Inline { len, data } => &mut data[..*len as usize],
+            Fields::Spilled(b) => b,
+        }
+    }
+}
+
+impl From<Vec<i64>> for Fields {
+    fn from(v: Vec<i64>) -> Self {
+        Fields::from_fn(v.len(), |i| v[i])
+    }
+}
+
+impl fmt::Debug for Fields {
+    fn fmt(&self, f: &mut fmt::Formatter<'_>) -> fmt::Result {
+        f.debug_list().entries(self.iter()).finish()
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn small_field_lists_stay_inline() {
+        let f = Fields::from_fn(2, |i| i as i64 + 10);
+        assert!(f.is_inline());
+        assert_eq!(&f[..], &[10, 11]);
+        assert!(Fields::from_fn(0, |_| 0).is_empty());
+
+        let mut big = Fields::from(vec![1, 2, 3]);
+        assert!(!big.is_inline());
+        big[2] = 7;
+        assert_eq!(&big[..], &[1, 2, 7]);
+    }
+
+    #[test]
+    fn fields_are_no_larger_than_a_vec() {
+        assert_eq!(
+            std::mem::size_of::<Fields>(),
+            std::mem::size_of::<Vec<i64>>()
+        );
+    }
+}
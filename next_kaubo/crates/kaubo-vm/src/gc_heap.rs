@@ -1,11 +1,51 @@
+//! 堆 — 引用计数为主，备用标记清除回收环
+//!
+//! 对象平铺在 `slots` 里：空闲链表优先复用，否则在末尾追加。引用计数回收不了
+//! 结构体 / 列表 / 闭包之间的环，所以自上次回收以来的分配数达到阈值时，VM 在
+//! 安全点（回边、调用）调用 `collect` 做一次标记清除。
+
+use crate::execute::HeapObj;
+use std::collections::HashMap;
+
+/// 常驻对象的引用计数哨兵：`retain` / `release` 跳过，槽位永不回收。
+const IMMORTAL: u32 = u32::MAX;
+
+/// 两次回收之间至少的分配次数。之后阈值取上次回收后的存活数，回收摊还 O(1)。
+pub const GC_MIN_THRESHOLD: usize = 1 << 16;
+
 pub struct GcHeap {
     slots: Vec<GcSlot>,
     free_list: Vec<usize>,
+    /// 字符串驻留表：内容 → 常驻槽位。
+    interned: HashMap<Box<str>, usize>,
+    /// 存活对象数（含常驻对象）。
+    live: usize,
+    /// 自上次回收以来的分配次数。
+    allocs_since_gc: usize,
+    gc_threshold: usize,
+    allocations: u64,
+    collections: u64,
+    collected: u64,
+}
+
+/// 堆的运行统计，供监控采集。
+#[derive(Debug, Clone, Copy, Default, PartialEq, Eq)]
+pub struct HeapStats {
+    /// 存活对象数。
+    pub live_objects: usize,
+    /// 槽位数组加上存活对象自有缓冲的字节数（按容量估算）。
+    pub live_bytes: usize,
+    /// 累计分配次数。
+    pub allocations: u64,
+    /// 标记清除次数。
+    pub collections: u64,
+    /// 标记清除累计回收的对象数。
+    pub collected_objects: u64,
 }
 
 struct GcSlot {
     rc: u32,
-    obj: Option<crate::execute::HeapObj>,
+    obj: Option<HeapObj>,
 }
 
 impl Default for GcHeap {
@@ -19,10 +59,50 @@ impl GcHeap {
         GcHeap {
             slots: Vec::new(),
             free_list: Vec::new(),
+            interned: HashMap::new(),
+            live: 0,
+            allocs_since_gc: 0,
+            gc_threshold: GC_MIN_THRESHOLD,
+            allocations: 0,
+            collections: 0,
+            collected: 0,
         }
     }
 
-    pub fn alloc(&mut self, obj: crate::execute::HeapObj) -> usize {
+    /// 清空所有对象（包括常驻字符串）和统计，保留已分配的容量。
+    pub fn reset(&mut self) {
+        self.slots.clear();
+        self.free_list.clear();
+        self.interned.clear();
+        self.live = 0;
+        self.allocs_since_gc = 0;
+        self.gc_threshold = GC_MIN_THRESHOLD;
+        self.allocations = 0;
+        self.collections = 0;
+        self.collected = 0;
+    }
+
+    /// 返回内容为 `s` 的常驻字符串槽位，相同内容只分配一次。
+    ///
+    /// 常驻槽位不参与引用计数，持有者无需 retain / release；调用方不得原地修改。
+    pub fn intern(&mut self, s: &str) -> usize {
+        if let Some(&idx) = self.interned.get(s) {
+            return idx;
+        }
+        let idx = self.alloc(HeapObj::String(s.to_string()));
+        self.slots[idx].rc = IMMORTAL;
+        self.interned.insert(s.into(), idx);
+        idx
+    }
+
+    pub fn is_immortal(&self, idx: usize) -> bool {
+        self.slots.get(idx).is_some_and(|s| s.rc == IMMORTAL)
+    }
+
+    pub fn alloc(&mut self, obj: HeapObj) -> usize {
+        self.live += 1;
+        self.allocs_since_gc += 1;
+        self.allocations += 1;
         if let Some(idx) = self.free_list.pop() {
             self.slots[idx] = GcSlot {
                 rc: 1,
@@ -39,7 +119,8 @@ impl GcHeap {
     }
 
     pub fn retain(&mut self, idx: usize) {
-        if idx < self.slots.len() && self.slots[idx].obj.is_some() {
+        if idx < self.slots.len() && self.slots[idx].obj.is_some() && self.slots[idx].rc != IMMORTAL
+        {
             self.slots[idx].rc += 1;
         }
     }
@@ -48,38 +129,217 @@ impl GcHeap {
         if idx >= self.slots.len() {
             return;
         }
-        if self.slots[idx].obj.is_none() {
+        if self.slots[idx].obj.is_none() || self.slots[idx].rc == IMMORTAL {
             return;
         }
         self.slots[idx].rc -= 1;
         if self.slots[idx].rc == 0 {
-            self.slots[idx].obj = None;
+            let obj = self.slots[idx].obj.take();
             self.free_list.push(idx);
+            self.live -= 1;
+            // 追加缓冲归它的切片共同持有
+            if let Some(HeapObj::StrSlice { buf, .. }) = obj {
+                self.release(buf);
+            }
         }
     }
 
-    pub fn get(&self, idx: usize) -> &crate::execute::HeapObj {
+    /// 字符串值的内容；`idx` 不是字符串时返回 `None`。
+    pub fn get_str(&self, idx: usize) -> Option<&str> {
+        let (slot, len) = self.str_backing(idx)?;
+        match self.try_get(slot)? {
+            HeapObj::String(s) | HeapObj::StrBuf(s) => Some(&s[..len]),
+            _ => None,
+        }
+    }
+
+    /// 字符串值的底层存储：`(存放内容的槽位, 字节长度)`。
+    fn str_backing(&self, idx: usize) -> Option<(usize, usize)> {
+        match self.try_get(idx)? {
+            HeapObj::String(s) | HeapObj::StrBuf(s) => Some((idx, s.len())),
+            HeapObj::StrSlice { buf, len } => Some((*buf, *len)),
+            _ => None,
+        }
+    }
+
+    /// 拼接两个字符串值，返回新值的槽位；任一侧不是字符串时返回 `None`。
+    ///
+    /// 左值恰好是某个追加缓冲的末端时原地追加，新值与左值共享缓冲（左值仍只看到
+    /// 自己的前缀）；否则先把左值复制进一个新缓冲。循环里反复 `s = s + x` 因此是线性的。
+    pub fn concat(&mut self, lhs: usize, rhs: usize) -> Option<usize> {
+        let (lslot, llen) = self.str_backing(lhs)?;
+        let (rslot, rlen) = self.str_backing(rhs)?;
+        let at_tip = matches!(
+            &self.slots[lslot].obj,
+            Some(HeapObj::StrBuf(s)) if s.len() == llen
+        );
+        let buf = if at_tip {
+            self.retain(lslot);
+            lslot
+        } else {
+            let mut s = String::with_capacity((llen + rlen) * 2);
+            s.push_str(self.get_str(lhs)?);
+            self.alloc(HeapObj::StrBuf(s))
+        };
+        self.append_from(buf, rslot, rlen);
+        Some(self.alloc(HeapObj::StrSlice {
+            buf,
+            len: llen + rlen,
+        }))
+    }
+
+    /// 把槽位 `src` 的前 `len` 字节追加到缓冲 `buf` 末尾（`src` 可以就是 `buf`）。
+    fn append_from(&mut self, buf: usize, src: usize, len: usize) {
+        if buf == src {
+            if let Some(HeapObj::StrBuf(s)) = &mut self.slots[buf].obj {
+                s.extend_from_within(..len);
+            }
+            return;
+        }
+        let (dst, src) = if buf < src {
+            let (lo, hi) = self.slots.split_at_mut(src);
+            (&mut lo[buf], &hi[0])
+        } else {
+            let (lo, hi) = self.slots.split_at_mut(buf);
+            (&mut hi[0], &lo[src])
+        };
+        if let (Some(HeapObj::StrBuf(d)), Some(HeapObj::String(s) | HeapObj::StrBuf(s))) =
+            (&mut dst.obj, &src.obj)
+        {
+            d.push_str(&s[..len]);
+        }
+    }
+
+    pub fn get(&self, idx: usize) -> &HeapObj {
         self.slots[idx]
             .obj
             .as_ref()
             .expect("gc_heap: get on empty slot")
     }
 
-    pub fn get_mut(&mut self, idx: usize) -> &mut crate::execute::HeapObj {
+    pub fn get_mut(&mut self, idx: usize) -> &mut HeapObj {
         self.slots[idx]
             .obj
             .as_mut()
             .expect("gc_heap: get_mut on empty slot")
     }
 
-    pub fn try_get(&self, idx: usize) -> Option<&crate::execute::HeapObj> {
+    pub fn try_get(&self, idx: usize) -> Option<&HeapObj> {
         self.slots.get(idx).and_then(|s| s.obj.as_ref())
     }
 
+    /// 自上次回收以来的分配是否已达到阈值。
+    #[inline(always)]
+    pub fn should_collect(&self) -> bool {
+        self.allocs_since_gc >= self.gc_threshold
+    }
+
+    /// 标记清除一次，返回回收的对象数。
+    ///
+    /// 寄存器不带类型，`roots` 里每个落在存活槽位上的值都当作句柄（保守扫描）。
+    /// 对象字段同样保守扫描：`struct_bitmaps` 把闭包、泛型等类型未知的字段
+    /// 记为非堆，`Box` 又借用 struct id 0，位图不足以证明某个字段不是句柄。
+    /// 多保留一些对象是安全的，漏标才会出错。常驻对象从不回收。
+    pub fn collect(&mut self, roots: impl IntoIterator<Item = u64>) -> usize {
+        let mut marked = vec![false; self.slots.len()];
+        let mut stack = Vec::new();
+        let slots = &self.slots;
+        let mut mark = |v: u64, stack: &mut Vec<usize>| {
+            let i = v as usize;
+            if i < slots.len() && !marked[i] && slots[i].obj.is_some() {
+                marked[i] = true;
+                stack.push(i);
+            }
+        };
+        for v in roots {
+            mark(v, &mut stack);
+        }
+        while let Some(i) = stack.pop() {
+            if let Some(obj) = &slots[i].obj {
+                for_each_ref(obj, |v| mark(v, &mut stack));
+            }
+        }
+
+        let mut freed = 0;
+        for (i, slot) in self.slots.iter_mut().enumerate() {
+            if slot.obj.is_some() && !marked[i] && slot.rc != IMMORTAL {
+                slot.obj = None;
+                self.free_list.push(i);
+                freed += 1;
+            }
+        }
+        self.live -= freed;
+        self.allocs_since_gc = 0;
+        self.gc_threshold = self.live.max(GC_MIN_THRESHOLD);
+        self.collections += 1;
+        self.collected += freed as u64;
+        freed
+    }
+
+    pub fn stats(&self) -> HeapStats {
+        let owned: usize = self
+            .slots
+            .iter()
+            .filter_map(|s| s.obj.as_ref())
+            .map(owned_bytes)
+            .sum();
+        HeapStats {
+            live_objects: self.live,
+            live_bytes: self.slots.capacity() * std::mem::size_of::<GcSlot>() + owned,
+            allocations: self.allocations,
+            collections: self.collections,
+            collected_objects: self.collected,
+        }
+    }
+
     #[cfg(test)]
     pub fn ref_count(&self, idx: usize) -> u32 {
         self.slots[idx].rc
     }
+
+    #[cfg(test)]
+    pub fn slot_count(&self) -> usize {
+        self.slots.len()
+    }
+}
+
+/// 对象里每个可能是句柄的值。
+fn for_each_ref(obj: &HeapObj, mut f: impl FnMut(u64)) {
+    match obj {
+        HeapObj::Struct(_, fields) | HeapObj::Variant(_, _, fields) => {
+            fields.iter().for_each(|&v| f(v as u64))
+        }
+        HeapObj::List(items) => items.iter().for_each(|&v| f(v as u64)),
+        HeapObj::Closure(c) => c.upvalues.iter().for_each(|&v| f(v as u64)),
+        HeapObj::TupleObj(items) => items.iter().for_each(|&v| f(v as u64)),
+        HeapObj::InterfaceObj { data, .. } => f(*data as u64),
+        HeapObj::StrSlice { buf, .. } => f(*buf as u64),
+        HeapObj::String(_)
+        | HeapObj::StrBuf(_)
+        | HeapObj::Int64Array(_)
+        | HeapObj::Float64Array(_) => {}
+    }
+}
+
+/// 对象在槽位之外自有的堆字节数。
+fn owned_bytes(obj: &HeapObj) -> usize {
+    const W: usize = std::mem::size_of::<i64>();
+    match obj {
+        HeapObj::String(s) | HeapObj::StrBuf(s) => s.capacity(),
+        HeapObj::Struct(_, fields) | HeapObj::Variant(_, _, fields) => {
+            if fields.is_inline() {
+                0
+            } else {
+                fields.len() * W
+            }
+        }
+        HeapObj::List(items) => items.capacity() * W,
+        HeapObj::Closure(c) => std::mem::size_of_val(&**c) + c.upvalues.capacity() * W,
+        HeapObj::TupleObj(items) => items.capacity() * W,
+        HeapObj::Int64Array(items) => items.capacity() * W,
+        HeapObj::Float64Array(items) => items.capacity() * W,
+        HeapObj::StrSlice { .. } | HeapObj::InterfaceObj { .. } => 0,
+    }
 }
 
 #[cfg(test)]
@@ -88,7 +348,7 @@ mod tests {
     use crate::execute::HeapObj;
 
     fn int_obj(n: i64) -> HeapObj {
-        HeapObj::Struct(0, vec![n])
+        HeapObj::Struct(0, vec![n].into())
     }
     fn str_obj(s: &str) -> HeapObj {
         HeapObj::String(s.to_string())
@@ -229,7 +489,7 @@ mod tests {
     #[test]
     fn t14_struct_heap_object() {
         let mut heap = GcHeap::new();
-        let idx = heap.alloc(HeapObj::Struct(42, vec![100, 200]));
+        let idx = heap.alloc(HeapObj::Struct(42, vec![100, 200].into()));
         match heap.get(idx) {
             HeapObj::Struct(id, vals) => {
                 assert_eq!(*id, 42);
@@ -255,4 +515,109 @@ mod tests {
             _ => panic!("expected Closure"),
         }
     }
+
+    #[test]
+    fn t16_interned_strings_are_shared_and_immortal() {
+        let mut heap = GcHeap::new();
+        let a = heap.intern("lit");
+        assert_eq!(heap.intern("lit"), a);
+        assert_ne!(heap.intern("other"), a);
+        assert!(heap.is_immortal(a));
+        heap.retain(a);
+        heap.release(a);
+        heap.release(a);
+        match heap.get(a) {
+            HeapObj::String(s) => assert_eq!(s, "lit"),
+            _ => panic!("expected String"),
+        }
+        // 常驻槽位不会进 free_list 被复用
+        assert_ne!(heap.alloc(str_obj("fresh")), a);
+    }
+
+    #[test]
+    fn t17_concat_appends_in_place_at_the_tip() {
+        let mut heap = GcHeap::new();
+        let a = heap.alloc(str_obj("ab"));
+        let c = heap.intern("c");
+        let abc = heap.concat(a, c).unwrap();
+        let abcc = heap.concat(abc, c).unwrap();
+        assert_eq!(heap.get_str(abc), Some("abc"));
+        assert_eq!(heap.get_str(abcc), Some("abcc"));
+        // 第二次拼接直接追加进第一次建立的缓冲
+        let buf = match heap.get(abc) {
+            HeapObj::StrSlice { buf, .. } => *buf,
+            _ => panic!("expected StrSlice"),
+        };
+        assert!(matches!(heap.get(abcc), HeapObj::StrSlice { buf: b, len: 4 } if *b == buf));
+        assert_eq!(heap.ref_count(buf), 2);
+
+        // 从旧前缀分叉时复制，不破坏已有的值
+        let x = heap.intern("x");
+        let abx = heap.concat(abc, x).unwrap();
+        assert_eq!(heap.get_str(abx), Some("abcx"));
+        assert_eq!(heap.get_str(abcc), Some("abcc"));
+
+        // 自拼接：右值就在同一个缓冲里
+        let twice = heap.concat(abcc, abcc).unwrap();
+        assert_eq!(heap.get_str(twice), Some("abccabcc"));
+
+        let n = heap.alloc(int_obj(1));
+        assert_eq!(heap.concat(a, n), None);
+    }
+
+    #[test]
+    fn t18_buffer_freed_with_its_last_slice() {
+        let mut heap = GcHeap::new();
+        let a = heap.alloc(str_obj("a"));
+        let ab = heap.concat(a, a).unwrap();
+        let abb = heap.concat(ab, a).unwrap();
+        let buf = match heap.get(ab) {
+            HeapObj::StrSlice { buf, .. } => *buf,
+            _ => panic!("expected StrSlice"),
+        };
+        heap.release(ab);
+        assert!(heap.try_get(buf).is_some());
+        heap.release(abb);
+        assert!(heap.try_get(buf).is_none());
+    }
+
+    #[test]
+    fn t19_collect_frees_unreachable_cycles() {
+        let mut heap = GcHeap::new();
+        let lit = heap.intern("lit");
+        // a ⇄ b：引用计数永远不会归零
+        let a = heap.alloc(HeapObj::Struct(0, vec![-1].into()));
+        let b = heap.alloc(HeapObj::Struct(0, vec![a as i64].into()));
+        if let HeapObj::Struct(_, f) = heap.get_mut(a) {
+            f[0] = b as i64;
+        }
+        let kept = heap.alloc(HeapObj::List(vec![-5, i64::MAX]));
+
+        // 不是存活槽位的值（负数、越界）都被忽略
+        assert_eq!(heap.collect([a as u64, kept as u64, u64::MAX]), 0);
+        assert_eq!(heap.collect([kept as u64]), 2);
+        assert!(heap.try_get(a).is_none() && heap.try_get(b).is_none());
+        assert!(heap.try_get(kept).is_some());
+        assert!(heap.is_immortal(lit));
+
+        let stats = heap.stats();
+        assert_eq!(stats.live_objects, 2);
+        assert_eq!(stats.allocations, 4);
+        assert_eq!((stats.collections, stats.collected_objects), (2, 2));
+        // 回收的槽位被复用
+        assert!([a, b].contains(&heap.alloc(int_obj(1))));
+    }
+
+    #[test]
+    fn t20_collection_is_triggered_by_allocation_volume() {
+        let mut heap = GcHeap::new();
+        for i in 0..GC_MIN_THRESHOLD {
+            assert!(!heap.should_collect());
+            heap.alloc(int_obj(i as i64));
+        }
+        assert!(heap.should_collect());
+        heap.collect([]);
+        assert!(!heap.should_collect());
+        assert_eq!(heap.stats().live_objects, 0);
+    }
 }
@@ -0,0 +1,703 @@
+//! 预编译程序映像 — `KAUB` v2：把 `LoadedProgram` 的平铺表原样落盘
+//!
+//! v1（`kaubo_ir::pass::binary`）存的是 `CpsModule`，加载时要逐字段解析、重新编码
+//! 指令、重算块起点和边移动表。v2 直接存这些结果：
+//!
+//! ```text
+//! 0    "KAUB"  version = 2 (u32)  段数 (u32)  0 (u32)
+//! 16   段表：每段 (offset u32, len u32)，顺序固定，见 `Section`
+//! ..   各段数据，起点 8 字节对齐，全部小端
+//! ```
+//!
+//! 段内都是定长记录的数组，加载时每段整块转成对应的表：不建 `CpsModule`，不逐块
+//! 分配。字符串（常量、函数名、归属模块、vtable）集中在一个字节区，按编号引用；
+//! 前 `string_slots` 个就是常驻字符串槽位（`LoadedProgram::strings`）。
+//!
+//! 预解码不落盘：它随 `decode` 的实现变化，而且按函数在首次执行时才做
+//! （`LoadedProgram::decoded`），没调用到的函数不付加载代价。
+//!
+//! 对齐和小端让映像可以直接 mmap 后读取；`from_image` 目前把每段复制进
+//! `LoadedProgram` 自己的表，由所有隔离区共享这一份。
+
+use crate::edges::{EdgeSpan, RegMove};
+use crate::program::LoadedProgram;
+use kaubo_cps::{Constant, VtableDef};
+use std::ops::Range;
+
+const MAGIC: &[u8; 4] = b"KAUB";
+/// 映像格式版本（v1 是 `kaubo_ir` 的 `CpsModule` 序列化）。
+pub const VERSION: u32 = 2;
+const HEADER: usize = 16;
+const ALIGN: usize = 8;
+
+/// 段的固定顺序，也是段表里的下标。
+#[derive(Clone, Copy)]
+enum Section {
+    /// u32: 常驻字符串槽位数、内联缓存调用点数
+    Meta,
+    /// 每个字符串 (start u32, len u32)，指向 `Arena`
+    Strings,
+    Arena,
+    /// 每个常量一个 u8 标签（与 v1 相同：0 Int / 1 Float / 2 String / 3 Bool / 4 Null）
+    ConstTags,
+    /// 每个常量的寄存器位模式（u64，`LoadedProgram::const_bits`）
+    ConstBits,
+    /// 每个函数 `FUNC_WORDS` 个 u32
+    Funcs,
+    /// 每个函数归属模块的字符串编号（u32，可为空表）
+    Owners,
+    /// 每个块 (start u32, len u32)，按 `func_block_base` 平铺
+    Blocks,
+    /// 每个块参数在 `ParamPool` 中的 (start u32, len u32)
+    BlockParams,
+    ParamPool,
+    Instrs,
+    /// 每条指令 (start, len, alt_len) 三个 u32
+    EdgeSpans,
+    /// 每个移动 (dst u32, src u32)
+    EdgeMoves,
+    IcSites,
+    /// 每个结构体 id (位图 u64, 字段数 u64)
+    Structs,
+    /// 每个枚举 id 在 `Variants` 中的 (start u32, len u32)
+    Enums,
+    /// 每个变体 (位图 u64, 字段数 u64)
+    Variants,
+    /// 每个 vtable (接口名 u32, 结构体名 u32, 方法 start u32, 方法数 u32)
+    Vtables,
+    /// 每个方法 (名字 u32, 函数号 u32)
+    Methods,
+}
+
+const SECTIONS: usize = Section::Methods as usize + 1;
+/// 函数记录：名字、入口 IP、寄存器数、指令起点、块起点（`func_block_base`）、块数。
+const FUNC_WORDS: usize = 6;
+
+/// `bytes` 是 `KAUB` 容器时返回它的版本号（v1 / v2），否则 `None`。
+pub fn version(bytes: &[u8]) -> Option<u32> {
+    if bytes.len() < 8 || &bytes[..4] != MAGIC {
+        return None;
+    }
+    Some(u32::from_le_bytes(bytes[4..8].try_into().unwrap()))
+}
+
+// ── 写 ──
+
+/// 字符串区：按出现顺序编号，不去重（常驻槽位已在 `LoadedProgram::new` 去重）。
+#[derive(Default)]
+struct Strings {
+    index: Vec<u8>,
+    arena: Vec<u8>,
+    count: u32,
+}
+
+impl Strings {
+    fn push(&mut self, s: &str) -> u32 {
+        put_u32(&mut self.index, self.arena.len() as u32);
+        put_u32(&mut self.index, s.len() as u32);
+        self.arena.extend_from_slice(s.as_bytes());
+        self.count += 1;
+        self.count - 1
+    }
+}
+
+fn put_u32(w: &mut Vec<u8>, v: u32) {
+    w.extend_from_slice(&v.to_le_bytes());
+}
+
+fn put_u64(w: &mut Vec<u8>, v: u64) {
+    w.extend_from_slice(&v.to_le_bytes());
+}
+
+fn put_pairs(w: &mut Vec<u8>, pairs: impl IntoIterator<Item = (usize, usize)>) {
+    for (a, b) in pairs {
+        put_u32(w, a as u32);
+        put_u32(w, b as u32);
+    }
+}
+
+impl LoadedProgram {
+    /// 编码为 v2 映像（见模块文档）。
+    pub fn to_image(&self) -> Vec<u8> {
+        let mut s: [Vec<u8>; SECTIONS] = Default::default();
+        let mut strings = Strings::default();
+        for slot in &self.strings {
+            strings.push(slot);
+        }
+
+        let meta = &mut s[Section::Meta as usize];
+        put_u32(meta, self.strings.len() as u32);
+        put_u32(meta, self.ic_site_count as u32);
+
+        for (c, &bits) in self.consts.iter().zip(&self.const_bits) {
+            let tag = match c {
+                Constant::Int(_) => 0,
+                Constant::Float(_) => 1,
+                Constant::String(_) => 2,
+                Constant::Bool(_) => 3,
+                Constant::Null => 4,
+            };
+            s[Section::ConstTags as usize].push(tag);
+            put_u64(&mut s[Section::ConstBits as usize], bits);
+        }
+
+        for func in 0..self.func_count() {
+            let name = strings.push(&self.func_names[func]);
+            let w = &mut s[Section::Funcs as usize];
+            for v in [
+                name as usize,
+                self.func_entries[func],
+                self.func_reg_counts[func],
+                self.func_instr_base[func],
+                self.func_block_base[func],
+                self.func_blocks[func].len(),
+            ] {
+                put_u32(w, v as u32);
+            }
+        }
+        for owner in &self.func_owners {
+            let id = strings.push(owner);
+            put_u32(&mut s[Section::Owners as usize], id);
+        }
+
+        let blocks = self.func_blocks.iter().flatten().copied();
+        put_pairs(&mut s[Section::Blocks as usize], blocks);
+        put_pairs(
+            &mut s[Section::BlockParams as usize],
+            self.block_params.iter().copied(),
+        );
+        for &r in &self.param_pool {
+            put_u32(&mut s[Section::ParamPool as usize], r as u32);
+        }
+
+        for &inst in &self.instrs {
+            put_u32(&mut s[Section::Instrs as usize], inst);
+        }
+        for span in &self.edge_spans {
+            let w = &mut s[Section::EdgeSpans as usize];
+            put_u32(w, span.start);
+            put_u32(w, span.len);
+            put_u32(w, span.alt_len);
+        }
+        for m in &self.edge_moves {
+            put_u32(&mut s[Section::EdgeMoves as usize], m.dst);
+            put_u32(&mut s[Section::EdgeMoves as usize], m.src);
+        }
+        for &site in &self.ic_sites {
+            put_u32(&mut s[Section::IcSites as usize], site);
+        }
+
+        for (&bitmap, &fields) in self.struct_bitmaps.iter().zip(&self.struct_field_counts) {
+            put_u64(&mut s[Section::Structs as usize], bitmap);
+            put_u64(&mut s[Section::Structs as usize], fields as u64);
+        }
+        for (bitmaps, counts) in self
+            .enum_variant_bitmaps
+            .iter()
+            .zip(&self.enum_variant_counts)
+        {
+            let start = s[Section::Variants as usize].len() / 16;
+            put_pairs(&mut s[Section::Enums as usize], [(start, counts.len())]);
+            for (&bitmap, &fields) in bitmaps.iter().zip(counts) {
+                put_u64(&mut s[Section::Variants as usize], bitmap);
+                put_u64(&mut s[Section::Variants as usize], fields as u64);
+            }
+        }
+
+        for vt in &self.vtables {
+            let iface = strings.push(&vt.interface_name);
+            let name = strings.push(&vt.struct_name);
+            let start = s[Section::Methods as usize].len() / 8;
+            for (method, func) in &vt.methods {
+                let id = strings.push(method);
+                put_u32(&mut s[Section::Methods as usize], id);
+                put_u32(&mut s[Section::Methods as usize], *func as u32);
+            }
+            let w = &mut s[Section::Vtables as usize];
+            for v in [iface, name, start as u32, vt.methods.len() as u32] {
+                put_u32(w, v);
+            }
+        }
+
+        s[Section::Strings as usize] = strings.index;
+        s[Section::Arena as usize] = strings.arena;
+
+        let mut out = Vec::new();
+        out.extend_from_slice(MAGIC);
+        put_u32(&mut out, VERSION);
+        put_u32(&mut out, SECTIONS as u32);
+        put_u32(&mut out, 0);
+        let mut offset = align(HEADER + SECTIONS * 8);
+        for section in &s {
+            put_u32(&mut out, offset as u32);
+            put_u32(&mut out, section.len() as u32);
+            offset = align(offset + section.len());
+        }
+        for section in &s {
+            out.resize(align(out.len()), 0);
+            out.extend_from_slice(section);
+        }
+        out
+    }
+
+    /// 从 v2 映像恢复程序（见模块文档）。v1 映像要先经 `kaubo_ir` 解码成
+    /// `CpsModule` 再走 `LoadedProgram::new`。
+    pub fn from_image(bytes: &[u8]) -> Result<Self, String> {
+        match version(bytes) {
+            Some(VERSION) => {}
+            Some(v) => return Err(format!("unsupported image version {v}")),
+            None => return Err("bad magic".into()),
+        }
+        let image = Image::parse(bytes)?;
+        let mut p = Self::empty();
+
+        let meta = image.words(Section::Meta)?;
+        let [slots, ic_sites] = meta[..] else {
+            return Err("meta: expected 2 words".into());
+        };
+        let strings = image.strings()?;
+        let string = |id: u32| {
+            strings
+                .get(id as usize)
+                .copied()
+                .ok_or_else(|| format!("string {id} out of range"))
+        };
+        p.strings = (0..slots)
+            .map(|id| string(id).map(Into::into))
+            .collect::<Result<_, _>>()?;
+        p.ic_site_count = ic_sites as usize;
+
+        let tags = image.raw(Section::ConstTags);
+        p.const_bits = image.u64s(Section::ConstBits)?;
+        if tags.len() != p.const_bits.len() {
+            return Err("constants: tag and value counts differ".into());
+        }
+        for (&tag, &bits) in tags.iter().zip(&p.const_bits) {
+            p.consts.push(match tag {
+                0 => Constant::Int(bits as i64),
+                1 => Constant::Float(f64::from_bits(bits)),
+                2 => Constant::String(
+                    p.strings
+                        .get(bits as usize)
+                        .ok_or_else(|| format!("string slot {bits} out of range"))?
+                        .to_string(),
+                ),
+                3 => Constant::Bool(bits != 0),
+                4 => Constant::Null,
+                _ => return Err(format!("bad const tag {tag}")),
+            });
+        }
+
+        p.instrs = image.words(Section::Instrs)?;
+        p.ic_sites = image.words(Section::IcSites)?;
+        p.edge_spans = image
+            .records::<3>(Section::EdgeSpans)?
+            .map(|[start, len, alt_len]| EdgeSpan {
+                start,
+                len,
+                alt_len,
+            })
+            .collect();
+        p.edge_moves = image
+            .records::<2>(Section::EdgeMoves)?
+            .map(|[dst, src]| RegMove { dst, src })
+            .collect();
+        let ips = p.instrs.len();
+        if p.edge_spans.len() != ips || p.ic_sites.len() != ips {
+            return Err("edge spans / ic sites do not match the instruction count".into());
+        }
+        for span in &p.edge_spans {
+            let end = span.start as u64 + span.len as u64 + span.alt_len as u64;
+            if end > p.edge_moves.len() as u64 {
+                return Err("edge span out of range".into());
+            }
+        }
+
+        p.param_pool = image
+            .words(Section::ParamPool)?
+            .into_iter()
+            .map(|r| r as usize)
+            .collect();
+        p.block_params = image.pairs(Section::BlockParams)?;
+        let blocks = image.pairs(Section::Blocks)?;
+        if p.block_params.len() != blocks.len() {
+            return Err("block params do not match the block count".into());
+        }
+        let fits =
+            |&(s, n): &(usize, usize), limit: usize| range(s, n).is_some_and(|r| r.end <= limit);
+        if !p.block_params.iter().all(|b| fits(b, p.param_pool.len()))
+            || !blocks.iter().all(|b| fits(b, ips))
+        {
+            return Err("block out of range".into());
+        }
+        p.block_starts = blocks.iter().map(|b| b.0).collect();
+
+        let mut next_ip = 0;
+        for [name, entry, regs, instr_base, block_base, block_count] in
+            image.records::<FUNC_WORDS>(Section::Funcs)?
+        {
+            let (entry, instr_base) = (entry as usize, instr_base as usize);
+            let func_blocks = range(block_base as usize, block_count as usize)
+                .and_then(|r| blocks.get(r))
+                .map(<[_]>::to_vec);
+            // 函数在 `instrs` 中首尾相接，`func_instr_len` 依赖这一点
+            let (Some(func_blocks), true) = (func_blocks, instr_base == next_ip && entry <= ips)
+            else {
+                return Err(format!("function {} out of range", p.func_count()));
+            };
+            next_ip = func_blocks
+                .iter()
+                .map(|&(s, n)| s + n)
+                .max()
+                .unwrap_or(instr_base)
+                .max(instr_base);
+            p.func_names.push(string(name)?.into());
+            p.func_entries.push(entry);
+            p.func_reg_counts.push(regs as usize);
+            p.func_instr_base.push(instr_base);
+            p.func_block_base.push(block_base as usize);
+            p.func_blocks.push(func_blocks);
+        }
+        if next_ip != ips {
+            return Err("functions do not cover the instruction stream".into());
+        }
+        p.func_owners = image
+            .words(Section::Owners)?
+            .into_iter()
+            .map(|id| string(id).map(Into::into))
+            .collect::<Result<_, _>>()?;
+
+        for [bitmap, fields] in image.records64::<2>(Section::Structs)? {
+            p.struct_bitmaps.push(bitmap);
+            p.struct_field_counts.push(fields as usize);
+        }
+        let variants: Vec<[u64; 2]> = image.records64::<2>(Section::Variants)?.collect();
+        for (start, len) in image.pairs(Section::Enums)? {
+            let vs = range(start, len)
+                .and_then(|r| variants.get(r))
+                .ok_or("enum variants out of range")?;
+            p.enum_variant_bitmaps
+                .push(vs.iter().map(|v| v[0]).collect());
+            p.enum_variant_counts
+                .push(vs.iter().map(|v| v[1] as usize).collect());
+        }
+
+        let methods: Vec<[u32; 2]> = image.records::<2>(Section::Methods)?.collect();
+        for [iface, name, start, len] in image.records::<4>(Section::Vtables)? {
+            let ms = range(start as usize, len as usize)
+                .and_then(|r| methods.get(r))
+                .ok_or("vtable methods out of range")?;
+            p.vtables.push(VtableDef {
+                interface_name: string(iface)?.into(),
+                struct_name: string(name)?.into(),
+                methods: ms
+                    .iter()
+                    .map(|&[m, f]| Ok((string(m)?.to_string(), f as usize)))
+                    .collect::<Result<_, String>>()?,
+            });
+        }
+
+        p.validate()?;
+        p.reset_code();
+        Ok(p)
+    }
+}
+
+fn align(n: usize) -> usize {
+    n.next_multiple_of(ALIGN)
+}
+
+/// `start..start + len`；记录里的数都来自映像，加法溢出时返回 `None`。
+fn range(start: usize, len: usize) -> Option<Range<usize>> {
+    Some(start..start.checked_add(len)?)
+}
+
+// ── 读 ──
+
+/// 校验过段表的映像视图。
+struct Image<'a> {
+    bytes: &'a [u8],
+    sections: [(usize, usize); SECTIONS],
+}
+
+impl<'a> Image<'a> {
+    fn parse(bytes: &'a [u8]) -> Result<Self, String> {
+        let word = |at: usize| {
+            bytes
+                .get(at..at + 4)
+                .map(|b| u32::from_le_bytes(b.try_into().unwrap()) as usize)
+                .ok_or_else(|| format!("truncated header at {at}"))
+        };
+        if word(8)? != SECTIONS {
+            return Err(format!("expected {SECTIONS} sections, found {}", word(8)?));
+        }
+        let mut sections = [(0, 0); SECTIONS];
+        for (i, s) in sections.iter_mut().enumerate() {
+            let (offset, len) = (word(HEADER + i * 8)?, word(HEADER + i * 8 + 4)?);
+            if !offset.is_multiple_of(ALIGN)
+                || range(offset, len).is_none_or(|r| r.end > bytes.len())
+            {
+                return Err(format!("section {} out of range", Self::name(i)));
+            }
+            *s = (offset, len);
+        }
+        Ok(Image { bytes, sections })
+    }
+
+    fn name(i: usize) -> &'static str {
+        const NAMES: [&str; SECTIONS] = [
+            "meta",
+            "strings",
+            "arena",
+            "const-tags",
+            "const-bits",
+            "funcs",
+            "owners",
+            "blocks",
+            "block-params",
+            "param-pool",
+            "instrs",
+            "edge-spans",
+            "edge-moves",
+            "ic-sites",
+            "structs",
+            "enums",
+            "variants",
+            "vtables",
+            "methods",
+        ];
+        NAMES[i]
+    }
+
+    fn raw(&self, s: Section) -> &'a [u8] {
+        let (offset, len) = self.sections[s as usize];
+        &self.bytes[offset..offset + len]
+    }
+
+    /// 段 `s` 作为 `N` 个 u32 一组的记录数组。
+    fn records<const N: usize>(
+        &self,
+        s: Section,
+    ) -> Result<impl Iterator<Item = [u32; N]> + 'a, String> {
+        let raw = self.raw(s);
+        if !raw.len().is_multiple_of(N * 4) {
+            return Err(format!(
+                "section {} has a partial record",
+                Self::name(s as usize)
+            ));
+        }
+        Ok(raw.chunks_exact(N * 4).map(|r| {
+            std::array::from_fn(|i| u32::from_le_bytes(r[i * 4..i * 4 + 4].try_into().unwrap()))
+        }))
+    }
+
+    /// 段 `s` 作为 `N` 个 u64 一组的记录数组。
+    fn records64<const N: usize>(
+        &self,
+        s: Section,
+    ) -> Result<impl Iterator<Item = [u64; N]> + 'a, String> {
+        let raw = self.raw(s);
+        if !raw.len().is_multiple_of(N * 8) {
+            return Err(format!(
+                "section {} has a partial record",
+                Self::name(s as usize)
+            ));
+        }
+        Ok(raw.chunks_exact(N * 8).map(|r| {
+            std::array::from_fn(|i| u64::from_le_bytes(r[i * 8..i * 8 + 8].try_into().unwrap()))
+        }))
+    }
+
+    fn words(&self, s: Section) -> Result<Vec<u32>, String> {
+        Ok(self.records::<1>(s)?.map(|[w]| w).collect())
+    }
+
+    fn u64s(&self, s: Section) -> Result<Vec<u64>, String> {
+        Ok(self.records64::<1>(s)?.map(|[w]| w).collect())
+    }
+
+    fn pairs(&self, s: Section) -> Result<Vec<(usize, usize)>, String> {
+        Ok(self
+            .records::<2>(s)?
+            .map(|[a, b]| (a as usize, b as usize))
+            .collect())
+    }
+
+    /// 字符串表，借用映像里的字节区。
+    fn strings(&self) -> Result<Vec<&'a str>, String> {
+        let arena = self.raw(Section::Arena);
+        self.records::<2>(Section::Strings)?
+            .map(|[start, len]| {
+                let bytes = range(start as usize, len as usize)
+                    .and_then(|r| arena.get(r))
+                    .ok_or("string out of range")?;
+                std::str::from_utf8(bytes).map_err(|e| format!("utf8: {e}"))
+            })
+            .collect()
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::execute::VM;
+    use kaubo_cps::*;
+    use std::collections::HashMap;
+    use std::sync::Arc;
+
+    /// 块参数、字符串、结构体、枚举、vtable 与跨函数调用都用到的模块。
+    fn module() -> CpsModule {
+        let callee = CpsFunction {
+            name: "inc".into(),
+            blocks: vec![CpsBlock {
+                id: 0,
+                params: vec![],
+                instrs: vec![
+                    CpsInstr::LoadConst(1, 1),
+                    CpsInstr::BinOp(0, CpsBinOp::AddInt, 0, 1),
+                ],
+                term: CpsTerminator::Return(0),
+            }],
+            entry: 0,
+            reg_count: 2,
+        };
+        let main = CpsFunction {
+            name: "main".into(),
+            blocks: vec![
+                CpsBlock {
+                    id: 0,
+                    params: vec![],
+                    instrs: vec![CpsInstr::LoadConst(0, 0), CpsInstr::LoadConst(1, 2)],
+                    term: CpsTerminator::Jump(1, vec![0, 1]),
+                },
+                CpsBlock {
+                    id: 1,
+                    params: vec![2, 3],
+                    instrs: vec![CpsInstr::NewTuple(4, vec![2, 3]), CpsInstr::Print(3)],
+                    term: CpsTerminator::Call(0, vec![2], 2),
+                },
+                CpsBlock {
+                    id: 2,
+                    params: vec![],
+                    instrs: vec![
+                        CpsInstr::TupleIndex(5, 4, 0),
+                        CpsInstr::BinOp(0, CpsBinOp::AddInt, 0, 5),
+                    ],
+                    term: CpsTerminator::Return(0),
+                },
+            ],
+            entry: 0,
+            reg_count: 6,
+        };
+        CpsModule {
+            functions: vec![callee, main],
+            constants: vec![
+                Constant::Int(20),
+                Constant::Int(1),
+                Constant::String("hi".into()),
+                Constant::Float(0.5),
+                Constant::Bool(true),
+                Constant::Null,
+            ],
+            structs: vec![StructDef {
+                id: 0,
+                name: "P".into(),
+                fields: vec![("x".into(), "Int64".into()), ("s".into(), "String".into())],
+                type_bitmap: 0b10,
+            }],
+            enums: vec![],
+            vtables: vec![VtableDef {
+                interface_name: "Show".into(),
+                struct_name: "P".into(),
+                methods: vec![("show".into(), 0)],
+            }],
+            symbol_map: HashMap::new(),
+            func_owners: vec!["main.kb".into(), "main.kb".into()],
+        }
+    }
+
+    fn run(program: LoadedProgram) -> (i64, Vec<String>) {
+        let entry = program.entry().unwrap();
+        let mut vm = VM::with_program(Arc::new(program));
+        let r = vm.execute(entry, 0, None).unwrap();
+        (r, vm.take_output())
+    }
+
+    #[test]
+    fn image_round_trips_every_table() {
+        let program = LoadedProgram::new(&module()).unwrap();
+        let image = program.to_image();
+        assert_eq!(version(&image), Some(VERSION));
+        let back = LoadedProgram::from_image(&image).unwrap();
+        assert_eq!(back.instrs, program.instrs);
+        assert_eq!(back.const_bits, program.const_bits);
+        assert_eq!(back.strings, program.strings);
+        assert_eq!(back.func_names, program.func_names);
+        assert_eq!(back.func_owners, program.func_owners);
+        assert_eq!(back.func_blocks, program.func_blocks);
+        assert_eq!(back.block_starts, program.block_starts);
+        assert_eq!(back.block_params(1, 1), &[2, 3]);
+        assert_eq!(back.edge_moves.len(), program.edge_moves.len());
+        assert_eq!(back.struct_bitmaps, vec![0b10]);
+        assert_eq!(back.vtables[0].methods, vec![("show".to_string(), 0)]);
+        assert!(matches!(back.consts[3], Constant::Float(f) if f == 0.5));
+        // 同一份程序再编码，字节不变
+        assert_eq!(back.to_image(), image);
+    }
+
+    #[test]
+    fn image_runs_like_the_module() {
+        let program = LoadedProgram::new(&module()).unwrap();
+        let image = program.to_image();
+        let expected = run(program);
+        assert_eq!(expected, (41, vec!["hi".to_string()]));
+        assert_eq!(run(LoadedProgram::from_image(&image).unwrap()), expected);
+    }
+
+    #[test]
+    fn sections_are_aligned() {
+        let image = LoadedProgram::new(&module()).unwrap().to_image();
+        let parsed = Image::parse(&image).unwrap();
+        assert!(parsed
+            .sections
+            .iter()
+            .all(|&(offset, _)| offset % ALIGN == 0));
+        assert_eq!(parsed.raw(Section::Instrs).len() % 4, 0);
+    }
+
+    #[test]
+    fn malformed_images_are_rejected() {
+        let image = LoadedProgram::new(&module()).unwrap().to_image();
+        assert!(LoadedProgram::from_image(b"KAUB").is_err());
+        assert!(LoadedProgram::from_image(&image[..image.len() - 1]).is_err());
+
+        let mut v1 = image.clone();
+        v1[4..8].copy_from_slice(&1u32.to_le_bytes());
+        let err = LoadedProgram::from_image(&v1).err().unwrap();
+        assert!(err.contains("version 1"), "{err}");
+
+        // 指令段截掉一条：边表长度对不上
+        let mut bad = image.clone();
+        let at = HEADER + Section::Instrs as usize * 8 + 4;
+        let len = u32::from_le_bytes(bad[at..at + 4].try_into().unwrap());
+        bad[at..at + 4].copy_from_slice(&(len - 4).to_le_bytes());
+        assert!(LoadedProgram::from_image(&bad).is_err());
+
+        // 段内第一条记录改成 `word`
+        let patched = |section: Section, word: u32| {
+            let mut bad = image.clone();
+            let at = HEADER + section as usize * 8;
+            let offset = u32::from_le_bytes(bad[at..at + 4].try_into().unwrap()) as usize;
+            bad[offset..offset + 4].copy_from_slice(&word.to_le_bytes());
+            LoadedProgram::from_image(&bad).err().unwrap_or_default()
+        };
+        let err = patched(Section::Instrs, 0x7E << 25);
+        assert!(err.contains("invalid opcode 0x7e"), "{err}");
+        let print_255 = crate::execute::encode(crate::execute::Opcode::Print as u8, 255, 0, 0);
+        let err = patched(Section::Instrs, print_255);
+        assert!(err.contains("register 255 outside"), "{err}");
+        // 字符串区间 start + len 超出 u32
+        let err = patched(Section::Strings, u32::MAX);
+        assert!(err.contains("string out of range"), "{err}");
+    }
+}
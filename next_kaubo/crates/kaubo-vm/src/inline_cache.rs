@@ -0,0 +1,199 @@
+//! CallIndirect 的内联缓存 — 每个调用点记住见过的 vtable 及其目标
+//!
+//! 接口方法调用点的槽位在编译期固定，运行时只有接收者的 vtable 会变。
+//! 每个调用点缓存最多 `POLY_WAYS` 个 `vtable_idx → (func_idx, func_entry, regs)`：
+//! 命中时跳过 vtable / 方法表 / 函数表的查找；见过的 vtable 超过上限后调用点
+//! 转为 megamorphic，不再填充，每次都走慢路径。
+//!
+//! 调用点编号由 `LoadedProgram::ic_sites` 给出（只读、共享）；缓存内容是执行期
+//! 状态，属于各自的 VM，`VM::reset` 时清空。
+
+/// 每个调用点最多缓存的 vtable 数。
+pub const POLY_WAYS: usize = 4;
+
+/// `LoadedProgram::ic_sites` 中不是调用点的 IP。
+pub const NO_SITE: u32 = u32::MAX;
+
+/// 一次解析的结果：被调函数、入口 IP、寄存器数。
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub struct Target {
+    pub func_idx: u32,
+    pub func_entry: u32,
+    pub regs: u32,
+}
+
+#[derive(Debug, Clone, Copy)]
+struct Way {
+    vtable_idx: u32,
+    target: Target,
+}
+
+/// 调用点状态。
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum IcState {
+    Empty,
+    Monomorphic,
+    Polymorphic(usize),
+    Megamorphic,
+}
+
+#[derive(Debug, Clone, Default)]
+pub struct CallSite {
+    ways: Vec<Way>,
+    megamorphic: bool,
+    pub hits: u64,
+    pub misses: u64,
+}
+
+impl CallSite {
+    pub fn state(&self) -> IcState {
+        match (self.megamorphic, self.ways.len()) {
+            (true, _) => IcState::Megamorphic,
+            (false, 0) => IcState::Empty,
+            (false, 1) => IcState::Monomorphic,
+            (false, n) => IcState::Polymorphic(n),
+        }
+    }
+}
+
+impl IcState {
+    /// 缓存着的 vtable 数（megamorphic 调用点不缓存）。
+    pub fn entries(self) -> usize {
+        match self {
+            IcState::Empty | IcState::Megamorphic => 0,
+            IcState::Monomorphic => 1,
+            IcState::Polymorphic(n) => n,
+        }
+    }
+}
+
+/// 所有调用点的命中统计。
+#[derive(Debug, Clone, Copy, Default, PartialEq, Eq)]
+pub struct IcStats {
+    pub sites: usize,
+    pub hits: u64,
+    pub misses: u64,
+    pub megamorphic: usize,
+}
+
+#[derive(Debug, Default)]
+pub struct InlineCaches {
+    sites: Vec<CallSite>,
+}
+
+impl InlineCaches {
+    pub fn new() -> Self {
+        Self::default()
+    }
+
+    /// 换成 `sites` 个空调用点。
+    pub fn reset(&mut self, sites: usize) {
+        self.sites.clear();
+        self.sites.resize(sites, CallSite::default());
+    }
+
+    /// 查 `site` 上 `vtable_idx` 的目标，命中 / 未命中计入统计。
+    #[inline(always)]
+    pub fn lookup(&mut self, site: usize, vtable_idx: usize) -> Option<Target> {
+        let s = &mut self.sites[site];
+        // 单态调用点最常见，先比第一路
+        let hit = s
+            .ways
+            .iter()
+            .find(|w| w.vtable_idx as usize == vtable_idx)
+            .map(|w| w.target);
+        match hit {
+            Some(_) => s.hits += 1,
+            None => s.misses += 1,
+        }
+        hit
+    }
+
+    /// 慢路径解析后回填；调用点已满时转为 megamorphic。返回回填后的状态。
+    pub fn fill(&mut self, site: usize, vtable_idx: usize, target: Target) -> IcState {
+        let s = &mut self.sites[site];
+        if !s.megamorphic {
+            if s.ways.len() < POLY_WAYS {
+                s.ways.push(Way {
+                    vtable_idx: vtable_idx as u32,
+                    target,
+                });
+            } else {
+                s.ways.clear();
+                s.megamorphic = true;
+            }
+        }
+        s.state()
+    }
+
+    pub fn site(&self, site: usize) -> &CallSite {
+        &self.sites[site]
+    }
+
+    pub fn stats(&self) -> IcStats {
+        self.sites.iter().fold(
+            IcStats {
+                sites: self.sites.len(),
+                ..IcStats::default()
+            },
+            |mut acc, s| {
+                acc.hits += s.hits;
+                acc.misses += s.misses;
+                acc.megamorphic += s.megamorphic as usize;
+                acc
+            },
+        )
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn target(f: u32) -> Target {
+        Target {
+            func_idx: f,
+            func_entry: f * 10,
+            regs: 4,
+        }
+    }
+
+    #[test]
+    fn sites_go_from_mono_to_poly_to_megamorphic() {
+        let mut ic = InlineCaches::new();
+        ic.reset(2);
+        assert_eq!(ic.site(0).state(), IcState::Empty);
+        assert_eq!(ic.lookup(0, 7), None);
+        assert_eq!(ic.fill(0, 7, target(1)), IcState::Monomorphic);
+        assert_eq!(ic.lookup(0, 7), Some(target(1)));
+
+        for vt in 1..POLY_WAYS {
+            assert_eq!(ic.lookup(0, vt), None);
+            ic.fill(0, vt, target(vt as u32));
+        }
+        assert_eq!(ic.site(0).state(), IcState::Polymorphic(POLY_WAYS));
+        assert_eq!(ic.lookup(0, 2), Some(target(2)));
+
+        assert_eq!(ic.lookup(0, 99), None);
+        assert_eq!(ic.fill(0, 99, target(9)), IcState::Megamorphic);
+        assert_eq!(ic.lookup(0, 7), None);
+        assert_eq!(ic.fill(0, 7, target(1)), IcState::Megamorphic);
+
+        let stats = ic.stats();
+        assert_eq!(stats.sites, 2);
+        assert_eq!(stats.hits, 2);
+        assert_eq!(stats.misses, POLY_WAYS as u64 + 2);
+        assert_eq!(stats.megamorphic, 1);
+        // 另一个调用点不受影响
+        assert_eq!(ic.site(1).state(), IcState::Empty);
+
+        ic.reset(1);
+        assert_eq!(
+            ic.stats(),
+            IcStats {
+                sites: 1,
+                ..IcStats::default()
+            }
+        );
+    }
+}
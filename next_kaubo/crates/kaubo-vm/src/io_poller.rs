@@ -0,0 +1,212 @@
+//! I/O 事件源 — `AsyncScheduler::turn` 向它收集完成的任务
+//!
+//! 每个后端只负责把「某个 I/O 就绪 / 某个宿主回调触发」翻译成 `(TaskId, i64)`，
+//! 注册接口各自不同（fd 兴趣、宿主句柄），由宿主直接调用具体类型：
+//!   - `PromisePoller`：完成由宿主推送（kaubo-wasm 在 Promise 回调里 `resolve`），
+//!     任何目标都可用
+//!   - `EpollPoller`：Linux epoll，单次触发（`EPOLLONESHOT`），需要 `epoll` feature
+
+use std::cell::RefCell;
+use std::io;
+use std::rc::Rc;
+use std::time::Duration;
+
+use crate::async_runtime::TaskId;
+
+pub trait IoPoller {
+    /// 最多等待 `timeout`（`None` 为无限等待），把完成的 `(task, result)` 追加到 `out`。
+    fn poll(&mut self, timeout: Option<Duration>, out: &mut Vec<(TaskId, i64)>) -> io::Result<()>;
+}
+
+// ── 宿主推送 ──
+
+/// 宿主回调推送完成结果的句柄，可克隆后交给 Promise 回调。
+#[derive(Clone, Default)]
+pub struct PromiseHandle(Rc<RefCell<Vec<(TaskId, i64)>>>);
+
+impl PromiseHandle {
+    /// 宿主侧：`task` 等待的操作以 `result` 完成。
+    pub fn resolve(&self, task: TaskId, result: i64) {
+        self.0.borrow_mut().push((task, result));
+    }
+}
+
+/// 由宿主驱动的事件源：`poll` 从不阻塞，只取走已推送的完成结果。
+/// wasm 上事件循环在每个 Promise 回调结束时跑一轮 `turn`。
+#[derive(Default)]
+pub struct PromisePoller {
+    handle: PromiseHandle,
+}
+
+impl PromisePoller {
+    pub fn new() -> Self {
+        Self::default()
+    }
+
+    pub fn handle(&self) -> PromiseHandle {
+        self.handle.clone()
+    }
+}
+
+impl IoPoller for PromisePoller {
+    fn poll(&mut self, _timeout: Option<Duration>, out: &mut Vec<(TaskId, i64)>) -> io::Result<()> {
+        out.append(&mut self.handle.0.borrow_mut());
+        Ok(())
+    }
+}
+
+// ── Linux epoll ──
+
+#[cfg(all(target_os = "linux", feature = "epoll"))]
+pub use epoll::{EpollPoller, Interest};
+
+#[cfg(all(target_os = "linux", feature = "epoll"))]
+mod epoll {
+    use super::*;
+    use std::os::fd::RawFd;
+
+    /// 等待的就绪方向。
+    #[derive(Debug, Clone, Copy, PartialEq, Eq)]
+    pub enum Interest {
+        Readable,
+        Writable,
+    }
+
+    /// epoll 后端：每次注册单次触发，就绪后任务以事件位（`EPOLLIN` 等）完成。
+    pub struct EpollPoller {
+        epfd: RawFd,
+        events: Vec<libc::epoll_event>,
+    }
+
+    impl EpollPoller {
+        pub fn new() -> io::Result<Self> {
+            let epfd = unsafe { libc::epoll_create1(libc::EPOLL_CLOEXEC) };
+            if epfd < 0 {
+                return Err(io::Error::last_os_error());
+            }
+            Ok(EpollPoller {
+                epfd,
+                events: Vec::with_capacity(256),
+            })
+        }
+
+        /// `fd` 就绪时完成 `task`；同一 fd 再次注册会替换上一次（`EPOLL_CTL_MOD`）。
+        pub fn register(&mut self, fd: RawFd, interest: Interest, task: TaskId) -> io::Result<()> {
+            let bits = match interest {
+                Interest::Readable => libc::EPOLLIN,
+                Interest::Writable => libc::EPOLLOUT,
+            };
+            let mut ev = libc::epoll_event {
+                events: (bits | libc::EPOLLONESHOT) as u32,
+                u64: task as u64,
+            };
+            let mut ctl = |op| unsafe { libc::epoll_ctl(self.epfd, op, fd, &mut ev) };
+            if ctl(libc::EPOLL_CTL_ADD) == 0 {
+                return Ok(());
+            }
+            let err = io::Error::last_os_error();
+            if err.raw_os_error() != Some(libc::EEXIST) {
+                return Err(err);
+            }
+            if ctl(libc::EPOLL_CTL_MOD) == 0 {
+                Ok(())
+            } else {
+                Err(io::Error::last_os_error())
+            }
+        }
+
+        /// 不再关注 `fd`（关闭 fd 前调用）。
+        pub fn deregister(&mut self, fd: RawFd) -> io::Result<()> {
+            let rc = unsafe {
+                libc::epoll_ctl(self.epfd, libc::EPOLL_CTL_DEL, fd, std::ptr::null_mut())
+            };
+            if rc == 0 {
+                Ok(())
+            } else {
+                Err(io::Error::last_os_error())
+            }
+        }
+    }
+
+    impl IoPoller for EpollPoller {
+        fn poll(
+            &mut self,
+            timeout: Option<Duration>,
+            out: &mut Vec<(TaskId, i64)>,
+        ) -> io::Result<()> {
+            let ms = match timeout {
+                None => -1,
+                Some(t) => t.as_millis().min(i32::MAX as u128) as i32,
+            };
+            let cap = self.events.capacity() as i32;
+            let n = unsafe { libc::epoll_wait(self.epfd, self.events.as_mut_ptr(), cap, ms) };
+            if n < 0 {
+                let err = io::Error::last_os_error();
+                return if err.kind() == io::ErrorKind::Interrupted {
+                    Ok(())
+                } else {
+                    Err(err)
+                };
+            }
+            unsafe { self.events.set_len(n as usize) };
+            out.extend(self.events.iter().map(|ev| {
+                let (task, bits) = (ev.u64, ev.events);
+                (task as TaskId, bits as i64)
+            }));
+            self.events.clear();
+            Ok(())
+        }
+    }
+
+    impl Drop for EpollPoller {
+        fn drop(&mut self) {
+            unsafe { libc::close(self.epfd) };
+        }
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn promise_poller_drains_host_completions() {
+        let mut poller = PromisePoller::new();
+        let host = poller.handle();
+        host.resolve(3, 30);
+        host.clone().resolve(4, 40);
+        let mut out = vec![];
+        poller.poll(None, &mut out).unwrap();
+        assert_eq!(out, vec![(3, 30), (4, 40)]);
+        out.clear();
+        poller.poll(None, &mut out).unwrap();
+        assert!(out.is_empty());
+    }
+
+    #[cfg(all(target_os = "linux", feature = "epoll"))]
+    #[test]
+    fn epoll_completes_the_task_waiting_on_a_pipe() {
+        let mut fds = [0; 2];
+        assert_eq!(unsafe { libc::pipe(fds.as_mut_ptr()) }, 0);
+        let mut poller = EpollPoller::new().unwrap();
+        poller.register(fds[0], Interest::Readable, 9).unwrap();
+
+        let mut out = vec![];
+        poller.poll(Some(Duration::ZERO), &mut out).unwrap();
+        assert!(out.is_empty());
+
+        assert_eq!(unsafe { libc::write(fds[1], b"x".as_ptr().cast(), 1) }, 1);
+        poller.poll(Some(Duration::from_secs(1)), &mut out).unwrap();
+        assert_eq!(out, vec![(9, libc::EPOLLIN as i64)]);
+
+        // 单次触发：不重新注册就不会再报告
+        out.clear();
+        poller.poll(Some(Duration::ZERO), &mut out).unwrap();
+        assert!(out.is_empty());
+        poller.deregister(fds[0]).unwrap();
+        unsafe {
+            libc::close(fds[0]);
+            libc::close(fds[1]);
+        }
+    }
+}
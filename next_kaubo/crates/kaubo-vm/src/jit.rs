@@ -0,0 +1,842 @@
+//! 基线 JIT — 热函数编译成 x86-64 机器码（`jit` feature，默认关闭）
+//!
+//! 每个函数在 `VM::jit` 里有调用 / 回边计数，两者之和达到 `Baseline::threshold`
+//! 时把整个函数的块编译一次。机器码直接读写当前帧的寄存器窗口（`RegFile`
+//! 的同一段内存），所以在任何一条指令处都能无缝退回解释器：
+//!   - 纯寄存器指令（整数/浮点运算、比较、Move、常量、Jump / Branch 及边移动）
+//!     逐条翻译成 load-op-store，不做寄存器分配；
+//!   - 其余指令（调用、堆操作、Return……）翻译成"退出"：返回该指令的 IP，
+//!     由解释器接着执行，帧的建立 / 返回仍走 `CallFrame`；
+//!   - 回边扣 `VM::fuel`，燃料用完时带着回边目标退出，由 `burn_fuel` 换片或报
+//!     `LoopExceeded`，时间片与循环上限和解释执行完全一致。
+//!
+//! 机器码不分配堆对象，不会越过 GC 安全点。有事件处理器（trace / 调试）或使用
+//! `DispatchMode::Encoded` 时不进入基线层；非 x86-64 unix 目标（包括 wasm）上
+//! `compile` 总是失败，函数留在解释器里。
+
+use crate::execute::VM;
+
+/// 默认编译阈值（调用 + 回边次数）。
+pub const JIT_THRESHOLD: u64 = 1000;
+
+/// 退出码里"回边燃料用完"的标记位；其下 31 位是目标块，低 32 位是 IP。
+const EXIT_BACK: u64 = 1 << 63;
+
+/// 进入基线层的位置。
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub(crate) enum Entry {
+    /// 调用进入函数入口块（计一次调用）。
+    Call,
+    /// 回边进入块（计一次回边）。
+    Back(usize),
+    /// 从被调方返回到续体块（不计数，只在已编译时进入）。
+    Return(usize),
+}
+
+/// 一个函数的热度计数。
+#[derive(Debug, Clone, Copy, Default, PartialEq, Eq)]
+pub struct FuncCounters {
+    pub calls: u64,
+    pub back_edges: u64,
+}
+
+impl FuncCounters {
+    pub fn hotness(&self) -> u64 {
+        self.calls + self.back_edges
+    }
+}
+
+/// 机器码的一次退出。
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub struct JitExit {
+    /// 解释器从这里继续。
+    pub ip: usize,
+    /// 燃料用完的回边目标块；`None` 表示遇到了基线层不支持的指令。
+    pub back_edge: Option<usize>,
+}
+
+enum Tier {
+    Interpreted,
+    Compiled(CompiledFn),
+    /// 编译失败（没有后端 / 可执行内存申请失败），不再尝试。
+    Rejected,
+}
+
+/// 基线层状态：每个函数的计数和编译结果（`VM::reset` 时重置）。
+pub struct Baseline {
+    /// 运行时开关，默认打开（feature 本身默认关闭）。
+    pub enabled: bool,
+    pub threshold: u64,
+    counters: Vec<FuncCounters>,
+    tiers: Vec<Tier>,
+}
+
+impl Default for Baseline {
+    fn default() -> Self {
+        Self::new()
+    }
+}
+
+impl Baseline {
+    pub fn new() -> Self {
+        Baseline {
+            enabled: true,
+            threshold: JIT_THRESHOLD,
+            counters: vec![],
+            tiers: vec![],
+        }
+    }
+
+    pub(crate) fn reset(&mut self, funcs: usize) {
+        self.counters = vec![FuncCounters::default(); funcs];
+        self.tiers = (0..funcs).map(|_| Tier::Interpreted).collect();
+    }
+
+    /// 记一次进入，返回是否应当走基线层（已编译，或热度已到阈值且还没失败过）。
+    #[inline(always)]
+    pub(crate) fn heat(&mut self, func: usize, entry: Entry) -> bool {
+        let Some(c) = self.counters.get_mut(func) else {
+            return false;
+        };
+        match entry {
+            Entry::Call => c.calls += 1,
+            Entry::Back(_) => c.back_edges += 1,
+            Entry::Return(_) => {
+                return self.enabled && matches!(self.tiers[func], Tier::Compiled(_));
+            }
+        }
+        self.enabled && c.hotness() >= self.threshold && !matches!(self.tiers[func], Tier::Rejected)
+    }
+
+    pub(crate) fn needs_compile(&self, func: usize) -> bool {
+        matches!(self.tiers[func], Tier::Interpreted)
+    }
+
+    pub(crate) fn install(&mut self, func: usize, code: Option<CompiledFn>) {
+        self.tiers[func] = match code {
+            Some(code) => Tier::Compiled(code),
+            None => Tier::Rejected,
+        };
+    }
+
+    pub(crate) fn code(&self, func: usize) -> Option<&CompiledFn> {
+        match &self.tiers[func] {
+            Tier::Compiled(code) => Some(code),
+            _ => None,
+        }
+    }
+
+    pub fn counters(&self, func: usize) -> FuncCounters {
+        self.counters.get(func).copied().unwrap_or_default()
+    }
+
+    pub fn is_compiled(&self, func: usize) -> bool {
+        matches!(self.tiers.get(func), Some(Tier::Compiled(_)))
+    }
+
+    pub fn compiled_functions(&self) -> usize {
+        self.tiers
+            .iter()
+            .filter(|t| matches!(t, Tier::Compiled(_)))
+            .count()
+    }
+}
+
+/// 一个函数的机器码。
+pub struct CompiledFn {
+    #[cfg(all(target_arch = "x86_64", unix))]
+    code: x64::Code,
+    blocks: usize,
+    /// 机器码访问的寄存器数（`func_reg_counts`），进入时窗口不能比它短。
+    regs: usize,
+    /// 函数入口块。
+    pub entry_block: usize,
+}
+
+impl CompiledFn {
+    /// 从块 `block` 开始执行，直到遇到不支持的指令或回边燃料用完。
+    pub fn run(&self, regs: &mut [u64], fuel: &mut u64, block: usize) -> JitExit {
+        assert!(block < self.blocks && regs.len() >= self.regs);
+        #[cfg(all(target_arch = "x86_64", unix))]
+        // SAFETY: 编译时所有寄存器操作数都已校验 < self.regs，块号有对应的跳转表项
+        let raw = unsafe { self.code.call(regs.as_mut_ptr(), fuel, block as u64) };
+        #[cfg(not(all(target_arch = "x86_64", unix)))]
+        let raw: u64 = unreachable!("no baseline backend for this target ({fuel})");
+        JitExit {
+            ip: raw as u32 as usize,
+            back_edge: (raw & EXIT_BACK != 0).then_some(((raw & !EXIT_BACK) >> 32) as usize),
+        }
+    }
+}
+
+/// 编译函数 `func` 的全部块；没有可用后端时返回 `None`。
+pub(crate) fn compile(vm: &VM, func: usize) -> Option<CompiledFn> {
+    let blocks = &vm.program.func_blocks[func];
+    let entry = vm.program.func_entries[func];
+    let entry_block = blocks
+        .iter()
+        .position(|&(start, len)| start == entry && len > 0)
+        .or_else(|| blocks.iter().position(|&(start, _)| start == entry))?;
+    #[cfg(all(target_arch = "x86_64", unix))]
+    return Some(CompiledFn {
+        code: x64::compile(vm, func)?,
+        blocks: blocks.len(),
+        regs: vm.program.func_reg_counts[func],
+        entry_block,
+    });
+    #[cfg(not(all(target_arch = "x86_64", unix)))]
+    {
+        let _ = entry_block;
+        None
+    }
+}
+
+#[cfg(all(target_arch = "x86_64", unix))]
+mod x64 {
+    //! x86-64 (System V) 发射器。
+    //!
+    //! 入口 `fn(regs: *mut u64 /*rdi*/, fuel: *mut u64 /*rsi*/, block: u64 /*rdx*/) -> u64`
+    //! 经函数末尾的跳转表跳到块标签。寄存器 `r` 就是 `[rdi + 8r]`；rax / rcx / rdx /
+    //! xmm0 是临时寄存器，r8 充当边移动的 `SCRATCH` 槽。不使用栈，也不调用任何函数。
+
+    use super::EXIT_BACK;
+    use crate::decode::{self, DOp, DecodedInst, BACK_F, BACK_T};
+    use crate::edges::{RegMove, SCRATCH};
+    use crate::execute::VM;
+    use std::ops::Range;
+
+    // ModRM reg 字段
+    const RAX: u8 = 0;
+    const RCX: u8 = 1;
+    const RDX: u8 = 2;
+
+    const REX_W: u8 = 0x48;
+    /// REX.W + REX.R（reg 字段是 r8）
+    const REX_WR: u8 = 0x4C;
+
+    /// 一段可执行内存（mmap，写完后改为只读可执行）。
+    pub struct Code {
+        ptr: *mut u8,
+        len: usize,
+    }
+
+    // 代码发布后不再修改
+    unsafe impl Send for Code {}
+    unsafe impl Sync for Code {}
+
+    impl Code {
+        /// 把 `bytes` 放进可执行内存，并把 `table_at` 处的跳转表填成块标签的绝对地址。
+        fn new(mut bytes: Vec<u8>, table_at: usize, labels: &[usize]) -> Option<Code> {
+            let len = bytes.len();
+            // SAFETY: 匿名私有映射，失败时返回 MAP_FAILED
+            let ptr = unsafe {
+                libc::mmap(
+                    std::ptr::null_mut(),
+                    len,
+                    libc::PROT_READ | libc::PROT_WRITE,
+                    libc::MAP_PRIVATE | libc::MAP_ANONYMOUS,
+                    -1,
+                    0,
+                )
+            };
+            if ptr == libc::MAP_FAILED {
+                return None;
+            }
+            let code = Code {
+                ptr: ptr as *mut u8,
+                len,
+            };
+            for (i, &label) in labels.iter().enumerate() {
+                let at = table_at + i * 8;
+                let addr = code.ptr as u64 + label as u64;
+                bytes[at..at + 8].copy_from_slice(&addr.to_le_bytes());
+            }
+            // SAFETY: 映射长度 ≥ len，且与 bytes 不重叠
+            unsafe {
+                std::ptr::copy_nonoverlapping(bytes.as_ptr(), code.ptr, len);
+                if libc::mprotect(ptr, len, libc::PROT_READ | libc::PROT_EXEC) != 0 {
+                    return None;
+                }
+            }
+            Some(code)
+        }
+
+        /// # Safety
+        /// `regs` 至少覆盖编译时校验过的寄存器数，`block` 小于块数。
+        pub unsafe fn call(&self, regs: *mut u64, fuel: *mut u64, block: u64) -> u64 {
+            let entry: unsafe extern "sysv64" fn(*mut u64, *mut u64, u64) -> u64 =
+                std::mem::transmute(self.ptr);
+            entry(regs, fuel, block)
+        }
+    }
+
+    impl Drop for Code {
+        fn drop(&mut self) {
+            // SAFETY: ptr / len 来自 Code::new 的 mmap
+            unsafe {
+                libc::munmap(self.ptr as *mut libc::c_void, self.len);
+            }
+        }
+    }
+
+    struct Asm {
+        buf: Vec<u8>,
+        /// 块号 → 标签偏移。
+        labels: Vec<usize>,
+        /// 待回填的 rel32（偏移, 目标块）。
+        fixups: Vec<(usize, usize)>,
+    }
+
+    impl Asm {
+        fn bytes(&mut self, b: &[u8]) {
+            self.buf.extend_from_slice(b);
+        }
+
+        /// `prefix.. ModRM(reg, [rdi + disp32])`，`r` 是 VM 寄存器号。
+        fn mem(&mut self, prefix: &[u8], reg: u8, r: u16) {
+            self.bytes(prefix);
+            self.buf.push(0x80 | (reg << 3) | 7);
+            self.bytes(&(r as u32 * 8).to_le_bytes());
+        }
+
+        fn load(&mut self, reg: u8, r: u16) {
+            self.mem(&[REX_W, 0x8B], reg, r);
+        }
+
+        fn store(&mut self, reg: u8, r: u16) {
+            self.mem(&[REX_W, 0x89], reg, r);
+        }
+
+        /// movzx eax, al; mov [a], rax
+        fn store_flag(&mut self, a: u16) {
+            self.bytes(&[0x0F, 0xB6, 0xC0]);
+            self.store(RAX, a);
+        }
+
+        /// mov rax, imm64; ret
+        fn exit(&mut self, ip: usize, back: Option<usize>) {
+            let mut code = ip as u64;
+            if let Some(block) = back {
+                code |= EXIT_BACK | (block as u64) << 32;
+            }
+            self.bytes(&[REX_W, 0xB8]);
+            self.bytes(&code.to_le_bytes());
+            self.buf.push(0xC3);
+        }
+
+        /// 短跳转 `opcode rel8`，返回待回填位置。
+        fn jcc8(&mut self, opcode: u8) -> usize {
+            self.bytes(&[opcode, 0]);
+            self.buf.len() - 1
+        }
+
+        fn bind8(&mut self, at: usize) {
+            self.buf[at] = (self.buf.len() - at - 1) as u8;
+        }
+
+        /// jmp rel32 → 块标签。
+        fn jmp_block(&mut self, block: usize) {
+            self.buf.push(0xE9);
+            self.fixups.push((self.buf.len(), block));
+            self.bytes(&[0; 4]);
+        }
+
+        fn moves(&mut self, moves: &[RegMove]) {
+            for m in moves {
+                if m.src == SCRATCH {
+                    self.mem(&[REX_WR, 0x89], 0, m.dst as u16);
+                } else if m.dst == SCRATCH {
+                    self.mem(&[REX_WR, 0x8B], 0, m.src as u16);
+                } else {
+                    self.load(RAX, m.src as u16);
+                    self.store(RAX, m.dst as u16);
+                }
+            }
+        }
+
+        /// 一条出边：边移动在此之前已发射；回边先扣燃料，用完就退出。
+        fn edge(&mut self, back: bool, target_ip: usize, block: usize) {
+            if back {
+                // mov rax, [rsi]; test rax, rax; jnz go
+                self.bytes(&[REX_W, 0x8B, 0x06, REX_W, 0x85, 0xC0]);
+                let go = self.jcc8(0x75);
+                self.exit(target_ip, Some(block));
+                self.bind8(go);
+                // sub qword [rsi], 1
+                self.bytes(&[REX_W, 0x83, 0x2E, 0x01]);
+            }
+            self.jmp_block(block);
+        }
+    }
+
+    /// 寄存器操作数都在窗口内，边移动也一样。
+    struct Check {
+        regs: usize,
+    }
+
+    impl Check {
+        fn regs(&self, rs: &[u16]) -> bool {
+            rs.iter().all(|&r| (r as usize) < self.regs)
+        }
+
+        fn moves(&self, moves: &[RegMove]) -> bool {
+            let ok = |r: u32| r == SCRATCH || (r as usize) < self.regs;
+            moves.iter().all(|m| ok(m.dst) && ok(m.src))
+        }
+    }
+
+    pub(super) fn compile(vm: &VM, func: usize) -> Option<Code> {
+        let blocks = &vm.program.func_blocks[func];
+        let check = Check {
+            regs: vm.program.func_reg_counts[func],
+        };
+        let mut asm = Asm {
+            buf: Vec::with_capacity(32 * blocks.iter().map(|b| b.1).sum::<usize>() + 64),
+            labels: vec![0; blocks.len()],
+            fixups: vec![],
+        };
+        // lea rax, [rip + table]; jmp [rax + rdx*8]
+        asm.bytes(&[REX_W, 0x8D, 0x05, 0, 0, 0, 0]);
+        let lea_end = asm.buf.len();
+        asm.bytes(&[0xFF, 0x24, 0xD0]);
+
+        for (b, &(start, len)) in blocks.iter().enumerate() {
+            asm.labels[b] = asm.buf.len();
+            let mut ip = start;
+            loop {
+                if ip >= start + len {
+                    asm.exit(ip, None);
+                    break;
+                }
+                let d = decode::decode_one(&vm.program, func, ip);
+                if !lower(&mut asm, vm, &check, d, ip) {
+                    asm.exit(ip, None);
+                    break;
+                }
+                if matches!(d.op, DOp::Jump | DOp::Branch) {
+                    break;
+                }
+                ip += 1;
+            }
+        }
+
+        asm.buf.resize(asm.buf.len().next_multiple_of(8), 0xCC);
+        let table_at = asm.buf.len();
+        asm.buf.resize(table_at + 8 * blocks.len(), 0);
+        let rel = (table_at - lea_end) as u32;
+        asm.buf[lea_end - 4..lea_end].copy_from_slice(&rel.to_le_bytes());
+        for &(at, block) in &asm.fixups {
+            let rel = asm.labels[block] as i64 - (at as i64 + 4);
+            asm.buf[at..at + 4].copy_from_slice(&(rel as i32).to_le_bytes());
+        }
+        Code::new(asm.buf, table_at, &asm.labels)
+    }
+
+    /// 发射一条已解码（未融合）的指令；不支持时什么都不发射并返回 false。
+    fn lower(asm: &mut Asm, vm: &VM, check: &Check, d: DecodedInst, ip: usize) -> bool {
+        let (a, b, c) = (d.a, d.b, d.c);
+        let moves = |range: Range<usize>| &vm.program.edge_moves[range];
+        let span = vm.program.edge_spans[ip];
+        let ok = match d.op {
+            DOp::Jump => check.moves(moves(span.primary())),
+            DOp::Branch => {
+                check.regs(&[a])
+                    && check.moves(moves(span.primary()))
+                    && check.moves(moves(span.alt()))
+            }
+            DOp::NegInt | DOp::FNeg | DOp::FSqrt | DOp::Not | DOp::Move => check.regs(&[a, b]),
+            // roundsd 需要 SSE4.1；sin/cos 没有单条指令，都退回解释器
+            DOp::FFloor | DOp::FCeil => {
+                std::arch::is_x86_feature_detected!("sse4.1") && check.regs(&[a, b])
+            }
+            DOp::FSin | DOp::FCos => false,
+            DOp::LoadImm64 => check.regs(&[a]),
+            DOp::Slow
+            | DOp::LtIntBranch
+            | DOp::LeIntBranch
+            | DOp::ModIntEqInt
+            | DOp::ModIntEqIntImm
+            | DOp::AddIntJump => false,
+            _ => check.regs(&[a, b, c]),
+        };
+        if !ok {
+            return false;
+        }
+
+        match d.op {
+            DOp::AddInt | DOp::SubInt | DOp::MulInt => {
+                asm.load(RAX, b);
+                match d.op {
+                    DOp::AddInt => asm.mem(&[REX_W, 0x03], RAX, c),
+                    DOp::SubInt => asm.mem(&[REX_W, 0x2B], RAX, c),
+                    _ => asm.mem(&[REX_W, 0x0F, 0xAF], RAX, c),
+                }
+                asm.store(RAX, a);
+            }
+            DOp::DivInt | DOp::ModInt => {
+                // 除数为 0（报错）或 -1（MIN / -1 溢出）交给解释器
+                asm.load(RCX, c);
+                asm.bytes(&[REX_W, 0x85, 0xC9]); // test rcx, rcx
+                let zero = asm.jcc8(0x74);
+                asm.bytes(&[REX_W, 0x83, 0xF9, 0xFF]); // cmp rcx, -1
+                let fine = asm.jcc8(0x75);
+                asm.bind8(zero);
+                asm.exit(ip, None);
+                asm.bind8(fine);
+                asm.load(RAX, b);
+                asm.bytes(&[REX_W, 0x99, REX_W, 0xF7, 0xF9]); // cqo; idiv rcx
+                asm.store(if d.op == DOp::DivInt { RAX } else { RDX }, a);
+            }
+            DOp::NegInt => {
+                asm.load(RAX, b);
+                asm.bytes(&[REX_W, 0xF7, 0xD8]); // neg rax
+                asm.store(RAX, a);
+            }
+            DOp::FAdd | DOp::FSub | DOp::FMul | DOp::FDiv => {
+                let op = match d.op {
+                    DOp::FAdd => 0x58,
+                    DOp::FSub => 0x5C,
+                    DOp::FMul => 0x59,
+                    _ => 0x5E,
+                };
+                asm.mem(&[0xF2, 0x0F, 0x10], 0, b); // movsd xmm0, [b]
+                asm.mem(&[0xF2, 0x0F, op], 0, c);
+                asm.mem(&[0xF2, 0x0F, 0x11], 0, a);
+            }
+            DOp::FNeg => {
+                asm.load(RAX, b);
+                asm.bytes(&[REX_W, 0x0F, 0xBA, 0xF8, 0x3F]); // btc rax, 63
+                asm.store(RAX, a);
+            }
+            DOp::FSqrt => {
+                asm.mem(&[0xF2, 0x0F, 0x51], 0, b); // sqrtsd xmm0, [b]
+                asm.mem(&[0xF2, 0x0F, 0x11], 0, a);
+            }
+            DOp::FFloor | DOp::FCeil => {
+                // roundsd xmm0, [b], imm8：1 = 向下，2 = 向上，bit 3 屏蔽精度异常
+                asm.mem(&[0x66, 0x0F, 0x3A, 0x0B], 0, b);
+                asm.buf.push(if d.op == DOp::FFloor { 0x09 } else { 0x0A });
+                asm.mem(&[0xF2, 0x0F, 0x11], 0, a);
+            }
+            DOp::EqInt | DOp::NeInt | DOp::LtInt | DOp::LeInt | DOp::GtInt | DOp::GeInt => {
+                let setcc = match d.op {
+                    DOp::EqInt => 0x94,
+                    DOp::NeInt => 0x95,
+                    DOp::LtInt => 0x9C,
+                    DOp::LeInt => 0x9E,
+                    DOp::GtInt => 0x9F,
+                    _ => 0x9D,
+                };
+                asm.load(RAX, b);
+                asm.mem(&[REX_W, 0x3B], RAX, c);
+                asm.bytes(&[0x0F, setcc, 0xC0]);
+                asm.store_flag(a);
+            }
+            DOp::FLt | DOp::FLe | DOp::FGt | DOp::FGe => {
+                // 无序（NaN）时 CF=1：b < c 写成 c > b 用 seta / setae
+                let (x, y) = match d.op {
+                    DOp::FLt | DOp::FLe => (c, b),
+                    _ => (b, c),
+                };
+                let setcc = if matches!(d.op, DOp::FLt | DOp::FGt) {
+                    0x97
+                } else {
+                    0x93
+                };
+                asm.mem(&[0xF2, 0x0F, 0x10], 0, x);
+                asm.mem(&[0x66, 0x0F, 0x2E], 0, y); // ucomisd xmm0, [y]
+                asm.bytes(&[0x0F, setcc, 0xC0]);
+                asm.store_flag(a);
+            }
+            DOp::FEq | DOp::FNe => {
+                asm.mem(&[0xF2, 0x0F, 0x10], 0, b);
+                asm.mem(&[0x66, 0x0F, 0x2E], 0, c);
+                if d.op == DOp::FEq {
+                    // sete al; setnp cl; and al, cl
+                    asm.bytes(&[0x0F, 0x94, 0xC0, 0x0F, 0x9B, 0xC1, 0x20, 0xC8]);
+                } else {
+                    // setne al; setp cl; or al, cl
+                    asm.bytes(&[0x0F, 0x95, 0xC0, 0x0F, 0x9A, 0xC1, 0x08, 0xC8]);
+                }
+                asm.store_flag(a);
+            }
+            DOp::Not => {
+                asm.mem(&[REX_W, 0x83], 7, b); // cmp qword [b], 0
+                asm.buf.push(0);
+                asm.bytes(&[0x0F, 0x94, 0xC0]);
+                asm.store_flag(a);
+            }
+            DOp::Move => {
+                asm.load(RAX, b);
+                asm.store(RAX, a);
+            }
+            DOp::LoadImm64 => {
+                asm.bytes(&[REX_W, 0xB8]);
+                asm.bytes(&d.imm64().to_le_bytes());
+                asm.store(RAX, a);
+            }
+            DOp::Jump => {
+                asm.moves(moves(span.primary()));
+                asm.edge(d.flags & BACK_T != 0, d.t as usize, d.tb as usize);
+            }
+            DOp::Branch => {
+                asm.load(RAX, a);
+                asm.bytes(&[REX_W, 0x85, 0xC0]); // test rax, rax
+                                                 // jz rel32 → false 边
+                asm.bytes(&[0x0F, 0x84, 0, 0, 0, 0]);
+                let to_false = asm.buf.len();
+                asm.moves(moves(span.primary()));
+                asm.edge(d.flags & BACK_T != 0, d.t as usize, d.tb as usize);
+                let rel = (asm.buf.len() - to_false) as u32;
+                asm.buf[to_false - 4..to_false].copy_from_slice(&rel.to_le_bytes());
+                asm.moves(moves(span.alt()));
+                asm.edge(d.flags & BACK_F != 0, d.f as usize, d.fb as usize);
+            }
+            _ => unreachable!("checked above"),
+        }
+        true
+    }
+}
+
+#[cfg(all(test, target_arch = "x86_64", unix))]
+mod tests {
+    use super::*;
+    use crate::{Completion, RuntimeError};
+    use kaubo_cps::test_util::{block, func, module};
+    use kaubo_cps::*;
+
+    fn add(d: usize, a: usize, b: usize) -> CpsInstr {
+        CpsInstr::BinOp(d, CpsBinOp::AddInt, a, b)
+    }
+
+    /// sum = Σ i (0 ≤ i < n)；r0 = i, r1 = sum, r2 = n。
+    fn sum_loop(n: i64) -> CpsModule {
+        module(
+            vec![func(
+                vec![
+                    block(
+                        0,
+                        vec![
+                            CpsInstr::LoadConst(0, 1),
+                            CpsInstr::LoadConst(1, 1),
+                            CpsInstr::LoadConst(2, 0),
+                        ],
+                        CpsTerminator::Jump(1, vec![]),
+                    ),
+                    block(
+                        1,
+                        vec![CpsInstr::BinOp(3, CpsBinOp::LtInt, 0, 2)],
+                        CpsTerminator::Branch(3, 2, vec![], 3, vec![]),
+                    ),
+                    block(
+                        2,
+                        vec![add(1, 1, 0), CpsInstr::LoadConst(4, 2), add(0, 0, 4)],
+                        CpsTerminator::Jump(1, vec![]),
+                    ),
+                    block(3, vec![], CpsTerminator::Return(1)),
+                ],
+                5,
+            )],
+            vec![Constant::Int(n), Constant::Int(0), Constant::Int(1)],
+        )
+    }
+
+    fn run(m: &CpsModule, threshold: u64) -> (Result<i64, RuntimeError>, VM) {
+        let mut vm = VM::new();
+        vm.load(m).unwrap();
+        vm.jit.threshold = threshold;
+        let entry = m.functions.len() - 1;
+        let result = vm.execute(entry, 0, None);
+        (result, vm)
+    }
+
+    #[test]
+    fn hot_loop_tiers_up_and_matches_the_interpreter() {
+        let m = sum_loop(100_000);
+        let (fast, vm) = run(&m, 10);
+        assert!(vm.jit.is_compiled(0));
+        // 编译后回边留在机器码里，不再经过计数
+        assert_eq!(vm.jit.counters(0).back_edges, 10);
+        assert_eq!(vm.fuel_used(), 100_000);
+
+        let (slow, vm) = run(&m, u64::MAX);
+        assert!(!vm.jit.is_compiled(0));
+        assert_eq!(fast.unwrap(), slow.unwrap());
+    }
+
+    #[test]
+    fn calls_leave_and_reenter_compiled_code() {
+        // f0(a, b) = a + b；main: 循环里 sum = f0(sum, i)，结果经 r0 返回
+        let callee = func(
+            vec![block(0, vec![add(2, 0, 1)], CpsTerminator::Return(2))],
+            3,
+        );
+        let main = func(
+            vec![
+                block(
+                    0,
+                    vec![
+                        CpsInstr::LoadConst(1, 1),
+                        CpsInstr::LoadConst(2, 1),
+                        CpsInstr::LoadConst(3, 0),
+                        CpsInstr::LoadConst(5, 2),
+                    ],
+                    CpsTerminator::Jump(1, vec![]),
+                ),
+                block(
+                    1,
+                    vec![CpsInstr::BinOp(4, CpsBinOp::LtInt, 1, 3)],
+                    CpsTerminator::Branch(4, 2, vec![], 4, vec![]),
+                ),
+                block(2, vec![], CpsTerminator::Call(0, vec![2, 1], 3)),
+                block(
+                    3,
+                    vec![CpsInstr::Move(2, 0), add(1, 1, 5)],
+                    CpsTerminator::Jump(1, vec![]),
+                ),
+                block(4, vec![], CpsTerminator::Return(2)),
+            ],
+            6,
+        );
+        let m = module(
+            vec![callee, main],
+            vec![Constant::Int(1_000), Constant::Int(0), Constant::Int(1)],
+        );
+        let (result, vm) = run(&m, 1);
+        assert_eq!(result.unwrap(), (0..1_000).sum::<i64>());
+        assert_eq!(vm.jit.compiled_functions(), 2);
+        assert_eq!(vm.jit.counters(0).calls, 1_000);
+    }
+
+    #[test]
+    fn compiled_code_keeps_the_loop_limit_and_time_slices() {
+        let m = sum_loop(1_000);
+        let mut vm = VM::new();
+        vm.load(&m).unwrap();
+        vm.jit.threshold = 1;
+        vm.max_loop_iterations = 500;
+        assert!(matches!(
+            vm.execute(0, 0, None),
+            Err(RuntimeError::LoopExceeded {
+                block_id: 1,
+                limit: 500
+            })
+        ));
+
+        let sliced = |threshold| {
+            let mut vm = VM::new();
+            vm.load(&m).unwrap();
+            vm.jit.threshold = threshold;
+            vm.time_slice = 100;
+            let mut yields = 0;
+            let mut done = vm.start(0, None).unwrap();
+            while let Completion::Yielded = done {
+                yields += 1;
+                done = vm.resume(None).unwrap();
+            }
+            assert!(matches!(done, Completion::Done(v) if v == (0..1_000).sum::<i64>()));
+            yields
+        };
+        assert_eq!(sliced(1), sliced(u64::MAX));
+        assert!(sliced(1) >= 9);
+    }
+
+    #[test]
+    fn division_by_zero_falls_back_to_the_interpreter() {
+        // 循环体里算 sum / (i - 5)：i = 5 时已在机器码里，零除数退回解释器报错
+        let mut m = sum_loop(10);
+        m.constants.push(Constant::Int(5));
+        m.functions[0].blocks[2].instrs.splice(
+            0..0,
+            [
+                CpsInstr::LoadConst(4, 3),
+                CpsInstr::BinOp(4, CpsBinOp::SubInt, 0, 4),
+                CpsInstr::BinOp(4, CpsBinOp::DivInt, 1, 4),
+            ],
+        );
+        let (result, vm) = run(&m, 1);
+        assert!(vm.jit.is_compiled(0));
+        assert!(matches!(result, Err(RuntimeError::DivisionByZero)));
+    }
+
+    #[test]
+    fn float_compares_treat_nan_as_unordered() {
+        let ops = [
+            (CpsBinOp::FLt, false),
+            (CpsBinOp::FLe, false),
+            (CpsBinOp::FGt, false),
+            (CpsBinOp::FGe, false),
+            (CpsBinOp::FEq, false),
+            (CpsBinOp::FNe, true),
+        ];
+        for (op, expect) in ops {
+            for (x, y, ordered) in [(f64::NAN, 1.0, expect), (1.0, 2.0, true)] {
+                let m = module(
+                    vec![func(
+                        vec![block(
+                            0,
+                            vec![
+                                CpsInstr::LoadConst(0, 0),
+                                CpsInstr::LoadConst(1, 1),
+                                CpsInstr::BinOp(2, op, 0, 1),
+                            ],
+                            CpsTerminator::Return(2),
+                        )],
+                        3,
+                    )],
+                    vec![Constant::Float(x), Constant::Float(y)],
+                );
+                let (slow, vm) = run(&m, u64::MAX);
+                let code = compile(&vm, 0).unwrap();
+                let (mut regs, mut fuel) = ([0u64; 3], 0);
+                let exit = code.run(&mut regs, &mut fuel, 0);
+                assert_eq!(exit.back_edge, None);
+                assert_eq!(regs[2], slow.unwrap() as u64, "{op:?} {x} {y}");
+                if x.is_nan() {
+                    assert_eq!(regs[2] != 0, ordered, "{op:?}");
+                }
+            }
+        }
+    }
+
+    #[test]
+    fn math_intrinsics_run_natively_or_exit() {
+        for op in [
+            CpsUnOp::FSqrt,
+            CpsUnOp::FFloor,
+            CpsUnOp::FCeil,
+            CpsUnOp::FSin,
+        ] {
+            for x in [2.5, -2.5, 16.0] {
+                let m = module(
+                    vec![func(
+                        vec![block(
+                            0,
+                            vec![CpsInstr::LoadConst(0, 0), CpsInstr::UnOp(1, op, 0)],
+                            CpsTerminator::Return(1),
+                        )],
+                        2,
+                    )],
+                    vec![Constant::Float(x)],
+                );
+                let (slow, vm) = run(&m, u64::MAX);
+                let code = compile(&vm, 0).unwrap();
+                let (mut regs, mut fuel) = ([0u64; 2], 0);
+                let exit = code.run(&mut regs, &mut fuel, 0);
+                let native = match op {
+                    CpsUnOp::FSin => false,
+                    CpsUnOp::FFloor | CpsUnOp::FCeil => {
+                        std::arch::is_x86_feature_detected!("sse4.1")
+                    }
+                    _ => true,
+                };
+                if !native {
+                    // 没有单条指令的运算在本条 IP 退出
+                    assert_eq!(exit.ip, 1);
+                } else {
+                    assert_eq!(regs[1], slow.unwrap() as u64, "{op:?} {x}");
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,537 @@
+//! 类型化数组的批量内核 — `Int64Array` / `Float64Array` 上的归约、逐元素运算与掩码
+//!
+//! 每个内核写成按 `LANES` 路分块的标量代码（每路一个独立累加器），由编译器
+//! 在不同目标特性下展开成向量指令：
+//!   - x86-64：运行时检测 AVX2，命中走 `#[target_feature(enable = "avx2")]` 版本，否则 SSE2 基线
+//!   - aarch64：NEON 是基线特性，直接向量化
+//!   - wasm32：以 `+simd128` 构建（见 `next_kaubo/.cargo/config.toml`）
+//!
+//! 所有路径的运算顺序完全相同，浮点归约的结果与 CPU 无关（但与逐元素顺序累加
+//! 的舍入不同）。整数运算按回绕语义，与 VM 的 `AddInt` / `MulInt` 一致。
+//! 浮点 min / max 忽略 NaN（`f64::min` 语义）。
+//!
+//! `register` 把内核包装成 native 函数，`stdlib::register_all` 把它们追加在
+//! 基础函数之后；`kaubo-ir` 的 builtin 表按同样的下标降为 `CallNative`。
+
+use crate::execute::HeapObj;
+use crate::gc_heap::GcHeap;
+use crate::stdlib::NativeFn;
+
+/// 分块宽度：8 × 64-bit，够填满两条 AVX2 寄存器。
+const LANES: usize = 8;
+
+/// 内核的元素类型。
+trait Elem: Copy + PartialOrd {
+    const ZERO: Self;
+    fn add(self, o: Self) -> Self;
+    fn sub(self, o: Self) -> Self;
+    fn mul(self, o: Self) -> Self;
+    fn min(self, o: Self) -> Self;
+    fn max(self, o: Self) -> Self;
+}
+
+impl Elem for i64 {
+    const ZERO: Self = 0;
+    #[inline(always)]
+    fn add(self, o: Self) -> Self {
+        self.wrapping_add(o)
+    }
+    #[inline(always)]
+    fn sub(self, o: Self) -> Self {
+        self.wrapping_sub(o)
+    }
+    #[inline(always)]
+    fn mul(self, o: Self) -> Self {
+        self.wrapping_mul(o)
+    }
+    #[inline(always)]
+    fn min(self, o: Self) -> Self {
+        Ord::min(self, o)
+    }
+    #[inline(always)]
+    fn max(self, o: Self) -> Self {
+        Ord::max(self, o)
+    }
+}
+
+impl Elem for f64 {
+    const ZERO: Self = 0.0;
+    #[inline(always)]
+    fn add(self, o: Self) -> Self {
+        self + o
+    }
+    #[inline(always)]
+    fn sub(self, o: Self) -> Self {
+        self - o
+    }
+    #[inline(always)]
+    fn mul(self, o: Self) -> Self {
+        self * o
+    }
+    #[inline(always)]
+    fn min(self, o: Self) -> Self {
+        f64::min(self, o)
+    }
+    #[inline(always)]
+    fn max(self, o: Self) -> Self {
+        f64::max(self, o)
+    }
+}
+
+/// 分路归约：`LANES` 个累加器各自折叠，再按固定顺序合并，最后接上尾部。
+#[inline(always)]
+fn reduce<T: Elem>(x: &[T], init: T, f: impl Fn(T, T) -> T) -> T {
+    let mut acc = [init; LANES];
+    let chunks = x.chunks_exact(LANES);
+    let rest = chunks.remainder();
+    for c in chunks {
+        for l in 0..LANES {
+            acc[l] = f(acc[l], c[l]);
+        }
+    }
+    let mut r = acc.into_iter().fold(init, &f);
+    for &v in rest {
+        r = f(r, v);
+    }
+    r
+}
+
+#[inline(always)]
+fn sum<T: Elem>(x: &[T]) -> T {
+    reduce(x, T::ZERO, T::add)
+}
+
+#[inline(always)]
+fn min<T: Elem>(x: &[T]) -> T {
+    reduce(x, x[0], T::min)
+}
+
+#[inline(always)]
+fn max<T: Elem>(x: &[T]) -> T {
+    reduce(x, x[0], T::max)
+}
+
+#[inline(always)]
+fn dot<T: Elem>(x: &[T], y: &[T]) -> T {
+    let mut acc = [T::ZERO; LANES];
+    let (xc, yc) = (x.chunks_exact(LANES), y.chunks_exact(LANES));
+    let (xr, yr) = (xc.remainder(), yc.remainder());
+    for (a, b) in xc.zip(yc) {
+        for l in 0..LANES {
+            acc[l] = acc[l].add(a[l].mul(b[l]));
+        }
+    }
+    let mut r = acc.into_iter().fold(T::ZERO, T::add);
+    for (&a, &b) in xr.iter().zip(yr) {
+        r = r.add(a.mul(b));
+    }
+    r
+}
+
+/// y ← a·x + y（先乘后加，不融合，保证各路径舍入一致）。
+#[inline(always)]
+fn axpy<T: Elem>(a: T, x: &[T], y: &mut [T]) {
+    for (yi, &xi) in y.iter_mut().zip(x) {
+        *yi = a.mul(xi).add(*yi);
+    }
+}
+
+#[inline(always)]
+fn zip_with<T: Elem, U>(x: &[T], y: &[T], out: &mut [U], f: impl Fn(T, T) -> U) {
+    for ((o, &a), &b) in out.iter_mut().zip(x).zip(y) {
+        *o = f(a, b);
+    }
+}
+
+#[inline(always)]
+fn add<T: Elem>(x: &[T], y: &[T], out: &mut [T]) {
+    zip_with(x, y, out, T::add)
+}
+
+#[inline(always)]
+fn sub<T: Elem>(x: &[T], y: &[T], out: &mut [T]) {
+    zip_with(x, y, out, T::sub)
+}
+
+#[inline(always)]
+fn mul<T: Elem>(x: &[T], y: &[T], out: &mut [T]) {
+    zip_with(x, y, out, T::mul)
+}
+
+#[inline(always)]
+fn lt<T: Elem>(x: &[T], y: &[T], out: &mut [i64]) {
+    zip_with(x, y, out, |a, b| (a < b) as i64)
+}
+
+#[inline(always)]
+fn gt<T: Elem>(x: &[T], y: &[T], out: &mut [i64]) {
+    zip_with(x, y, out, |a, b| (a > b) as i64)
+}
+
+#[inline(always)]
+fn eq<T: Elem>(x: &[T], y: &[T], out: &mut [i64]) {
+    zip_with(x, y, out, |a, b| (a == b) as i64)
+}
+
+/// 包含式前缀和。跨元素依赖无法分路，逐元素累加（与用户循环的舍入一致）。
+fn prefix_sum<T: Elem>(x: &[T]) -> Vec<T> {
+    let mut acc = T::ZERO;
+    x.iter()
+        .map(|&v| {
+            acc = acc.add(v);
+            acc
+        })
+        .collect()
+}
+
+/// 为每个内核生成单态入口：x86-64 上运行时检测 AVX2 再选版本。
+macro_rules! multiversion {
+    ($($(#[$doc:meta])* pub fn $name:ident = $imp:ident::<$t:ty>($($arg:ident: $ty:ty),*) $(-> $ret:ty)?;)*) => {$(
+        $(#[$doc])*
+        pub fn $name($($arg: $ty),*) $(-> $ret)? {
+            #[cfg(target_arch = "x86_64")]
+            {
+                #[target_feature(enable = "avx2")]
+                unsafe fn avx2($($arg: $ty),*) $(-> $ret)? {
+                    $imp::<$t>($($arg),*)
+                }
+                if std::arch::is_x86_feature_detected!("avx2") {
+                    // SAFETY: 已检测到 AVX2
+                    return unsafe { avx2($($arg),*) };
+                }
+            }
+            $imp::<$t>($($arg),*)
+        }
+    )*};
+}
+
+multiversion! {
+    pub fn sum_i64 = sum::<i64>(x: &[i64]) -> i64;
+    pub fn sum_f64 = sum::<f64>(x: &[f64]) -> f64;
+    /// `x` 非空。
+    pub fn min_i64 = min::<i64>(x: &[i64]) -> i64;
+    /// `x` 非空。
+    pub fn min_f64 = min::<f64>(x: &[f64]) -> f64;
+    /// `x` 非空。
+    pub fn max_i64 = max::<i64>(x: &[i64]) -> i64;
+    /// `x` 非空。
+    pub fn max_f64 = max::<f64>(x: &[f64]) -> f64;
+    pub fn dot_i64 = dot::<i64>(x: &[i64], y: &[i64]) -> i64;
+    pub fn dot_f64 = dot::<f64>(x: &[f64], y: &[f64]) -> f64;
+    pub fn axpy_i64 = axpy::<i64>(a: i64, x: &[i64], y: &mut [i64]);
+    pub fn axpy_f64 = axpy::<f64>(a: f64, x: &[f64], y: &mut [f64]);
+    pub fn add_i64 = add::<i64>(x: &[i64], y: &[i64], out: &mut [i64]);
+    pub fn add_f64 = add::<f64>(x: &[f64], y: &[f64], out: &mut [f64]);
+    pub fn sub_i64 = sub::<i64>(x: &[i64], y: &[i64], out: &mut [i64]);
+    pub fn sub_f64 = sub::<f64>(x: &[f64], y: &[f64], out: &mut [f64]);
+    pub fn mul_i64 = mul::<i64>(x: &[i64], y: &[i64], out: &mut [i64]);
+    pub fn mul_f64 = mul::<f64>(x: &[f64], y: &[f64], out: &mut [f64]);
+    pub fn lt_i64 = lt::<i64>(x: &[i64], y: &[i64], out: &mut [i64]);
+    pub fn lt_f64 = lt::<f64>(x: &[f64], y: &[f64], out: &mut [i64]);
+    pub fn gt_i64 = gt::<i64>(x: &[i64], y: &[i64], out: &mut [i64]);
+    pub fn gt_f64 = gt::<f64>(x: &[f64], y: &[f64], out: &mut [i64]);
+    pub fn eq_i64 = eq::<i64>(x: &[i64], y: &[i64], out: &mut [i64]);
+    pub fn eq_f64 = eq::<f64>(x: &[f64], y: &[f64], out: &mut [i64]);
+}
+
+// ── native 包装 ──
+
+/// 内核 native 函数，按注册顺序（下标从 `stdlib` 基础函数之后接着排）。
+pub fn register() -> Vec<(&'static str, NativeFn)> {
+    vec![
+        ("int_array", int_array_fn),
+        ("float_array", float_array_fn),
+        ("sum", sum_fn),
+        ("min", min_fn),
+        ("max", max_fn),
+        ("dot", dot_fn),
+        ("axpy", axpy_fn),
+        ("fill", fill_fn),
+        ("prefix_sum", prefix_sum_fn),
+        ("array_add", |a, h| {
+            elementwise(a, h, "array_add", add_i64, add_f64)
+        }),
+        ("array_sub", |a, h| {
+            elementwise(a, h, "array_sub", sub_i64, sub_f64)
+        }),
+        ("array_mul", |a, h| {
+            elementwise(a, h, "array_mul", mul_i64, mul_f64)
+        }),
+        ("array_lt", |a, h| mask(a, h, "array_lt", lt_i64, lt_f64)),
+        ("array_gt", |a, h| mask(a, h, "array_gt", gt_i64, gt_f64)),
+        ("array_eq", |a, h| mask(a, h, "array_eq", eq_i64, eq_f64)),
+    ]
+}
+
+/// 实参里的一个类型化数组。
+enum Array<'a> {
+    Int(&'a [i64]),
+    Float(&'a [f64]),
+}
+
+impl Array<'_> {
+    fn len(&self) -> usize {
+        match self {
+            Array::Int(v) => v.len(),
+            Array::Float(v) => v.len(),
+        }
+    }
+}
+
+fn arg(args: &[i64], i: usize, name: &str) -> Result<i64, String> {
+    args.get(i)
+        .copied()
+        .ok_or_else(|| format!("{name} expects {} arguments", i + 1))
+}
+
+fn array<'h>(heap: &'h GcHeap, handle: i64, name: &str) -> Result<Array<'h>, String> {
+    let obj = usize::try_from(handle).ok().and_then(|h| heap.try_get(h));
+    match obj {
+        Some(HeapObj::Int64Array(v)) => Ok(Array::Int(v)),
+        Some(HeapObj::Float64Array(v)) => Ok(Array::Float(v)),
+        other => Err(format!(
+            "{name}: expected Int64Array or Float64Array, got {other:?}"
+        )),
+    }
+}
+
+/// 两个同元素类型、同长度的数组。
+fn pair<'h>(heap: &'h GcHeap, args: &[i64], name: &str) -> Result<(Array<'h>, Array<'h>), String> {
+    let x = array(heap, arg(args, 0, name)?, name)?;
+    let y = array(heap, arg(args, 1, name)?, name)?;
+    if x.len() != y.len() {
+        return Err(format!(
+            "{name}: length mismatch ({} vs {})",
+            x.len(),
+            y.len()
+        ));
+    }
+    match (&x, &y) {
+        (Array::Int(_), Array::Int(_)) | (Array::Float(_), Array::Float(_)) => Ok((x, y)),
+        _ => Err(format!("{name}: element types differ")),
+    }
+}
+
+fn len_arg(args: &[i64], name: &str) -> Result<usize, String> {
+    let n = arg(args, 0, name)?;
+    usize::try_from(n).map_err(|_| format!("{name}: negative length {n}"))
+}
+
+fn int_array_fn(args: &[i64], heap: &mut GcHeap) -> Result<i64, String> {
+    let n = len_arg(args, "int_array")?;
+    let v = arg(args, 1, "int_array")?;
+    Ok(heap.alloc(HeapObj::Int64Array(vec![v; n])) as i64)
+}
+
+fn float_array_fn(args: &[i64], heap: &mut GcHeap) -> Result<i64, String> {
+    let n = len_arg(args, "float_array")?;
+    let v = f64::from_bits(arg(args, 1, "float_array")? as u64);
+    Ok(heap.alloc(HeapObj::Float64Array(vec![v; n])) as i64)
+}
+
+fn sum_fn(args: &[i64], heap: &mut GcHeap) -> Result<i64, String> {
+    Ok(match array(heap, arg(args, 0, "sum")?, "sum")? {
+        Array::Int(v) => sum_i64(v),
+        Array::Float(v) => sum_f64(v).to_bits() as i64,
+    })
+}
+
+fn min_fn(args: &[i64], heap: &mut GcHeap) -> Result<i64, String> {
+    Ok(match array(heap, arg(args, 0, "min")?, "min")? {
+        Array::Int([]) | Array::Float([]) => return Err("min of an empty array".into()),
+        Array::Int(v) => min_i64(v),
+        Array::Float(v) => min_f64(v).to_bits() as i64,
+    })
+}
+
+fn max_fn(args: &[i64], heap: &mut GcHeap) -> Result<i64, String> {
+    Ok(match array(heap, arg(args, 0, "max")?, "max")? {
+        Array::Int([]) | Array::Float([]) => return Err("max of an empty array".into()),
+        Array::Int(v) => max_i64(v),
+        Array::Float(v) => max_f64(v).to_bits() as i64,
+    })
+}
+
+fn dot_fn(args: &[i64], heap: &mut GcHeap) -> Result<i64, String> {
+    Ok(match pair(heap, args, "dot")? {
+        (Array::Int(x), Array::Int(y)) => dot_i64(x, y),
+        (Array::Float(x), Array::Float(y)) => dot_f64(x, y).to_bits() as i64,
+        _ => unreachable!("pair checks element types"),
+    })
+}
+
+/// axpy(a, xs, ys)：ys ← a·xs + ys，原地更新。
+fn axpy_fn(args: &[i64], heap: &mut GcHeap) -> Result<i64, String> {
+    let a = arg(args, 0, "axpy")?;
+    let (xh, yh) = (arg(args, 1, "axpy")?, arg(args, 2, "axpy")?);
+    // 先把 xs 读成独立副本（xs 与 ys 可以是同一个数组）
+    let x = match pair(heap, &[xh, yh], "axpy")?.0 {
+        Array::Int(x) => Owned::Int(x.to_vec()),
+        Array::Float(x) => Owned::Float(x.to_vec()),
+    };
+    match (heap.get_mut(yh as usize), x) {
+        (HeapObj::Int64Array(y), Owned::Int(x)) => axpy_i64(a, &x, y),
+        (HeapObj::Float64Array(y), Owned::Float(x)) => axpy_f64(f64::from_bits(a as u64), &x, y),
+        _ => unreachable!("pair checks element types"),
+    }
+    Ok(0)
+}
+
+/// fill(xs, v)：原地把每个元素写成 v。
+fn fill_fn(args: &[i64], heap: &mut GcHeap) -> Result<i64, String> {
+    let h = arg(args, 0, "fill")?;
+    let v = arg(args, 1, "fill")?;
+    array(heap, h, "fill")?;
+    match heap.get_mut(h as usize) {
+        HeapObj::Int64Array(xs) => xs.fill(v),
+        HeapObj::Float64Array(xs) => xs.fill(f64::from_bits(v as u64)),
+        _ => unreachable!("checked by array()"),
+    }
+    Ok(0)
+}
+
+fn prefix_sum_fn(args: &[i64], heap: &mut GcHeap) -> Result<i64, String> {
+    let obj = match array(heap, arg(args, 0, "prefix_sum")?, "prefix_sum")? {
+        Array::Int(v) => HeapObj::Int64Array(prefix_sum(v)),
+        Array::Float(v) => HeapObj::Float64Array(prefix_sum(v)),
+    };
+    Ok(heap.alloc(obj) as i64)
+}
+
+type IntKernel<U> = fn(&[i64], &[i64], &mut [U]);
+type FloatKernel<U> = fn(&[f64], &[f64], &mut [U]);
+
+/// 逐元素运算，结果是同元素类型的新数组。
+fn elementwise(
+    args: &[i64],
+    heap: &mut GcHeap,
+    name: &str,
+    int: IntKernel<i64>,
+    float: FloatKernel<f64>,
+) -> Result<i64, String> {
+    let obj = match pair(heap, args, name)? {
+        (Array::Int(x), Array::Int(y)) => {
+            let mut out = vec![0; x.len()];
+            int(x, y, &mut out);
+            HeapObj::Int64Array(out)
+        }
+        (Array::Float(x), Array::Float(y)) => {
+            let mut out = vec![0.0; x.len()];
+            float(x, y, &mut out);
+            HeapObj::Float64Array(out)
+        }
+        _ => unreachable!("pair checks element types"),
+    };
+    Ok(heap.alloc(obj) as i64)
+}
+
+/// 逐元素比较，结果是 0 / 1 的 `Int64Array` 掩码。
+fn mask(
+    args: &[i64],
+    heap: &mut GcHeap,
+    name: &str,
+    int: IntKernel<i64>,
+    float: FloatKernel<i64>,
+) -> Result<i64, String> {
+    let (x, y) = pair(heap, args, name)?;
+    let mut out = vec![0; x.len()];
+    match (x, y) {
+        (Array::Int(x), Array::Int(y)) => int(x, y, &mut out),
+        (Array::Float(x), Array::Float(y)) => float(x, y, &mut out),
+        _ => unreachable!("pair checks element types"),
+    }
+    Ok(heap.alloc(HeapObj::Int64Array(out)) as i64)
+}
+
+/// `axpy` 的 xs 副本。
+enum Owned {
+    Int(Vec<i64>),
+    Float(Vec<f64>),
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn floats(n: usize) -> Vec<f64> {
+        (0..n).map(|i| (i as f64 * 0.37).sin() * 100.0).collect()
+    }
+
+    #[test]
+    fn dispatched_kernels_match_the_scalar_path_bit_for_bit() {
+        // 覆盖整块、尾部和空输入
+        for n in [0, 1, 7, 8, 9, 1000, 1003] {
+            let (x, y) = (floats(n), floats(n + 5)[5..].to_vec());
+            assert_eq!(sum_f64(&x).to_bits(), sum::<f64>(&x).to_bits());
+            assert_eq!(dot_f64(&x, &y).to_bits(), dot::<f64>(&x, &y).to_bits());
+            let ints: Vec<i64> = (0..n as i64).map(|i| i * 7 - 300).collect();
+            assert_eq!(sum_i64(&ints), ints.iter().sum::<i64>());
+            assert_eq!(
+                dot_i64(&ints, &ints),
+                ints.iter().map(|v| v * v).sum::<i64>()
+            );
+            if n > 0 {
+                assert_eq!(min_i64(&ints), *ints.iter().min().unwrap());
+                assert_eq!(max_f64(&x), x.iter().copied().fold(f64::MIN, f64::max));
+            }
+        }
+    }
+
+    #[test]
+    fn integer_kernels_wrap_like_the_vm() {
+        assert_eq!(sum_i64(&[i64::MAX, 1]), i64::MIN);
+        let mut out = [0; 2];
+        mul_i64(&[i64::MAX, 3], &[2, 4], &mut out);
+        assert_eq!(out, [-2, 12]);
+    }
+
+    #[test]
+    fn float_min_max_ignore_nan() {
+        let x = [3.0, f64::NAN, -1.0, 2.0];
+        assert_eq!(min_f64(&x), -1.0);
+        assert_eq!(max_f64(&x), 3.0);
+    }
+
+    fn call(name: &str, args: &[i64], heap: &mut GcHeap) -> Result<i64, String> {
+        let (_, f) = register().into_iter().find(|(n, _)| *n == name).unwrap();
+        f(args, heap)
+    }
+
+    #[test]
+    fn natives_allocate_and_update_arrays() {
+        let mut heap = GcHeap::new();
+        let xs = call("float_array", &[4, 1.5f64.to_bits() as i64], &mut heap).unwrap();
+        let ys = call("float_array", &[4, 2.0f64.to_bits() as i64], &mut heap).unwrap();
+        call("axpy", &[2.0f64.to_bits() as i64, xs, ys], &mut heap).unwrap();
+        let s = call("sum", &[ys], &mut heap).unwrap();
+        assert_eq!(f64::from_bits(s as u64), 4.0 * 5.0);
+
+        // xs 与 ys 是同一个数组时先读出副本
+        call("axpy", &[1.0f64.to_bits() as i64, xs, xs], &mut heap).unwrap();
+        let ps = call("prefix_sum", &[xs], &mut heap).unwrap();
+        assert!(
+            matches!(heap.get(ps as usize), HeapObj::Float64Array(v) if v == &[3.0, 6.0, 9.0, 12.0])
+        );
+
+        let is = call("int_array", &[3, 5], &mut heap).unwrap();
+        let js = call("prefix_sum", &[is], &mut heap).unwrap();
+        let m = call("array_lt", &[is, js], &mut heap).unwrap();
+        assert!(matches!(heap.get(m as usize), HeapObj::Int64Array(v) if v == &[0, 1, 1]));
+        call("fill", &[js, 9], &mut heap).unwrap();
+        assert_eq!(call("max", &[js], &mut heap), Ok(9));
+    }
+
+    #[test]
+    fn natives_reject_mismatched_arrays() {
+        let mut heap = GcHeap::new();
+        let is = call("int_array", &[3, 1], &mut heap).unwrap();
+        let fs = call("float_array", &[3, 0], &mut heap).unwrap();
+        let short = call("int_array", &[2, 1], &mut heap).unwrap();
+        let empty = call("int_array", &[0, 0], &mut heap).unwrap();
+        assert!(call("dot", &[is, fs], &mut heap).is_err());
+        assert!(call("array_add", &[is, short], &mut heap).is_err());
+        assert!(call("min", &[empty], &mut heap).is_err());
+        assert!(call("int_array", &[-1, 0], &mut heap).is_err());
+        assert!(call("sum", &[-5], &mut heap).is_err());
+    }
+}
@@ -1,15 +1,41 @@
 //! kaubo-vm — 寄存器 VM (CPS block scheduler)
 //!
-//! 44 opcodes, 零栈操作, 零控制流 opcode
-//! 分层寄存器: int_regs / float_regs / ptr_regs
-//! 引用计数 GC
+//! 68 个 opcode（`execute::Opcode`，7 位编码），零栈操作；块以 Jump / Branch /
+//! Call 等终结指令结束，热点指令对在预解码时融合成超级指令（`decode`）
+//! 统一 u64 寄存器文件：所有帧共用一个寄存器栈，每帧一个窗口（`regfile`）
+//! 引用计数 GC + 备用标记清除（回收环）
 
 pub mod async_runtime;
+pub mod decode;
+pub mod edges;
 pub mod execute;
+pub mod fields;
 pub mod gc_heap;
+pub mod image;
+pub mod inline_cache;
+pub mod io_poller;
+#[cfg(feature = "jit")]
+pub mod jit;
+pub mod kernels;
+pub mod output;
+pub mod profile;
+pub mod program;
 pub mod regfile;
 pub mod stdlib;
+pub mod timer_wheel;
+
+/// 本次构建的 VM 是否带基线 JIT（`jit` feature）。
+///
+/// 下游 crate 的 feature 不代表 VM 的：`kaubo-vm/jit` 可以被别的依赖方单独打开，
+/// 依赖 JIT 行为的测试看这个常量。
+pub const JIT_ENABLED: bool = cfg!(feature = "jit");
 
 pub use async_runtime::*;
 pub use execute::*;
+pub use fields::Fields;
+pub use gc_heap::HeapStats;
+pub use inline_cache::IcStats;
+pub use output::{CollectSink, OutputSink, RingSink, WriteSink};
+pub use profile::{ProfileConfig, Profiler};
+pub use program::LoadedProgram;
 pub use regfile::*;
@@ -0,0 +1,282 @@
+//! print 的输出端 — `VM::sink` 可替换
+//!
+//! 每次 `print` 是一行，VM 按值的类型调用 `print_str` / `print_int`：
+//!   - `CollectSink`：收集成 `Vec<String>`（默认，测试与 `RunOutcome` 用）
+//!   - `WriteSink`：写进任意 `io::Write`（stdout、文件），数字直接格式化进
+//!     复用的字节缓冲，攒满一块才写出，不为每行分配 `String`
+//!   - `RingSink`：只保留最近 N 行（playground），旧行丢弃并计数
+
+use std::collections::VecDeque;
+use std::io::{self, Write};
+
+pub trait OutputSink: Send {
+    /// 输出一行（不含换行符）。
+    fn print_str(&mut self, s: &str);
+
+    /// 输出一行整数。
+    fn print_int(&mut self, n: i64) {
+        let mut buf = [0u8; 20];
+        self.print_str(format_int(n, &mut buf));
+    }
+
+    /// 输出一行浮点数（与 `to_string()` 的格式相同）。
+    fn print_float(&mut self, x: f64) {
+        self.print_str(&x.to_string());
+    }
+
+    /// 把缓冲的输出写到底层设备。
+    fn flush(&mut self) -> io::Result<()> {
+        Ok(())
+    }
+
+    /// 取走保存在内存里的行；流式输出端没有，返回空。
+    fn take_lines(&mut self) -> Vec<String> {
+        Vec::new()
+    }
+
+    /// `VM::reset` 时调用：丢弃上一次执行留在内存里的行。
+    fn clear(&mut self) {}
+}
+
+/// 把 `n` 的十进制写进 `buf` 尾部，返回写好的部分。
+pub fn format_int(n: i64, buf: &mut [u8; 20]) -> &str {
+    let mut i = buf.len();
+    let mut v = n.unsigned_abs();
+    loop {
+        i -= 1;
+        buf[i] = b'0' + (v % 10) as u8;
+        v /= 10;
+        if v == 0 {
+            break;
+        }
+    }
+    if n < 0 {
+        i -= 1;
+        buf[i] = b'-';
+    }
+    // 只写了 ASCII 数字和负号
+    std::str::from_utf8(&buf[i..]).unwrap()
+}
+
+// ── 收集 ──
+
+/// 收集所有输出行。
+#[derive(Debug, Default)]
+pub struct CollectSink {
+    pub lines: Vec<String>,
+}
+
+impl CollectSink {
+    pub fn new() -> Self {
+        Self::default()
+    }
+}
+
+impl OutputSink for CollectSink {
+    fn print_str(&mut self, s: &str) {
+        self.lines.push(s.to_string());
+    }
+
+    fn take_lines(&mut self) -> Vec<String> {
+        std::mem::take(&mut self.lines)
+    }
+
+    fn clear(&mut self) {
+        self.lines.clear();
+    }
+}
+
+// ── io::Write ──
+
+/// `WriteSink` 攒到这么多字节就写出一次。
+pub const WRITE_CHUNK: usize = 8 << 10;
+
+/// 带缓冲的 `io::Write` 输出端。
+///
+/// `print_*` 不能返回错误：第一次写失败后丢弃后续输出，错误留给 `flush` 报告。
+pub struct WriteSink<W: Write + Send> {
+    out: W,
+    buf: Vec<u8>,
+    error: Option<io::Error>,
+}
+
+impl<W: Write + Send> WriteSink<W> {
+    pub fn new(out: W) -> Self {
+        WriteSink {
+            out,
+            buf: Vec::with_capacity(WRITE_CHUNK),
+            error: None,
+        }
+    }
+
+    /// 底层 writer（尚未写出的缓冲不在其中）。
+    pub fn get_ref(&self) -> &W {
+        &self.out
+    }
+
+    fn end_line(&mut self) {
+        self.buf.push(b'\n');
+        if self.buf.len() >= WRITE_CHUNK {
+            self.drain();
+        }
+    }
+
+    fn drain(&mut self) {
+        if self.error.is_none() {
+            if let Err(e) = self.out.write_all(&self.buf) {
+                self.error = Some(e);
+            }
+        }
+        self.buf.clear();
+    }
+}
+
+impl<W: Write + Send> OutputSink for WriteSink<W> {
+    fn print_str(&mut self, s: &str) {
+        self.buf.extend_from_slice(s.as_bytes());
+        self.end_line();
+    }
+
+    fn print_int(&mut self, n: i64) {
+        let mut digits = [0u8; 20];
+        self.buf
+            .extend_from_slice(format_int(n, &mut digits).as_bytes());
+        self.end_line();
+    }
+
+    fn print_float(&mut self, x: f64) {
+        // 写进 Vec<u8> 不会失败
+        let _ = write!(self.buf, "{x}");
+        self.end_line();
+    }
+
+    fn flush(&mut self) -> io::Result<()> {
+        self.drain();
+        if let Some(e) = self.error.take() {
+            return Err(e);
+        }
+        self.out.flush()
+    }
+}
+
+impl<W: Write + Send> Drop for WriteSink<W> {
+    fn drop(&mut self) {
+        let _ = self.flush();
+    }
+}
+
+// ── 环形缓冲 ──
+
+/// 只保留最近 `capacity` 行。
+#[derive(Debug)]
+pub struct RingSink {
+    lines: VecDeque<String>,
+    capacity: usize,
+    dropped: usize,
+}
+
+impl RingSink {
+    pub fn new(capacity: usize) -> Self {
+        RingSink {
+            lines: VecDeque::with_capacity(capacity.min(1024)),
+            capacity: capacity.max(1),
+            dropped: 0,
+        }
+    }
+
+    /// 因超出容量被丢弃的行数。
+    pub fn dropped(&self) -> usize {
+        self.dropped
+    }
+}
+
+impl OutputSink for RingSink {
+    fn print_str(&mut self, s: &str) {
+        // 满了就复用最旧一行的缓冲
+        let mut line = if self.lines.len() == self.capacity {
+            self.dropped += 1;
+            self.lines.pop_front().unwrap()
+        } else {
+            String::new()
+        };
+        line.clear();
+        line.push_str(s);
+        self.lines.push_back(line);
+    }
+
+    fn take_lines(&mut self) -> Vec<String> {
+        self.lines.drain(..).collect()
+    }
+
+    fn clear(&mut self) {
+        self.lines.clear();
+        self.dropped = 0;
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn integers_format_like_display() {
+        let mut buf = [0u8; 20];
+        for n in [0, 7, -7, 1234567890, i64::MIN, i64::MAX] {
+            assert_eq!(format_int(n, &mut buf), n.to_string());
+        }
+    }
+
+    #[test]
+    fn write_sink_buffers_until_flush() {
+        let mut sink = WriteSink::new(Vec::new());
+        sink.print_str("a");
+        sink.print_int(-42);
+        sink.print_float(2.5);
+        sink.print_float(3.0);
+        assert!(sink.get_ref().is_empty());
+        sink.flush().unwrap();
+        assert_eq!(sink.get_ref().as_slice(), b"a\n-42\n2.5\n3\n");
+    }
+
+    #[test]
+    fn write_sink_emits_full_chunks() {
+        let mut sink = WriteSink::new(Vec::new());
+        let line = "x".repeat(1023);
+        for _ in 0..8 {
+            sink.print_str(&line);
+        }
+        assert_eq!(sink.out.len(), WRITE_CHUNK);
+        assert!(sink.buf.is_empty());
+    }
+
+    #[test]
+    fn write_sink_reports_the_first_error_on_flush() {
+        struct Broken;
+        impl Write for Broken {
+            fn write(&mut self, _: &[u8]) -> io::Result<usize> {
+                Err(io::Error::other("closed"))
+            }
+            fn flush(&mut self) -> io::Result<()> {
+                Ok(())
+            }
+        }
+        let mut sink = WriteSink::new(Broken);
+        sink.print_str("lost");
+        assert_eq!(sink.flush().unwrap_err().to_string(), "closed");
+        assert!(sink.flush().is_ok());
+    }
+
+    #[test]
+    fn ring_sink_keeps_the_newest_lines() {
+        let mut sink = RingSink::new(3);
+        for n in 0..5 {
+            sink.print_int(n);
+        }
+        assert_eq!(sink.dropped(), 2);
+        assert_eq!(sink.take_lines(), vec!["2", "3", "4"]);
+        sink.print_str("again");
+        sink.clear();
+        assert!(sink.take_lines().is_empty());
+        assert_eq!(sink.dropped(), 0);
+    }
+}
@@ -0,0 +1,340 @@
+//! 采样 profiler — 挂在燃料检查点上，生产环境也能开
+//!
+//! 回边和调用本来就要扣燃料（`VM::burn_fuel`），profiler 只在这两处记账：
+//!   - 每个函数的调用次数、回边次数，每个回边目标块的次数（精确计数）
+//!   - 每隔 `sample_period` 个检查点，从 `VM::frames` 抓一次调用栈
+//!   - 可选的 opcode 直方图：需要逐条计数，开启后 VM 走 `Encoded` 分发
+//!
+//! 没挂 profiler 时检查点上只多一次 `Option` 判断。调用栈按函数下标记录，
+//! 输出时借 `LoadedProgram::func_names` / `func_owners` 还原成 `模块:函数`。
+
+use crate::execute::{CallFrame, Opcode};
+use crate::program::LoadedProgram;
+use std::collections::HashMap;
+use std::fmt::Write;
+
+/// 默认每 97 个检查点采一次栈（取素数，避免与循环周期同步）。
+pub const DEFAULT_SAMPLE_PERIOD: u32 = 97;
+
+#[derive(Debug, Clone, Copy)]
+pub struct ProfileConfig {
+    /// 每隔多少个检查点采一次调用栈，1 表示每次都采。
+    pub sample_period: u32,
+    /// 统计 opcode 直方图。
+    pub opcodes: bool,
+}
+
+impl Default for ProfileConfig {
+    fn default() -> Self {
+        ProfileConfig {
+            sample_period: DEFAULT_SAMPLE_PERIOD,
+            opcodes: false,
+        }
+    }
+}
+
+#[derive(Debug)]
+pub struct Profiler {
+    config: ProfileConfig,
+    countdown: u32,
+    /// 按函数：被调用次数（含自尾调用）。
+    pub calls: Vec<u64>,
+    /// 按函数：回边次数。
+    pub back_edges: Vec<u64>,
+    /// 按函数、块：作为回边目标的次数。
+    pub blocks: Vec<Vec<u64>>,
+    /// 按 opcode 的执行次数（`ProfileConfig::opcodes`）。
+    pub opcodes: Option<Box<[u64; 128]>>,
+    /// 调用栈（栈底在前）→ 采样次数。
+    stacks: HashMap<Box<[u32]>, u64>,
+    scratch: Vec<u32>,
+    /// 采样总数。
+    pub samples: u64,
+}
+
+impl Profiler {
+    pub fn new(config: ProfileConfig) -> Self {
+        let config = ProfileConfig {
+            sample_period: config.sample_period.max(1),
+            ..config
+        };
+        Profiler {
+            config,
+            countdown: config.sample_period,
+            calls: vec![],
+            back_edges: vec![],
+            blocks: vec![],
+            opcodes: config.opcodes.then(|| Box::new([0; 128])),
+            stacks: HashMap::new(),
+            scratch: vec![],
+            samples: 0,
+        }
+    }
+
+    pub fn config(&self) -> ProfileConfig {
+        self.config
+    }
+
+    /// 按 `program` 的函数 / 块数扩展计数表（已有的计数保留）。
+    pub(crate) fn fit(&mut self, program: &LoadedProgram) {
+        let n = program.func_count();
+        self.calls.resize(n, 0);
+        self.back_edges.resize(n, 0);
+        self.blocks.resize(n, vec![]);
+        for (counts, blocks) in self.blocks.iter_mut().zip(&program.func_blocks) {
+            if counts.len() < blocks.len() {
+                counts.resize(blocks.len(), 0);
+            }
+        }
+    }
+
+    /// 清零所有计数与采样。
+    pub fn clear(&mut self) {
+        self.calls.iter_mut().for_each(|c| *c = 0);
+        self.back_edges.iter_mut().for_each(|c| *c = 0);
+        self.blocks.iter_mut().flatten().for_each(|c| *c = 0);
+        if let Some(h) = &mut self.opcodes {
+            h.fill(0);
+        }
+        self.stacks.clear();
+        self.samples = 0;
+        self.countdown = self.config.sample_period;
+    }
+
+    /// 检查点：刚进入 `func`（`frames` 是调用方链）。
+    #[inline]
+    pub(crate) fn on_call(&mut self, func: usize, frames: &[CallFrame]) {
+        self.calls[func] += 1;
+        self.tick(func, frames);
+    }
+
+    /// 检查点：`func` 内跳回 `block`。
+    #[inline]
+    pub(crate) fn on_back_edge(&mut self, func: usize, block: usize, frames: &[CallFrame]) {
+        self.back_edges[func] += 1;
+        if let Some(c) = self.blocks[func].get_mut(block) {
+            *c += 1;
+        }
+        self.tick(func, frames);
+    }
+
+    #[inline]
+    pub(crate) fn on_instr(&mut self, inst: u32) {
+        if let Some(h) = &mut self.opcodes {
+            h[((inst >> 25) & 0x7F) as usize] += 1;
+        }
+    }
+
+    pub(crate) fn wants_opcodes(&self) -> bool {
+        self.opcodes.is_some()
+    }
+
+    #[inline(always)]
+    fn tick(&mut self, func: usize, frames: &[CallFrame]) {
+        self.countdown -= 1;
+        if self.countdown == 0 {
+            self.countdown = self.config.sample_period;
+            self.sample(func, frames);
+        }
+    }
+
+    #[cold]
+    fn sample(&mut self, func: usize, frames: &[CallFrame]) {
+        self.samples += 1;
+        self.scratch.clear();
+        self.scratch
+            .extend(frames.iter().map(|f| f.func_idx as u32));
+        self.scratch.push(func as u32);
+        match self.stacks.get_mut(&self.scratch[..]) {
+            Some(n) => *n += 1,
+            None => {
+                self.stacks.insert(self.scratch.as_slice().into(), 1);
+            }
+        }
+    }
+
+    /// 采到的调用栈（栈底在前），按栈排序。
+    pub fn stacks(&self) -> Vec<(&[u32], u64)> {
+        let mut v: Vec<_> = self.stacks.iter().map(|(s, &n)| (&s[..], n)).collect();
+        v.sort_unstable();
+        v
+    }
+
+    /// 非零的 opcode 计数，按次数降序。
+    pub fn opcode_counts(&self) -> Vec<(Opcode, u64)> {
+        let Some(h) = &self.opcodes else {
+            return vec![];
+        };
+        let mut v: Vec<_> = h
+            .iter()
+            .enumerate()
+            // 只有真实执行过的 opcode 计数非零
+            .filter(|(_, &n)| n > 0)
+            .filter_map(|(op, &n)| Some((Opcode::try_from(op as u8).ok()?, n)))
+            .collect();
+        v.sort_by(|a, b| b.1.cmp(&a.1).then((a.0 as u8).cmp(&(b.0 as u8))));
+        v
+    }
+
+    /// flamegraph 的 folded-stack 格式：每行 `a;b;c 次数`。
+    pub fn folded(&self, program: &LoadedProgram) -> String {
+        let mut out = String::new();
+        for (stack, n) in self.stacks() {
+            for (i, &f) in stack.iter().enumerate() {
+                if i > 0 {
+                    out.push(';');
+                }
+                out.push_str(&func_label(program, f as usize));
+            }
+            let _ = writeln!(out, " {n}");
+        }
+        out
+    }
+
+    /// JSON 报告。栈里是 `functions` 的下标。
+    pub fn to_json(&self, program: &LoadedProgram) -> String {
+        let mut out = String::new();
+        let _ = write!(
+            out,
+            "{{\"sample_period\":{},\"samples\":{},\"functions\":[",
+            self.config.sample_period, self.samples
+        );
+        for f in 0..program.func_count() {
+            if f > 0 {
+                out.push(',');
+            }
+            out.push_str("{\"name\":");
+            json_str(&mut out, name_of(&program.func_names, f));
+            out.push_str(",\"module\":");
+            json_str(&mut out, name_of(&program.func_owners, f));
+            let _ = write!(
+                out,
+                ",\"calls\":{},\"back_edges\":{},\"blocks\":{{",
+                self.calls.get(f).copied().unwrap_or(0),
+                self.back_edges.get(f).copied().unwrap_or(0)
+            );
+            let blocks = self.blocks.get(f).map(Vec::as_slice).unwrap_or(&[]);
+            let hot = blocks.iter().enumerate().filter(|(_, &n)| n > 0);
+            for (i, (b, n)) in hot.enumerate() {
+                let sep = if i > 0 { "," } else { "" };
+                let _ = write!(out, "{sep}\"{b}\":{n}");
+            }
+            out.push_str("}}");
+        }
+        out.push_str("],\"stacks\":[");
+        for (i, (stack, n)) in self.stacks().into_iter().enumerate() {
+            let sep = if i > 0 { "," } else { "" };
+            let _ = write!(out, "{sep}{{\"frames\":{stack:?},\"count\":{n}}}");
+        }
+        out.push_str("],\"opcodes\":{");
+        for (i, (op, n)) in self.opcode_counts().into_iter().enumerate() {
+            let sep = if i > 0 { "," } else { "" };
+            let _ = write!(out, "{sep}\"{op:?}\":{n}");
+        }
+        out.push_str("}}");
+        out
+    }
+}
+
+fn name_of(names: &[Box<str>], f: usize) -> &str {
+    names.get(f).map_or("", |s| s)
+}
+
+/// `模块:函数`；单文件程序没有模块名，只用函数名。
+pub fn func_label(program: &LoadedProgram, f: usize) -> String {
+    let name = match name_of(&program.func_names, f) {
+        "" => format!("fn{f}"),
+        name => name.to_string(),
+    };
+    match name_of(&program.func_owners, f) {
+        "" => name,
+        owner => format!("{owner}:{name}"),
+    }
+}
+
+fn json_str(out: &mut String, s: &str) {
+    out.push('"');
+    for c in s.chars() {
+        match c {
+            '"' => out.push_str("\\\""),
+            '\\' => out.push_str("\\\\"),
+            c if (c as u32) < 0x20 => {
+                let _ = write!(out, "\\u{:04x}", c as u32);
+            }
+            c => out.push(c),
+        }
+    }
+    out.push('"');
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn frame(func_idx: usize) -> CallFrame {
+        CallFrame {
+            func_idx,
+            ret_block: 0,
+            base: 0,
+            len: 0,
+            result_reg: 0,
+        }
+    }
+
+    fn program(names: &[&str], owners: &[&str]) -> LoadedProgram {
+        let mut p = LoadedProgram::empty();
+        p.func_names = names.iter().map(|&s| s.into()).collect();
+        p.func_owners = owners.iter().map(|&s| s.into()).collect();
+        p.func_entries = vec![0; names.len()];
+        p.func_blocks = vec![vec![(0, 0); 2]; names.len()];
+        p
+    }
+
+    #[test]
+    fn counts_checkpoints_and_samples_every_period() {
+        let p = program(&["main", "area"], &["", "shapes"]);
+        let mut prof = Profiler::new(ProfileConfig {
+            sample_period: 2,
+            opcodes: false,
+        });
+        prof.fit(&p);
+        for _ in 0..3 {
+            prof.on_back_edge(0, 1, &[]);
+            prof.on_call(1, &[frame(0)]);
+        }
+        assert_eq!(prof.calls, vec![0, 3]);
+        assert_eq!(prof.back_edges, vec![3, 0]);
+        assert_eq!(prof.blocks[0], vec![0, 3]);
+        // 第 2、4、6 个检查点：都落在 area 里
+        assert_eq!(prof.samples, 3);
+        assert_eq!(prof.stacks(), vec![(&[0u32, 1][..], 3)]);
+        assert_eq!(prof.folded(&p), "main;shapes:area 3\n");
+
+        prof.clear();
+        assert_eq!(prof.samples, 0);
+        assert!(prof.stacks().is_empty());
+        assert_eq!(prof.calls, vec![0, 0]);
+    }
+
+    #[test]
+    fn json_report_names_functions_and_opcodes() {
+        let p = program(&["main", "say \"hi\""], &["", ""]);
+        let mut prof = Profiler::new(ProfileConfig {
+            sample_period: 1,
+            opcodes: true,
+        });
+        prof.fit(&p);
+        prof.on_call(1, &[frame(0)]);
+        prof.on_instr(crate::execute::encode(Opcode::AddInt as u8, 0, 0, 0));
+        prof.on_instr(crate::execute::encode(Opcode::AddInt as u8, 0, 0, 0));
+        prof.on_instr(crate::execute::encode(Opcode::Print as u8, 0, 0, 0));
+        assert_eq!(
+            prof.to_json(&p),
+            "{\"sample_period\":1,\"samples\":1,\"functions\":[\
+             {\"name\":\"main\",\"module\":\"\",\"calls\":0,\"back_edges\":0,\"blocks\":{}},\
+             {\"name\":\"say \\\"hi\\\"\",\"module\":\"\",\"calls\":1,\"back_edges\":0,\"blocks\":{}}],\
+             \"stacks\":[{\"frames\":[0, 1],\"count\":1}],\
+             \"opcodes\":{\"AddInt\":2,\"Print\":1}}"
+        );
+    }
+}
@@ -0,0 +1,649 @@
+//! 加载后的程序映像 — 只读，`Arc` 共享给任意多个 VM 隔离区
+//!
+//! `LoadedProgram::new` 一次性完成编码和边移动表，`from_image` 直接读入这些平铺表
+//! （见 `image`）；之后它不再改变，可以跨线程共享。唯一的例外是预解码：每个函数
+//! 第一次执行时才降为 `DecodedInst`（`decoded`），结果经 `OnceLock` 在所有隔离区间
+//! 共享，冷启动只为用到的函数付费。每个 `VM` 只持有寄存器、调用帧、堆和调度器这些
+//! 执行期状态，`VM::attach` 换程序、`VM::reset` 清状态，都不重新加载。
+//!
+//! 字符串常量要在每个隔离区的堆里常驻，`const_bits` 里存的是堆槽位。
+//! 槽位按 `strings` 的顺序从 0 开始编号：`VM::reset` 在空堆里按同样顺序驻留，
+//! 每个隔离区得到相同的编号，预解码的立即数因此可以共享。
+
+use crate::decode::{self, DecodedInst};
+use crate::edges::{self, EdgeSpan, RegMove, SCRATCH};
+use crate::execute::{encode_instr, encode_term, Inst, Opcode, MAX_BLOCKS};
+use crate::gc_heap::GcHeap;
+use crate::inline_cache::NO_SITE;
+use kaubo_cps::*;
+use std::collections::HashMap;
+use std::sync::OnceLock;
+
+pub struct LoadedProgram {
+    pub consts: Vec<Constant>,
+    /// 每个常量的寄存器位模式：标量按类型编码，字符串是常驻堆槽位。
+    pub const_bits: Vec<u64>,
+    /// 去重后的字符串常量，下标即常驻槽位（见模块文档）。
+    pub strings: Vec<Box<str>>,
+    // Per-function data
+    /// 函数名与归属模块（`CpsModule::func_owners`，单文件程序为空），profiler 用。
+    pub func_names: Vec<Box<str>>,
+    pub func_owners: Vec<Box<str>>,
+    pub func_blocks: Vec<Vec<(usize, usize)>>,
+    pub func_entries: Vec<usize>,
+    pub func_reg_counts: Vec<usize>,
+    pub func_instr_base: Vec<usize>, // start IP in flat instrs array
+    pub block_starts: Vec<usize>,    // flat: block_id → start IP (per func)
+    pub func_block_base: Vec<usize>, // offset into block_starts per function
+    /// 块参数寄存器在 `param_pool` 中的区间 `(start, len)`，下标与 `block_starts` 相同。
+    pub block_params: Vec<(usize, usize)>,
+    pub param_pool: Vec<usize>,
+    pub instrs: Vec<u32>,
+    /// 所有边的寄存器移动，平铺存放（见 `edges`）。
+    pub edge_moves: Vec<RegMove>,
+    /// 每条指令在 `edge_moves` 中的区间，按 IP 与 `instrs` 一一对应。
+    pub edge_spans: Vec<EdgeSpan>,
+    /// 每个函数的预解码指令，首次执行时物化（见 `decoded`）。
+    code: Vec<OnceLock<Box<[DecodedInst]>>>,
+    pub struct_bitmaps: Vec<u64>,
+    pub struct_field_counts: Vec<usize>,
+    pub enum_variant_bitmaps: Vec<Vec<u64>>,
+    pub enum_variant_counts: Vec<Vec<usize>>,
+    pub vtables: Vec<VtableDef>,
+    /// 按 IP：`CallIndirect` 的内联缓存调用点编号，其余为 `inline_cache::NO_SITE`。
+    pub ic_sites: Vec<u32>,
+    /// `CallIndirect` 调用点个数。
+    pub ic_site_count: usize,
+}
+
+impl LoadedProgram {
+    /// 不含任何函数的空程序（`VM::new` 的初始映像）。
+    pub fn empty() -> Self {
+        LoadedProgram {
+            consts: vec![],
+            const_bits: vec![],
+            strings: vec![],
+            func_names: vec![],
+            func_owners: vec![],
+            func_blocks: vec![],
+            func_entries: vec![],
+            func_reg_counts: vec![],
+            func_instr_base: vec![],
+            block_starts: vec![],
+            func_block_base: vec![],
+            block_params: vec![],
+            param_pool: vec![],
+            instrs: vec![],
+            edge_moves: vec![],
+            edge_spans: vec![],
+            code: vec![],
+            struct_bitmaps: vec![],
+            struct_field_counts: vec![],
+            enum_variant_bitmaps: vec![],
+            enum_variant_counts: vec![],
+            vtables: vec![],
+            ic_sites: vec![],
+            ic_site_count: 0,
+        }
+    }
+
+    pub fn new(module: &CpsModule) -> Result<Self, String> {
+        let mut p = Self::empty();
+        p.consts = module.constants.clone();
+        let mut slots: HashMap<&str, usize> = HashMap::new();
+        for c in &module.constants {
+            let bits = match c {
+                Constant::Int(n) => *n as u64,
+                Constant::Float(f) => f.to_bits(),
+                Constant::Bool(b) => *b as u64,
+                Constant::Null => 0,
+                Constant::String(s) => *slots.entry(s.as_str()).or_insert_with(|| {
+                    p.strings.push(s.as_str().into());
+                    p.strings.len() - 1
+                }) as u64,
+            };
+            p.const_bits.push(bits);
+        }
+
+        for sd in &module.structs {
+            let id = sd.id;
+            if id >= p.struct_bitmaps.len() {
+                p.struct_bitmaps.resize(id + 1, 0);
+                p.struct_field_counts.resize(id + 1, 0);
+            }
+            p.struct_bitmaps[id] = sd.type_bitmap;
+            p.struct_field_counts[id] = sd.fields.len();
+        }
+
+        for ed in &module.enums {
+            let id = ed.id;
+            if id >= p.enum_variant_counts.len() {
+                p.enum_variant_counts.resize(id + 1, vec![]);
+                p.enum_variant_bitmaps.resize(id + 1, vec![]);
+            }
+            p.enum_variant_counts[id] = ed.variants.iter().map(|(_, _, f)| f.len()).collect();
+            p.enum_variant_bitmaps[id] = ed.variant_type_bitmaps.clone();
+        }
+
+        p.vtables = module.vtables.clone();
+        p.func_owners = module
+            .func_owners
+            .iter()
+            .map(|o| o.as_str().into())
+            .collect();
+
+        for func in &module.functions {
+            let at = |e: String| format!("{}: {e}", func.name);
+            if let Some(b) = func
+                .blocks
+                .iter()
+                .find(|b| b.id != usize::MAX && b.id >= MAX_BLOCKS)
+            {
+                return Err(at(format!(
+                    "block {} exceeds the {MAX_BLOCKS}-block encoding",
+                    b.id
+                )));
+            }
+            let base_ip = p.instrs.len();
+            let max_id = func
+                .blocks
+                .iter()
+                .filter(|b| b.id != usize::MAX)
+                .map(|b| b.id)
+                .max()
+                .unwrap_or(0)
+                + 1;
+            let mut blocks = vec![(0, 0); max_id];
+            // 先收集全部块参数：边的移动表需要知道目标块的参数寄存器
+            let mut params = vec![vec![]; max_id];
+            for block in func.blocks.iter().filter(|b| b.id != usize::MAX) {
+                params[block.id] = block.params.clone();
+            }
+
+            for block in &func.blocks {
+                if block.id == usize::MAX {
+                    continue;
+                }
+                let start = p.instrs.len();
+                for instr in &block.instrs {
+                    p.instrs.push(encode_instr(instr).map_err(at)?);
+                    p.edge_spans.push(EdgeSpan::default());
+                }
+                let span = p.edge_span(module, &params, &block.term);
+                p.edge_spans.push(span);
+                p.ic_sites.resize(p.instrs.len(), NO_SITE);
+                if matches!(block.term, CpsTerminator::CallIndirect(..)) {
+                    p.ic_sites.push(p.ic_site_count as u32);
+                    p.ic_site_count += 1;
+                } else {
+                    p.ic_sites.push(NO_SITE);
+                }
+                p.instrs.push(encode_term(&block.term).map_err(at)?);
+                blocks[block.id] = (start, p.instrs.len() - start);
+            }
+            let entry_ip = blocks
+                .get(func.entry)
+                .filter(|b| b.1 > 0)
+                .ok_or_else(|| at(format!("jump to missing block {}", func.entry)))?
+                .0;
+            // Build flat block_starts before moving blocks
+            p.func_block_base.push(p.block_starts.len());
+            for (b, regs) in blocks.iter().zip(&params) {
+                p.block_starts.push(b.0);
+                p.block_params.push((p.param_pool.len(), regs.len()));
+                p.param_pool.extend_from_slice(regs);
+            }
+            p.func_names.push(func.name.as_str().into());
+            p.func_blocks.push(blocks);
+            p.func_entries.push(entry_ip);
+            p.func_reg_counts.push(func.reg_count);
+            p.func_instr_base.push(base_ip);
+        }
+        p.validate()?;
+        p.reset_code();
+        Ok(p)
+    }
+
+    /// 每个函数一个空的预解码槽位（构造完平铺表之后调用）。
+    pub(crate) fn reset_code(&mut self) {
+        self.code = (0..self.func_count()).map(|_| OnceLock::new()).collect();
+    }
+
+    /// 函数个数。
+    pub fn func_count(&self) -> usize {
+        self.func_entries.len()
+    }
+
+    /// 函数 `func` 的指令条数（它在 `instrs` 中占 `func_instr_base[func]` 起的一段）。
+    pub fn func_instr_len(&self, func: usize) -> usize {
+        let end = self
+            .func_instr_base
+            .get(func + 1)
+            .copied()
+            .unwrap_or(self.instrs.len());
+        end - self.func_instr_base[func]
+    }
+
+    /// 函数 `func` 的预解码指令，下标是相对 `func_instr_base[func]` 的 IP。
+    ///
+    /// 第一次访问时降级并缓存，之后所有共享这份程序的 VM 都直接用。
+    pub fn decoded(&self, func: usize) -> &[DecodedInst] {
+        self.code[func].get_or_init(|| decode::lower(self, func))
+    }
+
+    /// `func` 是否已经物化过预解码指令。
+    pub fn is_materialized(&self, func: usize) -> bool {
+        self.code[func].get().is_some()
+    }
+
+    /// 块 `block` 的参数寄存器（NewList / NewTuple 从这里取元素）。
+    pub fn block_params(&self, func: usize, block: usize) -> &[usize] {
+        let (start, len) = self.block_params[self.func_block_base[func] + block];
+        &self.param_pool[start..start + len]
+    }
+
+    /// 驱动约定的入口函数（最后一个函数），空程序返回 `None`。
+    pub fn entry(&self) -> Option<usize> {
+        self.func_count().checked_sub(1)
+    }
+
+    /// 在 `heap`（必须是空堆）里按槽位顺序驻留字符串常量。
+    pub(crate) fn intern_strings(&self, heap: &mut GcHeap) {
+        for (slot, s) in self.strings.iter().enumerate() {
+            let idx = heap.intern(s);
+            debug_assert_eq!(
+                idx, slot,
+                "string constants must be interned into an empty heap"
+            );
+        }
+    }
+
+    /// 为终结指令生成移动表，追加到 `edge_moves`。
+    ///
+    /// `params` 是当前函数各块的参数寄存器。
+    fn edge_span(
+        &mut self,
+        module: &CpsModule,
+        params: &[Vec<usize>],
+        term: &CpsTerminator,
+    ) -> EdgeSpan {
+        let out = &mut self.edge_moves;
+        let start = out.len() as u32;
+        let bind = |out: &mut Vec<RegMove>, block: usize, args: &[usize]| {
+            let params = params.get(block).map(Vec::as_slice).unwrap_or(&[]);
+            let pairs: Vec<(usize, usize)> =
+                params.iter().copied().zip(args.iter().copied()).collect();
+            edges::push_parallel_moves(out, &pairs)
+        };
+        let (len, alt_len) = match term {
+            CpsTerminator::Jump(b, a) => (bind(out, *b, a), 0),
+            CpsTerminator::Branch(_, tb, ta, fb, fa) => {
+                let len = bind(out, *tb, ta);
+                (len, bind(out, *fb, fa))
+            }
+            // 编码里没有函数号，VM 把 TailCall 当作自递归：回到当前函数块 0
+            CpsTerminator::TailCall(_, a) => (bind(out, 0, a), 0),
+            CpsTerminator::Call(fi, a, _) => {
+                let limit = module.functions.get(*fi).map_or(0, |f| f.reg_count);
+                (edges::push_arg_copies(out, a, limit), 0)
+            }
+            CpsTerminator::CallNative(_, a, _) | CpsTerminator::CallIndirect(_, a, _) => {
+                (edges::push_arg_copies(out, a, usize::MAX), 0)
+            }
+            _ => (0, 0),
+        };
+        EdgeSpan {
+            start,
+            len,
+            alt_len,
+        }
+    }
+}
+
+/// 帧内可寻址的寄存器数：寄存器操作数最宽的是 9 位的 src1。
+const MAX_FRAME_REGS: usize = 1 << 9;
+
+impl LoadedProgram {
+    /// 核对执行期不再检查的下标：操作码都有效，寄存器字段和移动表都落在帧内，
+    /// 跳转、分支和续体块都存在，调用目标和常量下标在范围内。
+    ///
+    /// `new` 和 `from_image` 构造完平铺表后都调这里：输入可能来自不受信任的字节码
+    /// （`decode_module` / `.kauboc`），报错而不是在执行时越界。
+    pub(crate) fn validate(&self) -> Result<(), String> {
+        for func in 0..self.func_count() {
+            self.check_function(func)
+                .map_err(|e| format!("{}: {e}", self.func_names[func]))?;
+        }
+        for vt in &self.vtables {
+            if let Some((method, f)) = vt.methods.iter().find(|m| m.1 >= self.func_count()) {
+                return Err(format!(
+                    "vtable '{}': method '{method}' names missing function {f}",
+                    vt.interface_name
+                ));
+            }
+        }
+        Ok(())
+    }
+
+    fn check_function(&self, func: usize) -> Result<(), String> {
+        let regs = self.func_reg_counts[func];
+        if regs > MAX_FRAME_REGS {
+            return Err(format!(
+                "{regs} registers exceed the {MAX_FRAME_REGS}-register frame"
+            ));
+        }
+        let base = self.func_instr_base[func];
+        let end = base + self.func_instr_len(func);
+        let blocks = &self.func_blocks[func];
+        let has_block = |b: usize| blocks.get(b).is_some_and(|&(_, len)| len > 0);
+        let block = |b: usize| {
+            if has_block(b) {
+                Ok(())
+            } else {
+                Err(format!("jump to missing block {b}"))
+            }
+        };
+        let reg = |r: usize| {
+            if r < regs {
+                Ok(())
+            } else {
+                Err(format!("register {r} outside the {regs}-register frame"))
+            }
+        };
+        let opcode = |ip: usize| Inst(self.instrs[ip]).opcode();
+        // 边移动里的 `SCRATCH` 是局部临时槽，不占寄存器
+        let edge_reg = |r: u32| {
+            if r == SCRATCH {
+                Ok(())
+            } else {
+                reg(r as usize)
+            }
+        };
+
+        for ip in base..end {
+            let inst = Inst(self.instrs[ip]);
+            let op = opcode(ip).map_err(|op| format!("ip {ip}: invalid opcode {op:#04x}"))?;
+            let at = |e: String| format!("ip {ip}: {e}");
+            let [d, s1, s2] = reg_fields(op);
+            for (used, r) in [(d, inst.dst()), (s1, inst.src1()), (s2, inst.src2())] {
+                if used {
+                    reg(r).map_err(at)?;
+                }
+            }
+            let span = self.edge_spans[ip];
+            let (primary, alt) = (
+                &self.edge_moves[span.primary()],
+                &self.edge_moves[span.alt()],
+            );
+            match op {
+                Opcode::LoadConst if inst.const_idx() >= self.const_bits.len() => {
+                    return Err(at(format!("constant {} out of range", inst.const_idx())));
+                }
+                Opcode::NewStruct
+                    if inst.src1()
+                        >= self
+                            .struct_field_counts
+                            .len()
+                            .min(self.struct_bitmaps.len()) =>
+                {
+                    return Err(at(format!("unknown struct id {}", inst.src1())));
+                }
+                Opcode::NewVariant => {
+                    let (id, tag) = (inst.src1(), inst.src2());
+                    let counts = self.enum_variant_counts.get(id).map_or(0, Vec::len);
+                    let bitmaps = self.enum_variant_bitmaps.get(id).map_or(0, Vec::len);
+                    if tag >= counts.min(bitmaps) {
+                        return Err(at(format!("unknown variant {id}.{tag}")));
+                    }
+                }
+                Opcode::Jump => block((inst.src1() << 8) | inst.src2()).map_err(at)?,
+                Opcode::Branch => {
+                    block(inst.src1()).map_err(at)?;
+                    block(inst.src2()).map_err(at)?;
+                }
+                Opcode::TailCall => block(0).map_err(at)?,
+                Opcode::Call => {
+                    let target = inst.call_target();
+                    let Some(&callee) = self.func_reg_counts.get(target) else {
+                        return Err(at(format!("call to missing function {target}")));
+                    };
+                    for m in primary {
+                        reg(m.src as usize).map_err(at)?;
+                        if m.dst as usize >= callee {
+                            return Err(at(format!(
+                                "argument {} outside the {callee}-register callee frame",
+                                m.dst
+                            )));
+                        }
+                    }
+                }
+                Opcode::CallIndirect if self.ic_sites[ip] as usize >= self.ic_site_count => {
+                    return Err(at("call site without an inline cache slot".into()));
+                }
+                _ => {}
+            }
+            match op {
+                Opcode::Jump | Opcode::Branch | Opcode::TailCall => {
+                    for m in primary.iter().chain(alt) {
+                        edge_reg(m.dst).map_err(at)?;
+                        edge_reg(m.src).map_err(at)?;
+                    }
+                }
+                Opcode::CallNative | Opcode::CallIndirect => {
+                    for m in primary {
+                        reg(m.src as usize).map_err(at)?;
+                    }
+                }
+                _ => {}
+            }
+            match op {
+                Opcode::Call | Opcode::CallNative | Opcode::CallIndirect => {
+                    block(inst.call_cont()).map_err(at)?;
+                }
+                _ => {}
+            }
+            // 这两条把结果写进寄存器 0
+            if matches!(op, Opcode::CallNative | Opcode::AsyncPoll) {
+                reg(0).map_err(at)?;
+            }
+        }
+
+        for (b, &(start, len)) in blocks.iter().enumerate() {
+            if len == 0 {
+                continue;
+            }
+            if start < base || start + len > end {
+                return Err(format!("block {b} lies outside the function"));
+            }
+            // 块只能经终结指令离开，不会落进下一个块或下一个函数
+            let last = opcode(start + len - 1);
+            if !last.is_ok_and(Opcode::is_terminator) {
+                return Err(format!("block {b} does not end in a terminator"));
+            }
+            if let Some(&r) = self.block_params(func, b).iter().find(|&&r| r >= regs) {
+                return Err(format!(
+                    "block {b}: register {r} outside the {regs}-register frame"
+                ));
+            }
+        }
+        let entry = self.func_entries[func];
+        if !blocks.iter().any(|&(start, len)| len > 0 && start == entry) {
+            return Err(format!("entry {entry} is not the start of a block"));
+        }
+        Ok(())
+    }
+}
+
+/// `op` 的 dst / src1 / src2 里哪些是寄存器（与 `VM::step` 的读写一致）。
+fn reg_fields(op: Opcode) -> [bool; 3] {
+    use Opcode::*;
+    match op {
+        AddInt | SubInt | MulInt | DivInt | ModInt | FAdd | FSub | FMul | FDiv | EqInt | NeInt
+        | LtInt | LeInt | GtInt | GeInt | FEq | FNe | FLt | FLe | FGt | FGe | SAdd | IndexGet
+        | IndexSet | NewInterfaceObj => [true; 3],
+        NegInt | FNeg | Not | FSqrt | FSin | FCos | FFloor | FCeil | IToF | FToI | IToS | FToS
+        | SToI | BToS | Move | ListLen | GetField | SetField | TupleIndex | Box_ | Unbox
+        | GetVariantTag | GetVariantField | SetVariantField => [true, true, false],
+        LoadImm | LoadConst | NewStruct | NewList | NewTuple | NewInt64Array | NewFloat64Array
+        | NewVariant | LoadVtable | Print | Return | Branch => [true, false, false],
+        Jump | Call | TailCall | CallIndirect | CallNative | AsyncPoll | Suspend => [false; 3],
+    }
+}
+
+impl Default for LoadedProgram {
+    fn default() -> Self {
+        Self::empty()
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::execute::VM;
+    use std::sync::Arc;
+
+    /// `print("a" + "b"); return 3`，常量里 "a" 出现两次。
+    fn concat_module() -> CpsModule {
+        CpsModule {
+            functions: vec![CpsFunction {
+                name: "main".into(),
+                blocks: vec![CpsBlock {
+                    id: 0,
+                    params: vec![],
+                    instrs: vec![
+                        CpsInstr::LoadConst(0, 2),
+                        CpsInstr::LoadConst(1, 1),
+                        CpsInstr::BinOp(2, CpsBinOp::SAdd, 0, 1),
+                        CpsInstr::Print(2),
+                        CpsInstr::LoadConst(3, 3),
+                    ],
+                    term: CpsTerminator::Return(3),
+                }],
+                entry: 0,
+                reg_count: 4,
+            }],
+            constants: vec![
+                Constant::String("a".into()),
+                Constant::String("b".into()),
+                Constant::String("a".into()),
+                Constant::Int(3),
+            ],
+            structs: vec![],
+            enums: vec![],
+            vtables: vec![],
+            symbol_map: HashMap::new(),
+            func_owners: vec![],
+        }
+    }
+
+    #[test]
+    fn string_constants_get_the_same_slot_in_every_isolate() {
+        let program = Arc::new(LoadedProgram::new(&concat_module()).unwrap());
+        assert_eq!(program.strings.len(), 2);
+        assert_eq!(&program.const_bits[..3], &[0, 1, 0]);
+        for _ in 0..2 {
+            let mut vm = VM::with_program(program.clone());
+            assert_eq!(vm.heap.get_str(1), Some("b"));
+            assert!(vm.heap.is_immortal(0));
+            assert_eq!(vm.execute(0, 4, None).unwrap(), 3);
+            assert_eq!(vm.take_output(), vec!["ab".to_string()]);
+        }
+        assert_eq!(Arc::strong_count(&program), 1);
+    }
+
+    #[test]
+    fn reset_lets_a_pooled_vm_rerun_the_program() {
+        let mut vm = VM::with_program(Arc::new(LoadedProgram::new(&concat_module()).unwrap()));
+        let mut allocations = vec![];
+        for _ in 0..3 {
+            vm.reset();
+            assert_eq!(vm.execute(0, 4, None).unwrap(), 3);
+            assert_eq!(vm.take_output(), vec!["ab".to_string()]);
+            allocations.push(vm.heap.stats().allocations);
+        }
+        // 每轮都从只有常驻字符串的空堆开始
+        assert!(allocations.iter().all(|&n| n == allocations[0]));
+    }
+
+    #[test]
+    fn isolates_share_one_program_across_threads() {
+        fn assert_send_sync<T: Send + Sync>() {}
+        fn assert_send<T: Send>() {}
+        assert_send_sync::<LoadedProgram>();
+        assert_send::<VM>();
+
+        let program = Arc::new(LoadedProgram::new(&concat_module()).unwrap());
+        let threads: Vec<_> = (0..4)
+            .map(|_| {
+                let program = program.clone();
+                std::thread::spawn(move || {
+                    let mut vm = VM::with_program(program);
+                    (0..100)
+                        .map(|_| {
+                            vm.reset();
+                            vm.execute(0, 4, None).unwrap();
+                            vm.take_output().join("")
+                        })
+                        .collect::<Vec<_>>()
+                })
+            })
+            .collect();
+        for t in threads {
+            assert!(t.join().unwrap().iter().all(|out| out == "ab"));
+        }
+    }
+
+    #[test]
+    fn out_of_range_operands_fail_to_load() {
+        let broken = |edit: fn(&mut CpsModule)| {
+            let mut m = concat_module();
+            edit(&mut m);
+            LoadedProgram::new(&m).err().unwrap_or_default()
+        };
+        let err = broken(|m| {
+            m.functions[0].reg_count = 16;
+            m.functions[0].blocks[0].instrs[2] = CpsInstr::BinOp(252, CpsBinOp::SAdd, 0, 1);
+        });
+        assert!(
+            err.contains("register 252 outside the 16-register frame"),
+            "{err}"
+        );
+        assert!(broken(|m| m.functions[0].blocks[0].params = vec![4]).contains("register 4"));
+        assert!(broken(|m| m.functions[0].reg_count = 1 << 20).contains("registers exceed"));
+        assert!(
+            broken(|m| m.functions[0].blocks[0].instrs[0] = CpsInstr::LoadConst(0, 4))
+                .contains("constant 4")
+        );
+        assert!(broken(|m| m.functions[0].entry = 3).contains("missing block 3"));
+        assert!(broken(|m| m.functions[0].blocks[0].id = usize::MAX - 1).contains("block"));
+        assert!(
+            broken(|m| m.functions[0].blocks[0].term = CpsTerminator::Call(1, vec![], 0))
+                .contains("missing function 1")
+        );
+        assert!(
+            broken(|m| m.functions[0].blocks[0].term = CpsTerminator::Jump(7, vec![]))
+                .contains("missing block 7")
+        );
+    }
+
+    #[test]
+    fn validation_runs_on_the_encoded_tables() {
+        let program = LoadedProgram::new(&concat_module()).unwrap();
+        let broken = |edit: fn(&mut LoadedProgram)| {
+            let mut p = LoadedProgram::new(&concat_module()).unwrap();
+            edit(&mut p);
+            p.validate().err().unwrap_or_default()
+        };
+        assert_eq!(program.validate(), Ok(()));
+        // 0x7E 不是任何操作码
+        let err = broken(|p| p.instrs[3] = (p.instrs[3] & 0x1FF_FFFF) | (0x7E << 25));
+        assert!(err.contains("invalid opcode 0x7e"), "{err}");
+        let err = broken(|p| p.instrs[3] |= 0xFF << 17);
+        assert!(err.contains("register 255 outside"), "{err}");
+        // 结尾的 Return 换成 Print：块会落到映像末尾之外
+        let err = broken(|p| p.instrs[5] = (p.instrs[5] & 0x1FF_FFFF) | (0x7F << 25));
+        assert!(err.contains("does not end in a terminator"), "{err}");
+        let err = broken(|p| p.func_entries[0] = 1);
+        assert!(err.contains("entry 1"), "{err}");
+    }
+}
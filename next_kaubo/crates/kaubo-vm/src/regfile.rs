@@ -2,22 +2,100 @@
 //!
 //! 所有值存储为 u64。操作码决定位模式的解释方式：
 //!   AddInt → reg as i64,   FAdd → f64::from_bits(reg)
+//!
+//! 所有调用帧共用一个连续的寄存器栈：当前帧是栈顶窗口 `stack[base..]`，
+//! 被调方窗口压在调用方之后，返回时截断。`regs[i]` 访问当前窗口。
+
+use std::ops::{Index, IndexMut};
 
 /// 寄存器文件：单组 Vec<u64>，不分 int/float
 pub struct RegFile {
-    pub regs: Vec<u64>,
+    /// 所有活动帧的寄存器窗口首尾相接；当前窗口总在栈顶。
+    /// 截断不释放容量，递归深度稳定后不再分配。
+    pub stack: Vec<u64>,
+    /// 当前窗口起点。
+    pub base: usize,
 }
 
 impl RegFile {
     pub fn new(cap: usize) -> Self {
-        RegFile { regs: vec![0; cap] }
+        RegFile {
+            stack: vec![0; cap],
+            base: 0,
+        }
+    }
+
+    /// 当前窗口长度。
+    #[inline(always)]
+    pub fn len(&self) -> usize {
+        self.stack.len() - self.base
+    }
+
+    #[inline(always)]
+    pub fn is_empty(&self) -> bool {
+        self.len() == 0
     }
 
+    /// 保证当前窗口至少有 `n` 个寄存器（新增的置零）。
     pub fn ensure_capacity(&mut self, n: usize) {
-        if self.regs.len() < n {
-            self.regs.resize(n, 0);
+        if self.len() < n {
+            self.stack.resize(self.base + n, 0);
         }
     }
+
+    /// 回到栈底窗口（`execute` 入口），长度为 `n`，保留其中已有的值。
+    pub fn reset(&mut self, n: usize) {
+        self.base = 0;
+        self.stack.resize(n, 0);
+    }
+
+    /// 回到新建时的状态：栈底窗口长 `n`，全部置零（保留容量）。
+    pub fn clear(&mut self, n: usize) {
+        self.base = 0;
+        self.stack.clear();
+        self.stack.resize(n, 0);
+    }
+
+    #[inline(always)]
+    pub fn window(&self) -> &[u64] {
+        &self.stack[self.base..]
+    }
+
+    #[inline(always)]
+    pub fn window_mut(&mut self) -> &mut [u64] {
+        &mut self.stack[self.base..]
+    }
+
+    /// 在栈顶压一个置零的 `len` 寄存器窗口，返回调用方的 `(base, len)`。
+    pub fn push_window(&mut self, len: usize) -> (usize, usize) {
+        let caller = (self.base, self.len());
+        self.base = self.stack.len();
+        self.stack.resize(self.base + len, 0);
+        caller
+    }
+
+    /// 弹出当前窗口，回到 `push_window` 返回的调用方窗口。
+    #[inline(always)]
+    pub fn pop_window(&mut self, (base, len): (usize, usize)) {
+        self.stack.truncate(base + len);
+        self.base = base;
+    }
+}
+
+impl Index<usize> for RegFile {
+    type Output = u64;
+
+    #[inline(always)]
+    fn index(&self, i: usize) -> &u64 {
+        &self.stack[self.base + i]
+    }
+}
+
+impl IndexMut<usize> for RegFile {
+    #[inline(always)]
+    fn index_mut(&mut self, i: usize) -> &mut u64 {
+        &mut self.stack[self.base + i]
+    }
 }
 
 #[cfg(test)]
@@ -28,14 +106,30 @@ mod tests {
     fn ensure_capacity_grows() {
         let mut rf = RegFile::new(1);
         rf.ensure_capacity(5);
-        assert!(rf.regs.len() >= 5);
+        assert!(rf.len() >= 5);
     }
 
     #[test]
     fn new_regfile_is_zero_initialized() {
         let rf = RegFile::new(10);
         for i in 0..10 {
-            assert_eq!(rf.regs[i], 0);
+            assert_eq!(rf[i], 0);
         }
     }
+
+    #[test]
+    fn windows_are_stacked_and_zeroed() {
+        let mut rf = RegFile::new(2);
+        rf[1] = 7;
+        let caller = rf.push_window(3);
+        assert_eq!((rf.base, rf.len()), (2, 3));
+        rf[0] = 9;
+        rf.pop_window(caller);
+        assert_eq!((rf.base, rf.len()), (0, 2));
+        assert_eq!(rf[1], 7);
+
+        // 复用同一段栈时被调方窗口重新置零
+        rf.push_window(3);
+        assert_eq!(rf[0], 0);
+    }
 }
@@ -0,0 +1,112 @@
+//! 哈希时间轮 — 定时唤醒挂起的异步任务
+//!
+//! 时钟刻度由调用方给出（`AsyncScheduler::turn` 的 `now`），时间轮本身不读系统时钟，
+//! wasm 上也能用。到期刻度 `d` 的定时器放进槽位 `d % SLOTS`，推进时只检查走过的槽位，
+//! 槽里未到期的（还要再转几圈的）留在原处。登记 O(1)，推进 O(走过的槽位 + 槽内定时器)。
+
+use crate::async_runtime::TaskId;
+
+/// 槽位数（2 的幂）。
+pub const SLOTS: usize = 256;
+
+#[derive(Debug, Clone, Copy)]
+struct Timer {
+    task: TaskId,
+    deadline: u64,
+    result: i64,
+}
+
+pub struct TimerWheel {
+    slots: Vec<Vec<Timer>>,
+    /// 已处理到的刻度。
+    now: u64,
+    len: usize,
+}
+
+impl TimerWheel {
+    pub fn new(now: u64) -> Self {
+        TimerWheel {
+            slots: (0..SLOTS).map(|_| Vec::new()).collect(),
+            now,
+            len: 0,
+        }
+    }
+
+    /// `ticks` 个刻度后以 `result` 唤醒 `task`（至少 1 个刻度）。
+    pub fn insert(&mut self, task: TaskId, ticks: u64, result: i64) {
+        let deadline = self.now + ticks.max(1);
+        self.slots[deadline as usize % SLOTS].push(Timer {
+            task,
+            deadline,
+            result,
+        });
+        self.len += 1;
+    }
+
+    /// 推进到 `now`，把到期的 `(task, result)` 追加到 `fired`。
+    pub fn advance(&mut self, now: u64, fired: &mut Vec<(TaskId, i64)>) {
+        if now <= self.now {
+            return;
+        }
+        let steps = (now - self.now).min(SLOTS as u64);
+        for tick in self.now + 1..=self.now + steps {
+            if self.len == 0 {
+                break;
+            }
+            let slot = &mut self.slots[tick as usize % SLOTS];
+            let before = slot.len();
+            slot.retain(|t| {
+                if t.deadline <= now {
+                    fired.push((t.task, t.result));
+                    false
+                } else {
+                    true
+                }
+            });
+            self.len -= before - slot.len();
+        }
+        self.now = now;
+    }
+
+    pub fn len(&self) -> usize {
+        self.len
+    }
+
+    pub fn is_empty(&self) -> bool {
+        self.len == 0
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn timers_fire_at_their_deadline() {
+        let mut wheel = TimerWheel::new(0);
+        wheel.insert(1, 3, 10);
+        wheel.insert(2, 1, 20);
+        let mut fired = vec![];
+        wheel.advance(2, &mut fired);
+        assert_eq!(fired, vec![(2, 20)]);
+        wheel.advance(3, &mut fired);
+        assert_eq!(fired, vec![(2, 20), (1, 10)]);
+        assert!(wheel.is_empty());
+    }
+
+    #[test]
+    fn long_delays_wait_out_extra_rotations() {
+        let mut wheel = TimerWheel::new(0);
+        // 与刻度 5 同槽，但要多转一圈
+        wheel.insert(7, 5 + SLOTS as u64, 1);
+        wheel.insert(8, 5, 2);
+        let mut fired = vec![];
+        wheel.advance(5, &mut fired);
+        assert_eq!(fired, vec![(8, 2)]);
+
+        // 一次跨过整圈以上也只扫一遍槽位
+        wheel.advance(10 * SLOTS as u64, &mut fired);
+        assert_eq!(fired, vec![(8, 2), (7, 1)]);
+        assert_eq!(wheel.len(), 0);
+    }
+}
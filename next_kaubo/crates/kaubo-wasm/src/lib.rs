@@ -1,14 +1,25 @@
+use kaubo_driver::programs::{ProgramId, Programs, Slice};
 use kaubo_language_service::{
     completions as ls_completions, semantic_tokens as ls_semantic_tokens,
     LspCoordinator,
 };
 use kaubo_syntax::lexer::Lexer;
-use kaubo_web_api::token::{classify_token, describe_token, utf16_range};
+use kaubo_web_api::token::{classify_token, describe_token, Utf16Cursor};
+use kaubo_web_api::wire;
 use once_cell::sync::Lazy;
-use std::sync::Mutex;
+use std::sync::{Arc, Mutex};
 use wasm_bindgen::prelude::*;
 
-static COMPILED: Lazy<Mutex<Option<kaubo_driver::CpsModule>>> = Lazy::new(|| Mutex::new(None));
+/// Last compiled program, loaded once and shared by every `run`.
+static COMPILED: Lazy<Mutex<Option<Arc<kaubo_driver::LoadedProgram>>>> =
+    Lazy::new(|| Mutex::new(None));
+
+/// Compiled programs by handle, with their in-progress executions.
+static PROGRAMS: Lazy<Mutex<Programs>> = Lazy::new(|| {
+    let mut programs = Programs::new();
+    programs.max_lines = PLAYGROUND_MAX_LINES;
+    Mutex::new(programs)
+});
 
 /// Global LSP coordinator — shared across all editor features.
 static LSP: Lazy<Mutex<LspCoordinator>> = Lazy::new(|| Mutex::new(LspCoordinator::new()));
@@ -25,18 +36,12 @@ pub fn init() {
 /// Tokenize source, return JSON array of {kind, from, to}.
 #[wasm_bindgen]
 pub fn lex(source: &str) -> String {
-    let tokens = Lexer::new(source).tokenize();
-    let items: Vec<String> = tokens
-        .iter()
-        .filter(|t| {
-            !matches!(
-                t.kind,
-                kaubo_syntax::TokenKind::Whitespace | kaubo_syntax::TokenKind::Eof
-            )
-        })
+    let mut utf16 = Utf16Cursor::new(source);
+    let items: Vec<String> = Lexer::new(source)
+        .filter(|t| t.kind != kaubo_syntax::TokenKind::Whitespace)
         .map(|t| {
             let kind = classify_token(t.kind);
-            let (from, to) = utf16_range(source, t.line, t.col, &t.lexeme);
+            let (from, to) = utf16.range(&t);
             format!(r#"{{"kind":"{kind}","from":{from},"to":{to}}}"#)
         })
         .collect();
@@ -49,6 +54,35 @@ pub fn diagnose(source: &str) -> String {
     kaubo_web_api::diagnose::diagnose(source)
 }
 
+/// Diagnostics in the LSP five-slot layout (see `kaubo_web_api::wire`).
+#[wasm_bindgen]
+pub struct Diagnostics(wire::EncodedDiagnostics);
+
+#[wasm_bindgen]
+impl Diagnostics {
+    /// `deltaLine, deltaStartChar, length, severity, messageIndex` per entry.
+    #[wasm_bindgen(getter)]
+    pub fn data(&self) -> Vec<u32> {
+        self.0.data.clone()
+    }
+
+    #[wasm_bindgen(getter)]
+    pub fn messages(&self) -> js_sys::Array {
+        self.0
+            .messages
+            .iter()
+            .map(|m| JsValue::from_str(m))
+            .collect()
+    }
+}
+
+/// Parse + type-check, return the errors as a `Uint32Array` plus messages.
+#[wasm_bindgen]
+pub fn diagnostics(source: &str) -> Diagnostics {
+    let found = kaubo_web_api::diagnose::diagnostics(source);
+    Diagnostics(wire::encode_diagnostics(source, &found))
+}
+
 /// Enable or disable structured logging from the toolchain.
 ///
 /// `level` is a severity level: 0 = Trace, 1 = Debug, 2 = Info,
@@ -69,6 +103,14 @@ pub fn set_log_level(level: u8) {
     *LOG_LEVEL.lock().unwrap() = severity;
 }
 
+fn js_error(e: impl std::fmt::Display) -> JsValue {
+    JsValue::from_str(&e.to_string())
+}
+
+fn unknown_program(id: ProgramId) -> JsValue {
+    JsValue::from_str(&format!("unknown program {id}"))
+}
+
 /// Compile source to bytecode, return instruction count.
 #[wasm_bindgen]
 pub fn compile(source: &str) -> Result<usize, JsValue> {
@@ -78,20 +120,174 @@ pub fn compile(source: &str) -> Result<usize, JsValue> {
         return Err(JsValue::from_str("no functions in compiled module"));
     }
     let count = kaubo_driver::instruction_count(&cps);
-    *COMPILED.lock().unwrap() = Some(cps);
+    let program =
+        kaubo_driver::load_program(&cps).map_err(|e| JsValue::from_str(&e.to_string()))?;
+    *COMPILED.lock().unwrap() = Some(program);
     Ok(count)
 }
 
-/// Run previously compiled bytecode, return print() output.
+/// Lines of print() output the playground keeps; older lines are dropped.
+const PLAYGROUND_MAX_LINES: usize = 10_000;
+
+/// Run previously compiled bytecode, return the last `PLAYGROUND_MAX_LINES`
+/// lines of print() output.
 #[wasm_bindgen]
 pub fn run(_bytes: &[u8]) -> Result<String, JsValue> {
-    let cps = COMPILED.lock().unwrap().take()
+    let program = COMPILED
+        .lock()
+        .unwrap()
+        .clone()
         .ok_or_else(|| JsValue::from_str("no compiled module"))?;
-    let outcome = kaubo_driver::run_module(&cps)
+    let sink = Box::new(kaubo_driver::RingSink::new(PLAYGROUND_MAX_LINES));
+    let outcome = kaubo_driver::run_program_with_sink(&program, u64::MAX, sink)
         .map_err(|e| JsValue::from_str(&e.to_string()))?;
-    let out = outcome.output.join("\n");
-    COMPILED.lock().unwrap().replace(cps);
-    Ok(out)
+    Ok(outcome.output.join("\n"))
+}
+
+/// Run previously compiled bytecode with the sampling profiler attached.
+///
+/// Returns `{"output", "profile", "folded"}`: the print() lines, the JSON
+/// report (per-function counters, sampled stacks, opcode histogram when
+/// `opcodes` is set) for charting, and the folded stacks for a flamegraph.
+/// `sample_period` 0 keeps the VM default.
+#[wasm_bindgen]
+pub fn profile(sample_period: u32, opcodes: bool) -> Result<String, JsValue> {
+    let program = COMPILED
+        .lock()
+        .unwrap()
+        .clone()
+        .ok_or_else(|| JsValue::from_str("no compiled module"))?;
+    profile_report(&program, sample_period, opcodes)
+}
+
+fn profile_report(
+    program: &kaubo_driver::LoadedProgram,
+    sample_period: u32,
+    opcodes: bool,
+) -> Result<String, JsValue> {
+    let mut config = kaubo_driver::ProfileConfig {
+        opcodes,
+        ..Default::default()
+    };
+    if sample_period > 0 {
+        config.sample_period = sample_period;
+    }
+    let sink = Box::new(kaubo_driver::RingSink::new(PLAYGROUND_MAX_LINES));
+    let (outcome, profile) =
+        kaubo_driver::profile_program(program, u64::MAX, config, sink).map_err(js_error)?;
+    let report: serde_json::Value =
+        serde_json::from_str(&profile.to_json(program)).map_err(js_error)?;
+    Ok(serde_json::json!({
+        "output": outcome.output.join("\n"),
+        "profile": report,
+        "folded": profile.folded(program),
+    })
+    .to_string())
+}
+
+// ── Program handles ──
+//
+// The exports above keep the single-program API the shipped `pkg` was built
+// against; the handle API below runs programs in fuel-bounded slices (see
+// `kaubo_driver::programs`).
+
+/// Compile source, return a handle for `run_program` / `program_bytecode` /
+/// `release_program`.
+#[wasm_bindgen]
+pub fn compile_program(source: &str) -> Result<ProgramId, JsValue> {
+    PROGRAMS.lock().unwrap().compile(source).map_err(js_error)
+}
+
+/// Register bytecode previously returned by `program_bytecode` (e.g. cached
+/// in IndexedDB), return its handle. Damaged bytecode is an error.
+#[wasm_bindgen]
+pub fn load_program(bytes: &[u8]) -> Result<ProgramId, JsValue> {
+    PROGRAMS.lock().unwrap().load(bytes).map_err(js_error)
+}
+
+/// The checksummed bytecode behind a handle.
+#[wasm_bindgen]
+pub fn program_bytecode(id: ProgramId) -> Result<Vec<u8>, JsValue> {
+    let programs = PROGRAMS.lock().unwrap();
+    programs
+        .bytecode(id)
+        .map(<[u8]>::to_vec)
+        .ok_or_else(|| unknown_program(id))
+}
+
+/// CPS instruction count of a handle.
+#[wasm_bindgen]
+pub fn program_instruction_count(id: ProgramId) -> Result<usize, JsValue> {
+    PROGRAMS
+        .lock()
+        .unwrap()
+        .instructions(id)
+        .ok_or_else(|| unknown_program(id))
+}
+
+/// Drop a handle and any execution in progress.
+#[wasm_bindgen]
+pub fn release_program(id: ProgramId) {
+    PROGRAMS.lock().unwrap().release(id);
+}
+
+/// Abandon the execution in progress; the next `run_program` starts over.
+#[wasm_bindgen]
+pub fn reset_program(id: ProgramId) -> Result<(), JsValue> {
+    PROGRAMS.lock().unwrap().reset(id).map_err(js_error)
+}
+
+/// One `run_program` slice: output printed meanwhile, and whether the
+/// program finished.
+#[wasm_bindgen]
+pub struct RunSlice(Slice);
+
+#[wasm_bindgen]
+impl RunSlice {
+    #[wasm_bindgen(getter)]
+    pub fn done(&self) -> bool {
+        self.0.done
+    }
+
+    /// The entry function's return value once `done`.
+    #[wasm_bindgen(getter)]
+    pub fn result(&self) -> i64 {
+        self.0.result
+    }
+
+    /// print() lines of this slice, newline-separated.
+    #[wasm_bindgen(getter)]
+    pub fn output(&self) -> String {
+        self.0.output.join("\n")
+    }
+}
+
+/// Run a handle for at most `fuel` units (back edges and calls; 0 = to
+/// completion). A slice that is not `done` resumes on the next call, so the
+/// caller can post output between slices and stay responsive.
+#[wasm_bindgen]
+pub fn run_program(id: ProgramId, fuel: u32) -> Result<RunSlice, JsValue> {
+    let slice = PROGRAMS
+        .lock()
+        .unwrap()
+        .run(id, fuel as u64)
+        .map_err(js_error)?;
+    Ok(RunSlice(slice))
+}
+
+/// `profile` for a handle.
+#[wasm_bindgen]
+pub fn profile_program(
+    id: ProgramId,
+    sample_period: u32,
+    opcodes: bool,
+) -> Result<String, JsValue> {
+    let program = PROGRAMS
+        .lock()
+        .unwrap()
+        .program(id)
+        .ok_or_else(|| unknown_program(id))?;
+    profile_report(&program, sample_period, opcodes)
 }
 
 /// Feed source to the LSP coordinator. Call after each text change.
@@ -119,9 +315,9 @@ pub fn hover(source: &str, offset: usize) -> String {
     }
 
     // Fallback: token-based hover
-    let tokens = Lexer::new(source).tokenize();
-    for t in &tokens {
-        let (from, to) = utf16_range(source, t.line, t.col, &t.lexeme);
+    let mut utf16 = Utf16Cursor::new(source);
+    for t in Lexer::new(source) {
+        let (from, to) = utf16.range(&t);
         if offset >= from && offset < to {
             return serde_json::json!({
                 "kind": classify_token(t.kind),
@@ -167,6 +363,29 @@ pub fn semantic_tokens(source: &str) -> String {
     serde_json::to_string(&ls_semantic_tokens(source)).unwrap_or_else(|_| "[]".to_string())
 }
 
+/// Token type names; `tokenType` in `semantic_tokens_data` indexes this list.
+#[wasm_bindgen]
+pub fn semantic_token_legend() -> js_sys::Array {
+    wire::SEMANTIC_TOKEN_TYPES
+        .iter()
+        .map(|t| JsValue::from_str(t))
+        .collect()
+}
+
+/// Semantic tokens as a `Uint32Array` in the LSP delta layout:
+/// `deltaLine, deltaStartChar, length, tokenType, tokenModifiers` per token.
+#[wasm_bindgen]
+pub fn semantic_tokens_data(source: &str) -> Vec<u32> {
+    if let Ok(mut lsp) = LSP.lock() {
+        let _ = lsp.on_change(source);
+    }
+    let tokens = ls_semantic_tokens(source);
+    wire::encode_semantic_tokens(
+        source,
+        tokens.iter().map(|t| (t.from, t.to, t.kind.as_str())),
+    )
+}
+
 #[wasm_bindgen]
 pub fn complete(source: &str, offset: usize) -> String {
     // Try LSP coordinator
@@ -246,13 +465,16 @@ mod tests {
     #[test]
     fn semantic_tokens_include_type_method_and_function_roles() {
         let source = "struct Point { x: Int64 }\nimpl Point { dis: |self| { self.x } }\nconst p = Point { x: 1 };\np.dis();\nprint(p.x);";
-        let tokens: Vec<kaubo_language_service::SemanticToken> =
-            serde_json::from_str(&semantic_tokens(source)).unwrap();
-        let roles: Vec<String> = tokens.into_iter().map(|t| t.kind).collect();
-        assert!(roles.contains(&"type".to_string()));
-        assert!(roles.contains(&"method".to_string()));
-        assert!(roles.contains(&"function".to_string()));
-        assert!(roles.contains(&"field".to_string()));
+        let data = semantic_tokens_data(source);
+        assert_eq!(data.len() % 5, 0);
+        let roles: Vec<&str> = data
+            .chunks(5)
+            .map(|t| wire::SEMANTIC_TOKEN_TYPES[t[3] as usize])
+            .collect();
+        assert!(roles.contains(&"type"));
+        assert!(roles.contains(&"method"));
+        assert!(roles.contains(&"function"));
+        assert!(roles.contains(&"field"));
     }
 
     #[test]
@@ -280,4 +502,29 @@ mod tests {
         let output = run(&[]).unwrap();
         assert_eq!(output, ""); // no print output
     }
+
+    #[test]
+    fn program_handles_reload_and_run_in_slices() {
+        let id = compile_program(
+            "var i = 0;\nwhile (i < 3) {\n    print(i.to_string());\n    i = i + 1;\n};",
+        )
+        .unwrap();
+        assert!(program_instruction_count(id).unwrap() > 0);
+        let bytes = program_bytecode(id).unwrap();
+        release_program(id);
+        let id = load_program(&bytes).unwrap();
+        let mut output = Vec::new();
+        loop {
+            let slice = run_program(id, 1).unwrap();
+            if !slice.output().is_empty() {
+                output.push(slice.output());
+            }
+            if slice.done() {
+                break;
+            }
+        }
+        assert_eq!(output.join("\n"), "0\n1\n2");
+        release_program(id);
+        assert!(load_program(&bytes[..bytes.len() - 1]).is_err());
+    }
 }
@@ -1,23 +1,46 @@
-//! Convert pipeline errors to JSON diagnostics.
+//! Convert pipeline errors to diagnostics (JSON, or structured for `wire`).
 use kaubo_ast::Stmt;
 use kaubo_infer::infer_module;
 use kaubo_syntax::parser::Parser;
 use std::collections::HashSet;
 
-pub fn diagnose(source: &str) -> String {
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum Severity {
+    Error,
+    Warning,
+}
+
+impl Severity {
+    pub fn as_str(self) -> &'static str {
+        match self {
+            Severity::Error => "error",
+            Severity::Warning => "warning",
+        }
+    }
+}
+
+/// One pipeline error. `line` and `column` are 1-based, the column in chars.
+#[derive(Debug, Clone, PartialEq, Eq)]
+pub struct Diagnostic {
+    pub severity: Severity,
+    pub line: usize,
+    pub column: usize,
+    pub message: String,
+}
+
+/// Parse + type-check `source`; the first error, if any.
+pub fn diagnostics(source: &str) -> Vec<Diagnostic> {
+    let error = |line, column, message| {
+        vec![Diagnostic {
+            severity: Severity::Error,
+            line,
+            column,
+            message,
+        }]
+    };
     let module = match Parser::new(source).parse() {
         Ok(m) => m,
-        Err(e) => {
-            return format!(
-                "[{}]",
-                serde_json::json!({
-                    "severity": "error",
-                    "line": e.line,
-                    "column": e.col,
-                    "message": e.to_string()
-                })
-            )
-        }
+        Err(e) => return error(e.line, e.col, e.to_string()),
     };
 
     // Collect imported names — these are resolved externally, so infer
@@ -33,29 +56,38 @@ pub fn diagnose(source: &str) -> String {
         .collect();
 
     match infer_module(&module) {
-        Ok(_) => "[]".to_string(),
+        Ok(_) => Vec::new(),
         Err(e) => {
             // Skip "unbound variable" if the name was imported
             if e.msg.starts_with("unbound variable") {
                 for name in &imported {
                     if e.msg.contains(&format!("'{name}'")) {
-                        return "[]".to_string();
+                        return Vec::new();
                     }
                 }
             }
-            format!(
-                "[{}]",
-                serde_json::json!({
-                    "severity": "error",
-                    "line": e.line,
-                    "column": e.col,
-                    "message": e.msg
-                })
-            )
+            error(e.line, e.col, e.msg)
         }
     }
 }
 
+/// `diagnostics` as a JSON array of `{severity, line, column, message}`.
+pub fn diagnose(source: &str) -> String {
+    let items: Vec<String> = diagnostics(source)
+        .into_iter()
+        .map(|d| {
+            serde_json::json!({
+                "severity": d.severity.as_str(),
+                "line": d.line,
+                "column": d.column,
+                "message": d.message
+            })
+            .to_string()
+        })
+        .collect();
+    format!("[{}]", items.join(","))
+}
+
 #[cfg(test)]
 mod tests {
     use super::*;
@@ -86,6 +118,19 @@ mod tests {
     #[test]
     fn diagnose_skips_imported_names() {
         let r = diagnose("import { add_a } from \"./A.kb\"; const r = add_a(10, 12);");
-        assert_eq!(r, "[]", "imported name should not be reported as unbound: {r}");
+        assert_eq!(
+            r, "[]",
+            "imported name should not be reported as unbound: {r}"
+        );
+    }
+
+    #[test]
+    fn diagnostics_carry_position_and_severity() {
+        let d = diagnostics("const a = 1;\nvar x = ;");
+        assert_eq!(d.len(), 1);
+        assert_eq!(d[0].severity, Severity::Error);
+        assert_eq!(d[0].line, 2);
+        assert!(d[0].column > 1);
+        assert!(diagnostics("const x = 42;").is_empty());
     }
 }
@@ -1,6 +1,6 @@
 //! Web-facing token utilities: classification, UTF-16 offsets, descriptions.
 
-use kaubo_token::TokenKind;
+use kaubo_token::{RawToken, TokenKind};
 
 /// Map a TokenKind to one of 7 display classes for syntax highlighting.
 pub fn classify_token(kind: TokenKind) -> &'static str {
@@ -99,6 +99,49 @@ fn escape_newline(_chars: &mut std::iter::Peekable<std::str::Chars>) -> usize {
     1 // \n always adds 1 in UTF-16
 }
 
+/// Maps byte offsets to UTF-16 code unit offsets in a single forward pass.
+///
+/// Token spans arrive in source order, so each lookup only walks the bytes
+/// since the previous one; `utf16_range` rescans from the top for every token.
+pub struct Utf16Cursor<'s> {
+    source: &'s str,
+    byte: usize,
+    utf16: usize,
+}
+
+impl<'s> Utf16Cursor<'s> {
+    pub fn new(source: &'s str) -> Self {
+        Self {
+            source,
+            byte: 0,
+            utf16: 0,
+        }
+    }
+
+    /// UTF-16 offset of byte `offset`. Going backwards restarts from the top.
+    pub fn offset(&mut self, offset: usize) -> usize {
+        if offset < self.byte {
+            (self.byte, self.utf16) = (0, 0);
+        }
+        let skipped = &self.source[self.byte..offset];
+        self.utf16 += if skipped.is_ascii() {
+            skipped.len()
+        } else {
+            skipped.chars().map(char::len_utf16).sum()
+        };
+        self.byte = offset;
+        self.utf16
+    }
+
+    /// The (from, to) UTF-16 offsets of a token's source text.
+    pub fn range(&mut self, token: &RawToken) -> (usize, usize) {
+        (
+            self.offset(token.start as usize),
+            self.offset(token.end as usize),
+        )
+    }
+}
+
 /// Human-readable description of a token kind (for hover tooltips).
 pub fn describe_token(kind: TokenKind) -> &'static str {
     match kind {
@@ -359,6 +402,34 @@ mod tests {
         }
     }
 
+    #[test]
+    fn utf16_cursor_matches_utf16_range_on_lexer_spans() {
+        let src = "struct Point { x: Int64 }\nconst p = Point { x: 1 };";
+        let mut cursor = Utf16Cursor::new(src);
+        let mut lexer = kaubo_syntax::Lexer::new(src);
+        loop {
+            let (token, raw) = lexer.next_spanned();
+            if token.kind == TokenKind::Eof {
+                break;
+            }
+            assert_eq!(
+                cursor.range(&raw),
+                utf16_range(src, token.line, token.col, &token.lexeme)
+            );
+        }
+    }
+
+    #[test]
+    fn utf16_cursor_spans_source_text_of_strings() {
+        // `𝄞` is two UTF-16 units; the escape is its two source characters
+        let src = "\"𝄞\\n\" x";
+        let tokens: Vec<RawToken> = kaubo_syntax::Lexer::new(src).collect();
+        let mut cursor = Utf16Cursor::new(src);
+        assert_eq!(cursor.range(&tokens[0]), (0, 6));
+        assert_eq!(cursor.range(&tokens[1]), (7, 8));
+        assert_eq!(cursor.offset(0), 0);
+    }
+
     // ── describe_token ──
 
     #[test]
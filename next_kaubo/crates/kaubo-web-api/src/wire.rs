@@ -0,0 +1,301 @@
+//! Binary wire formats for editor hosts: the LSP delta-encoded `u32` layout.
+//!
+//! Semantic tokens follow `textDocument/semanticTokens/full`: five integers
+//! per token — `deltaLine`, `deltaStartChar`, `length`, `tokenType`,
+//! `tokenModifiers` — with positions in UTF-16 code units and `deltaStartChar`
+//! relative to the previous token only when both sit on the same line.
+//! Diagnostics reuse the same five-slot layout so hosts decode both with one
+//! loop; see [`encode_diagnostics`].
+
+use crate::diagnose::{Diagnostic, Severity};
+use kaubo_syntax::lexer::Lexer;
+use kaubo_token::TokenKind;
+
+/// Token type legend: `tokenType` is an index into this list. Matches the
+/// language-service roles (see `kaubo_language_service::semantic_tokens`).
+pub const SEMANTIC_TOKEN_TYPES: [&str; 11] = [
+    "keyword",
+    "number",
+    "string",
+    "comment",
+    "identifier",
+    "atom",
+    "operator",
+    "type",
+    "field",
+    "method",
+    "function",
+];
+
+/// Index of `kind` in [`SEMANTIC_TOKEN_TYPES`].
+pub fn token_type(kind: &str) -> Option<u32> {
+    SEMANTIC_TOKEN_TYPES
+        .iter()
+        .position(|&t| t == kind)
+        .map(|i| i as u32)
+}
+
+/// Line starts of a source text, for converting offsets to LSP positions.
+pub struct LineIndex<'s> {
+    source: &'s str,
+    /// `(byte, utf16)` offset of each line's first character.
+    lines: Vec<(usize, usize)>,
+    utf16_len: usize,
+}
+
+impl<'s> LineIndex<'s> {
+    pub fn new(source: &'s str) -> Self {
+        let mut lines = vec![(0, 0)];
+        let mut utf16 = 0;
+        for (byte, c) in source.char_indices() {
+            utf16 += c.len_utf16();
+            if c == '\n' {
+                lines.push((byte + 1, utf16));
+            }
+        }
+        Self {
+            source,
+            lines,
+            utf16_len: utf16,
+        }
+    }
+
+    pub fn line_count(&self) -> usize {
+        self.lines.len()
+    }
+
+    /// 0-based `(line, character)` of UTF-16 offset `offset`.
+    pub fn position(&self, offset: usize) -> (usize, usize) {
+        let offset = offset.min(self.utf16_len);
+        let line = self.lines.partition_point(|&(_, u)| u <= offset) - 1;
+        (line, offset - self.lines[line].1)
+    }
+
+    /// UTF-16 offset where 0-based `line` ends, before its newline.
+    pub fn line_end(&self, line: usize) -> usize {
+        match self.lines.get(line + 1) {
+            Some(&(_, next)) => next - 1,
+            None => self.utf16_len,
+        }
+    }
+
+    /// Byte and UTF-16 offsets of a 1-based `(line, column)` position with
+    /// the column counted in chars, as the lexer and parser report it.
+    /// Clamped to the end of the line / text.
+    pub fn locate(&self, line: usize, column: usize) -> (usize, usize) {
+        let line = line.clamp(1, self.lines.len()) - 1;
+        let (mut byte, mut utf16) = self.lines[line];
+        for c in self.source[byte..].chars().take(column.saturating_sub(1)) {
+            if c == '\n' {
+                break;
+            }
+            byte += c.len_utf8();
+            utf16 += c.len_utf16();
+        }
+        (byte, utf16)
+    }
+}
+
+/// Appends five-slot entries with positions relative to the previous one.
+#[derive(Default)]
+struct DeltaEncoder {
+    line: usize,
+    character: usize,
+    data: Vec<u32>,
+}
+
+impl DeltaEncoder {
+    fn push(&mut self, line: usize, character: usize, length: usize, a: u32, b: u32) {
+        let delta_line = line - self.line;
+        let delta_start = if delta_line == 0 {
+            character - self.character
+        } else {
+            character
+        };
+        self.data
+            .extend([delta_line as u32, delta_start as u32, length as u32, a, b]);
+        (self.line, self.character) = (line, character);
+    }
+}
+
+/// Encode `(from, to, kind)` spans — UTF-16 offsets in source order — as LSP
+/// semantic token data. Spans crossing a newline (block comments, multi-line
+/// strings) are split per line; unknown kinds and empty spans are skipped.
+pub fn encode_semantic_tokens<'k>(
+    source: &str,
+    tokens: impl IntoIterator<Item = (usize, usize, &'k str)>,
+) -> Vec<u32> {
+    let index = LineIndex::new(source);
+    let mut out = DeltaEncoder::default();
+    for (from, to, kind) in tokens {
+        let Some(ty) = token_type(kind) else {
+            continue;
+        };
+        let mut start = from;
+        while start < to {
+            let (line, character) = index.position(start);
+            let end = to.min(index.line_end(line));
+            if end > start {
+                out.push(line, character, end - start, ty, 0);
+            }
+            match index.lines.get(line + 1) {
+                Some(&(_, next)) => start = next,
+                None => break,
+            }
+        }
+    }
+    out.data
+}
+
+/// LSP `DiagnosticSeverity`.
+pub fn lsp_severity(severity: Severity) -> u32 {
+    match severity {
+        Severity::Error => 1,
+        Severity::Warning => 2,
+    }
+}
+
+/// Diagnostics in the semantic-token layout, plus their messages.
+#[derive(Debug, Clone, Default, PartialEq, Eq)]
+pub struct EncodedDiagnostics {
+    /// `deltaLine, deltaStartChar, length, severity, messageIndex` per
+    /// diagnostic, sorted by position; `severity` is LSP's (1 = error).
+    pub data: Vec<u32>,
+    /// `messages[messageIndex]`.
+    pub messages: Vec<String>,
+}
+
+/// Encode `diagnostics` against `source`. Each range covers the token that
+/// starts at the reported position, or one character when none does (e.g.
+/// an error at end of input).
+pub fn encode_diagnostics(source: &str, diagnostics: &[Diagnostic]) -> EncodedDiagnostics {
+    let index = LineIndex::new(source);
+    let mut located: Vec<_> = diagnostics
+        .iter()
+        .map(|d| (index.locate(d.line, d.column), d))
+        .collect();
+    located.sort_by_key(|&((byte, _), _)| byte);
+
+    let mut lexer = Lexer::new(source).filter(|t| t.kind != TokenKind::Whitespace);
+    let mut token = lexer.next();
+    let mut out = DeltaEncoder::default();
+    let mut messages = Vec::with_capacity(located.len());
+    for ((byte, utf16), d) in located {
+        while token.is_some_and(|t| (t.start as usize) < byte) {
+            token = lexer.next();
+        }
+        let (line, character) = index.position(utf16);
+        let length = match token {
+            Some(t) if t.start as usize == byte => {
+                let text = &source[byte..t.end as usize];
+                let text = text.split('\n').next().unwrap_or_default();
+                text.chars().map(char::len_utf16).sum::<usize>().max(1)
+            }
+            _ => 1,
+        };
+        out.push(
+            line,
+            character,
+            length,
+            lsp_severity(d.severity),
+            messages.len() as u32,
+        );
+        messages.push(d.message.clone());
+    }
+    EncodedDiagnostics {
+        data: out.data,
+        messages,
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::diagnose::diagnostics;
+
+    #[test]
+    fn line_index_maps_utf16_offsets() {
+        let index = LineIndex::new("ab\n中😀x\n");
+        assert_eq!(index.line_count(), 3);
+        assert_eq!(index.position(0), (0, 0));
+        assert_eq!(index.position(3), (1, 0));
+        // 中 is one UTF-16 unit, 😀 two
+        assert_eq!(index.position(6), (1, 3));
+        assert_eq!(index.line_end(1), 7);
+        assert_eq!(index.locate(2, 3), ("ab\n中😀".len(), 6));
+        assert_eq!(index.locate(1, 99), (2, 2));
+    }
+
+    #[test]
+    fn semantic_tokens_are_delta_encoded() {
+        let source = "const x = 1;\n  x;";
+        let tokens = [
+            (0, 5, "keyword"),
+            (6, 7, "identifier"),
+            (10, 11, "number"),
+            (15, 16, "identifier"),
+            (16, 17, "unknown"),
+        ];
+        assert_eq!(
+            encode_semantic_tokens(source, tokens),
+            vec![
+                0, 0, 5, 0, 0, //
+                0, 6, 1, 4, 0, //
+                0, 4, 1, 1, 0, //
+                1, 2, 1, 4, 0,
+            ]
+        );
+    }
+
+    #[test]
+    fn multi_line_tokens_are_split_per_line() {
+        let source = "/* a\nbc */ x";
+        let data = encode_semantic_tokens(source, [(0, 10, "comment"), (11, 12, "identifier")]);
+        assert_eq!(
+            data,
+            vec![
+                0, 0, 4, 3, 0, //
+                1, 0, 5, 3, 0, //
+                0, 6, 1, 4, 0,
+            ]
+        );
+    }
+
+    #[test]
+    fn diagnostics_cover_the_token_at_the_error() {
+        let source = "const a = 1;\nconst s = \"é\" + 1;";
+        let d = diagnostics(source);
+        assert_eq!(d.len(), 1);
+        let encoded = encode_diagnostics(source, &d);
+        assert_eq!(encoded.data.len(), 5);
+        assert_eq!(encoded.data[0], d[0].line as u32 - 1);
+        assert_eq!(encoded.data[3], 1);
+        assert_eq!(encoded.data[4], 0);
+        assert!(encoded.data[2] >= 1);
+        assert_eq!(encoded.messages, vec![d[0].message.clone()]);
+    }
+
+    #[test]
+    fn diagnostics_are_sorted_and_chars_become_utf16() {
+        let diag = |line, column, message: &str| Diagnostic {
+            severity: Severity::Error,
+            line,
+            column,
+            message: message.to_string(),
+        };
+        let source = "😀 foo;\nbar";
+        let encoded = encode_diagnostics(source, &[diag(2, 1, "second"), diag(1, 3, "first")]);
+        assert_eq!(
+            encoded.data,
+            vec![
+                0, 3, 3, 1, 0, //
+                1, 0, 3, 1, 1,
+            ]
+        );
+        assert_eq!(encoded.messages, vec!["first", "second"]);
+
+        // past the end of input: one character at the clamped position
+        let encoded = encode_diagnostics("x", &[diag(5, 9, "eof")]);
+        assert_eq!(encoded.data, vec![0, 1, 1, 1, 0]);
+    }
+}
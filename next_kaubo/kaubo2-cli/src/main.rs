@@ -1,6 +1,8 @@
 //! kaubo2 — v2 direct driver: parse → infer → build → flatten → execute
+use kaubo_driver::module_loader::FileLoader;
 use std::env;
 use std::fs;
+use std::sync::Arc;
 use std::time::Instant;
 
 fn render_run(outcome: &kaubo_driver::RunOutcome) {
@@ -9,17 +11,181 @@ fn render_run(outcome: &kaubo_driver::RunOutcome) {
     }
 }
 
+/// Run a compiled module, streaming `print` output to stdout as it happens.
+fn stream_run(cps: &kaubo_driver::CpsModule, max_loop_iterations: u64) -> Result<(), String> {
+    let program = kaubo_driver::load_program(cps).map_err(|e| e.to_string())?;
+    stream_program(&program, max_loop_iterations)
+}
+
+/// Run a loaded program, streaming `print` output to stdout.
+fn stream_program(
+    program: &Arc<kaubo_driver::LoadedProgram>,
+    max_loop_iterations: u64,
+) -> Result<(), String> {
+    let sink = Box::new(kaubo_driver::WriteSink::new(std::io::stdout()));
+    kaubo_driver::run_program_with_sink(program, max_loop_iterations, sink)
+        .map_err(|e| e.to_string())?;
+    Ok(())
+}
+
+/// File-system loader rooted at `file`'s directory, plus the entry module name.
+fn module_loader(file: &str) -> Result<(String, Arc<FileLoader>), String> {
+    let abs = std::path::Path::new(file)
+        .canonicalize()
+        .map_err(|e| format!("cannot resolve {file}: {e}"))?;
+    let root = abs.parent().unwrap_or_else(|| std::path::Path::new("."));
+    let entry_name = abs
+        .file_name()
+        .unwrap()
+        .to_str()
+        .ok_or_else(|| format!("invalid entry file: {file}"))?;
+
+    let vfs = kaubo_vfs::MmapVfs::new(root);
+    let loader = FileLoader::new(Box::new(vfs));
+    Ok((entry_name.to_string(), Arc::new(loader)))
+}
+
+/// 模块扩展性基准用的分层项目：每层 `SCALE_WIDTH` 个互不依赖的模块，
+/// 每个导入上一层的两个模块；`main.kb` 导入最后一层并打印结果。
+/// 返回 `(文件名, 源码)` 和 `main.kb` 应当打印的那一行。
+fn scale_project(modules: usize) -> (Vec<(String, String)>, String) {
+    const SCALE_WIDTH: usize = 25;
+    const MODULUS: i64 = 1_000_003;
+    let modules = modules.max(1);
+    let mut files = Vec::with_capacity(modules + 1);
+    // 每个模块对 main 传入的实参 1 求出的值，用来算期望输出
+    let mut values = Vec::with_capacity(modules);
+    for id in 0..modules {
+        let (layer, k) = (id / SCALE_WIDTH, id % SCALE_WIDTH);
+        let width = SCALE_WIDTH.min(modules - layer * SCALE_WIDTH);
+        let (head, init, mut s) = if layer == 0 {
+            (String::new(), "x + 1".to_string(), 2)
+        } else {
+            let prev = (layer - 1) * SCALE_WIDTH;
+            let (a, b) = (prev + k % SCALE_WIDTH, prev + (k + 1) % SCALE_WIDTH);
+            (
+                format!("import {{ f{a} }} from \"./m{a}.kb\";\nimport {{ f{b} }} from \"./m{b}.kb\";\n"),
+                // 调用之后再读参数 x。f{b} 只在 x < 0 时调用：两条依赖都要编译，
+                // 运行时每层只进一次调用，总调用数不随层数翻倍
+                format!("f{a}(x) + x;\n    if (x < 0) {{ s = f{b}(x); }}"),
+                values[a] + 1,
+            )
+        };
+        // 几段互不相关的循环，给 infer / CPS 构建足够的活
+        let work: String = (1..=6)
+            .map(|c| {
+                let m = 31 + c + k % width;
+                for j in 0..c {
+                    s = (s * m as i64 + j as i64) % MODULUS;
+                }
+                format!(
+                    "    var j{c} = 0;\n    while (j{c} < {c}) {{ s = (s * {m} + j{c}) % {MODULUS}; j{c} = j{c} + 1; }};\n"
+                )
+            })
+            .collect();
+        values.push(s);
+        files.push((
+            format!("m{id}.kb"),
+            format!("{head}export const f{id} = |x: Int64| -> Int64 {{\n    var s = {init};\n{work}    return s;\n}};\n"),
+        ));
+    }
+    let last = (modules - 1) / SCALE_WIDTH * SCALE_WIDTH;
+    let imports: String = (last..modules)
+        .map(|i| format!("import {{ f{i} }} from \"./m{i}.kb\";\n"))
+        .collect();
+    let calls: Vec<String> = (last..modules).map(|i| format!("f{i}(1)")).collect();
+    files.push((
+        "main.kb".to_string(),
+        format!("{imports}print(({}).to_string());\n", calls.join(" + ")),
+    ));
+    let expected: i64 = values[last..].iter().sum();
+    (files, expected.to_string())
+}
+
+/// Value of `--<name> <value>`, if present.
+fn flag_value<'a>(args: &'a [String], name: &str) -> Option<&'a str> {
+    args.iter()
+        .position(|a| a == name)
+        .and_then(|i| args.get(i + 1))
+        .map(String::as_str)
+}
+
 /// Parsed CLI configuration.
 struct CliConfig {
     max_loop_iterations: u64,
     events: Option<Box<dyn kaubo_log::EventHandler>>,
+    /// 持久化产物缓存（`--cache-dir` / `KAUBO_CACHE_DIR`）
+    cache: Option<Arc<kaubo_driver::DiskCache>>,
+    /// 退出前向 stderr 打印各 Kind 的缓存命中情况
+    cache_stats: bool,
+}
+
+/// 未指定 `KAUBO_CACHE_MAX_MB` 时的缓存上限
+const DEFAULT_CACHE_MAX_MB: u64 = 512;
+
+/// 打开持久化缓存：`--cache-dir` 优先于 `KAUBO_CACHE_DIR`，都没有则不缓存。
+/// 打不开（无权限等）只告警，编译照常进行。
+fn open_cache(args: &[String]) -> Option<Arc<kaubo_driver::DiskCache>> {
+    let dir = flag_value(args, "--cache-dir")
+        .map(str::to_string)
+        .or_else(|| env::var("KAUBO_CACHE_DIR").ok().filter(|d| !d.is_empty()))?;
+    let max_mb = env::var("KAUBO_CACHE_MAX_MB")
+        .ok()
+        .and_then(|v| v.parse::<u64>().ok())
+        .unwrap_or(DEFAULT_CACHE_MAX_MB);
+    match kaubo_driver::DiskCache::open(&dir, max_mb.saturating_mul(1024 * 1024)) {
+        Ok(cache) => Some(Arc::new(cache)),
+        Err(e) => {
+            eprintln!("warning: cache disabled, cannot open {dir}: {e}");
+            None
+        }
+    }
+}
+
+/// 编译单文件源码，配置了缓存时走缓存。
+fn compile(source: &str, config: &CliConfig) -> Result<kaubo_driver::CpsModule, String> {
+    match &config.cache {
+        Some(cache) => {
+            kaubo_driver::compile_source_cached(source, config.max_loop_iterations, cache.clone())
+        }
+        None => kaubo_driver::compile_source_with_config(source, config.max_loop_iterations),
+    }
+    .map_err(|e| e.to_string())
+}
+
+/// 以 file 为入口编译多文件模块，配置了缓存时未改动的模块直接复用。
+fn compile_modules(file: &str, config: &CliConfig) -> Result<kaubo_driver::CpsModule, String> {
+    let (entry, loader) = module_loader(file)?;
+    match &config.cache {
+        Some(cache) => kaubo_driver::compile_file_cached(&entry, loader, cache.clone()),
+        None => kaubo_driver::compile_file(&entry, loader),
+    }
+    .map_err(|e| e.to_string())
+}
+
+/// `--cache-stats`：每个 Kind 一行，输出到 stderr，不干扰程序输出。
+fn report_cache(config: &CliConfig) {
+    let (true, Some(cache)) = (config.cache_stats, &config.cache) else {
+        return;
+    };
+    use kaubo_driver::PersistentCache;
+    for (kind, s) in cache.stats() {
+        eprintln!(
+            "cache {kind}: {} hits, {} misses, {} writes, {} evictions",
+            s.hits, s.misses, s.writes, s.evictions
+        );
+    }
 }
 
 /// Parse CLI arguments.
 ///
 /// Recognized flags (position-independent, before or after subcommand):
 ///   --log-level <LEVEL>        trace|debug|info|warn|error
-///   --max-loop-iterations <N>  override the default loop limit
+///   --max-loop-iterations <N>  cap back edges plus calls per run (VM fuel):
+///                              LoopExceeded / CallLimitExceeded when spent
+///   --cache-dir <DIR>          persist compiled artifacts (or KAUBO_CACHE_DIR;
+///                              size limit KAUBO_CACHE_MAX_MB, default 512)
+///   --cache-stats              print per-kind cache hits/misses to stderr
 ///
 /// Priority: CLI --log-level > KAUBO_LOG env var > default (no logging).
 fn build_config(args: &[String]) -> CliConfig {
@@ -65,6 +231,8 @@ fn build_config(args: &[String]) -> CliConfig {
     CliConfig {
         max_loop_iterations,
         events,
+        cache: open_cache(args),
+        cache_stats: args.iter().any(|a| a == "--cache-stats"),
     }
 }
 
@@ -74,7 +242,7 @@ fn positional_args(args: &[String]) -> Vec<&str> {
     let mut i = 1;
     while i < args.len() {
         match args[i].as_str() {
-            "--log-level" | "--max-loop-iterations" => {
+            "--log-level" | "--max-loop-iterations" | "--sample-period" | "--cache-dir" => {
                 i += 2; // skip flag + value
             }
             other => {
@@ -96,11 +264,27 @@ fn run_args(args: &[String]) -> Result<(), String> {
     let fmt_write = args.iter().any(|a| a == "--write");
 
     let (sub, file) = match pos.as_slice() {
-        ["compile" | "run" | "bench" | "mod" | "fmt", f, ..] => (pos[0], *f),
-        [f, ..] if !matches!(*f, "compile" | "run" | "bench" | "mod" | "fmt") => ("run", *f),
+        ["compile" | "run" | "bench" | "throughput" | "lex" | "profile" | "mod" | "scale"
+        | "fmt", f, ..] => (pos[0], *f),
+        [f, ..]
+            if !matches!(
+                *f,
+                "compile"
+                    | "run"
+                    | "bench"
+                    | "throughput"
+                    | "lex"
+                    | "profile"
+                    | "mod"
+                    | "scale"
+                    | "fmt"
+            ) =>
+        {
+            ("run", *f)
+        }
         _ => {
             return Err(
-                "Usage: kaubo2 [--log-level <LEVEL>] [--max-loop-iterations <N>] [compile|run|bench|mod|fmt] <file>"
+                "Usage: kaubo2 [--log-level <LEVEL>] [--max-loop-iterations <N>] [--cache-dir <DIR>] [--cache-stats] [compile|run|bench|throughput|lex|profile|mod|scale|fmt] <file>"
                     .to_string(),
             );
         }
@@ -130,10 +314,10 @@ fn run_args(args: &[String]) -> Result<(), String> {
         }
         "compile" => {
             let source = fs::read_to_string(file).map_err(|e| format!("read {file}: {e}"))?;
-            let cps = kaubo_driver::compile_source_with_config(&source, config.max_loop_iterations)
-                .map_err(|e| e.to_string())?;
+            let cps = compile(&source, &config)?;
             let out = file.replace(".kaubo", ".kauboc");
-            let bytes = kaubo_driver::encode_module(&cps);
+            let program = kaubo_driver::load_program(&cps).map_err(|e| e.to_string())?;
+            let bytes = kaubo_driver::encode_image(&program);
             let len = bytes.len();
             fs::write(&out, bytes).map_err(|e| format!("write {out}: {e}"))?;
             println!("Compiled: ({:.1}KB)", len as f64 / 1024.0);
@@ -145,8 +329,7 @@ fn run_args(args: &[String]) -> Result<(), String> {
 
             // Compile once
             let t0 = Instant::now();
-            let cps = kaubo_driver::compile_source_with_config(&source, config.max_loop_iterations)
-                .map_err(|e| e.to_string())?;
+            let cps = compile(&source, &config)?;
             let compile_ms = t0.elapsed().as_secs_f64() * 1000.0;
 
             let last_func = cps.functions.len() - 1;
@@ -158,23 +341,23 @@ fn run_args(args: &[String]) -> Result<(), String> {
                 .filter(|b| b.id != usize::MAX)
                 .map(|b| b.instrs.len())
                 .sum();
+            let frame_regs = kaubo_driver::frame_size(&cps);
 
             let events = config.events.as_ref().map(|h| h.as_ref());
+            let program = kaubo_driver::load_program(&cps).map_err(|e| e.to_string())?;
+            let mut vm = kaubo_vm::VM::with_program(program);
+            vm.max_loop_iterations = config.max_loop_iterations;
 
             // Warmup
             for _ in 0..warmup {
-                let mut vm = kaubo_vm::VM::new();
-                vm.max_loop_iterations = config.max_loop_iterations;
-                vm.load(&cps).map_err(|e| format!("load: {e}"))?;
+                vm.reset();
                 let _ = vm.execute(last_func, reg_count, events);
             }
 
             // Measure
             let mut times = Vec::with_capacity(iterations);
             for _ in 0..iterations {
-                let mut vm = kaubo_vm::VM::new();
-                vm.max_loop_iterations = config.max_loop_iterations;
-                vm.load(&cps).map_err(|e| format!("load: {e}"))?;
+                vm.reset();
                 let t0 = Instant::now();
                 let _ = vm
                     .execute(last_func, reg_count, events)
@@ -184,51 +367,193 @@ fn run_args(args: &[String]) -> Result<(), String> {
             }
 
             let avg_us = times.iter().sum::<f64>() / times.len() as f64 * 1000.0;
-            // Single-line output: avg_us instr_count compile_ms
-            println!("{avg_us} {instr_count} {compile_ms}");
+            // Single-line output: avg_us instr_count compile_ms frame_regs
+            println!("{avg_us} {instr_count} {compile_ms} {frame_regs}");
         }
-        "mod" => {
-            // 多文件模块模式：以 file 所在目录为 root，file 为入口
-            let abs = std::path::Path::new(file)
-                .canonicalize()
-                .map_err(|e| format!("cannot resolve {file}: {e}"))?;
-            let root = abs.parent().unwrap_or_else(|| std::path::Path::new("."));
-            let entry_name = abs
-                .file_name()
-                .unwrap()
-                .to_str()
-                .ok_or_else(|| format!("invalid entry file: {file}"))?;
+        "throughput" => {
+            // 一份程序映像，每个线程一个池化 VM 反复重置执行
+            let threads: usize = args
+                .get(3)
+                .and_then(|s| s.parse().ok())
+                .unwrap_or_else(|| std::thread::available_parallelism().map_or(1, |n| n.get()));
+            let runs: usize = args.get(4).and_then(|s| s.parse().ok()).unwrap_or(10);
+            let source = fs::read_to_string(file).map_err(|e| format!("read {file}: {e}"))?;
+            let cps = compile(&source, &config)?;
+            let program = kaubo_driver::load_program(&cps).map_err(|e| e.to_string())?;
+            let Some(entry) = program.entry() else {
+                return Err("no functions in compiled module".to_string());
+            };
+            let reg_count = program.func_reg_counts[entry];
 
-            let vfs = kaubo_vfs::FsVfs::new(root);
-            let loader = kaubo_driver::module_loader::FileLoader::new(Box::new(vfs));
+            let t0 = Instant::now();
+            let workers: Vec<_> = (0..threads.max(1))
+                .map(|_| {
+                    let program = program.clone();
+                    let max_loop_iterations = config.max_loop_iterations;
+                    std::thread::spawn(move || -> Result<(), String> {
+                        let mut vm = kaubo_vm::VM::with_program(program);
+                        vm.max_loop_iterations = max_loop_iterations;
+                        for _ in 0..runs {
+                            vm.reset();
+                            vm.execute(entry, reg_count, None)
+                                .map_err(|e| format!("{e:?}"))?;
+                        }
+                        Ok(())
+                    })
+                })
+                .collect();
+            for w in workers {
+                w.join().map_err(|_| "worker panicked".to_string())??;
+            }
+            let secs = t0.elapsed().as_secs_f64();
 
-            let loader = std::sync::Arc::new(loader);
-            let outcome = kaubo_driver::run_file(entry_name, loader).map_err(|e| e.to_string())?;
-            render_run(&outcome);
+            let total = threads.max(1) * runs;
+            // Single-line output: runs_per_sec threads total_runs
+            println!("{} {} {total}", total as f64 / secs, threads.max(1));
+        }
+        "lex" => {
+            // lex <file> [copies] [runs]：把 file 重复 copies 遍拼成一个大文件，测词法吞吐
+            let copies: usize = args.get(3).and_then(|s| s.parse().ok()).unwrap_or(1000);
+            let runs: usize = args.get(4).and_then(|s| s.parse().ok()).unwrap_or(5);
+            let source = fs::read_to_string(file).map_err(|e| format!("read {file}: {e}"))?;
+            let source = format!("{}\n", source.trim_end()).repeat(copies.max(1));
+
+            let mut tokens = 0;
+            let t0 = Instant::now();
+            for _ in 0..runs.max(1) {
+                tokens = kaubo_syntax::Lexer::new(&source).count();
+            }
+            let secs = t0.elapsed().as_secs_f64() / runs.max(1) as f64;
+
+            let mb = source.len() as f64 / (1024.0 * 1024.0);
+            // Single-line output: mb_per_sec tokens bytes
+            println!("{} {tokens} {}", mb / secs, source.len());
+        }
+        "scale" => {
+            // scale <dir> [modules] [runs]：在 dir 生成分层多模块项目，
+            // 用 1, 2, 4, … 直到核数个工作线程的池各编译 runs 次，取最快一次
+            let modules: usize = args.get(3).and_then(|s| s.parse().ok()).unwrap_or(500);
+            let runs: usize = args.get(4).and_then(|s| s.parse().ok()).unwrap_or(3);
+            fs::create_dir_all(file).map_err(|e| format!("create {file}: {e}"))?;
+            let (files, expected) = scale_project(modules);
+            for (name, source) in files {
+                let path = std::path::Path::new(file).join(name);
+                fs::write(&path, source).map_err(|e| format!("write {}: {e}", path.display()))?;
+            }
+            let main = std::path::Path::new(file).join("main.kb");
+            let (entry, loader) = module_loader(&main.to_string_lossy())?;
+
+            let cores = std::thread::available_parallelism().map_or(1, |n| n.get());
+            let mut threads: Vec<usize> = std::iter::successors(Some(1), |t| Some(t * 2))
+                .take_while(|&t| t < cores)
+                .collect();
+            threads.push(cores);
+            let mut base_ms = None;
+            let mut cps = None;
+            for t in threads {
+                let spawner = Arc::new(kaubo_driver::PoolSpawner::new(t));
+                let mut best = f64::INFINITY;
+                for _ in 0..runs.max(1) {
+                    let t0 = Instant::now();
+                    let module = kaubo_driver::compile_file_with_spawner(
+                        &entry,
+                        loader.clone(),
+                        spawner.clone(),
+                    )
+                    .map_err(|e| e.to_string())?;
+                    best = best.min(t0.elapsed().as_secs_f64() * 1000.0);
+                    cps = Some(module);
+                }
+                let base = *base_ms.get_or_insert(best);
+                // One line per pool size: threads compile_ms speedup
+                println!("{t} {best:.2} {:.2}", base / best);
+            }
+
+            // 最后一次编译的产物要真能跑，且打印出生成器算好的结果
+            let program = kaubo_driver::load_program(&cps.expect("at least one pool size"))
+                .map_err(|e| e.to_string())?;
+            let t0 = Instant::now();
+            let outcome = kaubo_driver::run_program(&program, config.max_loop_iterations)
+                .map_err(|e| e.to_string())?;
+            let run_ms = t0.elapsed().as_secs_f64() * 1000.0;
+            if outcome.output != [expected.as_str()] {
+                return Err(format!(
+                    "scale project printed {:?}, expected {expected}",
+                    outcome.output
+                ));
+            }
+            // Last line: run run_ms output
+            println!("run {run_ms:.2} {expected}");
+        }
+        "profile" => {
+            // profile <file> [out] [--mod] [--opcodes] [--sample-period N]
+            // 写出 <out>.folded（flamegraph）和 <out>.json，默认 out 为去掉扩展名的 file
+            let cps = if args.iter().any(|a| a == "--mod") {
+                compile_modules(file, &config)?
+            } else {
+                let source = fs::read_to_string(file).map_err(|e| format!("read {file}: {e}"))?;
+                compile(&source, &config)?
+            };
+            let mut profile_config = kaubo_driver::ProfileConfig {
+                opcodes: args.iter().any(|a| a == "--opcodes"),
+                ..Default::default()
+            };
+            if let Some(n) = flag_value(args, "--sample-period").and_then(|v| v.parse().ok()) {
+                profile_config.sample_period = n;
+            }
+            let out = pos.get(2).map(|s| s.to_string()).unwrap_or_else(|| {
+                let path = std::path::Path::new(file);
+                path.with_extension("").to_string_lossy().into_owned()
+            });
+
+            let program = kaubo_driver::load_program(&cps).map_err(|e| e.to_string())?;
+            let sink = Box::new(kaubo_driver::WriteSink::new(std::io::stdout()));
+            let (_, profile) = kaubo_driver::profile_program(
+                &program,
+                config.max_loop_iterations,
+                profile_config,
+                sink,
+            )
+            .map_err(|e| e.to_string())?;
+
+            let folded = format!("{out}.folded");
+            let json = format!("{out}.json");
+            fs::write(&folded, profile.folded(&program))
+                .map_err(|e| format!("write {folded}: {e}"))?;
+            fs::write(&json, profile.to_json(&program))
+                .map_err(|e| format!("write {json}: {e}"))?;
+            eprintln!("profile: {} samples -> {folded}, {json}", profile.samples);
+        }
+        "mod" => {
+            // 多文件模块模式：以 file 所在目录为 root，file 为入口
+            let outcome = if config.cache.is_some() {
+                let cps = compile_modules(file, &config)?;
+                kaubo_driver::run_module_with_config(&cps, config.max_loop_iterations)
+            } else {
+                let (entry, loader) = module_loader(file)?;
+                kaubo_driver::run_file(&entry, loader)
+            };
+            render_run(&outcome.map_err(|e| e.to_string())?);
         }
         "run" => {
             if file.ends_with(".kauboc") {
+                // v2 映像直接载入平铺表；旧的 v1 文件仍可运行
                 let bytes = fs::read(file).map_err(|e| format!("read {file}: {e}"))?;
-                let cps = kaubo_driver::decode_module(&bytes).map_err(|e| e.to_string())?;
-                let outcome =
-                    kaubo_driver::run_module_with_config(&cps, config.max_loop_iterations)
-                        .map_err(|e| e.to_string())?;
-                render_run(&outcome);
+                let program = kaubo_driver::load_image(&bytes).map_err(|e| e.to_string())?;
+                stream_program(&program, config.max_loop_iterations)?;
             } else {
                 let source = fs::read_to_string(file).map_err(|e| format!("read {file}: {e}"))?;
-                let outcome =
-                    kaubo_driver::run_source_with_config(&source, config.max_loop_iterations)
-                        .map_err(|e| e.to_string())?;
-                render_run(&outcome);
+                let cps = compile(&source, &config)?;
+                stream_run(&cps, config.max_loop_iterations)?;
             }
         }
         _ => {
             let source = fs::read_to_string(file).map_err(|e| format!("read {file}: {e}"))?;
-            let outcome = kaubo_driver::run_source_with_config(&source, config.max_loop_iterations)
-                .map_err(|e| e.to_string())?;
-            render_run(&outcome);
+            let cps = compile(&source, &config)?;
+            stream_run(&cps, config.max_loop_iterations)?;
         }
     }
+    report_cache(&config);
     Ok(())
 }
 
@@ -356,7 +681,11 @@ mod tests {
         run_args(&args(&["kaubo2", "compile", src.to_str().unwrap()])).unwrap();
 
         assert!(out.exists());
-        assert!(!fs::read(&out).unwrap().is_empty());
+        let bytes = fs::read(&out).unwrap();
+        assert_eq!(
+            kaubo_vm::image::version(&bytes),
+            Some(kaubo_vm::image::VERSION)
+        );
 
         let _ = fs::remove_file(&src);
         let _ = fs::remove_file(&out);
@@ -373,6 +702,89 @@ mod tests {
         let _ = fs::remove_file(&src);
     }
 
+    #[test]
+    fn cli_cache_dir_reuses_compiled_artifacts() {
+        use kaubo_driver::PersistentCache;
+        fn cps_stats(config: &CliConfig) -> kaubo_driver::CacheStats {
+            let stats = config.cache.as_ref().unwrap().stats();
+            stats
+                .into_iter()
+                .find(|(k, _)| k.as_str() == "Cps")
+                .unwrap()
+                .1
+        }
+
+        let src = temp_stem("cached").with_extension("kaubo");
+        let dir = temp_stem("cache_dir");
+        let _ = fs::remove_dir_all(&dir);
+        fs::write(&src, "const x = 42;").unwrap();
+        let (dir_arg, src_arg) = (dir.to_str().unwrap(), src.to_str().unwrap());
+        let argv = args(&["kaubo2", "--cache-dir", dir_arg, "run", src_arg]);
+
+        let first = build_config(&argv);
+        compile("const x = 42;", &first).unwrap();
+        assert_eq!((cps_stats(&first).misses, cps_stats(&first).writes), (1, 1));
+        assert!(first.cache.as_ref().unwrap().size() > 0);
+        run_args(&argv).unwrap();
+
+        // 新进程（新配置）命中上一次写入的条目
+        let second = build_config(&argv);
+        compile("const x = 42;", &second).unwrap();
+        assert_eq!(cps_stats(&second).hits, 1);
+
+        let _ = fs::remove_file(&src);
+        let _ = fs::remove_dir_all(&dir);
+    }
+
+    #[test]
+    fn cli_scale_project_compiles_and_runs() {
+        let dir = temp_stem("scale");
+        let _ = fs::remove_dir_all(&dir);
+        // 60 个模块：25 + 25 + 10 三层，main 导入最后一层
+        run_args(&args(&[
+            "kaubo2",
+            "scale",
+            dir.to_str().unwrap(),
+            "60",
+            "1",
+        ]))
+        .unwrap();
+
+        let main = dir.join("main.kb");
+        let (entry, loader) = module_loader(main.to_str().unwrap()).unwrap();
+        let outcome = kaubo_driver::run_file(&entry, loader).unwrap();
+        assert_eq!(outcome.output, vec![scale_project(60).1]);
+        let _ = fs::remove_dir_all(&dir);
+    }
+
+    #[test]
+    fn cli_scale_project_runs_past_the_call_and_constant_encodings() {
+        // 300 个模块链接后有六百多个函数、几千个常量，超过旧编码的 256 个
+        // 调用目标和 512 个常量下标；scale 自己核对输出
+        let dir = temp_stem("scale_300");
+        let _ = fs::remove_dir_all(&dir);
+        run_args(&args(&[
+            "kaubo2",
+            "scale",
+            dir.to_str().unwrap(),
+            "300",
+            "1",
+        ]))
+        .unwrap();
+        let _ = fs::remove_dir_all(&dir);
+    }
+
+    #[test]
+    fn cli_lex_measures_generated_file() {
+        let src = temp_stem("lex").with_extension("kaubo");
+        let _ = fs::remove_file(&src);
+        fs::write(&src, "const x = 42;").unwrap();
+
+        run_args(&args(&["kaubo2", "lex", src.to_str().unwrap(), "3", "1"])).unwrap();
+
+        let _ = fs::remove_file(&src);
+    }
+
     #[test]
     fn cli_run_compiled_file() {
         let src = temp_stem("run_compiled").with_extension("kaubo");
@@ -431,7 +843,43 @@ mod tests {
     }
 
     #[test]
-    fn debug_impl_dis() {
+    fn cli_profile_writes_folded_and_json() {
+        let src = temp_stem("profile").with_extension("kaubo");
+        let out = temp_stem("profile_out");
+        let folded = out.with_extension("folded");
+        let json = out.with_extension("json");
+        fs::write(
+            &src,
+            // `type_of` is a native call, so Inline leaves `sq` its own frame.
+            "const sq = |n: Int64| -> Int64 { type_of(n); return n * n; };\n\
+             var t = 0; var i = 0; while (i < 50) { t = t + sq(i); i = i + 1; };",
+        )
+        .unwrap();
+
+        run_args(&args(&[
+            "kaubo2",
+            "profile",
+            src.to_str().unwrap(),
+            out.to_str().unwrap(),
+            "--sample-period",
+            "1",
+            "--opcodes",
+        ]))
+        .unwrap();
+
+        let stacks = fs::read_to_string(&folded).unwrap();
+        assert!(stacks.contains("main;lambda_0 50"), "{stacks}");
+        let report = fs::read_to_string(&json).unwrap();
+        assert!(report.starts_with("{\"sample_period\":1,"));
+        assert!(report.contains("\"MulInt\":50"), "{report}");
+
+        for p in [&src, &folded, &json] {
+            let _ = fs::remove_file(p);
+        }
+    }
+
+    #[test]
+    fn impl_method_runs() {
         let src = r#"
 	struct Point { x: Int64, y: Int64 };
 	impl Point {
@@ -446,29 +894,10 @@ mod tests {
 	print(p1.dis(p2).to_string());
 	"#;
         let cps = kaubo_driver::compile_source(src).unwrap();
-        eprintln!("=== CPS DUMP ===");
-        for (fi, func) in cps.functions.iter().enumerate() {
-            eprintln!(
-                "fn {} '{}' entry={} regs={}",
-                fi, func.name, func.entry, func.reg_count
-            );
-            for b in func.blocks.iter().filter(|b| b.id != usize::MAX) {
-                eprintln!(
-                    "  blk{} {}: {:?} | {:?}",
-                    b.id,
-                    if b.id == func.entry { "(entry)" } else { "" },
-                    b.instrs,
-                    b.term
-                );
-            }
-        }
-        if cps.functions.is_empty() {
-            panic!("no funcs");
-        }
         let mut vm = kaubo_vm::VM::new();
         vm.load(&cps).unwrap();
         let e = cps.functions.len() - 1;
-        let r = vm.execute(e, cps.functions[e].reg_count, None);
-        eprintln!("[DEBUG] result={:?} output={:?}", r, vm.output);
+        vm.execute(e, cps.functions[e].reg_count, None).unwrap();
+        assert_eq!(vm.take_output(), vec!["141.4213562373095".to_string()]);
     }
 }
@@ -0,0 +1,3 @@
+async function work(n) { return n * n % 1000 }
+async function main(n) { let t=0; for(let i=0;i<n;i+=4) { const r = await Promise.all([work(i), work(i+1), work(i+2), work(i+3)]); t += r[0]+r[1]+r[2]+r[3] } return t }
+main(20000).then(t => console.log(t))
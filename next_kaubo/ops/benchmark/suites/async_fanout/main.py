@@ -0,0 +1,12 @@
+import asyncio
+
+async def work(n):
+    return n * n % 1000
+
+async def main(n):
+    t = 0
+    for i in range(0, n, 4):
+        t += sum(await asyncio.gather(work(i), work(i + 1), work(i + 2), work(i + 3)))
+    return t
+
+print(asyncio.run(main(20000)))
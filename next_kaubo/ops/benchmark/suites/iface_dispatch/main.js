@@ -0,0 +1,7 @@
+class Sq { constructor(s) { this.s = s } area() { return this.s * this.s } }
+class Rect { constructor(w, h) { this.w = w; this.h = h } area() { return this.w * this.h } }
+class Tri { constructor(b, h) { this.b = b; this.h = h } area() { return Math.trunc(this.b * this.h / 2) } }
+const measure = sh => sh.area()
+const side = n => n % 100 + 1
+function dispatch() { let t=0; for(let i=0;i<100000;i++) { const k=i%3, n=side(i); if(k===0) t+=measure(new Sq(n)); if(k===1) t+=measure(new Rect(n,3)); if(k===2) t+=measure(new Tri(n,4)) } return t }
+console.log(dispatch())
@@ -0,0 +1,25 @@
+class Sq:
+    def __init__(self, s): self.s = s
+    def area(self): return self.s * self.s
+
+class Rect:
+    def __init__(self, w, h): self.w, self.h = w, h
+    def area(self): return self.w * self.h
+
+class Tri:
+    def __init__(self, b, h): self.b, self.h = b, h
+    def area(self): return self.b * self.h // 2
+
+def measure(sh): return sh.area()
+def side(n): return n % 100 + 1
+
+def dispatch():
+    t = 0
+    for i in range(100000):
+        k, n = i % 3, side(i)
+        if k == 0: t += measure(Sq(n))
+        if k == 1: t += measure(Rect(n, 3))
+        if k == 2: t += measure(Tri(n, 4))
+    return t
+
+print(dispatch())
@@ -0,0 +1,2 @@
+function build(n) { let s=""; for(let i=0;i<n;i++) s+="0"; return s+String(n) }
+console.log(parseInt(build(100000), 10))
@@ -0,0 +1,6 @@
+def build(n):
+    s = ""
+    for _ in range(n): s += "0"
+    return s + str(n)
+
+print(int(build(100000).lstrip("0")))